@@ -0,0 +1,157 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "classad/common.h"
+#include "classad/attrName.h"
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+
+namespace classad {
+
+// The table of interned names.  A spelling is removed when its reference
+// count drops to 0.  The count is only lowered to 0 with the table locked,
+// and the entry is removed at once, so a lookup never finds a dead entry.
+// The table is created on first use, because ads may be made by static
+// initializers, and never destroyed, because ads may be deleted by static
+// destructors.
+namespace {
+struct NameId {
+	int id;
+	int spellings;	// the entries with this id
+};
+
+struct AttrNameTable {
+	std::mutex lock;
+		// every spelling of every name
+	std::unordered_map<string, AttrNameEntry *> spellings;
+		// the id of each name, ignoring case
+	std::unordered_map<string, NameId, ClassadAttrNameHash, CaseIgnEqStr> ids;
+		// ids of removed names, to be reused
+	std::vector<int> free_ids;
+};
+
+AttrNameTable &theTable()
+{
+	static AttrNameTable *table = new AttrNameTable;
+	return *table;
+}
+
+const AttrNameEntry *intern( const string &name )
+{
+	AttrNameTable &table = theTable();
+	std::lock_guard<std::mutex> guard( table.lock );
+
+	auto itr = table.spellings.find( name );
+	if( itr != table.spellings.end() ) {
+		itr->second->refs.fetch_add( 1, std::memory_order_relaxed );
+		return itr->second;
+	}
+
+	auto id_itr = table.ids.find( name );
+	if( id_itr == table.ids.end() ) {
+		NameId nid;
+		if( table.free_ids.empty() ) {
+			nid.id = (int)table.ids.size();
+		} else {
+			nid.id = table.free_ids.back();
+			table.free_ids.pop_back();
+		}
+		nid.spellings = 0;
+		id_itr = table.ids.emplace( name, nid ).first;
+	}
+	id_itr->second.spellings++;
+
+	AttrNameEntry *entry = new AttrNameEntry;
+	itr = table.spellings.emplace( name, entry ).first;
+	entry->name = &itr->first;
+	entry->hash = ClassadAttrNameHash()( name );
+	entry->id = id_itr->second.id;
+	entry->refs = 1;
+	return entry;
+}
+}
+
+void AttrName::
+unintern( const AttrNameEntry *entry )
+{
+	AttrNameTable &table = theTable();
+	std::lock_guard<std::mutex> guard( table.lock );
+
+	AttrNameEntry *e = const_cast<AttrNameEntry *>( entry );
+	if( e->refs.fetch_sub( 1 ) != 1 ) {
+			// interned again since the caller looked at the count
+		return;
+	}
+
+	auto id_itr = table.ids.find( *e->name );
+	if( id_itr != table.ids.end() && --id_itr->second.spellings == 0 ) {
+		table.free_ids.push_back( id_itr->second.id );
+		table.ids.erase( id_itr );
+	}
+	table.spellings.erase( table.spellings.find( *e->name ) );
+	delete e;
+}
+
+AttrNameProbe::
+AttrNameProbe( const string &name )
+{
+	entry.name = &name;
+	entry.hash = ClassadAttrNameHash()( name );
+	entry.id = -1;
+}
+
+AttrName::
+AttrName()
+{
+		// the table keeps the reference taken here, so "" is never removed
+	static const AttrNameEntry *empty = intern( "" );
+	entry = empty;
+	hold();
+}
+
+AttrName::
+AttrName( const string &name ) : entry( intern( name ) )
+{
+}
+
+AttrName::
+AttrName( const char *name ) : entry( intern( name ) )
+{
+}
+
+int AttrName::
+InternedCount()
+{
+	AttrNameTable &table = theTable();
+	std::lock_guard<std::mutex> guard( table.lock );
+	return (int)table.ids.size();
+}
+
+std::ostream &
+operator<<( std::ostream &os, const AttrName &name )
+{
+	return os << name.str();
+}
+
+} // classad
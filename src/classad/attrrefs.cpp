@@ -39,7 +39,7 @@ AttributeReference::
 AttributeReference( ExprTree *tree, const string &attrname, bool absolut )
 {
 	parentScope = NULL;
-	attributeStr = attrname;
+	attributeStr = AttrName( attrname );
 	expr = tree;
 	absolute = absolut;
 }
@@ -109,7 +109,7 @@ bool AttributeReference::SetComponents( ExprTree *tree, const std::string &attr,
 		if (expr) delete expr;
 		expr = tree;
 	}
-	attributeStr = attr;
+	attributeStr = AttrName( attr );
 	absolute = abs;
 	return true;
 }
@@ -23,6 +23,7 @@
 #include "classad/source.h"
 #include "classad/sink.h"
 #include "classad/classadCache.h"
+#include <atomic>
 
 using namespace std;
 
@@ -58,8 +59,9 @@ bool ClassAdGetExpressionCaching()
 // This is probably not the best place to put these. However, 
 // I am reconsidering how we want to do errors, and this may all
 // change in any case. 
-string CondorErrMsg;
-int CondorErrno;
+// They are per-thread so that expressions can be parsed on more than one thread.
+thread_local string CondorErrMsg;
+thread_local int CondorErrno;
 
 void ClassAdLibraryVersion(int &major, int &minor, int &patch)
 {
@@ -114,6 +116,7 @@ void SetOldClassAdSemantics(bool enable)
 ClassAd::
 ClassAd ()
 {
+	version = 0;
 	parentScope = NULL;
 	do_dirty_tracking = false;
 	chained_parent_ad = NULL;
@@ -124,6 +127,7 @@ ClassAd ()
 ClassAd::
 ClassAd (const ClassAd &ad)
 {
+	version = 0;
     CopyFrom(ad);
 	return;
 }	
@@ -265,6 +269,18 @@ Clear( )
 		if( itr->second ) delete itr->second;
 	}
 	attrList.clear( );
+	version = 0;
+}
+
+
+unsigned long long ClassAd::
+GetVersion() const
+{
+	static std::atomic<unsigned long long> last_version(0);
+	if( !version ) {
+		version = ++last_version;
+	}
+	return version;
 }
 
 void ClassAd::
@@ -283,7 +299,7 @@ GetComponents( vector< pair< string, ExprTree* > > &attrs,
 {
 	attrs.clear( );
 	for ( References::const_iterator wl_itr = whitelist.begin(); wl_itr != whitelist.end(); wl_itr++ ) {
-		AttrList::const_iterator attr_itr = attrList.find( *wl_itr );
+		AttrList::const_iterator attr_itr = attrList.find( AttrNameProbe( *wl_itr ) );
 		if ( attr_itr != attrList.end() ) {
 			attrs.emplace_back( attr_itr->first, attr_itr->second );
 		}
@@ -334,7 +350,7 @@ InsertAttr( const string &name, long long value)
 	MarkAttributeDirty(name);
 
 	// Optimized insert of long long values that overwrite the destination value if the destination is a literal.
-	classad::ExprTree* & expr = attrList[name];
+	classad::ExprTree* & expr = _LookupOrInsert(name);
 	if (expr) {
 		if (expr->GetKind() == LITERAL_NODE) {
 			((Literal*)expr)->SetLong(value);
@@ -400,7 +416,7 @@ InsertAttr( const string &name, double value)
 	MarkAttributeDirty(name);
 
 	// Optimized insert of Real values that overwrite the destination value if the destination is a literal.
-	classad::ExprTree* & expr = attrList[name];
+	classad::ExprTree* & expr = _LookupOrInsert(name);
 	if (expr) {
 		if (expr->GetKind() == LITERAL_NODE) {
 			((Literal*)expr)->SetReal(value);
@@ -433,7 +449,7 @@ InsertAttr( const string &name, bool value )
 	MarkAttributeDirty(name);
 
 	// Optimized insert of bool values that overwrite the destination value if the destination is a literal.
-	classad::ExprTree* & expr = attrList[name];
+	classad::ExprTree* & expr = _LookupOrInsert(name);
 	if (expr) {
 		if (expr->GetKind() == LITERAL_NODE) {
 			((Literal*)expr)->SetBool(value);
@@ -472,7 +488,7 @@ InsertAttr( const string &name, const char * str, size_t len)
 	MarkAttributeDirty(name);
 
 	// Optimized insert of long long values that overwrite the destination value if the destination is a literal.
-	classad::ExprTree* & expr = attrList[name];
+	classad::ExprTree* & expr = _LookupOrInsert(name);
 	if (expr) {
 		if (expr->GetKind() == LITERAL_NODE) {
 			((Literal*)expr)->SetString(str, len);
@@ -622,8 +638,17 @@ AssignExpr(const std::string &name, const char *value)
 
 bool ClassAd::Insert( const std::string& attrName, ExprTree * tree )
 {
-	bool bRet = false;
-	
+		// use the name already in the list if there is one, to save
+		// interning it again
+	AttrList::iterator itr = attrList.find( AttrNameProbe( attrName ) );
+	if( itr != attrList.end() ) {
+		return Insert( itr->first, tree );
+	}
+	return Insert( AttrName( attrName ), tree );
+}
+
+bool ClassAd::Insert( const AttrName& attrName, ExprTree * tree )
+{
 		// sanity checks
 	if( attrName.empty() ) {
 		CondorErrno = ERR_MISSING_ATTRNAME;
@@ -645,6 +670,7 @@ bool ClassAd::Insert( const std::string& attrName, ExprTree * tree )
 		delete insert_result.first->second;
 		insert_result.first->second = tree;
 	}
+	version = 0;
 
 	MarkAttributeDirty(attrName);
 
@@ -658,19 +684,9 @@ bool ClassAd::Insert( const std::string& attrName, ExprTree * tree )
 //
 bool ClassAd::InsertLiteral(const std::string & name, Literal* lit)
 {
-#if 0 // tj wonders, is this slower/faster?
-	classad::ExprTree* & ppv = attrList[name];
+	classad::ExprTree* & ppv = _LookupOrInsert(name);
 	if (ppv) delete ppv;
 	ppv = lit;
-#else
-	pair<AttrList::iterator,bool> insert_result = attrList.emplace(name, lit);
-
-	if( !insert_result.second ) {
-			// replace existing value
-		delete insert_result.first->second;
-		insert_result.first->second = lit;
-	}
-#endif
 	MarkAttributeDirty(name);
 	return true;
 }
@@ -683,25 +699,43 @@ DeepInsert( ExprTree *scopeExpr, const string &name, ExprTree *tree )
 	if( !ad ) return( false );
 	return( ad->Insert( name, tree ) );
 }
+
+ExprTree *& ClassAd::
+_LookupOrInsert( const string &name )
+{
+	// the caller is going to store into the result
+	version = 0;
+	AttrList::iterator itr = attrList.find( AttrNameProbe( name ) );
+	if( itr != attrList.end() ) {
+		return itr->second;
+	}
+	return attrList.emplace( AttrName( name ), (ExprTree*)NULL ).first->second;
+}
 // --- end expression insertion
 
 // --- begin STL-like functions
 ClassAd::iterator ClassAd::
 find(string const& attrName)
 {
-    return attrList.find(attrName);
+    return attrList.find(AttrNameProbe(attrName));
 }
  
 ClassAd::const_iterator ClassAd::
 find(string const& attrName) const
 {
-    return attrList.find(attrName);
+    return attrList.find(AttrNameProbe(attrName));
 }
 // --- end STL-like functions
 
 // --- begin lookup methods
 ExprTree *ClassAd::
 Lookup( const string &name ) const
+{
+	return Lookup( AttrName( AttrNameProbe( name ) ) );
+}
+
+ExprTree *ClassAd::
+Lookup( const AttrName &name ) const
 {
 	ExprTree *tree;
 	AttrList::const_iterator itr;
@@ -723,7 +757,7 @@ LookupIgnoreChain( const string &name ) const
 	ExprTree *tree;
 	AttrList::const_iterator itr;
 
-	itr = attrList.find( name );
+	itr = attrList.find( AttrNameProbe( name ) );
 	if (itr != attrList.end()) {
 		tree = itr->second;
 	} else {
@@ -753,6 +787,12 @@ LookupInScope( const string &name, const ClassAd *&finalScope ) const
 
 int ClassAd::
 LookupInScope(const string &name, ExprTree*& expr, EvalState &state) const
+{
+	return LookupInScope( AttrName( AttrNameProbe( name ) ), expr, state );
+}
+
+int ClassAd::
+LookupInScope(const AttrName &name, ExprTree*& expr, EvalState &state) const
 {
 	const ClassAd *current = this, *superScope;
 
@@ -773,7 +813,7 @@ LookupInScope(const string &name, ExprTree*& expr, EvalState &state) const
 		} else {
 			superScope = current->parentScope;
 		}
-		if ( getSpecialAttrNames().find(name) == getSpecialAttrNames().end() ) {
+		if ( getSpecialAttrNames().find(name.str()) == getSpecialAttrNames().end() ) {
 			// continue searching from the superScope ...
 			current = superScope;
 			if( current == this ) {		// NAC - simple loop checker
@@ -817,10 +857,11 @@ Delete( const string &name )
 	bool deleted_attribute;
 
     deleted_attribute = false;
-	AttrList::iterator itr = attrList.find( name );
+	AttrList::iterator itr = attrList.find( AttrNameProbe( name ) );
 	if( itr != attrList.end( ) ) {
 		delete itr->second;
 		attrList.erase( itr );
+		version = 0;
 		deleted_attribute = true;
 	}
 	// If the attribute is in the chained parent, we delete define it
@@ -865,10 +906,11 @@ Remove( const string &name )
 	ExprTree *tree;
 
 	tree = NULL;
-	AttrList::iterator itr = attrList.find( name );
+	AttrList::iterator itr = attrList.find( AttrNameProbe( name ) );
 	if( itr != attrList.end( ) ) {
 		tree = itr->second;
 		attrList.erase( itr );
+		version = 0;
 		tree->SetParentScope( NULL );
 	}
 
@@ -2150,7 +2192,7 @@ bool ClassAd::PruneChildAttr(const std::string & attrName, bool if_child_matches
 	if ( ! chained_parent_ad)
 		return false;
 
-	AttrList::iterator itr = attrList.find(attrName);
+	AttrList::iterator itr = attrList.find(AttrNameProbe(attrName));
 	if (itr == attrList.end())
 		return false;
 
@@ -2163,6 +2205,7 @@ bool ClassAd::PruneChildAttr(const std::string & attrName, bool if_child_matches
 	if (prune_it) {
 		delete itr->second;
 		attrList.erase(itr);
+		version = 0;
 		return true;
 	}
 	return false;
@@ -2189,6 +2232,7 @@ int ClassAd::PruneChildAd()
 				MarkAttributeClean(rm_itr->first);
 				delete rm_itr->second;
 				attrList.erase( rm_itr->first );
+				version = 0;
 				iRet++;
 			}
 			else
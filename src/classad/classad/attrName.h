@@ -0,0 +1,178 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef __CLASSAD_ATTR_NAME_H__
+#define __CLASSAD_ATTR_NAME_H__
+
+#include <string>
+#include <iosfwd>
+#include <atomic>
+#include "classad/common.h"
+
+namespace classad {
+
+class AttrName;
+
+/// An entry in the table of attribute names
+struct AttrNameEntry {
+	const std::string *name;
+	size_t hash;		// ClassadAttrNameHash of name
+	int id;				// the same for names that differ only in case, -1 if not interned
+	std::atomic<int> refs;	// AttrNames that hold the entry, it is removed at 0
+};
+
+/** A lookup key for a name that is not interned.  It refers to the string
+	it was made from, so it must not outlive it.  This is used to look up
+	a name in an attribute list without adding it to the table of names.
+*/
+class AttrNameProbe
+{
+	public:
+		explicit AttrNameProbe( const std::string &name );
+	private:
+		friend class AttrName;
+		AttrNameEntry entry;
+};
+
+/** The name of an attribute in a ClassAd.  Names are interned in a table
+	shared by all ads, so an AttrName is a single pointer, and each spelling
+	of a name is stored once no matter how many ads have it.  Names that
+	differ only in case are given the same id, so attribute lists can hash
+	and compare interned names without looking at the strings.
+
+	Entries are reference counted, a spelling is removed from the table
+	when the last AttrName that holds it goes away, and its id is given
+	to the next new name.  So names that come from ads sent by other
+	processes do not stay in the table after the ads are deleted.
+
+	An AttrName can be used in most places a const std::string can.
+	Comparing it to a string with == or < is case sensitive, as it is for
+	std::string; use AttrNameEq for the case insensitive comparison done
+	by attribute lists.
+*/
+class AttrName
+{
+	public:
+		/// The empty name
+		AttrName();
+
+		/// Intern a name, adding it to the table if it is not there
+		explicit AttrName( const std::string &name );
+		explicit AttrName( const char *name );
+
+		/// A key that refers to the string the probe was made from
+		AttrName( const AttrNameProbe &probe ) : entry( &probe.entry ) { }
+
+		AttrName( const AttrName &that ) : entry( that.entry ) { hold(); }
+		AttrName &operator=( const AttrName &that ) {
+			if( entry != that.entry ) {
+				that.hold();
+				release();
+				entry = that.entry;
+			}
+			return *this;
+		}
+		~AttrName() { release(); }
+
+		const std::string &str() const { return *entry->name; }
+		operator const std::string &() const { return *entry->name; }
+		const char *c_str() const { return entry->name->c_str(); }
+		size_t size() const { return entry->name->size(); }
+		size_t length() const { return entry->name->length(); }
+		bool empty() const { return entry->name->empty(); }
+		char operator[]( size_t pos ) const { return (*entry->name)[pos]; }
+		std::string substr( size_t pos = 0, size_t len = std::string::npos ) const
+			{ return entry->name->substr( pos, len ); }
+		size_t find( const char *s, size_t pos = 0 ) const { return entry->name->find( s, pos ); }
+		size_t find( char ch, size_t pos = 0 ) const { return entry->name->find( ch, pos ); }
+		size_t rfind( const char *s, size_t pos = std::string::npos ) const
+			{ return entry->name->rfind( s, pos ); }
+		int compare( const std::string &s ) const { return entry->name->compare( s ); }
+
+		/// Names that differ only in case have the same id
+		int id() const { return entry->id; }
+		size_t hash() const { return entry->hash; }
+
+		/// The number of distinct (case insensitive) names in the table
+		static int InternedCount();
+
+	private:
+		friend struct AttrNameEq;
+		void hold() const {
+			if( entry->id >= 0 ) {
+				const_cast<AttrNameEntry *>( entry )->refs.fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+		void release() {
+			if( entry->id >= 0 ) {
+				int refs = entry->refs.load( std::memory_order_relaxed );
+					// only the table may take the count to 0, see unintern()
+				while( refs > 1 ) {
+					if( const_cast<AttrNameEntry *>( entry )->refs.compare_exchange_weak( refs, refs - 1 ) ) {
+						return;
+					}
+				}
+				unintern( entry );
+			}
+		}
+		static void unintern( const AttrNameEntry *entry );
+
+		const AttrNameEntry *entry;
+};
+
+/// The hash used by attribute lists, the same as ClassadAttrNameHash of the name
+struct AttrNameHash {
+	inline size_t operator()( const AttrName &name ) const noexcept {
+		return name.hash();
+	}
+};
+
+/// The case insensitive comparison used by attribute lists
+struct AttrNameEq {
+	inline bool operator()( const AttrName &n1, const AttrName &n2 ) const noexcept {
+		const AttrNameEntry *e1 = n1.entry, *e2 = n2.entry;
+		if( e1->id >= 0 && e2->id >= 0 ) {
+			return e1->id == e2->id;
+		}
+		return e1->hash == e2->hash &&
+			strcasecmp( e1->name->c_str(), e2->name->c_str() ) == 0;
+	}
+};
+
+inline bool operator==( const AttrName &n1, const AttrName &n2 ) { return n1.str() == n2.str(); }
+inline bool operator==( const AttrName &n1, const std::string &s2 ) { return n1.str() == s2; }
+inline bool operator==( const std::string &s1, const AttrName &n2 ) { return s1 == n2.str(); }
+inline bool operator==( const AttrName &n1, const char *s2 ) { return n1.str() == s2; }
+inline bool operator==( const char *s1, const AttrName &n2 ) { return s1 == n2.str(); }
+inline bool operator!=( const AttrName &n1, const AttrName &n2 ) { return n1.str() != n2.str(); }
+inline bool operator!=( const AttrName &n1, const std::string &s2 ) { return n1.str() != s2; }
+inline bool operator!=( const std::string &s1, const AttrName &n2 ) { return s1 != n2.str(); }
+inline bool operator!=( const AttrName &n1, const char *s2 ) { return n1.str() != s2; }
+inline bool operator!=( const char *s1, const AttrName &n2 ) { return s1 != n2.str(); }
+inline bool operator<( const AttrName &n1, const AttrName &n2 ) { return n1.str() < n2.str(); }
+inline std::string operator+( const std::string &s1, const AttrName &n2 ) { return s1 + n2.str(); }
+inline std::string operator+( const AttrName &n1, const std::string &s2 ) { return n1.str() + s2; }
+inline std::string operator+( const char *s1, const AttrName &n2 ) { return s1 + n2.str(); }
+inline std::string operator+( const AttrName &n1, const char *s2 ) { return n1.str() + s2; }
+std::ostream &operator<<( std::ostream &os, const AttrName &name );
+
+} // classad
+
+#endif//__CLASSAD_ATTR_NAME_H__
@@ -21,6 +21,8 @@
 #ifndef __CLASSAD_ATTRREFS_H__
 #define __CLASSAD_ATTRREFS_H__
 
+#include "classad/attrName.h"
+
 namespace classad {
 
 /// Represents a attribute reference node (like .b) in the expression tree
@@ -107,11 +109,13 @@ class AttributeReference : public ExprTree
     	virtual bool _Flatten( EvalState&, Value&, ExprTree*&, int* ) const;
 		int	FindExpr( EvalState&, ExprTree*&, ExprTree*&, bool ) const;
 
+		friend class CompiledExpr;
+
 		const ClassAd *parentScope;
 
 		ExprTree	*expr;
 		bool		absolute;
-    	std::string attributeStr;
+		AttrName	attributeStr;	// interned when parsed, so lookups don't hash the name
 };
 
 } // classad
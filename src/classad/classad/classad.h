@@ -27,6 +27,8 @@
 #include <vector>
 #include "classad/classad_containers.h"
 #include "classad/exprTree.h"
+#include "classad/attrName.h"
+#include "classad/flatAttrList.h"
 
 namespace classad {
 
@@ -38,7 +40,11 @@ typedef std::map<const ClassAd*, References> PortReferences;
 #include "classad/rectangle.h"
 #endif
 
-typedef classad_unordered<std::string, ExprTree*, ClassadAttrNameHash, CaseIgnEqStr> AttrList;
+#ifdef CLASSAD_FLAT_ATTRLIST
+typedef FlatAttrList AttrList;
+#else
+typedef classad_unordered<AttrName, ExprTree*, AttrNameHash, AttrNameEq> AttrList;
+#endif
 typedef std::set<std::string, CaseIgnLTStr> DirtyAttrList;
 
 void ClassAdLibraryVersion(int &major, int &minor, int &patch);
@@ -99,6 +105,7 @@ class ClassAd : public ExprTree
 			@see ExprTree::setParentScope
 		*/
 		bool Insert( const std::string& attrName, ExprTree* expr);   // (ignores cache)
+		bool Insert( const AttrName& attrName, ExprTree* expr);   // (ignores cache)
 		bool InsertLiteral(const std::string& attrName, Literal* lit); // (ignores cache)
 
 		// insert through cache if cache is enabled, otherwise just parse and insert
@@ -287,6 +294,8 @@ class ClassAd : public ExprTree
 				otherwise.
 		*/
 		ExprTree *Lookup( const std::string &attrName ) const;
+		/// As above, for a name that has been interned, which is faster
+		ExprTree *Lookup( const AttrName &attrName ) const;
 		ExprTree* LookupExpr(const std::string &name) const
 		{ return Lookup( name ); }
 
@@ -636,6 +645,8 @@ class ClassAd : public ExprTree
 		ClassAd &operator=(const ClassAd &rhs);
 
 		ClassAd &operator=(ClassAd &&rhs)  noexcept {
+			this->version = 0;
+			rhs.version = 0;
 			this->do_dirty_tracking = rhs.do_dirty_tracking;
 			this->chained_parent_ad = rhs.chained_parent_ad;
 			this->alternateScope = rhs.alternateScope;
@@ -764,6 +775,24 @@ class ClassAd : public ExprTree
 		bool UpdateFromChain( const ClassAd &ad );
         //@}
 
+		/**@name Version */
+        //@{
+		/** Get a number that identifies the current contents of this ad.
+		 *  It changes whenever an attribute is inserted, replaced or removed,
+		 *  and no two ads, or two states of one ad, have the same version, so
+		 *  a copy of it can be kept to tell whether the ad has changed since.
+		 *  Changes made through an iterator or to an expression in place are
+		 *  not noticed.  The first call after a change assigns the new number,
+		 *  so it must not be made by several threads at once.
+		 *  @return the version, which is never 0
+		 */
+		unsigned long long GetVersion() const;
+		/** Check whether this ad is still at the given version, without
+		 *  assigning a version.  This is safe to call from several threads.
+		 */
+		bool        IsVersion(unsigned long long v) const { return v && version == v; }
+        //@}
+
 		/**@name Dirty Tracking */
         //@{
 		/** enable or disable dirty tracking for this ClassAd
@@ -831,6 +860,7 @@ class ClassAd : public ExprTree
 		friend 	class ExprTree;
 		friend 	class EvalState;
 		friend 	class ClassAdIterator;
+		friend 	class CompiledExpr;
 
 		bool _GetExternalReferences( const ExprTree *, const ClassAd *, 
 					EvalState &, References&, bool fullNames ) const;
@@ -854,8 +884,11 @@ class ClassAd : public ExprTree
 		virtual bool _Flatten( EvalState&, Value&, ExprTree*&, int* ) const;
 	
 		int LookupInScope( const std::string&, ExprTree*&, EvalState& ) const;
+		int LookupInScope( const AttrName&, ExprTree*&, EvalState& ) const;
+		ExprTree *&_LookupOrInsert( const std::string &name );
 		AttrList	  attrList;
 		DirtyAttrList dirtyAttrList;
+		mutable unsigned long long version; // 0 if changed since GetVersion()
 		bool          do_dirty_tracking;
 		ClassAd       *chained_parent_ad;
 		const ClassAd *parentScope;
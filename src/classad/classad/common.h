@@ -184,10 +184,10 @@ struct ClassadAttrNameHash
 	}
 
 };
-extern std::string       CondorErrMsg;
+extern thread_local std::string CondorErrMsg;
 #endif
 
-extern int 		CondorErrno;
+extern thread_local int CondorErrno;
 
 
 } // classad
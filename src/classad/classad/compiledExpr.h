@@ -0,0 +1,158 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef __CLASSAD_COMPILED_EXPR_H__
+#define __CLASSAD_COMPILED_EXPR_H__
+
+#include <vector>
+#include "classad/exprTree.h"
+#include "classad/attrName.h"
+
+namespace classad {
+
+/** An expression tree lowered into a flat program for a small stack machine.
+	This is intended for expressions that are evaluated many times without
+	changing, such as the Requirements of a job that is being matched against
+	every slot in the pool.
+
+	Literals, operators and attribute references are compiled; function calls,
+	lists, nested ads and <tt>a ?: b</tt> are evaluated by calling into the
+	tree.  Each attribute name is given a slot when the expression is
+	compiled, and a lookup of the same name from the same scope is done only
+	once per evaluation.  References that lead to a ClassAd, like TARGET and
+	MY in a match, are also evaluated only once.  Expressions in the same ad
+	that are referred to by name, like START in the Requirements of a slot,
+	are compiled along with the expression and used when the reference turns
+	out to lead to them.  Evaluation produces the same Value as evaluating
+	the tree.
+
+	The program refers to nodes of the tree it was compiled from, so that
+	tree must not be modified or deleted while the program is in use.  The
+	compiled forms of the expressions it refers to by name are used only
+	while the ad that holds them is at the same version as when they were
+	compiled, so inserting, replacing or removing attributes of the ad is
+	safe; the referenced expressions are then evaluated as trees.  Evaluate()
+	does not modify the program, so one program may be evaluated by several
+	threads at once.
+*/
+class CompiledExpr
+{
+	public:
+		/** Compile an expression tree.
+			@param tree The expression to compile.
+			@return The compiled expression, or NULL if tree is NULL.
+		*/
+		static CompiledExpr *Compile( const ExprTree *tree );
+
+		~CompiledExpr();
+
+		/** Evaluate the compiled expression, as ExprTree::Evaluate would.
+			@param state The current state
+			@param val   The result of the evaluation
+			@return true on success, false on failure
+		*/
+		bool Evaluate( EvalState &state, Value &val ) const;
+
+		/** Evaluate the compiled expression in the scope of the ClassAd
+			that the tree belongs to, as ExprTree::Evaluate(Value&) would.
+			@param val   The result of the evaluation
+			@return true on success, false on failure
+		*/
+		bool Evaluate( Value &val ) const;
+
+		/// The expression this was compiled from
+		const ExprTree *GetTree() const { return tree; }
+
+		/** Gets the size of the program
+			@param instructions The number of instructions
+			@param tree_calls The number of instructions that evaluate a subtree
+		*/
+		void GetStats( int &instructions, int &tree_calls ) const;
+
+	private:
+		enum OpCode {
+			PUSH_CONST,		// push constants[arg]
+			PUSH_ATTR,		// push the value of an unscoped or absolute attribute
+			SELECT_ATTR,	// replace the ad on top of the stack with the value of its attribute
+			EVAL_TREE,		// push the value of node, evaluated as a tree
+			UNARY_OP,
+			BINARY_OP,
+			AND_JUMP,		// short circuit of &&, jump to target if the top is false
+			OR_JUMP,		// short circuit of ||, jump to target if the top is true
+			TERNARY_TEST,	// pop a true selector, pop a false one and jump to arg,
+							// otherwise evaluate the rest of node as a tree and jump to target
+			JUMP,
+		};
+
+		struct Instruction {
+			OpCode code;
+			int op;				// Operation::OpKind for operators
+			int arg;			// constant index, attribute slot or else branch
+			int target;			// jump target
+			const ExprTree *node;
+		};
+
+		struct AttrSlot {
+			AttrName name;
+			bool absolute;
+			bool use_alternate;
+			const ExprTree *expected;	// what the name refers to in the ad of the tree
+			const ClassAd *owner;		// the ad that held expected when it was compiled
+			unsigned long long version;	// the version of owner then
+			CompiledExpr *compiled;		// the compiled form of expected
+		};
+
+		// the result of looking up a slot's attribute, remembered for one evaluation
+		struct AttrLookup {
+			const ClassAd *from;
+			int rval;
+			ExprTree *expr;
+			const ClassAd *scope;
+			const ClassAd *ad_value;	// non-NULL if expr is known to evaluate to this ad
+		};
+
+		CompiledExpr( const ExprTree *tree, int nesting );
+
+		void compile( const ExprTree *tree );
+		int emit( OpCode code, const ExprTree *node, int op = 0, int arg = 0 );
+		int attrSlot( const AttrName &name, bool absolute, bool use_alternate );
+		void push( int count = 1 );
+
+		bool evalAttr( EvalState &state, const Instruction &ins, const ClassAd *from,
+			AttrLookup *lookups, Value &val ) const;
+		static bool evalRef( EvalState &state, const ExprTree *expr, Value &val,
+			const ClassAd *&ad_value );
+
+		const ExprTree *tree;
+		std::vector<Instruction> code;
+		std::vector<Value> constants;
+		std::vector<AttrSlot> slots;
+		int depth;
+		int max_depth;
+		int nesting;		// how many references deep this is compiled for
+
+		// No copying
+		CompiledExpr( const CompiledExpr & );
+		CompiledExpr &operator=( const CompiledExpr & );
+};
+
+} // classad
+
+#endif//__CLASSAD_COMPILED_EXPR_H__
@@ -0,0 +1,170 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef __CLASSAD_FLAT_ATTR_LIST_H__
+#define __CLASSAD_FLAT_ATTR_LIST_H__
+
+#include <cstddef>
+#include <stdint.h>
+#include <iterator>
+#include <utility>
+#include "classad/attrName.h"
+
+namespace classad {
+
+class ExprTree;
+
+/** An attribute list that keeps its (name, expression) pairs in a single
+	array, using open addressing with linear probing.  It has the parts of
+	the interface of std::unordered_map that ClassAd uses, and is used as
+	the AttrList of a ClassAd when the library is built with
+	CLASSAD_FLAT_ATTRLIST defined.
+
+	Compared to std::unordered_map this uses no memory per attribute other
+	than the pair and one control byte, and a lookup touches one array
+	instead of following a pointer from the bucket to each node.  As with
+	std::unordered_map, erasing an element only invalidates iterators to it,
+	and inserting a new element invalidates all iterators.  Unlike it,
+	inserting a new element also invalidates pointers and references to
+	elements.
+*/
+class FlatAttrList
+{
+	public:
+		typedef AttrName key_type;
+		typedef ExprTree *mapped_type;
+		typedef std::pair<const AttrName, ExprTree *> value_type;
+		typedef size_t size_type;
+
+		template <class V> class iterator_base
+		{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef FlatAttrList::value_type value_type;
+				typedef ptrdiff_t difference_type;
+				typedef V *pointer;
+				typedef V &reference;
+
+				iterator_base() : slot( NULL ), ctrl( NULL ) { }
+				// an iterator converts to a const_iterator
+				template <class V2> iterator_base( const iterator_base<V2> &that )
+					: slot( that.slot ), ctrl( that.ctrl ) { }
+
+				reference operator*() const { return *slot; }
+				pointer operator->() const { return slot; }
+				iterator_base &operator++() {
+					do { ++slot; ++ctrl; } while( !( *ctrl & FULL ) );
+					return *this;
+				}
+				iterator_base operator++( int ) { iterator_base tmp( *this ); ++*this; return tmp; }
+				template <class V2> bool operator==( const iterator_base<V2> &that ) const
+					{ return slot == that.slot; }
+				template <class V2> bool operator!=( const iterator_base<V2> &that ) const
+					{ return slot != that.slot; }
+
+			private:
+				friend class FlatAttrList;
+				template <class V2> friend class iterator_base;
+				iterator_base( V *s, const unsigned char *c ) : slot( s ), ctrl( c ) { }
+				V *slot;
+				const unsigned char *ctrl;
+		};
+		typedef iterator_base<value_type> iterator;
+		typedef iterator_base<const value_type> const_iterator;
+
+		FlatAttrList() : slots( NULL ), ctrl( &end_ctrl ), capacity( 0 ), count( 0 ), used( 0 ) { }
+		FlatAttrList( const FlatAttrList &that );
+		FlatAttrList( FlatAttrList &&that );
+		~FlatAttrList();
+		FlatAttrList &operator=( const FlatAttrList &that );
+		FlatAttrList &operator=( FlatAttrList &&that );
+
+		iterator begin() { return first( slots, ctrl ); }
+		const_iterator begin() const { return first( (const value_type *)slots, ctrl ); }
+		iterator end() { return iterator( slots + capacity, ctrl + capacity ); }
+		const_iterator end() const { return const_iterator( slots + capacity, ctrl + capacity ); }
+
+		size_type size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		iterator find( const AttrName &name ) {
+			size_t ix = lookup( name );
+			return ix < capacity ? iterator( slots + ix, ctrl + ix ) : end();
+		}
+		const_iterator find( const AttrName &name ) const {
+			size_t ix = lookup( name );
+			return ix < capacity ? const_iterator( slots + ix, ctrl + ix ) : end();
+		}
+
+		/// Insert a pair if the name is not in the list
+		std::pair<iterator, bool> emplace( const AttrName &name, ExprTree *tree );
+		ExprTree *&operator[]( const AttrName &name ) { return emplace( name, NULL ).first->second; }
+
+		void erase( const_iterator pos );
+		size_type erase( const AttrName &name );
+		void clear();
+
+		/// Make room for at least n attributes
+		void rehash( size_type n );
+
+	private:
+		enum { EMPTY = 0, DELETED = 1, FULL = 0x80 };
+		static unsigned char end_ctrl;	// the control byte past the end of every table, never written
+
+		// the hash is mixed so that both the index (the low bits) and the
+		// tag (the high bits) depend on the whole name
+		static uint64_t mix( size_t hash ) {
+			uint64_t h = hash;
+			h ^= h >> 33; h *= 0xff51afd7ed558ccdull; h ^= h >> 33;
+			return h;
+		}
+		static unsigned char tag( uint64_t mixed ) { return (unsigned char)( FULL | ( mixed >> 57 ) ); }
+
+		template <class V> static iterator_base<V> first( V *s, const unsigned char *c ) {
+			iterator_base<V> it( s, c );
+			if( !( *c & FULL ) ) ++it;
+			return it;
+		}
+
+		// the index of the name, or capacity if it is not in the list
+		size_t lookup( const AttrName &name ) const {
+			if( count == 0 ) return capacity;
+			uint64_t mixed = mix( name.hash() );
+			unsigned char t = tag( mixed );
+			size_t mask = capacity - 1;
+			for( size_t ix = (size_t)mixed & mask; ; ix = ( ix + 1 ) & mask ) {
+				if( ctrl[ix] == t && AttrNameEq()( slots[ix].first, name ) ) return ix;
+				if( ctrl[ix] == EMPTY ) return capacity;
+			}
+		}
+
+		void resize( size_t new_capacity );
+		void release();
+
+		value_type *slots;
+		unsigned char *ctrl;	// capacity control bytes followed by end_ctrl
+		size_t capacity;		// 0 or a power of 2
+		size_t count;			// full slots
+		size_t used;			// full and deleted slots
+};
+
+} // classad
+
+#endif//__CLASSAD_FLAT_ATTR_LIST_H__
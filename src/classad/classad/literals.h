@@ -229,6 +229,7 @@ class Literal : public ExprTree
 		friend class ClassAd;
 		friend class ExprList;
 		friend class Operation;
+		friend class CompiledExpr;
 
 		virtual void _SetParentScope( const ClassAd* ){ }
 		virtual bool _Flatten( EvalState&, Value&, ExprTree*&, int* ) const;
@@ -25,6 +25,8 @@
 
 namespace classad {
 
+class CompiledExpr;
+
 /** Special case of a ClassAd which make it easy to do matching.  
     The top-level ClassAd equivalent to the following, with some
     minor implementation differences for efficiency.  Because of
@@ -165,6 +167,17 @@ class MatchClassAd : public ClassAd
 		void SetLeftAlias( const std::string &name );
 		void SetRightAlias( const std::string &name );
 
+		/** Sets a compiled form of the requirements of the left/right ad,
+		 *  to be used by symmetricMatch(), rightMatchesLeft() and
+		 *  leftMatchesRight() in place of evaluating the tree.  It is
+		 *  ignored if it was not compiled from the Requirements that is
+		 *  in the ad, and it is forgotten when the ad is replaced or
+		 *  removed.  The caller owns the compiled expression.
+		 *  @param req The compiled requirements, or NULL to evaluate the tree.
+		 */
+		void SetLeftRequirements( const CompiledExpr *req );
+		void SetRightRequirements( const CompiledExpr *req );
+
 		/** Modifies the requirements expression in the given ad to
 			make matchmaking more efficient.  This will only improve
 			efficiency if it is called once and then the resulting
@@ -199,6 +212,7 @@ class MatchClassAd : public ClassAd
 		const ClassAd *ladParent, *radParent;
 		ClassAd *lCtx, *rCtx, *lad, *rad;
 		ExprTree *symmetric_match, *right_matches_left, *left_matches_right;
+		const CompiledExpr *left_requirements, *right_requirements;
 		std::string lAlias, rAlias;
 
     private:
@@ -226,6 +240,12 @@ class MatchClassAd : public ClassAd
 		   @return true if the given expression evaluates to true
 		*/
 		bool EvalMatchExpr(ExprTree *match_expr);
+
+		/**
+		   evaluate the requirements of the given ad as match_expr would,
+		   using the compiled requirements if they are current
+		*/
+		bool EvalRequirements(ExprTree *match_expr, ClassAd *ad, const CompiledExpr *req, Value &val);
 };
 
 } // classad
@@ -543,6 +543,43 @@ static void test_classad(const Parameters &, Results &results)
     TEST("update from chain is merged",(have_attribute==true));
     TEST("update from chain has attribute c==6",(i==6));
 
+    /* ----- Test that attribute names are case insensitive ----- */
+    ClassAd classad4;
+    classad4.InsertAttr("MixedCase", 1);
+    classad4.InsertAttr("mixedcase", 2);
+    TEST("insert with other case replaces attribute", (classad4.size() == 1));
+    TEST("first spelling of name is kept", (classad4.begin()->first == "MixedCase"));
+    have_attribute = classad4.EvaluateAttrInt("MIXEDCASE", i);
+    TEST("lookup with other case finds attribute", (have_attribute == true && i == 2));
+    c = parser.ParseClassAd("[ x = MIXEDcase + 1 ]");
+    c->ChainToAd(&classad4);
+    have_attribute = c->EvaluateAttrInt("X", i);
+    TEST("reference with other case finds attribute", (have_attribute == true && i == 3));
+    c->Unchain();
+    delete c;
+    success = classad4.Delete("mIxEdCaSe");
+    TEST("delete with other case removes attribute", (success == true && classad4.size() == 0));
+
+    /* ----- Test that unused attribute names leave the table ----- */
+    int interned = AttrName::InternedCount();
+    c = parser.ParseClassAd("[ UnusedName1 = 1; UnusedName2 = UnusedName1 + 1; unusedname3 = 3 ]");
+    TEST("new names are interned", (AttrName::InternedCount() == interned + 3));
+    classad4.InsertAttr("UNUSEDNAME3", 4);
+    classad4.InsertAttr("UnusedName4", 4);
+    TEST("other spelling has the same id", (AttrName::InternedCount() == interned + 4));
+    delete c;
+    TEST("names still in an ad are kept", (AttrName::InternedCount() == interned + 2));
+    c = parser.ParseClassAd("[ UnusedName5 = 5; UnusedName6 = 6 ]");
+    have_attribute = classad4.EvaluateAttrInt("unusedname3", i);
+    TEST("kept name is found after ids are reused", (have_attribute == true && i == 4));
+    have_attribute = classad4.EvaluateAttrInt("UnusedName5", i);
+    TEST("reused id does not find another name", (have_attribute == false));
+    have_attribute = c->EvaluateAttrInt("UNUSEDNAME6", i);
+    TEST("name with reused id is found", (have_attribute == true && i == 6));
+    delete c;
+    classad4.Clear();
+    TEST("names are removed when no ad has them", (AttrName::InternedCount() == interned));
+
     return;
 }
 
@@ -0,0 +1,549 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "classad/common.h"
+#include "classad/exprTree.h"
+#include "classad/compiledExpr.h"
+
+using namespace std;
+
+namespace classad {
+
+// the stack and lookup slots of most expressions fit in these, so that
+// evaluation doesn't have to allocate.
+static const int LOCAL_STACK_SIZE = 16;
+static const int LOCAL_SLOT_COUNT = 32;
+
+// how deep to follow references to other expressions in the same ad
+static const int MAX_COMPILE_NESTING = 4;
+
+CompiledExpr::
+CompiledExpr( const ExprTree *expr, int nest )
+	: tree( expr ), depth( 0 ), max_depth( 0 ), nesting( nest )
+{
+}
+
+
+CompiledExpr::
+~CompiledExpr()
+{
+	for( vector<AttrSlot>::iterator it = slots.begin(); it != slots.end(); ++it ) {
+		delete it->compiled;
+	}
+}
+
+
+CompiledExpr *CompiledExpr::
+Compile( const ExprTree *expr )
+{
+	if( !expr ) {
+		return NULL;
+	}
+	CompiledExpr *prog = new CompiledExpr( expr, 0 );
+	prog->compile( expr );
+	return prog;
+}
+
+
+void CompiledExpr::
+GetStats( int &instructions, int &tree_calls ) const
+{
+	instructions = (int)code.size();
+	tree_calls = 0;
+	for( vector<Instruction>::const_iterator it = code.begin(); it != code.end(); ++it ) {
+		if( it->code == EVAL_TREE || it->code == TERNARY_TEST ) {
+			tree_calls++;
+		}
+	}
+	for( vector<AttrSlot>::const_iterator it = slots.begin(); it != slots.end(); ++it ) {
+		if( it->compiled ) {
+			int num = 0, calls = 0;
+			it->compiled->GetStats( num, calls );
+			instructions += num;
+			tree_calls += calls;
+		}
+	}
+}
+
+
+int CompiledExpr::
+emit( OpCode opcode, const ExprTree *node, int op, int arg )
+{
+	Instruction ins;
+	ins.code = opcode;
+	ins.op = op;
+	ins.arg = arg;
+	ins.target = 0;
+	ins.node = node;
+	code.push_back( ins );
+	return (int)code.size() - 1;
+}
+
+
+void CompiledExpr::
+push( int count )
+{
+	depth += count;
+	if( depth > max_depth ) {
+		max_depth = depth;
+	}
+}
+
+
+int CompiledExpr::
+attrSlot( const AttrName &name, bool absolute, bool use_alternate )
+{
+	for( size_t ix = 0; ix < slots.size(); ++ix ) {
+		if( slots[ix].absolute == absolute && slots[ix].use_alternate == use_alternate &&
+			AttrNameEq()( slots[ix].name, name ) ) {
+			return (int)ix;
+		}
+	}
+	AttrSlot slot;
+	slot.name = name;
+	slot.absolute = absolute;
+	slot.use_alternate = use_alternate;
+	slot.expected = NULL;
+	slot.owner = NULL;
+	slot.version = 0;
+	slot.compiled = NULL;
+
+	// an unscoped reference will usually find an expression in the same ad,
+	// compile that too if it is worth compiling.
+	const ClassAd *parent = tree->GetParentScope();
+	const ExprTree *ref = NULL;
+	if( use_alternate && parent && nesting < MAX_COMPILE_NESTING &&
+		( ref = parent->Lookup( name ) ) && ref->self()->GetKind() == ExprTree::OP_NODE &&
+		( slot.owner = ref->GetParentScope() ) ) {
+		slot.expected = ref->self();
+		slot.version = slot.owner->GetVersion();
+		slot.compiled = new CompiledExpr( ref, nesting + 1 );
+		slot.compiled->compile( ref );
+	}
+	slots.push_back( slot );
+	return (int)slots.size() - 1;
+}
+
+
+void CompiledExpr::
+compile( const ExprTree *expr )
+{
+	expr = expr->self();
+
+	switch( expr->GetKind() ) {
+	case ExprTree::LITERAL_NODE: {
+			EvalState state;
+			Value val;
+			expr->Evaluate( state, val );
+			constants.push_back( val );
+			emit( PUSH_CONST, expr, 0, (int)constants.size() - 1 );
+			push();
+			return;
+		}
+
+	case ExprTree::ATTRREF_NODE: {
+			const AttributeReference *ref = (const AttributeReference*)expr;
+			const ExprTree *scope = ref->expr;
+			const AttrName &name = ref->attributeStr;
+			bool absolute = ref->absolute;
+			if( !scope ) {
+				// "attr" and ".attr", only the unscoped form falls back to the alternate scope
+				emit( PUSH_ATTR, expr, 0, attrSlot( name, absolute, !absolute ) );
+				push();
+			} else {
+				// "expr.attr"
+				compile( scope );
+				emit( SELECT_ATTR, expr, 0, attrSlot( name, false, false ) );
+			}
+			return;
+		}
+
+	case ExprTree::OP_NODE: {
+			Operation::OpKind op = Operation::__NO_OP__;
+			ExprTree *e1 = NULL, *e2 = NULL, *e3 = NULL;
+			((const Operation*)expr)->GetComponents( op, e1, e2, e3 );
+
+			if( op == Operation::PARENTHESES_OP && e1 ) {
+				compile( e1 );
+				return;
+			}
+			if( ( op == Operation::LOGICAL_AND_OP || op == Operation::LOGICAL_OR_OP ) && e1 && e2 && !e3 ) {
+				compile( e1 );
+				int jump = emit( op == Operation::LOGICAL_AND_OP ? AND_JUMP : OR_JUMP, expr, op );
+				compile( e2 );
+				emit( BINARY_OP, expr, op );
+				push( -1 );
+				code[jump].target = (int)code.size();
+				return;
+			}
+			if( op == Operation::TERNARY_OP && e1 && e2 && e3 ) {
+				compile( e1 );
+				int test = emit( TERNARY_TEST, expr, op );
+				push( -1 );
+				compile( e2 );
+				int jump = emit( JUMP, expr );
+				push( -1 );
+				code[test].arg = (int)code.size();
+				compile( e3 );
+				code[test].target = (int)code.size();
+				code[jump].target = (int)code.size();
+				return;
+			}
+			if( op != Operation::TERNARY_OP && op != Operation::__NO_OP__ && e1 && !e3 ) {
+				compile( e1 );
+				if( e2 ) {
+					compile( e2 );
+					emit( BINARY_OP, expr, op );
+					push( -1 );
+				} else {
+					emit( UNARY_OP, expr, op );
+				}
+				return;
+			}
+			break;
+		}
+
+	default:
+		break;
+	}
+
+	// everything else is evaluated by the tree
+	emit( EVAL_TREE, expr );
+	push();
+}
+
+
+bool CompiledExpr::
+evalAttr( EvalState &state, const Instruction &ins, const ClassAd *from,
+	AttrLookup *lookups, Value &val ) const
+{
+	const AttrSlot &slot = slots[ins.arg];
+	AttrLookup &lookup = lookups[ins.arg];
+	const ClassAd *curAd = state.curAd;
+
+	// the same as AttributeReference::FindExpr(), but remember the result
+	// so that the next reference from the same scope doesn't have to look.
+	if( lookup.from != from || !from ) {
+		if( !from ) {
+			if( slot.absolute ) {
+				return false;
+			}
+			val.SetUndefinedValue();
+			return true;
+		}
+		lookup.from = from;
+		lookup.ad_value = NULL;
+		lookup.rval = from->LookupInScope( slot.name, lookup.expr, state );
+		if( slot.use_alternate && lookup.rval == ExprTree::EVAL_UNDEF && from->alternateScope ) {
+			lookup.rval = from->alternateScope->LookupInScope( slot.name, lookup.expr, state );
+		}
+		lookup.scope = state.curAd;
+		state.curAd = curAd;
+	}
+
+	switch( lookup.rval ) {
+		case ExprTree::EVAL_FAIL:
+			return false;
+
+		case ExprTree::EVAL_ERROR:
+			val.SetErrorValue();
+			return true;
+
+		case ExprTree::EVAL_UNDEF:
+			val.SetUndefinedValue();
+			return true;
+
+		case ExprTree::EVAL_OK:
+		{
+			if( lookup.ad_value ) {
+				val.SetClassAdValue( (ClassAd*)lookup.ad_value );
+				return true;
+			}
+			if( state.depth_remaining <= 0 ) {
+				val.SetErrorValue();
+				return false;
+			}
+			state.depth_remaining--;
+			state.curAd = lookup.scope;
+
+			val.SetUndefinedValue();
+			bool rval;
+				// the compiled form is good only if the ad that holds the
+				// expression is unchanged since it was compiled.  owner may
+				// have been deleted since, so check that it holds expr first.
+			if( slot.compiled && lookup.expr->self() == slot.expected &&
+				lookup.expr->GetParentScope() == slot.owner && slot.owner->IsVersion( slot.version ) ) {
+				rval = slot.compiled->Evaluate( state, val );
+			} else {
+				rval = evalRef( state, lookup.expr, val, lookup.ad_value );
+			}
+
+			state.depth_remaining++;
+			state.curAd = curAd;
+			return rval;
+		}
+		default:  CLASSAD_EXCEPT( "ClassAd:  Should not reach here" );
+	}
+	return false;
+}
+
+
+// Evaluate the expression that an attribute refers to.  If it is a ClassAd,
+// or a chain of plain references that ends in a ClassAd, the value can't
+// change during an evaluation, so the ad is returned in ad_value.
+bool CompiledExpr::
+evalRef( EvalState &state, const ExprTree *expr, Value &val, const ClassAd *&ad_value )
+{
+	expr = expr->self();
+	ad_value = NULL;
+
+	if( expr->GetKind() == ExprTree::LITERAL_NODE ) {
+		// most attributes are literals, skip the virtual call
+		return ((const Literal*)expr)->Literal::_Evaluate( state, val );
+	}
+	if( expr->GetKind() == ExprTree::CLASSAD_NODE ) {
+		ad_value = (const ClassAd*)expr;
+		val.SetClassAdValue( (ClassAd*)ad_value );
+		return true;
+	}
+
+	const AttributeReference *ref = (const AttributeReference*)expr;
+	if( expr->GetKind() != ExprTree::ATTRREF_NODE || ref->expr ) {
+		return expr->Evaluate( state, val );
+	}
+
+	// as AttributeReference::_Evaluate() for "attr" and ".attr"
+	const ClassAd *curAd = state.curAd;
+	const ClassAd *current = ref->absolute ? state.rootAd : state.curAd;
+	ExprTree *tree = NULL;
+	int rval;
+	if( !current ) {
+		rval = ref->absolute ? ExprTree::EVAL_FAIL : ExprTree::EVAL_UNDEF;
+	} else {
+		rval = current->LookupInScope( ref->attributeStr, tree, state );
+		if( !ref->absolute && rval == ExprTree::EVAL_UNDEF && current->alternateScope ) {
+			rval = current->alternateScope->LookupInScope( ref->attributeStr, tree, state );
+		}
+	}
+
+	bool ok = true;
+	switch( rval ) {
+		case ExprTree::EVAL_FAIL:
+			ok = false;
+			break;
+
+		case ExprTree::EVAL_ERROR:
+			val.SetErrorValue();
+			break;
+
+		case ExprTree::EVAL_UNDEF:
+			val.SetUndefinedValue();
+			break;
+
+		case ExprTree::EVAL_OK:
+			if( state.depth_remaining <= 0 ) {
+				val.SetErrorValue();
+				ok = false;
+				break;
+			}
+			state.depth_remaining--;
+			ok = evalRef( state, tree, val, ad_value );
+			state.depth_remaining++;
+			break;
+
+		default:  CLASSAD_EXCEPT( "ClassAd:  Should not reach here" );
+	}
+	state.curAd = curAd;
+	return ok;
+}
+
+
+bool CompiledExpr::
+Evaluate( Value &val ) const
+{
+	EvalState state;
+
+	state.SetScopes( tree->GetParentScope() );
+	return Evaluate( state, val );
+}
+
+
+bool CompiledExpr::
+Evaluate( EvalState &state, Value &result ) const
+{
+	// the tree walker is the one that knows how to print debug output
+	if( state.debug ) {
+		return tree->Evaluate( state, result );
+	}
+
+	Value local_stack[LOCAL_STACK_SIZE];
+	AttrLookup local_lookups[LOCAL_SLOT_COUNT];
+	vector<Value> big_stack;
+	vector<AttrLookup> big_lookups;
+	Value *stack = local_stack;
+	AttrLookup *lookups = local_lookups;
+	if( max_depth > LOCAL_STACK_SIZE ) {
+		big_stack.resize( max_depth );
+		stack = &big_stack[0];
+	}
+	if( slots.size() > (size_t)LOCAL_SLOT_COUNT ) {
+		big_lookups.resize( slots.size() );
+		lookups = &big_lookups[0];
+	}
+	for( size_t ix = 0; ix < slots.size(); ++ix ) {
+		lookups[ix].from = NULL;
+	}
+
+	const ClassAd *curAd = state.curAd;
+	int sp = -1;
+	int pc = 0;
+	int end = (int)code.size();
+	bool arg_bool;
+
+	while( pc < end ) {
+		const Instruction &ins = code[pc++];
+
+		switch( ins.code ) {
+		case PUSH_CONST:
+			stack[++sp].CopyFrom( constants[ins.arg] );
+			break;
+
+		case PUSH_ATTR:
+			++sp;
+			if( !evalAttr( state, ins, slots[ins.arg].absolute ? state.rootAd : state.curAd,
+					lookups, stack[sp] ) ) {
+				goto failed;
+			}
+			break;
+
+		case SELECT_ATTR: {
+				Value &top = stack[sp];
+				ClassAd *ad = NULL;
+				if( top.IsUndefinedValue() || top.IsErrorValue() ) {
+					// propagates as it is
+				} else if( top.GetType() == Value::CLASSAD_VALUE ) {
+					// the ad isn't owned by the value, so it can be overwritten
+					top.IsClassAdValue( ad );
+					if( !evalAttr( state, ins, ad, lookups, top ) ) {
+						goto failed;
+					}
+				} else if( top.IsClassAdValue( ad ) ) {
+					Value val;
+					if( !evalAttr( state, ins, ad, lookups, val ) ) {
+						goto failed;
+					}
+					top.CopyFrom( val );
+				} else if( top.IsListValue() ) {
+					// the tree knows how to apply the reference to each ad in the list
+					Value val;
+					if( !ins.node->Evaluate( state, val ) ) {
+						goto failed;
+					}
+					top.CopyFrom( val );
+				} else {
+					top.SetErrorValue();
+				}
+				break;
+			}
+
+		case EVAL_TREE:
+			stack[++sp].SetUndefinedValue();
+			if( !ins.node->Evaluate( state, stack[sp] ) ) {
+				goto failed;
+			}
+			break;
+
+		case UNARY_OP: {
+				Value val, dummy;
+				if( Operation::_doOperation( (Operation::OpKind)ins.op, stack[sp], dummy, dummy,
+						true, false, false, val, &state ) == Operation::SIG_NONE ) {
+					goto failed;
+				}
+				stack[sp].CopyFrom( val );
+				break;
+			}
+
+		case BINARY_OP: {
+				Value val, dummy;
+				--sp;
+				if( Operation::_doOperation( (Operation::OpKind)ins.op, stack[sp], stack[sp+1], dummy,
+						true, true, false, val, &state ) == Operation::SIG_NONE ) {
+					goto failed;
+				}
+				stack[sp].CopyFrom( val );
+				break;
+			}
+
+		case AND_JUMP:
+			if( stack[sp].IsBooleanValueEquiv( arg_bool ) && !arg_bool ) {
+				stack[sp].SetBooleanValue( false );
+				pc = ins.target;
+			}
+			break;
+
+		case OR_JUMP:
+			if( stack[sp].IsBooleanValueEquiv( arg_bool ) && arg_bool ) {
+				stack[sp].SetBooleanValue( true );
+				pc = ins.target;
+			}
+			break;
+
+		case TERNARY_TEST:
+			if( stack[sp].IsBooleanValueEquiv( arg_bool ) ) {
+				--sp;
+				if( !arg_bool ) {
+					pc = ins.arg;
+				}
+			} else {
+				// an undefined or non-boolean selector is rare, so let the
+				// tree evaluate both branches and combine them.
+				Operation::OpKind op;
+				ExprTree *e1, *e2, *e3;
+				Value val2, val3, val;
+				((const Operation*)ins.node)->GetComponents( op, e1, e2, e3 );
+				if( !e2->Evaluate( state, val2 ) || !e3->Evaluate( state, val3 ) ) {
+					goto failed;
+				}
+				if( Operation::_doOperation( op, stack[sp], val2, val3,
+						true, true, true, val, &state ) == Operation::SIG_NONE ) {
+					goto failed;
+				}
+				stack[sp].CopyFrom( val );
+				pc = ins.target;
+			}
+			break;
+
+		case JUMP:
+			pc = ins.target;
+			break;
+		}
+	}
+
+	state.curAd = curAd;
+	result.CopyFrom( stack[0] );
+	return true;
+
+failed:
+	state.curAd = curAd;
+	result.SetErrorValue();
+	return false;
+}
+
+} // classad
@@ -0,0 +1,216 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "classad/common.h"
+#include "classad/flatAttrList.h"
+#include <new>
+#include <string.h>
+
+namespace classad {
+
+unsigned char FlatAttrList::end_ctrl = 0xff;
+
+// smallest table allocated, and the maximum load of a table in eighths
+static const size_t MIN_CAPACITY = 8;
+static const size_t MAX_LOAD = 7;
+
+FlatAttrList::
+FlatAttrList( const FlatAttrList &that )
+	: slots( NULL ), ctrl( &end_ctrl ), capacity( 0 ), count( 0 ), used( 0 )
+{
+	*this = that;
+}
+
+FlatAttrList::
+FlatAttrList( FlatAttrList &&that )
+	: slots( that.slots ), ctrl( that.ctrl ), capacity( that.capacity ),
+	  count( that.count ), used( that.used )
+{
+	that.slots = NULL;
+	that.ctrl = &end_ctrl;
+	that.capacity = that.count = that.used = 0;
+}
+
+FlatAttrList::
+~FlatAttrList()
+{
+	release();
+}
+
+FlatAttrList &FlatAttrList::
+operator=( const FlatAttrList &that )
+{
+	if( this != &that ) {
+		clear();
+		rehash( that.count );
+		for( const_iterator itr = that.begin(); itr != that.end(); ++itr ) {
+			emplace( itr->first, itr->second );
+		}
+	}
+	return *this;
+}
+
+FlatAttrList &FlatAttrList::
+operator=( FlatAttrList &&that )
+{
+	if( this != &that ) {
+		release();
+		slots = that.slots;
+		ctrl = that.ctrl;
+		capacity = that.capacity;
+		count = that.count;
+		used = that.used;
+		that.slots = NULL;
+		that.ctrl = &end_ctrl;
+		that.capacity = that.count = that.used = 0;
+	}
+	return *this;
+}
+
+std::pair<FlatAttrList::iterator, bool> FlatAttrList::
+emplace( const AttrName &name, ExprTree *tree )
+{
+	size_t ix = lookup( name );
+	if( ix < capacity ) {
+		return std::make_pair( iterator( slots + ix, ctrl + ix ), false );
+	}
+
+	if( ( used + 1 ) * 8 > capacity * MAX_LOAD ) {
+			// if half of the used slots are deleted, cleaning them out
+			// is enough, otherwise grow
+		resize( count + 1 > used / 2 ? ( capacity ? capacity * 2 : MIN_CAPACITY ) : capacity );
+	}
+
+	uint64_t mixed = mix( name.hash() );
+	size_t mask = capacity - 1;
+	ix = (size_t)mixed & mask;
+	while( ctrl[ix] & FULL ) {
+		ix = ( ix + 1 ) & mask;
+	}
+	if( ctrl[ix] == EMPTY ) {
+		used++;
+	}
+	ctrl[ix] = tag( mixed );
+	new( slots + ix ) value_type( name, tree );
+	count++;
+	return std::make_pair( iterator( slots + ix, ctrl + ix ), true );
+}
+
+void FlatAttrList::
+erase( const_iterator pos )
+{
+	size_t ix = pos.slot - slots;
+	slots[ix].~value_type();
+	count--;
+		// a slot followed by an empty one is not in the middle of any
+		// probe sequence, so it can be made empty rather than deleted
+	if( ctrl[( ix + 1 ) & ( capacity - 1 )] == EMPTY ) {
+		ctrl[ix] = EMPTY;
+		used--;
+	} else {
+		ctrl[ix] = DELETED;
+	}
+}
+
+FlatAttrList::size_type FlatAttrList::
+erase( const AttrName &name )
+{
+	size_t ix = lookup( name );
+	if( ix >= capacity ) {
+		return 0;
+	}
+	erase( const_iterator( slots + ix, ctrl + ix ) );
+	return 1;
+}
+
+void FlatAttrList::
+clear()
+{
+	for( size_t ix = 0; ix < capacity; ++ix ) {
+		if( ctrl[ix] & FULL ) {
+			slots[ix].~value_type();
+		}
+	}
+	memset( ctrl, EMPTY, capacity );
+	count = used = 0;
+}
+
+void FlatAttrList::
+rehash( size_type n )
+{
+	size_t new_capacity = capacity ? capacity : MIN_CAPACITY;
+	while( n * 8 > new_capacity * MAX_LOAD ) {
+		new_capacity *= 2;
+	}
+	if( new_capacity > capacity ) {
+		resize( new_capacity );
+	}
+}
+
+void FlatAttrList::
+resize( size_t new_capacity )
+{
+	value_type *old_slots = slots;
+	unsigned char *old_ctrl = ctrl;
+	size_t old_capacity = capacity;
+
+		// the slots and the control bytes share one allocation
+	char *mem = new char[new_capacity * sizeof( value_type ) + new_capacity + 1];
+	slots = (value_type *)mem;
+	ctrl = (unsigned char *)( mem + new_capacity * sizeof( value_type ) );
+	memset( ctrl, EMPTY, new_capacity );
+	ctrl[new_capacity] = end_ctrl;
+	capacity = new_capacity;
+	count = used = 0;
+
+	size_t mask = capacity - 1;
+	for( size_t old_ix = 0; old_ix < old_capacity; ++old_ix ) {
+		if( !( old_ctrl[old_ix] & FULL ) ) {
+			continue;
+		}
+		size_t ix = (size_t)mix( old_slots[old_ix].first.hash() ) & mask;
+		while( ctrl[ix] != EMPTY ) {
+			ix = ( ix + 1 ) & mask;
+		}
+		ctrl[ix] = old_ctrl[old_ix];
+		new( slots + ix ) value_type( old_slots[old_ix] );
+		old_slots[old_ix].~value_type();
+		count++;
+		used++;
+	}
+
+	if( old_capacity ) {
+		delete [] (char *)old_slots;
+	}
+}
+
+void FlatAttrList::
+release()
+{
+	if( capacity ) {
+		clear();
+		delete [] (char *)slots;
+	}
+	slots = NULL;
+	ctrl = &end_ctrl;
+	capacity = count = used = 0;
+}
+
+} // classad
@@ -21,6 +21,7 @@
 #include "classad/common.h"
 #include "classad/source.h"
 #include "classad/matchClassad.h"
+#include "classad/compiledExpr.h"
 
 using namespace std;
 
@@ -37,6 +38,7 @@ MatchClassAd()
 	symmetric_match = NULL;
 	right_matches_left = NULL;
 	left_matches_right = NULL;
+	left_requirements = right_requirements = NULL;
 	InitMatchClassAd( NULL, NULL );
 }
 
@@ -46,6 +48,7 @@ MatchClassAd( ClassAd *adl, ClassAd *adr ) : ClassAd()
 {
 	lad = rad = lCtx = rCtx = NULL;
 	ladParent = radParent = NULL;
+	left_requirements = right_requirements = NULL;
 	InitMatchClassAd( adl, adr );
 }
 
@@ -144,6 +147,7 @@ bool MatchClassAd::
 ReplaceLeftAd( ClassAd *ad )
 {
 	lad = ad;
+	left_requirements = NULL;
 	ladParent = ad ? ad->GetParentScope( ) : (ClassAd*)NULL;
 	if( ad ) {
 		if( !Insert( "LEFT", ad ) ) {
@@ -176,6 +180,7 @@ bool MatchClassAd::
 ReplaceRightAd( ClassAd *ad )
 {
 	rad = ad;
+	right_requirements = NULL;
 	radParent = ad ? ad->GetParentScope( ) : (ClassAd*)NULL;
 	if( ad ) {
 		if( !Insert( "RIGHT", ad ) ) {
@@ -247,6 +252,7 @@ RemoveLeftAd( )
 	}
 	ladParent = NULL;
 	lad = NULL;
+	left_requirements = NULL;
 	return( ad );
 }
 
@@ -265,6 +271,7 @@ RemoveRightAd( )
 	}
 	radParent = NULL;
 	rad = NULL;
+	right_requirements = NULL;
 	return( ad );
 }
 
@@ -308,6 +315,18 @@ SetRightAlias( const std::string &name )
 	}
 }
 
+void MatchClassAd::
+SetLeftRequirements( const CompiledExpr *req )
+{
+	left_requirements = req;
+}
+
+void MatchClassAd::
+SetRightRequirements( const CompiledExpr *req )
+{
+	right_requirements = req;
+}
+
 bool MatchClassAd::
 OptimizeRightAdForMatchmaking( ClassAd *ad, std::string *error_msg, const std::string &left_alias, const std::string &right_alias )
 {
@@ -443,6 +462,20 @@ UnoptimizeAdForMatchmaking( ClassAd *ad )
 	return true;
 }
 
+static bool
+IsMatchValue( const Value &val )
+{
+	bool result = false;
+	if( val.IsBooleanValueEquiv( result ) ) {
+		return result;
+	}
+	long long int_result = 0;
+	if( val.IsIntegerValue( int_result ) ) {
+		return int_result != 0;
+	}
+	return false;
+}
+
 bool MatchClassAd::
 EvalMatchExpr(ExprTree *match_expr)
 {
@@ -452,34 +485,69 @@ EvalMatchExpr(ExprTree *match_expr)
 	}
 
 	if( EvaluateExpr( match_expr, val ) ) {
-		bool result = false;
-		if( val.IsBooleanValueEquiv( result ) ) {
-			return result;
-		}
-		long long int_result = 0;
-		if( val.IsIntegerValue( int_result ) ) {
-			return int_result != 0;
-		}
+		return IsMatchValue( val );
 	}
 	return false;
 }
 
+bool MatchClassAd::
+EvalRequirements(ExprTree *match_expr, ClassAd *ad, const CompiledExpr *req, Value &val)
+{
+	ExprTree *tree = ad ? ad->Lookup( ATTR_REQUIREMENTS ) : NULL;
+	if( !req || !tree || tree->self() != req->GetTree()->self() ) {
+		return EvaluateExpr( match_expr, val );
+	}
+
+		// match_expr is LEFT.requirements or RIGHT.requirements, which
+		// evaluates the requirements one level down in the ad itself
+	EvalState state;
+	state.SetScopes( this );
+	state.curAd = ad;
+	state.depth_remaining--;
+	return req->Evaluate( state, val );
+}
+
 bool MatchClassAd::
 symmetricMatch()
 {
-	return EvalMatchExpr( symmetric_match );
+	if( !symmetric_match || ( !left_requirements && !right_requirements ) ) {
+		return EvalMatchExpr( symmetric_match );
+	}
+
+		// RIGHT.requirements && LEFT.requirements
+	Value right_val, left_val, val;
+	bool result = false;
+	if( !EvalRequirements( left_matches_right, rad, right_requirements, right_val ) ) {
+		return false;
+	}
+	if( right_val.IsBooleanValueEquiv( result ) && !result ) {
+		return false;
+	}
+	if( !EvalRequirements( right_matches_left, lad, left_requirements, left_val ) ) {
+		return false;
+	}
+	Operation::Operate( Operation::LOGICAL_AND_OP, right_val, left_val, val );
+	return IsMatchValue( val );
 }
 
 bool MatchClassAd::
 rightMatchesLeft()
 {
-	return EvalMatchExpr( right_matches_left );
+	if( !right_matches_left || !left_requirements ) {
+		return EvalMatchExpr( right_matches_left );
+	}
+	Value val;
+	return EvalRequirements( right_matches_left, lad, left_requirements, val ) && IsMatchValue( val );
 }
 
 bool MatchClassAd::
 leftMatchesRight()
 {
-	return EvalMatchExpr( left_matches_right );
+	if( !left_matches_right || !right_requirements ) {
+		return EvalMatchExpr( left_matches_right );
+	}
+	Value val;
+	return EvalRequirements( left_matches_right, rad, right_requirements, val ) && IsMatchValue( val );
 }
 
 } // classad
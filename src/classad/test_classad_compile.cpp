@@ -0,0 +1,421 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Compare matchmaking with the tree walker against matchmaking with compiled
+// Requirements expressions.  The job and machine ads are read from files in
+// the long form written by condor_q -long and condor_status -long, or made up
+// if no files are given.  Every job is matched against every machine, first
+// to check that both ways give the same values, then timed.  Then a small ad
+// is changed under a compiled Requirements to check that the compiled forms of
+// the attributes it refers to are not used once they are stale.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <time.h>
+
+#include "classad/classad_distribution.h"
+#include "classad/compiledExpr.h"
+
+using namespace std;
+using namespace classad;
+
+static bool read_ads(const char * filename, vector<ClassAd*> & ads)
+{
+	FILE * fp = fopen(filename, "r");
+	if ( ! fp) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return false;
+	}
+
+	ClassAd * ad = NULL;
+	char line[64*1024];
+	while (fgets(line, sizeof(line), fp)) {
+		size_t len = strlen(line);
+		while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) { line[--len] = 0; }
+		if ( ! len) {
+			if (ad) { ads.push_back(ad); ad = NULL; }
+			continue;
+		}
+		if ( ! ad) { ad = new ClassAd(); }
+		if ( ! ad->Insert(string(line))) {
+			fprintf(stderr, "%s: could not parse: %s\n", filename, line);
+		}
+	}
+	if (ad) { ads.push_back(ad); }
+	fclose(fp);
+	return true;
+}
+
+static const char * job_requirements[] = {
+	"(TARGET.Arch == \"X86_64\") && (TARGET.OpSys == \"LINUX\") && (TARGET.Disk >= RequestDisk) && (TARGET.Memory >= RequestMemory) && (TARGET.Cpus >= RequestCpus) && (TARGET.HasFileTransfer)",
+	"(TARGET.OpSys == \"LINUX\" || TARGET.OpSys == \"WINDOWS\") && TARGET.Memory >= RequestMemory && TARGET.KFlops > 1000000",
+	"TARGET.Memory >= RequestMemory && (TARGET.HasDocker =?= true ? TARGET.DockerVersion >= 18 : TARGET.HasSingularity =?= true)",
+	"isUndefined(TARGET.GPUs) ? false : (TARGET.GPUs >= RequestGPUs && TARGET.CUDACapability >= 3.5) && TARGET.Disk >= RequestDisk",
+	"(TARGET.Arch == \"X86_64\") && (TARGET.Memory * 1024 >= ImageSize) && ((TARGET.FileSystemDomain == MY.FileSystemDomain) || (TARGET.HasFileTransfer))",
+	"member(TARGET.Machine, {\"exec3\", \"exec7\", \"exec11\"}) || (TARGET.Cpus >= RequestCpus && TARGET.LoadAvg < 0.5)",
+};
+
+static void make_ads(int num_jobs, int num_machines, vector<ClassAd*> & jobs, vector<ClassAd*> & machines)
+{
+	ClassAdParser parser;
+	char buf[4096];
+	for (int ii = 0; ii < num_machines; ++ii) {
+		snprintf(buf, sizeof(buf),
+			"[ MyType = \"Machine\"; Name = \"slot1@exec%d\"; Machine = \"exec%d\";"
+			" Arch = \"%s\"; OpSys = \"%s\"; Memory = %d; Disk = %d; Cpus = %d;"
+			" KFlops = %d; LoadAvg = %.2f; KeyboardIdle = %d; HasFileTransfer = true;"
+			" FileSystemDomain = \"%s\"; %s %s"
+			" Start = (KeyboardIdle > 15 * 60) && (LoadAvg < 0.3 || TARGET.NiceUser =?= true);"
+			" WithinResourceLimits = (MY.Cpus >= TARGET.RequestCpus) && (MY.Memory >= TARGET.RequestMemory) && (MY.Disk >= TARGET.RequestDisk);"
+			" Requirements = START && WithinResourceLimits; Rank = TARGET.JobPrio ]",
+			ii, ii,
+			(ii % 5) ? "X86_64" : "INTEL", (ii % 7) ? "LINUX" : "WINDOWS",
+			1024 * (1 + rand() % 64), 1000000 * (1 + rand() % 100), 1 + rand() % 32,
+			500000 + rand() % 2000000, (rand() % 100) / 100.0, rand() % 3600,
+			(ii % 3) ? "cs.wisc.edu" : "chtc.wisc.edu",
+			(ii % 4) ? "" : "GPUs = 2; CUDACapability = 6.0;",
+			(ii % 2) ? "HasDocker = true; DockerVersion = 19;" : "HasSingularity = true;");
+		ClassAd * ad = parser.ParseClassAd(buf, true);
+		if (ad) { machines.push_back(ad); }
+	}
+	for (int ii = 0; ii < num_jobs; ++ii) {
+		snprintf(buf, sizeof(buf),
+			"[ MyType = \"Job\"; ClusterId = %d; ProcId = 0; Owner = \"user%d\";"
+			" RequestMemory = %d; RequestDisk = %d; RequestCpus = %d; RequestGPUs = 1;"
+			" ImageSize = %d; JobPrio = %d; NiceUser = %s; FileSystemDomain = \"cs.wisc.edu\";"
+			" Requirements = %s; Rank = TARGET.KFlops ]",
+			ii + 1, ii % 10,
+			128 * (1 + rand() % 64), 1000 * (1 + rand() % 10000), 1 + rand() % 4,
+			1000 * (1 + rand() % 1000), rand() % 10, (ii % 9) ? "false" : "true",
+			job_requirements[ii % (sizeof(job_requirements)/sizeof(job_requirements[0]))]);
+		ClassAd * ad = parser.ParseClassAd(buf, true);
+		if (ad) { jobs.push_back(ad); }
+	}
+}
+
+static vector<CompiledExpr*> compile_requirements(vector<ClassAd*> & ads)
+{
+	vector<CompiledExpr*> progs;
+	for (size_t ii = 0; ii < ads.size(); ++ii) {
+		progs.push_back(CompiledExpr::Compile(ads[ii]->Lookup(ATTR_REQUIREMENTS)));
+	}
+	return progs;
+}
+
+// evaluate the Requirements of ad as rightMatchesLeft and leftMatchesRight would
+static bool eval_compiled(MatchClassAd & match, ClassAd * ad, CompiledExpr * prog, Value & val)
+{
+	EvalState state;
+	state.SetScopes(&match);
+	state.curAd = ad;
+	state.depth_remaining--;
+	return prog->Evaluate(state, val);
+}
+
+static int check_values(MatchClassAd & match, vector<ClassAd*> & jobs, vector<CompiledExpr*> & job_progs,
+	vector<ClassAd*> & machines, vector<CompiledExpr*> & machine_progs, bool verbose)
+{
+	int mismatches = 0;
+	for (size_t jj = 0; jj < jobs.size(); ++jj) {
+		match.ReplaceLeftAd(jobs[jj]);
+		for (size_t mm = 0; mm < machines.size(); ++mm) {
+			match.ReplaceRightAd(machines[mm]);
+
+			Value tree_val, prog_val;
+			bool tree_ok, prog_ok;
+			for (int side = 0; side < 2; ++side) {
+				CompiledExpr * prog = side ? machine_progs[mm] : job_progs[jj];
+				if ( ! prog) continue;
+				tree_ok = match.EvaluateAttr(side ? "leftMatchesRight" : "rightMatchesLeft", tree_val);
+				prog_ok = eval_compiled(match, side ? machines[mm] : jobs[jj], prog, prog_val);
+				if (tree_ok != prog_ok || ! tree_val.SameAs(prog_val)) {
+					++mismatches;
+					if (verbose) {
+						ClassAdUnParser unp;
+						string expr, tv, pv;
+						unp.Unparse(expr, prog->GetTree());
+						unp.Unparse(tv, tree_val);
+						unp.Unparse(pv, prog_val);
+						fprintf(stdout, "MISMATCH job %d machine %d: %s\n\ttree %s, compiled %s\n",
+							(int)jj, (int)mm, expr.c_str(), tv.c_str(), pv.c_str());
+					}
+				}
+			}
+
+			match.SetLeftRequirements(NULL);
+			bool tree_match = match.symmetricMatch();
+			match.SetLeftRequirements(job_progs[jj]);
+			match.SetRightRequirements(machine_progs[mm]);
+			if (tree_match != match.symmetricMatch()) {
+				++mismatches;
+				if (verbose) {
+					fprintf(stdout, "MISMATCH job %d machine %d: symmetricMatch\n", (int)jj, (int)mm);
+				}
+			}
+			match.RemoveRightAd();
+		}
+		match.RemoveLeftAd();
+	}
+	return mismatches;
+}
+
+// compare the compiled and tree values of the Requirements of ad
+static int check_requirements(ClassAd * ad, CompiledExpr * prog, const char * what, bool verbose)
+{
+	Value tree_val, prog_val;
+	bool tree_ok = ad->EvaluateAttr(ATTR_REQUIREMENTS, tree_val);
+	bool prog_ok = prog->Evaluate(prog_val);
+	if (tree_ok != prog_ok || ! tree_val.SameAs(prog_val)) {
+		if (verbose) {
+			ClassAdUnParser unp;
+			string tv, pv;
+			unp.Unparse(tv, tree_val);
+			unp.Unparse(pv, prog_val);
+			fprintf(stdout, "MISMATCH after %s: tree %s, compiled %s\n", what, tv.c_str(), pv.c_str());
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// Requirements compiles the expressions of the attributes it refers to in the
+// same ad.  Check that those compiled forms stop being used once the ad is
+// changed, including when a freed expression or ad is replaced by a new one at
+// the same address, and when an attribute is taken out and put back the way
+// the negotiator overrides and restores attributes of the slot ads.
+static int check_invalidation(bool verbose)
+{
+	int mismatches = 0;
+	ClassAdParser parser;
+
+	ClassAd * ad = parser.ParseClassAd("[ Memory = 200; START = Memory > 100; Requirements = START && Memory > 0 ]");
+	if ( ! ad) { fprintf(stdout, "could not parse ad\n"); return 1; }
+
+	unsigned long long version = ad->GetVersion();
+	if ( ! version || version != ad->GetVersion() || ! ad->IsVersion(version) || ad->IsVersion(0)) {
+		fprintf(stdout, "MISMATCH: GetVersion is not stable\n");
+		++mismatches;
+	}
+
+	CompiledExpr * prog = CompiledExpr::Compile(ad->Lookup(ATTR_REQUIREMENTS));
+	if ( ! prog) { fprintf(stdout, "could not compile Requirements\n"); delete ad; return 1; }
+	mismatches += check_requirements(ad, prog, "compile", verbose);
+
+	// replace START.  The new expressions are not shared through the cache,
+	// so the allocator will usually hand back the memory of the old ones.
+	ad->Delete("START");
+	ad->Insert("START", parser.ParseExpression("Memory < 100"));
+	if (ad->IsVersion(version)) {
+		fprintf(stdout, "MISMATCH: version not changed by assignment\n");
+		++mismatches;
+	}
+	mismatches += check_requirements(ad, prog, "replacing START", verbose);
+
+	for (int ii = 0; ii < 10; ++ii) {
+		ad->Delete("START");
+		ad->Insert("START", parser.ParseExpression((ii & 1) ? "Memory > 100" : "Memory < 100"));
+		mismatches += check_requirements(ad, prog, "deleting and inserting START", verbose);
+	}
+	ad->AssignExpr("START", "Memory > 100");
+	mismatches += check_requirements(ad, prog, "assigning START", verbose);
+
+	// override and restore, as the negotiator does to the slot ads
+	ExprTree * saved = ad->Remove("START");
+	ad->Insert("START", parser.ParseExpression("false"));
+	mismatches += check_requirements(ad, prog, "overriding START", verbose);
+	ad->Insert("START", saved);
+	mismatches += check_requirements(ad, prog, "restoring START", verbose);
+
+	// changing the referring attribute itself must also be seen
+	version = ad->GetVersion();
+	ad->Assign("Memory", 50);
+	if (ad->IsVersion(version)) {
+		fprintf(stdout, "MISMATCH: version not changed by Assign\n");
+		++mismatches;
+	}
+	mismatches += check_requirements(ad, prog, "changing Memory", verbose);
+
+	delete prog;
+
+	// a new ad, likely at the same address as a deleted one, never shares its version
+	for (int ii = 0; ii < 10; ++ii) {
+		version = ad->GetVersion();
+		delete ad;
+		ad = parser.ParseClassAd((ii & 1)
+			? "[ Memory = 200; START = Memory > 100; Requirements = START && Memory > 0 ]"
+			: "[ Memory = 200; START = Memory < 100; Requirements = START && Memory > 0 ]");
+		if ( ! ad) { fprintf(stdout, "could not parse ad\n"); return mismatches + 1; }
+		if (ad->IsVersion(version) || ad->GetVersion() == version) {
+			fprintf(stdout, "MISMATCH: new ad has the version of a deleted one\n");
+			++mismatches;
+		}
+		prog = CompiledExpr::Compile(ad->Lookup(ATTR_REQUIREMENTS));
+		if (prog) {
+			mismatches += check_requirements(ad, prog, "making a new ad", verbose);
+			delete prog;
+		}
+	}
+
+	ClassAd copy(*ad);
+	if (copy.GetVersion() == ad->GetVersion()) {
+		fprintf(stdout, "MISMATCH: copied ad has the same version\n");
+		++mismatches;
+	}
+	delete ad;
+
+	return mismatches;
+}
+
+static long match_all(MatchClassAd & match, vector<ClassAd*> & jobs, vector<CompiledExpr*> * job_progs,
+	vector<ClassAd*> & machines, vector<CompiledExpr*> * machine_progs)
+{
+	long matches = 0;
+	for (size_t jj = 0; jj < jobs.size(); ++jj) {
+		match.ReplaceLeftAd(jobs[jj]);
+		if (job_progs) { match.SetLeftRequirements((*job_progs)[jj]); }
+		for (size_t mm = 0; mm < machines.size(); ++mm) {
+			match.ReplaceRightAd(machines[mm]);
+			if (machine_progs) { match.SetRightRequirements((*machine_progs)[mm]); }
+			if (match.symmetricMatch()) {
+				++matches;
+			}
+			match.RemoveRightAd();
+		}
+		match.RemoveLeftAd();
+	}
+	return matches;
+}
+
+int main(int argc, const char ** argv)
+{
+	const char * job_file = NULL;
+	const char * machine_file = NULL;
+	int num_jobs = 200;
+	int num_machines = 2000;
+	int iterations = 5;
+	bool optimize = false;
+	bool verbose = false;
+	bool old_semantics = true;
+
+	for (int ii = 1; ii < argc; ++ii) {
+		if (strcmp(argv[ii], "-jobs") == 0 && ii+1 < argc) {
+			job_file = argv[++ii];
+		} else if (strcmp(argv[ii], "-machines") == 0 && ii+1 < argc) {
+			machine_file = argv[++ii];
+		} else if (strcmp(argv[ii], "-num-jobs") == 0 && ii+1 < argc) {
+			num_jobs = atoi(argv[++ii]);
+		} else if (strcmp(argv[ii], "-num-machines") == 0 && ii+1 < argc) {
+			num_machines = atoi(argv[++ii]);
+		} else if (strcmp(argv[ii], "-n") == 0 && ii+1 < argc) {
+			iterations = atoi(argv[++ii]);
+		} else if (strcmp(argv[ii], "-optimize") == 0) {
+			optimize = true;
+		} else if (strcmp(argv[ii], "-strict") == 0) {
+			old_semantics = false;
+		} else if (strcmp(argv[ii], "-v") == 0) {
+			verbose = true;
+		} else {
+			fprintf(stderr, "usage: %s [-jobs <file>] [-machines <file>] [-num-jobs <n>] [-num-machines <n>]\n"
+				"\t[-n <iterations>] [-optimize] [-strict] [-v]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	SetOldClassAdSemantics(old_semantics);
+	srand(42);
+
+	vector<ClassAd*> jobs, machines;
+	if (job_file || machine_file) {
+		if ( ! job_file || ! machine_file) {
+			fprintf(stderr, "both -jobs and -machines are needed\n");
+			return 2;
+		}
+		if ( ! read_ads(job_file, jobs) || ! read_ads(machine_file, machines)) {
+			return 1;
+		}
+	} else {
+		make_ads(num_jobs, num_machines, jobs, machines);
+	}
+
+	if (optimize) {
+		// as the negotiator does
+		string error_msg;
+		for (size_t ii = 0; ii < jobs.size(); ++ii) {
+			MatchClassAd::OptimizeLeftAdForMatchmaking(jobs[ii], &error_msg);
+		}
+		for (size_t ii = 0; ii < machines.size(); ++ii) {
+			MatchClassAd::OptimizeRightAdForMatchmaking(machines[ii], &error_msg);
+		}
+	}
+
+	vector<CompiledExpr*> job_progs = compile_requirements(jobs);
+	vector<CompiledExpr*> machine_progs = compile_requirements(machines);
+
+	int instructions = 0, tree_calls = 0;
+	for (size_t ii = 0; ii < job_progs.size(); ++ii) {
+		int num = 0, calls = 0;
+		if (job_progs[ii]) { job_progs[ii]->GetStats(num, calls); }
+		instructions += num; tree_calls += calls;
+	}
+	for (size_t ii = 0; ii < machine_progs.size(); ++ii) {
+		int num = 0, calls = 0;
+		if (machine_progs[ii]) { machine_progs[ii]->GetStats(num, calls); }
+		instructions += num; tree_calls += calls;
+	}
+	fprintf(stdout, "%d jobs, %d machines, %d instructions, %d of them tree evaluations\n",
+		(int)jobs.size(), (int)machines.size(), instructions, tree_calls);
+
+	MatchClassAd match;
+
+	int mismatches = check_values(match, jobs, job_progs, machines, machine_progs, verbose);
+	fprintf(stdout, "Mismatches: %d\n", mismatches);
+
+	int invalidation_mismatches = check_invalidation(verbose);
+	fprintf(stdout, "Invalidation mismatches: %d\n", invalidation_mismatches);
+	mismatches += invalidation_mismatches;
+
+	long tree_matches = 0, compiled_matches = 0;
+	clock_t begin = clock();
+	for (int ii = 0; ii < iterations; ++ii) {
+		tree_matches = match_all(match, jobs, NULL, machines, NULL);
+	}
+	double tree_time = (1.0*(clock() - begin))/CLOCKS_PER_SEC;
+
+	begin = clock();
+	for (int ii = 0; ii < iterations; ++ii) {
+		compiled_matches = match_all(match, jobs, &job_progs, machines, &machine_progs);
+	}
+	double compiled_time = (1.0*(clock() - begin))/CLOCKS_PER_SEC;
+
+	fprintf(stdout, "tree Match Time: %.6f (%ld matches)\n", tree_time, tree_matches);
+	fprintf(stdout, "compiled Match Time: %.6f (%ld matches)\n", compiled_time, compiled_matches);
+	if (compiled_time > 0) {
+		fprintf(stdout, "Speedup: %.2f\n", tree_time / compiled_time);
+	}
+
+	for (size_t ii = 0; ii < job_progs.size(); ++ii) { delete job_progs[ii]; }
+	for (size_t ii = 0; ii < machine_progs.size(); ++ii) { delete machine_progs[ii]; }
+	for (size_t ii = 0; ii < jobs.size(); ++ii) { delete jobs[ii]; }
+	for (size_t ii = 0; ii < machines.size(); ++ii) { delete machines[ii]; }
+
+	return (mismatches || tree_matches != compiled_matches) ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Time constraint scans over a whole job queue, as condor_q and the schedd
+// do them.  The queue is read from a job_queue.log, or made up if no log is
+// given.  Build this with and without CLASSAD_FLAT_ATTRLIST to compare the
+// attribute containers.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <time.h>
+
+#include "classad/classad_distribution.h"
+
+using namespace std;
+using namespace classad;
+
+// the operations of the job_queue.log that change the queue, as in ClassAdLogEntry.h
+enum {
+	LogOp_NewClassAd = 101,
+	LogOp_DestroyClassAd = 102,
+	LogOp_SetAttribute = 103,
+	LogOp_DeleteAttribute = 104,
+};
+
+typedef map<string, ClassAd*> JobQueue;
+
+static const char * next_token(const char * p, string & tok)
+{
+	while (*p == ' ') ++p;
+	const char * start = p;
+	while (*p && *p != ' ') ++p;
+	tok.assign(start, p - start);
+	return p;
+}
+
+// apply the log to the queue.  transactions are applied as they are read,
+// which is good enough for a log that was written by a schedd that exited.
+static bool read_log(const char * filename, JobQueue & queue)
+{
+	FILE * fp = fopen(filename, "r");
+	if ( ! fp) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return false;
+	}
+
+	ClassAdParser parser;
+	parser.SetOldClassAd(true);
+	string key, name;
+	vector<char> line(1024*1024);
+	while (fgets(&line[0], (int)line.size(), fp)) {
+		size_t len = strlen(&line[0]);
+		while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) { line[--len] = 0; }
+		char * endp = NULL;
+		int op = (int)strtol(&line[0], &endp, 10);
+		const char * p = next_token(endp, key);
+		switch (op) {
+		case LogOp_NewClassAd:
+			if ( ! queue[key]) { queue[key] = new ClassAd(); }
+			break;
+		case LogOp_DestroyClassAd: {
+			JobQueue::iterator it = queue.find(key);
+			if (it != queue.end()) { delete it->second; queue.erase(it); }
+			break;
+		}
+		case LogOp_SetAttribute: {
+			p = next_token(p, name);
+			while (*p == ' ') ++p;
+			JobQueue::iterator it = queue.find(key);
+			ExprTree * tree = NULL;
+			if (it == queue.end() || ! parser.ParseExpression(p, tree, true) || ! tree) {
+				fprintf(stderr, "%s: could not apply: %s\n", filename, &line[0]);
+				break;
+			}
+			it->second->Insert(name, tree);
+			break;
+		}
+		case LogOp_DeleteAttribute: {
+			next_token(p, name);
+			JobQueue::iterator it = queue.find(key);
+			if (it != queue.end()) { it->second->Delete(name); }
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+static void make_queue(int num_jobs, JobQueue & queue)
+{
+	ClassAdParser parser;
+	char key[64], buf[8192];
+	const int procs = 10;
+	for (int cluster = 1; (cluster - 1) * procs < num_jobs; ++cluster) {
+		snprintf(buf, sizeof(buf),
+			"[ ClusterId = %d; Owner = \"user%d\"; User = \"user%d@cs.wisc.edu\"; QDate = %d;"
+			" Cmd = \"/home/user%d/bin/analyze\"; Iwd = \"/home/user%d/run%d\"; JobUniverse = 5;"
+			" Requirements = (TARGET.Arch == \"X86_64\") && (TARGET.OpSys == \"LINUX\") && (TARGET.Disk >= RequestDisk) && (TARGET.Memory >= RequestMemory);"
+			" Rank = 0.0; RequestCpus = %d; RequestMemory = %d; RequestDisk = %d; JobPrio = %d;"
+			" ShouldTransferFiles = \"YES\"; WhenToTransferOutput = \"ON_EXIT\"; TransferInput = \"data.in,params.txt\";"
+			" Environment = \"HOME=/home/user%d PATH=/usr/bin:/bin\"; NiceUser = false; WantRemoteIO = true;"
+			" LeaveJobInQueue = false; OnExitRemove = true; OnExitHold = false; PeriodicHold = false;"
+			" PeriodicRelease = false; PeriodicRemove = false; JobLeaseDuration = 2400; MaxHosts = 1; MinHosts = 1;"
+			" CoreSize = 0; KillSig = \"SIGTERM\"; Rank = 0.0; NumCkpts = 0; NumRestarts = 0; BufferSize = 524288;"
+			" BufferBlockSize = 32768; CommittedTime = 0; CommittedSlotTime = 0; CommittedSuspensionTime = 0;"
+			" CumulativeSuspensionTime = 0; ExecutableSize = 512; ImageSize = 1024; DiskUsage = 2048;"
+			" AccountingGroup = \"group_%s.user%d\"; TargetType = \"Machine\"; MyType = \"Job\" ]",
+			cluster, cluster % 50, cluster % 50, 1600000000 + cluster * 60,
+			cluster % 50, cluster % 50, cluster,
+			1 + cluster % 4, 512 * (1 + cluster % 16), 100000 * (1 + cluster % 10), cluster % 20,
+			cluster % 50, (cluster % 3) ? "physics" : "chemistry", cluster % 50);
+		ClassAd * cluster_ad = parser.ParseClassAd(buf, true);
+		snprintf(key, sizeof(key), "0%d.-1", cluster);
+		queue[key] = cluster_ad;
+
+		for (int proc = 0; proc < procs && (cluster - 1) * procs + proc < num_jobs; ++proc) {
+			int status = 1 + rand() % 5;
+			snprintf(buf, sizeof(buf),
+				"[ ClusterId = %d; ProcId = %d; JobStatus = %d; LastJobStatus = 1; EnteredCurrentStatus = %d;"
+				" Args = \"-seed %d -in data.in\"; Out = \"out.%d\"; Err = \"err.%d\"; UserLog = \"/home/user%d/run%d/log\";"
+				" RemoteWallClockTime = %d.0; CumulativeSlotTime = %d.0; NumJobStarts = %d; NumShadowStarts = %d;"
+				" ResidentSetSize = %d; MemoryUsage = ((ResidentSetSize + 1023) / 1024); JobCurrentStartDate = %d;"
+				" ExitBySignal = false; ExitCode = 0; %s %s GlobalJobId = \"submit.cs.wisc.edu#%d.%d#%d\" ]",
+				cluster, proc, status, 1600000000 + rand() % 100000,
+				rand(), proc, proc, cluster % 50, cluster,
+				rand() % 100000, rand() % 100000, status == 1 ? 0 : 1 + rand() % 3, status == 1 ? 0 : 1,
+				1000 * (rand() % 4000), 1600000000 + rand() % 100000,
+				status == 2 ? "RemoteHost = \"slot1@exec12.cs.wisc.edu\"; ShadowBday = 1600050000;" : "",
+				status == 5 ? "HoldReason = \"Error from slot1@exec3: Job has gone over memory limit\"; HoldReasonCode = 34;" : "",
+				cluster, proc, 1600000000 + cluster);
+			ClassAd * ad = parser.ParseClassAd(buf, true);
+			snprintf(key, sizeof(key), "%d.%d", cluster, proc);
+			queue[key] = ad;
+		}
+	}
+}
+
+// chain each job ad to its cluster ad, as the schedd does, and return the job ads
+static void chain_jobs(JobQueue & queue, vector<ClassAd*> & jobs)
+{
+	char key[64];
+	for (JobQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+		int cluster = 0, proc = 0;
+		if (sscanf(it->first.c_str(), "%d.%d", &cluster, &proc) != 2 || cluster <= 0 || proc < 0) {
+			continue;
+		}
+		snprintf(key, sizeof(key), "0%d.-1", cluster);
+		JobQueue::iterator parent = queue.find(key);
+		if (parent != queue.end()) {
+			it->second->ChainToAd(parent->second);
+		}
+		jobs.push_back(it->second);
+	}
+}
+
+static long resident_kb()
+{
+	long pages = 0, resident = 0;
+	FILE * fp = fopen("/proc/self/statm", "r");
+	if ( ! fp) return -1;
+	if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) { resident = -1; }
+	fclose(fp);
+	return resident < 0 ? -1 : resident * 4;
+}
+
+static const char * default_constraints[] = {
+	"JobStatus == 2",
+	"Owner == \"user7\"",
+	"JobStatus == 1 && RequestMemory > 4096",
+	"JobStatus == 5 && HoldReasonCode == 34",
+	"(NumJobStarts > 1 || JobPrio > 15) && AccountingGroup =!= undefined",
+	"MemoryUsage > RequestMemory",
+	"regexp(\"^/home/user1\", Iwd)",
+};
+
+int main(int argc, const char ** argv)
+{
+	const char * log_file = NULL;
+	int num_jobs = 100000;
+	int iterations = 5;
+	vector<string> constraints;
+
+	for (int ii = 1; ii < argc; ++ii) {
+		if (strcmp(argv[ii], "-log") == 0 && ii+1 < argc) {
+			log_file = argv[++ii];
+		} else if (strcmp(argv[ii], "-num-jobs") == 0 && ii+1 < argc) {
+			num_jobs = atoi(argv[++ii]);
+		} else if (strcmp(argv[ii], "-n") == 0 && ii+1 < argc) {
+			iterations = atoi(argv[++ii]);
+		} else if (strcmp(argv[ii], "-constraint") == 0 && ii+1 < argc) {
+			constraints.push_back(argv[++ii]);
+		} else {
+			fprintf(stderr, "usage: %s [-log <job_queue.log>] [-num-jobs <n>] [-n <iterations>] [-constraint <expr>]...\n", argv[0]);
+			return 2;
+		}
+	}
+	if (constraints.empty()) {
+		constraints.assign(default_constraints, default_constraints + sizeof(default_constraints)/sizeof(default_constraints[0]));
+	}
+
+	SetOldClassAdSemantics(true);
+	srand(42);
+
+#ifdef CLASSAD_FLAT_ATTRLIST
+	fprintf(stdout, "attribute storage: flat\n");
+#else
+	fprintf(stdout, "attribute storage: unordered_map\n");
+#endif
+
+	long rss_before = resident_kb();
+	JobQueue queue;
+	clock_t begin = clock();
+	if (log_file) {
+		if ( ! read_log(log_file, queue)) {
+			return 1;
+		}
+	} else {
+		make_queue(num_jobs, queue);
+	}
+	double load_time = (1.0*(clock() - begin))/CLOCKS_PER_SEC;
+	long rss_after = resident_kb();
+
+	vector<ClassAd*> jobs;
+	chain_jobs(queue, jobs);
+	long attributes = 0;
+	for (JobQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+		attributes += it->second->size();
+	}
+	fprintf(stdout, "%d ads, %d jobs, %ld attributes, loaded in %.3f sec",
+		(int)queue.size(), (int)jobs.size(), attributes, load_time);
+	if (rss_before >= 0 && rss_after >= 0) {
+		fprintf(stdout, ", %ld KB resident", rss_after - rss_before);
+	}
+	fprintf(stdout, "\n");
+
+	ClassAdParser parser;
+	parser.SetOldClassAd(true);
+	double total_time = 0;
+	for (size_t cc = 0; cc < constraints.size(); ++cc) {
+		ExprTree * constraint = parser.ParseExpression(constraints[cc]);
+		if ( ! constraint) {
+			fprintf(stderr, "could not parse constraint: %s\n", constraints[cc].c_str());
+			return 1;
+		}
+		long matches = 0;
+		begin = clock();
+		for (int ii = 0; ii < iterations; ++ii) {
+			matches = 0;
+			for (size_t jj = 0; jj < jobs.size(); ++jj) {
+				Value val;
+				bool result = false;
+				if (jobs[jj]->EvaluateExpr(constraint, val) && val.IsBooleanValueEquiv(result) && result) {
+					++matches;
+				}
+			}
+		}
+		double scan_time = (1.0*(clock() - begin))/CLOCKS_PER_SEC;
+		total_time += scan_time;
+		fprintf(stdout, "%8ld matches %9.3f usec/job  %s\n", matches,
+			jobs.empty() ? 0.0 : 1e6 * scan_time / iterations / jobs.size(), constraints[cc].c_str());
+		delete constraint;
+	}
+	fprintf(stdout, "Scan Time: %.6f\n", total_time);
+
+	for (JobQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+		it->second->Unchain();
+	}
+	for (JobQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+		delete it->second;
+	}
+	return 0;
+}
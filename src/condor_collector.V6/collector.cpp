@@ -114,6 +114,7 @@ int CollectorDaemon::max_pending_query_workers = 50;
 int CollectorDaemon::max_query_worktime = 0;
 int CollectorDaemon::active_query_workers = 0;
 int CollectorDaemon::pending_query_workers = 0;
+std::map<int, double> CollectorDaemon::query_worker_start_times;
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 bool CollectorDaemon::want_track_queries_by_subsys = false;
@@ -396,6 +397,8 @@ void CollectorDaemon::Init()
 		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
 	daemonCore->Register_CommandWithPayload(MERGE_STARTD_AD,"MERGE_STARTD_AD",
 		receive_update,"receive_update",NEGOTIATOR);
+	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD_DELTA,"UPDATE_STARTD_AD_DELTA",
+		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
 	daemonCore->Register_CommandWithPayload(UPDATE_SCHEDD_AD,"UPDATE_SCHEDD_AD",
 		receive_update,"receive_update",ADVERTISE_SCHEDD_PERM);
 	daemonCore->Register_CommandWithPayload(UPDATE_SUBMITTOR_AD,"UPDATE_SUBMITTOR_AD",
@@ -531,6 +534,10 @@ int CollectorDaemon::receive_query_cedar(int command,
 	// Initial query handler
 	whichAds = receive_query_public( command );
 
+	// Count secondary index use here rather than in process_query_public, because
+	// the query may be handled by a forked worker whose statistics are thrown away.
+	collector.accountQueryIndex( whichAds, cad->LookupExpr( ATTR_REQUIREMENTS ) );
+
 	is_locate = cad->Lookup(ATTR_LOCATION_QUERY) != NULL;
 	if (is_locate) { rt.runtime = &HandleLocate_runtime; }
 
@@ -586,6 +593,7 @@ int CollectorDaemon::receive_query_cedar(int command,
 	query_entry->subsys[0] = 0;
 	query_entry->sock = sock;
 	query_entry->whichAds = whichAds;
+	query_entry->enqueue_time = 0;
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	if ( want_track_queries_by_subsys ) {
@@ -656,6 +664,7 @@ int CollectorDaemon::receive_query_cedar(int command,
 			  (active_query_workers - reserved_for_highprio_query_workers + (int)query_queue_high_prio.size() <  max_query_workers + max_pending_query_workers))
 		   )
 		{
+			query_entry->enqueue_time = condor_gettimestamp_double();
 			if ( high_prio_query ) {
 				query_queue_high_prio.push( query_entry );
 			} else {
@@ -716,6 +725,12 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 			active_query_workers--;
 		}
 		collectorStats.global.ActiveQueryWorkers = active_query_workers;
+
+		std::map<int, double>::iterator started = query_worker_start_times.find(pid);
+		if (started != query_worker_start_times.end()) {
+			collectorStats.global.QueryWorkerTime += condor_gettimestamp_double() - started->second;
+			query_worker_start_times.erase(started);
+		}
 	}
 
 	// Grab a queue_entry to service, ignoring "stale" (old) entries.
@@ -745,6 +760,8 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 		// recently added into the queue, or recently removed from the queue.
 		pending_query_workers = query_queue_high_prio.size() + query_queue_low_prio.size();
 		collectorStats.global.PendingQueries = pending_query_workers;
+		collectorStats.global.PendingQueriesHighPrio = (int)query_queue_high_prio.size();
+		collectorStats.global.PendingQueriesLowPrio = (int)query_queue_low_prio.size();
 
 		// If query_entry==NULL, we are not forking anything now, so we're done for now
 		if ( query_entry == NULL ) {
@@ -799,6 +816,8 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 	Stream *sock = query_entry->sock;
 	query_entry->sock = NULL;
 	ClassAd *query_classad = query_entry->cad;
+	double fork_time = condor_gettimestamp_double();
+	double wait_time = fork_time - query_entry->enqueue_time;
 	int tid = daemonCore->
 		Create_Thread((ThreadStartFunc)&CollectorDaemon::receive_query_cedar_worker_thread,
 		    (void *)query_entry, sock, ReaperId);
@@ -817,6 +836,15 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 	active_query_workers++;
 	collectorStats.global.ActiveQueryWorkers = active_query_workers;
 
+	// Record how long the query waited for a worker, and remember when the worker
+	// started so the reaper can record how long it took to answer the query.
+	if (high_prio_query) {
+		collectorStats.global.QueryWaitTimeHighPrio += wait_time;
+	} else {
+		collectorStats.global.QueryWaitTimeLowPrio += wait_time;
+	}
+	query_worker_start_times[tid] = fork_time;
+
 	// Also close query_entry->sock since DaemonCore
 	// will have cloned this socket for the child, and we have no need to write anything
 	// out here in the parent once the child finishes.
@@ -934,7 +962,13 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 			}
 		}
 
-		bool send_failed = (!sock->code(more) || !putClassAd(sock, *curr_ad, filter_private_ads ? PUT_CLASSAD_NO_PRIVATE : 0, proj.empty() ? NULL : &proj));
+		// send the ad from the wire form cached when it was last updated, if we have one.
+		// the stats ad is made for this query, so never has a cached form.
+		int put_opts = filter_private_ads ? PUT_CLASSAD_NO_PRIVATE : 0;
+		const SerializedClassAd * wire = stats_ad ? NULL : collector.serializedAd(curr_ad);
+		bool send_failed = !sock->code(more) ||
+			(wire ? !putClassAd(sock, *curr_ad, *wire, put_opts, proj.empty() ? NULL : &proj)
+			      : !putClassAd(sock, *curr_ad, put_opts, proj.empty() ? NULL : &proj));
         
 		if (stats_ad) {
 			stats_ad->Unchain();
@@ -1273,6 +1307,14 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 			// which already does all the necessary logging.
 		}
 
+		if (command == UPDATE_STARTD_AD_DELTA && insert == 0 &&
+			sock->type() == Stream::reli_sock)
+		{
+			// A delta we don't have the base for was still read in full,
+			// so keep the connection for the full update that follows it.
+			return stashSocket( (ReliSock *)sock );
+		}
+
 		return FALSE;
 
 	}
@@ -1280,6 +1322,12 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 	CollectorEngine_ru_collect_runtime += rt.tick(rt_last);
 #endif
 
+	// a delta update has been merged into the stored ad, so from here
+	// on treat it as a full update of that ad.
+	if (command == UPDATE_STARTD_AD_DELTA) {
+		command = UPDATE_STARTD_AD;
+	}
+
 	/* let the off-line plug-in have at it */
 	offline_plugin_.update ( command, *cad );
 
@@ -1574,7 +1622,7 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		}
 	}
 
-	if (!collector.walkHashTable (whichAds, query_scanFunc))
+	if (!collector.walkHashTable (whichAds, query_scanFunc, __filter__))
 	{
 		dprintf (D_ALWAYS, "Error sending query response\n");
 	}
@@ -1615,6 +1663,7 @@ int CollectorDaemon::setAttrLastHeardFrom (ClassAd* cad, unsigned long time)
 		 result.IsBooleanValueEquiv(val) && val ) {
 
 		cad->Assign( ATTR_LAST_HEARD_FROM, time );
+		collector.adModified( cad );
         __numAds__++;
     }
 
@@ -1864,6 +1913,8 @@ void CollectorDaemon::Config()
     // set the appropriate parameters in the collector engine
     collector.setClientTimeout( ClientTimeout );
     collector.scheduleHousekeeper( ClassadLifetime );
+    collector.configureIndexes();
+    collector.configureSerializedAds();
 
     offline_plugin_.configure ();
 
@@ -2102,6 +2153,7 @@ void CollectorDaemon::sendCollectorAd()
 	selfAd->Delete(ATTR_UPDATESTATS_HISTORY);
 	selfAd->Delete(ATTR_UPDATESTATS_SEQUENCED);
 	collectorStats.publishGlobal(selfAd, NULL);
+	collector.adModified(selfAd);
 
 	// Send the ad
 	int num_updated = collectorsToUpdate->sendUpdates(UPDATE_COLLECTOR_AD, ad, NULL, false);
@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <queue>
+#include <map>
 
 #include "condor_classad.h"
 #include "totals.h"
@@ -153,6 +154,7 @@ public:
 		AdTypes whichAds;
 		bool is_locate;
 		char subsys[15];
+		double enqueue_time; // when the query was put into the pending queue
 	} pending_query_entry_t;
 
 	static std::queue<pending_query_entry_t *> query_queue_high_prio;
@@ -165,6 +167,7 @@ public:
 	static int reserved_for_highprio_query_workers; // from config file
 	static int active_query_workers;
 	static int pending_query_workers;
+	static std::map<int, double> query_worker_start_times; // fork time of active workers, by pid
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	static bool want_track_queries_by_subsys;
@@ -38,7 +38,6 @@ extern "C" void event_mgr (void);
 
 static void killHashTable (CollectorHashTable &);
 static int killGenericHashTable(CollectorHashTable *);
-static void purgeHashTable (CollectorHashTable &);
 
 int 	engine_clientTimeoutHandler (Service *);
 int 	engine_housekeepingHandler  (Service *);
@@ -65,6 +64,7 @@ CollectorEngine::CollectorEngine (CollectorStats *stats ) :
 	machineUpdateInterval = 30;
 	m_forwardInterval = machineUpdateInterval / 3;
 	m_forwardFilteringEnabled = false;
+	m_cacheSerializedAds = false;
 	housekeeperTimerID = -1;
 
 	m_allowOnlyOneNegotiator = param_boolean("COLLECTOR_ALLOW_ONLY_ONE_NEGOTIATOR", false);
@@ -235,6 +235,7 @@ CollectorEngine::invalidateAds(AdTypes adType, ClassAd &query)
 				dprintf(D_ALWAYS,
 						"\t\t**** Invalidating ad: \"%s\"\n",
 						hkString.Value());
+				adRemoved(*table, ad);
 				delete ad;
 				count++;
 			}
@@ -310,6 +311,181 @@ walkHashTable (AdTypes adType, int (*scanFunction)(ClassAd *))
 	return 1;
 }
 
+int CollectorEngine::
+walkHashTable (AdTypes adType, int (*scanFunction)(ClassAd *), classad::ExprTree *filter)
+{
+	CollectorHashTable *table;
+	CollectorEngine::HashFunc func;
+	CollectorAdIndex *index = NULL;
+	if (LookupByAdType(adType, table, func)) {
+		index = findIndex(*table);
+	}
+
+	CollectorIndexPredicate pred;
+	size_t num_candidates = 0;
+	if ( ! index || ! index->plan(filter, pred, num_candidates)) {
+		return walkHashTable(adType, scanFunction);
+	}
+
+	std::vector<ClassAd*> candidates;
+	candidates.reserve(num_candidates);
+	index->candidates(pred, candidates);
+	dprintf(D_FULLDEBUG, "Using %s index to scan %d of %d ads\n",
+		pred.attr.c_str(), (int)candidates.size(), table->getNumElements());
+
+	for (size_t ix = 0; ix < candidates.size(); ++ix) {
+		if ( ! scanFunction(candidates[ix])) {
+			break;
+		}
+	}
+
+	return 1;
+}
+
+void CollectorEngine::
+accountQueryIndex (AdTypes adType, classad::ExprTree *filter)
+{
+	CollectorHashTable *table;
+	CollectorEngine::HashFunc func;
+	if ( ! collectorStats || ! LookupByAdType(adType, table, func)) {
+		return;
+	}
+	CollectorAdIndex *index = findIndex(*table);
+	if ( ! index) {
+		return;
+	}
+
+	CollectorIndexPredicate pred;
+	size_t num_candidates = 0;
+	if (index->plan(filter, pred, num_candidates)) {
+		collectorStats->global.IndexedQueries += 1;
+		collectorStats->global.IndexCandidateAds += (long)num_candidates;
+		size_t num_ads = (size_t)table->getNumElements();
+		if (num_ads > num_candidates) {
+			collectorStats->global.IndexSkippedAds += (long)(num_ads - num_candidates);
+		}
+	} else {
+		collectorStats->global.UnindexedQueries += 1;
+	}
+}
+
+CollectorAdIndex * CollectorEngine::
+findIndex (const CollectorHashTable &table)
+{
+	if (m_indexes.empty()) {
+		return NULL;
+	}
+	auto it = m_indexes.find(&table);
+	if (it == m_indexes.end()) {
+		return NULL;
+	}
+	return &it->second;
+}
+
+void CollectorEngine::
+adModified (ClassAd *ad)
+{
+	for (auto it = m_indexes.begin(); it != m_indexes.end(); ++it) {
+		if (it->second.contains(ad)) {
+			it->second.insert(ad);
+		}
+	}
+	auto wire = m_serialized.find(ad);
+	if (wire != m_serialized.end()) {
+		wire->second.serialize(*ad);
+	}
+}
+
+void CollectorEngine::
+configureIndexes ()
+{
+	static const AdTypes indexable[] = {
+		STARTD_AD, STARTD_PVT_AD, SCHEDD_AD, SUBMITTOR_AD, LICENSE_AD, MASTER_AD,
+		CKPT_SRVR_AD, COLLECTOR_AD, STORAGE_AD, ACCOUNTING_AD, NEGOTIATOR_AD, HAD_AD, GRID_AD,
+	};
+
+	for (size_t ix = 0; ix < COUNTOF(indexable); ++ix) {
+		AdTypes adType = indexable[ix];
+		CollectorHashTable *table;
+		CollectorEngine::HashFunc func;
+		if ( ! LookupByAdType(adType, table, func)) {
+			continue;
+		}
+
+		std::string knob("COLLECTOR_INDEX_ATTRS_");
+		knob += AdTypeToString(adType);
+		classad::References attrs;
+		auto_free_ptr value(param(knob.c_str()));
+		if (value) {
+			StringTokenIterator list(value.ptr());
+			const std::string * attr;
+			while ((attr = list.next_string())) { attrs.insert(*attr); }
+		}
+
+		if (attrs.empty()) {
+			if (m_indexes.erase(table)) {
+				dprintf(D_ALWAYS, "Removed secondary indexes for %s ads\n", AdTypeToString(adType));
+			}
+			continue;
+		}
+
+		CollectorAdIndex &index = m_indexes[table];
+		if (index.configure(attrs)) {
+			std::string attrlist;
+			for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+				if ( ! attrlist.empty()) attrlist += ",";
+				attrlist += *it;
+			}
+			dprintf(D_ALWAYS, "Indexing %s ads on %s\n", AdTypeToString(adType), attrlist.c_str());
+
+			ClassAd *ad;
+			table->startIterations();
+			while (table->iterate(ad)) {
+				index.insert(ad);
+			}
+		}
+	}
+}
+
+
+void CollectorEngine::
+configureSerializedAds ()
+{
+	bool enable = param_boolean("COLLECTOR_CACHE_SERIALIZED_ADS", false);
+	if (enable == m_cacheSerializedAds) {
+		return;
+	}
+	m_cacheSerializedAds = enable;
+	m_serialized.clear();
+	if ( ! enable) {
+		dprintf(D_ALWAYS, "Not caching serialized ads\n");
+		return;
+	}
+
+	std::vector<CollectorHashTable *> tables = {
+		&StartdAds, &StartdPrivateAds, &ScheddAds, &SubmittorAds, &LicenseAds, &MasterAds,
+		&StorageAds, &AccountingAds, &CkptServerAds, &GatewayAds, &CollectorAds,
+		&NegotiatorAds, &HadAds, &GridAds,
+	};
+	CollectorHashTable *cht;
+	GenericAds.startIterations();
+	while (GenericAds.iterate(cht)) {
+		tables.push_back(cht);
+	}
+
+	size_t bytes = 0;
+	for (size_t ix = 0; ix < tables.size(); ++ix) {
+		ClassAd *ad;
+		tables[ix]->startIterations();
+		while (tables[ix]->iterate(ad)) {
+			SerializedClassAd &wire = m_serialized[ad];
+			wire.serialize(*ad);
+			bytes += wire.bytes();
+		}
+	}
+	dprintf(D_ALWAYS, "Caching serialized ads, %d ads using %lld bytes\n",
+		(int)m_serialized.size(), (long long)bytes);
+}
 
 CollectorHashTable *CollectorEngine::findOrCreateTable(MyString &type)
 {
@@ -431,6 +607,7 @@ bool CollectorEngine::ValidateClassAd(int command,ClassAd *clientAd,Sock *sock)
 	  case MERGE_STARTD_AD:
 	  case UPDATE_STARTD_AD:
 	  case UPDATE_STARTD_AD_WITH_ACK:
+	  case UPDATE_STARTD_AD_DELTA:
 		  ipattr = ATTR_STARTD_IP_ADDR;
 		  break;
 	  case UPDATE_OWN_SUBMITTOR_AD:
@@ -686,6 +863,27 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 							  clientAd, hk, hashString, insert, from );
 		break;
 
+	  case UPDATE_STARTD_AD_DELTA:
+		if (!makeStartdAdHashKey (hk, clientAd))
+		{
+			dprintf (D_ALWAYS, "Could not make hashkey --- ignoring ad\n");
+			insert = -3;
+			retVal = 0;
+			break;
+		}
+		hashString.Build( hk );
+		retVal=mergeClassAd (StartdAds, "StartdAd     ", "Start",
+							  clientAd, hk, hashString, insert, from, true );
+
+		// a delta update carries no private ad, but it means the startd
+		// is still alive, so keep its private ad from expiring before the
+		// public one.
+		if (retVal && StartdPrivateAds.lookup(hk, pvtAd) == 0) {
+			pvtAd->Assign(ATTR_LAST_HEARD_FROM, (int)time(NULL));
+			adModified(pvtAd);
+		}
+		break;
+
 	  case UPDATE_SCHEDD_AD:
 		if (!makeScheddAdHashKey (hk, clientAd))
 		{
@@ -957,6 +1155,7 @@ int CollectorEngine::remove (AdTypes t_AddType, const ClassAd & c_query, bool *q
 				hk.sprint( hkString );
 				iRet = !table->remove(hk);
 				dprintf (D_ALWAYS,"\t\t**** Removed(%d) ad(s): \"%s\"\n", iRet, hkString.Value() );
+				adRemoved(*table, pAd);
 				delete pAd;
 			}
 		}
@@ -981,6 +1180,7 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
                 cAd->Assign( ATTR_LAST_HEARD_FROM, 1 );
                 
                 if( CollectorDaemon::offline_plugin_.expire( * cAd ) == true ) {
+                    adInserted( * hTable, cAd );
                     return rVal;
                 }
                 
@@ -995,6 +1195,7 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
                 hKey.sprint( hkString );                
                 dprintf( D_ALWAYS, "\t\t**** Removed(%d) stale ad(s): \"%s\"\n", rVal, hkString.Value() );
 
+                adRemoved( * hTable, cAd );
                 delete cAd;
             }
         }
@@ -1011,6 +1212,10 @@ remove (AdTypes adType, AdNameHashKey &hk)
 	if (!LookupByAdType(adType, table, func)) {
 		return 0;
 	}
+	ClassAd *ad = NULL;
+	if (table->lookup(hk, ad) != -1) {
+		adRemoved(*table, ad);
+	}
 	return !table->remove(hk);
 }
 
@@ -1075,6 +1280,8 @@ updateClassAd (CollectorHashTable &hashTable,
 			new_ad->Assign( ATTR_LAST_FORWARDED, (int)time(NULL) );
 		}
 
+		adInserted(hashTable, new_ad);
+
 		return new_ad;
 	}
 	else
@@ -1124,6 +1331,9 @@ updateClassAd (CollectorHashTable &hashTable,
 
 		if (isSelfAd(old_ad)) { __self_ad__ = new_ad; }
 
+		adRemoved(hashTable, old_ad);
+		adInserted(hashTable, new_ad);
+
 		delete old_ad;
 
 		insert = 0;
@@ -1134,12 +1344,13 @@ updateClassAd (CollectorHashTable &hashTable,
 ClassAd * CollectorEngine::
 mergeClassAd (CollectorHashTable &hashTable,
 			   const char *adType,
-			   const char * /*label*/,
+			   const char * label,
 			   ClassAd *new_ad,
 			   AdNameHashKey &hk,
 			   const MyString &hashString,
 			   int  &insert,
-			   const condor_sockaddr& /*from*/ )
+			   const condor_sockaddr& /*from*/,
+			   bool delta_update )
 {
 	ClassAd		*old_ad = NULL;
 
@@ -1150,15 +1361,45 @@ mergeClassAd (CollectorHashTable &hashTable,
     {	 	
 		dprintf (D_ALWAYS, "%s: Failed to merge update for ** \"%s\" because "
 				 "no existing ad matches.\n", adType, hashString.Value() );
+		if (delta_update && collectorStats) {
+			collectorStats->global.DeltaUpdatesRejected += 1;
+		}
 			// We should _NOT_ delete new_ad if we return NULL
 			// because our caller will delete it in that case.
 		return NULL;
 	}
 	else
     {
-		// yes ... old ad must be updated
-		dprintf (D_FULLDEBUG, "%s: Merging update for ... \"%s\"\n",
-				 adType, hashString.Value() );
+		if (delta_update) {
+			// A delta update only contains the attributes that changed since the
+			// previous update, so it can only be applied if we have that update.
+			long long new_seq = 0, old_seq = 0, new_stime = 0, old_stime = 0;
+			if ( ! new_ad->LookupInteger(ATTR_UPDATE_SEQUENCE_NUMBER, new_seq) ||
+				 ! old_ad->LookupInteger(ATTR_UPDATE_SEQUENCE_NUMBER, old_seq) ||
+				 ! new_ad->LookupInteger(ATTR_DAEMON_START_TIME, new_stime) ||
+				 ! old_ad->LookupInteger(ATTR_DAEMON_START_TIME, old_stime) ||
+				 new_stime != old_stime || new_seq != old_seq + 1)
+			{
+				dprintf (D_ALWAYS, "%s: Ignoring delta update for \"%s\" because it is "
+						 "sequence %lld but the last update was %lld, waiting for a full update.\n",
+						 adType, hashString.Value(), new_seq, old_seq );
+				if (collectorStats) {
+					collectorStats->global.DeltaUpdatesRejected += 1;
+				}
+				return NULL;
+			}
+
+			dprintf (D_FULLDEBUG, "%s: Applying delta update for ... \"%s\"\n",
+					 adType, hashString.Value() );
+			if (collectorStats) {
+				collectorStats->update( label, old_ad, new_ad );
+				collectorStats->global.DeltaUpdates += 1;
+			}
+		} else {
+			// yes ... old ad must be updated
+			dprintf (D_FULLDEBUG, "%s: Merging update for ... \"%s\"\n",
+					 adType, hashString.Value() );
+		}
 
 			// Do not allow changes to some attributes
 		ClassAd new_ad_copy(*new_ad);
@@ -1168,6 +1409,14 @@ mergeClassAd (CollectorHashTable &hashTable,
 
 		// Now, finally, merge the new ClassAd into the old one
 		MergeClassAds(old_ad,&new_ad_copy,true);
+
+		// an update from the daemon itself means that we have heard from it
+		if (delta_update) {
+			old_ad->Assign(ATTR_LAST_HEARD_FROM, (int)time(NULL));
+		}
+
+		// the merge may have changed indexed attributes
+		adInserted(hashTable, old_ad);
 	}
 	delete new_ad;
 	return old_ad;
@@ -1243,7 +1492,7 @@ housekeeper()
 }
 
 void CollectorEngine::
-cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) const
+cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey)
 {
 	ClassAd  *ad;
 	int   	 timeStamp;
@@ -1285,6 +1534,8 @@ cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) con
 				   so then this ad should NOT be deleted. */
 				if ( CollectorDaemon::offline_plugin_.expire( *ad ) == true ) {
 					// plugin say to not delete this ad, so continue
+					// but the plugin may have changed indexed attributes
+					adInserted(hashTable, ad);
 					continue;
 				} else {
 					dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
@@ -1294,6 +1545,7 @@ cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) con
 			{
 				dprintf (D_ALWAYS, "\t\tError while removing ad\n");
 			}
+			adRemoved(hashTable, ad);
 			delete ad;
 		}
 	}
@@ -1367,7 +1619,7 @@ CollectorEngine::LookupByAdType(AdTypes adType,
 }
 
 
-static void
+void CollectorEngine::
 purgeHashTable( CollectorHashTable &table )
 {
 	ClassAd* ad;
@@ -1377,6 +1629,7 @@ purgeHashTable( CollectorHashTable &table )
 		if( table.remove(hk) == -1 ) {
 			dprintf( D_ALWAYS, "\t\tError while removing ad\n" );
 		}		
+		adRemoved(table, ad);
 		delete ad;
 	}
 }
@@ -23,6 +23,7 @@
 #include "condor_classad.h"
 
 #include "collector_stats.h"
+#include "collector_index.h"
 #include "hashkey.h"
 
 class CollectorEngine : public Service
@@ -70,6 +71,30 @@ class CollectorEngine : public Service
 	// walk specified hash table with the given visit procedure
 	int walkHashTable (AdTypes, int (*)(ClassAd *));
 
+	// as above, but if the table has secondary indexes and the filter has an
+	// indexed conjunct, visit only the ads that the index says might match
+	int walkHashTable (AdTypes, int (*)(ClassAd *), classad::ExprTree *filter);
+
+	// (re)read the COLLECTOR_INDEX_ATTRS_<type> knobs and rebuild indexes that changed
+	void configureIndexes();
+
+	// update the secondary indexes and serialized form of an ad that was modified in place
+	void adModified(ClassAd *ad);
+
+	// (re)read COLLECTOR_CACHE_SERIALIZED_ADS and populate or drop the serialized ad cache
+	void configureSerializedAds();
+
+	// the ad as it would be sent by putClassAd, or NULL if it is not cached.
+	const SerializedClassAd * serializedAd(const ClassAd *ad) const {
+		if (m_serialized.empty()) return NULL;
+		auto it = m_serialized.find(ad);
+		return (it == m_serialized.end() || it->second.empty()) ? NULL : &it->second;
+	}
+
+	// record in the collector statistics whether a query on the given table
+	// could be answered from a secondary index.
+	void accountQueryIndex(AdTypes, classad::ExprTree *filter);
+
 	// Walk through a specific (non-generic, non-ANY) table using a lambda
 	template<typename T>
 	int walkConcreteTable(AdTypes adType, T scanFunction) {
@@ -154,7 +179,7 @@ class CollectorEngine : public Service
 
 	void  housekeeper ();
 	int  housekeeperTimerID;
-	void cleanHashTable (CollectorHashTable &, time_t, HashFunc) const;
+	void cleanHashTable (CollectorHashTable &, time_t, HashFunc);
 	ClassAd* updateClassAd(CollectorHashTable&,const char*, const char *,
 						   ClassAd*,AdNameHashKey&, const MyString &, int &, 
 						   const condor_sockaddr& );
@@ -166,11 +191,29 @@ class CollectorEngine : public Service
 							AdNameHashKey &hk,
 							const MyString &hashString,
 							int  &insert,
-							const condor_sockaddr& /*from*/ );
+							const condor_sockaddr& /*from*/,
+							bool delta_update = false );
 
 	// support for dynamically created tables
 	CollectorHashTable *findOrCreateTable(MyString &str);
 
+	// secondary attribute indexes, only tables with configured indexes have an entry
+	std::map<const CollectorHashTable *, CollectorAdIndex> m_indexes;
+	CollectorAdIndex * findIndex(const CollectorHashTable &table);
+	void adInserted(const CollectorHashTable &table, ClassAd *ad) {
+		CollectorAdIndex *index = findIndex(table); if (index) index->insert(ad);
+		if (m_cacheSerializedAds) m_serialized[ad].serialize(*ad);
+	}
+	void adRemoved(const CollectorHashTable &table, ClassAd *ad) {
+		CollectorAdIndex *index = findIndex(table); if (index) index->remove(ad);
+		if ( ! m_serialized.empty()) m_serialized.erase(ad);
+	}
+	void purgeHashTable (CollectorHashTable &);
+
+	// wire form of each ad in the tables, so that queries don't have to unparse them
+	bool m_cacheSerializedAds;
+	std::map<const ClassAd *, SerializedClassAd> m_serialized;
+
 	bool ValidateClassAd(int command,ClassAd *clientAd,Sock *sock);
 
 	void* __self_ad__; // contains address of last Ad for this collector added to the hashtable, do NOT free from here
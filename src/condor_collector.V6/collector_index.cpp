@@ -0,0 +1,315 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_classad.h"
+#include "condor_debug.h"
+#include "compat_classad_util.h"
+
+#include "collector_index.h"
+
+void
+CollectorAttrIndex::insert(ClassAd *ad, const std::string &attr)
+{
+	remove(ad);
+
+	classad::ExprTree *expr = ad->LookupExpr(attr);
+	if ( ! expr) {
+		return;
+	}
+
+	Key key;
+	classad::Value val;
+	std::string sval;
+	double rval;
+	if (ExprTreeIsLiteral(expr, val)) {
+		if (val.IsStringValue(sval)) {
+			key.kind = Key::STRING;
+			key.sit = m_strings.insert(StringMap::value_type(sval, AdSet())).first;
+			key.sit->second.insert(ad);
+		} else if (val.IsNumber(rval)) {
+			// IsNumber also converts booleans, which is what the comparison operators do
+			key.kind = Key::NUMBER;
+			key.nit = m_numbers.insert(NumberMap::value_type(rval, AdSet())).first;
+			key.nit->second.insert(ad);
+		} else {
+			// undefined, error, lists and nested ads never compare equal to
+			// (or less than) a string or number, so they need not be indexed.
+			return;
+		}
+	} else {
+		key.kind = Key::EXPR;
+		m_exprs.insert(ad);
+	}
+	m_keys[ad] = key;
+}
+
+void
+CollectorAttrIndex::remove(ClassAd *ad)
+{
+	std::map<ClassAd*, Key>::iterator it = m_keys.find(ad);
+	if (it == m_keys.end()) {
+		return;
+	}
+
+	Key &key = it->second;
+	switch (key.kind) {
+	case Key::STRING:
+		key.sit->second.erase(ad);
+		if (key.sit->second.empty()) { m_strings.erase(key.sit); }
+		break;
+	case Key::NUMBER:
+		key.nit->second.erase(ad);
+		if (key.nit->second.empty()) { m_numbers.erase(key.nit); }
+		break;
+	case Key::EXPR:
+		m_exprs.erase(ad);
+		break;
+	}
+	m_keys.erase(it);
+}
+
+void
+CollectorAttrIndex::clear()
+{
+	m_strings.clear();
+	m_numbers.clear();
+	m_exprs.clear();
+	m_keys.clear();
+}
+
+size_t
+CollectorAttrIndex::count(const CollectorIndexPredicate &pred) const
+{
+	size_t num = m_exprs.size();
+	if (pred.is_string) {
+		StringMap::const_iterator it = m_strings.find(pred.sval);
+		if (it != m_strings.end()) { num += it->second.size(); }
+	} else {
+		NumberMap::const_iterator it = pred.has_lo ? m_numbers.lower_bound(pred.lo) : m_numbers.begin();
+		NumberMap::const_iterator end = pred.has_hi ? m_numbers.upper_bound(pred.hi) : m_numbers.end();
+		for ( ; it != end; ++it) { num += it->second.size(); }
+	}
+	return num;
+}
+
+void
+CollectorAttrIndex::candidates(const CollectorIndexPredicate &pred, std::vector<ClassAd*> &ads) const
+{
+	if (pred.is_string) {
+		StringMap::const_iterator it = m_strings.find(pred.sval);
+		if (it != m_strings.end()) { ads.insert(ads.end(), it->second.begin(), it->second.end()); }
+	} else {
+		NumberMap::const_iterator it = pred.has_lo ? m_numbers.lower_bound(pred.lo) : m_numbers.begin();
+		NumberMap::const_iterator end = pred.has_hi ? m_numbers.upper_bound(pred.hi) : m_numbers.end();
+		for ( ; it != end; ++it) { ads.insert(ads.end(), it->second.begin(), it->second.end()); }
+	}
+	ads.insert(ads.end(), m_exprs.begin(), m_exprs.end());
+}
+
+
+bool
+CollectorAdIndex::configure(const classad::References &attrs)
+{
+	if (attrs == m_attrs) {
+		return false;
+	}
+	clear();
+	m_attrs = attrs;
+	return true;
+}
+
+void
+CollectorAdIndex::insert(ClassAd *ad)
+{
+	if (m_attrs.empty()) {
+		return;
+	}
+	for (classad::References::const_iterator it = m_attrs.begin(); it != m_attrs.end(); ++it) {
+		m_indexes[*it].insert(ad, *it);
+	}
+	m_ads.insert(ad);
+}
+
+void
+CollectorAdIndex::remove(ClassAd *ad)
+{
+	if (m_ads.erase(ad) == 0) {
+		return;
+	}
+	for (auto it = m_indexes.begin(); it != m_indexes.end(); ++it) {
+		it->second.remove(ad);
+	}
+}
+
+void
+CollectorAdIndex::clear()
+{
+	m_indexes.clear();
+	m_ads.clear();
+}
+
+// add the conjuncts of the top level && chain of tree to the list, skipping parens.
+static void
+collectConjuncts(classad::ExprTree *tree, std::vector<classad::ExprTree*> &conjuncts)
+{
+	tree = SkipExprParens(tree);
+	if ( ! tree) {
+		return;
+	}
+	if (tree->GetKind() == classad::ExprTree::OP_NODE) {
+		classad::Operation::OpKind op;
+		classad::ExprTree *t1, *t2, *t3;
+		((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+		if (op == classad::Operation::LOGICAL_AND_OP) {
+			collectConjuncts(t1, conjuncts);
+			collectConjuncts(t2, conjuncts);
+			return;
+		}
+	}
+	conjuncts.push_back(tree);
+}
+
+// if tree is of the form <attr> <op> <literal> or <literal> <op> <attr> with an
+// operator that an index can answer, fill in pred and return true.
+static bool
+conjunctToPredicate(classad::ExprTree *tree, CollectorIndexPredicate &pred)
+{
+	if (tree->GetKind() != classad::ExprTree::OP_NODE) {
+		return false;
+	}
+
+	classad::Operation::OpKind op;
+	classad::ExprTree *t1, *t2, *t3;
+	((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+	t1 = SkipExprParens(t1);
+	t2 = SkipExprParens(t2);
+
+	bool absolute = false;
+	classad::Value val;
+	if (ExprTreeIsAttrRef(t1, pred.attr, &absolute) && ExprTreeIsLiteral(t2, val)) {
+		// attr on the left, nothing to do
+	} else if (ExprTreeIsLiteral(t1, val) && ExprTreeIsAttrRef(t2, pred.attr, &absolute)) {
+		// literal on the left, so flip the sense of the ordering operators
+		switch (op) {
+		case classad::Operation::LESS_THAN_OP:        op = classad::Operation::GREATER_THAN_OP; break;
+		case classad::Operation::LESS_OR_EQUAL_OP:    op = classad::Operation::GREATER_OR_EQUAL_OP; break;
+		case classad::Operation::GREATER_THAN_OP:     op = classad::Operation::LESS_THAN_OP; break;
+		case classad::Operation::GREATER_OR_EQUAL_OP: op = classad::Operation::LESS_OR_EQUAL_OP; break;
+		default: break;
+		}
+	} else {
+		return false;
+	}
+	if (absolute) {
+		return false;
+	}
+
+	double rval;
+	switch (op) {
+	case classad::Operation::EQUAL_OP:
+	case classad::Operation::META_EQUAL_OP:
+		if (val.IsStringValue(pred.sval)) {
+			pred.is_string = true;
+			return true;
+		}
+		if (val.IsNumber(rval)) {
+			pred.has_lo = pred.has_hi = true;
+			pred.lo = pred.hi = rval;
+			return true;
+		}
+		return false;
+
+	case classad::Operation::LESS_THAN_OP:
+	case classad::Operation::LESS_OR_EQUAL_OP:
+		if (val.IsNumber(rval)) {
+			pred.has_hi = true;
+			pred.hi = rval;
+			return true;
+		}
+		return false;
+
+	case classad::Operation::GREATER_THAN_OP:
+	case classad::Operation::GREATER_OR_EQUAL_OP:
+		if (val.IsNumber(rval)) {
+			pred.has_lo = true;
+			pred.lo = rval;
+			return true;
+		}
+		return false;
+
+	default:
+		return false;
+	}
+}
+
+bool
+CollectorAdIndex::plan(classad::ExprTree *filter, CollectorIndexPredicate &best, size_t &num_candidates) const
+{
+	if (m_attrs.empty() || ! filter) {
+		return false;
+	}
+
+	std::vector<classad::ExprTree*> conjuncts;
+	collectConjuncts(filter, conjuncts);
+
+	// merge the predicates on each indexed attribute, so that (Memory >= 1024 && Memory < 4096)
+	// is answered as a single range.
+	std::map<std::string, CollectorIndexPredicate, classad::CaseIgnLTStr> preds;
+	for (size_t ix = 0; ix < conjuncts.size(); ++ix) {
+		CollectorIndexPredicate pred;
+		if ( ! conjunctToPredicate(conjuncts[ix], pred) || ! m_attrs.count(pred.attr)) {
+			continue;
+		}
+		auto found = preds.find(pred.attr);
+		if (found == preds.end()) {
+			preds[pred.attr] = pred;
+			continue;
+		}
+		CollectorIndexPredicate &merged = found->second;
+		if (merged.is_string || pred.is_string) {
+			// a string equality is at least as selective as anything else on the attribute
+			if ( ! merged.is_string) { merged = pred; }
+			continue;
+		}
+		if (pred.has_lo && ( ! merged.has_lo || pred.lo > merged.lo)) { merged.has_lo = true; merged.lo = pred.lo; }
+		if (pred.has_hi && ( ! merged.has_hi || pred.hi < merged.hi)) { merged.has_hi = true; merged.hi = pred.hi; }
+	}
+
+	bool found_one = false;
+	for (auto it = preds.begin(); it != preds.end(); ++it) {
+		auto index = m_indexes.find(it->first);
+		size_t num = (index == m_indexes.end()) ? 0 : index->second.count(it->second);
+		if ( ! found_one || num < num_candidates) {
+			best = it->second;
+			num_candidates = num;
+			found_one = true;
+		}
+	}
+	return found_one;
+}
+
+void
+CollectorAdIndex::candidates(const CollectorIndexPredicate &pred, std::vector<ClassAd*> &ads) const
+{
+	auto index = m_indexes.find(pred.attr);
+	if (index != m_indexes.end()) {
+		index->second.candidates(pred, ads);
+	}
+}
@@ -0,0 +1,111 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef __COLLECTOR_INDEX_H__
+#define __COLLECTOR_INDEX_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "condor_classad.h"
+
+// A single predicate extracted from a query constraint that can be answered
+// by an attribute index: either a case-insensitive string equality, or a
+// (closed) numeric range.  Bounds are always treated as inclusive; the index
+// only has to produce a superset of the matching ads, since every candidate
+// is still evaluated against the full constraint.
+struct CollectorIndexPredicate {
+	std::string attr;
+	bool is_string;
+	std::string sval;
+	bool has_lo, has_hi;
+	double lo, hi;
+
+	CollectorIndexPredicate() : is_string(false), has_lo(false), has_hi(false), lo(0), hi(0) {}
+};
+
+// Secondary index of the ads in one collector table on the value of a single attribute.
+// Only attributes whose value in the ad is a string or numeric literal are indexed by
+// value; ads where the attribute is an expression are kept in a separate set that is
+// always returned as candidates.  Ads that do not have the attribute at all are not in
+// the index, because no equality or range comparison against a literal can be true for them.
+class CollectorAttrIndex
+{
+  public:
+	CollectorAttrIndex() {}
+
+	void insert(ClassAd *ad, const std::string &attr);
+	void remove(ClassAd *ad);
+	void clear();
+
+	// number of ads that might satisfy the predicate
+	size_t count(const CollectorIndexPredicate &pred) const;
+	// append the ads that might satisfy the predicate
+	void candidates(const CollectorIndexPredicate &pred, std::vector<ClassAd*> &ads) const;
+
+  private:
+	typedef std::set<ClassAd*> AdSet;
+	typedef std::map<std::string, AdSet, classad::CaseIgnLTStr> StringMap;
+	typedef std::map<double, AdSet> NumberMap;
+
+	// where an ad was put, so that it can be removed without re-evaluating it.
+	struct Key {
+		enum { STRING, NUMBER, EXPR } kind;
+		StringMap::iterator sit;
+		NumberMap::iterator nit;
+	};
+
+	StringMap m_strings;
+	NumberMap m_numbers;
+	AdSet     m_exprs;
+	std::map<ClassAd*, Key> m_keys;
+};
+
+// The set of attribute indexes for one collector table.
+class CollectorAdIndex
+{
+  public:
+	CollectorAdIndex() {}
+
+	// set the attributes to index, returns true if the set changed, in which
+	// case the index is empty and must be re-populated by the caller.
+	bool configure(const classad::References &attrs);
+	bool empty() const { return m_attrs.empty(); }
+	const classad::References & attributes() const { return m_attrs; }
+
+	void insert(ClassAd *ad);
+	void remove(ClassAd *ad);
+	bool contains(ClassAd *ad) const { return m_ads.count(ad) > 0; }
+	void clear();
+
+	// Choose the most selective indexed predicate in the top level conjunction of the
+	// filter expression.  Returns false if no conjunct can be answered from an index,
+	// otherwise returns true and sets pred and num_candidates.
+	bool plan(classad::ExprTree *filter, CollectorIndexPredicate &pred, size_t &num_candidates) const;
+	void candidates(const CollectorIndexPredicate &pred, std::vector<ClassAd*> &ads) const;
+
+  private:
+	classad::References m_attrs;
+	std::map<std::string, CollectorAttrIndex, classad::CaseIgnLTStr> m_indexes;
+	std::set<ClassAd*> m_ads;
+};
+
+#endif // __COLLECTOR_INDEX_H__
@@ -376,6 +376,25 @@ void UpdatesStats::Init()
 	STATS_POOL_ADD(Pool, "", ActiveQueryWorkers, IF_BASICPUB);
 	STATS_POOL_ADD(Pool, "", PendingQueries, IF_BASICPUB);
 	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", DroppedQueries, IF_BASICPUB);
+	STATS_POOL_ADD(Pool, "", PendingQueriesHighPrio, IF_BASICPUB);
+	STATS_POOL_ADD(Pool, "", PendingQueriesLowPrio, IF_BASICPUB);
+
+	// publish Count, Avg, Min and Max of the time queries wait for a fork worker,
+	// and of the time a fork worker takes to answer the query.
+	const int latency_flags = stats_entry_recent<Probe>::PubValueAndRecent | ProbeDetailMode_CAMM | IF_BASICPUB;
+	Pool.AddProbe("QueryWaitTimeHighPrio", &QueryWaitTimeHighPrio, NULL, latency_flags);
+	Pool.AddProbe("QueryWaitTimeLowPrio", &QueryWaitTimeLowPrio, NULL, latency_flags);
+	Pool.AddProbe("QueryWorkerTime", &QueryWorkerTime, NULL, latency_flags);
+
+	// stats for delta updates
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", DeltaUpdates, IF_BASICPUB);
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", DeltaUpdatesRejected, IF_BASICPUB);
+
+	// stats for secondary indexes
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", IndexedQueries, IF_BASICPUB);
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", UnindexedQueries, IF_BASICPUB);
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", IndexCandidateAds, IF_VERBOSEPUB);
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", IndexSkippedAds, IF_VERBOSEPUB);
 
 	ADD_EXTERN_RUNTIME(Pool, HandleQuery, IF_VERBOSEPUB);
 	ADD_EXTERN_RUNTIME(Pool, HandleLocate, IF_VERBOSEPUB);
@@ -174,6 +174,21 @@ struct UpdatesStats {
 	stats_entry_abs<int> ActiveQueryWorkers;
 	stats_entry_abs<int> PendingQueries;
 	stats_entry_recent<long> DroppedQueries;
+	stats_entry_abs<int> PendingQueriesHighPrio;
+	stats_entry_abs<int> PendingQueriesLowPrio;
+	stats_entry_recent<Probe> QueryWaitTimeHighPrio; // seconds a query spent in the pending queue
+	stats_entry_recent<Probe> QueryWaitTimeLowPrio;
+	stats_entry_recent<Probe> QueryWorkerTime;       // seconds from fork to reap of a query worker
+
+	// startd updates that sent only the changed attributes
+	stats_entry_recent<long> DeltaUpdates;
+	stats_entry_recent<long> DeltaUpdatesRejected; // out of sequence, or for an ad we don't have
+
+	// use of secondary indexes by queries of indexed tables
+	stats_entry_recent<long> IndexedQueries;
+	stats_entry_recent<long> UnindexedQueries;
+	stats_entry_recent<long> IndexCandidateAds; // ads evaluated by indexed queries
+	stats_entry_recent<long> IndexSkippedAds;   // ads indexed queries did not need to evaluate
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	stats_entry_recent<long> InProcQueriesFrom[SUBSYSTEM_ID_COUNT]; // Track subsystems < the AUTO subsys.
@@ -0,0 +1,379 @@
+// Checks that the collector engine keeps its secondary indexes and its
+// cache of serialized ads in step with the ads in its tables.  For each
+// way an ad can change, a walk of the STARTD table through the index must
+// find exactly the ads that a full walk finds, and an ad sent from its
+// cached form must arrive the same as one serialized afresh.  Also checks
+// that delta updates keep a startd's private ad from expiring.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "condor_commands.h"
+#include "reli_sock.h"
+#include "condor_daemon_core.h"
+#include "subsystem_info.h"
+#include "collector.h"
+#include "collector_engine.h"
+
+#include <set>
+#include <string>
+
+static std::set<ClassAd *> visited;
+
+static int
+visit( ClassAd * ad ) {
+	visited.insert( ad );
+	return 1;
+}
+
+	// The ads a walk finds that match the filter.  A walk through an index
+	// may visit ads that do not match, but must not miss any that do.
+static std::set<ClassAd *>
+matching( CollectorEngine & engine, classad::ExprTree * filter, bool use_index ) {
+	visited.clear();
+	if( use_index ) {
+		engine.walkHashTable( STARTD_AD, visit, filter );
+	} else {
+		engine.walkHashTable( STARTD_AD, visit );
+	}
+	std::set<ClassAd *> result;
+	for( auto it = visited.begin(); it != visited.end(); ++it ) {
+		if( EvalExprBool( *it, filter ) ) {
+			result.insert( *it );
+		}
+	}
+	return result;
+}
+
+static unsigned failures = 0;
+
+static void
+check( CollectorEngine & engine, const char * when, const char * constraint, size_t expected ) {
+	classad::ExprTree * filter = NULL;
+	if( ParseClassAdRvalExpr( constraint, filter ) ) {
+		EXCEPT( "failed to parse %s", constraint );
+	}
+	std::set<ClassAd *> indexed = matching( engine, filter, true );
+	std::set<ClassAd *> walked = matching( engine, filter, false );
+	if( indexed != walked ) {
+		++failures;
+		fprintf( stderr, "%s: %s: index found %d ads, full walk found %d\n",
+			when, constraint, (int)indexed.size(), (int)walked.size() );
+	}
+	if( walked.size() != expected ) {
+		++failures;
+		fprintf( stderr, "%s: %s: found %d ads, expected %d\n",
+			when, constraint, (int)walked.size(), (int)expected );
+	}
+	delete filter;
+}
+
+static ClassAd *
+make_ad( int i, const char * state, int memory ) {
+	ClassAd * ad = new ClassAd;
+	std::string name, addr;
+	formatstr( name, "slot1@exec%d.example.edu", i );
+	formatstr( addr, "<10.0.0.%d:9618>", i );
+	SetMyTypeName( *ad, STARTD_ADTYPE );
+	SetTargetTypeName( *ad, JOB_ADTYPE );
+	ad->Assign( ATTR_NAME, name );
+	ad->Assign( ATTR_MY_ADDRESS, addr );
+	ad->Assign( ATTR_STARTD_IP_ADDR, addr );
+	ad->Assign( ATTR_STATE, state );
+	ad->Assign( ATTR_MEMORY, memory );
+	ad->Assign( ATTR_DAEMON_START_TIME, 1000 );
+	ad->Assign( ATTR_UPDATE_SEQUENCE_NUMBER, 1 );
+	return ad;
+}
+
+static ClassAd *
+lookup( CollectorEngine & engine, int i ) {
+	ClassAd * ad = make_ad( i, "", 0 );
+	AdNameHashKey hk;
+	makeStartdAdHashKey( hk, ad );
+	delete ad;
+	return engine.lookup( STARTD_AD, hk );
+}
+
+static void
+collect( CollectorEngine & engine, int command, ClassAd * ad ) {
+	condor_sockaddr from;
+	int insert = 0;
+	if( ! engine.collect( command, ad, from, insert ) ) {
+		delete ad;
+		++failures;
+		fprintf( stderr, "collect(%d) failed with %d\n", command, insert );
+	}
+}
+
+static void
+test_indexes( CollectorEngine & engine ) {
+	const int num_ads = 20;
+	for( int i = 0; i < num_ads; ++i ) {
+		collect( engine, UPDATE_STARTD_AD,
+			make_ad( i, (i % 2) ? "Claimed" : "Unclaimed", 1024 * (1 + i % 4) ) );
+	}
+	check( engine, "insert", "State == \"Claimed\"", 10 );
+	check( engine, "insert", "Memory == 2048", 5 );
+
+		// A full update replaces the ad.
+	collect( engine, UPDATE_STARTD_AD, make_ad( 0, "Claimed", 1024 ) );
+	check( engine, "update", "State == \"Claimed\"", 11 );
+	check( engine, "update", "State == \"Unclaimed\"", 9 );
+
+		// A merge changes the existing ad.
+	ClassAd * merge = make_ad( 1, "Unclaimed", 4096 );
+	merge->Delete( ATTR_UPDATE_SEQUENCE_NUMBER );
+	collect( engine, MERGE_STARTD_AD, merge );
+	check( engine, "merge", "State == \"Claimed\"", 10 );
+	check( engine, "merge", "Memory == 4096", 6 );
+
+		// So does a delta update.
+	ClassAd * delta = make_ad( 2, "Claimed", 1024 );
+	delta->Assign( ATTR_UPDATE_SEQUENCE_NUMBER, 2 );
+	collect( engine, UPDATE_STARTD_AD_DELTA, delta );
+	check( engine, "delta", "State == \"Claimed\"", 11 );
+
+		// The collector changes some ads in place, as it does its own.
+	ClassAd * ad = lookup( engine, 3 );
+	if( ! ad ) {
+		EXCEPT( "ad 3 is missing" );
+	}
+	ad->Assign( ATTR_STATE, "Owner" );
+	engine.adModified( ad );
+	check( engine, "adModified", "State == \"Owner\"", 1 );
+	check( engine, "adModified", "State == \"Claimed\"", 10 );
+
+		// Invalidation removes ads.
+	ClassAd query;
+	SetTargetTypeName( query, STARTD_ADTYPE );
+	query.AssignExpr( ATTR_REQUIREMENTS, "TARGET.Memory == 3072" );
+	int invalidated = engine.invalidateAds( STARTD_AD, query );
+	if( invalidated != 4 ) {
+		++failures;
+		fprintf( stderr, "invalidated %d ads, expected 4\n", invalidated );
+	}
+	check( engine, "invalidate", "Memory == 3072", 0 );
+	check( engine, "invalidate", "State == \"Unclaimed\"", 5 );
+
+		// So does expiry.
+	for( int i = 4; i < 8; ++i ) {
+		ad = lookup( engine, i );
+		if( ad ) {
+			ad->Assign( ATTR_LAST_HEARD_FROM, (int)time(NULL) - 3600 );
+		}
+	}
+	engine.invokeHousekeeper( STARTD_AD );
+	check( engine, "expire", "State == \"Claimed\"", 8 );
+	check( engine, "expire", "State == \"Unclaimed\"", 4 );
+	check( engine, "expire", "Memory == 1024", 5 );
+}
+
+	// Sends the ad from its cached serialized form and then afresh, the
+	// two ways a query reply can send it, and checks that they arrive the
+	// same.  Leaves the ad as it arrived from the cache in received.
+static void
+check_wire( CollectorEngine & engine, const char * when, ClassAd * ad, ClassAd & received ) {
+	const SerializedClassAd * wire = engine.serializedAd( ad );
+	if( ! wire ) {
+		++failures;
+		fprintf( stderr, "%s: ad has no serialized form\n", when );
+		return;
+	}
+
+	classad::References projection;
+	projection.insert( ATTR_NAME );
+	projection.insert( ATTR_STATE );
+	const int options[] = { 0, PUT_CLASSAD_NO_PRIVATE };
+	for( size_t i = 0; i < COUNTOF(options); ++i ) {
+		for( int projected = 0; projected < 2; ++projected ) {
+			const classad::References * whitelist = projected ? &projection : NULL;
+			ReliSock sender, receiver;
+			if( ! sender.connect_socketpair( receiver ) ) {
+				EXCEPT( "failed to connect loopback sockets" );
+			}
+			sender.encode();
+			if( ! putClassAd( &sender, *ad, *wire, options[i], whitelist ) ||
+				! putClassAd( &sender, *ad, options[i], whitelist ) ||
+				! sender.end_of_message() ) {
+				EXCEPT( "failed to send ad" );
+			}
+			ClassAd cached, fresh;
+			receiver.decode();
+			if( ! getClassAd( &receiver, cached ) || ! getClassAd( &receiver, fresh ) ||
+				! receiver.end_of_message() ) {
+				EXCEPT( "failed to receive ad" );
+			}
+			if( ! cached.SameAs( &fresh ) ) {
+				++failures;
+				fprintf( stderr, "%s: cached ad differs from fresh ad (options %d, %s)\n",
+					when, options[i], projected ? "projected" : "whole ad" );
+			}
+			if( options[i] == 0 && ! projected ) {
+				received.CopyFrom( cached );
+			}
+		}
+	}
+}
+
+static void
+check_attr( const char * when, ClassAd & ad, const char * attr, const char * expected ) {
+	std::string value;
+	if( ! ad.LookupString( attr, value ) || value != expected ) {
+		++failures;
+		fprintf( stderr, "%s: %s is \"%s\", expected \"%s\"\n",
+			when, attr, value.c_str(), expected );
+	}
+}
+
+static void
+test_serialized( CollectorEngine & engine ) {
+	ClassAd received;
+
+		// A new ad, with a private attribute.
+	ClassAd * ad = make_ad( 100, "Unclaimed", 1024 );
+	ad->Assign( ATTR_CAPABILITY, "<10.0.0.100:9618>#1#1#..." );
+	collect( engine, UPDATE_STARTD_AD, ad );
+	check_wire( engine, "insert", lookup( engine, 100 ), received );
+	check_attr( "insert", received, ATTR_STATE, "Unclaimed" );
+
+		// A full update replaces it.
+	collect( engine, UPDATE_STARTD_AD, make_ad( 100, "Claimed", 1024 ) );
+	check_wire( engine, "update", lookup( engine, 100 ), received );
+	check_attr( "update", received, ATTR_STATE, "Claimed" );
+	if( received.Lookup( ATTR_CAPABILITY ) ) {
+		++failures;
+		fprintf( stderr, "update: the replaced ad's %s was sent\n", ATTR_CAPABILITY );
+	}
+
+		// A merge changes it.
+	ClassAd * merge = make_ad( 100, "Owner", 1024 );
+	merge->Delete( ATTR_UPDATE_SEQUENCE_NUMBER );
+	collect( engine, MERGE_STARTD_AD, merge );
+	check_wire( engine, "merge", lookup( engine, 100 ), received );
+	check_attr( "merge", received, ATTR_STATE, "Owner" );
+
+		// The collector changes its own ad in place after storing it,
+		// deleting some attributes and publishing its statistics.
+	ClassAd * self = new ClassAd;
+	SetMyTypeName( *self, COLLECTOR_ADTYPE );
+	SetTargetTypeName( *self, "" );
+	self->Assign( ATTR_NAME, "collector.example.edu" );
+	self->Assign( ATTR_MY_ADDRESS, "<10.0.0.1:9618>" );
+	self->Assign( ATTR_COLLECTOR_IP_ADDR, "<10.0.0.1:9618>" );
+	self->Assign( ATTR_UPDATESTATS_HISTORY, "0x00000000" );
+	self->Assign( ATTR_STATE, "Starting" );
+	condor_sockaddr from;
+	int insert = 0;
+	if( ! engine.collect( UPDATE_COLLECTOR_AD, self, from, insert ) ) {
+		EXCEPT( "failed to collect the collector ad" );
+	}
+	self->Delete( ATTR_UPDATESTATS_HISTORY );
+	self->Assign( ATTR_STATE, "Running" );
+	engine.adModified( self );
+	check_wire( engine, "self", self, received );
+	check_attr( "self", received, ATTR_STATE, "Running" );
+	if( received.Lookup( ATTR_UPDATESTATS_HISTORY ) ) {
+		++failures;
+		fprintf( stderr, "self: deleted attribute %s was sent\n", ATTR_UPDATESTATS_HISTORY );
+	}
+}
+
+	// A delta update has no private ad, so it must keep the private ad
+	// from the last full update alive as long as the public ad.
+static void
+test_private_ad_lifetime( CollectorEngine & engine ) {
+	ReliSock sender, receiver;
+	if( ! sender.connect_socketpair( receiver ) ) {
+		EXCEPT( "failed to connect loopback sockets" );
+	}
+	ClassAd pvt;
+	pvt.Assign( ATTR_CAPABILITY, "<10.0.0.200:9618>#1#1#..." );
+	sender.encode();
+	if( ! putClassAd( &sender, pvt ) || ! sender.end_of_message() ) {
+		EXCEPT( "failed to send private ad" );
+	}
+
+	condor_sockaddr from;
+	int insert = 0;
+	ClassAd * ad = make_ad( 200, "Unclaimed", 1024 );
+	receiver.decode();
+	if( ! engine.collect( UPDATE_STARTD_AD, ad, from, insert, &receiver ) ) {
+		EXCEPT( "failed to collect startd ad" );
+	}
+	receiver.end_of_message();
+
+	AdNameHashKey hk;
+	makeStartdAdHashKey( hk, ad );
+	ClassAd * pvt_ad = engine.lookup( STARTD_PVT_AD, hk );
+	if( ! pvt_ad ) {
+		EXCEPT( "private ad was not stored" );
+	}
+
+		// Both ads were last heard from well over their lifetime ago,
+		// as they would be after a run of delta updates.
+	int long_ago = (int)time(NULL) - 3600;
+	ad->Assign( ATTR_LAST_HEARD_FROM, long_ago );
+	pvt_ad->Assign( ATTR_LAST_HEARD_FROM, long_ago );
+
+	ClassAd * delta = make_ad( 200, "Claimed", 1024 );
+	delta->Assign( ATTR_UPDATE_SEQUENCE_NUMBER, 2 );
+	collect( engine, UPDATE_STARTD_AD_DELTA, delta );
+
+	engine.invokeHousekeeper( STARTD_AD );
+	engine.invokeHousekeeper( STARTD_PVT_AD );
+	if( ! engine.lookup( STARTD_AD, hk ) ) {
+		++failures;
+		fprintf( stderr, "delta: public ad expired\n" );
+	}
+	if( ! engine.lookup( STARTD_PVT_AD, hk ) ) {
+		++failures;
+		fprintf( stderr, "delta: private ad expired\n" );
+	}
+
+		// A rejected delta is not a sign of life.
+	ad = engine.lookup( STARTD_AD, hk );
+	pvt_ad = engine.lookup( STARTD_PVT_AD, hk );
+	if( ad && pvt_ad ) {
+		pvt_ad->Assign( ATTR_LAST_HEARD_FROM, long_ago );
+		delta = make_ad( 200, "Owner", 1024 );
+		delta->Assign( ATTR_UPDATE_SEQUENCE_NUMBER, 4 );
+		if( engine.collect( UPDATE_STARTD_AD_DELTA, delta, from, insert ) ) {
+			++failures;
+			fprintf( stderr, "delta: out of sequence delta was applied\n" );
+		} else {
+			delete delta;
+		}
+		engine.invokeHousekeeper( STARTD_PVT_AD );
+		if( engine.lookup( STARTD_PVT_AD, hk ) ) {
+			++failures;
+			fprintf( stderr, "delta: rejected delta kept the private ad alive\n" );
+		}
+	}
+}
+
+int
+main( int /* argc */, char ** /* argv */ ) {
+	set_mySubSystem( "COLLECTOR", SUBSYSTEM_TYPE_COLLECTOR );
+	config();
+	dprintf_config_tool_on_error( 0 );
+	dprintf_OnExitDumpOnErrorBuffer( stderr );
+	param_insert( "COLLECTOR_INDEX_ATTRS_Machine", "State, Memory" );
+	param_insert( "COLLECTOR_CACHE_SERIALIZED_ADS", "true" );
+
+	CollectorStats stats( false, 0 );
+	CollectorEngine engine( &stats );
+	engine.configureIndexes();
+	engine.configureSerializedAds();
+
+	test_indexes( engine );
+	test_serialized( engine );
+	test_private_ad_lifetime( engine );
+
+	if( failures ) {
+		fprintf( stderr, "%u failures\n", failures );
+	}
+	return failures ? 1 : 0;
+}
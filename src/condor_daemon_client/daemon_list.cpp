@@ -311,6 +311,20 @@ CollectorList::sendUpdates (int cmd, ClassAd * ad1, ClassAd* ad2, bool nonblocki
 	return success_count;
 }
 
+int
+CollectorList::updateFailures()
+{
+	int failures = 0;
+
+	this->rewind();
+	DCCollector * daemon;
+	while (this->next(daemon)) {
+		failures += daemon->getUpdateFailures();
+	}
+
+	return failures;
+}
+
 QueryResult
 CollectorList::query (CondorQuery & cQuery, bool (*callback)(void*, ClassAd *), void* pv, CondorError * errstack) {
 
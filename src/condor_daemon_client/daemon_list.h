@@ -115,6 +115,9 @@ class CollectorList : public DaemonList {
 		DCTokenRequester *token_requester = nullptr, const std::string &identity = "",
 		const std::string authz_name = "");
 
+		// Total of DCCollector::getUpdateFailures() for the collectors
+	int updateFailures();
+
 		// use this to detach the ad sequence counters before destroying the collector list
 		// we do this when we want to move the sequence counters to a new list
 	DCCollectorAdSequences * detachAdSequences() { DCCollectorAdSequences * p = adSeq; adSeq = NULL; return p; }
@@ -49,6 +49,7 @@ DCCollector::init( bool needs_reconfig )
 	reconfigTime = 0;
 
 	update_rsock = NULL;
+	update_failures = 0;
 	use_tcp = true;
 	use_nonblocking_update = true;
 	update_destination = NULL;
@@ -116,6 +117,7 @@ DCCollector::deepCopy( const DCCollector& copy )
 	update_destination = copy.update_destination ? strdup( copy.update_destination ) : NULL;
 
 	startTime = copy.startTime;
+	update_failures = copy.update_failures;
 }
 
 
@@ -376,10 +378,16 @@ DCCollector::sendUpdate( int cmd, ClassAd* ad1, DCCollectorAdSequences& adSeq, C
 		}
 	}
 
+	bool sent;
 	if( use_tcp ) {
-		return sendTCPUpdate( cmd, ad1, ad2, nonblocking, callback_fn, miscdata );
+		sent = sendTCPUpdate( cmd, ad1, ad2, nonblocking, callback_fn, miscdata );
+	} else {
+		sent = sendUDPUpdate( cmd, ad1, ad2, nonblocking, callback_fn, miscdata );
+	}
+	if( ! sent ) {
+		update_failures++;
 	}
-	return sendUDPUpdate( cmd, ad1, ad2, nonblocking, callback_fn, miscdata );
+	return sent;
 }
 
 
@@ -523,6 +531,7 @@ public:
 			}
 			dprintf(D_ALWAYS,"Failed to start non-blocking update to %s.\n",who);
 			if (dc_collector) {
+				dc_collector->update_failures++;
 				while (!dc_collector->pending_update_list.empty()) {
 					// UpdateData's dtor removes this from the pending update list
 					delete(dc_collector->pending_update_list.front());
@@ -535,6 +544,7 @@ public:
 			if(sock) who = sock->get_sinful_peer();
 			dprintf(D_ALWAYS,"Failed to send non-blocking update to %s.\n",who);
 			if (dc_collector) {
+				dc_collector->update_failures++;
 				while (!dc_collector->pending_update_list.empty()) {
 					// UpdateData's dtor removes this from the pending update list
 					delete(dc_collector->pending_update_list.front());
@@ -584,6 +594,7 @@ public:
 						who = dc_collector->update_rsock->get_sinful_peer();
 					}
 					dprintf(D_ALWAYS,"Failed to send update to %s.\n",who);
+					dc_collector->update_failures++;
 					delete dc_collector->update_rsock;
 					dc_collector->update_rsock = NULL;
 					// Notice we remove the element from the list of pending updates
@@ -695,6 +706,9 @@ DCCollector::sendTCPUpdate( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblockin
 	dprintf( D_FULLDEBUG, 
 			 "Couldn't reuse TCP socket to update collector, "
 			 "starting new connection\n" );
+		// the update we just tried to send is lost, and if the
+		// collector restarted it has lost the earlier ones too
+	update_failures++;
 	delete update_rsock;
 	update_rsock = NULL;
 	return initiateTCPUpdate( cmd, ad1, ad2, nonblocking, callback_fn, miscdata );
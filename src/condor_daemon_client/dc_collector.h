@@ -108,6 +108,13 @@ public:
 	time_t getStartTime() const { return startTime; }
 	time_t getReconfigTime() const { return reconfigTime; }
 
+		/** The number of updates to this collector that failed, or that
+			had to open a new TCP connection because the old one failed.
+			In either case the collector may not have earlier updates, so
+			a daemon that sends deltas should send a full update.
+		*/
+	int getUpdateFailures() const { return update_failures; }
+
 		/** Request that the collector get an identity token from the specified
 		 *  schedd.
 		 */
@@ -122,6 +129,7 @@ private:
 	void deepCopy( const DCCollector& copy );
 
 	ReliSock* update_rsock;
+	int update_failures;
 
 	bool use_tcp;
 	bool use_nonblocking_update;
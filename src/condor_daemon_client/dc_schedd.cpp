@@ -1935,6 +1935,133 @@ bool DCSchedd::recycleShadow( int previous_job_exit_reason, ClassAd **new_job_ad
 	return true;
 }
 
+bool DCSchedd::multiJobShadowSync( const std::vector<PROC_ID> &exited_jobs,
+									const std::vector<int> &exit_reasons,
+									int running_jobs, bool accepting_jobs,
+									std::vector<PROC_ID> &signal_jobs,
+									std::vector<int> &signals,
+									std::vector<ClassAd*> &new_job_ads,
+									MyString &error_msg )
+{
+	int timeout = 300;
+	CondorError errstack;
+
+	ASSERT( exited_jobs.size() == exit_reasons.size() );
+	signal_jobs.clear();
+	signals.clear();
+	new_job_ads.clear();
+
+	if (IsDebugLevel(D_COMMAND)) {
+		dprintf (D_COMMAND, "DCSchedd::multiJobShadowSync(%s,...) making connection to %s\n",
+			getCommandStringSafe(MULTI_JOB_SHADOW_SYNC), _addr ? _addr : "NULL");
+	}
+
+	ReliSock sock;
+	if( !connectSock(&sock,timeout,&errstack) ) {
+		error_msg.formatstr("Failed to connect to schedd: %s",
+						  errstack.getFullText().c_str());
+		return false;
+	}
+
+	if( !startCommand(MULTI_JOB_SHADOW_SYNC, &sock, timeout, &errstack) ) {
+		error_msg.formatstr("Failed to send MULTI_JOB_SHADOW_SYNC to schedd: %s",
+						  errstack.getFullText().c_str());
+		return false;
+	}
+
+	if( !forceAuthentication(&sock, &errstack) ) {
+		error_msg.formatstr("Failed to authenticate: %s",
+						  errstack.getFullText().c_str());
+		return false;
+	}
+
+	sock.encode();
+	int mypid = getpid();
+	int accepting = accepting_jobs ? 1 : 0;
+	int num_exits = (int)exited_jobs.size();
+	if( !sock.put( mypid ) ||
+		!sock.put( running_jobs ) ||
+		!sock.put( accepting ) ||
+		!sock.put( num_exits ) )
+	{
+		error_msg = "Failed to send job exit reasons";
+		return false;
+	}
+	for( int i = 0; i < num_exits; i++ ) {
+		if( !sock.put( exited_jobs[i].cluster ) ||
+			!sock.put( exited_jobs[i].proc ) ||
+			!sock.put( exit_reasons[i] ) )
+		{
+			error_msg = "Failed to send job exit reasons";
+			return false;
+		}
+	}
+	if( !sock.end_of_message() ) {
+		error_msg = "Failed to send job exit reasons";
+		return false;
+	}
+
+	sock.decode();
+
+	int num_signals = 0;
+	if( !sock.get( num_signals ) ) {
+		error_msg = "Failed to receive signals";
+		return false;
+	}
+	for( int i = 0; i < num_signals; i++ ) {
+		PROC_ID job_id;
+		int sig = 0;
+		if( !sock.get( job_id.cluster ) ||
+			!sock.get( job_id.proc ) ||
+			!sock.get( sig ) )
+		{
+			error_msg = "Failed to receive signals";
+			return false;
+		}
+		signal_jobs.push_back( job_id );
+		signals.push_back( sig );
+	}
+
+	int num_jobs = 0;
+	bool got_jobs = sock.get( num_jobs );
+	for( int i = 0; got_jobs && i < num_jobs; i++ ) {
+		ClassAd *ad = new ClassAd();
+		if( !getClassAd( &sock, *ad ) ) {
+			delete ad;
+			got_jobs = false;
+			break;
+		}
+		new_job_ads.push_back( ad );
+	}
+
+	if( !got_jobs || !sock.end_of_message() ) {
+		error_msg = got_jobs ? "Failed to receive end of message" :
+			"Failed to receive new job ClassAds";
+		for( size_t i = 0; i < new_job_ads.size(); i++ ) {
+			delete new_job_ads[i];
+		}
+		new_job_ads.clear();
+		return false;
+	}
+
+	if( num_jobs ) {
+		sock.encode();
+		int ok=1;
+		if( !sock.put(ok) ||
+			!sock.end_of_message() )
+		{
+			error_msg = "Failed to send ok";
+			for( size_t i = 0; i < new_job_ads.size(); i++ ) {
+				delete new_job_ads[i];
+			}
+			new_job_ads.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool
 DCSchedd::reassignSlot( PROC_ID bid, ClassAd & reply, std::string & errorMessage, PROC_ID * vids, unsigned vCount, int flags ) {
 	std::string vidList;
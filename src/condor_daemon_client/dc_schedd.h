@@ -368,6 +368,21 @@ public:
 		// If no new job found, returns true with *new_job_ad=NULL
 	bool recycleShadow( int previous_job_exit_reason, ClassAd **new_job_ad, MyString &error_msg );
 
+		// Used by a shadow that hosts more than one job (see
+		// MAX_JOBS_PER_SHADOW).  Tells the schedd the exit reasons of the
+		// jobs the shadow is done with, how many jobs it is still running,
+		// and whether it will take more jobs.  Returns the signals the schedd
+		// has for the jobs the shadow is running, and the ads of the new
+		// jobs it should run, which the caller should delete.
+		// Returns false on error (see error_msg)
+	bool multiJobShadowSync( const std::vector<PROC_ID> &exited_jobs,
+							 const std::vector<int> &exit_reasons,
+							 int running_jobs, bool accepting_jobs,
+							 std::vector<PROC_ID> &signal_jobs,
+							 std::vector<int> &signals,
+							 std::vector<ClassAd*> &new_job_ads,
+							 MyString &error_msg );
+
 
 		/*
 		 * Retrieve a token with someone else's identity from a remote schedd,
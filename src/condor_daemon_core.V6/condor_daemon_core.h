@@ -76,6 +76,7 @@ class ProcFamilyInterface;
 
 template <class Key, class Value> class HashTable; // forward declaration
 class Probe;
+class Selector;
 
 #define USE_MIRON_PROBE_FOR_DC_RUNTIME_STATS
 
@@ -1707,6 +1708,16 @@ class DaemonCore : public Service
 	int m_iMaxReapsPerCycle; // maximum number reapers to invoke per event loop
 	int m_MaxTimeSkip;
 	int m_iMaxUdpMsgsPerCycle;	// max number of udp messages read per loop
+	bool m_use_epoll;			// keep the main loop's fds registered with epoll
+		// Set whenever the sockets or pipes Driver() must watch may have
+		// changed, so it knows to declare its interest to the selector again.
+	bool m_selector_interest_changed;
+		// Filled in by SetupSelector() when the selector is persistent:
+		// the sockTable index for each registered fd, and the entries
+		// that have a deadline.
+	std::vector<int> m_sock_index_by_fd;
+	std::vector<int> m_sock_deadline_index;
+	std::vector<int> m_sock_ready_index;
 
     void Inherit( void );  // called in main()
 	void InitDCCommandSocket( int command_port );  // called in main()
@@ -2091,6 +2102,10 @@ class DaemonCore : public Service
 		// invoked by CondorThreads upon thread context switch
 	static void thread_switch_callback(void* & ptr);
 
+		// Declare our interest in the registered sockets and pipes to
+		// Driver()'s selector, and find the earliest socket deadline.
+	void SetupSelector( Selector &selector, time_t &min_deadline );
+
 		// Call the registered socket handler for this socket
 		// i - index of registered socket
 		// default_to_HandleCommand - true if HandleCommand() should be called
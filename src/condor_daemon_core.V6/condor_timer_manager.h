@@ -34,6 +34,9 @@
 #include "dc_service.h"
 #include "condor_timeslice.h"
 
+#include <vector>
+#include <unordered_map>
+
 #ifdef WIN32
 #include <time.h>
 #else
@@ -84,7 +87,8 @@ struct tagTimer {
     /** Not_Yet_Documented */ TimerHandler             handler;
     /** Not_Yet_Documented */ TimerHandlercpp          handlercpp;
     /** Not_Yet_Documented */ class Service*    service; 
-    /** Not_Yet_Documented */ struct tagTimer*  next;
+    /** Index in the timer heap */ int         heap_index;
+    /** Insertion order, for ties */ uint64_t  seq;
     /** Not_Yet_Documented */ char*             event_descrip;
     /** Not_Yet_Documented */ void*             data_ptr;
     /** Not_Yet_Documented */ Timeslice *       timeslice;
@@ -95,6 +99,10 @@ struct tagTimer {
 ///
 typedef struct tagTimer Timer;
 
+// Values of tagTimer::heap_index for timers that are not in the heap
+const int TIMER_NOT_QUEUED = -1;
+const int TIMER_DEFERRED = -2;
+
 //-----------------------------------------------------------------------------
 /**
  */
@@ -250,19 +258,42 @@ class TimerManager
                   unsigned   period          =  0,
 				  const Timeslice *timeslice = NULL);
 
-	void RemoveTimer( Timer *timer, Timer *prev );
+	void RemoveTimer( Timer *timer );
 	void InsertTimer( Timer *new_timer );
 	void DeleteTimer( Timer *timer );
 
 	/*
 	  @param id The id of the timer to find
-	  @param prev If not NULL, this will be set to previous timer in list
 	  @return pointer to timer with specified id or NULL if not found
 	 */
-	Timer *GetTimer( int id, Timer **prev );
+	Timer *GetTimer( int id );
+
+	// Binary min-heap operations on timer_heap, ordered by when and
+	// then by seq, so that timers with equal deadlines fire in the
+	// order they were inserted.
+	static bool TimerBefore( const Timer *a, const Timer *b );
+	void HeapPush( Timer *timer );
+	void HeapPlace( Timer *timer, size_t pos );
+	void HeapSiftUp( size_t pos );
+	void HeapSiftDown( size_t pos );
+
+	// Move the timers deferred during Timeout() into the heap
+	void InsertDeferredTimers();
+
+	// The earliest time any timer is due, or TIME_T_NEVER if none are
+	time_t NextTimerWhen();
+
+	std::vector<Timer*> timer_heap;
+	std::unordered_map<int,Timer*> timer_index;
+	uint64_t timer_seq;
+
+	// When Timeout() has no limit on the number of handlers it calls,
+	// timers added or reset by those handlers are held here until it
+	// finishes, so that it only calls the ones that were due when it
+	// started.
+	std::vector<Timer*> deferred_timers;
+	bool    defer_inserts;
 
-    Timer*  timer_list;
-	Timer*  list_tail;
     int     timer_ids;
     Timer*  in_timeout;
     bool    did_reset;
@@ -913,6 +913,10 @@ DaemonCommandProtocol::CommandProtocolResult DaemonCommandProtocol::ReadCommand(
 								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating 3DES key for session %s...\n", m_sid);
 								m_key = new KeyInfo(rbuf, 24, CONDOR_3DES);
 								break;
+							case 'A': // aesgcm
+								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating AESGCM key for session %s...\n", m_sid);
+								m_key = new KeyInfo(rbuf, 24, CONDOR_AESGCM);
+								break;
 							default:
 								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating RANDOM key for session %s...\n", m_sid);
 								m_key = new KeyInfo(rbuf, 24);
@@ -1216,6 +1220,21 @@ DaemonCommandProtocol::CommandProtocolResult DaemonCommandProtocol::EnableCrypto
 		m_sock->set_crypto_key(false, m_key);
 	}
 
+		// as in SecManStartCommand, don't compress data that was
+		// encrypted before it was put in packets
+	if (m_sec_man->sec_lookup_feat_act(*m_policy, ATTR_SEC_COMPRESSION) == SecMan::SEC_FEAT_ACT_YES &&
+		!(m_sock->get_encryption() && !m_sock->crypto_seals_packets()))
+	{
+		std::string method;
+		m_policy->LookupString(ATTR_SEC_COMPRESSION_METHODS, method);
+		if (!static_cast<ReliSock *>(m_sock)->set_compression(method.c_str())) {
+			dprintf (D_ALWAYS, "DC_AUTHENTICATE: unable to turn on %s compression, failing request from %s.\n", method.c_str(), m_sock->peer_description());
+			m_result = FALSE;
+			return CommandProtocolFinished;
+		}
+		dprintf (D_SECURITY, "DC_AUTHENTICATE: %s compression enabled for session %s\n", method.c_str(), m_sid);
+	}
+
 	m_state = CommandProtocolVerifyCommand;
 	return CommandProtocolContinue;
 }
@@ -112,6 +112,8 @@ CRITICAL_SECTION Big_fat_mutex; // coarse grained mutex for debugging purposes
 
 #include "systemd_manager.h"
 
+#include <algorithm>
+
 static const char* EMPTY_DESCRIP = "<NULL>";
 
 // special errno values that may be returned from Create_Process
@@ -401,6 +403,8 @@ DaemonCore::DaemonCore(int ComSize,int SigSize,
 	m_super_dc_port = -1;
 	m_iMaxReapsPerCycle = 1;
     m_iMaxAcceptsPerCycle = 1;
+	m_use_epoll = false;
+	m_selector_interest_changed = true;
 
 	m_MaxTimeSkip = 60 * 20;  // 20 minutes
 
@@ -1846,6 +1850,7 @@ int DaemonCore::Register_Socket(Stream *iosock, const char* iosock_descrip,
 
 	// If we are a worker thread, wake up select in the main thread
 	// so the main thread re-computes the fd_sets.
+	m_selector_interest_changed = true;
 	Wake_up_select();
 
 	return i;
@@ -1925,6 +1930,7 @@ int DaemonCore::Cancel_Socket( Stream* insock, void *prev_entry)
 
 	// If we are a worker thread, wake up select in the main thread
 	// so the main thread re-computes the fd_sets.
+	m_selector_interest_changed = true;
 	Wake_up_select();
 
 	return TRUE;
@@ -2221,9 +2227,14 @@ int DaemonCore::Register_Pipe(int pipe_end, const char* pipe_descrip,
 	curr_regdataptr = &((*pipeTable)[i].data_ptr);
 
 #ifndef WIN32
+	// The fd may have been dup2()ed over since we last saw it registered
+	// (the CCB server does this), so don't trust what the selector has.
+	Selector::fd_closing( (*pipeHandleTable)[index] );
+
 	// On Unix, pipe fds are given to select.  So
 	// if we are a worker thread, wake up select in the main thread
 	// so the main thread re-computes the fd_sets.
+	m_selector_interest_changed = true;
 	Wake_up_select();
 #endif
 
@@ -2342,6 +2353,7 @@ int DaemonCore::Cancel_Pipe( int pipe_end )
 	// On Unix, pipe fds are passed into select.  So
 	// if we are a worker thread, wake up select in the main thread
 	// so the main thread re-computes the fd_sets.
+	m_selector_interest_changed = true;
 	Wake_up_select();
 #endif
 
@@ -2398,6 +2410,9 @@ int DaemonCore::Close_Pipe( int pipe_end )
 
 	// Now, close the pipe.
 	int retval = TRUE;
+#if !defined(WIN32)
+	Selector::fd_closing( (*pipeHandleTable)[index] );
+#endif
 #if defined(WIN32)
 	WritePipeEnd* wpe = dynamic_cast<WritePipeEnd*>((*pipeHandleTable)[index]);
 	if (wpe && wpe->needs_delayed_close()) {
@@ -3036,6 +3051,8 @@ DaemonCore::reconfig(void) {
         dprintf(D_FULLDEBUG,"Setting maximum accepts per cycle %d.\n", m_iMaxAcceptsPerCycle);
     }
 
+	m_use_epoll = param_boolean("DAEMON_CORE_USE_EPOLL", true);
+
 	m_iMaxUdpMsgsPerCycle = param_integer("MAX_UDP_MSGS_PER_CYCLE", 1);
 	if( m_iMaxUdpMsgsPerCycle != 1 ) {
 		dprintf(D_FULLDEBUG,"Setting maximum UDP messages per cycle %d.\n", m_iMaxUdpMsgsPerCycle);
@@ -3344,15 +3361,134 @@ DaemonCore::Async_test_Wake_up_select(
 }
 
 
+// Declare our interest in the registered sockets and pipes to the
+// selector used by Driver(), and find the earliest socket deadline.
+void
+DaemonCore::SetupSelector( Selector &selector, time_t &min_deadline )
+{
+	selector.reset();
+	min_deadline = 0;
+
+	bool persistent = selector.is_persistent();
+	if ( persistent ) {
+		m_sock_index_by_fd.assign( m_sock_index_by_fd.size(), -1 );
+		m_sock_deadline_index.clear();
+	}
+
+	for (int i = 0; i < nSock; i++) {
+			// NOTE: keep the following logic for building the
+			// fdset in sync with DaemonCore::ServiceCommandSocket()
+
+			// if a valid entry not already being serviced, add to select
+		if ( (*sockTable)[i].iosock && 
+			 (*sockTable)[i].servicing_tid==0 &&
+			 (*sockTable)[i].remove_asap == false ) {	
+				// Setup our fdsets
+			if ( (*sockTable)[i].is_reverse_connect_pending ) {
+				// nothing to do; we are just allowing this socket
+				// to be registered so that it behaves like a socket
+				// that is doing a non-blocking connect
+				// CCBClient will eventually ensure that the
+				// socket's registered callback function is called
+				// We want to ignore the socket's deadline (below)
+				// because that is all taken care of by CCBClient.
+				continue;
+			}
+			else if ( (*sockTable)[i].is_connect_pending ) {
+					// we want to be woken when a non-blocking
+					// connect is ready to write.  when connect
+					// is ready, select will set the writefd set
+					// on success, or the exceptfd set on failure.
+				selector.add_fd( (*sockTable)[i].iosock->get_file_desc(), Selector::IO_WRITE );
+				selector.add_fd( (*sockTable)[i].iosock->get_file_desc(), Selector::IO_EXCEPT );
+			} else {
+				int sockfd = (*sockTable)[i].iosock->get_file_desc();
+				switch( (*sockTable)[i].handler_type ) {
+				case HANDLE_READ:
+					selector.add_fd( sockfd, Selector::IO_READ );
+					break;
+				case HANDLE_WRITE:
+					selector.add_fd( sockfd, Selector::IO_WRITE );
+					break;
+				case HANDLE_READ_WRITE:
+					selector.add_fd( sockfd, Selector::IO_READ );
+					selector.add_fd( sockfd, Selector::IO_WRITE );
+					break;
+				}
+			}
+
+				// If this socket times out sooner than
+				// our select timeout, adjust the select timeout.
+			time_t deadline = (*sockTable)[i].iosock->get_deadline();
+			if(deadline) { // If non-zero, there is a timeout.
+				if(min_deadline == 0 || min_deadline > deadline) {
+					min_deadline = deadline;
+				}
+				if ( persistent ) {
+					m_sock_deadline_index.push_back( i );
+				}
+			}
+
+				// Remember which entry owns this fd, so Driver() can go
+				// straight from a ready fd to its entry.
+			if ( persistent ) {
+				int sockfd = (*sockTable)[i].iosock->get_file_desc();
+				if ( sockfd >= (int)m_sock_index_by_fd.size() ) {
+					m_sock_index_by_fd.resize( sockfd + 1, -1 );
+				}
+				m_sock_index_by_fd[sockfd] = i;
+			}
+		}
+	}
+
+#if !defined(WIN32)
+	// Add the registered pipe fds into the list of descriptors to
+	// select on.
+	for (int i = 0; i < nPipe; i++) {
+		if ( (*pipeTable)[i].index != -1 ) {	// if a valid entry....
+			int pipefd = (*pipeHandleTable)[(*pipeTable)[i].index];
+			switch( (*pipeTable)[i].handler_type ) {
+			case HANDLE_READ:
+				selector.add_fd( pipefd, Selector::IO_READ );
+				break;
+			case HANDLE_WRITE:
+				selector.add_fd( pipefd, Selector::IO_WRITE );
+				break;
+			case HANDLE_READ_WRITE:
+				selector.add_fd( pipefd, Selector::IO_READ );
+				selector.add_fd( pipefd, Selector::IO_WRITE );
+				break;
+			}
+		}
+	}
+#endif
+
+
+	// Add the read side of async_pipe to the list of file descriptors to
+	// select on.  We write to async_pipe if a unix async signal
+	// is delivered after we unblock signals and before we block on select.
+#ifdef WIN32
+	if ( ! async_pipe[0].is_connected()) {
+		EXCEPT("DaemonCore:: async_pipe has been unexpectedly closed!");
+	} 
+	selector.add_fd( async_pipe[0].get_file_desc() , Selector::IO_READ );
+#else
+	selector.add_fd( async_pipe[0], Selector::IO_READ );
+#endif
+}
+
 // This function never returns. It is responsible for monitor signals and
 // incoming messages or requests and invoke corresponding handlers.
 void DaemonCore::Driver()
 {
 	Selector	selector;
+	Selector	recheck_selector;
+	bool		selector_persistent = false;
+	time_t		last_interest_time = 0;
 	int			i;
 	int			tmpErrno;
 	time_t		timeout;
-	time_t min_deadline;
+	time_t min_deadline = 0;
 
 #ifndef WIN32
 	sigset_t fullset, emptyset;
@@ -3507,62 +3643,35 @@ void DaemonCore::Driver()
         dc_stats.TimerRuntime += (runtime - group_runtime);
         group_runtime = runtime;
 
-		// Setup what socket descriptors to select on.  We recompute this
+		// With epoll, the selector keeps our fds registered with the kernel
+		// between cycles.  We still declare our interest below on every
+		// cycle, but only changes since the last cycle cost a system call.
+		if ( selector_persistent != m_use_epoll ) {
+			selector_persistent = m_use_epoll;
+			if ( ! selector.set_persistent( selector_persistent ) ) {
+				dprintf( D_FULLDEBUG, "DaemonCore: epoll not available, using select()\n" );
+			}
+			m_selector_interest_changed = true;
+		}
+
+		// Setup what fds to select on.  With select(), we recompute this
 		// every time because 1) some timeout handler may have removed/added
 		// sockets, and 2) it ain't that expensive....
-		selector.reset();
-		min_deadline = 0;
-		for (i = 0; i < nSock; i++) {
-				// NOTE: keep the following logic for building the
-				// fdset in sync with DaemonCore::ServiceCommandSocket()
-
-				// if a valid entry not already being serviced, add to select
-			if ( (*sockTable)[i].iosock && 
-				 (*sockTable)[i].servicing_tid==0 &&
-				 (*sockTable)[i].remove_asap == false ) {	
-					// Setup our fdsets
-				if ( (*sockTable)[i].is_reverse_connect_pending ) {
-					// nothing to do; we are just allowing this socket
-					// to be registered so that it behaves like a socket
-					// that is doing a non-blocking connect
-					// CCBClient will eventually ensure that the
-					// socket's registered callback function is called
-					// We want to ignore the socket's deadline (below)
-					// because that is all taken care of by CCBClient.
-					continue;
-				}
-				else if ( (*sockTable)[i].is_connect_pending ) {
-						// we want to be woken when a non-blocking
-						// connect is ready to write.  when connect
-						// is ready, select will set the writefd set
-						// on success, or the exceptfd set on failure.
-					selector.add_fd( (*sockTable)[i].iosock->get_file_desc(), Selector::IO_WRITE );
-					selector.add_fd( (*sockTable)[i].iosock->get_file_desc(), Selector::IO_EXCEPT );
-				} else {
-					int sockfd = (*sockTable)[i].iosock->get_file_desc();
-					switch( (*sockTable)[i].handler_type ) {
-					case HANDLE_READ:
-						selector.add_fd( sockfd, Selector::IO_READ );
-						break;
-					case HANDLE_WRITE:
-						selector.add_fd( sockfd, Selector::IO_WRITE );
-						break;
-					case HANDLE_READ_WRITE:
-						selector.add_fd( sockfd, Selector::IO_READ );
-						selector.add_fd( sockfd, Selector::IO_WRITE );
-						break;
-					}
-				}
-
-					// If this socket times out sooner than
-					// our select timeout, adjust the select timeout.
-				time_t deadline = (*sockTable)[i].iosock->get_deadline();
-				if(deadline) { // If non-zero, there is a timeout.
-					if(min_deadline == 0 || min_deadline > deadline) {
-						min_deadline = deadline;
-					}
-				}
-            }
+		// With epoll, the kernel keeps our registrations, so we only need
+		// to do it when the socket or pipe tables changed, when an fd we
+		// had registered was closed, or once a second to notice sockets
+		// whose deadline changed.
+		bool interest_skipped = false;
+		time_t interest_now = time(NULL);
+		if ( ! selector.is_persistent() || m_selector_interest_changed ||
+			 selector.forgot_fds() || interest_now != last_interest_time ||
+			 ( min_deadline && min_deadline <= interest_now ) )
+		{
+			m_selector_interest_changed = false;
+			last_interest_time = interest_now;
+			SetupSelector( selector, min_deadline );
+		} else {
+			interest_skipped = true;
 		}
 
 		if( min_deadline ) {
@@ -3573,40 +3682,12 @@ void DaemonCore::Driver()
 			}
 		}
 
-#if !defined(WIN32)
-		// Add the registered pipe fds into the list of descriptors to
-		// select on.
-		for (i = 0; i < nPipe; i++) {
-			if ( (*pipeTable)[i].index != -1 ) {	// if a valid entry....
-				int pipefd = (*pipeHandleTable)[(*pipeTable)[i].index];
-				switch( (*pipeTable)[i].handler_type ) {
-				case HANDLE_READ:
-					selector.add_fd( pipefd, Selector::IO_READ );
-					break;
-				case HANDLE_WRITE:
-					selector.add_fd( pipefd, Selector::IO_WRITE );
-					break;
-				case HANDLE_READ_WRITE:
-					selector.add_fd( pipefd, Selector::IO_READ );
-					selector.add_fd( pipefd, Selector::IO_WRITE );
-					break;
-				}
-			}
-        }
-#endif
-
+		if ( interest_skipped && timeout > 1 ) {
+				// a handler may have given a socket a deadline we
+				// haven't seen yet; look again within a second.
+			timeout = 1;
+		}
 
-		// Add the read side of async_pipe to the list of file descriptors to
-		// select on.  We write to async_pipe if a unix async signal
-		// is delivered after we unblock signals and before we block on select.
-#ifdef WIN32
-		if ( ! async_pipe[0].is_connected()) {
-			EXCEPT("DaemonCore:: async_pipe has been unexpectedly closed!");
-		} 
-		selector.add_fd( async_pipe[0].get_file_desc() , Selector::IO_READ );
-#else
-		selector.add_fd( async_pipe[0], Selector::IO_READ );
-#endif
 
 		// Let other threads run while we are waiting on select
 		CondorThreads::enable_parallel(true);
@@ -3752,8 +3833,32 @@ void DaemonCore::Driver()
 				dprintf(D_ALWAYS,"Received a superuser command\n");
 			}
 
+			// With epoll, we only need to look at the entries whose fd is
+			// ready or whose deadline may have passed, not the whole table.
+			bool scan_ready_only = selector.is_persistent();
+			int nScan = nSock;
+			if ( scan_ready_only ) {
+				m_sock_ready_index.clear();
+				const std::vector<int> &ready_fds = selector.ready_fds();
+				for ( size_t r = 0; r < ready_fds.size(); r++ ) {
+					int fd = ready_fds[r];
+					if ( fd < (int)m_sock_index_by_fd.size() && m_sock_index_by_fd[fd] >= 0 ) {
+						m_sock_ready_index.push_back( m_sock_index_by_fd[fd] );
+					}
+				}
+				if ( min_deadline && min_deadline < now ) {
+					m_sock_ready_index.insert( m_sock_ready_index.end(),
+						m_sock_deadline_index.begin(), m_sock_deadline_index.end() );
+				}
+				std::sort( m_sock_ready_index.begin(), m_sock_ready_index.end() );
+				m_sock_ready_index.erase( std::unique( m_sock_ready_index.begin(),
+					m_sock_ready_index.end() ), m_sock_ready_index.end() );
+				nScan = (int)m_sock_ready_index.size();
+			}
+
 			// scan through the socket table to find which ones select() set
-			for(i = 0; i < nSock; i++) {
+			for(int scan = 0; scan < nScan; scan++) {
+				i = scan_ready_only ? m_sock_ready_index[scan] : scan;
 				if ( (*sockTable)[i].iosock && 
 					 (*sockTable)[i].servicing_tid==0 &&
 					 (*sockTable)[i].remove_asap == false ) 
@@ -3882,11 +3987,11 @@ void DaemonCore::Driver()
 #else
 							// UNIX
 							int pipefd = (*pipeHandleTable)[(*pipeTable)[i].index];
-							selector.reset();
-							selector.set_timeout( 0 );
-							selector.add_fd( pipefd, Selector::IO_READ );
-							selector.execute();
-							if ( selector.timed_out() ) {
+							recheck_selector.reset();
+							recheck_selector.set_timeout( 0 );
+							recheck_selector.add_fd( pipefd, Selector::IO_READ );
+							recheck_selector.execute();
+							if ( recheck_selector.timed_out() ) {
 								// nothing available, try the next entry...
 								continue;
 							}
@@ -3960,7 +4065,11 @@ void DaemonCore::Driver()
 			group_runtime = runtime;
 
 			// Now loop through all sock entries, calling handlers if required.
-			for(i = 0; i < nSock; i++) {
+			if ( ! scan_ready_only ) {
+				nScan = nSock;
+			}
+			for(int scan = 0; scan < nScan; scan++) {
+				i = scan_ready_only ? m_sock_ready_index[scan] : scan;
 				if ( (*sockTable)[i].iosock ) {	// if a valid entry...
 
 					if ( (*sockTable)[i].call_handler ) {
@@ -3977,13 +4086,13 @@ void DaemonCore::Driver()
 							// read on the pipe could block?  to prevent this, we need
 							// to check one more time to make certain the pipe is ready
 							// for reading.
-							selector.reset();
-							selector.set_timeout( 0 );// set timeout for a poll
-							selector.add_fd( (*sockTable)[i].iosock->get_file_desc(),
+							recheck_selector.reset();
+							recheck_selector.set_timeout( 0 );// set timeout for a poll
+							recheck_selector.add_fd( (*sockTable)[i].iosock->get_file_desc(),
 											 Selector::IO_READ );
 
-							selector.execute();
-							if ( selector.timed_out() ) {
+							recheck_selector.execute();
+							if ( recheck_selector.timed_out() ) {
 								// nothing available, try the next entry...
 								continue;
 							}
@@ -4153,6 +4262,7 @@ DaemonCore::CallSocketHandler( int &i, bool default_to_HandleCommand )
 		    // setup pointer (pTid) to pass to pool_add - thus servicing_tid will be
 		    // set to the tid value BEFORE pool_add() yields.
 		    pTid = &((*sockTable)[i].servicing_tid);
+		    m_selector_interest_changed = true;
 	    }
 	    CondorThreads::pool_add(DaemonCore::CallSocketHandler_worker_demarshall,args,
 								    pTid,(*sockTable)[i].handler_descrip);
@@ -4256,6 +4366,7 @@ DaemonCore::CallSocketHandler_worker( int i, bool default_to_HandleCommand, Stre
 		{
 				(*sockTable)[i].servicing_tid = 0;
 				// need to potentially add this sock to select
+				m_selector_interest_changed = true;
 				daemonCore->Wake_up_select();	
 		}
 	}
@@ -40,6 +40,7 @@
 #include "exit.h"
 #include "match_prefix.h"
 #include "historyFileFinder.h"
+#include "history_archive.h"
 #include "store_cred.h"
 #include "condor_netaddr.h"
 #include "net_string_list.h"
@@ -1750,6 +1751,20 @@ handle_fetch_log_history(ReliSock *stream, char *name) {
 
 	for (int f = 0; f < numHistoryFiles; f++) {
 		filesize_t size;
+		if (IsHistoryArchive(historyFiles[f])) {
+			// send archives in the text form, like the rest of the history
+			std::string errmsg;
+			FILE *fp = tmpfile();
+			if ( ! fp || ! WriteHistoryArchiveAsText(historyFiles[f], fp, errmsg) || fflush(fp) != 0) {
+				dprintf(D_ALWAYS, "DaemonCore: handle_fetch_log_history: can't read history archive %s: %s\n",
+					historyFiles[f], errmsg.c_str());
+			} else {
+				rewind(fp);
+				stream->put_file(&size, fileno(fp));
+			}
+			if (fp) fclose(fp);
+			continue;
+		}
 		stream->put_file(&size, historyFiles[f]);
 	}
 	freeHistoryFilesList(historyFiles);
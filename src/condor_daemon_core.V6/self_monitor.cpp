@@ -206,6 +206,14 @@ void DaemonCore::Stats::SetWindowSize(int window)
 #define DC_STATS_ADD_RECENT(pool,name,as)  STATS_POOL_ADD_VAL_PUB_RECENT(pool, "DC", name, as) 
 #define DC_STATS_PUB_DEBUG(pool,name,as)   STATS_POOL_PUB_DEBUG(pool, "DC", name, as) 
 
+// CEDAR compression stats, kept by condor_io
+extern stats_entry_recent<int64_t> cedar_compress_bytes_in;    // bytes given to CEDAR to compress
+extern stats_entry_recent<int64_t> cedar_compress_bytes_out;   // bytes they were compressed to
+extern stats_entry_recent<int64_t> cedar_decompress_bytes_in;  // compressed bytes received by CEDAR
+extern stats_entry_recent<int64_t> cedar_decompress_bytes_out; // bytes they were decompressed to
+extern stats_entry_recent<Probe> cedar_compress_runtime;       // count & runtime of compressing packets
+extern stats_entry_recent<Probe> cedar_decompress_runtime;     // count & runtime of decompressing packets
+
 // this is for first time initialization before calling SetWindowSize,
 // use the Clear() method to reset stats after the window size has been set.
 //
@@ -245,6 +253,15 @@ void DaemonCore::Stats::Init(bool enable)
    extern stats_entry_probe<double> condor_fsync_runtime;
    Pool.AddProbe("DCfsync", &condor_fsync_runtime, "DCfsync", IF_VERBOSEPUB | IF_RT_SUM);
 
+   const int bytes_flags = stats_entry_recent<int64_t>::PubValueAndRecent;
+   const int runtime_flags = ProbeDetailMode_RT_SUM | stats_entry_recent<Probe>::PubValueAndRecent;
+   Pool.AddProbe("DCCedarCompressBytesIn",    &cedar_compress_bytes_in,    NULL, IF_BASICPUB | bytes_flags);
+   Pool.AddProbe("DCCedarCompressBytesOut",   &cedar_compress_bytes_out,   NULL, IF_BASICPUB | bytes_flags);
+   Pool.AddProbe("DCCedarDecompressBytesIn",  &cedar_decompress_bytes_in,  NULL, IF_BASICPUB | bytes_flags);
+   Pool.AddProbe("DCCedarDecompressBytesOut", &cedar_decompress_bytes_out, NULL, IF_BASICPUB | bytes_flags);
+   Pool.AddProbe("DCCedarCompress",   &cedar_compress_runtime,   NULL, IF_BASICPUB | runtime_flags);
+   Pool.AddProbe("DCCedarDecompress", &cedar_decompress_runtime, NULL, IF_BASICPUB | runtime_flags);
+
 #if 1
    //PRAGMA_REMIND("temporarily!! publish recent windowed values for DNS lookup runtime...")
    extern stats_entry_recent<Probe> getaddrinfo_runtime; // count & runtime of all lookups, success and fail
@@ -353,6 +370,19 @@ void DaemonCore::Stats::Publish(ClassAd & ad, int flags) const
    }
    ad.Assign("RecentDaemonCoreDutyCycle", dDutyCycle);
 
+   // how many times smaller CEDAR compression made what this daemon
+   // sent and received, if it compressed anything
+   int64_t wire_bytes = cedar_compress_bytes_out.value + cedar_decompress_bytes_in.value;
+   if (wire_bytes > 0) {
+      ad.Assign("DCCedarCompressionRatio",
+         (double)(cedar_compress_bytes_in.value + cedar_decompress_bytes_out.value) / wire_bytes);
+   }
+   wire_bytes = cedar_compress_bytes_out.recent + cedar_decompress_bytes_in.recent;
+   if (wire_bytes > 0 && (flags & IF_RECENTPUB)) {
+      ad.Assign("RecentDCCedarCompressionRatio",
+         (double)(cedar_compress_bytes_in.recent + cedar_decompress_bytes_out.recent) / wire_bytes);
+   }
+
    Pool.Publish(ad, flags);
 }
 
@@ -365,6 +395,8 @@ void DaemonCore::Stats::Unpublish(ClassAd & ad) const
    ad.Delete("DCRecentWindowMax");
    ad.Delete("DaemonCoreDutyCycle");
    ad.Delete("RecentDaemonCoreDutyCycle");
+   ad.Delete("DCCedarCompressionRatio");
+   ad.Delete("RecentDCCedarCompressionRatio");
    Pool.Unpublish(ad);
 }
 
@@ -24,7 +24,7 @@
 #include "condor_debug.h"
 #include "condor_daemon_core.h"
 #include "condor_config.h"
-#include <unordered_set>
+#include <algorithm>
 
 static const char* DEFAULT_INDENT = "DaemonCore--> ";
 
@@ -52,8 +52,8 @@ TimerManager::TimerManager()
 	{
 		EXCEPT("TimerManager object exists!");
 	}
-	timer_list = NULL;
-	list_tail = NULL;
+	timer_seq = 0;
+	defer_inserts = false;
 	timer_ids = 0;
 	in_timeout = NULL;
 	_t = this; 
@@ -136,6 +136,8 @@ int TimerManager::NewTimer(Service* s, unsigned deltawhen,
 	new_timer->releasecpp = releasecpp;
 	new_timer->period = period;
 	new_timer->service = s; 
+	new_timer->heap_index = TIMER_NOT_QUEUED;
+	new_timer->seq = 0;
 
 	if( timeslice ) {
 		new_timer->timeslice = new Timeslice( *timeslice );
@@ -185,7 +187,7 @@ bool TimerManager::ResetTimerTimeslice(int id, Timeslice const &new_timeslice)
 
 bool TimerManager::GetTimerTimeslice(int id, Timeslice &timeslice)
 {
-	Timer *timer_ptr = GetTimer( id, NULL );
+	Timer *timer_ptr = GetTimer( id );
 	if( !timer_ptr || !timer_ptr->timeslice ) {
 		return false;
 	}
@@ -195,7 +197,7 @@ bool TimerManager::GetTimerTimeslice(int id, Timeslice &timeslice)
 
 time_t TimerManager::GetNextRuntime(int id)
 {
-	Timer *timer_ptr = GetTimer( id, NULL );
+	Timer *timer_ptr = GetTimer( id );
 	if (!timer_ptr) { return false; }
 
 	return timer_ptr->when;
@@ -205,22 +207,15 @@ int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 							 Timeslice const *new_timeslice)
 {
 	Timer*			timer_ptr;
-	Timer*			trail_ptr;
 
 	dprintf( D_DAEMONCORE,
 			 "In reset_timer(), id=%d, time=%d, period=%d\n",id,when,period);
-	if (timer_list == NULL) {
+	if (timer_index.empty()) {
 		dprintf( D_DAEMONCORE, "Reseting Timer from empty list!\n");
 		return -1;
 	}
 
-	timer_ptr = timer_list;
-	trail_ptr = NULL;
-	while ( timer_ptr && timer_ptr->id != id ) {
-		trail_ptr = timer_ptr;
-		timer_ptr = timer_ptr->next;
-	}
-
+	timer_ptr = GetTimer( id );
 	if ( timer_ptr == NULL ) {
 		dprintf( D_ALWAYS, "Timer %d not found\n",id );
 		return -1;
@@ -278,7 +273,7 @@ int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 	}
 	timer_ptr->period = period;
 
-	RemoveTimer( timer_ptr, trail_ptr );
+	RemoveTimer( timer_ptr );
 	InsertTimer( timer_ptr );
 
 	if ( in_timeout == timer_ptr ) {
@@ -293,27 +288,20 @@ int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 int TimerManager::CancelTimer(int id)
 {
 	Timer*		timer_ptr;
-	Timer*		trail_ptr;
 
 	dprintf( D_DAEMONCORE, "In cancel_timer(), id=%d\n",id);
-	if (timer_list == NULL) {
+	if (timer_index.empty()) {
 		dprintf( D_DAEMONCORE, "Removing Timer from empty list!\n");
 		return -1;
 	}
 
-	timer_ptr = timer_list;
-	trail_ptr = NULL;
-	while ( timer_ptr && timer_ptr->id != id ) {
-		trail_ptr = timer_ptr;
-		timer_ptr = timer_ptr->next;
-	}
-
+	timer_ptr = GetTimer( id );
 	if ( timer_ptr == NULL ) {
 		dprintf( D_ALWAYS, "Timer %d not found\n",id );
 		return -1;
 	}
 
-	RemoveTimer( timer_ptr, trail_ptr );
+	RemoveTimer( timer_ptr );
 
 	if ( in_timeout == timer_ptr ) {
 		// We're inside the handler for this timer. Don't delete it,
@@ -329,11 +317,15 @@ int TimerManager::CancelTimer(int id)
 
 void TimerManager::CancelAllTimers()
 {
-	Timer		*timer_ptr;
-
-	while( timer_list != NULL ) {
-		timer_ptr = timer_list;
-		timer_list = timer_list->next;
+	std::vector<Timer*> timers;
+	timers.swap( timer_heap );
+	timers.insert( timers.end(), deferred_timers.begin(), deferred_timers.end() );
+	deferred_timers.clear();
+	timer_index.clear();
+
+	for( size_t i = 0; i < timers.size(); i++ ) {
+		Timer *timer_ptr = timers[i];
+		timer_ptr->heap_index = TIMER_NOT_QUEUED;
 		if( in_timeout == timer_ptr ) {
 				// We get here if somebody calls exit from inside a timer.
 			did_cancel = true;
@@ -342,8 +334,6 @@ void TimerManager::CancelAllTimers()
 			DeleteTimer( timer_ptr );
 		}
 	}
-	timer_list = NULL;
-	list_tail = NULL;
 }
 
 // Timeout() is called when a select() time out.  Returns number of seconds
@@ -361,10 +351,10 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 
 	if ( in_timeout != NULL ) {
 		dprintf(D_DAEMONCORE,"DaemonCore Timeout() called and in_timeout is non-NULL\n");
-		if ( timer_list == NULL ) {
+		if ( timer_index.empty() ) {
 			result = 0;
 		} else {
-			result = (timer_list->when) - time(NULL);
+			result = NextTimerWhen() - time(NULL);
 		}
 		if ( result < 0 ) {
 			result = 0;
@@ -374,7 +364,7 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 		
 	dprintf( D_DAEMONCORE, "In DaemonCore Timeout()\n");
 
-	if (timer_list == NULL) {
+	if (timer_index.empty()) {
 		dprintf( D_DAEMONCORE, "Empty timer list, nothing to do\n" );
 	}
 
@@ -383,63 +373,26 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 	DumpTimerList(D_DAEMONCORE | D_FULLDEBUG);
 
     // if we are going to not limit the number of timer handlers we invoke,
-    // make a set now of all timers that are ready to go... below we will
-    // use this set in order to NOT invoke new timers that are inserted by
-    // timer handlers themselves.
-    std::unordered_set<int> readyTimerIds;
-    if (max_timer_events_per_cycle == INT_MAX) {
-        in_timeout = timer_list;
-        while ((in_timeout != NULL) && (in_timeout->when <= now)) {
-            readyTimerIds.insert(in_timeout->id);
-            in_timeout = in_timeout->next;
-        }
-        in_timeout = NULL;
+    // hold back the timers that the handlers add or reset until we are done,
+    // so that we only invoke the timers that were ready to go when we started
+    // and don't get stuck here forever.
+    bool defer = (max_timer_events_per_cycle == INT_MAX);
+    if (defer) {
+        defer_inserts = true;
     }
 
 	// loop until all handlers that should have been called by now or before
 	// are invoked and renewed if periodic.  Remember that NewTimer and CancelTimer
-	// keep the timer_list happily sorted on "when" for us.  We use "now" as a 
+	// keep the timer_heap ordered on "when" for us.  We use "now" as a 
 	// variable so that if some of these handler functions run for a long time,
 	// we do not sit in this loop forever.
 	// we make certain we do not call more than "max_fires" handlers in a 
 	// single timeout --- this ensures that timers don't starve out the rest
 	// of daemonCore if a timer handler resets itself to 0.
-	while( (timer_list != NULL) && (timer_list->when <= now ) &&
+	while( !timer_heap.empty() && (timer_heap[0]->when <= now ) &&
 		   (num_fires < max_timer_events_per_cycle))
 	{
-        in_timeout = timer_list;
-
-        // In this code block, if there is no limit on how many timer handlers we will invoke,
-        // we want to skip over timers that got  added or reset by other timer handlers to make
-        // certain we aren't stuck here forever. So we will only call timer handlers that
-        // were ready to fire when we first entered Timeout().
-        if (max_timer_events_per_cycle == INT_MAX) {
-            std::unordered_set<int>::iterator it;
-            bool call_handler = false;
-            // Skip handlers already invoked or added
-            do {
-                it = readyTimerIds.find(in_timeout->id);
-                if (it == readyTimerIds.end()) {
-                    // this timer was not ready when we first looked, so it must have been
-                    // added or reset by another timer callback.  in this case, skip this timer
-                    // callback (we will deal with it next time through the daemoncore loop).
-                    dprintf(D_DAEMONCORE, "Timer %d not fired (SKIPPED) cause added\n", in_timeout->id);
-                    in_timeout = in_timeout->next;
-                }
-                else {
-                    // this timer was ready to fire when we first looked at the timer list, so
-                    // we are going to go ahead and call its handler.  Erase it from our readyTimerIds
-                    // list, and then break out of loop to go ahead and call the handler.
-                    call_handler = true;
-                    readyTimerIds.erase(it);
-                }
-            } while ((!call_handler) && (in_timeout != NULL) && (in_timeout->when <= now));
-
-            if (!call_handler) {
-                // no timers left that we want to fire at this time, break out of outer while loop
-                break;
-            }
-        }  // end of block if max_timer_events_per_cycle == INT_MAX
+        in_timeout = timer_heap[0];
 
         num_fires++;
 
@@ -489,12 +442,14 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 			}
 		}
 
-		if (pruntime) {           
-			*pruntime = daemonCore->dc_stats.AddRuntime(in_timeout->event_descrip, *pruntime);
-		}
+		if (daemonCore) {
+			if (pruntime) {
+				*pruntime = daemonCore->dc_stats.AddRuntime(in_timeout->event_descrip, *pruntime);
+			}
 
-        // Make sure we didn't leak our priv state
-		daemonCore->CheckPrivState();
+			// Make sure we didn't leak our priv state
+			daemonCore->CheckPrivState();
+		}
 
 		// Clear curr_dataptr
 		curr_dataptr = NULL;
@@ -505,17 +460,11 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 			DeleteTimer( in_timeout );
 		} else if ( !did_reset ) {
 			// here we remove the timer we just serviced, or renew it if it is 
-			// periodic.
-
-			// If a new timer was added at a time in the past
-			// (possible when resetting a timeslice timer), then
-			// it may have landed before the timer we just processed,
-			// meaning that we cannot assume prev==NULL in the call
-			// to RemoveTimer() below.
+			// periodic.  It may no longer be the first timer, if the
+			// handler added one that is due even sooner.
 
-			Timer *prev = NULL;
-			ASSERT( GetTimer(in_timeout->id,&prev) == in_timeout );
-			RemoveTimer( in_timeout, prev );
+			ASSERT( GetTimer(in_timeout->id) == in_timeout );
+			RemoveTimer( in_timeout );
 
 			if ( in_timeout->period > 0 || in_timeout->timeslice ) {
 				in_timeout->period_started = time(NULL);
@@ -538,23 +487,26 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 		}
 	}  // end of while loop
 
+	in_timeout = NULL;
+	if (defer) {
+		InsertDeferredTimers();
+	}
 
 	// set result to number of seconds until next event.  get an update on the
 	// time from time() in case the handlers we called above took significant time.
-	if ( timer_list == NULL ) {
+	if ( timer_index.empty() ) {
 		// we set result to be -1 so that we do not busy poll.
 		// a -1 return value will tell the DaemonCore:Driver to use select with
 		// no timeout.
 		result = -1;
 	} else {
-		result = (timer_list->when) - time(NULL);
+		result = NextTimerWhen() - time(NULL);
 		if (result < 0)
 			result = 0;
 	}
 
 	dprintf( D_DAEMONCORE, "DaemonCore Timeout() Complete, returning %d \n",result);
     if (pNumFired) *pNumFired = num_fires;
-	in_timeout = NULL;
 	return(result);
 }
 
@@ -563,7 +515,6 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 
 void TimerManager::DumpTimerList(int flag, const char* indent)
 {
-	Timer		*timer_ptr;
 	const char	*ptmp;
 
 	// we want to allow flag to be "D_FULLDEBUG | D_DAEMONCORE",
@@ -577,11 +528,16 @@ void TimerManager::DumpTimerList(int flag, const char* indent)
 	if ( indent == NULL) 
 		indent = DEFAULT_INDENT;
 
+	std::vector<Timer*> timers( timer_heap );
+	timers.insert( timers.end(), deferred_timers.begin(), deferred_timers.end() );
+	std::sort( timers.begin(), timers.end(), TimerBefore );
+
 	dprintf(flag, "\n");
 	dprintf(flag, "%sTimers\n", indent);
 	dprintf(flag, "%s~~~~~~\n", indent);
-	for(timer_ptr = timer_list; timer_ptr != NULL; timer_ptr = timer_ptr->next)
+	for(size_t i = 0; i < timers.size(); i++)
 	{
+		Timer *timer_ptr = timers[i];
 		if ( timer_ptr->event_descrip )
 			ptmp = timer_ptr->event_descrip;
 		else
@@ -648,69 +604,144 @@ void TimerManager::Start()
 	}
 }
 
-void TimerManager::RemoveTimer( Timer *timer, Timer *prev )
+void TimerManager::RemoveTimer( Timer *timer )
 {
-	if ( timer == NULL || ( prev && prev->next != timer ) ||
-		 ( !prev && timer != timer_list ) ) {
+	if ( timer == NULL ) {
 		EXCEPT( "Bad call to TimerManager::RemoveTimer()!" );
 	}
 
-	if ( timer == timer_list ) {
-		timer_list = timer_list->next;
+	if ( timer->heap_index == TIMER_DEFERRED ) {
+		std::vector<Timer*>::iterator it =
+			std::find( deferred_timers.begin(), deferred_timers.end(), timer );
+		if ( it == deferred_timers.end() ) {
+			EXCEPT( "Bad call to TimerManager::RemoveTimer()!" );
+		}
+		deferred_timers.erase( it );
+	} else {
+		size_t pos = (size_t)timer->heap_index;
+		if ( timer->heap_index < 0 || pos >= timer_heap.size() ||
+			 timer_heap[pos] != timer ) {
+			EXCEPT( "Bad call to TimerManager::RemoveTimer()!" );
+		}
+
+			// fill the hole with the last timer and restore the heap order
+		Timer *last = timer_heap.back();
+		timer_heap.pop_back();
+		if ( last != timer ) {
+			HeapPlace( last, pos );
+			if ( pos > 0 && TimerBefore( last, timer_heap[(pos - 1) / 2] ) ) {
+				HeapSiftUp( pos );
+			} else {
+				HeapSiftDown( pos );
+			}
+		}
 	}
-	if ( timer == list_tail ) {
-		list_tail = prev;
+
+	timer->heap_index = TIMER_NOT_QUEUED;
+	timer_index.erase( timer->id );
+}
+
+void TimerManager::InsertTimer( Timer *new_timer )
+{
+		// The sequence number puts a timer after every other timer with
+		// the same "when", which makes certain we "round-robin" across
+		// timers that constantly reset themselves to zero.
+	new_timer->seq = timer_seq++;
+	timer_index[new_timer->id] = new_timer;
+
+	if ( defer_inserts ) {
+		new_timer->heap_index = TIMER_DEFERRED;
+		deferred_timers.push_back( new_timer );
+		return;
 	}
-	if ( prev ) {
-		prev->next = timer->next;
+
+	HeapPush( new_timer );
+}
+
+void TimerManager::InsertDeferredTimers()
+{
+	defer_inserts = false;
+
+	std::vector<Timer*> timers;
+	timers.swap( deferred_timers );
+	for ( size_t i = 0; i < timers.size(); i++ ) {
+		HeapPush( timers[i] );
 	}
 }
 
-void TimerManager::InsertTimer( Timer *new_timer )
+time_t TimerManager::NextTimerWhen()
 {
-	if ( timer_list == NULL ) {
-		// list is empty, place ours in front
-		timer_list = new_timer;
-		list_tail = new_timer;
-		new_timer->next = NULL;
+	time_t when = TIME_T_NEVER;
+	if ( !timer_heap.empty() ) {
+		when = timer_heap[0]->when;
+	}
+	for ( size_t i = 0; i < deferred_timers.size(); i++ ) {
+		if ( deferred_timers[i]->when < when ) {
+			when = deferred_timers[i]->when;
+		}
+	}
+	return when;
+}
+
+bool TimerManager::TimerBefore( const Timer *a, const Timer *b )
+{
+	if ( a->when != b->when ) {
+		return a->when < b->when;
+	}
+	return a->seq < b->seq;
+}
+
+void TimerManager::HeapPush( Timer *timer )
+{
+	timer_heap.push_back( timer );
+	HeapPlace( timer, timer_heap.size() - 1 );
+	HeapSiftUp( timer_heap.size() - 1 );
+
+	if ( timer->heap_index == 0 && daemonCore ) {
 			// since we have a new first timer, we must wake up select
 		daemonCore->Wake_up_select();
-	} else {
-		// list is not empty, so keep timer_list ordered from soonest to
-		// farthest (i.e. sorted on "when").
-		// Note: when doing the comparisons, we always use "<" instead
-		// of "<=" -- this makes certain we "round-robin" across 
-		// timers that constantly reset themselves to zero.
-		if ( new_timer->when < timer_list->when ) {
-			// make the this new timer first in line
-			new_timer->next = timer_list;
-			timer_list = new_timer;
-			// since we have a new first timer, we must wake up select
-			daemonCore->Wake_up_select();
-		} else if ( new_timer->when == TIME_T_NEVER ) {
-			// Our new timer goes to the very back of the list.
-			new_timer->next = NULL;
-			list_tail->next = new_timer;
-			list_tail = new_timer;
-		} else {
-			Timer* timer_ptr;
-			Timer* trail_ptr = NULL;
-			for (timer_ptr = timer_list; timer_ptr != NULL; 
-				 timer_ptr = timer_ptr->next ) 
-			{
-				if (new_timer->when < timer_ptr->when) {
-					break;
-				}
-				trail_ptr = timer_ptr;
-			}
-			ASSERT( trail_ptr );
-			new_timer->next = timer_ptr;
-			trail_ptr->next = new_timer;
-			if ( trail_ptr == list_tail ) {
-				list_tail = new_timer;
-			}
+	}
+}
+
+void TimerManager::HeapPlace( Timer *timer, size_t pos )
+{
+	timer_heap[pos] = timer;
+	timer->heap_index = (int)pos;
+}
+
+void TimerManager::HeapSiftUp( size_t pos )
+{
+	Timer *timer = timer_heap[pos];
+	while ( pos > 0 ) {
+		size_t parent = (pos - 1) / 2;
+		if ( !TimerBefore( timer, timer_heap[parent] ) ) {
+			break;
 		}
+		HeapPlace( timer_heap[parent], pos );
+		pos = parent;
 	}
+	HeapPlace( timer, pos );
+}
+
+void TimerManager::HeapSiftDown( size_t pos )
+{
+	Timer *timer = timer_heap[pos];
+	size_t count = timer_heap.size();
+	for (;;) {
+		size_t child = 2 * pos + 1;
+		if ( child >= count ) {
+			break;
+		}
+		if ( child + 1 < count && TimerBefore( timer_heap[child + 1], timer_heap[child] ) ) {
+			child++;
+		}
+		if ( !TimerBefore( timer_heap[child], timer ) ) {
+			break;
+		}
+		HeapPlace( timer_heap[child], pos );
+		pos = child;
+	}
+	HeapPlace( timer, pos );
 }
 
 void TimerManager::DeleteTimer( Timer *timer )
@@ -735,18 +766,11 @@ void TimerManager::DeleteTimer( Timer *timer )
 	delete timer;
 }
 
-Timer *TimerManager::GetTimer( int id, Timer **prev )
+Timer *TimerManager::GetTimer( int id )
 {
-	Timer *timer_ptr = timer_list;
-	if( prev ) {
-		*prev = NULL;
-	}
-	while ( timer_ptr && timer_ptr->id != id ) {
-		if( prev ) {
-			*prev = timer_ptr;
-		}
-		timer_ptr = timer_ptr->next;
+	std::unordered_map<int,Timer*>::iterator it = timer_index.find( id );
+	if ( it == timer_index.end() ) {
+		return NULL;
 	}
-
-	return timer_ptr;
+	return it->second;
 }
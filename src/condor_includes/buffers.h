@@ -32,6 +32,7 @@ void sanity_check();
 #endif /* not WIN32 */
 
 class Condor_MD_MAC;
+class Condor_Compress;
 
 class Buf {
 	
@@ -82,6 +83,18 @@ public:
         bool computeMD(char * checkSUM, Condor_MD_MAC * checker);
         bool verifyMD(char * checkSUM, Condor_MD_MAC * checker);
 
+		// Encrypt/decrypt the packet data in place with the socket's
+		// authenticated cipher, which puts/finds its tag and nonce in
+		// the packet header.  See Sock::seal_packet().
+	bool seal(char * hdr, int header_size, Sock * sock);
+	bool open(const char * hdr, Sock * sock);
+
+		// Compress the packet data into out, after header_size bytes
+		// of room for the header, or decompress it into out, which may
+		// grow up to max_size.  See ReliSock::set_compression().
+	bool compress(int header_size, Buf & out, Condor_Compress * compressor);
+	bool decompress(Buf & out, int max_size, Condor_Compress * compressor);
+
 	void swap(Buf &);
 
 private:
@@ -861,6 +861,8 @@
 #define ATTR_SEC_AUTHENTICATION_METHODS_LIST  "AuthMethodsList"
 #define ATTR_SEC_AUTHENTICATION_METHODS  "AuthMethods"
 #define ATTR_SEC_CRYPTO_METHODS  "CryptoMethods"
+#define ATTR_SEC_COMPRESSION  "Compression"
+#define ATTR_SEC_COMPRESSION_METHODS  "CompressionMethods"
 #define ATTR_SEC_AUTHENTICATION  "Authentication"
 #define ATTR_SEC_AUTH_REQUIRED  "AuthRequired"
 #define ATTR_SEC_ENCRYPTION  "Encryption"
@@ -1092,6 +1094,10 @@ extern const char ATTR_SEC_AUTHENTICATED_USER [];
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE2_CPU_TIME  "LastNegotiationCyclePhase2CpuTime"
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE3_CPU_TIME  "LastNegotiationCyclePhase3CpuTime"
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE4_CPU_TIME  "LastNegotiationCyclePhase4CpuTime"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_DURATION  "LastNegotiationCycleMatchmakingDuration"
+#define ATTR_LAST_NEGOTIATION_CYCLE_PARALLEL_MATCH_DURATION  "LastNegotiationCycleParallelMatchDuration"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_HITS  "LastNegotiationCycleMatchCacheHits"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_MISSES  "LastNegotiationCycleMatchCacheMisses"
 
 #define ATTR_JOB_MACHINE_ATTRS  "JobMachineAttrs"
 #define ATTR_MACHINE_ATTR_PREFIX  "MachineAttr"
@@ -188,6 +188,7 @@ NAMETABLE_DIRECTIVE:TABLE:DCTranslation
 // Get the SubmitterCeiling
 #define GET_CEILING (SCHED_VERS+124)
 #define SET_CEILING (SCHED_VERS+125)
+#define MULTI_JOB_SHADOW_SYNC (SCHED_VERS+126) // schedd: report job exits and get new jobs for a multi-job shadow
 
 
 // values used for "HowFast" in the draining request
@@ -348,6 +349,9 @@ const int UPDATE_OWN_SUBMITTOR_AD = 80;
 // Request a collector to retrieve an identity token from a schedd.
 const int IMPERSONATION_TOKEN_REQUEST = 81;
 
+// Startd ad containing only the attributes that changed since the previous update
+const int UPDATE_STARTD_AD_DELTA = 82;
+
 /* these comments are used to control command_table_generator.pl
 NAMETABLE_DIRECTIVE:END_SECTION:collector
 */
@@ -476,6 +480,7 @@ NAMETABLE_DIRECTIVE:END_SECTION:collector
 #define GIVE_MATCHES 	       (DCSHADOW_BASE+3)  // for MPI & parallel shadow
 //#define RECEIVE_JOBAD		   (DCSHADOW_BASE+4)	/* Not used */
 #define UPDATE_JOBAD		   (DCSHADOW_BASE+5)
+#define MULTI_JOB_SHADOW_WAKEUP (DCSHADOW_BASE+6)  // multi-job shadow: the schedd has work for it
 
 
 /*
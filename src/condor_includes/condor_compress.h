@@ -0,0 +1,68 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef CONDOR_COMPRESS_H
+#define CONDOR_COMPRESS_H
+
+#include "condor_common.h"
+
+typedef struct z_stream_s z_stream;
+
+// Stream compression for a CEDAR connection.  ReliSock compresses each
+// packet it sends and decompresses each one it receives.  The packets
+// are flushed but not reset, so each one is compressed with what came
+// before it on the connection, and a reply made of many small, similar
+// ClassAds compresses about as well as if it were sent in one piece.
+// The compressor and decompressor are created the first time they are
+// used, so a connection that only receives does not pay for both.
+class Condor_Compress {
+
+ public:
+		// Returns the comma separated list of methods this build
+		// supports, in order of preference, e.g. "ZLIB".
+	static const char * supportedMethods();
+
+		// Returns NULL if the method is not supported.
+	static Condor_Compress * create( const char * method );
+
+	~Condor_Compress();
+
+	const char * method() const { return "ZLIB"; }
+
+		// The most compress() can turn len bytes into.
+	static int bound( int len );
+
+		// Compress len bytes of data into out, which must have room
+		// for bound(len) bytes.
+	bool compress( const char * data, int len, char * out, int out_max, int & out_len );
+
+		// Decompress the len bytes of a packet from compress() into
+		// out.  If out fills up first, this returns true with out_len
+		// equal to out_max; call it again with no data to get the rest.
+	bool decompress( const char * data, int len, char * out, int out_max, int & out_len );
+
+ private:
+	Condor_Compress();
+
+	z_stream * m_deflate;
+	z_stream * m_inflate;
+};
+
+#endif
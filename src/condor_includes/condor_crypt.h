@@ -26,6 +26,12 @@
 
 #include "CryptKey.h"
 
+// Authenticated ciphers (AES-GCM) seal each CEDAR packet on its own and
+// send the nonce and tag along in the packet header.
+#define AESGCM_IV_SIZE  12
+#define AESGCM_TAG_SIZE 16
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
 
 class Condor_Crypto_State {
 
@@ -52,6 +58,17 @@ public:
     int m_method_key_data_len;
     unsigned char *m_method_key_data;
 
+    // for authenticated ciphers, the OpenSSL contexts used to seal and
+    // open packets, the per-state nonce that each packet varies, and
+    // the peer's nonce, learned from the first packet it sent, which
+    // each packet we open must follow in sequence
+    EVP_CIPHER_CTX *m_seal_ctx;
+    EVP_CIPHER_CTX *m_open_ctx;
+    unsigned char m_seal_iv[AESGCM_IV_SIZE];
+    uint64_t m_seal_count;
+    unsigned char m_open_iv[AESGCM_IV_SIZE];
+    uint64_t m_open_count;
+
     // CURRENTLY UNUSED: int m_additional_len;
     // CURRENTLY UNUSED: unsigned char *m_additional;
 
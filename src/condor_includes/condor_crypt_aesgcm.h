@@ -0,0 +1,94 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef CONDOR_CRYPTO_AESGCM_H
+#define CONDOR_CRYPTO_AESGCM_H
+
+#ifdef HAVE_EXT_OPENSSL
+
+#include "condor_common.h"
+#include "condor_crypt.h"          // base class
+
+// AES-256.  ReliSock seals each packet with AES-GCM, which provides
+// integrity as well as privacy, so no separate MAC is needed.  Where
+// CEDAR encrypts a byte stream instead (SafeSock), AES-CFB is used.
+class Condor_Crypt_AESGCM : public Condor_Crypt_Base {
+
+ public:
+    Condor_Crypt_AESGCM() {}
+    ~Condor_Crypt_AESGCM() {}
+
+    bool encrypt(Condor_Crypto_State *s,
+                 const unsigned char * input,
+                 int          input_len, 
+                 unsigned char *&      output, 
+                 int&         output_len);
+
+    bool decrypt(Condor_Crypto_State *s,
+                 const unsigned char * input,
+                 int          input_len, 
+                 unsigned char *&      output, 
+                 int&         output_len);
+
+    bool seal(Condor_Crypto_State *s,
+              const unsigned char * aad,
+              int          aad_len,
+              unsigned char *       data,
+              int          data_len,
+              unsigned char *       tag,
+              unsigned char *       iv);
+    //------------------------------------------
+    // PURPOSE: encrypt data in place, and compute a tag over it, the
+    //          additional authenticated data (aad) and the number of
+    //          the packet
+    // REQUIRE: tag -- room for AESGCM_TAG_SIZE bytes
+    //          iv  -- room for AESGCM_IV_SIZE bytes; gets the nonce,
+    //                 which must be sent along with the tag
+    // RETURNS: true -- success; false -- failure
+    //------------------------------------------
+
+    bool open(Condor_Crypto_State *s,
+              const unsigned char * aad,
+              int          aad_len,
+              unsigned char *       data,
+              int          data_len,
+              const unsigned char * tag,
+              const unsigned char * iv);
+    //------------------------------------------
+    // PURPOSE: decrypt data sealed by seal() in place.  Packets must be
+    //          opened in the order the peer sealed them.
+    // RETURNS: true -- success; false -- the data, aad or tag were
+    //          altered, the wrong key was used, or the packet is not
+    //          the next one from the peer
+    //------------------------------------------
+
+    static void packet_nonce(const unsigned char * base,
+                             uint64_t     count,
+                             unsigned char *       iv);
+    //------------------------------------------
+    // PURPOSE: compute the nonce of a packet from the nonce of a
+    //          crypto state and the packet's number
+    // REQUIRE: iv -- room for AESGCM_IV_SIZE bytes
+    //------------------------------------------
+};
+
+#endif
+
+#endif
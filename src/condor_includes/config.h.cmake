@@ -340,6 +340,9 @@
 /* Define to 1 if you have the <pcre.h> header file. (USED)*/
 #cmakedefine HAVE_PCRE_H 1
 
+/* Define to 1 if you have the <zlib.h> header file. (USED)*/
+#cmakedefine HAVE_ZLIB_H 1
+
 /* Define to 1 if you have the <pcre/pcre.h> header file. (USED)*/
 #cmakedefine HAVE_PCRE_PCRE_H 1
 
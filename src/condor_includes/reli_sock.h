@@ -284,6 +284,19 @@ public:
 
 	bool is_closed() const {return rcv_msg.m_closed;}
 
+	/** Compress each packet sent from now on and decompress each one
+		received with the given method (see Condor_Compress), or stop
+		compressing if method is NULL.  Both ends must switch between
+		the same two messages, as SecMan does when the security policy
+		calls for compression.  The compression state is not carried by
+		serialize(), so a compressing socket cannot be passed on.
+		@return false if the method is not supported or a message is
+		partly sent or received
+	*/
+	bool set_compression( const char *method );
+	/// The compression method in use, or NULL if none
+	const char *get_compression_method() const;
+
 	// serialize and deserialize
 	const char * serialize(const char *);	// restore state from buffer
 	char * serialize() const;	// save state into buffer
@@ -309,6 +322,14 @@ protected:
 	*/
 
 	int prepare_for_nobuffering( stream_coding = stream_unknown);
+	int put_bytes_sealed( const char *buffer, int length, int send_size );
+	int get_bytes_sealed( char *buffer, int max_length, int receive_size );
+	int bulk_packet_size();
+	bool use_zero_copy();
+#ifdef LINUX
+	filesize_t put_file_data_sendfile( int fd, filesize_t offset, filesize_t bytes, class DCTransferQueue *xfer_q );
+	filesize_t get_file_data_splice( int fd, filesize_t bytes, filesize_t &written, class DCTransferQueue *xfer_q );
+#endif
 	int perform_authenticate( bool with_key, KeyInfo *& key, 
 							  const char* methods, CondorError* errstack,
 							  int auth_timeout, bool non_blocking, char **method_used );
@@ -320,7 +341,7 @@ protected:
 
 	class RcvMsg {
 		
-		char m_partial_cksum[MAC_SIZE];
+		char m_partial_hdr[5 + AESGCM_TAG_SIZE + AESGCM_IV_SIZE];
                 CONDOR_MD_MODE  mode_;
                 Condor_MD_MAC * mdChecker_;
 		ReliSock      * p_sock; //preserve parent pointer to use for condor_read/write
@@ -346,7 +367,8 @@ protected:
                 Condor_MD_MAC * mdChecker_;
 		ReliSock      * p_sock;
 		Buf		*m_out_buf;
-		void stash_packet();
+		Buf		m_zbuf; // buf's packet, compressed
+		void stash_packet(Buf &out);
 
 	public:
 		SndMsg();
@@ -354,6 +376,10 @@ protected:
 		void reset();
 		Buf			buf;
 		int snd_packet(char const *peer_description, int, int, int);
+			// Send a packet straight from the caller's data, without
+			// copying it into buf.  Only for packets without a MAC or
+			// seal, and not the last packet of a message.
+		int snd_packet_direct(char const *peer_description, int sock, const char *data, int len, int timeout);
 
 			// If there is a packet not flushed to the network, try to
 			// send it again.
@@ -391,6 +417,8 @@ protected:
 	bool m_has_backlog;
 	bool m_read_would_block;
 	bool m_non_blocking;
+	int m_bulk_packet_size;
+	class Condor_Compress *m_compressor;
 
 	virtual void setTargetSharedPortID( char const *id );
 	virtual bool sendTargetSharedPortID();
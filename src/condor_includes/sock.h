@@ -261,6 +261,30 @@ public:
         // RETURNS: TRUE -- success, FALSE -- failure
         //------------------------------------------
 
+        bool crypto_seals_packets() const;
+        //------------------------------------------
+        // PURPOSE: whether the crypto key is for an authenticated
+        //          cipher (AES-GCM), which seals whole packets with
+        //          seal_packet() instead of being applied to the byte
+        //          stream with wrap()/unwrap().  Sealed packets are
+        //          always encrypted and need no separate MAC.
+        // RETURNS: true -- packets are sealed; false -- otherwise
+        //------------------------------------------
+
+        bool seal_packet(const unsigned char* hdr, int hdr_len,
+                         unsigned char* data, int data_len,
+                         unsigned char* tag, unsigned char* iv);
+        bool open_packet(const unsigned char* hdr, int hdr_len,
+                         unsigned char* data, int data_len,
+                         const unsigned char* tag, const unsigned char* iv);
+        //------------------------------------------
+        // PURPOSE: encrypt/decrypt a packet's data in place, protecting
+        //          the packet header (hdr) from tampering as well
+        // REQUIRE: crypto_seals_packets()
+        // RETURNS: true -- success, false -- failure or, when opening,
+        //          the packet was altered
+        //------------------------------------------
+
         //----------------------------------------------------------------------
         // MAC/MD related stuff
         //----------------------------------------------------------------------
@@ -510,6 +534,9 @@ protected:
     char * serializeCryptoInfo() const;
     const char * serializeMdInfo(const char * buf);
     char * serializeMdInfo() const;
+        // the nonces of a crypto state that seals packets
+    const char * serializeNonces(const char * buf);
+    void serializeNonces(std::string & buf) const;
         
 	virtual int encrypt(bool);
 	///
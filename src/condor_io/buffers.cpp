@@ -24,6 +24,7 @@
 #include "condor_io.h"
 #include "condor_debug.h"
 #include "condor_md.h"
+#include "condor_compress.h"
 #include "condor_rw.h"
 
 unsigned long num_created = 0;
@@ -320,6 +321,80 @@ bool Buf::verifyMD(char * checkSUM, Condor_MD_MAC * checker)
     return checker->verifyMD((unsigned char *) checkSUM);
 }
 
+bool Buf::seal(char * hdr, int header_size, Sock * sock)
+{
+	alloc_buf();
+
+	// the normal 5 byte cedar header is authenticated too, and is
+	// followed by the tag and then the nonce
+	return sock->seal_packet((unsigned char *) hdr, 5,
+		(unsigned char *) &_dta[header_size], _dta_sz - header_size,
+		(unsigned char *) &hdr[5], (unsigned char *) &hdr[5+AESGCM_TAG_SIZE]);
+}
+
+bool Buf::open(const char * hdr, Sock * sock)
+{
+	alloc_buf();
+
+	return sock->open_packet((const unsigned char *) hdr, 5,
+		(unsigned char *) &_dta[0], _dta_sz,
+		(const unsigned char *) &hdr[5], (const unsigned char *) &hdr[5+AESGCM_TAG_SIZE]);
+}
+
+bool Buf::compress(int header_size, Buf & out, Condor_Compress * compressor)
+{
+	alloc_buf();
+
+	int len = _dta_sz - header_size;
+	int need = header_size + Condor_Compress::bound(len);
+	if (out._dta_maxsz < need) {
+		out.dealloc_buf();
+		out._dta_maxsz = need;
+	}
+	out.alloc_buf();
+	out.reset();
+
+	int out_len = 0;
+	if (!compressor->compress(&_dta[header_size], len, &out._dta[header_size],
+			out._dta_maxsz - header_size, out_len)) {
+		return false;
+	}
+	out._dta_sz = header_size + out_len;
+	return true;
+}
+
+bool Buf::decompress(Buf & out, int max_size, Condor_Compress * compressor)
+{
+	alloc_buf();
+
+		// ClassAds usually shrink to well under a quarter of their size
+	int guess = 4 * _dta_sz;
+	out.grow_buf(guess < max_size ? guess : max_size);
+	out.alloc_buf();
+	out.reset();
+
+	const char * data = &_dta[_dta_pt];
+	int len = _dta_sz - _dta_pt;
+	for (;;) {
+		int out_len = 0;
+		if (!compressor->decompress(data, len, &out._dta[out._dta_sz],
+				out._dta_maxsz - out._dta_sz, out_len)) {
+			return false;
+		}
+		out._dta_sz += out_len;
+		if (out._dta_sz < out._dta_maxsz) {
+			return true;
+		}
+		if (out._dta_maxsz >= max_size) {
+			dprintf(D_ALWAYS, "IO: Decompressed packet is larger than %d bytes\n", max_size);
+			return false;
+		}
+		out.grow_buf(2 * out._dta_maxsz < max_size ? 2 * out._dta_maxsz : max_size);
+		data = NULL;
+		len = 0;
+	}
+}
+
 void Buf::swap(Buf &other)
 {
 	char * tmp_dta = _dta;
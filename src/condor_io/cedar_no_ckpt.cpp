@@ -46,10 +46,14 @@
 #include "condor_fsync.h"
 #include "dc_transfer_queue.h"
 #include "limit_directory_access.h"
+#include "selector.h"
 
 #ifdef WIN32
 #include <mswsock.h>	// For TransmitFile()
 #endif
+#ifdef LINUX
+#include <sys/sendfile.h>
+#endif
 
 const unsigned int PUT_FILE_EOM_NUM = 666;
 
@@ -176,6 +180,30 @@ ReliSock::get_file( filesize_t *size, int fd,
 		  RSC in the syscall library.  this code isn't like that.
 		*/
 
+#ifdef LINUX
+		// If the data is not encrypted, move it from the socket to the
+		// file inside the kernel.  Leave the rare case of a transfer
+		// that exceeds max_bytes to the loop below, which knows how to
+		// abort it.
+	if( fd != GET_FILE_NULL_FD && !append && bytes_to_receive > 0 &&
+		( max_bytes < 0 || bytes_to_receive <= max_bytes ) &&
+		use_zero_copy() )
+	{
+		filesize_t written = 0;
+		filesize_t nbytes = get_file_data_splice( fd, bytes_to_receive, written, xfer_q );
+		if( nbytes < 0 ) {
+			return -1;
+		}
+		if( written < nbytes ) {
+				// Continue reading data, but throw it all away.
+			saved_errno = errno;
+			fd = GET_FILE_NULL_FD;
+			retval = GET_FILE_WRITE_FAILED;
+		}
+		total = nbytes;
+	}
+#endif
+
 	// Now, read it all in & save it
 	while( total < bytes_to_receive ) {
 		struct timeval t1,t2;
@@ -490,10 +518,26 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 		}
 #endif
 
+#ifdef LINUX
+		// If the data is not encrypted, hand the file to the kernel to
+		// send; what goes on the wire is the same.
+		if ( use_zero_copy() ) {
+			filesize_t nbytes = put_file_data_sendfile( fd, offset, bytes_to_send, xfer_q );
+			if ( nbytes < 0 ) {
+				return -1;
+			}
+			total = nbytes;
+			if ( total > 0 && total < bytes_to_send ) {
+				lseek( fd, offset + total, SEEK_SET );
+			}
+		}
+#endif
+
 		char buf[65536];
 		int nbytes, nrd;
 
-		// On Unix, always send the file using put_bytes_nobuffer().
+		// On Unix, send the file using put_bytes_nobuffer(), unless it
+		// was sent above.
 		// Note that on Win32, we use this method as well if encryption 
 		// is required.
 		while (total < bytes_to_send) {
@@ -572,6 +616,220 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 }
 MSC_RESTORE_WARNING(6262) // function uses 64k of stack
 
+#ifdef LINUX
+	// Wait up to the socket's timeout for it to be ready for io.
+static bool
+wait_for_socket( char const *peer_description, SOCKET sock, Selector::IO_FUNC io, int timeout )
+{
+	Selector selector;
+	selector.add_fd( sock, io );
+	if ( timeout > 0 ) {
+		selector.set_timeout( timeout );
+	}
+	do {
+		selector.execute();
+	} while ( selector.signalled() );
+	if ( selector.timed_out() ) {
+		dprintf( D_ALWAYS, "ReliSock: timed out waiting for %s\n", peer_description );
+		return false;
+	}
+	if ( selector.failed() ) {
+		dprintf( D_ALWAYS, "ReliSock: select() failed waiting for %s, errno=%d\n",
+				 peer_description, selector.select_errno() );
+		return false;
+	}
+	return true;
+}
+
+	// The most to move at once, so that the transfer queue hears about
+	// progress regularly.
+static const size_t ZERO_COPY_CHUNK = 1024 * 1024;
+
+	// Send bytes of the file from offset with sendfile().  Returns the
+	// number of bytes sent, which is 0 if the file can't be sent this
+	// way and the caller should send it as usual, or -1 on failure.
+filesize_t
+ReliSock::put_file_data_sendfile( int fd, filesize_t offset, filesize_t bytes, DCTransferQueue *xfer_q )
+{
+	if ( !prepare_for_nobuffering(stream_encode) ) {
+		dprintf(D_ALWAYS, "ReliSock: put_file: failed to drain buffers!\n");
+		return -1;
+	}
+
+	off_t off = offset;
+	filesize_t total = 0;
+	while ( total < bytes ) {
+		struct timeval t1, t2;
+		condor_gettimestamp(t1);
+
+		if ( !wait_for_socket( peer_description(), _sock, Selector::IO_WRITE, _timeout ) ) {
+			return -1;
+		}
+		size_t count = (size_t) MIN( (filesize_t) ZERO_COPY_CHUNK, bytes - total );
+		ssize_t nw = sendfile( _sock, fd, &off, count );
+		if ( nw < 0 ) {
+			if ( errno == EINTR || errno == EAGAIN ) {
+				continue;
+			}
+			if ( total == 0 && ( errno == EINVAL || errno == ENOSYS ) ) {
+				dprintf( D_FULLDEBUG, "ReliSock: put_file: sendfile() not supported for this file, errno=%d (%s)\n",
+						 errno, strerror(errno) );
+				return 0;
+			}
+			dprintf( D_ALWAYS, "ReliSock: put_file: sendfile() to %s failed, errno=%d (%s)\n",
+					 peer_description(), errno, strerror(errno) );
+			return -1;
+		}
+		if ( nw == 0 ) {
+				// the file is shorter than it was
+			break;
+		}
+		total += nw;
+		_bytes_sent += nw;
+
+		if( xfer_q ) {
+				// We don't know how much of the time was spent reading
+				// from disk vs. writing to the network, so we just report
+				// it all as network i/o time.
+			condor_gettimestamp(t2);
+			xfer_q->AddUsecNetWrite(timersub_usec(t2, t1));
+			xfer_q->AddBytesSent(nw);
+			xfer_q->ConsiderSendingReport(t2.tv_sec);
+		}
+	}
+	return total;
+}
+
+	// Receive bytes into the file with splice(), through a pipe.  Returns
+	// the number of bytes read from the socket, which is 0 if the caller
+	// should receive the data as usual, or -1 on failure.  Sets written
+	// to the number of bytes written to the file, which is less than the
+	// number read only if writing failed; the rest were thrown away.  If
+	// the file can't be written with splice(), as with O_DIRECT or on a
+	// file system that doesn't support it, the data already read is
+	// written with write() and the caller receives the rest as usual.
+filesize_t
+ReliSock::get_file_data_splice( int fd, filesize_t bytes, filesize_t &written, DCTransferQueue *xfer_q )
+{
+	written = 0;
+	this->decode();
+	if ( !prepare_for_nobuffering(stream_decode) ) {
+		return -1;
+	}
+
+	int pipefd[2];
+	if ( pipe2( pipefd, O_CLOEXEC ) < 0 ) {
+		return 0;
+	}
+		// a bigger pipe means fewer trips; not fatal if it fails
+	fcntl( pipefd[1], F_SETPIPE_SZ, (int) ZERO_COPY_CHUNK );
+
+	filesize_t total = 0;
+	bool write_failed = false;
+	int write_errno = 0;
+	bool copy_to_file = false;
+	while ( total < bytes && !copy_to_file ) {
+		struct timeval t1, t2;
+		condor_gettimestamp(t1);
+
+		if ( !wait_for_socket( peer_description(), _sock, Selector::IO_READ, _timeout ) ) {
+			total = -1;
+			break;
+		}
+		size_t count = (size_t) MIN( (filesize_t) ZERO_COPY_CHUNK, bytes - total );
+		ssize_t nr = splice( _sock, NULL, pipefd[1], NULL, count, SPLICE_F_MOVE | SPLICE_F_MORE );
+		if ( nr < 0 && ( errno == EINTR || errno == EAGAIN ) ) {
+			continue;
+		}
+		if ( nr < 0 && total == 0 && ( errno == EINVAL || errno == ENOSYS ) ) {
+			dprintf( D_FULLDEBUG, "ReliSock: get_file: splice() not supported, errno=%d (%s)\n",
+					 errno, strerror(errno) );
+			break;
+		}
+		if ( nr <= 0 ) {
+			dprintf( D_ALWAYS, "ReliSock: get_file: splice() from %s failed, returned %d, errno=%d (%s)\n",
+					 peer_description(), (int)nr, errno, strerror(errno) );
+			total = -1;
+			break;
+		}
+		total += nr;
+		_bytes_recvd += nr;
+
+		condor_gettimestamp(t2);
+		if( xfer_q ) {
+			xfer_q->AddUsecNetRead(timersub_usec(t2, t1));
+		}
+
+			// Now empty the pipe into the file.  If that fails, keep
+			// reading the data, but throw it away, as get_file() does.
+		ssize_t left = nr;
+		while ( left > 0 && !write_failed ) {
+			ssize_t nw = splice( pipefd[0], NULL, fd, NULL, left, SPLICE_F_MOVE );
+			if ( nw < 0 && errno == EINTR ) {
+				continue;
+			}
+			if ( nw < 0 && ( errno == EINVAL || errno == ENOSYS ) ) {
+				dprintf( D_FULLDEBUG, "ReliSock::get_file: splice() to file not supported, errno=%d (%s)\n",
+						 errno, strerror(errno) );
+				copy_to_file = true;
+				break;
+			}
+			if ( nw <= 0 ) {
+				write_errno = nw < 0 ? errno : ENOSPC;
+				dprintf( D_ALWAYS, "ReliSock::get_file: splice() to file returned %d: %s (errno=%d)\n",
+						 (int)nw, strerror(write_errno), write_errno );
+				write_failed = true;
+				break;
+			}
+			left -= nw;
+			written += nw;
+		}
+			// Whatever is left in the pipe is copied to the file if splice()
+			// can't write it, or else thrown away.
+		while ( left > 0 ) {
+			char pipe_buf[4096];
+			ssize_t nd = ::read( pipefd[0], pipe_buf, MIN( left, (ssize_t)sizeof(pipe_buf) ) );
+			if ( nd <= 0 && errno != EINTR ) {
+				break;
+			}
+			if ( nd <= 0 ) {
+				continue;
+			}
+			left -= nd;
+			for ( ssize_t off = 0; copy_to_file && !write_failed && off < nd; ) {
+				ssize_t nw = ::write( fd, &pipe_buf[off], nd - off );
+				if ( nw < 0 && errno == EINTR ) {
+					continue;
+				}
+				if ( nw <= 0 ) {
+					write_errno = nw < 0 ? errno : ENOSPC;
+					dprintf( D_ALWAYS, "ReliSock::get_file: write() returned %d: %s (errno=%d)\n",
+							 (int)nw, strerror(write_errno), write_errno );
+					write_failed = true;
+					break;
+				}
+				off += nw;
+				written += nw;
+			}
+		}
+
+		if( xfer_q ) {
+			condor_gettimestamp(t1);
+			xfer_q->AddUsecFileWrite(timersub_usec(t1, t2));
+			xfer_q->AddBytesReceived(nr);
+			xfer_q->ConsiderSendingReport(t1.tv_sec);
+		}
+	}
+
+	::close( pipefd[0] );
+	::close( pipefd[1] );
+	if ( write_failed ) {
+		errno = write_errno;
+	}
+	return total;
+}
+#endif
+
 int
 ReliSock::get_file_with_permissions( filesize_t *size, 
 									 const char *destination,
@@ -0,0 +1,210 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "condor_common.h"
+#include "condor_compress.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "generic_stats.h"
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+// these stats keep track of how much CEDAR compression saves and costs;
+// DaemonCore publishes them
+//
+stats_entry_recent<int64_t> cedar_compress_bytes_in;    // bytes given to compress()
+stats_entry_recent<int64_t> cedar_compress_bytes_out;   // bytes it turned them into
+stats_entry_recent<int64_t> cedar_decompress_bytes_in;  // bytes given to decompress()
+stats_entry_recent<int64_t> cedar_decompress_bytes_out; // bytes it turned them into
+stats_entry_recent<Probe> cedar_compress_runtime;       // count & runtime of compress() calls
+stats_entry_recent<Probe> cedar_decompress_runtime;     // count & runtime of decompress() calls
+
+#ifdef HAVE_ZLIB_H
+
+	// ClassAds compress well even at the fastest level, and the
+	// collector answering large queries cannot spare the CPU for more.
+static const int COMPRESSION_LEVEL = Z_BEST_SPEED;
+
+const char *
+Condor_Compress::supportedMethods()
+{
+	return "ZLIB";
+}
+
+Condor_Compress *
+Condor_Compress::create( const char * method )
+{
+	if( !method || strcasecmp( method, "ZLIB" ) != 0 ) {
+		return NULL;
+	}
+	return new Condor_Compress();
+}
+
+Condor_Compress::Condor_Compress()
+	: m_deflate(NULL), m_inflate(NULL)
+{
+}
+
+Condor_Compress::~Condor_Compress()
+{
+	if( m_deflate ) {
+		deflateEnd( m_deflate );
+		delete m_deflate;
+	}
+	if( m_inflate ) {
+		inflateEnd( m_inflate );
+		delete m_inflate;
+	}
+}
+
+int
+Condor_Compress::bound( int len )
+{
+		// compressBound() counts the zlib header and trailer, which a
+		// flushed stream does not have, but not the empty block that
+		// ends each flush
+	return (int)compressBound( len ) + 16;
+}
+
+bool
+Condor_Compress::compress( const char * data, int len, char * out, int out_max, int & out_len )
+{
+	double begin = _condor_debug_get_time_double();
+	out_len = 0;
+
+	if( !m_deflate ) {
+		m_deflate = new z_stream;
+		memset( m_deflate, 0, sizeof(z_stream) );
+		if( deflateInit( m_deflate, COMPRESSION_LEVEL ) != Z_OK ) {
+			dprintf( D_ALWAYS, "Condor_Compress: deflateInit() failed\n" );
+			delete m_deflate;
+			m_deflate = NULL;
+			return false;
+		}
+	}
+
+	m_deflate->next_in = (Bytef *)const_cast<char *>(data);
+	m_deflate->avail_in = len;
+	m_deflate->next_out = (Bytef *)out;
+	m_deflate->avail_out = out_max;
+
+	int rc = deflate( m_deflate, Z_SYNC_FLUSH );
+	if( rc != Z_OK || m_deflate->avail_in != 0 || m_deflate->avail_out == 0 ) {
+			// avail_out == 0 means the output may have been cut short
+		dprintf( D_ALWAYS, "Condor_Compress: deflate() failed (%d)\n", rc );
+		return false;
+	}
+	out_len = out_max - m_deflate->avail_out;
+
+	cedar_compress_bytes_in += len;
+	cedar_compress_bytes_out += out_len;
+	cedar_compress_runtime += _condor_debug_get_time_double() - begin;
+	return true;
+}
+
+bool
+Condor_Compress::decompress( const char * data, int len, char * out, int out_max, int & out_len )
+{
+	double begin = _condor_debug_get_time_double();
+	out_len = 0;
+
+	if( !m_inflate ) {
+		m_inflate = new z_stream;
+		memset( m_inflate, 0, sizeof(z_stream) );
+		if( inflateInit( m_inflate ) != Z_OK ) {
+			dprintf( D_ALWAYS, "Condor_Compress: inflateInit() failed\n" );
+			delete m_inflate;
+			m_inflate = NULL;
+			return false;
+		}
+	}
+
+	if( data ) {
+		m_inflate->next_in = (Bytef *)const_cast<char *>(data);
+		m_inflate->avail_in = len;
+		cedar_decompress_bytes_in += len;
+	}
+	m_inflate->next_out = (Bytef *)out;
+	m_inflate->avail_out = out_max;
+
+	int rc = inflate( m_inflate, Z_SYNC_FLUSH );
+		// Z_BUF_ERROR only means that there was nothing left to do
+	if( rc != Z_OK && !(rc == Z_BUF_ERROR && m_inflate->avail_in == 0) ) {
+		dprintf( D_ALWAYS, "Condor_Compress: inflate() failed (%d)%s%s\n", rc,
+			m_inflate->msg ? ": " : "", m_inflate->msg ? m_inflate->msg : "" );
+		return false;
+	}
+	out_len = out_max - m_inflate->avail_out;
+	if( out_len < out_max && m_inflate->avail_in != 0 ) {
+		dprintf( D_ALWAYS, "Condor_Compress: inflate() stopped short\n" );
+		return false;
+	}
+
+	cedar_decompress_bytes_out += out_len;
+	cedar_decompress_runtime += _condor_debug_get_time_double() - begin;
+	return true;
+}
+
+#else
+
+const char *
+Condor_Compress::supportedMethods()
+{
+	return "";
+}
+
+Condor_Compress *
+Condor_Compress::create( const char * /*method*/ )
+{
+	return NULL;
+}
+
+Condor_Compress::Condor_Compress()
+	: m_deflate(NULL), m_inflate(NULL)
+{
+}
+
+Condor_Compress::~Condor_Compress()
+{
+}
+
+int
+Condor_Compress::bound( int len )
+{
+	return len;
+}
+
+bool
+Condor_Compress::compress( const char * /*data*/, int /*len*/, char * /*out*/, int /*out_max*/, int & out_len )
+{
+	out_len = 0;
+	return false;
+}
+
+bool
+Condor_Compress::decompress( const char * /*data*/, int /*len*/, char * /*out*/, int /*out_max*/, int & out_len )
+{
+	out_len = 0;
+	return false;
+}
+
+#endif
@@ -29,6 +29,9 @@
 // function in each method object.
 #include <openssl/des.h>
 #include <openssl/blowfish.h>
+#include <openssl/aes.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
 
 Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
     m_keyInfo(key)
@@ -44,6 +47,12 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
     m_ivec = NULL;
     m_method_key_data_len = 0;
     m_method_key_data = NULL;
+    m_seal_ctx = NULL;
+    m_open_ctx = NULL;
+    memset(m_seal_iv, 0, sizeof(m_seal_iv));
+    m_seal_count = 0;
+    memset(m_open_iv, 0, sizeof(m_open_iv));
+    m_open_count = 0;
 
     // there should probably be a static function in each crypto object to do
     // these conversions so that the state object doesn't need any specifc
@@ -79,6 +88,40 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
             m_ivec = (unsigned char*)malloc(m_ivec_len);
             break;
         }
+        case CONDOR_AESGCM: {
+            // AES-256 wants a 32 byte key, and session keys are usually
+            // shorter, so use a hash of the key data.
+            unsigned char aes_key[SHA256_DIGEST_LENGTH];
+            SHA256(m_keyInfo.getKeyData(), m_keyInfo.getKeyLength(), aes_key);
+
+            // key schedule for the AES-CFB stream cipher used by SafeSock
+            m_method_key_data_len = sizeof(AES_KEY);
+            m_method_key_data = (unsigned char*)malloc(m_method_key_data_len);
+            AES_set_encrypt_key(aes_key, 256, (AES_KEY*)m_method_key_data);
+
+            m_ivec_len = AES_BLOCK_SIZE;
+            m_ivec = (unsigned char*)malloc(m_ivec_len);
+
+            // contexts for sealing ReliSock packets with AES-GCM.  The
+            // key schedule is set up once here; each packet only sets
+            // its nonce.
+            m_seal_ctx = EVP_CIPHER_CTX_new();
+            m_open_ctx = EVP_CIPHER_CTX_new();
+            ASSERT(m_seal_ctx && m_open_ctx);
+            if (!EVP_EncryptInit_ex(m_seal_ctx, EVP_aes_256_gcm(), NULL, aes_key, NULL) ||
+                !EVP_DecryptInit_ex(m_open_ctx, EVP_aes_256_gcm(), NULL, aes_key, NULL)) {
+                dprintf(D_ALWAYS, "CRYPTO: failed to initialize AES-GCM.\n");
+            }
+
+            // Session keys are shared by many connections, so start
+            // each state's nonces from a random point rather than zero.
+            unsigned char * iv = Condor_Crypt_Base::randomKey(AESGCM_IV_SIZE);
+            memcpy(m_seal_iv, iv, AESGCM_IV_SIZE);
+            free(iv);
+
+            memset(aes_key, 0, sizeof(aes_key));
+            break;
+        }
         default:
             dprintf(D_ALWAYS, "CRYPTO: WARNING: Initialized crypto state for unknown proto %i.\n", proto);
             break;
@@ -92,6 +135,8 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
 Condor_Crypto_State::~Condor_Crypto_State() {
     if(m_ivec) free(m_ivec);
     if(m_method_key_data) free(m_method_key_data);
+    if(m_seal_ctx) EVP_CIPHER_CTX_free(m_seal_ctx);
+    if(m_open_ctx) EVP_CIPHER_CTX_free(m_open_ctx);
     // CURRENTLY UNUSED: if(m_additional) free(m_additional);
 }
 
@@ -0,0 +1,179 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "condor_common.h"
+#include "condor_crypt_aesgcm.h"
+#include "condor_debug.h"
+#include <openssl/aes.h>
+#include <openssl/evp.h>
+
+bool Condor_Crypt_AESGCM :: encrypt(Condor_Crypto_State *cs,
+                                    const unsigned char *  input,
+                                    int              input_len, 
+                                    unsigned char *& output, 
+                                    int&             output_len)
+{
+    output_len = input_len;
+
+    output = (unsigned char *) malloc(output_len);
+
+    if (output) {
+        AES_cfb128_encrypt(input, output, output_len, (AES_KEY*)cs->m_method_key_data, cs->m_ivec, &cs->m_num, AES_ENCRYPT);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+bool Condor_Crypt_AESGCM :: decrypt(Condor_Crypto_State *cs,
+                                    const unsigned char *  input,
+                                    int              input_len, 
+                                    unsigned char *& output, 
+                                    int&             output_len)
+{
+    output_len = input_len;
+
+    output = (unsigned char *) malloc(output_len);
+
+    if (output) {
+        // CFB mode runs the block cipher forwards in both directions
+        AES_cfb128_encrypt(input, output, output_len, (AES_KEY*)cs->m_method_key_data, cs->m_ivec, &cs->m_num, AES_DECRYPT);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+// the packet number, as authenticated along with each packet
+static void sequence_bytes(uint64_t count, unsigned char * seq)
+{
+    for (int i = 0; i < 8; i++) {
+        seq[7 - i] = (unsigned char)(count >> (8 * i));
+    }
+}
+
+void Condor_Crypt_AESGCM :: packet_nonce(const unsigned char * base,
+                                          uint64_t         count,
+                                          unsigned char *  iv)
+{
+    memcpy(iv, base, AESGCM_IV_SIZE);
+    for (int i = 0; i < 8; i++) {
+        iv[AESGCM_IV_SIZE - 1 - i] ^= (unsigned char)(count >> (8 * i));
+    }
+}
+
+bool Condor_Crypt_AESGCM :: seal(Condor_Crypto_State *cs,
+                                 const unsigned char * aad,
+                                 int              aad_len,
+                                 unsigned char *  data,
+                                 int              data_len,
+                                 unsigned char *  tag,
+                                 unsigned char *  iv)
+{
+    EVP_CIPHER_CTX *ctx = cs->m_seal_ctx;
+    if (!ctx) {
+        return false;
+    }
+
+    // A nonce must never be used twice with the same key, so every
+    // packet gets the state's nonce with a packet counter mixed in.
+    // The counter is also authenticated, so the peer can tell if this
+    // isn't the next packet, even on a connection's first packet.
+    uint64_t count = cs->m_seal_count++;
+    packet_nonce(cs->m_seal_iv, count, iv);
+    unsigned char seq[8];
+    sequence_bytes(count, seq);
+
+    int len = 0;
+    if (!EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv) ||
+        !EVP_EncryptUpdate(ctx, NULL, &len, aad, aad_len) ||
+        !EVP_EncryptUpdate(ctx, NULL, &len, seq, sizeof(seq)) ||
+        !EVP_EncryptUpdate(ctx, data, &len, data, data_len) ||
+        !EVP_EncryptFinal_ex(ctx, data + len, &len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_SIZE, tag)) {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM encryption failed.\n");
+        return false;
+    }
+    return true;
+}
+
+bool Condor_Crypt_AESGCM :: open(Condor_Crypto_State *cs,
+                                 const unsigned char * aad,
+                                 int              aad_len,
+                                 unsigned char *  data,
+                                 int              data_len,
+                                 const unsigned char * tag,
+                                 const unsigned char * iv)
+{
+    EVP_CIPHER_CTX *ctx = cs->m_open_ctx;
+    if (!ctx) {
+        return false;
+    }
+
+    // The tag only proves that the packet was sealed with this key, and
+    // session keys are shared by many connections.  So the tag also
+    // covers the packet's number, which must be the number of packets
+    // we have opened; the first packet we open fixes the peer's nonce;
+    // and every later one must carry the next nonce in that sequence.
+    // A packet that was replayed, reordered or dropped, or that came
+    // from another connection, is rejected.
+    if (cs->m_open_count == 0) {
+        // The packet counter only changes the last 8 bytes of a nonce,
+        // so if the rest is the same as ours, this is one of our own
+        // packets sent back to us.
+        if (memcmp(iv, cs->m_seal_iv, AESGCM_IV_SIZE - 8) == 0) {
+            dprintf(D_ALWAYS, "CRYPTO: AES-GCM packet has our own nonce, rejecting it.\n");
+            return false;
+        }
+    } else {
+        unsigned char expected[AESGCM_IV_SIZE];
+        packet_nonce(cs->m_open_iv, cs->m_open_count, expected);
+        if (memcmp(iv, expected, AESGCM_IV_SIZE) != 0) {
+            dprintf(D_ALWAYS, "CRYPTO: AES-GCM packet %llu is out of sequence, rejecting it.\n",
+                    (unsigned long long)cs->m_open_count);
+            return false;
+        }
+    }
+
+    unsigned char seq[8];
+    sequence_bytes(cs->m_open_count, seq);
+
+    int len = 0;
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv) ||
+        !EVP_DecryptUpdate(ctx, NULL, &len, aad, aad_len) ||
+        !EVP_DecryptUpdate(ctx, NULL, &len, seq, sizeof(seq)) ||
+        !EVP_DecryptUpdate(ctx, data, &len, data, data_len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AESGCM_TAG_SIZE, (void *)tag)) {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM decryption failed.\n");
+        return false;
+    }
+    // this is where the tag is checked
+    if (EVP_DecryptFinal_ex(ctx, data + len, &len) <= 0) {
+        return false;
+    }
+    // only a packet that was really sealed with our key starts the sequence
+    if (cs->m_open_count == 0) {
+        memcpy(cs->m_open_iv, iv, AESGCM_IV_SIZE);
+    }
+    cs->m_open_count++;
+    return true;
+}
@@ -42,6 +42,7 @@
 #include "ipv6_hostname.h"
 #include "condor_auth_passwd.h"
 #include "condor_auth_ssl.h"
+#include "condor_compress.h"
 
 #include <sstream>
 
@@ -506,6 +507,12 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 	sec_req sec_integrity = sec_req_param(
 		 "SEC_%s_INTEGRITY", auth_level, SEC_REQ_OPTIONAL);
 
+	// compression is off unless both sides ask for it, because
+	// compressing secrets together with data that an attacker chooses
+	// leaks the secrets through the length of the compressed data
+	sec_req sec_compression = sec_req_param(
+		"SEC_%s_COMPRESSION", auth_level, SEC_REQ_NEVER);
+
 
 	// regarding SEC_NEGOTIATE values:
 	// REQUIRED- outgoing will always negotiate, and incoming must
@@ -526,6 +533,7 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 		sec_authentication = SEC_REQ_NEVER;
 		sec_encryption = SEC_REQ_NEVER;
 		sec_integrity = SEC_REQ_NEVER;
+		sec_compression = SEC_REQ_NEVER;
 	}
 
 
@@ -533,7 +541,8 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 		!ReconcileSecurityDependency (sec_authentication, sec_integrity) ||
 	    !ReconcileSecurityDependency (sec_negotiation, sec_authentication) ||
 	    !ReconcileSecurityDependency (sec_negotiation, sec_encryption) ||
-		!ReconcileSecurityDependency (sec_negotiation, sec_integrity)) {
+		!ReconcileSecurityDependency (sec_negotiation, sec_integrity) ||
+		!ReconcileSecurityDependency (sec_negotiation, sec_compression)) {
 
 		// houston, we have a problem.  
 		dprintf (D_SECURITY, "SECMAN: failure! can't resolve security policy:\n");
@@ -545,6 +554,8 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 				SecMan::sec_req_rev[sec_encryption]);
 		dprintf (D_SECURITY, "SECMAN:   SEC_INTEGRITY=\"%s\"\n", 
 				SecMan::sec_req_rev[sec_integrity]);
+		dprintf (D_SECURITY, "SECMAN:   SEC_COMPRESSION=\"%s\"\n", 
+				SecMan::sec_req_rev[sec_compression]);
 		return false;
 	}
 
@@ -600,6 +611,25 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 		}
 	}
 
+	// compression methods
+	paramer = SecMan::getSecSetting("SEC_%s_COMPRESSION_METHODS", auth_level);
+	if (!paramer) {
+		paramer = strdup(Condor_Compress::supportedMethods());
+	}
+
+	if (paramer && *paramer) {
+		ad->Assign (ATTR_SEC_COMPRESSION_METHODS, paramer);
+	} else if( sec_compression == SEC_REQ_REQUIRED ) {
+		dprintf( D_SECURITY, "SECMAN: no compression methods, "
+				 "but it was required! failing...\n" );
+		free(paramer);
+		return false;
+	} else {
+		sec_compression = SEC_REQ_NEVER;
+	}
+	free(paramer);
+	paramer = NULL;
+
 
 	ad->Assign( ATTR_SEC_NEGOTIATION, SecMan::sec_req_rev[sec_negotiation] );
 
@@ -609,6 +639,8 @@ SecMan::FillInSecurityPolicyAd( DCpermission auth_level, ClassAd* ad,
 
 	ad->Assign ( ATTR_SEC_INTEGRITY, SecMan::sec_req_rev[sec_integrity] );
 
+	ad->Assign ( ATTR_SEC_COMPRESSION, SecMan::sec_req_rev[sec_compression] );
+
 	ad->Assign ( ATTR_SEC_ENACT, "NO" );
 
 
@@ -858,9 +890,38 @@ SecMan::ReconcileSecurityPolicyAds(const ClassAd &cli_ad, const ClassAd &srv_ad)
 								ATTR_SEC_INTEGRITY,
 								cli_ad, srv_ad );
 
+	// peers before 8.9.11 cannot compress, which is only a problem
+	// if compression is required
+	sec_feat_act compression_action = SEC_FEAT_ACT_NO;
+	if( cli_ad.LookupExpr(ATTR_SEC_COMPRESSION) && srv_ad.LookupExpr(ATTR_SEC_COMPRESSION) ) {
+		compression_action = ReconcileSecurityAttribute(
+								ATTR_SEC_COMPRESSION,
+								cli_ad, srv_ad );
+	} else if( sec_lookup_req(cli_ad, ATTR_SEC_COMPRESSION) == SEC_REQ_REQUIRED ||
+			   sec_lookup_req(srv_ad, ATTR_SEC_COMPRESSION) == SEC_REQ_REQUIRED ) {
+		compression_action = SEC_FEAT_ACT_FAIL;
+	}
+
+	std::string compression_method;
+	if( compression_action == SEC_FEAT_ACT_YES ) {
+		std::string cli_list, srv_list;
+		cli_ad.LookupString(ATTR_SEC_COMPRESSION_METHODS, cli_list);
+		srv_ad.LookupString(ATTR_SEC_COMPRESSION_METHODS, srv_list);
+		compression_method = ReconcileMethodLists(
+			const_cast<char *>(cli_list.c_str()), const_cast<char *>(srv_list.c_str()) );
+		size_t pos = compression_method.find(',');
+		if( pos != std::string::npos ) {
+			compression_method.erase(pos);
+		}
+		if( compression_method.empty() ) {
+			compression_action = SEC_FEAT_ACT_NO;
+		}
+	}
+
 	if ( (authentication_action == SEC_FEAT_ACT_FAIL) ||
 	     (encryption_action == SEC_FEAT_ACT_FAIL) ||
-	     (integrity_action == SEC_FEAT_ACT_FAIL) ) {
+	     (integrity_action == SEC_FEAT_ACT_FAIL) ||
+	     (compression_action == SEC_FEAT_ACT_FAIL) ) {
 
 		// one or more decisions could not be agreed upon, so
 		// we fail.
@@ -886,6 +947,11 @@ SecMan::ReconcileSecurityPolicyAds(const ClassAd &cli_ad, const ClassAd &srv_ad)
 
 	action_ad->Assign(ATTR_SEC_INTEGRITY, SecMan::sec_feat_act_rev[integrity_action]);
 
+	action_ad->Assign(ATTR_SEC_COMPRESSION, SecMan::sec_feat_act_rev[compression_action]);
+	if( compression_action == SEC_FEAT_ACT_YES ) {
+		action_ad->Assign(ATTR_SEC_COMPRESSION_METHODS, compression_method);
+	}
+
 
 	char* cli_methods = NULL;
 	char* srv_methods = NULL;
@@ -1940,6 +2006,8 @@ SecManStartCommand::receiveAuthInfo_inner()
 			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_AUTH_REQUIRED );
 			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_ENCRYPTION );
 			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_INTEGRITY );
+			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_COMPRESSION );
+			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_COMPRESSION_METHODS );
 			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_SESSION_DURATION );
 			m_sec_man.sec_copy_attribute( m_auth_info, auth_response, ATTR_SEC_SESSION_LEASE );
 
@@ -2182,6 +2250,22 @@ SecManStartCommand::authenticate_inner_finish()
 			m_sock->encode();
 			m_sock->set_crypto_key(false, m_private_key);
 		}
+
+			// BLOWFISH and 3DES encrypt the data before it is put in
+			// packets, where it would be compressed, and encrypted
+			// data does not compress.  The server makes the same choice.
+		if (m_sec_man.sec_lookup_feat_act( m_auth_info, ATTR_SEC_COMPRESSION ) == SecMan::SEC_FEAT_ACT_YES &&
+			!(m_sock->get_encryption() && !m_sock->crypto_seals_packets()))
+		{
+			std::string method;
+			m_auth_info.LookupString( ATTR_SEC_COMPRESSION_METHODS, method );
+			if (!static_cast<ReliSock *>(m_sock)->set_compression( method.c_str() )) {
+				m_errstack->pushf( "SECMAN", SECMAN_ERR_INTERNAL,
+						"Failed to enable %s compression.", method.c_str() );
+				return StartCommandFailed;
+			}
+			dprintf ( D_SECURITY, "SECMAN: successfully enabled %s compression!\n", method.c_str() );
+		}
 		
 	}
 
@@ -3261,6 +3345,8 @@ Protocol CryptProtocolNameToEnum(char const *name) {
 	case '3': // 3des
 	case 'T': // Tripledes
 		return CONDOR_3DES;
+	case 'A': // aesgcm
+		return CONDOR_AESGCM;
 	default:
 		return CONDOR_NO_PROTOCOL;
 	}
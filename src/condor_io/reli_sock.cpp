@@ -26,12 +26,14 @@
 #include "internet.h"
 #include "condor_rw.h"
 #include "condor_md.h"
+#include "condor_compress.h"
 #include "selector.h"
 #include "ccb_client.h"
 #include "condor_sockfunc.h"
 
 #define NORMAL_HEADER_SIZE 5
 #define MAX_HEADER_SIZE MAC_SIZE + NORMAL_HEADER_SIZE
+#define SEALED_HEADER_SIZE (NORMAL_HEADER_SIZE + AESGCM_TAG_SIZE + AESGCM_IV_SIZE)
 
 /**************************************************************/
 
@@ -47,6 +49,7 @@ ReliSock::init()
 	m_has_backlog = false;
 	m_read_would_block = false;
 	m_non_blocking = false;
+	m_bulk_packet_size = -1;
 	ignore_next_encode_eom = FALSE;
 	ignore_next_decode_eom = FALSE;
 	_bytes_sent = 0.0;
@@ -64,12 +67,12 @@ ReliSock::init()
 
 
 ReliSock::ReliSock()
-	: Sock()
+	: Sock(), m_compressor(NULL)
 {
 	init();
 }
 
-ReliSock::ReliSock(const ReliSock & orig) : Sock(orig)
+ReliSock::ReliSock(const ReliSock & orig) : Sock(orig), m_compressor(NULL)
 {
 	init();
 	// now copy all cedar state info via the serialize() method
@@ -114,6 +117,9 @@ ReliSock::close()
 	snd_msg.reset();
 	rcv_msg.reset();
 
+	delete m_compressor;
+	m_compressor = NULL;
+
 	// then invoke close() in parent class to close fd etc
 	return Sock::close();
 }
@@ -329,6 +335,10 @@ ReliSock::put_bytes_nobuffer( const char *buffer, int length, int send_size )
 	int pagesize = 65536;  // Optimize large writes to be page sized.
 	const char * cur;
 	unsigned char * buf = NULL;
+
+	if (crypto_seals_packets()) {
+		return put_bytes_sealed(buffer, length, send_size);
+	}
         
 	// First, encrypt the data if necessary
 	if (get_encryption()) {
@@ -402,6 +412,10 @@ ReliSock::get_bytes_nobuffer(char *buffer, int max_length, int receive_size)
 	ASSERT(buffer != NULL);
 	ASSERT(max_length > 0);
 
+	if (crypto_seals_packets()) {
+		return get_bytes_sealed(buffer, max_length, receive_size);
+	}
+
 	// Find out how big the file is going to be, if requested.
 	// No receive_size means read max_length bytes.
 	this->decode();
@@ -448,6 +462,79 @@ ReliSock::get_bytes_nobuffer(char *buffer, int max_length, int receive_size)
 }
 
 
+	// An authenticated cipher can only check whole packets, so with one
+	// the "unbuffered" data goes out as an ordinary message of sealed
+	// packets.  The receiver may ask for the data in different sized
+	// pieces than it was sent in, so a piece can span messages.
+int
+ReliSock::put_bytes_sealed( const char *buffer, int length, int send_size )
+{
+	this->encode();
+	if ( send_size ) {
+		ASSERT( this->code(length) != FALSE );
+		ASSERT( this->end_of_message() != FALSE );
+	}
+
+	if ( !prepare_for_nobuffering(stream_encode) ) {
+		dprintf(D_ALWAYS, "ReliSock::put_bytes_nobuffer: Send failed.\n");
+		return -1;
+	}
+
+	if ( put_bytes(buffer, length) != length || !end_of_message() ) {
+		dprintf(D_ALWAYS, "ReliSock::put_bytes_nobuffer: Send failed.\n");
+		return -1;
+	}
+
+		// as after sending raw bytes, the caller's end_of_message()
+		// has nothing left to do
+	ignore_next_encode_eom = TRUE;
+	return length;
+}
+
+int
+ReliSock::get_bytes_sealed( char *buffer, int max_length, int receive_size )
+{
+	int length;
+
+	this->decode();
+	if ( receive_size ) {
+		ASSERT( this->code(length) != FALSE );
+		ASSERT( this->end_of_message() != FALSE );
+	} else {
+		length = max_length;
+	}
+
+	if ( !prepare_for_nobuffering(stream_decode) ) {
+		return -1;
+	}
+
+	if( length > max_length ) {
+		dprintf(D_ALWAYS, 
+			"ReliSock::get_bytes_nobuffer: data too large for buffer.\n");
+		return -1;
+	}
+
+	int nr = 0;
+	while( nr < length ) {
+		int result = get_bytes(buffer + nr, length - nr);
+		if( result <= 0 ) {
+			dprintf(D_ALWAYS, 
+				"ReliSock::get_bytes_nobuffer: Failed to receive file.\n");
+			return -1;
+		}
+		nr += result;
+		if( rcv_msg.buf.consumed() ) {
+			rcv_msg.ready = FALSE;
+			rcv_msg.buf.reset();
+		}
+	}
+
+		// a partly read message is left for the next call, so the
+		// caller's end_of_message() must not check for its end
+	ignore_next_decode_eom = TRUE;
+	return nr;
+}
+
 int 
 ReliSock::handle_incoming_packet()
 {
@@ -586,7 +673,7 @@ ReliSock::put_bytes(const void *data, int sz)
         // Check to see if we need to encrypt
         // Okay, this is a bug! H.W. 9/25/2001
 
-        if (get_encryption()) {
+        if (get_encryption() && !crypto_seals_packets()) {
         	unsigned char * dta = NULL;
 			int l_out;
             if (!wrap((const unsigned char *)(data), sz, dta , l_out)) {
@@ -608,13 +695,92 @@ ReliSock::put_bytes(const void *data, int sz)
         }
 }
 
+	// The size of packets to use for data too big for one ordinary
+	// packet, or 0 to keep to ordinary packets.
+int
+ReliSock::bulk_packet_size()
+{
+		// Peers accept packets of up to 1MB, but to be safe we only
+		// send bigger than ordinary ones to peers that we know send
+		// them too.
+	CondorVersionInfo const *peer_version = get_peer_version();
+	if ( !peer_version || !peer_version->built_since_version(8, 9, 11) ) {
+		return 0;
+	}
+	if ( m_bulk_packet_size < 0 ) {
+		m_bulk_packet_size = param_integer("CEDAR_BULK_PACKET_SIZE", 256 * 1024,
+			CONDOR_IO_BUF_SIZE, 1024 * 1024);
+		if ( m_bulk_packet_size <= CONDOR_IO_BUF_SIZE ) {
+			m_bulk_packet_size = 0;
+		}
+	}
+		// Compressing data that does not compress makes it a little
+		// bigger, and the packet must still fit in 1MB.
+	if ( m_compressor && m_bulk_packet_size > 1024 * 1024 - CONDOR_IO_BUF_SIZE ) {
+		return 1024 * 1024 - CONDOR_IO_BUF_SIZE;
+	}
+	return m_bulk_packet_size;
+}
+
+bool
+ReliSock::set_compression( const char *method )
+{
+	if ( !snd_msg.buf.empty() || !rcv_msg.buf.consumed() ) {
+		dprintf(D_ALWAYS, "ReliSock: cannot change compression in the middle of a message\n");
+		return false;
+	}
+
+	Condor_Compress *compressor = NULL;
+	if ( method ) {
+		compressor = Condor_Compress::create(method);
+		if ( !compressor ) {
+			dprintf(D_ALWAYS, "ReliSock: compression method %s is not supported\n", method);
+			return false;
+		}
+	}
+	delete m_compressor;
+	m_compressor = compressor;
+	return true;
+}
+
+const char *
+ReliSock::get_compression_method() const
+{
+	return m_compressor ? m_compressor->method() : NULL;
+}
+
+	// True if bulk data may bypass CEDAR's buffers.  With a key that is
+	// applied to the data, it has to be copied to be encrypted anyway.
+bool
+ReliSock::use_zero_copy()
+{
+	return !get_encryption() && !crypto_seals_packets() &&
+		param_boolean("CEDAR_ZERO_COPY", true);
+}
+
 int 
 ReliSock::put_bytes_after_encryption(const void *dta, int sz) {
 	ignore_next_encode_eom = FALSE;
 
 	int		nw;
 	int 	tw = 0;
-	int		header_size = isOutgoing_Hash_on() ? MAX_HEADER_SIZE:NORMAL_HEADER_SIZE;
+	int		header_size = crypto_seals_packets() ? SEALED_HEADER_SIZE :
+		(isOutgoing_Hash_on() ? MAX_HEADER_SIZE:NORMAL_HEADER_SIZE);
+
+		// Use bigger packets for data that would not fit in an ordinary
+		// one.  Whole packets of data without a MAC can then go straight
+		// from the caller's buffer.
+	int bulk_size = 0;
+	bool direct = false;
+	if ( dta && sz > snd_msg.buf.num_free() ) {
+		bulk_size = bulk_packet_size();
+		if ( bulk_size > snd_msg.buf.max_size() ) {
+			snd_msg.buf.grow_buf(bulk_size);
+		}
+		direct = bulk_size && header_size == NORMAL_HEADER_SIZE && !m_non_blocking &&
+			!m_compressor && param_boolean("CEDAR_ZERO_COPY", true);
+	}
+
 	for(nw=0;;) {
 		
 		if (snd_msg.buf.full()) {
@@ -631,6 +797,16 @@ ReliSock::put_bytes_after_encryption(const void *dta, int sz) {
 		}
 		
 		if (snd_msg.buf.empty()) {
+				// Keep back at least one byte for the buffer, since
+				// end_of_message() needs a packet to mark as the last.
+			if (direct && sz - nw > snd_msg.buf.max_size() - header_size) {
+				tw = snd_msg.buf.max_size() - header_size;
+				if (!snd_msg.snd_packet_direct(peer_description(), _sock, &((const char *)dta)[nw], tw, _timeout)) {
+					return FALSE;
+				}
+				nw += tw;
+				continue;
+			}
 			snd_msg.buf.seek(header_size);
 		}
 		
@@ -674,7 +850,7 @@ ReliSock::get_bytes(void *dta, int max_sz)
 	bytes = rcv_msg.buf.get(dta, max_sz);
 
 	if (bytes > 0) {
-            if (get_encryption()) {
+            if (get_encryption() && !crypto_seals_packets()) {
                 unwrap((unsigned char *) dta, bytes, data, length);
                 memcpy(dta, data, bytes);
                 free(data);
@@ -737,7 +913,7 @@ ReliSock::RcvMsg :: RcvMsg() :
 	ready(0),
 	m_closed(false)
 {
-	memset( m_partial_cksum, 0, sizeof(m_partial_cksum) );
+	memset( m_partial_hdr, 0, sizeof(m_partial_hdr) );
 }
 
 ReliSock::RcvMsg::~RcvMsg()
@@ -753,9 +929,9 @@ void ReliSock::RcvMsg::reset()
 
 int ReliSock::RcvMsg::rcv_packet( char const *peer_description, SOCKET _sock, int _timeout)
 {
-	char	        hdr[MAX_HEADER_SIZE];
-	char *cksum_ptr = &hdr[5];
+	char	        hdr[SEALED_HEADER_SIZE];
 	int		len, len_t, header_size, header_filled;
+	bool	sealed = p_sock->crypto_seals_packets();
 	int		tmp_len;
 	int		retval;
 	const int max_packet_size = 1024 * 1024;  // We will reject packets bigger than this
@@ -765,11 +941,15 @@ int ReliSock::RcvMsg::rcv_packet( char const *peer_description, SOCKET _sock, in
 	if (m_partial_packet) {
 		m_partial_packet = false;
 		len = m_remaining_read_length;
-		cksum_ptr = m_partial_cksum;
+		memcpy( hdr, m_partial_hdr, sizeof(hdr) );
 		goto read_packet;
 	}
 
-	header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+	if (sealed) {
+		header_size = SEALED_HEADER_SIZE;
+	} else {
+		header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+	}
 	header_filled = 0;
 
 	retval = condor_read(peer_description,_sock,hdr,header_size,_timeout, 0, p_sock->is_non_blocking());
@@ -857,9 +1037,7 @@ read_packet:
 		if (p_sock->is_non_blocking() && (tmp_len >= 0)) {
 			m_partial_packet = true;
 			m_remaining_read_length = len - tmp_len;
-			if ( mode_ != MD_OFF && cksum_ptr != m_partial_cksum ) {
-				memcpy( m_partial_cksum, cksum_ptr, sizeof(m_partial_cksum) );
-			}
+			memcpy( m_partial_hdr, hdr, sizeof(m_partial_hdr) );
 			return 2;
 		} else {
 			delete m_tmp;
@@ -870,15 +1048,36 @@ read_packet:
 		}
 	}
 
-        // Now, check MD
-        if (mode_ != MD_OFF) {
-            if (!m_tmp->verifyMD(cksum_ptr, mdChecker_)) {
+        // Now, check MD.  A sealed packet's tag covers that.
+        if (sealed) {
+            if (!m_tmp->open(hdr, p_sock)) {
+                delete m_tmp;
+		m_tmp = NULL;
+                dprintf(D_ALWAYS, "IO: Packet decryption/verification failed!\n");
+                return FALSE;
+            }
+        }
+        else if (mode_ != MD_OFF) {
+            if (!m_tmp->verifyMD(&hdr[5], mdChecker_)) {
                 delete m_tmp;
 		m_tmp = NULL;
                 dprintf(D_ALWAYS, "IO: Message Digest/MAC verification failed!\n");
                 return FALSE;  // or something other than this
             }
         }
+
+	if (p_sock->m_compressor) {
+		Buf *plain = new Buf;
+		if (!m_tmp->decompress(*plain, max_packet_size, p_sock->m_compressor)) {
+			delete plain;
+			delete m_tmp;
+			m_tmp = NULL;
+			dprintf(D_ALWAYS, "IO: Packet decompression failed\n");
+			return FALSE;
+		}
+		delete m_tmp;
+		m_tmp = plain;
+	}
         
 	if (!buf.put(m_tmp)) {
 		delete m_tmp;
@@ -911,6 +1110,7 @@ ReliSock::SndMsg::~SndMsg()
 void ReliSock::SndMsg::reset()
 {
 	buf.reset();
+	m_zbuf.reset();
 	delete m_out_buf;
 	m_out_buf = NULL;
 }
@@ -937,11 +1137,12 @@ int ReliSock::SndMsg::finish_packet(const char *peer_description, int sock, int
 	return retval;
 }
 
-void ReliSock::SndMsg::stash_packet()
+void ReliSock::SndMsg::stash_packet(Buf &out)
 {
 	dprintf(D_NETWORK, "Stashing packet for later due to non-blocking request.\n");
 	m_out_buf = new Buf();
-	m_out_buf->swap(buf);
+	m_out_buf->swap(out);
+	out.reset();
 	buf.reset();
 }
 
@@ -966,30 +1167,51 @@ int ReliSock::SndMsg::snd_packet( char const *peer_description, int _sock, int e
 	}
 		// 
 
-	char	        hdr[MAX_HEADER_SIZE];
+	char	        hdr[SEALED_HEADER_SIZE];
 	int		len, header_size;
 	int		ns;
+	bool	sealed = p_sock->crypto_seals_packets();
+
+	if (sealed) {
+		header_size = SEALED_HEADER_SIZE;
+	} else {
+		header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+	}
+		// The MAC or seal covers the packet as sent, so compress first.
+	Buf &out = p_sock->m_compressor ? m_zbuf : buf;
+	if (p_sock->m_compressor) {
+		if (!buf.compress(header_size, m_zbuf, p_sock->m_compressor)) {
+			dprintf(D_ALWAYS, "IO: Failed to compress packet\n");
+			return FALSE;
+		}
+		buf.reset();
+	}
 
-	header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
 	hdr[0] = (char) end;
-	ns = buf.num_used() - header_size;
+	ns = out.num_used() - header_size;
 	len = (int) htonl(ns);
 
 	memcpy(&hdr[1], &len, 4);
 
-	if (mode_ != MD_OFF) {
-		if (!buf.computeMD(&hdr[5], mdChecker_)) {
+	if (sealed) {
+		if (!out.seal(hdr, header_size, p_sock)) {
+			dprintf(D_ALWAYS, "IO: Failed to encrypt packet\n");
+			return FALSE;
+		}
+	}
+	else if (mode_ != MD_OFF) {
+		if (!out.computeMD(&hdr[5], mdChecker_)) {
 			dprintf(D_ALWAYS, "IO: Failed to compute Message Digest/MAC\n");
 			return FALSE;
 		}
 	}
 
-	int result = buf.flush(peer_description, _sock, hdr, header_size, _timeout, p_sock->is_non_blocking());
+	int result = out.flush(peer_description, _sock, hdr, header_size, _timeout, p_sock->is_non_blocking());
 	if (result < 0) {
 		return false;
 	} else if (result != ns+header_size) {
 		if (p_sock->is_non_blocking()) {
-			stash_packet();
+			stash_packet(out);
 			return 2;
 		} else {
 			return false;
@@ -998,6 +1220,31 @@ int ReliSock::SndMsg::snd_packet( char const *peer_description, int _sock, int e
         
 	if( end ) {
 		buf.dealloc_buf(); // save space, now that we are done sending
+		m_zbuf.dealloc_buf();
+	}
+	return TRUE;
+}
+
+int ReliSock::SndMsg::snd_packet_direct( char const *peer_description, int _sock, const char *data, int len, int _timeout )
+{
+	if (!finish_packet(peer_description, _sock, _timeout)) {
+		return FALSE;
+	}
+
+	char	hdr[NORMAL_HEADER_SIZE];
+	int		ns = (int) htonl(len);
+	hdr[0] = (char) 0;
+	memcpy(&hdr[1], &ns, 4);
+
+		// Tell the kernel more is coming, so that the header and the
+		// data go out together, as a writev() would send them.
+	int more_flag = 0;
+#ifdef MSG_MORE
+	more_flag = MSG_MORE;
+#endif
+	if (condor_write(peer_description, _sock, hdr, NORMAL_HEADER_SIZE, _timeout, more_flag) != NORMAL_HEADER_SIZE ||
+		condor_write(peer_description, _sock, data, len, _timeout) != len) {
+		return FALSE;
 	}
 	return TRUE;
 }
@@ -51,6 +51,7 @@
 #ifdef HAVE_EXT_OPENSSL
 #include "condor_crypt_blowfish.h"
 #include "condor_crypt_3des.h"
+#include "condor_crypt_aesgcm.h"
 #include "condor_md.h"                // Message authentication stuff
 #endif
 
@@ -1764,6 +1765,7 @@ Sock::cancel_connect()
 		// now close the underlying socket.  do not call Sock::close()
 		// here, because we do not want all the CEDAR socket state
 		// (like the _who data member) cleared.
+	Selector::fd_closing( get_file_desc() );
 	::closesocket(_sock);
 	_sock = INVALID_SOCKET;
 	_state = sock_virgin;
@@ -1866,6 +1868,7 @@ int Sock::close()
 	}
 
 	if ( _sock != INVALID_SOCKET ) {
+		Selector::fd_closing( get_file_desc() );
 		if (::closesocket(_sock) < 0) {
 			dprintf( D_NETWORK, "CLOSE FAILED %s %s fd=%d\n",
 						type() == Stream::reli_sock ? "TCP" : "UDP",
@@ -2097,6 +2100,20 @@ char * Sock::serializeCryptoInfo() const
         for (int i=0; i < len; i++, kserial++, ptr+=2) {
             sprintf(ptr, "%02X", *kserial);
         }
+
+#ifdef HAVE_EXT_OPENSSL
+        // An authenticated cipher checks that packets arrive in sequence,
+        // so the nonces can't start over in the process that inherits us.
+        if (crypto_seals_packets()) {
+            std::string nonces;
+            serializeNonces(nonces);
+            std::string buf(outbuf);
+            formatstr_cat(buf, "*%s", nonces.c_str());
+            delete [] outbuf;
+            outbuf = new char[buf.size() + 1];
+            strcpy(outbuf, buf.c_str());
+        }
+#endif
     }
     else {
         outbuf = new char[2];
@@ -2106,6 +2123,49 @@ char * Sock::serializeCryptoInfo() const
     return( outbuf );
 }
 
+#ifdef HAVE_EXT_OPENSSL
+void Sock::serializeNonces(std::string & buf) const
+{
+    buf.clear();
+    for (int i = 0; i < AESGCM_IV_SIZE; i++) {
+        formatstr_cat(buf, "%02X", crypto_state_->m_seal_iv[i]);
+    }
+    formatstr_cat(buf, ":%llu:", (unsigned long long)crypto_state_->m_seal_count);
+    for (int i = 0; i < AESGCM_IV_SIZE; i++) {
+        formatstr_cat(buf, "%02X", crypto_state_->m_open_iv[i]);
+    }
+    formatstr_cat(buf, ":%llu", (unsigned long long)crypto_state_->m_open_count);
+}
+
+const char * Sock::serializeNonces(const char * buf)
+{
+    unsigned char seal_iv[AESGCM_IV_SIZE], open_iv[AESGCM_IV_SIZE];
+    unsigned long long seal_count = 0, open_count = 0;
+    unsigned int hex;
+    for (int i = 0; i < AESGCM_IV_SIZE; i++, buf += 2) {
+        ASSERT( sscanf(buf, "%2X", &hex) == 1 );
+        seal_iv[i] = (unsigned char)hex;
+    }
+    ASSERT( sscanf(buf, ":%llu:", &seal_count) == 1 );
+    buf = strchr(buf + 1, ':');
+    ASSERT( buf );
+    buf++;
+    for (int i = 0; i < AESGCM_IV_SIZE; i++, buf += 2) {
+        ASSERT( sscanf(buf, "%2X", &hex) == 1 );
+        open_iv[i] = (unsigned char)hex;
+    }
+    ASSERT( sscanf(buf, ":%llu", &open_count) == 1 );
+    buf = strchr(buf, '*');
+    ASSERT( buf );
+
+    memcpy(crypto_state_->m_seal_iv, seal_iv, AESGCM_IV_SIZE);
+    crypto_state_->m_seal_count = seal_count;
+    memcpy(crypto_state_->m_open_iv, open_iv, AESGCM_IV_SIZE);
+    crypto_state_->m_open_count = open_count;
+    return buf;
+}
+#endif
+
 char * Sock::serializeMdInfo() const
 {
     const unsigned char * kmd = NULL;
@@ -2192,6 +2252,12 @@ const char * Sock::serializeCryptoInfo(const char * buf)
         KeyInfo k((unsigned char *)kserial, len, (Protocol)protocol);
         set_crypto_key(encryption_mode==1, &k, 0);
         free(kserial);
+#ifdef HAVE_EXT_OPENSSL
+        if (crypto_seals_packets()) {
+            ASSERT( *ptmp == '*' );
+            ptmp = serializeNonces(ptmp + 1);
+        }
+#endif
 		ASSERT( *ptmp == '*' );
         // Now, skip over this one
         ptmp++;
@@ -2879,6 +2945,44 @@ Sock::unwrap(const unsigned char* d_in,int l_in,
     return coded;
 }
 
+bool
+Sock::crypto_seals_packets() const
+{
+#ifdef HAVE_EXT_OPENSSL
+    return crypto_state_ && crypto_state_->m_keyInfo.getProtocol() == CONDOR_AESGCM;
+#else
+    return false;
+#endif
+}
+
+bool
+Sock::seal_packet(const unsigned char* hdr, int hdr_len,
+                  unsigned char* data, int data_len,
+                  unsigned char* tag, unsigned char* iv)
+{
+#ifdef HAVE_EXT_OPENSSL
+    if (crypto_seals_packets()) {
+        return static_cast<Condor_Crypt_AESGCM*>(crypto_)->seal(crypto_state_,
+            hdr, hdr_len, data, data_len, tag, iv);
+    }
+#endif
+    return false;
+}
+
+bool
+Sock::open_packet(const unsigned char* hdr, int hdr_len,
+                  unsigned char* data, int data_len,
+                  const unsigned char* tag, const unsigned char* iv)
+{
+#ifdef HAVE_EXT_OPENSSL
+    if (crypto_seals_packets()) {
+        return static_cast<Condor_Crypt_AESGCM*>(crypto_)->open(crypto_state_,
+            hdr, hdr_len, data, data_len, tag, iv);
+    }
+#endif
+    return false;
+}
+
 void Sock::resetCrypto()
 {
 #ifdef HAVE_EXT_OPENSSL
@@ -2910,6 +3014,10 @@ Sock::initialize_crypto(KeyInfo * key)
 			setCryptoMethodUsed("3DES");
             crypto_ = new Condor_Crypt_3des();
             break;
+        case CONDOR_AESGCM:
+			setCryptoMethodUsed("AESGCM");
+            crypto_ = new Condor_Crypt_AESGCM();
+            break;
 #endif
         default:
             break;
@@ -41,9 +41,11 @@
 #include "condor_daemon_core.h"
 #include "selector.h"
 #include "consumption_policy.h"
+#include "classad_helpers.h"
 #include "condor_classad.h"
 #include "subsystem_info.h"
 #include "authentication.h"
+#include "classad/compiledExpr.h"
 
 #include <vector>
 #include <string>
@@ -103,6 +105,13 @@ public:
     int prefetch_duration;
     double prefetch_cpu_time;
 
+    // parts of phase 4, in seconds
+    double matchmaking_duration;
+    double parallel_match_duration;
+
+    int match_cache_hits;
+    int match_cache_misses;
+
     int total_slots;
     int trimmed_slots;
     int candidate_slots;
@@ -145,6 +154,10 @@ NegotiationCycleStats::NegotiationCycleStats():
     phase4_cpu_time(0.0),
     prefetch_duration(0),
     prefetch_cpu_time(0.0),
+    matchmaking_duration(0.0),
+    parallel_match_duration(0.0),
+    match_cache_hits(0),
+    match_cache_misses(0),
     total_slots(0),
     trimmed_slots(0),
     candidate_slots(0),
@@ -396,6 +409,9 @@ Matchmaker ()
 
 	want_globaljobprio = false;
 	want_matchlist_caching = false;
+	want_match_result_caching = false;
+	m_num_threads = 1;
+	want_compiled_requirements = false;
 	PublishCrossSlotPrios = false;
 	ConsiderPreemption = true;
 	ConsiderEarlyPreemption = false;
@@ -768,6 +784,17 @@ reinitialize ()
 
 	want_globaljobprio = param_boolean("USE_GLOBAL_JOB_PRIOS",false);
 	want_matchlist_caching = param_boolean("NEGOTIATOR_MATCHLIST_CACHING",true);
+	want_match_result_caching = param_boolean("NEGOTIATOR_MATCH_RESULT_CACHING",false);
+		// the config may have changed the expressions we insert into slot ads
+	m_matchResultCache.clear();
+	m_num_threads = param_integer("NEGOTIATOR_NUM_THREADS", 1, 1);
+#ifndef _OPENMP
+	if (m_num_threads > 1) {
+		dprintf(D_ALWAYS, "WARNING: NEGOTIATOR_NUM_THREADS=%d will be ignored, because this negotiator was built without OpenMP\n", m_num_threads);
+		m_num_threads = 1;
+	}
+#endif
+	want_compiled_requirements = param_boolean("NEGOTIATOR_COMPILE_REQUIREMENTS", false);
 	PublishCrossSlotPrios = param_boolean("NEGOTIATOR_CROSS_SLOT_PRIOS", false);
 	ConsiderPreemption = param_boolean("NEGOTIATOR_CONSIDER_PREEMPTION",true);
 	ConsiderEarlyPreemption = param_boolean("NEGOTIATOR_CONSIDER_EARLY_PREEMPTION",false);
@@ -1423,6 +1450,19 @@ compute_significant_attrs(ClassAdListDoesNotDeleteAds & startdAds)
 	// Simplify the attribute references
 	TrimReferenceNames( external_references, true );
 
+		// Remember which of the attributes that negotiate() inserts into each
+		// request the slots refer to, since the match results depend on them.
+	static const char * const request_attrs[] = {
+		ATTR_SUBMITTOR_PRIO, ATTR_SUBMITTER_USER_PRIO, ATTR_SUBMITTER_USER_RESOURCES_IN_USE,
+		ATTR_SUBMITTER_GROUP_RESOURCES_IN_USE, ATTR_SUBMITTER_GROUP_QUOTA,
+	};
+	negotiator_job_attr_references.clear();
+	for (size_t ix = 0; ix < COUNTOF(request_attrs); ++ix) {
+		if (external_references.count(request_attrs[ix])) {
+			negotiator_job_attr_references.insert(request_attrs[ix]);
+		}
+	}
+
 		// Always get rid of the follow attrs:
 		//    CurrentTime - for obvious reasons
 		//    RemoteUserPrio - not needed since we negotiate per user
@@ -1710,6 +1750,10 @@ negotiationTime ()
 	// available during matchmaking
 	addRemoteUserPrios( startdAds );
 
+	if (want_match_result_caching) {
+		m_matchResultCache.beginCycle( startdAds );
+	}
+
 	SetupMatchSecurity(submitterAds);
 
     if (hgq_groups.size() <= 1) {
@@ -4869,12 +4913,14 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 		{
             remoteUser = "";
 			// 2e(i).  find a compatible offer
+			double start_matchmaking = condor_gettimestamp_double();
 			offer=matchmakingAlgorithm(submitterName, scheddAddr.c_str(), request,
                                              startdAds, priority,
                                              limitUsed, limitUsedUnclaimed,
                                              submitterLimit, submitterLimitUnclaimed,
 											 pieLeft,
 											 only_consider_startd_rank);
+			negotiation_cycle_stats[0]->matchmaking_duration += condor_gettimestamp_double() - start_matchmaking;
 
 			if( !offer )
 			{
@@ -5391,55 +5437,94 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 
 	bool allow_pslot_preemption = param_boolean("ALLOW_PSLOT_PREEMPTION", false);
 	double allocatedWeight = 0.0;
-		// Set up for parallel matchmaking, if enabled
-	std::vector<ClassAd *> par_candidates;
-	std::vector<ClassAd *> par_matches;
-
-	int num_threads =  param_integer("NEGOTIATOR_NUM_THREADS", 1);
-	if (num_threads > 1) {
-		startdAds.Open();
-		par_candidates.reserve(startdAds.Length());
-		while ((candidate = startdAds.Next())) {
-			par_candidates.push_back(candidate);
-		}
-		startdAds.Close();
-		ParallelIsAMatch(&request, par_candidates, par_matches, num_threads, false);
-	}
-
-	// scan the offer ads
-	startdAds.Open ();
-	std::string machineAddr;
 
 	bool isIPv4 = false;
 	bool isIPv6 = false;
 	getSinfulStringProtocolBools( false, false, scheddAddr, isIPv4, isIPv6 );
 
-	while ((candidate = startdAds.Next ())) {
+		// Returns true for offers that can't be matched with this request no
+		// matter what the Requirements say.
+	std::string machineAddr;
+	auto cannotMatch = [&](ClassAd *offer) -> bool {
 		bool v4 = false;
 		bool v6 = false;
-		candidate->LookupString( "MyAddress", machineAddr );
+		offer->LookupString( "MyAddress", machineAddr );
 		// This short-circuits based on the subsequent evaluation, so
 		// be sure only to change them in tandem.
 		getSinfulStringProtocolBools( isIPv4, isIPv6, machineAddr.c_str(),
 			v4, v6 );
-		if(! ((isIPv4 && v4) || (isIPv6 && v6))) { continue; }
-
-		if( IsDebugVerbose(D_MACHINE) ) {
-			dprintf(D_MACHINE,"Testing whether the job matches with the following machine ad:\n");
-			dPrintAd(D_MACHINE, *candidate);
-		}
+		if(! ((isIPv4 && v4) || (isIPv6 && v6))) { return true; }
 
 		if ( allow_pslot_preemption ) {
 			bool is_dslot = false;
-			candidate->LookupBool( ATTR_SLOT_DYNAMIC, is_dslot );
+			offer->LookupBool( ATTR_SLOT_DYNAMIC, is_dslot );
 			if ( is_dslot ) {
 				bool rollup = false;
-				candidate->LookupBool( ATTR_PSLOT_ROLLUP_INFORMATION, rollup );
+				offer->LookupBool( ATTR_PSLOT_ROLLUP_INFORMATION, rollup );
 				if ( rollup ) {
-					continue;
+					return true;
 				}
 			}
 		}
+		return false;
+	};
+
+		// The results of matching requests with the same signature against
+		// slots that haven't changed are remembered across negotiation cycles.
+	MatchResultCache::Results *cached_results = NULL;
+	if (want_match_result_caching) {
+		std::string signature;
+		if (matchResultSignature(request, signature)) {
+			cached_results = m_matchResultCache.results(signature);
+		}
+	}
+
+		// Set up for parallel matchmaking, if enabled.  The request is matched
+		// against all of the offers up front by NEGOTIATOR_NUM_THREADS threads,
+		// and since the matches come back in the order of startdAds, the scan
+		// below only has to step through them alongside the offers.  Offers
+		// with a consumption policy are left for the scan, because they have to
+		// be matched against the request as modified by the policy.  The scan
+		// still visits the offers in order and only replaces the best offer
+		// with a strictly better one, so the offer chosen is the same for any
+		// number of threads.
+	std::vector<ClassAd *> par_candidates;
+	std::vector<ClassAd *> par_matches;
+	size_t par_next = 0;
+	bool par_match = m_num_threads > 1;
+	if (par_match) {
+		double start_par_match = condor_gettimestamp_double();
+		startdAds.Open();
+		par_candidates.reserve(startdAds.Length());
+		while ((candidate = startdAds.Next())) {
+			if ( ! cannotMatch(candidate) && ! cp_supports_policy(*candidate) &&
+				 ( ! cached_results || m_matchResultCache.lookup(cached_results, candidate) < 0)) {
+				par_candidates.push_back(candidate);
+			}
+		}
+		startdAds.Close();
+		ParallelIsAMatch(&request, par_candidates, par_matches, m_num_threads, false);
+		negotiation_cycle_stats[0]->parallel_match_duration += condor_gettimestamp_double() - start_par_match;
+	}
+
+		// Compile the request's Requirements once, rather than walking the
+		// tree for each offer.  Offers with a consumption policy modify the
+		// request, so they are matched against the tree.
+	std::unique_ptr<classad::CompiledExpr> request_requirements;
+	if (want_compiled_requirements) {
+		request_requirements.reset(classad::CompiledExpr::Compile(request.Lookup(ATTR_REQUIREMENTS)));
+	}
+
+	// scan the offer ads
+	startdAds.Open ();
+
+	while ((candidate = startdAds.Next ())) {
+		if (cannotMatch(candidate)) { continue; }
+
+		if( IsDebugVerbose(D_MACHINE) ) {
+			dprintf(D_MACHINE,"Testing whether the job matches with the following machine ad:\n");
+			dPrintAd(D_MACHINE, *candidate);
+		}
 
         consumption_map_t consumption;
         bool has_cp = cp_supports_policy(*candidate);
@@ -5457,13 +5542,25 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
         // requested via consumption policy must also be available from
         // the resource
 		bool is_a_match = false;
-		if (num_threads > 1) {
-			is_a_match = cp_sufficient &&
-				(par_matches.end() !=
-					std::find(par_matches.begin(), par_matches.end(), candidate));
+		int cached_match = -1;
+		if (cached_results && ! has_cp) {
+			cached_match = m_matchResultCache.lookup(cached_results, candidate);
+		}
+		if (cached_match >= 0) {
+			is_a_match = cached_match > 0;
+			negotiation_cycle_stats[0]->match_cache_hits++;
+		} else if (par_match && ! has_cp) {
+			is_a_match = par_next < par_matches.size() && par_matches[par_next] == candidate;
+			if (is_a_match) { par_next++; }
+		} else if (request_requirements && ! has_cp) {
+			is_a_match = IsAMatch(&request, request_requirements.get(), candidate);
 		} else {
 			is_a_match = cp_sufficient && IsAMatch(&request, candidate);
 		}
+		if (cached_results && ! has_cp && cached_match < 0 &&
+			m_matchResultCache.store(cached_results, candidate, is_a_match)) {
+			negotiation_cycle_stats[0]->match_cache_misses++;
+		}
 
         if (has_cp) {
             // put original values back for RequestXxx attributes
@@ -6731,6 +6828,196 @@ void Matchmaker::DeleteMatchList()
 	unmutatedSlotAds.clear();
 }
 
+void Matchmaker::MatchResultCache::
+clear()
+{
+	m_slot_ids.clear();
+	m_slots.clear();
+	m_cycle_slots.clear();
+	m_results.clear();
+	m_num_present = 0;
+}
+
+void Matchmaker::MatchResultCache::
+beginCycle(ClassAdListDoesNotDeleteAds &startdAds)
+{
+	m_cycle++;
+	m_cycle_slots.clear();
+
+		// forget about slots that have gone away, once there are a lot of them
+	if (m_slot_ids.size() > 2*m_num_present + 1000) {
+		clear();
+	}
+
+	for (auto it = m_results.begin(); it != m_results.end(); ) {
+		if (it->second.last_cycle < m_cycle - 1) {
+			it = m_results.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	std::set<int> seen;
+	ClassAd *ad;
+	startdAds.Open();
+	while ((ad = startdAds.Next())) {
+			// The negotiator inserts user priority information into claimed
+			// slots every cycle, and deducts consumption policy assets from
+			// slots as they are matched, so the ad version doesn't tell us
+			// whether either of those has changed.
+		if (ad->Lookup(ATTR_REMOTE_USER_PRIO) || cp_supports_policy(*ad)) {
+			continue;
+		}
+		long long last_heard_from = 0, sequence = -1;
+		if ( ! ad->LookupInteger(ATTR_LAST_HEARD_FROM, last_heard_from) ||
+			 ! ad->LookupInteger(ATTR_UPDATE_SEQUENCE_NUMBER, sequence)) {
+			continue;
+		}
+
+		std::string id_str = MachineAdID(ad).c_str();
+		auto found = m_slot_ids.find(id_str);
+		int id;
+		if (found == m_slot_ids.end()) {
+			id = (int)m_slots.size();
+			m_slot_ids[id_str] = id;
+			SlotVersion version = { last_heard_from, sequence, 1, requirementsAreVolatile(*ad) };
+			m_slots.push_back(version);
+		} else {
+			id = found->second;
+			SlotVersion &version = m_slots[id];
+			if (version.last_heard_from != last_heard_from || version.sequence != sequence) {
+				version.last_heard_from = last_heard_from;
+				version.sequence = sequence;
+				version.generation++;
+				version.is_volatile = requirementsAreVolatile(*ad);
+			}
+		}
+			// two ads with the same name and address can't share results
+		if ( ! seen.insert(id).second) {
+			m_slots[id].generation++;
+			continue;
+		}
+		if (m_slots[id].is_volatile) {
+			continue;
+		}
+		m_cycle_slots[ad] = id;
+	}
+	startdAds.Close();
+	m_num_present = m_cycle_slots.size();
+}
+
+// Returns true if whether the slot matches can change without the slot ad
+// changing, because its Requirements depend on the time, or on the
+// priorities that addRemoteUserPrios() inserts for the other slots of the
+// machine when NEGOTIATOR_CROSS_SLOT_PRIOS is true.
+bool Matchmaker::MatchResultCache::
+requirementsAreVolatile(ClassAd &slot)
+{
+	static const char * const cross_slot_attrs[] = {
+		"_" ATTR_REMOTE_USER_PRIO, "_" ATTR_REMOTE_USER_RESOURCES_IN_USE,
+		"_" ATTR_REMOTE_GROUP_RESOURCES_IN_USE, "_" ATTR_REMOTE_GROUP_QUOTA,
+	};
+
+	ExprTree *requirements = slot.Lookup(ATTR_REQUIREMENTS);
+	classad::References refs;
+	if ( ! requirements || ! GetExprReferences(requirements, slot, &refs, &refs)) {
+		return true;
+	}
+	if (ExprTreeDependsOnTime(requirements)) {
+		return true;
+	}
+		// the references include those made through other attributes
+	for (auto it = refs.begin(); it != refs.end(); ++it) {
+		if (strcasecmp(it->c_str(), ATTR_CURRENT_TIME) == MATCH || ExprTreeDependsOnTime(slot.Lookup(*it))) {
+			return true;
+		}
+		for (size_t ix = 0; ix < COUNTOF(cross_slot_attrs); ++ix) {
+			size_t len = strlen(cross_slot_attrs[ix]);
+			if (it->size() > len && strcasecmp(it->c_str() + it->size() - len, cross_slot_attrs[ix]) == MATCH) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+Matchmaker::MatchResultCache::Results * Matchmaker::MatchResultCache::
+results(const std::string &signature)
+{
+	Results &results = m_results[signature];
+	results.last_cycle = m_cycle;
+	return &results;
+}
+
+int Matchmaker::MatchResultCache::
+lookup(Results *results, ClassAd *slot) const
+{
+	auto found = m_cycle_slots.find(slot);
+	if (found == m_cycle_slots.end()) {
+		return -1;
+	}
+	size_t id = found->second;
+	if (id >= results->generation.size() || results->generation[id] != m_slots[id].generation) {
+		return -1;
+	}
+	return results->matched[id] ? 1 : 0;
+}
+
+bool Matchmaker::MatchResultCache::
+store(Results *results, ClassAd *slot, bool matched)
+{
+	auto found = m_cycle_slots.find(slot);
+	if (found == m_cycle_slots.end()) {
+		return false;
+	}
+	size_t id = found->second;
+	if (id >= results->generation.size()) {
+		results->generation.resize(m_slots.size(), 0);
+		results->matched.resize(m_slots.size(), 0);
+	}
+	results->generation[id] = m_slots[id].generation;
+	results->matched[id] = matched;
+	return true;
+}
+
+// The signature of a request for the purpose of the MatchResultCache: the
+// values of the attributes that the schedd used to put the job into its
+// autocluster, of the job attributes that the slots refer to, and of the
+// attributes that negotiate() inserted into the request that the slots
+// refer to.  Returns false if the request has no autocluster, or if the
+// result of matching it could change with time.
+bool Matchmaker::
+matchResultSignature(ClassAd &request, std::string &signature)
+{
+	std::string sig_attrs;
+	if ( ! request.LookupString(ATTR_AUTO_CLUSTER_ATTRS, sig_attrs)) {
+		return false;
+	}
+
+	classad::References attrs;
+	add_attrs_from_string_tokens(attrs, sig_attrs);
+	if (job_attr_references) {
+		add_attrs_from_string_tokens(attrs, job_attr_references);
+	}
+	attrs.insert(negotiator_job_attr_references.begin(), negotiator_job_attr_references.end());
+	attrs.insert(ATTR_REQUIREMENTS);
+
+	classad::ClassAdUnParser unparser;
+	unparser.SetOldClassAd( true, true );
+	signature.clear();
+	for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+		ExprTree *tree = request.Lookup(*it);
+		if (strcasecmp(it->c_str(), ATTR_CURRENT_TIME) == MATCH || ExprTreeDependsOnTime(tree)) {
+			return false;
+		}
+		signature += *it;
+		signature += " = ";
+		if (tree) { unparser.Unparse(signature, tree); }
+		signature += '\n';
+	}
+	return true;
+}
+
 int Matchmaker::MatchListType::
 sort_compare(const void* elem1, const void* elem2)
 {
@@ -6806,9 +7093,13 @@ sort()
 	// once, this code has a bad logic errror, so ASSERT it.
 	ASSERT(already_sorted == false);
 
-	// Note: since we must use static members, sort() is
-	// _NOT_ thread safe!!!
-	qsort(AdListArray,adListLen,sizeof(AdListEntry),sort_compare);
+	// Slots of equal rank keep the order in which they were added,
+	// which is the order of the slots, so the result of the sort does
+	// not depend on how the matches were found.
+	std::stable_sort(AdListArray, AdListArray + adListLen,
+		[](const AdListEntry &a, const AdListEntry &b) {
+			return sort_compare(&a, &b) < 0;
+		});
 
 	already_sorted = true;
 }
@@ -7063,6 +7354,10 @@ Matchmaker::publishNegotiationCycleStats( ClassAd *ad )
         ATTR_LAST_NEGOTIATION_CYCLE_PHASE2_CPU_TIME,
         ATTR_LAST_NEGOTIATION_CYCLE_PHASE3_CPU_TIME,
         ATTR_LAST_NEGOTIATION_CYCLE_PHASE4_CPU_TIME,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_DURATION,
+        ATTR_LAST_NEGOTIATION_CYCLE_PARALLEL_MATCH_DURATION,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_HITS,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_MISSES,
         ATTR_LAST_NEGOTIATION_CYCLE_SCHEDDS_OUT_OF_TIME,
         ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_FAILED,
         ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_OUT_OF_TIME,
@@ -7118,6 +7413,10 @@ Matchmaker::publishNegotiationCycleStats( ClassAd *ad )
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_PHASE2_CPU_TIME, i, s->phase2_cpu_time );
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_PHASE3_CPU_TIME, i, s->phase3_cpu_time );
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_PHASE4_CPU_TIME, i, s->phase4_cpu_time );
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_DURATION, i, s->matchmaking_duration );
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_PARALLEL_MATCH_DURATION, i, s->parallel_match_duration );
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_HITS, i, s->match_cache_hits );
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCH_CACHE_MISSES, i, s->match_cache_misses );
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SCHEDDS_OUT_OF_TIME, i, s->schedds_out_of_time);
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_FAILED, i, s->submitters_failed);
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_OUT_OF_TIME, i, s->submitters_out_of_time);
@@ -379,6 +379,8 @@ class Matchmaker : public Service
 		ExprTree *NegotiatorPostJobRank; // rank applied after job rank
 		bool want_globaljobprio;	// cached value of config knob USE_GLOBAL_JOB_PRIOS
 		bool want_matchlist_caching;	// should we cache matches per autocluster?
+		int  m_num_threads;			// value of knob NEGOTIATOR_NUM_THREADS, threads used to evaluate slot Requirements
+		bool want_compiled_requirements; // value of knob NEGOTIATOR_COMPILE_REQUIREMENTS
 		bool PublishCrossSlotPrios; // value of knob NEGOTIATOR_CROSS_SLOT_PRIOS, default of false
 		bool ConsiderPreemption; // if false, negotiation is faster (default=true)
 		bool ConsiderEarlyPreemption; // if false, do not preempt slots that still have retirement time
@@ -426,6 +428,9 @@ class Matchmaker : public Service
 
 		// external references in startd ads ... used for autoclustering
 		char * job_attr_references;
+		// the external references in startd ads to attributes that the
+		// negotiator inserts into each request, left out of the above.
+		classad::References negotiator_job_attr_references;
 
 		// Epoch time when we finished most rescent negotiation cycle
 		time_t completedLastCycleTime;
@@ -569,6 +574,61 @@ class Matchmaker : public Service
 			
 			
 		};
+		// Results of matching the requests of an autocluster against
+		// the slots, kept across negotiation cycles.  The job side is keyed
+		// by a signature of the request attributes that matchmaking can
+		// depend on, the slot side by the Name and address of the slot; a
+		// result is used only if the slot ad is the same version, by
+		// LastHeardFrom and UpdateSequenceNumber, as when it was computed.
+		class MatchResultCache
+		{
+		public:
+			class Results;
+
+			MatchResultCache() : m_cycle(0), m_num_present(0) {}
+			void clear();
+
+			// start a negotiation cycle with these slots, and forget the
+			// results for signatures that were not used in the last cycle.
+			void beginCycle(ClassAdListDoesNotDeleteAds &startdAds);
+
+			// the results for requests with the given signature
+			Results * results(const std::string &signature);
+
+			// returns 1 for a match, 0 for no match, -1 if not known
+			int lookup(Results *results, ClassAd *slot) const;
+			// returns false if results for the slot can't be cached
+			bool store(Results *results, ClassAd *slot, bool matched);
+
+			size_t numSignatures() const { return m_results.size(); }
+
+			class Results
+			{
+				friend class MatchResultCache;
+				std::vector<unsigned int> generation; // by slot id, 0 if there is no result
+				std::vector<char> matched;
+				int last_cycle;
+			};
+
+		private:
+			struct SlotVersion {
+				long long last_heard_from;
+				long long sequence;
+				unsigned int generation; // incremented whenever the slot ad changes
+				bool is_volatile;        // results for the slot can't be cached
+			};
+			static bool requirementsAreVolatile(ClassAd &slot);
+			int m_cycle;
+			size_t m_num_present;
+			std::map<std::string, int> m_slot_ids;  // from MachineAdID
+			std::vector<SlotVersion> m_slots;       // by slot id
+			std::map<const ClassAd *, int> m_cycle_slots; // slots in this cycle whose results can be cached
+			std::map<std::string, Results> m_results; // by request signature
+		};
+		MatchResultCache m_matchResultCache;
+		bool want_match_result_caching; // value of knob NEGOTIATOR_MATCH_RESULT_CACHING
+		bool matchResultSignature(ClassAd &request, std::string &signature);
+
 		MatchListType* MatchList;
 		int cachedAutoCluster;
 		char* cachedName;
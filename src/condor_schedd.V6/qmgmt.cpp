@@ -56,6 +56,7 @@
 #include "iso_dates.h"
 #include "jobsets.h"
 #include <param_info.h>
+#include <algorithm>
 
 #if defined(HAVE_DLOPEN) || defined(WIN32)
 #include "ScheddPlugin.h"
@@ -70,6 +71,39 @@
 
 // Do filtered iteration in a way that is specific to the job queue
 //
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::filter_iterator::matches(AD ad)
+{
+	// we want to ignore all but job ads, unless the options flag indicates we should
+	// also iterate cluster ads, in any case we always want to skip the header ad.
+	if ( ! ad->IsJob()) {
+		if ( ! (m_options & JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS) || ! ad->IsCluster()) return false;
+	}
+
+	++m_examined;
+	if (m_requirements) {
+		bool boolVal;
+		int intVal;
+		classad::ExprTree &requirements = *const_cast<classad::ExprTree*>(m_requirements);
+		const classad::ClassAd *old_scope = requirements.GetParentScope();
+		requirements.SetParentScope( ad );
+		classad::Value result;
+		int retval = requirements.Evaluate(result);
+		requirements.SetParentScope(old_scope);
+		if (!retval) {
+			dprintf(D_FULLDEBUG, "Unable to evaluate ad.\n");
+			return false;
+		}
+
+		if (!(result.IsBooleanValue(boolVal) && boolVal) &&
+				!(result.IsIntegerValue(intVal) && intVal)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 template <typename K, typename AD>
 typename ClassAdLog<K,AD>::filter_iterator
 ClassAdLog<K,AD>::filter_iterator::operator++(int)
@@ -80,12 +114,35 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 		return cur;
 	}
 
-	HashIterator<K, AD> end = m_table->end();
-	bool boolVal;
-	int intVal;
 	int miss_count = 0;
 	Stopwatch sw;
 	sw.start();
+
+	// when the query planner gave us a list of candidate keys, we visit just those
+	if (m_keys) {
+		while (m_key_pos < m_keys->size())
+		{
+			miss_count++;
+			if ((miss_count % 500 == 0) && (sw.get_ms() > m_timeslice_ms)) {break;}
+
+			cur = *this;
+			AD tmp_ad = NULL;
+			// the ad may have left the queue since the candidates were chosen
+			if (m_table->lookup((*m_keys)[m_key_pos++], tmp_ad) < 0 || !tmp_ad) continue;
+			if ( ! matches(tmp_ad)) continue;
+
+			cur.m_key_ad = tmp_ad;
+			cur.m_found_ad = true;
+			m_found_ad = true;
+			break;
+		}
+		if ((m_key_pos >= m_keys->size()) && (!m_found_ad)) {
+			m_done = true;
+		}
+		return cur;
+	}
+
+	HashIterator<K, AD> end = m_table->end();
 	while (!(m_cur == end))
 	{
 		miss_count++;
@@ -101,30 +158,8 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 		cur = *this;
 		AD tmp_ad = (*m_cur++).second;
 		if (!tmp_ad) continue;
+		if ( ! matches(tmp_ad)) continue;
 
-		// we want to ignore all but job ads, unless the options flag indicates we should
-		// also iterate cluster ads, in any case we always want to skip the header ad.
-		if ( ! tmp_ad->IsJob()) {
-			if ( ! (m_options & JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS) || ! tmp_ad->IsCluster()) continue;
-		}
-
-		if (m_requirements) {
-			classad::ExprTree &requirements = *const_cast<classad::ExprTree*>(m_requirements);
-			const classad::ClassAd *old_scope = requirements.GetParentScope();
-			requirements.SetParentScope( tmp_ad );
-			classad::Value result;
-			int retval = requirements.Evaluate(result);
-			requirements.SetParentScope(old_scope);
-			if (!retval) {
-				dprintf(D_FULLDEBUG, "Unable to evaluate ad.\n");
-				continue;
-			}
-
-			if (!(result.IsBooleanValue(boolVal) && boolVal) &&
-					!(result.IsIntegerValue(intVal) && intVal)) {
-				continue;
-			}
-		}
 		//int tmp_int;
 		//if (!tmp_ad->EvaluateAttrInt(ATTR_CLUSTER_ID, tmp_int) || !tmp_ad->EvaluateAttrInt(ATTR_PROC_ID, tmp_int)) {
 		//	continue;
@@ -210,6 +245,11 @@ prio_rec	* PrioRec = &PrioRecArray[0];
 int			N_PrioRecs = 0;
 HashTable<int,int> *PrioRecAutoClusterRejected = NULL;
 int BuildPrioRecArrayTid = -1;
+// when true, changes to a job update just that job's record in the PrioRec array
+// rather than causing the whole array to be rebuilt
+static bool incremental_prio_rec_updates = true;
+// jobs whose records in the PrioRec array are stale
+static std::set<JOB_ID_KEY> PrioRecDirtyJobs;
 
 static int 	MAX_PRIO_REC=INITIAL_MAX_PRIO_REC ;	// INITIAL_MAX_* in prio_rec.h
 
@@ -239,6 +279,19 @@ static void HandleFlushJobQueueLogTimer();
 static int dirty_notice_interval = 0;
 static void PeriodicDirtyAttributeNotification();
 static void ScheduleJobQueueLogFlush();
+static bool clean_job_queue_in_background = false;
+static bool binary_job_queue_log = false; // write the job queue log in binary rather than text
+// when true, durable commits by qmgmt clients share an fsync with the other
+// commits made in the same pass of the event loop
+static bool group_commit_job_queue = false;
+static int group_commit_timer_id = -1;
+static std::vector<QmgmtPeer*> GroupCommitWaiters; // connections waiting for the group fsync
+static void HandleGroupCommitTimer();
+static void SyncGroupCommits(bool resume_connections);
+static bool SendGroupCommitReply(QmgmtPeer &peer);
+static int resume_q_requests(Stream *sock);
+static int job_queue_snapshot_tid = -1;
+static int job_queue_snapshot_reaper_id = -1;
 
 bool qmgmt_all_users_trusted = false;
 static std::vector<std::string> super_users;
@@ -252,11 +305,182 @@ static const char *default_super_user =
 // in schedd.cpp
 void IncrementLiveJobCounter(LiveJobCounters & num, int universe, int status, int increment /*, JobQueueJob * job*/);
 
+// Indexes of the jobs in the queue by Owner and by JobStatus, so that a query
+// whose constraint requires one of those to equal a literal only has to examine
+// the jobs filed under that value.  Queries on ClusterId use the jobs attached to
+// the cluster object instead.  Only committed values are indexed, and the query
+// constraint is still evaluated against every job that the index yields.
+typedef std::set<JOB_ID_KEY> JobQueryIndexEntry;
+static std::map<std::string, JobQueryIndexEntry, classad::CaseIgnLTStr> JobsByOwner;
+static std::map<int, JobQueryIndexEntry> JobsByStatus;
+static size_t NumIndexedJobs = 0;
+
+static void IndexJobOwnerForQueries(JobQueueJob * job)
+{
+	std::string owner;
+	if (job->LookupString(ATTR_OWNER, owner)) {
+		auto it = JobsByOwner.insert(std::make_pair(owner, JobQueryIndexEntry())).first;
+		it->second.insert(job->jid);
+		job->query_owner = &it->first;
+	}
+}
+
+static void UnindexJobOwnerForQueries(JobQueueJob * job)
+{
+	if ( ! job->query_owner) return;
+	auto it = JobsByOwner.find(*job->query_owner);
+	if (it != JobsByOwner.end()) {
+		it->second.erase(job->jid);
+		// no other job can point at the key of an empty entry
+		if (it->second.empty()) { JobsByOwner.erase(it); }
+	}
+	job->query_owner = NULL;
+}
+
+// add a job to the query indexes, called when the job is attached to its cluster
+static void IndexJobForQueries(JobQueueJob * job)
+{
+	if (job->query_status >= 0) return;
+	IndexJobOwnerForQueries(job);
+	job->query_status = job->Status();
+	JobsByStatus[job->query_status].insert(job->jid);
+	++NumIndexedJobs;
+}
+
+// remove a job from the query indexes, called when the job object is deleted
+static void UnindexJobForQueries(JobQueueJob * job)
+{
+	if (job->query_status < 0) return;
+	UnindexJobOwnerForQueries(job);
+	auto it = JobsByStatus.find(job->query_status);
+	if (it != JobsByStatus.end()) {
+		it->second.erase(job->jid);
+		if (it->second.empty()) { JobsByStatus.erase(it); }
+	}
+	job->query_status = -1;
+	--NumIndexedJobs;
+}
+
+// move a job to the index entry for its status, called after job->SetStatus()
+static void ReindexJobStatusForQueries(JobQueueJob * job)
+{
+	if (job->query_status < 0 || job->query_status == job->Status()) return;
+	auto it = JobsByStatus.find(job->query_status);
+	if (it != JobsByStatus.end()) {
+		it->second.erase(job->jid);
+		if (it->second.empty()) { JobsByStatus.erase(it); }
+	}
+	job->query_status = job->Status();
+	JobsByStatus[job->query_status].insert(job->jid);
+}
+
+// move a job to the index entry for its Owner, called when a committed transaction set Owner
+static void ReindexJobOwnerForQueries(JobQueueJob * job)
+{
+	if (job->query_status < 0) return;
+	std::string owner;
+	if (job->query_owner && job->LookupString(ATTR_OWNER, owner) && owner == *job->query_owner) return;
+	UnindexJobOwnerForQueries(job);
+	IndexJobOwnerForQueries(job);
+}
+
+// Look at the clauses that the query constraint joins with &&, and for those that
+// require Owner, JobStatus or ClusterId to equal a literal, pick the one that selects
+// the fewest jobs.  Returns false when no clause narrows the query, in which case
+// every job must be examined, otherwise keys is filled with the candidate jobs.
+static bool
+PlanJobQueueQuery(const classad::ExprTree * requirements, std::vector<JOB_ID_KEY> & keys)
+{
+	std::vector<classad::ExprTree*> clauses;
+	std::vector<classad::ExprTree*> todo(1, const_cast<classad::ExprTree*>(requirements));
+	while ( ! todo.empty()) {
+		classad::ExprTree * tree = SkipExprParens(todo.back());
+		todo.pop_back();
+		if ( ! tree) continue;
+		if (tree->GetKind() == classad::ExprTree::OP_NODE) {
+			classad::Operation::OpKind op;
+			classad::ExprTree *t1, *t2, *t3;
+			((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+			if (op == classad::Operation::LOGICAL_AND_OP) {
+				todo.push_back(t2);
+				todo.push_back(t1);
+				continue;
+			}
+		}
+		clauses.push_back(tree);
+	}
+
+	static const JobQueryIndexEntry no_jobs;
+	const JobQueryIndexEntry * best_set = NULL;
+	JobQueueCluster * best_cluster = NULL;
+	size_t best_size = NumIndexedJobs;
+	bool planned = false;
+
+	for (auto it = clauses.begin(); it != clauses.end(); ++it) {
+		classad::Operation::OpKind op;
+		std::string attr;
+		classad::Value value;
+		if ( ! ExprTreeIsAttrCmpLiteral(*it, op, attr, value)) continue;
+		if (op != classad::Operation::EQUAL_OP && op != classad::Operation::META_EQUAL_OP) continue;
+
+		std::string str;
+		long long num = 0;
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_OWNER) && value.IsStringValue(str)) {
+			// the index is case-insensitive like ==, so it also covers =?=
+			auto found = JobsByOwner.find(str);
+			const JobQueryIndexEntry * set = (found == JobsByOwner.end()) ? &no_jobs : &found->second;
+			if ( ! planned || set->size() < best_size) {
+				best_set = set; best_cluster = NULL; best_size = set->size(); planned = true;
+			}
+		} else if (MATCH == strcasecmp(attr.c_str(), ATTR_JOB_STATUS) && value.IsIntegerValue(num)) {
+			auto found = JobsByStatus.find((int)num);
+			const JobQueryIndexEntry * set = (found == JobsByStatus.end()) ? &no_jobs : &found->second;
+			if ( ! planned || set->size() < best_size) {
+				best_set = set; best_cluster = NULL; best_size = set->size(); planned = true;
+			}
+		} else if (MATCH == strcasecmp(attr.c_str(), ATTR_CLUSTER_ID) && value.IsIntegerValue(num)) {
+			JobQueueCluster * cad = (num > 0) ? GetClusterAd((int)num) : NULL;
+			size_t size = cad ? cad->NumAttachedJobs() : 0;
+			if ( ! planned || size < best_size) {
+				best_set = cad ? NULL : &no_jobs; best_cluster = cad; best_size = size; planned = true;
+			}
+		}
+	}
+
+	// an index entry that holds every job is no better than walking the queue
+	if ( ! planned || (best_size >= NumIndexedJobs && best_size > 0)) {
+		return false;
+	}
+
+	keys.clear();
+	keys.reserve(best_size);
+	if (best_cluster) {
+		for (JobQueueJob * job = best_cluster->NextAttachedJob(NULL); job; job = best_cluster->NextAttachedJob(job)) {
+			keys.push_back(job->jid);
+		}
+	} else if (best_set) {
+		keys.assign(best_set->begin(), best_set->end());
+	}
+	return true;
+}
+
 //static int allow_remote_submit = FALSE;
 JobQueueLogType::filter_iterator
-GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms)
+GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms, int options, int * candidates)
 {
-	return JobQueue->GetFilteredIterator(requirements, timeslice_ms);
+	JobQueueLogType::filter_iterator it = JobQueue->GetFilteredIterator(requirements, timeslice_ms);
+	it.set_options(options);
+	if (candidates) { *candidates = (int)NumIndexedJobs; }
+
+	// cluster ads are not in the indexes, so queries that want them must walk the queue
+	if ( ! (options & JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS)) {
+		std::shared_ptr<std::vector<JOB_ID_KEY> > keys(new std::vector<JOB_ID_KEY>());
+		if (PlanJobQueueQuery(&requirements, *keys)) {
+			if (candidates) { *candidates = (int)keys->size(); }
+			it.set_keys(keys);
+		}
+	}
+	return it;
 }
 
 JobQueueLogType::filter_iterator
@@ -384,6 +608,13 @@ void JobQueueCluster::PopulateInfoAd(ClassAd & iad, int num_pending, bool includ
 }
 
 
+JobQueueJob * JobQueueCluster::NextAttachedJob(JobQueueJob * job)
+{
+	qelm * q = job ? job->qe.next() : qe.next();
+	if (q == &qe) return NULL;
+	return q->as<JobQueueJob>();
+}
+
 // detach all of the procs from a cluster, we really hope that the list of attached proc
 // is empty before we get to the ::Delete call below, but just in case it isn't do the detach here.
 void JobQueueCluster::DetachAllJobs() {
@@ -421,10 +652,12 @@ ConstructClassAdLogTableEntry<JobQueueJob*>::Delete(ClassAd* &ad) const
 			// in which case the actual destruction would be delayed until the transaction commit. i.e. here...
 			IncrementLiveJobCounter(scheduler.liveJobCounts, job->Universe(), job->Status(), -1);
 			if (job->ownerinfo) { IncrementLiveJobCounter(job->ownerinfo->live, job->Universe(), job->Status(), -1); }
+			scheduler.UncountJob(job);
 
 			if (job->Cluster()) {
 				job->Cluster()->DetachJob(job);
 			}
+			UnindexJobForQueries(job);
 		}
 	}
 	delete job;
@@ -969,6 +1202,7 @@ QmgmtPeer::QmgmtPeer()
 	transaction = NULL;
 	allow_protected_attr_changes_by_superuser = true;
 	readonly = false;
+	commit_reply_pending = false;
 
 	unset();
 }
@@ -1271,6 +1505,20 @@ InitQmgmt()
 
 	flush_job_queue_log_delay = param_integer("SCHEDD_JOB_QUEUE_LOG_FLUSH_DELAY",5,0);
 	dirty_notice_interval = param_integer("SCHEDD_JOB_QUEUE_NOTIFY_UPDATES",30,0);
+	clean_job_queue_in_background = param_boolean("QUEUE_CLEAN_IN_BACKGROUND", false);
+	group_commit_job_queue = param_boolean("SCHEDD_JOB_QUEUE_GROUP_COMMIT", false);
+	binary_job_queue_log = param_boolean("SCHEDD_JOB_QUEUE_LOG_BINARY", false);
+	if (JobQueue) {
+		JobQueue->SetBinaryLog(binary_job_queue_log);
+	}
+
+	bool incremental = param_boolean("SCHEDD_INCREMENTAL_RUNNABLE_JOB_LIST", true);
+	if (incremental != incremental_prio_rec_updates) {
+		// changes were not tracked per job while this was off, so start over
+		incremental_prio_rec_updates = incremental;
+		PrioRecDirtyJobs.clear();
+		DirtyPrioRecArray();
+	}
 }
 
 void
@@ -1582,7 +1830,13 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 	int spool_cur_version = 0;
 	CheckSpoolVersion(spool.Value(),SPOOL_MIN_VERSION_SCHEDD_SUPPORTS,SPOOL_CUR_VERSION_SCHEDD_SUPPORTS,spool_min_version,spool_cur_version);
 
-	JobQueue = new JobQueueType(new ConstructClassAdLogTableEntry<JobQueuePayload>(),job_queue_name,max_historical_logs);
+		// the values in the log can be parsed on several threads, which
+		// shortens startup when the queue is large.
+	int replay_threads = param_integer("SCHEDD_JOB_QUEUE_REPLAY_THREADS", 0, 0);
+	double begin = _condor_debug_get_time_double();
+	JobQueue = new JobQueueType(new ConstructClassAdLogTableEntry<JobQueuePayload>(),job_queue_name,max_historical_logs,replay_threads);
+	JobQueue->SetBinaryLog(binary_job_queue_log);
+	double load_time = _condor_debug_get_time_double() - begin;
 	ClusterSizeHashTable = new ClusterSizeHashTable_t(hashFuncInt);
 	TotalJobsCount = 0;
 	jobs_added_this_transaction = 0;
@@ -1897,6 +2151,7 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 				// Add the job to various runtime indexes for quick lookups
 				//
 			scheduler.indexAJob(ad, true);
+			IndexJobForQueries(ad);
 
 				// If input files are going to be spooled, rewrite
 				// the paths in the job ad to point at our spool area.
@@ -1968,6 +2223,9 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 			TotalJobsCount++;
 		}
 	} // WHILE
+	double setup_time = _condor_debug_get_time_double() - begin - load_time;
+	dprintf(D_ALWAYS, "Loaded job queue %s in %.3f seconds: log %.3f, job setup %.3f\n",
+		job_queue_name, load_time + setup_time, load_time, setup_time);
 
 	// If JobSets enabled, scan again to add jobs into sets
 	if (scheduler.jobSets ) {
@@ -2048,7 +2306,13 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 void
 CleanJobQueue()
 {
-	if (JobQueueDirty) {
+	if (job_queue_snapshot_tid != -1) {
+			// the rotation below makes the snapshot useless.  forget the
+			// child, so its reaper is ignored and a new clean can start.
+		daemonCore->Kill_Thread(job_queue_snapshot_tid);
+		job_queue_snapshot_tid = -1;
+	}
+	if (JobQueueDirty || JobQueue->InBackgroundTruncLog()) {
 		dprintf(D_ALWAYS, "Cleaning job queue...\n");
 		JobQueue->TruncLog();
 		JobQueueDirty = false;
@@ -2056,6 +2320,72 @@ CleanJobQueue()
 }
 
 
+// runs in a forked child, which has a copy of the job queue as it was
+// when the background clean began.
+static int
+WriteJobQueueSnapshot(void * /*arg*/, Stream * /*sock*/)
+{
+	return JobQueue->WriteSnapshot() ? 0 : 1;
+}
+
+static int
+JobQueueSnapshotReaper(int tid, int exit_status)
+{
+	if (tid != job_queue_snapshot_tid) {
+		return 0;
+	}
+	job_queue_snapshot_tid = -1;
+
+	bool written = WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0;
+	if ( ! written) {
+		dprintf(D_ALWAYS, "Writing a snapshot of the job queue failed (status %d)\n", exit_status);
+	}
+		// falls back to cleaning the job queue in the foreground
+		// if the snapshot was not written
+	JobQueue->EndBackgroundTruncLog(written);
+	return 0;
+}
+
+// Clean the job queue log without blocking the schedd while the job queue
+// is written out.  New log records go to a tail file while a child writes
+// a snapshot of the queue, then the tail is appended to the snapshot.
+void
+PeriodicCleanJobQueue()
+{
+	if ( ! clean_job_queue_in_background) {
+		CleanJobQueue();
+		return;
+	}
+	if (job_queue_snapshot_tid != -1) {
+		dprintf(D_ALWAYS, "Not cleaning job queue, the last clean is still running\n");
+		return;
+	}
+
+	dprintf(D_ALWAYS, "Cleaning job queue in the background...\n");
+	if ( ! JobQueue->BeginBackgroundTruncLog()) {
+		CleanJobQueue();
+		return;
+	}
+		// the snapshot will include everything that made the queue dirty
+	JobQueueDirty = false;
+
+	if (job_queue_snapshot_reaper_id == -1) {
+		job_queue_snapshot_reaper_id = daemonCore->Register_Reaper(
+			"JobQueueSnapshotReaper",
+			JobQueueSnapshotReaper,
+			"JobQueueSnapshotReaper");
+	}
+	job_queue_snapshot_tid = daemonCore->Create_Thread(
+		WriteJobQueueSnapshot, NULL, NULL,
+		job_queue_snapshot_reaper_id);
+	if ( ! job_queue_snapshot_tid) {
+		job_queue_snapshot_tid = -1;
+		dprintf(D_ALWAYS, "Failed to create a process to write the job queue snapshot\n");
+		JobQueue->EndBackgroundTruncLog(false);
+	}
+}
+
+
 void
 DestroyJobQueue( void )
 {
@@ -2069,6 +2399,10 @@ DestroyJobQueue( void )
 	// object deleted by the time the child cleanup is attempted.
 	schedd_forker.DeleteAll( );
 
+		// Make any group commits durable and answer the clients waiting
+		// on them before the log goes away.
+	SyncGroupCommits(false);
+
 	if (JobQueueDirty) {
 			// We can't destroy it until it's clean.
 		CleanJobQueue();
@@ -2824,30 +3158,14 @@ unsetQSock()
 }
 
 
-int
-handle_q(int cmd, Stream *sock)
+// Serve requests on the connection in Q_SOCK until the client closes it,
+// a query forks, or a commit has to wait for the group fsync.  In the last
+// case the connection is handed to SyncGroupCommits() and KEEP_STREAM is
+// returned.
+static int
+serve_q_requests()
 {
 	int	rval;
-	bool all_good;
-
-	all_good = setQSock((ReliSock*)sock);
-
-		// if setQSock failed, unset it to purge any old/stale
-		// connection that was never cleaned up, and try again.
-	if ( !all_good ) {
-		unsetQSock();
-		all_good = setQSock((ReliSock*)sock);
-	}
-	if (!all_good && sock) {
-		// should never happen
-		EXCEPT("handle_q: Unable to setQSock!!");
-	}
-	ASSERT(Q_SOCK);
-
-	Q_SOCK->setReadOnly(cmd == QMGMT_READ_CMD);
-
-	BeginTransaction();
-
 	bool may_fork = false;
 	ForkStatus fork_status = FORK_FAILED;
 	do {
@@ -2861,6 +3179,30 @@ handle_q(int cmd, Stream *sock)
 				break;
 			}
 		}
+
+		if( rval >= 0 && Q_SOCK->commit_reply_pending && fork_status == FORK_CHILD ) {
+				// a forked worker has no event loop to wait in
+			JobQueue->SyncGroupCommits();
+			if( !SendGroupCommitReply(*Q_SOCK) ) {
+				rval = -1;
+			}
+		}
+		else if( rval >= 0 && Q_SOCK->commit_reply_pending ) {
+			QmgmtPeer *peer = getQmgmtConnectionInfo();
+			ReliSock *sock = peer->getReliSock();
+				// don't read the next request until the commit is acknowledged
+			if( daemonCore->SocketIsRegistered(sock) ) {
+				daemonCore->Cancel_Socket(sock);
+			}
+			GroupCommitWaiters.push_back(peer);
+			if( group_commit_timer_id == -1 ) {
+				group_commit_timer_id = daemonCore->Register_Timer(
+					0,
+					HandleGroupCommitTimer,
+					"HandleGroupCommitTimer");
+			}
+			return KEEP_STREAM;
+		}
 	} while(rval >= 0);
 
 
@@ -2885,6 +3227,51 @@ handle_q(int cmd, Stream *sock)
 	return 0;
 }
 
+int
+handle_q(int cmd, Stream *sock)
+{
+	bool all_good;
+
+	all_good = setQSock((ReliSock*)sock);
+
+		// if setQSock failed, unset it to purge any old/stale
+		// connection that was never cleaned up, and try again.
+	if ( !all_good ) {
+		unsetQSock();
+		all_good = setQSock((ReliSock*)sock);
+	}
+	if (!all_good && sock) {
+		// should never happen
+		EXCEPT("handle_q: Unable to setQSock!!");
+	}
+	ASSERT(Q_SOCK);
+
+	Q_SOCK->setReadOnly(cmd == QMGMT_READ_CMD);
+
+	BeginTransaction();
+
+	return serve_q_requests();
+}
+
+// Called when the client of a connection whose commit was acknowledged
+// after a group fsync sends its next request (or hangs up).
+static int
+resume_q_requests(Stream * /*sock*/)
+{
+	QmgmtPeer *peer = (QmgmtPeer *)daemonCore->GetDataPtr();
+	ASSERT(peer);
+
+	if ( Q_SOCK ) {
+		unsetQSock();
+	}
+	if ( !setQmgmtConnectionInfo(peer) ) {
+		// should never happen
+		EXCEPT("resume_q_requests: Unable to restore qmgmt connection!!");
+	}
+
+	return serve_q_requests();
+}
+
 int GetMyProxyPassword (int, int, char **);
 
 int get_myproxy_password_handler(int /*i*/, Stream *socket) {
@@ -3772,6 +4159,13 @@ enum {
 	idATTR_JOB_MATERIALIZE_PAUSED,
 	idATTR_HOLD_REASON,
 	idATTR_HOLD_REASON_CODE,
+	idATTR_CURRENT_HOSTS,
+	idATTR_MAX_HOSTS,
+	idATTR_PRE_JOB_PRIO1,
+	idATTR_PRE_JOB_PRIO2,
+	idATTR_POST_JOB_PRIO1,
+	idATTR_POST_JOB_PRIO2,
+	idATTR_Q_DATE,
 };
 
 enum {
@@ -3787,8 +4181,13 @@ enum {
 	catMaterializeState = 0x0100, // change in state of job factory
 	catSpoolingHold = 0x0200,    // hold reason was set to CONDOR_HOLD_CODE_SpoolingInput
 	catPostSubmitClusterChange = 0x400, // a cluster ad was changed after submit time which calls for special processing in commit transaction
+	catPrioRecJob   = 0x0800, // the job's record in the runnable job list must be updated on commit
 	catCallbackTrigger = 0x1000, // indicates that a callback should happen on commit of this attribute
+	catPeriodicPolicy = 0x2000,  // the job's periodic policy must be evaluated again after commit
+	catJobCounts    = 0x4000,    // the job must be counted again by count_jobs after commit
+	catClusterJobCounts = 0x8000, // every job in the cluster must be counted again by count_jobs after commit
 	catCallbackNow = 0x20000,    // indicates that a callback should happen when setAttribute is called
+	catQueryIndex  = 0x40000,    // the job must be filed again in the query indexes after commit
 };
 
 typedef struct attr_ident_pair {
@@ -3814,6 +4213,7 @@ static const ATTR_IDENT_PAIR aSpecialSetAttrs[] = {
 	FILL(ATTR_CRON_HOURS,         catCron),
 	FILL(ATTR_CRON_MINUTES,       catCron),
 	FILL(ATTR_CRON_MONTHS,        catCron),
+	FILL(ATTR_CURRENT_HOSTS,      catPrioRecJob),
 	FILL(ATTR_HOLD_REASON,        0), // used to detect submit of jobs with the magic 'hold for spooling' hold code
 	FILL(ATTR_HOLD_REASON_CODE,   0), // used to detect submit of jobs with the magic 'hold for spooling' hold code
 	FILL(ATTR_JOB_NOOP,           catDirtyPrioRec),
@@ -3825,16 +4225,22 @@ static const ATTR_IDENT_PAIR aSpecialSetAttrs[] = {
 	FILL(ATTR_JOB_MATERIALIZE_PAUSED, catMaterializeState | catCallbackTrigger),
 	FILL(ATTR_JOB_PRIO,           catDirtyPrioRec),
 	FILL(ATTR_JOB_STATUS,         catStatus | catCallbackTrigger),
-	FILL(ATTR_JOB_UNIVERSE,       catJobObj),
+	FILL(ATTR_JOB_UNIVERSE,       catJobObj | catPrioRecJob),
+	FILL(ATTR_MAX_HOSTS,          catPrioRecJob),
 #ifdef NO_DEPRECATED_NICE_USER
 	FILL(ATTR_NICE_USER,          catSubmitterIdent),
 #endif
 	FILL(ATTR_NUM_JOB_RECONNECTS, 0),
-	FILL(ATTR_OWNER,              0),
+	FILL(ATTR_OWNER,              catPrioRecJob | catQueryIndex | catCallbackTrigger),
+	FILL(ATTR_POST_JOB_PRIO1,     catPrioRecJob),
+	FILL(ATTR_POST_JOB_PRIO2,     catPrioRecJob),
+	FILL(ATTR_PRE_JOB_PRIO1,      catPrioRecJob),
+	FILL(ATTR_PRE_JOB_PRIO2,      catPrioRecJob),
 	FILL(ATTR_PROC_ID,            catJobId),
+	FILL(ATTR_Q_DATE,             catPrioRecJob),
 	FILL(ATTR_RANK,               catTargetScope),
 	FILL(ATTR_REQUIREMENTS,       catTargetScope),
-	FILL(ATTR_USER,              0),
+	FILL(ATTR_USER,               catPrioRecJob),
 
 
 };
@@ -4574,11 +4980,15 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 		// give the autocluster code a chance to invalidate (or rebuild)
 		// based on the changed attribute.
 		if (scheduler.autocluster.preSetAttribute(*job, attr_name, attr_value, flags)) {
-			DirtyPrioRecArray();
-			dprintf(D_FULLDEBUG,
-					"Prioritized runnable job list will be rebuilt, because "
-					"ClassAd attribute %s=%s changed\n",
-					attr_name,attr_value);
+			if (incremental_prio_rec_updates && proc_id >= 0) {
+				attr_category |= catPrioRecJob;
+			} else {
+				DirtyPrioRecArray();
+				dprintf(D_FULLDEBUG,
+						"Prioritized runnable job list will be rebuilt, because "
+						"ClassAd attribute %s=%s changed\n",
+						attr_name,attr_value);
+			}
 		}
 	}
 
@@ -4691,7 +5101,13 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 	}
 	free( round_param );
 
-	if( !PrioRecArrayIsDirty ) {
+	if (incremental_prio_rec_updates && proc_id >= 0) {
+		// only this job's record in the runnable job list needs to change,
+		// that happens when the transaction is committed
+		if (attr_category & (catDirtyPrioRec | catPrioRecJob | catStatus)) {
+			attr_category |= (catPrioRecJob | catCallbackTrigger);
+		}
+	} else if( !PrioRecArrayIsDirty ) {
 		if (attr_category & catDirtyPrioRec) {
 			DirtyPrioRecArray();
 		} else if(attr_id == idATTR_JOB_STATUS) {
@@ -4709,10 +5125,30 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 	if (attr_category & catSubmitterIdent) {
 		if (job) { job->dirty_flags |= JQJ_CACHE_DIRTY_SUBMITTERDATA; }
 	}
+	if (job && scheduler.PeriodicExprsReference(job, attr_name)) {
+		attr_category |= (catPeriodicPolicy | catCallbackTrigger);
+	}
+	// any attribute can change what the job adds to the job counts, through the
+	// SCHEDD_SLOT_WEIGHT expression if nothing else.  a cluster attribute can change
+	// it for every job in the cluster, except for the bookkeeping of the job factory.
+	if (cluster_id > 0) {
+		int count_triggers = catJobCounts;
+		if (proc_id < 0) {
+			if ((attr_category & (catNewMaterialize | catMaterializeState)) ||
+				MATCH == strcasecmp(attr_name, ATTR_JOB_MATERIALIZE_NEXT_PROC_ID)) {
+				count_triggers = 0;
+			} else {
+				count_triggers |= catClusterJobCounts;
+			}
+		}
+		if (count_triggers && ! JobQueue->SetTransactionTriggers(count_triggers)) {
+			scheduler.JobCountsChanged(key);
+		}
+	}
 
 	if (attr_category & catCallbackTrigger) {
 		// remember what callbacks to call when the transaction is committed.
-		int triggers = JobQueue->SetTransactionTriggers(attr_category & 0xFFF);
+		int triggers = JobQueue->SetTransactionTriggers(attr_category & ~(catCallbackTrigger | catCallbackNow));
 		if (0 == triggers) { // not inside a transaction, triggers will not be recorded... so promote it to trigger NOW
 			attr_category |= catCallbackNow;
 		}
@@ -4842,6 +5278,9 @@ void DoSetAttributeCallbacks(const std::set<std::string> &jobids, int triggers)
 			JobQueueJob * job = NULL;
 			if ( ! JobQueue->Lookup(job_id, job)) continue; // Ignore if no job ad (yet). this happens on submit commits.
 
+			// this also catches newly submitted jobs, whose other attributes were set before the job existed
+			scheduler.PeriodicExprsChanged(job_id);
+
 			int universe = job->Universe();
 			if ( ! universe) {
 				dprintf(D_ALWAYS, "job %s has no universe! in DoSetAttributeCallbacks\n", it->c_str());
@@ -4883,10 +5322,55 @@ void DoSetAttributeCallbacks(const std::set<std::string> &jobids, int triggers)
 					}
 				}
 				job->SetStatus(job_status);
+				ReindexJobStatusForQueries(job);
 			}
 		}
 	}
 
+	// this trigger happens when the Owner attribute of a job or cluster is set
+	if (triggers & catQueryIndex) {
+		for (auto it = jobids.begin(); it != jobids.end(); ++it) {
+			if ( ! job_id.set(it->c_str()) || job_id.cluster <= 0) continue;
+			if (job_id.proc < 0) {
+				// the procs of a cluster inherit the Owner of the cluster ad
+				JobQueueCluster * cad = GetClusterAd(job_id);
+				if ( ! cad) continue;
+				for (JobQueueJob * job = cad->NextAttachedJob(NULL); job; job = cad->NextAttachedJob(job)) {
+					ReindexJobOwnerForQueries(job);
+				}
+			} else {
+				JobQueueJob * job = NULL;
+				if (JobQueue->Lookup(job_id, job)) { ReindexJobOwnerForQueries(job); }
+			}
+		}
+	}
+
+	// this trigger happens when an attribute that the periodic policy of a job depends on is set
+	if (triggers & catPeriodicPolicy) {
+		for (auto it = jobids.begin(); it != jobids.end(); ++it) {
+			if ( ! job_id.set(it->c_str()) || job_id.cluster <= 0) continue; // ignore the '0.0' ad
+			scheduler.PeriodicExprsChanged(job_id);
+		}
+	}
+
+	// this trigger happens when any attribute of a job is set, and the catClusterJobCounts
+	// trigger when an attribute of a cluster that its jobs might depend on is set
+	if (triggers & catJobCounts) {
+		for (auto it = jobids.begin(); it != jobids.end(); ++it) {
+			if ( ! job_id.set(it->c_str()) || job_id.cluster <= 0) continue; // ignore the '0.0' ad
+			if (job_id.proc < 0 && ! (triggers & catClusterJobCounts)) continue;
+			scheduler.JobCountsChanged(job_id);
+		}
+	}
+
+	// this trigger happens when an attribute that goes into a job's record in the runnable job list is set
+	if (triggers & catPrioRecJob) {
+		for (auto it = jobids.begin(); it != jobids.end(); ++it) {
+			if ( ! job_id.set(it->c_str()) || job_id.cluster <= 0 || job_id.proc < 0) continue; // ignore the cluster ad and '0.0' ad
+			DirtyPrioRecJob(job_id);
+		}
+	}
+
 	// check factory clusters to see if there was a state change that justifies new job materialization
 	if (scheduler.getAllowLateMaterialize()) {
 		if (triggers & catMaterializeState) {
@@ -5004,6 +5488,89 @@ HandleFlushJobQueueLogTimer()
 	JobQueue->FlushLog();
 }
 
+// Send the reply to a commit that was held for the group fsync, the same
+// reply the CommitTransaction receiver sends on success.
+static bool
+SendGroupCommitReply(QmgmtPeer &peer)
+{
+	ReliSock *sock = peer.getReliSock();
+	int rval = 0;
+
+	peer.commit_reply_pending = false;
+	sock->encode();
+	if( !sock->code(rval) ) {
+		return false;
+	}
+	const CondorVersionInfo *vers = sock->get_peer_version();
+	if( vers && vers->built_since_version(8, 7, 4) ) {
+		ClassAd reply;
+		if( !peer.commit_reply_warning.empty() ) {
+			reply.Assign( "WarningReason", peer.commit_reply_warning );
+		}
+		if( !putClassAd( sock, reply ) ) {
+			return false;
+		}
+	}
+	peer.commit_reply_warning.clear();
+	return sock->end_of_message();
+}
+
+// Force the job queue log to disk once for all the commits waiting on it,
+// then acknowledge them.  When resume_connections is true the connections
+// go back to the event loop to wait for their next request, otherwise
+// they are closed.
+static void
+SyncGroupCommits(bool resume_connections)
+{
+	if( GroupCommitWaiters.empty() ) {
+		return;
+	}
+
+	double begin = _condor_debug_get_time_double();
+	int synced = JobQueue->SyncGroupCommits();
+	double sync_time = _condor_debug_get_time_double() - begin;
+
+	scheduler.stats.JobQueueGroupCommitSizes += (int)GroupCommitWaiters.size();
+	if( synced > 0 ) {
+		scheduler.stats.JobQueueGroupCommitSyncTimes += sync_time;
+	}
+	dprintf( D_FULLDEBUG, "Group commit of %d transactions (%d unsynced) took %.6f seconds\n",
+			 (int)GroupCommitWaiters.size(), synced, sync_time );
+
+	std::vector<QmgmtPeer*> waiters;
+	waiters.swap(GroupCommitWaiters);
+	for( std::vector<QmgmtPeer*>::iterator it = waiters.begin(); it != waiters.end(); ++it ) {
+		QmgmtPeer *peer = *it;
+		ReliSock *sock = peer->getReliSock();
+		bool keep = SendGroupCommitReply(*peer);
+		if( !keep ) {
+			dprintf( D_ALWAYS, "Failed to send commit reply to %s\n", sock->peer_description() );
+		}
+		else if( resume_connections ) {
+			keep = daemonCore->Register_Socket( sock, "QMGMT connection",
+				resume_q_requests, "resume_q_requests", ALLOW ) >= 0
+				&& daemonCore->Register_DataPtr( peer );
+		}
+		else {
+			keep = false;
+		}
+		if( !keep ) {
+			if( daemonCore->SocketIsRegistered(sock) ) {
+				daemonCore->Cancel_Socket(sock);
+			}
+			delete sock;
+			delete peer;
+		}
+	}
+}
+
+void
+HandleGroupCommitTimer()
+{
+	group_commit_timer_id = -1;
+	SyncGroupCommits(true);
+}
+
 int
 SetTimerAttribute( int cluster, int proc, const char *attr_name, int dur )
 {
@@ -5632,7 +6199,9 @@ AddSessionAttributes(const std::list<std::string> &new_ad_keys)
 	}
 }
 
-int CommitTransactionInternal( bool durable, CondorError * errorStack );
+// if group_commit_peer is not NULL, a durable commit waits for the group fsync
+// before it is acknowledged to that qmgmt client
+int CommitTransactionInternal( bool durable, CondorError * errorStack, QmgmtPeer * group_commit_peer = NULL );
 
 void
 CommitTransactionOrDieTrying() {
@@ -5660,6 +6229,17 @@ CommitNonDurableTransactionOrDieTrying() {
 	}
 }
 
+int
+CommitTransactionForClient( SetAttributeFlags_t flags,
+                            CondorError * errorStack )
+{
+	bool durable = !(flags & NONDURABLE);
+	if( !durable || !group_commit_job_queue || !Q_SOCK ) {
+		return CommitTransactionAndLive( flags, errorStack );
+	}
+	return CommitTransactionInternal( durable, errorStack, Q_SOCK );
+}
+
 int
 CommitTransactionAndLive( SetAttributeFlags_t flags,
                           CondorError * errorStack )
@@ -5676,7 +6256,7 @@ CommitTransactionAndLive( SetAttributeFlags_t flags,
 	return CommitTransactionInternal( durable, errorStack );
 }
 
-int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
+int CommitTransactionInternal( bool durable, CondorError * errorStack, QmgmtPeer * group_commit_peer ) {
 
 	std::list<std::string> new_ad_keys;
 	
@@ -5756,6 +6336,9 @@ int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
 		JobQueue->CommitNondurableTransaction(commit_comment);
 		ScheduleJobQueueLogFlush();
 	}
+	else if( group_commit_peer ) {
+		group_commit_peer->commit_reply_pending = JobQueue->CommitGroupTransaction(commit_comment);
+	}
 	else {
 		JobQueue->CommitTransaction(commit_comment);
 	}
@@ -5892,6 +6475,7 @@ int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
 
 					// Add the job to various runtime indexes for quick lookups
 				scheduler.indexAJob(procad, false);
+				IndexJobForQueries(procad);
 
 				PostCommitJobFactoryProc(clusterad, procad);
 
@@ -6301,6 +6885,19 @@ DeleteAttribute(int cluster_id, int proc_id, const char *attr_name)
 		return rc;
 	}
 
+	JobQueueJob *job = NULL;
+	if (JobQueue->Lookup(key, job) && scheduler.PeriodicExprsReference(job, attr_name)) {
+		if ( ! JobQueue->SetTransactionTriggers(catPeriodicPolicy)) {
+			scheduler.PeriodicExprsChanged(key);
+		}
+	}
+	if (cluster_id > 0) {
+		int count_triggers = (proc_id < 0) ? (catJobCounts | catClusterJobCounts) : catJobCounts;
+		if ( ! JobQueue->SetTransactionTriggers(count_triggers)) {
+			scheduler.JobCountsChanged(key);
+		}
+	}
+
 	JobQueue->DeleteAttribute(key, attr_name);
 
 	JobQueueDirty = true;
@@ -8062,6 +8659,14 @@ void DirtyPrioRecArray() {
 	PrioRecArrayIsDirty = true;
 }
 
+void DirtyPrioRecJob(const JOB_ID_KEY &jid) {
+		// Mark the records of a single job as stale. They will be
+		// replaced the next time the PrioRecArray is needed.
+	if (incremental_prio_rec_updates && jid.proc >= 0) {
+		PrioRecDirtyJobs.insert(jid);
+	}
+}
+
 // runtime stats for count & time spent building the priorec array
 //
 schedd_runtime_probe BuildPrioRec_runtime;
@@ -8069,6 +8674,7 @@ schedd_runtime_probe BuildPrioRec_mark_runtime;
 schedd_runtime_probe BuildPrioRec_walk_runtime;
 schedd_runtime_probe BuildPrioRec_sort_runtime;
 schedd_runtime_probe BuildPrioRec_sweep_runtime;
+schedd_runtime_probe BuildPrioRec_update_runtime;
 
 static void DoBuildPrioRecArray() {
 	condor_auto_runtime rt(BuildPrioRec_runtime);
@@ -8095,11 +8701,55 @@ static void DoBuildPrioRecArray() {
 	scheduler.autocluster.sweep();
 	BuildPrioRec_sweep_runtime += rt.tick(now);
 
+		// every job was just looked at, so none are stale
+	PrioRecDirtyJobs.clear();
+
 	if( !scheduler.shadow_prio_recs_consistent() ) {
 		scheduler.mail_problem_message();
 	}
 }
 
+static bool prio_rec_less(const prio_rec &a, const prio_rec &b) {
+	return prio_compar(const_cast<prio_rec*>(&a), const_cast<prio_rec*>(&b)) < 0;
+}
+
+/*
+ * Replace the records of the jobs in PrioRecDirtyJobs without looking
+ * at the rest of the queue.  The records that are left stay in order, the
+ * new ones are sorted and then merged in.  Records that FindRunnableJob
+ * disabled are dropped; if such a job becomes runnable again, it is
+ * marked dirty when its status or match changes.
+ */
+static void UpdatePrioRecArray() {
+	condor_auto_runtime rt(BuildPrioRec_update_runtime);
+
+	int kept = 0;
+	for (int i = 0; i < N_PrioRecs; ++i) {
+		if (PrioRec[i].submitter[0] == '\0' ||
+			PrioRecDirtyJobs.count(JOB_ID_KEY(PrioRec[i].id))) {
+			continue;
+		}
+		if (kept != i) {
+			PrioRec[kept] = PrioRec[i];
+		}
+		++kept;
+	}
+	N_PrioRecs = kept;
+
+	for (auto it = PrioRecDirtyJobs.begin(); it != PrioRecDirtyJobs.end(); ++it) {
+		JobQueueJob *job = NULL;
+		if (JobQueue->Lookup(*it, job) && job->IsJob()) {
+			get_job_prio(job, *it, NULL);
+		}
+	}
+	PrioRecDirtyJobs.clear();
+
+	if (N_PrioRecs > kept) {
+		std::sort(PrioRec + kept, PrioRec + N_PrioRecs, prio_rec_less);
+		std::inplace_merge(PrioRec, PrioRec + kept, PrioRec + N_PrioRecs, prio_rec_less);
+	}
+}
+
 /*
  * Force a rebuild of the PrioRec array if we're beyond the max interval
  * for a rebuild.
@@ -8137,6 +8787,14 @@ bool BuildPrioRecArray(bool no_match_found /*default false*/) {
 	}
 
 	if( !PrioRecArrayIsDirty ) {
+		if ( ! PrioRecDirtyJobs.empty()) {
+			size_t num_dirty = PrioRecDirtyJobs.size();
+			UpdatePrioRecArray();
+			dprintf(D_FULLDEBUG,
+					"Updated %d jobs in prioritized runnable job list.\n",
+					(int)num_dirty);
+			return true;
+		}
 		dprintf(D_FULLDEBUG,
 				"Reusing prioritized runnable job list because nothing has "
 				"changed.\n");
@@ -87,6 +87,12 @@ class QmgmtPeer {
 		int next_proc_num, active_cluster_num;
 		time_t xact_start_time;
 
+	public:
+			// set when a commit is waiting for a group fsync before it is
+			// acknowledged, along with the warnings to send with the reply
+		bool commit_reply_pending;
+		std::string commit_reply_warning;
+
 	private:
 		// we do not allow deep-copies via copy ctor or assignment op,
 		// so disable there here by making them private.
@@ -175,6 +181,37 @@ public:
 	bool IsCluster() { return IsType(entry_type_cluster); }
 };
 
+// What one job adds to the job counts in the schedd and submitter ads, as
+// computed by count_a_job().  The Scheduler keeps the sums of these, so that
+// only the jobs that changed need to be counted again.
+struct JobCountContribution {
+	struct SubmitterData * submitter; // NULL when the job is not counted
+	struct OwnerInfo * owner;
+	int status;
+	int JobsRunning;          // added to the schedd totals
+	int JobsIdle;
+	int SchedulerJobsRunning; // added to the schedd, submitter and owner counts
+	int SchedulerJobsIdle;
+	int LocalJobsRunning;
+	int LocalJobsIdle;
+	int OwnerJobsIdle;        // added to the submitter and owner counts
+	bool OwnerJobsHeld;
+	bool Flocks;              // OwnerJobsIdle and WeightedJobsIdle go to the flock counts
+	bool FlockDefault;        // to the flock counts of every pool in FLOCK_TO
+	bool EveryPass;           // count the job again on every pass
+	int WeightedJobsIdle;
+	std::vector<std::string> FlockPools; // and to these pools, which are not in FLOCK_TO
+	JobCountContribution() { clear(); }
+	void clear() {
+		submitter = NULL; owner = NULL; status = 0;
+		JobsRunning = JobsIdle = 0;
+		SchedulerJobsRunning = SchedulerJobsIdle = LocalJobsRunning = LocalJobsIdle = 0;
+		OwnerJobsIdle = 0; OwnerJobsHeld = Flocks = FlockDefault = EveryPass = false;
+		WeightedJobsIdle = 0;
+		FlockPools.clear();
+	}
+};
+
 class JobQueueJob : public JobQueueBase {
 public:
 	//TT JOB_ID_KEY jid;
@@ -186,11 +223,20 @@ public:
 	int dirty_flags;	// one or more of JQJ_CHACHE_DIRTY_ flags indicating that the job ad differs from the JobQueueJob 
 	int set_id;
 	int autocluster_id;
+	// attributes that the periodic policy of this job depends on, NULL if not yet known
+	// this points into the Scheduler's set of these, DO NOT FREE FROM HERE!
+	const classad::References * policy_refs;
 	// cached pointer into schedulers's SubmitterDataMap and OwnerInfoMap
 	// it is set by count_jobs() or by scheduler::get_submitter_and_owner()
 	// DO NOT FREE FROM HERE!
 	struct SubmitterData * submitterdata;
 	struct OwnerInfo * ownerinfo;
+	// what this job added to the job counts the last time it was counted
+	JobCountContribution counted;
+	// the Owner and JobStatus this job is filed under in the query indexes
+	// query_owner points at a key of the owner index, it is NULL when the job has no Owner
+	const std::string * query_owner;
+	int query_status; // -1 when the job is not in the query indexes
 protected:
 	JobQueueCluster * parent; // job pointer back to the 
 	qelm qe;
@@ -205,8 +251,11 @@ public:
 		, dirty_flags(0)
 		, set_id(0)
 		, autocluster_id(0)
+		, policy_refs(NULL)
 		, submitterdata(NULL)
 		, ownerinfo(NULL)
+		, query_owner(NULL)
+		, query_status(-1)
 		, parent(NULL)
 	{}
 	virtual ~JobQueueJob() {};
@@ -270,9 +319,11 @@ public:
 	int getNumNotRunning() const { return num_idle + num_held; }
 
 	bool HasAttachedJobs() { return ! qe.empty(); }
+	int NumAttachedJobs() const { return num_attached; }
 	void AttachJob(JobQueueJob * job);
 	void DetachJob(JobQueueJob * job);
 	void DetachAllJobs(); // When you absolutely positively need to free this class...
+	JobQueueJob * NextAttachedJob(JobQueueJob * job); // the attached job after job, or the first one if job is NULL
 	void JobStatusChanged(int old_status, int new_status);  // update cluster counters by job status.
 
 	void PopulateInfoAd(ClassAd & iad, int num_pending, bool include_factory_info); // fill out an info ad from fields in this structure and from the factory
@@ -353,6 +404,7 @@ bool UserCheck2( ClassAd *ad, const char *test_owner, char const *job_owner=NULL
 
 bool BuildPrioRecArray(bool no_match_found=false);
 void DirtyPrioRecArray();
+void DirtyPrioRecJob(const JOB_ID_KEY &jid);
 extern ClassAd *dollarDollarExpand(int cid, int pid, ClassAd *job, ClassAd *res, bool persist_expansions);
 bool rewriteSpooledJobAd(ClassAd *job_ad, int cluster, int proc, bool modify_ad);
 
@@ -390,6 +442,12 @@ JobQueueJob* GetNextDirtyJobByConstraint(const char *constraint, int initScan);
 int NewProcInternal(int cluster_id, int proc_id);
 // call NewProcInternal, and then SetAttribute on all of the attributes in job that are not the same as ClusterAd
 int NewProcFromAd (const classad::ClassAd * job, int ProcId, JobQueueCluster * ClusterAd, SetAttributeFlags_t flags);
+
+// Commit the transaction of the qmgmt client in Q_SOCK.  When group commit
+// is enabled, a durable commit is not forced to disk here; instead the
+// client's commit_reply_pending is set, and the reply is sent once the
+// job queue log has been synced.
+int CommitTransactionForClient( SetAttributeFlags_t flags, CondorError * errstack );
 #endif
 
 void * BeginJobAggregation(const char * projection, bool create_if_not, const char * constraint);
@@ -542,7 +600,10 @@ typedef JobQueueJob* JobQueuePayload;
 typedef ClassAdLog<JOB_ID_KEY, JobQueuePayload> JobQueueLogType;
 
 #define JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS     0x0001
-JobQueueLogType::filter_iterator GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms);
+// when the requirements require Owner, JobStatus or ClusterId to equal a literal
+// the iterator visits only the jobs that an index of the queue holds for that value.
+// if candidates is not NULL, it is set to the number of job ads the iterator will check.
+JobQueueLogType::filter_iterator GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms, int options=0, int * candidates=NULL);
 JobQueueLogType::filter_iterator GetJobQueueIteratorEnd();
 
 
@@ -560,6 +621,7 @@ void InitQmgmt();
 void InitJobQueue(const char *job_queue_name,int max_historical_logs);
 void PostInitJobQueue();
 void CleanJobQueue();
+void PeriodicCleanJobQueue();
 bool setQSock( ReliSock* rsock );
 void unsetQSock();
 void MarkJobClean(PROC_ID job_id);
@@ -672,11 +672,19 @@ do_Q_request(QmgmtPeer &Q_PEER, bool &may_fork)
 		} else {
 			errstack.reset(new CondorError());
 			errno = 0;
-			rval = CommitTransactionAndLive( flags, errstack.get() );
+			rval = CommitTransactionForClient( flags, errstack.get() );
 			terrno = errno;
 		}
 		dprintf( D_SYSCALLS, "\tflags = %d, rval = %d, errno = %d\n", flags, rval, terrno );
 
+		if( rval >= 0 && Q_PEER.commit_reply_pending ) {
+				// the reply is sent once the commit has been synced to disk
+			if(! errstack->empty()) {
+				Q_PEER.commit_reply_warning = errstack->getFullText();
+			}
+			return 0;
+		}
+
 		syscall_sock->encode();
 		assert( syscall_sock->code(rval) );
 		const CondorVersionInfo *vers = syscall_sock->get_peer_version();
@@ -180,6 +180,7 @@ bool jobIsSandboxed( ClassAd* ad );
 bool jobPrepNeedsThread( int cluster, int proc );
 bool jobCleanupNeedsThread( int cluster, int proc );
 int  count_a_job( JobQueueJob *job, const JOB_ID_KEY& jid, void* user);
+void tally_a_job( JobQueueJob *job, JobCountContribution & counts );
 void mark_jobs_idle();
 void load_job_factories();
 static void WriteCompletionVisa(ClassAd* ad);
@@ -191,6 +192,7 @@ schedd_runtime_probe WalkJobQ_clear_autocluster_id_runtime;
 schedd_runtime_probe WalkJobQ_add_runnable_local_jobs_runtime;
 schedd_runtime_probe WalkJobQ_fixAttrUser_runtime;
 schedd_runtime_probe WalkJobQ_updateSchedDInterval_runtime;
+schedd_runtime_probe CountJobs_update_runtime;
 
 int	WallClockCkptInterval = 0;
 int STARTD_CONTACT_TIMEOUT = 45;  // how long to potentially block
@@ -663,6 +665,7 @@ Scheduler::Scheduler() :
 	vanilla_start_expr.clear();
 
 	ShadowSizeEstimate = 0;
+	MaxJobsPerShadow = 1;
 
 	NumSubmitters = 0;
 	NegotiationRequestTime = 0;
@@ -692,6 +695,12 @@ Scheduler::Scheduler() :
 	timeoutid = -1;
 	startjobsid = -1;
 	periodicid = -1;
+	PeriodicExprFullInterval = 0;
+	PeriodicExprLastFullEval = 0;
+	PeriodicExprsNeedFullEval = true;
+	JobCountsAuditInterval = 0;
+	JobCountsLastAudit = 0;
+	JobCountsNeedFullCount = true;
 
 	checkContactQueue_tid = -1;
 	checkReconnectQueue_tid = -1;
@@ -813,6 +822,15 @@ Scheduler::~Scheduler()
 		}
 		delete shadowsByPid;
 	}
+	for (std::map<int, multi_job_shadow_rec>::iterator it = multiJobShadows.begin(); it != multiJobShadows.end(); ++it) {
+		for (std::set<PROC_ID>::iterator jit = it->second.jobs.begin(); jit != it->second.jobs.end(); ++jit) {
+			shadow_rec *rec = NULL;
+			if (shadowsByProcID && shadowsByProcID->lookup(*jit, rec) == 0) {
+				delete rec;
+			}
+		}
+	}
+	multiJobShadows.clear();
 	if (spoolJobFileWorkers) {
 		spoolJobFileWorkers->startIterations();
 		ExtArray<PROC_ID> * rec;
@@ -1368,16 +1386,7 @@ Scheduler::count_jobs()
 	time_t AbsentSubmitterUpdateRate = param_integer("ABSENT_SUBMITTER_UPDATE_RATE", 60*5); // 5 min
 	time_t AbsentOwnerLifetime = param_integer("ABSENT_OWNER_LIFETIME", 60*5);
 
-	JobsRunning = 0;
-	JobsIdle = 0;
-	JobsHeld = 0;
-	JobsTotalAds = 0;
 	JobsFlocked = 0;
-	JobsRemoved = 0;
-	SchedUniverseJobsIdle = 0;
-	SchedUniverseJobsRunning = 0;
-	LocalUniverseJobsIdle = 0;
-	LocalUniverseJobsRunning = 0;
 	stats.JobsRunning = 0;
 	stats.JobsRunningRuntimes = 0;
 	stats.JobsRunningSizes = 0;
@@ -1385,11 +1394,6 @@ Scheduler::count_jobs()
 
 	time_t current_time = time(0);
 
-	for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
-		OwnerInfo & Owner = it->second;
-		Owner.num.clear_counters();	// clear the jobs counters 
-	}
-
 	FlockPools.clear();
 	if (FlockCollectors) {
 		FlockCollectors->rewind();
@@ -1402,12 +1406,7 @@ Scheduler::count_jobs()
 
 	for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
 		SubmitterData & SubDat = it->second;
-		SubDat.num.clear_job_counters();	// clear the jobs counters 
 		SubDat.PrioSet.clear();
-		SubDat.flock.clear();
-		for (const auto &entry : FlockPools) {
-			SubDat.flock[entry] = SubmitterFlockCounters();
-		}
 	}
 	SubmitterMap.Cleanup(time(NULL));
 
@@ -1417,9 +1416,45 @@ Scheduler::count_jobs()
 		// job cluster ids, since we're about to re-create it.
 	dedicated_scheduler.clearDedicatedClusters();
 
-		// inserts/finds an entry in Owners for each job
-		// updates SubmitterCounters: Hits, JobsIdle, WeightedJobsIdle & JobsHeld
-	WalkJobQueue(count_a_job);
+		// The job counts are kept up to date as jobs change, so only the jobs
+		// that changed since the last pass, and the jobs that add to the counts
+		// that are rebuilt on every pass, need to be counted.  Every job is
+		// counted when the configuration changed, when the set of job priorities
+		// is needed, and once every SCHEDD_JOB_COUNTS_AUDIT_INTERVAL to check
+		// that the counts have not drifted.
+	bool audit = JobCountsAuditInterval > 0 && ! JobCountsNeedFullCount &&
+		(current_time < JobCountsLastAudit || current_time - JobCountsLastAudit >= JobCountsAuditInterval);
+	if (JobCountsAuditInterval <= 0 || JobCountsNeedFullCount || audit ||
+		FlockPools != JobCountsFlockPools || param_boolean("USE_GLOBAL_JOB_PRIOS",false)) {
+		count_all_jobs(audit);
+	} else {
+		_condor_auto_accum_runtime< stats_entry_probe<double> > rt(CountJobs_update_runtime);
+		std::set<JOB_ID_KEY> jobs;
+		jobs.swap(JobCountsDirty);
+		jobs.insert(JobCountsEveryPass.begin(), JobCountsEveryPass.end());
+		JobCountsEveryPass.clear();
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			CountJob(GetJobAd(*it));
+		}
+	}
+
+		// the counts of the owners and submitters start with the counts of their jobs
+	for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
+		OwnerInfo & Owner = it->second;
+		Owner.num = Owner.queued;
+		if (Owner.num.Hits > 0) { Owner.LastHitTime = current_time; }
+	}
+	for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+		SubmitterData & SubDat = it->second;
+		SubDat.num = SubDat.queued;
+		if (SubDat.num.Hits > 0) { SubDat.LastHitTime = current_time; }
+		SubDat.flock = SubDat.queued_flock;
+		for (const auto &entry : FlockPools) {
+			SubmitterFlockCounters & flock = SubDat.flock[entry];
+			flock.JobsIdle += SubDat.queued_flock_default.JobsIdle;
+			flock.WeightedJobsIdle += SubDat.queued_flock_default.WeightedJobsIdle;
+		}
+	}
 
 	if( dedicated_scheduler.hasDedicatedClusters() ) {
 			// We found some dedicated clusters to service.  Wake up
@@ -2261,6 +2296,7 @@ struct QueryJobAdsContinuation : Service {
 	LiveJobCounters my_job_counts;
 	std::string my_name;
 	JobQueueLogType::filter_iterator it;
+	int candidates; // job ads the plan for the query will check
 	int match_limit;
 	int match_count;
 	bool summary_only;
@@ -2273,14 +2309,13 @@ struct QueryJobAdsContinuation : Service {
 
 QueryJobAdsContinuation::QueryJobAdsContinuation(classad_shared_ptr<classad::ExprTree> requirements_, int limit, int timeslice_ms, int iter_opts)
 	: requirements(requirements_),
-	  it(GetJobQueueIterator(*requirements, timeslice_ms)),
+	  it(GetJobQueueIterator(*requirements, timeslice_ms, iter_opts, &candidates)),
 	  match_limit(limit),
 	  match_count(0),
 	  summary_only(false),
 	  unfinished_eom(false),
 	  registered_socket(false)
 {
-	it.set_options(iter_opts);
 	my_job_counts.clear_counters();
 }
 
@@ -2288,9 +2323,6 @@ int
 QueryJobAdsContinuation::finish(Stream *stream) {
 	ReliSock *sock = static_cast<ReliSock*>(stream);
 	JobQueueLogType::filter_iterator end = GetJobQueueIteratorEnd();
-	if (match_limit >= 0 && (match_count >= match_limit)) {
-		it = end;
-	}
 	bool has_backlog = false;
 
 	if (unfinished_eom) {
@@ -2304,7 +2336,8 @@ QueryJobAdsContinuation::finish(Stream *stream) {
 			return sendJobErrorAd(sock, 5, "Failed to write EOM to wire");
 		}
 	}
-	while ((it != end) && !has_backlog) {
+	// stop at the match limit without giving up the iterator, it knows how many ads were examined
+	while ((it != end) && !has_backlog && !(match_limit >= 0 && match_count >= match_limit)) {
 		JobQueueJob * job = *it++;
 		if (!job) {
 			// Return to DC in case if our time ran out.
@@ -2346,9 +2379,6 @@ QueryJobAdsContinuation::finish(Stream *stream) {
 			unfinished_eom = true;
 			has_backlog = true;
 		}
-		if (match_limit >= 0 && (match_count >= match_limit)) {
-			it = end;
-		}
 	}
 	if (has_backlog && !registered_socket) {
 		int retval = daemonCore->Register_Socket(stream, "Client Response",
@@ -2361,6 +2391,10 @@ QueryJobAdsContinuation::finish(Stream *stream) {
 		registered_socket = true;
 	} else if (!has_backlog) {
 		//dprintf(D_FULLDEBUG, "Finishing condor_q.\n");
+		// a query worker is a forked child, so this only counts the queries the schedd answers itself
+		scheduler.stats.JobQueryAdsReturned += match_count;
+		dprintf(D_FULLDEBUG, "QUERY_JOB_ADS examined %d job ads%s and returned %d\n",
+			it.examined(), it.has_keys() ? " from an index" : "", match_count);
 		const char * me = NULL;
 		LiveJobCounters * mine = NULL;
 		if ( ! my_name.empty()) { me = my_name.c_str(); mine = &my_job_counts; }
@@ -2528,6 +2562,11 @@ int Scheduler::command_query_job_ads(int cmd, Stream* stream)
 		continuation->summary_only = true;
 	}
 
+	// count the query here, from its plan, because a query worker can't update our statistics
+	stats.JobQueries += 1;
+	if (continuation->it.has_keys()) { stats.JobQueriesIndexed += 1; }
+	stats.JobQueryAdsExamined += continuation->candidates;
+
 	ForkStatus fork_status = schedd_forker.NewJob();
 	if (fork_status == FORK_PARENT)
 	{ // Successfully forked a child - as far as the schedd cares, this worked.
@@ -2872,8 +2911,27 @@ Scheduler::guessJobSlotWeight(JobQueueJob * job)
 	return job_weight;
 }
 
+// walk function for counting every job, count_jobs() has zeroed the counts
+// so what the job added to them before is dropped rather than subtracted
 int
 count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
+{
+		// we may get passed a NULL job ad if, for instance, the job ad was
+		// removed via condor_rm -f when some function didn't expect it.
+		// So check for it here before continuing onward...
+	if ( job == NULL ) {  
+		return 0;
+	}
+
+	job->counted.clear();
+	scheduler.CountJob(job);
+	return 0;
+}
+
+// compute what the job adds to the job counts, and update the counts that
+// count_jobs() recomputes on every pass
+void
+tally_a_job(JobQueueJob* job, JobCountContribution & counts)
 {
 	int		status;
 #if 1  // cache ownerdata pointer in job object
@@ -2887,17 +2945,12 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 	int		max_hosts;
 	int		universe;
 
-		// we may get passed a NULL job ad if, for instance, the job ad was
-		// removed via condor_rm -f when some function didn't expect it.
-		// So check for it here before continuing onward...
-	if ( job == NULL ) {  
-		return 0;
-	}
+	counts.clear();
 
 	if (job->LookupInteger(ATTR_JOB_STATUS, status) == 0) {
 		dprintf(D_ALWAYS, "Job has no %s attribute.  Ignoring...\n",
 				ATTR_JOB_STATUS);
-		return 0;
+		return;
 	}
 
 	bool noop = false;
@@ -2922,7 +2975,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		job_id.proc = proc;
 		set_job_status(cluster, proc, COMPLETED);
 		scheduler.WriteTerminateToUserLog( job_id, noop_status );
-		return 0;
+		return;
 	}
 
 	if (job->LookupInteger(ATTR_CURRENT_HOSTS, cur_hosts) == 0) {
@@ -2953,13 +3006,15 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 	OwnerInfo * OwnInfo = scheduler.get_submitter_and_owner(job, SubData);
 	if ( ! OwnInfo) {
 		dprintf(D_ALWAYS, "Job has no %s attribute.  Ignoring...\n", ATTR_OWNER);
-		return 0;
+		return;
 	}
 		// Keep track of unique owners per submitter.
 	SubData->owners.insert(OwnInfo->name);
 
-	// increment our count of the number of job ads in the queue
-	scheduler.JobsTotalAds++;
+	// the job counts as one job ad in the queue, and one hit for its owner and submitter
+	counts.submitter = SubData;
+	counts.owner = OwnInfo;
+	counts.status = status;
 
     time_t now = time(NULL);
     OwnInfo->LastHitTime = now;
@@ -2978,20 +3033,22 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
          */
         if ((status == RUNNING || status == TRANSFERRING_OUTPUT) && !cur_hosts)
         {
-                scheduler.JobsRunning += 1;
+                counts.JobsRunning += 1;
         }
         else if ((status == IDLE) && !max_hosts)
         {
-                scheduler.JobsIdle += 1;
+                counts.JobsIdle += 1;
         }
         else
         {
-                scheduler.JobsRunning += cur_hosts;
-                scheduler.JobsIdle += (max_hosts - cur_hosts);
+                counts.JobsRunning += cur_hosts;
+                counts.JobsIdle += (max_hosts - cur_hosts);
         }
 
-            // if job is not idle, then update statistics for running jobs
+            // if job is not idle, then update statistics for running jobs.
+            // these are recomputed on every pass, and the runtimes change anyway
         if (status == RUNNING || status == TRANSFERRING_OUTPUT) {
+            counts.EveryPass = true;
             scheduler.stats.JobsRunning += 1;
             OTHER.JobsRunning += 1;
 
@@ -3007,24 +3064,9 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
             scheduler.stats.JobsRunningRuntimes += job_running_time;
             OTHER.JobsRunningRuntimes += job_running_time;
         }
-    } else if (status == HELD) {
-        scheduler.JobsHeld++;
-    } else if (status == REMOVED) {
-        scheduler.JobsRemoved++;
     }
     #undef OTHER
 
-	// update per-submitter and per-owner counters
-	SubmitterCounters * Counters = &SubData->num;
-	RealOwnerCounters * OwnerCounts = &OwnInfo->num;
-
-	// Hits also counts matchrecs, which aren't jobs. (hits is sort of a reference count)
-	Counters->Hits += 1;
-	Counters->JobsCounted += 1;
-	
-	OwnerCounts->Hits += 1;
-	OwnerCounts->JobsCounted += 1;
-
 	if ( (universe != CONDOR_UNIVERSE_GRID) &&	// handle Globus below...
 		 (!service_this_universe(universe,job))  )
 	{
@@ -3034,23 +3076,15 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		{
 			// Count REMOVED or HELD jobs that are in the process of being
 			// killed. cur_hosts tells us which these are.
-			scheduler.SchedUniverseJobsRunning += cur_hosts;
-			scheduler.SchedUniverseJobsIdle += (max_hosts - cur_hosts);
-			OwnerCounts->SchedulerJobsRunning += cur_hosts;
-			OwnerCounts->SchedulerJobsIdle += (max_hosts - cur_hosts);
-			Counters->SchedulerJobsRunning += cur_hosts;
-			Counters->SchedulerJobsIdle += (max_hosts - cur_hosts);
+			counts.SchedulerJobsRunning += cur_hosts;
+			counts.SchedulerJobsIdle += (max_hosts - cur_hosts);
 		}
 		if (universe == CONDOR_UNIVERSE_LOCAL)
 		{
 			// Count REMOVED or HELD jobs that are in the process of being
 			// killed. cur_hosts tells us which these are.
-			scheduler.LocalUniverseJobsRunning += cur_hosts;
-			scheduler.LocalUniverseJobsIdle += (max_hosts - cur_hosts);
-			OwnerCounts->LocalJobsRunning += cur_hosts;
-			OwnerCounts->LocalJobsIdle += (max_hosts - cur_hosts);
-			Counters->LocalJobsRunning += cur_hosts;
-			Counters->LocalJobsIdle += (max_hosts - cur_hosts);
+			counts.LocalJobsRunning += cur_hosts;
+			counts.LocalJobsIdle += (max_hosts - cur_hosts);
 		}
 			// We want to record the cluster id of all idle MPI and parallel
 		    // jobs
@@ -3059,6 +3093,8 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		job->LookupBool(ATTR_WANT_PARALLEL_SCHEDULING, sendToDS);
 		if( (sendToDS || universe == CONDOR_UNIVERSE_MPI ||
 			 universe == CONDOR_UNIVERSE_PARALLEL) && status == IDLE ) {
+				// the list of dedicated clusters is rebuilt on every pass
+			counts.EveryPass = true;
 			if( max_hosts > cur_hosts ) {
 				int cluster = 0;
 				job->LookupInteger( ATTR_CLUSTER_ID, cluster );
@@ -3074,10 +3110,13 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 
 		// bailout now, since all the crud below is only for jobs
 		// which the schedd needs to service
-		return 0;
+		return;
 	} 
 
 	if ( universe == CONDOR_UNIVERSE_GRID ) {
+			// GridJobOwners is rebuilt on every pass
+		counts.EveryPass = true;
+
 		// for Globus, count jobs in UNSUBMITTED state by owner.
 		// later we make certain there is a grid manager daemon
 		// per owner.
@@ -3133,7 +3172,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			// If we do not need to do matchmaking on this job (i.e.
 			// service this globus universe job), than we can bailout now.
 		if (!want_service) {
-			return 0;
+			return;
 		}
 		status = real_status;	// set status back for below logic...
 	}
@@ -3152,8 +3191,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		}
 			// Update Owners array JobsIdle
 		int job_idle = (max_hosts - cur_hosts);
-		OwnerCounts->JobsIdle += job_idle;
-		Counters->JobsIdle += job_idle;
+		counts.OwnerJobsIdle = job_idle;
 
 			// If we're biasing by slot weight, and the job is idle, and everything parsed...
 		int job_idle_weight;
@@ -3174,9 +3212,11 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			// here: either max_hosts == cur_hosts || !scheduler.m_use_slot_weights
 			job_idle_weight = request_cpus * job_idle;
 		}
-		Counters->WeightedJobsIdle += job_idle_weight;
+		counts.WeightedJobsIdle = job_idle_weight;
 
-			// Update per-flock jobs idle
+			// Update per-flock jobs idle.  pools in FLOCK_TO are counted
+			// when the default list is, and not on their own.
+		counts.Flocks = true;
 		std::string flock_targets;
 		bool include_default_flock = param_boolean("FLOCK_BY_DEFAULT", true);
 		if (job->EvaluateAttrString(ATTR_FLOCK_TO, flock_targets)) {
@@ -3186,38 +3226,188 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			while ( (flock_entry = flock_list.next()) ) {
 				if (!strcasecmp(flock_entry, "default")) {
 					include_default_flock = true;
-				} else {
-					auto iter = SubData->flock.insert({flock_entry, SubmitterFlockCounters()});
-					iter.first->second.JobsIdle += job_idle;
-					iter.first->second.WeightedJobsIdle += job_idle_weight;
-				}
-			}
-				// Subtract out overlap with default list of flocked pools.
-			flock_list.rewind();
-			while ( (flock_entry = flock_list.next()) ) {
-				auto iter = scheduler.FlockPools.find(flock_entry);
-				if (iter != scheduler.FlockPools.end()) {
-					SubData->flock[flock_entry].JobsIdle -= job_idle;
-					SubData->flock[flock_entry].WeightedJobsIdle -= job_idle_weight;
+				} else if (scheduler.FlockPools.find(flock_entry) == scheduler.FlockPools.end()) {
+					counts.FlockPools.push_back(flock_entry);
 				}
 			}
 		}
-		if (include_default_flock) {
-			for (const auto &flock_entry : scheduler.FlockPools) {
-				SubData->flock[flock_entry].JobsIdle += job_idle;
-				SubData->flock[flock_entry].WeightedJobsIdle += job_idle_weight;
-			}
-		}
+		counts.FlockDefault = include_default_flock;
 
 			// Don't update scheduler.Owners[name].JobsRunning here.
 			// We do it in Scheduler::count_jobs().
 
 	} else if (status == HELD) {
-		OwnerCounts->JobsHeld++;
-		Counters->JobsHeld++;
+		counts.OwnerJobsHeld = true;
 	}
+}
 
-	return 0;
+void
+Scheduler::AddJobCounts(const JobCountContribution & counts, int sign)
+{
+	if ( ! counts.submitter) {
+		return;
+	}
+
+	JobsTotalAds += sign;
+	JobsRunning += sign * counts.JobsRunning;
+	JobsIdle += sign * counts.JobsIdle;
+	if (counts.status == HELD) {
+		JobsHeld += sign;
+	} else if (counts.status == REMOVED) {
+		JobsRemoved += sign;
+	}
+	SchedUniverseJobsRunning += sign * counts.SchedulerJobsRunning;
+	SchedUniverseJobsIdle += sign * counts.SchedulerJobsIdle;
+	LocalUniverseJobsRunning += sign * counts.LocalJobsRunning;
+	LocalUniverseJobsIdle += sign * counts.LocalJobsIdle;
+
+	SubmitterCounters & Counters = counts.submitter->queued;
+	RealOwnerCounters & OwnerCounts = counts.owner->queued;
+
+	// Hits also counts matchrecs, which aren't jobs. (hits is sort of a reference count)
+	Counters.Hits += sign;
+	Counters.JobsCounted += sign;
+	OwnerCounts.Hits += sign;
+	OwnerCounts.JobsCounted += sign;
+
+	Counters.SchedulerJobsRunning += sign * counts.SchedulerJobsRunning;
+	Counters.SchedulerJobsIdle += sign * counts.SchedulerJobsIdle;
+	Counters.LocalJobsRunning += sign * counts.LocalJobsRunning;
+	Counters.LocalJobsIdle += sign * counts.LocalJobsIdle;
+	OwnerCounts.SchedulerJobsRunning += sign * counts.SchedulerJobsRunning;
+	OwnerCounts.SchedulerJobsIdle += sign * counts.SchedulerJobsIdle;
+	OwnerCounts.LocalJobsRunning += sign * counts.LocalJobsRunning;
+	OwnerCounts.LocalJobsIdle += sign * counts.LocalJobsIdle;
+
+	Counters.JobsIdle += sign * counts.OwnerJobsIdle;
+	OwnerCounts.JobsIdle += sign * counts.OwnerJobsIdle;
+	Counters.WeightedJobsIdle += sign * counts.WeightedJobsIdle;
+	if (counts.OwnerJobsHeld) {
+		Counters.JobsHeld += sign;
+		OwnerCounts.JobsHeld += sign;
+	}
+
+	if (counts.Flocks) {
+		if (counts.FlockDefault) {
+			counts.submitter->queued_flock_default.JobsIdle += sign * counts.OwnerJobsIdle;
+			counts.submitter->queued_flock_default.WeightedJobsIdle += sign * counts.WeightedJobsIdle;
+		}
+		for (const auto & pool : counts.FlockPools) {
+			SubmitterFlockCounters & flock = counts.submitter->queued_flock[pool];
+			flock.JobsIdle += sign * counts.OwnerJobsIdle;
+			flock.WeightedJobsIdle += sign * counts.WeightedJobsIdle;
+		}
+	}
+}
+
+void
+Scheduler::CountJob(JobQueueJob *job)
+{
+	if ( ! job) {
+		return;
+	}
+	UncountJob(job);
+	tally_a_job(job, job->counted);
+	AddJobCounts(job->counted, 1);
+	if (job->counted.EveryPass && JobCountsAuditInterval > 0) {
+		JobCountsEveryPass.insert(job->jid);
+	}
+}
+
+// count every job in the queue.  when auditing, compare the counts with the
+// counts that were kept up to date as the jobs changed, and log the differences
+void
+Scheduler::count_all_jobs(bool audit)
+{
+	int totals[] = { JobsTotalAds, JobsRunning, JobsIdle, JobsHeld, JobsRemoved,
+		SchedUniverseJobsRunning, SchedUniverseJobsIdle, LocalUniverseJobsRunning, LocalUniverseJobsIdle };
+	std::map<std::string, SubmitterCounters> submitter_counts;
+	if (audit) {
+		for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+			submitter_counts[it->first] = it->second.queued;
+		}
+	}
+
+	JobsTotalAds = 0;
+	JobsRunning = 0;
+	JobsIdle = 0;
+	JobsHeld = 0;
+	JobsRemoved = 0;
+	SchedUniverseJobsIdle = 0;
+	SchedUniverseJobsRunning = 0;
+	LocalUniverseJobsIdle = 0;
+	LocalUniverseJobsRunning = 0;
+	for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
+		it->second.queued.clear_counters();
+	}
+	for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+		SubmitterData & SubDat = it->second;
+		SubDat.queued.clear_job_counters();
+		SubDat.queued_flock.clear();
+		SubDat.queued_flock_default = SubmitterFlockCounters();
+	}
+	JobCountsDirty.clear();
+	JobCountsEveryPass.clear();
+
+	WalkJobQueue(count_a_job);
+
+	JobCountsNeedFullCount = false;
+	JobCountsLastAudit = time(NULL);
+	JobCountsFlockPools = FlockPools;
+
+	if ( ! audit) {
+		return;
+	}
+
+	int counted[] = { JobsTotalAds, JobsRunning, JobsIdle, JobsHeld, JobsRemoved,
+		SchedUniverseJobsRunning, SchedUniverseJobsIdle, LocalUniverseJobsRunning, LocalUniverseJobsIdle };
+	const char * names[] = { ATTR_TOTAL_JOB_ADS, ATTR_TOTAL_RUNNING_JOBS, ATTR_TOTAL_IDLE_JOBS,
+		ATTR_TOTAL_HELD_JOBS, ATTR_TOTAL_REMOVED_JOBS, ATTR_TOTAL_SCHEDULER_RUNNING_JOBS,
+		ATTR_TOTAL_SCHEDULER_IDLE_JOBS, ATTR_TOTAL_LOCAL_RUNNING_JOBS, ATTR_TOTAL_LOCAL_IDLE_JOBS };
+	for (size_t ii = 0; ii < COUNTOF(names); ++ii) {
+		if (totals[ii] != counted[ii]) {
+			dprintf(D_ALWAYS, "Job count audit: %s was %d, but %d jobs were counted\n",
+				names[ii], totals[ii], counted[ii]);
+		}
+	}
+	for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+		const SubmitterCounters & was = submitter_counts[it->first];
+		const SubmitterCounters & now = it->second.queued;
+		if (was.JobsCounted != now.JobsCounted || was.JobsIdle != now.JobsIdle ||
+			was.JobsHeld != now.JobsHeld || (int)was.WeightedJobsIdle != (int)now.WeightedJobsIdle ||
+			was.SchedulerJobsRunning != now.SchedulerJobsRunning || was.SchedulerJobsIdle != now.SchedulerJobsIdle ||
+			was.LocalJobsRunning != now.LocalJobsRunning || was.LocalJobsIdle != now.LocalJobsIdle) {
+			dprintf(D_ALWAYS, "Job count audit: submitter %s had Tot=%d Idle=%d Held=%d, but Tot=%d Idle=%d Held=%d were counted\n",
+				it->second.Name(), was.JobsCounted, was.JobsIdle, was.JobsHeld,
+				now.JobsCounted, now.JobsIdle, now.JobsHeld);
+		}
+	}
+}
+
+void
+Scheduler::UncountJob(JobQueueJob *job)
+{
+	AddJobCounts(job->counted, -1);
+	job->counted.clear();
+}
+
+void
+Scheduler::JobCountsChanged(const JOB_ID_KEY &jid)
+{
+	if (JobCountsAuditInterval <= 0) {
+		return;
+	}
+	if (jid.proc >= 0) {
+		JobCountsDirty.insert(jid);
+		return;
+	}
+	JobQueueCluster * cad = GetClusterAd(jid.cluster);
+	if ( ! cad) {
+		return;
+	}
+	for (JobQueueJob * job = cad->NextAttachedJob(NULL); job; job = cad->NextAttachedJob(job)) {
+		JobCountsDirty.insert(job->jid);
+	}
 }
 
 bool
@@ -3873,7 +4063,12 @@ PeriodicExprEval(JobQueueJob *jobad, const JOB_ID_KEY & /*jid*/, void *)
 #endif
 {
 	int status=-1;
-	if(!ResponsibleForPeriodicExprs(jobad, status)) return 1;
+	bool responsible = ResponsibleForPeriodicExprs(jobad, status);
+#ifdef USE_NON_MUTATING_USERPOLICY
+	UserPolicy & policy = *(UserPolicy*)pvUser;
+	scheduler.AnalyzePeriodicExprs(jobad, policy, responsible);
+#endif
+	if( ! responsible) return 1;
 
 	int cluster = jobad->jid.cluster;
 	int proc = jobad->jid.proc;
@@ -3886,8 +4081,6 @@ PeriodicExprEval(JobQueueJob *jobad, const JOB_ID_KEY & /*jid*/, void *)
 	}
 
 #ifdef USE_NON_MUTATING_USERPOLICY
-	UserPolicy & policy = *(UserPolicy*)pvUser;
-
 	policy.ResetTriggers();
 	int action = policy.AnalyzePolicy(*jobad, PERIODIC_ONLY);
 #else
@@ -3936,8 +4129,89 @@ PeriodicExprEval(JobQueueJob *jobad, const JOB_ID_KEY & /*jid*/, void *)
 }
 
 /*
-For all of the jobs in the queue, evaluate the 
-periodic user policy expressions.
+Remember what the periodic policy of a job depends on, so that
+PeriodicExprHandler can skip the job until one of those things changes.
+*/
+
+void
+Scheduler::AnalyzePeriodicExprs( JobQueueJob *job, UserPolicy &policy, bool responsible )
+{
+	if ( ! PeriodicExprFullInterval || ! job->IsJob()) {
+		return;
+	}
+
+		// the attributes that ResponsibleForPeriodicExprs() looks at
+	classad::References refs;
+	refs.insert(ATTR_JOB_MANAGED);
+	refs.insert(ATTR_GRID_JOB_ID);
+	refs.insert(ATTR_HOLD_REASON_CODE);
+	refs.insert(ATTR_JOB_UNIVERSE);
+	bool depends_on_time = policy.PeriodicPolicyReferences(*job, refs);
+
+		// most jobs share a few distinct sets of references
+	auto found = PeriodicExprsRefSets.insert(refs);
+	if (found.second) {
+		PeriodicExprsAllRefs.insert(refs.begin(), refs.end());
+	}
+	job->policy_refs = &*found.first;
+
+	if ( ! responsible) {
+			// it will be evaluated when its status or shadow changes
+		return;
+	}
+
+		// completed and removed jobs are checked every time so that they
+		// are removed from the queue as soon as their shadow is gone
+	int status = -1;
+	job->LookupInteger(ATTR_JOB_STATUS, status);
+	if (depends_on_time || status == COMPLETED || status == REMOVED) {
+		PeriodicExprsEveryTime.insert(job->jid);
+	}
+
+	int timer_remove = -1;
+	if (job->LookupInteger(ATTR_TIMER_REMOVE_CHECK, timer_remove) && timer_remove >= time(NULL)) {
+		time_t when = (time_t)timer_remove + 1;
+		auto range = PeriodicExprsTimers.equal_range(when);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == job->jid) {
+				return;
+			}
+		}
+		PeriodicExprsTimers.insert(std::make_pair(when, job->jid));
+	}
+}
+
+bool
+Scheduler::PeriodicExprsReference( JobQueueJob *job, const char *attr )
+{
+	if ( ! PeriodicExprFullInterval) {
+		return false;
+	}
+	if (job->IsCluster()) {
+		return PeriodicExprsAllRefs.count(attr) > 0;
+	}
+	return ! job->policy_refs || job->policy_refs->count(attr) > 0;
+}
+
+void
+Scheduler::PeriodicExprsChanged( const JOB_ID_KEY &jid )
+{
+	if ( ! PeriodicExprFullInterval) {
+		return;
+	}
+	if (jid.proc < 0) {
+			// the procs of a cluster inherit its attributes
+		PeriodicExprsNeedFullEval = true;
+	} else {
+		PeriodicExprsDirty.insert(jid);
+	}
+}
+
+/*
+Evaluate the periodic user policy expressions of the jobs in the queue.
+Every PERIODIC_EXPR_FULL_INTERVAL this looks at all of the jobs, in between
+only at the ones whose policy depends on the time or on attributes that
+changed since they were last evaluated.
 */
 
 void
@@ -3949,15 +4223,55 @@ Scheduler::PeriodicExprHandler( void )
 #ifdef USE_NON_MUTATING_USERPOLICY
 	policy.Init();
 #endif
-	WalkJobQueue2(PeriodicExprEval, &policy);
+
+	time_t now = time(NULL);
+	int num_evaluated = -1;
+	if ( ! PeriodicExprFullInterval || PeriodicExprsNeedFullEval ||
+		 now >= PeriodicExprLastFullEval + PeriodicExprFullInterval )
+	{
+			// evaluating every job also finds the ones to evaluate next time
+		PeriodicExprsNeedFullEval = false;
+		PeriodicExprLastFullEval = now;
+		PeriodicExprsDirty.clear();
+		PeriodicExprsEveryTime.clear();
+		PeriodicExprsTimers.clear();
+		WalkJobQueue2(PeriodicExprEval, &policy);
+	} else {
+		std::set<JOB_ID_KEY> jobs;
+		jobs.swap(PeriodicExprsDirty);
+		jobs.insert(PeriodicExprsEveryTime.begin(), PeriodicExprsEveryTime.end());
+		PeriodicExprsEveryTime.clear();
+		auto expired = PeriodicExprsTimers.upper_bound(now);
+		for (auto it = PeriodicExprsTimers.begin(); it != expired; ++it) {
+			jobs.insert(it->second);
+		}
+		PeriodicExprsTimers.erase(PeriodicExprsTimers.begin(), expired);
+
+		num_evaluated = 0;
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			JobQueueJob *job = GetJobAd(*it);
+			if (job) {
+				PeriodicExprEval(job, *it, &policy);
+				++num_evaluated;
+			}
+		}
+	}
 
 	PeriodicExprInterval.setFinishTimeNow();
 
 	unsigned int time_to_next_run = PeriodicExprInterval.getTimeToNextRun();
-	dprintf(D_FULLDEBUG,"Evaluated periodic expressions in %.3fs, "
-			"scheduling next run in %us\n",
-			PeriodicExprInterval.getLastDuration(),
-			time_to_next_run);
+	if (num_evaluated < 0) {
+		dprintf(D_FULLDEBUG,"Evaluated periodic expressions of all jobs in %.3fs, "
+				"scheduling next run in %us\n",
+				PeriodicExprInterval.getLastDuration(),
+				time_to_next_run);
+	} else {
+		dprintf(D_FULLDEBUG,"Evaluated periodic expressions of %d jobs in %.3fs, "
+				"scheduling next run in %us\n",
+				num_evaluated,
+				PeriodicExprInterval.getLastDuration(),
+				time_to_next_run);
+	}
 	daemonCore->Reset_Timer( periodicid, time_to_next_run );
 }
 
@@ -9448,6 +9762,50 @@ Scheduler::spawnShadow( shadow_rec* srec )
 		return;
 	}
 
+		// If shadows may run more than one job, give this job to a
+		// shadow that is already running jobs for the same user, or
+		// start a shadow that will take more jobs.  Only serial jobs
+		// and new shadows are supported.  A multi-job shadow doesn't
+		// handle SHADOW_UPDATEINFO from pre-6.9.5 starters, and its
+		// LIMIT_DIRECTORY_ACCESS list is shared by all of its jobs,
+		// so those jobs get a shadow of their own.
+	bool multi_job = false;
+	if( MaxJobsPerShadow > 1 && sh_is_dc && sh_reads_file && !wants_reconnect &&
+		mrec && mrec->user &&
+		(universe == CONDOR_UNIVERSE_VANILLA ||
+		 universe == CONDOR_UNIVERSE_JAVA ||
+		 universe == CONDOR_UNIVERSE_VM) )
+	{
+		bool want_ps = false;
+		GetAttributeBool(job_id->cluster, job_id->proc, ATTR_WANT_PARALLEL_SCHEDULING, &want_ps);
+
+		bool new_starter = false;
+		std::string version;
+		if( mrec->my_match_ad &&
+			mrec->my_match_ad->LookupString( ATTR_VERSION, version ) )
+		{
+			CondorVersionInfo ver( version.c_str() );
+			new_starter = ver.built_since_version( 6, 9, 5 );
+		}
+
+		std::string limit_dirs;
+		GetAttributeString(job_id->cluster, job_id->proc, ATTR_JOB_LIMIT_DIRECTORY_ACCESS, limit_dirs);
+		if( limit_dirs.empty() ) {
+			param( limit_dirs, "SHADOW.LIMIT_DIRECTORY_ACCESS" );
+		}
+		if( limit_dirs.empty() ) {
+			param( limit_dirs, "LIMIT_DIRECTORY_ACCESS" );
+		}
+
+		if( !want_ps && new_starter && limit_dirs.empty() ) {
+			if( assignToMultiJobShadow( srec ) ) {
+				free( shadow_path );
+				return;
+			}
+			multi_job = true;
+		}
+	}
+
 	args.AppendArg("condor_shadow");
 	if(sh_is_dc) {
 		args.AppendArg("-f");
@@ -9475,6 +9833,10 @@ Scheduler::spawnShadow( shadow_rec* srec )
 				args.AppendArg(argbuf.Value());
 			}
 
+			if( multi_job ) {
+				args.AppendArg("--multi-job");
+			}
+
 				// pass the private socket ip/port for use just by shadows
 			args.AppendArg(MyShadowSockName);
 				
@@ -9529,8 +9891,19 @@ Scheduler::spawnShadow( shadow_rec* srec )
 		return;
 	}
 
-	dprintf( D_ALWAYS, "Started shadow for job %d.%d on %s, "
-			 "(shadow pid = %d)\n", job_id->cluster, job_id->proc,
+	if( multi_job ) {
+			// the shadow_recs of a multi-job shadow are found through
+			// multiJobShadows rather than shadowsByPid
+		shadowsByPid->remove( srec->pid );
+		multi_job_shadow_rec & mjs = multiJobShadows[srec->pid];
+		mjs.pid = srec->pid;
+		mjs.user = mrec->user;
+		mjs.jobs.insert( *job_id );
+	}
+
+	dprintf( D_ALWAYS, "Started %sshadow for job %d.%d on %s, "
+			 "(shadow pid = %d)\n", multi_job ? "multi-job " : "",
+			 job_id->cluster, job_id->proc,
 			 mrec->description(), srec->pid );
 
     //time_t now = time(NULL);
@@ -10066,6 +10439,8 @@ Scheduler::spawnLocalStarter( shadow_rec* srec )
 		dprintf( D_ALWAYS|D_FAILURE, "Can't spawn local starter for "
 				 "job %d.%d\n", job_id->cluster, job_id->proc );
 		shadowsByProcID->remove(srec->job_id);
+		DirtyPrioRecJob(srec->job_id);
+		PeriodicExprsChanged(srec->job_id);
 		mark_job_stopped( job_id );
 		delete srec;
 		return;
@@ -10631,6 +11006,11 @@ Scheduler::display_shadow_recs()
 				r->match ? r->match->peer : "localhost",
 				cur_hosts, status);
 	}
+	for (std::map<int, multi_job_shadow_rec>::iterator it = multiJobShadows.begin(); it != multiJobShadows.end(); ++it) {
+		dprintf(D_FULLDEBUG, ".. multi-job shadow %d, %s, %d jobs, %d pending%s\n",
+				it->first, it->second.user.c_str(), (int)it->second.jobs.size(),
+				(int)it->second.pending.size(), it->second.closed ? ", closed" : "");
+	}
 	dprintf( D_FULLDEBUG, "..................\n\n" );
 }
 
@@ -10932,10 +11312,11 @@ Scheduler::add_shadow_rec( shadow_rec* new_rec )
 
 		numShadows++;
 	}
-	if( new_rec->pid ) {
+	if( new_rec->pid && !FindMultiJobShadow(new_rec->pid) ) {
 		ASSERT( shadowsByPid->insert(new_rec->pid, new_rec) == 0 );
 	}
 	ASSERT( shadowsByProcID->insert(new_rec->job_id, new_rec) == 0 );
+	DirtyPrioRecJob(new_rec->job_id);
 
 		// To improve performance and to keep our sanity in case we
 		// get killed in the middle of this operation, do all of these
@@ -11310,9 +11691,20 @@ Scheduler::delete_shadow_rec( shadow_rec *rec )
 	}
 
 	if( pid ) {
-		shadowsByPid->remove(pid);
+		multi_job_shadow_rec *mjs = FindMultiJobShadow(pid);
+		if( mjs ) {
+			mjs->jobs.erase(rec->job_id);
+			std::deque<PROC_ID>::iterator it = std::find(mjs->pending.begin(), mjs->pending.end(), rec->job_id);
+			if( it != mjs->pending.end() ) {
+				mjs->pending.erase(it);
+			}
+		} else {
+			shadowsByPid->remove(pid);
+		}
 	}
 	shadowsByProcID->remove(rec->job_id);
+	DirtyPrioRecJob(rec->job_id);
+	PeriodicExprsChanged(rec->job_id);
 	if ( rec->conn_fd != -1 ) {
 		close(rec->conn_fd);
 	}
@@ -11502,6 +11894,19 @@ Scheduler::is_alive(shadow_rec* srec)
 	return daemonCore->Is_Pid_Alive(srec->pid);
 }
 
+static void
+sampleShadowRSS( int pid, int njobs, int & sampled_shadows, int & sampled_jobs, unsigned long & sampled_rss )
+{
+	piPTR pi = NULL;
+	int status = PROCAPI_OK;
+	if( ProcAPI::getProcInfo( pid, pi, status ) == PROCAPI_SUCCESS ) {
+		sampled_shadows += 1;
+		sampled_jobs += njobs;
+		sampled_rss += pi->rssize;
+	}
+	delete pi;
+}
+
 void
 Scheduler::clean_shadow_recs()
 {
@@ -11525,6 +11930,34 @@ Scheduler::clean_shadow_recs()
 		}
 	}
     stats.ShadowsRunning = numShadows;
+
+		// Count the shadow processes, and estimate the memory each
+		// running job costs from the resident set size of a sample of
+		// them, since reading it for every shadow would be too slow.
+	const int max_sampled_shadows = 100;
+	int hosted_jobs = 0;
+	int sampled_shadows = 0;
+	int sampled_jobs = 0;
+	unsigned long sampled_rss = 0;
+	std::map<int, multi_job_shadow_rec>::iterator mit;
+	for( mit = multiJobShadows.begin(); mit != multiJobShadows.end(); ++mit ) {
+		int njobs = (int)mit->second.jobs.size() - (int)mit->second.pending.size();
+		hosted_jobs += (int)mit->second.jobs.size();
+		if( sampled_shadows < max_sampled_shadows && njobs > 0 ) {
+			sampleShadowRSS( mit->first, njobs, sampled_shadows, sampled_jobs, sampled_rss );
+		}
+	}
+	shadowsByPid->startIterations();
+	while( sampled_shadows < max_sampled_shadows && shadowsByPid->iterate(rec) == 1 ) {
+		if( rec->universe != CONDOR_UNIVERSE_SCHEDULER &&
+			rec->universe != CONDOR_UNIVERSE_LOCAL )
+		{
+			sampleShadowRSS( rec->pid, 1, sampled_shadows, sampled_jobs, sampled_rss );
+		}
+	}
+	stats.ShadowProcessesRunning = numShadows - hosted_jobs + (int)multiJobShadows.size();
+	stats.ShadowMemoryPerJob = sampled_jobs ? (int)(sampled_rss / sampled_jobs) : 0;
+
 	dprintf( D_FULLDEBUG, "============ End clean_shadow_recs =============\n" );
 }
 
@@ -11539,7 +11972,9 @@ Scheduler::preempt( int n, bool force_sched_jobs )
 			 force_sched_jobs  ? " forcing scheduler/local univ preemptions" : "",
 			 ExitWhenDone ? " for a graceful shutdown" : "" );
 
-	shadowsByPid->startIterations();
+		// iterate over the jobs rather than the shadow pids, since a
+		// shadow may be running more than one job
+	shadowsByProcID->startIterations();
 
 	/* Now we loop until we are out of shadows or until we've preempted
 	 * `n' shadows.  Note that the behavior of this loop is slightly 
@@ -11548,7 +11983,11 @@ Scheduler::preempt( int n, bool force_sched_jobs )
 	 * ExitWhenDone is False, we will preempt n minus the number of shadows we
 	 * have previously told to preempt but are still waiting for them to exit.
 	 */
-	while (shadowsByPid->iterate(rec) == 1 && n > 0) {
+	while (shadowsByProcID->iterate(rec) == 1 && n > 0) {
+		if( rec->pid <= 0 ) {
+				// the shadow hasn't been spawned yet
+			continue;
+		}
 		if( is_alive(rec) ) {
 			if( rec->preempted ) {
 				if( ! ExitWhenDone ) {
@@ -11635,9 +12074,15 @@ Scheduler::preempt( int n, bool force_sched_jobs )
 					} else {
 							//
 							// Call the blocking form of Send_Signal, rather than
-							// sendSignalToShadow().
+							// sendSignalToShadow(), unless the shadow runs other
+							// jobs too.
 							//
-						daemonCore->Send_Signal( rec->pid, SIGKILL );
+						if( FindMultiJobShadow( rec->pid ) ) {
+								// don't kill the other jobs in the shadow
+							sendSignalToShadow( rec->pid, SIGKILL, rec->job_id );
+						} else {
+							daemonCore->Send_Signal( rec->pid, SIGKILL );
+						}
 						dprintf( D_ALWAYS, 
 								"Sent signal %d to %s [pid %d] for job %d.%d\n",
 								SIGKILL, rec->match->peer, rec->pid, cluster, proc );
@@ -11894,7 +12339,48 @@ set_job_status(int cluster, int proc, int status)
 void
 Scheduler::child_exit(int pid, int status)
 {
-	shadow_rec*     srec;
+	std::map<int, multi_job_shadow_rec>::iterator mit = multiJobShadows.find(pid);
+	if( mit != multiJobShadows.end() ) {
+			// A shadow that exits normally has reported every job
+			// but the last, which exits with the shadow's status.
+			// If it crashed or got an exception, the jobs it still
+			// has were running when it died.  Reconnect to each of
+			// them with a shadow of its own, so that one job's
+			// failure doesn't take all of them down.  Jobs that can't
+			// be reconnected exit with its exit status.  The jobs it
+			// never fetched didn't start.
+		bool died = WIFSIGNALED(status) ||
+			(WIFEXITED(status) && WEXITSTATUS(status) == JOB_EXCEPTION);
+		multi_job_shadow_rec mjs = mit->second;
+		for( std::set<PROC_ID>::iterator it = mjs.jobs.begin(); it != mjs.jobs.end(); ++it ) {
+			shadow_rec *srec = FindSrecByProcID( *it );
+			if( !srec || srec->pid != pid ) {
+				continue;
+			}
+			bool pending = std::find(mjs.pending.begin(), mjs.pending.end(), *it) != mjs.pending.end();
+			if( pending ) {
+				shadow_rec_exit( srec, JOB_NOT_STARTED << 8 );
+			}
+			else if( !died || !reconnectMultiJobShadowJob( srec ) ) {
+				shadow_rec_exit( srec, status );
+			}
+		}
+		multiJobShadows.erase( pid );
+		return;
+	}
+
+	shadow_rec *srec = FindSrecByPid(pid);
+	ASSERT(srec);
+	shadow_rec_exit( srec, status );
+}
+
+	// Handle the exit of the job handler for a job, which is usually the
+	// exit of its shadow, but may be the exit of one of the jobs that a
+	// multi-job shadow is running.
+void
+Scheduler::shadow_rec_exit(shadow_rec *srec, int status)
+{
+	int             pid = srec->pid;
 	int             StartJobsFlag=TRUE;
 	PROC_ID	        job_id;
 	bool            srec_was_local_universe = false;
@@ -11905,9 +12391,6 @@ Scheduler::child_exit(int pid, int status)
 	// AsyncXfer: Should this match be held idle waiting for a paired match?
 	bool            paired_match_wait = false;
 
-	srec = FindSrecByPid(pid);
-	ASSERT(srec);
-
 	if( srec->match ) {
 		match_rec *mrec = srec->match;
 
@@ -12055,7 +12538,10 @@ Scheduler::child_exit(int pid, int status)
 
 		// We always want to delete the shadow record regardless
 		// of how the job exited
-		delete_shadow_rec( pid );
+		srec = FindSrecByProcID( job_id );
+		if( srec && srec->pid == pid ) {
+			delete_shadow_rec( srec );
+		}
 
 	} 
 
@@ -12066,7 +12552,7 @@ Scheduler::child_exit(int pid, int status)
 	//
 	if ( srec_was_local_universe == true ) {
 		JobQueueJob *job_ad = GetJobAd(job_id);
-		count_a_job( job_ad, job_ad->jid, NULL);
+		CountJob( job_ad );
 	}
 
 	// If we're not trying to shutdown, now that either an agent
@@ -13290,6 +13776,8 @@ Scheduler::Init()
 	/* Value specified in kilobytes */
 	ShadowSizeEstimate = param_integer( "SHADOW_SIZE_ESTIMATE",DEFAULT_SHADOW_SIZE );
 
+	MaxJobsPerShadow = param_integer( "MAX_JOBS_PER_SHADOW", 1, 1 );
+
 	alive_interval = param_integer("ALIVE_INTERVAL",300,0);
 	if( alive_interval > leaseAliveInterval ) {
 			// adjust alive_interval to shortest interval of jobs in the queue
@@ -13346,6 +13834,14 @@ Scheduler::Init()
 
 	PeriodicExprInterval.setTimeslice( param_double("PERIODIC_EXPR_TIMESLICE", 0.01,0,1) );
 
+	PeriodicExprFullInterval = param_integer("PERIODIC_EXPR_FULL_INTERVAL", 3600, 0);
+		// the system periodic expressions may have changed
+	PeriodicExprsNeedFullEval = true;
+
+	JobCountsAuditInterval = param_integer("SCHEDD_JOB_COUNTS_AUDIT_INTERVAL", 3600, 0);
+		// the slot weight and flocking configuration may have changed
+	JobCountsNeedFullCount = true;
+
 	RequestClaimTimeout = param_integer("REQUEST_CLAIM_TIMEOUT",60*30);
 
 	int int_val = param_integer( "JOB_IS_FINISHED_INTERVAL", 0, 0 );
@@ -13712,6 +14208,11 @@ Scheduler::Register()
 			(CommandHandlercpp)&Scheduler::RecycleShadow,
 			"RecycleShadow", this, DAEMON, D_COMMAND,
 			true /*force authentication*/);
+	 daemonCore->Register_CommandWithPayload(MULTI_JOB_SHADOW_SYNC,
+			"MULTI_JOB_SHADOW_SYNC",
+			(CommandHandlercpp)&Scheduler::MultiJobShadowSync,
+			"MultiJobShadowSync", this, DAEMON, D_COMMAND,
+			true /*force authentication*/);
 
 		 // Commands used by the startd are registered at READ
 		 // level rather than something like DAEMON or WRITE in order
@@ -13900,7 +14401,7 @@ Scheduler::RegisterTimers()
         }
         cleanid =
             daemonCore->Register_Timer(QueueCleanInterval,QueueCleanInterval,
-            CleanJobQueue,"CleanJobQueue");
+            PeriodicCleanJobQueue,"PeriodicCleanJobQueue");
     }
     oldQueueCleanInterval = QueueCleanInterval;
 
@@ -14134,6 +14635,12 @@ Scheduler::shutdown_fast()
 					sig, rec->pid,
 					rec->job_id.cluster, rec->job_id.proc );
 	}
+	std::map<int, multi_job_shadow_rec>::iterator mit;
+	for( mit = multiJobShadows.begin(); mit != multiJobShadows.end(); ++mit ) {
+		daemonCore->Send_Signal(mit->first, SIGKILL);
+		dprintf( D_ALWAYS, "Sent signal %d to shadow [pid %d] for %d jobs\n",
+					SIGKILL, mit->first, (int)mit->second.jobs.size() );
+	}
 
 	// Shut down the cron logic
 	if( CronJobMgr ) {
@@ -14406,6 +14913,7 @@ Scheduler::AddMrec(char const* id, char const* peer, PROC_ID* jobId, const Class
 		return NULL;
 	}
 	ASSERT( matchesByJobID->insert( *jobId, rec ) == 0 );
+	DirtyPrioRecJob(*jobId);
 	numMatches++;
 
 		// Update CurrentRank in the startd ad.  Why?  Because when we
@@ -14506,6 +15014,7 @@ Scheduler::unlinkMrec(match_rec* match)
 	jobId.cluster = match->cluster;
 	jobId.proc = match->proc;
 	matchesByJobID->remove(jobId);
+	DirtyPrioRecJob(jobId);
 
 		// fill any authorization hole we made for this match
 	if (match->auth_hole_id != NULL) {
@@ -14572,11 +15081,13 @@ Scheduler::SetMrecJobID(match_rec *match, PROC_ID job_id) {
 	}
 
 	matchesByJobID->remove(old_job_id);
+	DirtyPrioRecJob(old_job_id);
 
 	match->cluster = job_id.cluster;
 	match->proc = job_id.proc;
 	if( match->proc != -1 ) {
 		ASSERT( matchesByJobID->insert(job_id, match) == 0 );
+		DirtyPrioRecJob(job_id);
 	}
 }
 
@@ -15007,7 +15518,12 @@ Scheduler::sendAlives()
 				DelMrec( mrec );
 				jobExitCode( srec->job_id, JOB_RECONNECT_FAILED );
 				srec->exit_already_handled = true;
-				daemonCore->Send_Signal( srec->pid, SIGKILL );
+				if( FindMultiJobShadow( srec->pid ) ) {
+						// don't kill the other jobs in the shadow
+					sendSignalToShadow( srec->pid, SIGKILL, srec->job_id );
+				} else {
+					daemonCore->Send_Signal( srec->pid, SIGKILL );
+				}
 			}
 		}
 	}
@@ -16811,6 +17327,23 @@ private:
 void
 Scheduler::sendSignalToShadow(pid_t pid,int sig,PROC_ID proc)
 {
+	multi_job_shadow_rec *mjs = FindMultiJobShadow(pid);
+	if( mjs ) {
+			// the shadow fetches the signal when we wake it up, so
+			// do now what DCShadowKillMsg does once the signal is sent
+		shadow_rec *srec = FindSrecByProcID( proc );
+		if( srec && srec->pid == pid && sig != DC_SIGSUSPEND && sig != DC_SIGCONTINUE ) {
+			srec->preempt_pending = false;
+			srec->preempted = true;
+		}
+		if( sig == SIGKILL ) {
+			mjs->killed.insert(proc);
+		}
+		mjs->signals.push_back(std::make_pair(proc, sig));
+		wakeMultiJobShadow(pid);
+		return;
+	}
+
 	classy_counted_ptr<DCShadowKillMsg> msg = new DCShadowKillMsg(pid,sig,proc);
 	daemonCore->Send_Signal_nonblocking(msg.get());
 
@@ -17071,6 +17604,316 @@ Scheduler::finishRecycleShadow(shadow_rec *srec)
 	delete stream;
 }
 
+multi_job_shadow_rec*
+Scheduler::FindMultiJobShadow(int pid)
+{
+	std::map<int, multi_job_shadow_rec>::iterator it = multiJobShadows.find(pid);
+	if( it == multiJobShadows.end() ) {
+		return NULL;
+	}
+	return &it->second;
+}
+
+bool
+Scheduler::assignToMultiJobShadow( shadow_rec *srec )
+{
+	match_rec *mrec = srec->match;
+	multi_job_shadow_rec *mjs = NULL;
+
+	std::map<int, multi_job_shadow_rec>::iterator it;
+	for( it = multiJobShadows.begin(); it != multiJobShadows.end(); ++it ) {
+		if( !it->second.closed &&
+			(int)it->second.jobs.size() < MaxJobsPerShadow &&
+			it->second.user == mrec->user )
+		{
+			mjs = &it->second;
+			break;
+		}
+	}
+	if( !mjs ) {
+		return false;
+	}
+
+	srec->pid = mjs->pid;
+	add_shadow_rec( srec );
+	mjs->jobs.insert( srec->job_id );
+	mjs->pending.push_back( srec->job_id );
+
+	dprintf( D_ALWAYS, "Assigned job %d.%d on %s to multi-job shadow "
+			 "(shadow pid = %d, %d jobs)\n", srec->job_id.cluster,
+			 srec->job_id.proc, mrec->description(), mjs->pid,
+			 (int)mjs->jobs.size() );
+
+	time_t now = stats.Tick();
+	stats.ShadowsRunning = numShadows;
+	OtherPoolStats.Tick(now);
+
+	wakeMultiJobShadow( mjs->pid );
+	return true;
+}
+
+void
+Scheduler::wakeMultiJobShadow( int pid )
+{
+	multi_job_shadow_rec *mjs = FindMultiJobShadow(pid);
+	if( !mjs || mjs->woken ) {
+			// it will sync soon anyway
+		return;
+	}
+	mjs->woken = true;
+
+	classy_counted_ptr<DCSignalMsg> msg = new DCSignalMsg(pid, MULTI_JOB_SHADOW_WAKEUP);
+	daemonCore->Send_Signal_nonblocking(msg.get());
+}
+
+bool
+Scheduler::reconnectMultiJobShadowJob( shadow_rec *srec )
+{
+		// The job is still running on its startd if it has a lease,
+		// so this is like a reconnect after the schedd restarts.
+	PROC_ID job_id = srec->job_id;
+	ClassAd *job_ad = GetJobAd( job_id.cluster, job_id.proc );
+	int status = -1;
+	if( ExitWhenDone || !srec->match || srec->removed || !job_ad ||
+		!job_ad->LookupInteger( ATTR_JOB_STATUS, status ) ||
+		(status != RUNNING && status != SUSPENDED && status != TRANSFERRING_OUTPUT) ||
+		!jobLeaseIsValid( job_ad, job_id.cluster, job_id.proc ) )
+	{
+		return false;
+	}
+
+	match_rec *mrec = srec->match;
+	dprintf( D_ALWAYS, "Multi-job shadow pid %d died while running job %d.%d, "
+			 "will reconnect to it on %s\n", srec->pid, job_id.cluster,
+			 job_id.proc, mrec->description() );
+
+	WriteUserLog* ULog = InitializeUserLog( job_id );
+	if ( ULog ) {
+		std::string startd_name;
+		GetAttributeString( job_id.cluster, job_id.proc, ATTR_REMOTE_HOST, startd_name );
+		JobDisconnectedEvent event;
+		event.setDisconnectReason( "Job shadow died" );
+		event.setStartdAddr( mrec->peer );
+		event.setStartdName( startd_name.c_str() );
+		if( !ULog->writeEventNoFsync(&event,job_ad) ) {
+			dprintf( D_ALWAYS, "Unable to log ULOG_JOB_DISCONNECTED event\n" );
+		}
+		delete ULog;
+		ULog = NULL;
+	}
+
+		// take the srec out of our tables without touching the job
+		// or the claim, and spawn a reconnect shadow for it.
+		// spawnJobHandlerRaw() puts it back in.
+	shadowsByProcID->remove( job_id );
+	if ( srec->universe != CONDOR_UNIVERSE_SCHEDULER &&
+		 srec->universe != CONDOR_UNIVERSE_LOCAL ) {
+		numShadows -= 1;
+	}
+	srec->pid = 0;
+	srec->is_reconnect = true;
+	srec->reconnect_succeeded = false;
+	mrec->setStatus( M_CLAIMED );
+	addRunnableJob( srec );
+	return true;
+}
+
+int
+Scheduler::MultiJobShadowSync(int /*cmd*/, Stream *stream)
+{
+		// This is called by a shadow running more than one job to
+		// report the exit reasons of the jobs it is done with, and
+		// to get new jobs and the signals for the jobs it has.
+	int shadow_pid = 0;
+	int running_jobs = 0;
+	int accepting = 0;
+	int num_exits = 0;
+	std::vector<PROC_ID> exited_jobs;
+	std::vector<int> exit_reasons;
+	Sock *sock = (Sock *)stream;
+
+		// force authentication
+	sock->decode();
+	if( !sock->triedAuthentication() ) {
+		CondorError errstack;
+		if( ! SecMan::authenticate_sock(sock, WRITE, &errstack) ||
+			! sock->getFullyQualifiedUser() )
+		{
+			dprintf( D_ALWAYS,
+					 "MultiJobShadowSync(): authentication failed: %s\n", 
+					 errstack.getFullText().c_str() );
+			return FALSE;
+		}
+	}
+
+	stream->decode();
+	if( !stream->get( shadow_pid ) ||
+		!stream->get( running_jobs ) ||
+		!stream->get( accepting ) ||
+		!stream->get( num_exits ) )
+	{
+		dprintf(D_ALWAYS,
+			"MultiJobShadowSync() failed to receive job exit reasons from shadow\n");
+		return FALSE;
+	}
+	for( int i = 0; i < num_exits; i++ ) {
+		PROC_ID job_id;
+		int reason = 0;
+		if( !stream->get( job_id.cluster ) ||
+			!stream->get( job_id.proc ) ||
+			!stream->get( reason ) )
+		{
+			dprintf(D_ALWAYS,
+				"MultiJobShadowSync() failed to receive job exit reasons from shadow\n");
+			return FALSE;
+		}
+		exited_jobs.push_back( job_id );
+		exit_reasons.push_back( reason );
+	}
+	if( !stream->end_of_message() ) {
+		dprintf(D_ALWAYS,
+			"MultiJobShadowSync() failed to receive job exit reasons from shadow\n");
+		return FALSE;
+	}
+
+	multi_job_shadow_rec *mjs = FindMultiJobShadow( shadow_pid );
+	if( !mjs ) {
+		dprintf(D_ALWAYS,"MultiJobShadowSync() called with unknown shadow pid %d\n",
+				shadow_pid);
+		return FALSE;
+	}
+
+		// verify that whoever is running this command is either the
+		// queue super user or the owner of the jobs
+	char const *cmd_user = EffectiveUser(sock);
+	std::string match_user = mjs->user;
+	if ( ! user_is_the_new_owner) {
+		size_t at_sign = match_user.find('@');
+		if( at_sign != std::string::npos ) {
+			match_user.erase(at_sign);
+		}
+	}
+
+	if( !UserCheck2(NULL, cmd_user, match_user.c_str()) ) {
+		dprintf(D_ALWAYS,
+				"MultiJobShadowSync() called by %s failed authorization check!\n",
+				cmd_user ? cmd_user : "(unauthenticated)");
+		return FALSE;
+	}
+
+	mjs->woken = false;
+
+		// Now handle the exit reasons.  This may give the claims of
+		// the jobs new jobs, which may come back to this shadow.
+	for( size_t i = 0; i < exited_jobs.size(); i++ ) {
+		shadow_rec *srec = FindSrecByProcID( exited_jobs[i] );
+		if( !srec || srec->pid != shadow_pid ||
+			std::find(mjs->pending.begin(), mjs->pending.end(), exited_jobs[i]) != mjs->pending.end() )
+		{
+				// we already heard about this exit
+			continue;
+		}
+		dprintf(D_ALWAYS,
+			"Shadow pid %d for job %d.%d reports job exit reason %d.\n",
+			shadow_pid, exited_jobs[i].cluster, exited_jobs[i].proc,
+			exit_reasons[i] );
+			// the same status as if a shadow running just this job
+			// had exited with the exit reason, or been killed
+		if( mjs->killed.erase( exited_jobs[i] ) ) {
+			shadow_rec_exit( srec, SIGKILL );
+		} else {
+			shadow_rec_exit( srec, exit_reasons[i] << 8 );
+		}
+	}
+
+		// A shadow with nothing to do exits, so don't give it more jobs.
+		// One that isn't accepting jobs still gets the ones assigned to
+		// it since it last synced, so their claims aren't wasted.
+	if( !accepting || (running_jobs == 0 && mjs->pending.empty()) ) {
+		mjs->closed = true;
+	}
+
+	std::vector<std::pair<PROC_ID,int> > signals;
+	signals.swap( mjs->signals );
+	std::vector<PROC_ID> new_jobs( mjs->pending.begin(), mjs->pending.end() );
+	mjs->pending.clear();
+
+	stream->encode();
+	bool sent = stream->put( (int)signals.size() );
+	for( size_t i = 0; sent && i < signals.size(); i++ ) {
+		sent = stream->put( signals[i].first.cluster ) &&
+			stream->put( signals[i].first.proc ) &&
+			stream->put( signals[i].second );
+	}
+
+	std::vector<PROC_ID> sent_jobs;
+	std::vector<ClassAd*> new_ads;
+	for( size_t i = 0; i < new_jobs.size(); i++ ) {
+		shadow_rec *srec = FindSrecByProcID( new_jobs[i] );
+		if( !srec || srec->pid != shadow_pid ) {
+			continue;
+		}
+		ClassAd *new_ad = GetExpandedJobAd( new_jobs[i], true );
+		if( !new_ad ) {
+			dprintf(D_ALWAYS,
+					"Failed to expand job ad when giving job %d.%d "
+					"to shadow %d\n",
+					new_jobs[i].cluster, new_jobs[i].proc, shadow_pid);
+			jobExitCode( new_jobs[i], JOB_SHOULD_REQUEUE );
+			srec->exit_already_handled = true;
+			shadow_rec_exit( srec, JOB_SHOULD_REQUEUE << 8 );
+			continue;
+		}
+		sent_jobs.push_back( new_jobs[i] );
+		new_ads.push_back( new_ad );
+	}
+
+	sent = sent && stream->put( (int)new_ads.size() );
+	for( size_t i = 0; sent && i < new_ads.size(); i++ ) {
+		sent = putClassAd( stream, *new_ads[i] );
+	}
+	sent = sent && stream->end_of_message();
+
+		// Get final ACK from shadow if we gave it new jobs, so we
+		// know that it will report their exits.
+	if( sent && !new_ads.empty() ) {
+		stream->decode();
+		int ok = 0;
+		sent = stream->get(ok) && stream->end_of_message() && ok;
+	}
+
+	for( size_t i = 0; i < sent_jobs.size(); i++ ) {
+		shadow_rec *srec = FindSrecByProcID( sent_jobs[i] );
+		if( !srec || srec->pid != shadow_pid ) {
+			continue;
+		}
+		if( sent ) {
+			ClassAd *machine_ad = NULL;
+			if( srec->match ) {
+				machine_ad = srec->match->my_match_ad;
+			}
+			setNextJobDelay( new_ads[i], machine_ad );
+		} else {
+			jobExitCode( sent_jobs[i], JOB_SHOULD_REQUEUE );
+			srec->exit_already_handled = true;
+			shadow_rec_exit( srec, JOB_SHOULD_REQUEUE << 8 );
+		}
+	}
+	for( size_t i = 0; i < new_ads.size(); i++ ) {
+		delete new_ads[i];
+	}
+
+	if( !sent ) {
+		dprintf(D_ALWAYS,
+			"Failed to send new jobs and signals to shadow %d.\n",
+			shadow_pid);
+			// the shadow will ask again for the signals
+		mjs->signals.insert( mjs->signals.begin(), signals.begin(), signals.end() );
+		return FALSE;
+	}
+	return TRUE;
+}
+
 int
 Scheduler::FindGManagerPid(PROC_ID job_id)
 {
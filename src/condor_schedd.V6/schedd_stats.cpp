@@ -86,6 +86,17 @@ static const time_t default_job_hist_lifes[] = {
       (time_t) 8 * 24*60*60, (time_t)16 * 24*60*60,  //  8 Day  16 Day,
       };
 static const char default_lifes_set[] = "30Sec, 1Min, 3Min, 10Min, 30Min, 1Hr, 3Hr, 6Hr, 12Hr, 1Day, 2Day, 4Day, 8Day, 16Day";
+static const int default_group_commit_sizes[] = {
+      1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024,
+      };
+static const char default_group_commit_sizes_set[] = "1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024";
+static const double default_group_commit_sync_times[] = {
+      0.001, 0.002, 0.005,    // 1ms, 2ms, 5ms
+      0.01,  0.02,  0.05,     // 10ms, 20ms, 50ms
+      0.1,   0.2,   0.5,      // 100ms, 200ms, 500ms
+      1.0,   2.0,   5.0,      // 1s, 2s, 5s
+      };
+static const char default_group_commit_sync_times_set[] = "1ms, 2ms, 5ms, 10ms, 20ms, 50ms, 100ms, 200ms, 500ms, 1s, 2s, 5s";
 
 void ScheddJobCounters::InitJobCounters(StatisticsPool &Pool, int base_verbosity)
 {
@@ -183,6 +194,8 @@ void ScheddStatistics::InitMain()
    InitJobCounters(Pool, IF_BASICPUB);
 
    JobsRestartReconnectsBadput.set_levels(default_job_hist_lifes, COUNTOF(default_job_hist_lifes));
+   JobQueueGroupCommitSizes.set_levels(default_group_commit_sizes, COUNTOF(default_group_commit_sizes));
+   JobQueueGroupCommitSyncTimes.set_levels(default_group_commit_sync_times, COUNTOF(default_group_commit_sync_times));
 
    SCHEDD_STATS_ADD_RECENT(Pool, JobsSubmitted,        IF_BASICPUB);
    SCHEDD_STATS_ADD_RECENT(Pool, Autoclusters,         IF_BASICPUB);
@@ -194,6 +207,9 @@ void ScheddStatistics::InitMain()
 
    SCHEDD_STATS_ADD_VAL(Pool, ShadowsRunning,               IF_BASICPUB);
    SCHEDD_STATS_PUB_PEAK(Pool, ShadowsRunning,              IF_BASICPUB);
+   SCHEDD_STATS_ADD_VAL(Pool, ShadowProcessesRunning,       IF_BASICPUB);
+   SCHEDD_STATS_PUB_PEAK(Pool, ShadowProcessesRunning,      IF_BASICPUB);
+   SCHEDD_STATS_ADD_VAL(Pool, ShadowMemoryPerJob,           IF_BASICPUB);
 
    SCHEDD_STATS_ADD_VAL(Pool, JobsRestartReconnectsFailed, IF_BASICPUB);
    SCHEDD_STATS_ADD_VAL(Pool, JobsRestartReconnectsLeaseExpired, IF_BASICPUB);
@@ -202,6 +218,14 @@ void ScheddStatistics::InitMain()
    SCHEDD_STATS_ADD_VAL(Pool, JobsRestartReconnectsInterrupted, IF_BASICPUB);
    SCHEDD_STATS_ADD_VAL(Pool, JobsRestartReconnectsBadput, IF_BASICPUB);
 
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueueGroupCommitSizes,     IF_VERBOSEPUB);
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueueGroupCommitSyncTimes, IF_VERBOSEPUB);
+
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueries,                IF_BASICPUB);
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueriesIndexed,         IF_BASICPUB);
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueryAdsExamined,       IF_BASICPUB);
+   SCHEDD_STATS_ADD_RECENT(Pool, JobQueryAdsReturned,       IF_BASICPUB);
+
    // SCHEDD runtime stats for various expensive processes
    //
    SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, BuildPrioRec,       IF_VERBOSEPUB);
@@ -209,6 +233,8 @@ void ScheddStatistics::InitMain()
    //SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, BuildPrioRec_walk,  IF_VERBOSEPUB);
    SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, BuildPrioRec_sort,  IF_VERBOSEPUB);
    //SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, BuildPrioRec_sweep, IF_VERBOSEPUB);
+   SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, BuildPrioRec_update, IF_VERBOSEPUB);
+   SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, CountJobs_update,    IF_VERBOSEPUB);
 
    SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, WalkJobQ, IF_VERBOSEPUB);
    SCHEDD_STATS_ADD_EXTERN_RUNTIME(Pool, WalkJobQ_check_for_spool_zombies, IF_VERBOSEPUB);
@@ -289,6 +315,10 @@ void ScheddStatistics::Publish(ClassAd & ad, int flags) const
       ad.Assign("StatsLifetime", (int)StatsLifetime);
       ad.Assign("JobsSizesHistogramBuckets", default_sizes_set);
       ad.Assign("JobsRuntimesHistogramBuckets", default_lifes_set);
+      if (flags & IF_VERBOSEPUB) {
+         ad.Assign("JobQueueGroupCommitSizesHistogramBuckets", default_group_commit_sizes_set);
+         ad.Assign("JobQueueGroupCommitSyncTimesHistogramBuckets", default_group_commit_sync_times_set);
+      }
       if (flags & IF_VERBOSEPUB)
          ad.Assign("StatsLastUpdateTime", (int)StatsLastUpdateTime);
       if (flags & IF_RECENTPUB) {
@@ -130,6 +130,18 @@ typedef struct ScheddStatistics : public ScheddJobCounters {
    stats_entry_recent<int> ShadowsRecycled;      // number of times shadows have been recycled
    //stats_entry_recent<int> ShadowExceptions;     // number of times shadows have excepted
    stats_entry_recent<int> ShadowsReconnections; // number of times shadows have reconnected
+   stats_entry_abs<int> ShadowProcessesRunning;  // current number of shadow processes, less than ShadowsRunning when shadows run many jobs
+   stats_entry_abs<int> ShadowMemoryPerJob;      // resident set size of the shadows in KiB per running job, from a sample of them
+
+   // group commit of the job queue log
+   stats_entry_recent_histogram<int> JobQueueGroupCommitSizes;        // commits acknowledged by each group fsync
+   stats_entry_recent_histogram<double> JobQueueGroupCommitSyncTimes; // seconds spent in each group fsync
+
+   // job queue queries
+   stats_entry_recent<int> JobQueries;            // number of QUERY_JOB_ADS queries answered
+   stats_entry_recent<int> JobQueriesIndexed;     // queries that examined only the jobs in one index entry
+   stats_entry_recent<int64_t> JobQueryAdsExamined; // job ads checked against the constraint of a query
+   stats_entry_recent<int64_t> JobQueryAdsReturned; // job ads that matched and were returned
 
 
    // non-published values
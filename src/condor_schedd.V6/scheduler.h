@@ -86,6 +86,7 @@ void AuditLogNewConnection( int cmd, Sock &sock, bool failure );
 // with new compilers (gcc 4.1+)
 //
 class JobQueueJob;
+struct JobCountContribution;
 extern int updateSchedDInterval( JobQueueJob*, const JOB_ID_KEY&, void* );
 
 class JobQueueCluster;
@@ -147,6 +148,24 @@ struct shadow_rec
 	~shadow_rec();
 }; 
 
+// A shadow that runs more than one job (see MAX_JOBS_PER_SHADOW).  The
+// shadow_recs of its jobs have its pid, but they are not in shadowsByPid.
+// The shadow fetches the jobs assigned to it and the signals for them
+// with the MULTI_JOB_SHADOW_SYNC command.
+struct multi_job_shadow_rec
+{
+	int				pid;
+	std::string		user;		// all of the jobs belong to this user
+	std::set<PROC_ID> jobs;		// the jobs assigned to it, including pending
+	std::deque<PROC_ID> pending;	// the jobs it hasn't fetched yet
+	std::vector<std::pair<PROC_ID,int> > signals;	// the signals it hasn't fetched yet
+	std::set<PROC_ID> killed;	// the jobs it was told to drop with SIGKILL
+	bool			closed;		// true when it won't take more jobs
+	bool			woken;		// true when we've woken it and it hasn't synced since
+
+	multi_job_shadow_rec() : pid(0), closed(false), woken(false) {}
+};
+
 
 // The schedd will have one of these structures per owner, and one for the schedd as a whole
 // these counters are new for 8.7, and used with the code that keeps live counts of jobs
@@ -228,6 +247,10 @@ struct SubmitterData {
   bool empty() const { return name.empty(); }
   SubmitterCounters num;
   std::unordered_map<std::string, SubmitterFlockCounters> flock; // Per-pool flock information
+  // the sums of what the jobs of this submitter add to num and flock, kept up to date between calls to count_jobs
+  SubmitterCounters queued;
+  std::unordered_map<std::string, SubmitterFlockCounters> queued_flock;
+  SubmitterFlockCounters queued_flock_default; // added to flock for every pool in FLOCK_TO
   std::unordered_set<std::string> owners; // Number of unique owners observed using this submitter.
   time_t LastHitTime; // records the last time we incremented num.Hit, use to expire Owners
   // Time of most recent change in flocking level or
@@ -288,6 +311,7 @@ struct OwnerInfo {
   const char * Name() const { return name.empty() ? "" : name.c_str(); }
   bool empty() const { return name.empty(); }
   RealOwnerCounters num; // job counts by OWNER rather than by submitter
+  RealOwnerCounters queued; // the sums of what the jobs of this owner add to num, kept up to date between calls to count_jobs
   LiveJobCounters live; // job counts that are always up-to-date with the committed job state
   time_t LastHitTime; // records the last time we incremented num.Hit, use to expire OwnerInfo
   OwnerInfo() : LastHitTime(0) { }
@@ -506,6 +530,7 @@ private:
 };
 
 class JobSets; // forward reference - declared in jobsets.h
+class UserPolicy;
 
 class Scheduler : public Service
 {
@@ -555,6 +580,7 @@ class Scheduler : public Service
 	JobTransforms	jobTransforms;
 	friend	int		NewProc(int cluster_id);
 	friend	int		count_a_job(JobQueueJob*, const JOB_ID_KEY&, void* );
+	friend	void	tally_a_job(JobQueueJob*, JobCountContribution&);
 //	friend	void	job_prio(ClassAd *);
 	void			AddRunnableLocalJobs();
 	bool			IsLocalJobEligibleToRun(JobQueueJob* job);
@@ -573,12 +599,24 @@ class Scheduler : public Service
 	int				spoolJobFilesReaper(int,int);	
 	int				transferJobFilesReaper(int,int);
 	void			PeriodicExprHandler( void );
+		// true if setting attr in the job ad may change what its periodic policy does
+	bool			PeriodicExprsReference( JobQueueJob *job, const char *attr );
+		// evaluate the periodic policy of the job (or of all jobs, for a cluster ad)
+		// the next time PeriodicExprHandler runs
+	void			PeriodicExprsChanged( const JOB_ID_KEY &jid );
+	void			AnalyzePeriodicExprs( JobQueueJob *job, UserPolicy &policy, bool responsible );
+		// count the job (or every job, for a cluster ad) again the next time count_jobs runs
+	void			JobCountsChanged( const JOB_ID_KEY &jid );
+		// replace what the job added to the job counts with what it adds now
+	void			CountJob( JobQueueJob *job );
+	void			UncountJob( JobQueueJob *job );
 	void			addCronTabClassAd( JobQueueJob* );
 	void			addCronTabClusterId( int );
 	void			indexAJob(JobQueueJob* job, bool loading_job_queue=false);
 	void			removeJobFromIndexes(const JOB_ID_KEY& job_id, int job_prio=0);
 	int				RecycleShadow(int cmd, Stream *stream);
 	void			finishRecycleShadow(shadow_rec *srec);
+	int				MultiJobShadowSync(int cmd, Stream *stream);
 
 	int				requestSandboxLocation(int mode, Stream* s);
 	int			FindGManagerPid(PROC_ID job_id);
@@ -607,6 +645,7 @@ class Scheduler : public Service
 	shadow_rec*		FindSrecByProcID(PROC_ID);
 	void			RemoveShadowRecFromMrec(shadow_rec*);
 	void            sendSignalToShadow(pid_t pid,int sig,PROC_ID proc);
+	multi_job_shadow_rec* FindMultiJobShadow(int pid);
 	int				AlreadyMatched(PROC_ID*);
 	int				AlreadyMatched(JobQueueJob * job, int universe);
 	void			ExpediteStartJobs() const;
@@ -617,6 +656,9 @@ class Scheduler : public Service
 	void			StartJobHandler();
 	void			addRunnableJob( shadow_rec* );
 	void			spawnShadow( shadow_rec* );
+	bool			assignToMultiJobShadow( shadow_rec* );
+	void			wakeMultiJobShadow( int pid );
+	bool			reconnectMultiJobShadowJob( shadow_rec* );
 	void			spawnLocalStarter( shadow_rec* );
 	bool			claimLocalStartd();
 	bool			isStillRunnable( int cluster, int proc, int &status ); 
@@ -852,6 +894,20 @@ private:
 	Timeslice       SchedDInterval;
 	Timeslice       PeriodicExprInterval;
 	int             periodicid;
+	int             PeriodicExprFullInterval;	// evaluate every job at least this often, 0 for every time
+	time_t          PeriodicExprLastFullEval;
+	bool            PeriodicExprsNeedFullEval;
+	std::set<JOB_ID_KEY> PeriodicExprsDirty;		// jobs to evaluate the next time
+	std::set<JOB_ID_KEY> PeriodicExprsEveryTime;	// jobs whose policy depends on the time
+	std::multimap<time_t, JOB_ID_KEY> PeriodicExprsTimers;	// jobs to evaluate when their TimerRemove expires
+	std::set<classad::References> PeriodicExprsRefSets;	// the distinct JobQueueJob::policy_refs
+	classad::References PeriodicExprsAllRefs;	// the union of PeriodicExprsRefSets
+	int             JobCountsAuditInterval;	// count every job at least this often, 0 for every time
+	time_t          JobCountsLastAudit;
+	bool            JobCountsNeedFullCount;
+	std::set<JOB_ID_KEY> JobCountsDirty;		// jobs to count the next time
+	std::set<JOB_ID_KEY> JobCountsEveryPass;	// jobs that must be counted every time
+	std::unordered_set<std::string> JobCountsFlockPools;	// FlockPools when every job was last counted
 	int				QueueCleanInterval;
 	int             RequestClaimTimeout;
 	int				JobStartDelay;
@@ -875,6 +931,7 @@ private:
 	int				JobsStarted; // # of jobs started last negotiating session
 	int				SwapSpace;	 // available at beginning of last session
 	int				ShadowSizeEstimate;	// Estimate of swap needed to run a job
+	int				MaxJobsPerShadow;	// more than 1 to run many jobs in one shadow
 	int				SwapSpaceExhausted;	// True if job died due to lack of swap space
 	int				ReservedSwap;		// for non-condor users
 	int				MaxShadowsForSwap;
@@ -973,6 +1030,8 @@ private:
 
 	// utility functions
 	int			count_jobs();
+	void		AddJobCounts(const JobCountContribution & counts, int sign);
+	void		count_all_jobs(bool audit);
 	bool		fill_submitter_ad(ClassAd & pAd, const SubmitterData & Owner, const std::string &pool_name, int flock_level);
 	int			make_ad_list(ClassAdList & ads, ClassAd * pQueryAd=NULL);
 	int			handleMachineAdsQuery( Stream * stream, ClassAd & queryAd );
@@ -988,6 +1047,7 @@ private:
 	OwnerInfo * get_ownerinfo(JobQueueJob * job);
 	void		remove_unused_owners();
 	void			child_exit(int, int);
+	void			shadow_rec_exit(shadow_rec *srec, int status);
 	// AFAICT, reapers should be be registered void to begin with.
 	int				child_exit_from_reaper(int a, int b) { child_exit(a, b); return 0; }
 	void			scheduler_univ_job_exit(int pid, int status, shadow_rec * srec);
@@ -1067,6 +1127,7 @@ private:
 	HashTable <PROC_ID, match_rec *> *matchesByJobID;
 	HashTable <int, shadow_rec *> *shadowsByPid;
 	HashTable <PROC_ID, shadow_rec *> *shadowsByProcID;
+	std::map<int, multi_job_shadow_rec> multiJobShadows;
 	HashTable <int, ExtArray<PROC_ID> *> *spoolJobFileWorkers;
 	int				numMatches;
 	int				numShadows;
@@ -31,6 +31,7 @@
 #include "secure_file.h"
 #include "zkm_base64.h"
 #include "directory_util.h"
+#include "basename.h"
 
 
 extern ReliSock *syscall_sock;
@@ -46,6 +47,18 @@ static bool write_access(const char * filename ) {
 	return thisRemoteResource->allowRemoteWriteFileAccess( filename );
 }
 
+	// A relative path from the job is relative to the job's iwd.  Make
+	// it absolute here, since a multi-job shadow's working directory
+	// is not the iwd of every job it runs.
+static void iwd_path( char *&path ) {
+	if ( path && !fullpath(path) ) {
+		std::string full;
+		formatstr( full, "%s%c%s", Shadow->getIwd(), DIR_DELIM_CHAR, path );
+		free( path );
+		path = strdup( full.c_str() );
+	}
+}
+
 static int stat_string( char *line, struct stat *info )
 {
 	return sprintf(line,"%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
@@ -425,6 +438,7 @@ do_REMOTE_syscall()
 		dprintf( D_SYSCALLS, "  lastarg = %d\n", lastarg );
 		path = NULL;
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		ASSERT( result );
 		result = ( syscall_sock->end_of_message() );
@@ -601,6 +615,7 @@ do_REMOTE_syscall()
 	  {
 		path = NULL;
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -638,9 +653,11 @@ do_REMOTE_syscall()
 		to = NULL;
 		from = NULL;
 		result = ( syscall_sock->code(from) );
+		iwd_path( from );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  from = %s\n", from );
 		result = ( syscall_sock->code(to) );
+		iwd_path( to );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  to = %s\n", to );
 		result = ( syscall_sock->end_of_message() );
@@ -700,6 +717,7 @@ do_REMOTE_syscall()
 	  {
 		path = NULL;
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(mode) );
@@ -735,6 +753,7 @@ do_REMOTE_syscall()
 	  {
 		path = NULL;
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1203,6 +1222,7 @@ do_REMOTE_syscall()
 	case CONDOR_rmall:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1243,6 +1263,7 @@ do_REMOTE_syscall()
 case CONDOR_getfile:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1300,6 +1321,7 @@ case CONDOR_getfile:
 case CONDOR_putfile:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf(D_SYSCALLS, "  path: %s\n", path);
 		result = ( syscall_sock->code(mode) );
@@ -1371,6 +1393,7 @@ case CONDOR_putfile:
 case CONDOR_getlongdir:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1431,6 +1454,7 @@ case CONDOR_getlongdir:
 case CONDOR_getdir:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1691,9 +1715,11 @@ case CONDOR_getdir:
 		char *newpath = NULL;
 
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(newpath) );
+		iwd_path( newpath );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  newpath = %s\n", newpath );
 		result = ( syscall_sock->end_of_message() );
@@ -1725,6 +1751,7 @@ case CONDOR_getdir:
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(newpath) );
+		iwd_path( newpath );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  newpath = %s\n", newpath );
 		result = ( syscall_sock->end_of_message() );
@@ -1751,6 +1778,7 @@ case CONDOR_getdir:
 	case CONDOR_readlink:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(length) );
@@ -1784,6 +1812,7 @@ case CONDOR_getdir:
 	case CONDOR_lstat:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1822,6 +1851,7 @@ case CONDOR_getdir:
 	case CONDOR_statfs:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -1860,6 +1890,7 @@ case CONDOR_getdir:
 	case CONDOR_chown:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(uid) );
@@ -1891,6 +1922,7 @@ case CONDOR_getdir:
 	case CONDOR_lchown:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(uid) );
@@ -1923,6 +1955,7 @@ case CONDOR_getdir:
 	{
 		
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(length) );
@@ -1997,6 +2030,7 @@ case CONDOR_getdir:
 	case CONDOR_stat:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->end_of_message() );
@@ -2037,6 +2071,7 @@ case CONDOR_getdir:
 		int flags = -1;
 
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(flags) );
@@ -2065,6 +2100,7 @@ case CONDOR_getdir:
 	case CONDOR_chmod:
 	{
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(mode) );
@@ -2095,6 +2131,7 @@ case CONDOR_getdir:
 		time_t actime = -1, modtime = -1;
 
 		result = ( syscall_sock->code(path) );
+		iwd_path( path );
 		ASSERT( result );
 		dprintf( D_SYSCALLS, "  path = %s\n", path );
 		result = ( syscall_sock->code(actime) );
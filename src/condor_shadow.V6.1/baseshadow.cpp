@@ -59,9 +59,11 @@ BaseShadow::BaseShadow() {
 	core_file_name = NULL;
 	scheddAddr = NULL;
 	job_updater = NULL;
-	ASSERT( !myshadow_ptr );	// make cetain we're only instantiated once
+	// make cetain we're only instantiated once, unless we host many jobs
+	ASSERT( !myshadow_ptr || multiJobShadow );
 	myshadow_ptr = this;
 	exception_already_logged = false;
+	m_exited = false;
 	began_execution = FALSE;
 	reconnect_e_factor = 0.0;
 	reconnect_ceiling = 300;
@@ -79,7 +81,9 @@ BaseShadow::BaseShadow() {
 }
 
 BaseShadow::~BaseShadow() {
-	myshadow_ptr = NULL;
+	if( myshadow_ptr == this ) {
+		myshadow_ptr = NULL;
+	}
 	if (jobAd) FreeJobAd(jobAd);
 	if (gjid) free(gjid); 
 	if (scheddAddr) free(scheddAddr);
@@ -153,6 +157,9 @@ BaseShadow::baseInit( ClassAd *job_ad, const char* schedd_addr, const char *xfer
 
 		// Make sure we've got enough swap space to run
 	checkSwap();
+	if( exited() ) {
+		return;
+	}
 
 	// handle system calls with Owner's privilege
 // XXX this belong here?  We'll see...
@@ -219,10 +226,17 @@ BaseShadow::baseInit( ClassAd *job_ad, const char* schedd_addr, const char *xfer
 		// in order to handle the case of the job going on hold as a
 		// result of failure in initUserLog().
 	initUserLog();
+	if( exited() ) {
+		return;
+	}
 
 		// change directory; hold on failure
 	if ( cdToIwd() == -1 ) {
-		EXCEPT("Could not cd to initial working directory");
+			// holdJobAndExit() only returns in a multi-job shadow
+		if( ! exited() ) {
+			EXCEPT("Could not cd to initial working directory");
+		}
+		return;
 	}
 
 		// check to see if this invocation of the shadow is just to write
@@ -233,7 +247,7 @@ BaseShadow::baseInit( ClassAd *job_ad, const char* schedd_addr, const char *xfer
 		if (pending == TRUE) {
 			// If the classad of this job "thinks" that this job should be
 			// finished already, let's enact that belief.
-			// This function does not return.
+			// This function does not return, unless we host many jobs.
 			this->terminateJob(US_TERMINATE_PENDING);
 		}
 	}
@@ -343,7 +357,8 @@ BaseShadow::shutDown( int reason )
 {
 		// exit now if there is no job ad
 	if ( !getJobAd() ) {
-		DC_Exit( reason );
+		exitJob( reason );
+		return;
 	}
 	
 		// if we are being called from the exception handler, return
@@ -398,16 +413,13 @@ BaseShadow::reconnectFailed( const char* reason )
 		// exist with JOB_SHOULD_REQUEUE.
 	if ( attemptingReconnectAtStartup ) {
 		dprintf(D_ALWAYS,"Exiting with JOB_RECONNECT_FAILED\n");
-		// does not return
-		DC_Exit( JOB_RECONNECT_FAILED );
+		// does not return, unless we host many jobs
+		exitJob( JOB_RECONNECT_FAILED );
 	} else {
 		dprintf(D_ALWAYS,"Exiting with JOB_SHOULD_REQUEUE\n");
-		// does not return
-		DC_Exit( JOB_SHOULD_REQUEUE );
+		// does not return, unless we host many jobs
+		exitJob( JOB_SHOULD_REQUEUE );
 	}
-
-	// Should never get here....
-	ASSERT(true);
 }
 
 
@@ -419,7 +431,8 @@ BaseShadow::holdJob( const char* reason, int hold_reason_code, int hold_reason_s
 
 	if( ! jobAd ) {
 		dprintf( D_ALWAYS, "In HoldJob() w/ NULL JobAd!\n" );
-		DC_Exit( JOB_SHOULD_HOLD );
+		exitJob( JOB_SHOULD_HOLD );
+		return;
 	}
 
 		// cleanup this shadow (kill starters, etc)
@@ -452,7 +465,25 @@ BaseShadow::holdJobAndExit( const char* reason, int hold_reason_code, int hold_r
 	// here it exits later with a different error code that causes the job
 	// to be rescheduled.
 	// exitAfterEvictingJob( JOB_SHOULD_HOLD );
-	DC_Exit( JOB_SHOULD_HOLD );
+	exitJob( JOB_SHOULD_HOLD );
+}
+
+void
+BaseShadow::exitJob( int reason )
+{
+	if( ! multiJobShadow ) {
+			// does not return
+		DC_Exit( reason );
+	}
+	if( m_exited ) {
+			// the job already exited, and the first reason is the one
+			// the schedd gets
+		dprintf( D_FULLDEBUG, "Job %d.%d already exited, ignoring exit "
+				 "reason %d\n", getCluster(), getProc(), reason );
+		return;
+	}
+	m_exited = true;
+	multiJobShadowExit( this, reason );
 }
 
 void
@@ -478,7 +509,8 @@ BaseShadow::mockTerminateJob( std::string exit_reason,
 	if( ! jobAd ) {
 		dprintf(D_ALWAYS, "BaseShadow::mockTerminateJob(): NULL JobAd! "
 			"Holding Job!");
-		DC_Exit( JOB_SHOULD_HOLD );
+		exitJob( JOB_SHOULD_HOLD );
+		return;
 	}
 
 	// Insert the various exit attributes into our job ad.
@@ -543,7 +575,8 @@ BaseShadow::retryJobCleanup( void )
 		        "(SHADOW_MAX_JOB_CLEANUP_RETRIES=%d) reached"
 		        "; Forcing job requeue!\n",
 		        m_max_cleanup_retries);
-		DC_Exit(JOB_SHOULD_REQUEUE);
+		exitJob(JOB_SHOULD_REQUEUE);
+		return;
 	}
 	ASSERT(m_cleanup_retry_tid == -1);
 	m_cleanup_retry_tid = daemonCore->Register_Timer(m_cleanup_retry_delay, 0,
@@ -624,7 +657,8 @@ BaseShadow::terminateJob( update_style_t kind ) // has a default argument of US_
 			// email the user, but get values from jobad
 		emailTerminateEvent( reason, kind );
 
-		DC_Exit( reason );
+		exitJob( reason );
+		return;
 	}
 
 	// the default path when kind == US_NORMAL
@@ -718,8 +752,8 @@ BaseShadow::terminateJob( update_style_t kind ) // has a default argument of US_
 		return;
 	}
 
-	// does not return.
-	DC_Exit( reason );
+	// does not return, unless we host many jobs.
+	exitJob( reason );
 }
 
 
@@ -745,7 +779,8 @@ BaseShadow::evictJob( int reason )
 
 	if( ! jobAd ) {
 		dprintf( D_ALWAYS, "In evictJob() w/ NULL JobAd!\n" );
-		DC_Exit( reason );
+		exitJob( reason );
+		return;
 	}
 
 		// cleanup this shadow (kill starters, etc)
@@ -830,9 +865,11 @@ void BaseShadow::initUserLog()
 		dprintf( D_ALWAYS, "%s\n",hold_reason.c_str());
 		holdJobAndExit(hold_reason.c_str(),
 				CONDOR_HOLD_CODE_UnableToInitUserLog,0);
-			// holdJobAndExit() should not return, but just in case it does
-			// EXCEPT
-		EXCEPT("Failed to initialize user log: %s",hold_reason.c_str());
+			// holdJobAndExit() only returns in a multi-job shadow, but
+			// just in case it does otherwise EXCEPT
+		if( ! exited() ) {
+			EXCEPT("Failed to initialize user log: %s",hold_reason.c_str());
+		}
 	}
 }
 
@@ -1243,7 +1280,7 @@ BaseShadow::checkSwap( void )
 
 	if( free_swap < reserved_swap ) {
 		dprintf( D_ALWAYS, "Not enough reserved swap space\n" );
-		DC_Exit( JOB_NO_MEM );
+		exitJob( JOB_NO_MEM );
 	}
 }	
 
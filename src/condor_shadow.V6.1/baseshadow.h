@@ -162,6 +162,18 @@ class BaseShadow : public Service
 		*/
 	void holdJobAndExit( const char* reason, int hold_reason_code, int hold_reason_subcode );
 
+		/** We're done with this job, tell the schedd why.  A shadow
+			that runs one job exits with the reason, and this does not
+			return.  A multi-job shadow reports the reason to the schedd
+			and deletes this object once we are back in the event loop,
+			so callers must return without touching the job.
+			@param reason The reason the job exited (JOB_BLAH_BLAH)
+		*/
+	void exitJob( int reason );
+
+		/// True once exitJob() has been called for this job.
+	bool exited() const { return m_exited; }
+
 		/** Remove the job from the queue, if requested, notify the
 			user about it, and exit with the appropriate status so
 			that the schedd actually removes the job.<p>
@@ -225,7 +237,7 @@ class BaseShadow : public Service
 			some cases that means we need to wait around for the starter
 			to tell us what happened.
 		*/
-	virtual void exitAfterEvictingJob( int reason ) { DC_Exit( reason ); }
+	virtual void exitAfterEvictingJob( int reason ) { exitJob( reason ); }
 	virtual bool exitDelayed( int & /*reason*/ ) { return false; }
 
 		/** The total number of bytes sent over the network on
@@ -505,6 +517,9 @@ class BaseShadow : public Service
 		// job termination?
 	bool m_committed_time_finalized;
 
+		// Has exitJob() been called?
+	bool m_exited;
+
 		// This makes this class un-copy-able:
 	BaseShadow( const BaseShadow& );
 	BaseShadow& operator = ( const BaseShadow& );
@@ -522,5 +537,16 @@ extern void fix_update_ad(ClassAd & update_ad);
 
 extern BaseShadow *Shadow;
 
+// True if this shadow hosts many jobs (--multi-job).
+extern bool multiJobShadow;
+
+// In a multi-job shadow, queue the exit reason of a job for the schedd,
+// and delete the job's shadow object once we are back in the event loop.
+extern void multiJobShadowExit(BaseShadow *shadow, int exit_reason);
+
+// Make shadow the one that the Shadow global, log messages and
+// BaseShadow::myshadow_ptr refer to.
+extern void setCurrentShadow(BaseShadow *shadow);
+
 #endif
 
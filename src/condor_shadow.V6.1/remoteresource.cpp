@@ -800,6 +800,7 @@ RemoteResource::handleSysCalls( Stream * /* sock */ )
 
 	syscall_sock = claim_sock;
 	thisRemoteResource = this;
+	setCurrentShadow( shadow );
 
 	if (do_REMOTE_syscall() < 0) {
 		shadow->dprintf(D_SYSCALLS,"Shadow: do_REMOTE_syscall returned < 0\n");
@@ -2161,6 +2162,8 @@ RemoteResource::reconnect( void )
 		formatstr( reason, "Job disconnected too long: %s (%d seconds) expired",
 		           ATTR_JOB_LEASE_DURATION, lease_duration );
 		shadow->reconnectFailed( reason.Value() );
+			// only a multi-job shadow gets here
+		return;
 	}
 	dprintf( D_ALWAYS, "%s remaining: %d\n", ATTR_JOB_LEASE_DURATION,
 			 remaining );
@@ -2489,7 +2492,7 @@ RemoteResource::requestReconnect( void )
 			msg += starter.error();
 			msg += ')';
 			shadow->reconnectFailed( msg.Value() );
-			break;
+			return;
 
 				// All the errors that can only be programmer
 				// mistakes: the starter should never return them...  
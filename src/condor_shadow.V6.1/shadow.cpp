@@ -29,7 +29,7 @@
 
 extern "C" char* d_format_time(double);
 
-UniShadow::UniShadow() : delayedExitReason( -1 ) {
+UniShadow::UniShadow() : delayedExitReason( -1 ), m_exit_lease_tid( -1 ) {
 		// pass RemoteResource ourself, so it knows where to go if
 		// it has to call something like shutDown().
 	remRes = new RemoteResource( this );
@@ -37,8 +37,14 @@ UniShadow::UniShadow() : delayedExitReason( -1 ) {
 
 UniShadow::~UniShadow() {
 	if ( remRes ) delete remRes;
-	daemonCore->Cancel_Command( SHADOW_UPDATEINFO );
-	daemonCore->Cancel_Command( CREDD_GET_CRED );
+	if ( m_exit_lease_tid != -1 ) {
+		daemonCore->Cancel_Timer( m_exit_lease_tid );
+	}
+		// a multi-job shadow registers these once for all of its jobs
+	if ( ! multiJobShadow ) {
+		daemonCore->Cancel_Command( SHADOW_UPDATEINFO );
+		daemonCore->Cancel_Command( CREDD_GET_CRED );
+	}
 }
 
 
@@ -121,6 +127,14 @@ UniShadow::init( ClassAd* job_ad, const char* schedd_addr, const char *xfer_queu
 	
 		// In this case we just pass the pointer along...
 	remRes->setJobAd( jobAd );
+
+		// A multi-job shadow can't tell which of its jobs an update
+		// on the command port is for, so it only works with starters
+		// that send updates over the syscall socket, and it registers
+		// CREDD_GET_CRED once, since it doesn't depend on the job.
+	if ( multiJobShadow ) {
+		return;
+	}
 	
 		// Register command which gets updates from the starter
 		// on the job's image size, cpu usage, etc.  Each kind of
@@ -203,7 +217,7 @@ UniShadow::gracefulShutDown( void )
 			// there's no lease or it has already expired.
 			remRes->killStarter(true);
 		} else {
-			DC_Exit( JOB_SHOULD_REQUEUE );
+			exitJob( JOB_SHOULD_REQUEUE );
 		}
 	}
 }
@@ -281,7 +295,7 @@ void UniShadow::removeJob( const char* reason )
 	if ( iPrevExitReason != JOB_SHOULD_REMOVE && iPrevExitReason != -1)
 	{
 		// don't wait for final update b/c there isn't one.
-		DC_Exit( JOB_SHOULD_REMOVE );
+		exitJob( JOB_SHOULD_REMOVE );
 	}
 }
 
@@ -575,11 +589,11 @@ UniShadow::exitAfterEvictingJob( int reason ) {
 	// do important-looking things between calling cleanUp() and calling
 	// DC_Exit().
 	if( remRes->gotJobExit() || remRes->getClaimSock() == NULL ) {
-		DC_Exit( reason );
-	} else {
+		exitJob( reason );
+	} else if( m_exit_lease_tid == -1 ) {
 		this->delayedExitReason = reason;
 		remRes->setExitReason( reason );
-		daemonCore->Register_Timer( 20, 0,
+		m_exit_lease_tid = daemonCore->Register_Timer( 20, 0,
 				(TimerHandlercpp)&UniShadow::exitLeaseHandler,
 				"exit lease handler", this );
 	}
@@ -595,8 +609,9 @@ UniShadow::exitDelayed( int &reason ) {
 }
 
 void
-UniShadow::exitLeaseHandler() const {
-	DC_Exit( delayedExitReason );
+UniShadow::exitLeaseHandler() {
+	m_exit_lease_tid = -1;
+	exitJob( delayedExitReason );
 }
 
 void
@@ -177,7 +177,7 @@ class UniShadow : public BaseShadow
 	virtual void exitAfterEvictingJob( int reason );
 	virtual bool exitDelayed( int &reason );
 
-	void exitLeaseHandler( void ) const;
+	void exitLeaseHandler( void );
 
  protected:
 
@@ -188,6 +188,7 @@ class UniShadow : public BaseShadow
  private:
 	RemoteResource *remRes;
 	int delayedExitReason;
+	int m_exit_lease_tid;
 
 	void requestJobRemoval();
 };
@@ -31,6 +31,8 @@
 #include "dc_schedd.h"
 #include "spool_version.h"
 #include "file_transfer.h"
+#include "store_cred.h"
+#include <algorithm>
 
 BaseShadow *Shadow = NULL;
 
@@ -44,6 +46,22 @@ static int proc = -1;
 static const char * xfer_queue_contact_info = NULL;
 bool sendUpdatesToSchedd = true;
 static time_t shadow_worklife_expires = 0;
+bool multiJobShadow = false;
+
+// What a multi-job shadow keeps track of, besides the jobs themselves.
+// The exits of jobs that the schedd has not been told about yet, and
+// the shadow objects of the jobs that have exited, which are deleted
+// once we are back in the event loop.
+static std::vector<BaseShadow*> hostedJobs;
+static std::vector<BaseShadow*> exitedJobs;
+static std::vector<PROC_ID> unreportedExitJobs;
+static std::vector<int> unreportedExitReasons;
+static int syncWithScheddTid = -1;
+static int deleteExitedJobsTid = -1;
+static int syncWithScheddFailures = 0;
+static bool shuttingDown = false;
+
+static void syncWithSchedd();
 
 static void
 usage( int argc, char* argv[] )
@@ -133,6 +151,11 @@ parseArgs( int argc, char *argv[] )
 			continue;
 		}
 
+		if (strcmp(opt, "--multi-job") == 0) {
+			multiJobShadow = true;
+			continue;
+		}
+
 			// the only other argument we understand is the
 			// filename we should read our ClassAd from, "-" for
 			// STDIN.  There's no further checking we need to do 
@@ -260,6 +283,10 @@ initShadow( ClassAd* ad )
 				 CondorUniverseName(universe) );
 		EXCEPT( "Universe not supported" );
 	}
+	if( multiJobShadow ) {
+			// add it before init(), since the job may exit during init()
+		hostedJobs.push_back( Shadow );
+	}
 	Shadow->init( ad, schedd_addr, xfer_queue_contact_info );
 }
 
@@ -282,6 +309,10 @@ void startShadow( ClassAd *ad )
 	}
 
 	initShadow( ad );
+	if( Shadow->exited() ) {
+			// only a multi-job shadow gets here
+		return;
+	}
 
 	bool wantClaiming = false;
 	ad->LookupBool(ATTR_CLAIM_STARTD, wantClaiming);
@@ -300,6 +331,9 @@ void startShadow( ClassAd *ad )
 			Shadow->logDataflowJobSkippedEvent(); // Must get called before Shadow->shutDown
 			dprintf(D_ALWAYS, "Job %d.%d is a dataflow job, skipping\n", cluster, proc);
 			Shadow->shutDown( JOB_EXITED );
+			if( Shadow->exited() ) {
+				return;
+			}
 		}
 		else {
 			Shadow->updateJobAttr(ATTR_DATAFLOW_JOB_SKIPPED, "false");
@@ -332,35 +366,229 @@ int handleJobRemoval(Service*,int sig)
 }
 
 
+static int handleJobSignal(BaseShadow *shadow, int sig)
+{
+	int iRet =0;
+	switch (sig)
+	{
+		case SIGUSR1: // remove the job
+			iRet =  shadow->handleJobRemoval(sig);
+			break;
+		case DC_SIGSUSPEND: // send down a signal to suspend the job
+			dprintf( D_ALWAYS, "***SUSPEND THE JOB\n");
+			iRet =  shadow->JobSuspend(sig);
+			break;
+		case DC_SIGCONTINUE: // send down a signal to continue the job
+			dprintf( D_ALWAYS, "***CONTINUE THE JOB\n");
+			iRet =  shadow->JobResume(sig);
+			break;
+		case UPDATE_JOBAD:
+			iRet =  shadow->handleUpdateJobAd(sig);
+			break;
+			// a multi-job shadow gets these for one of its jobs from
+			// the schedd, instead of as signals to the whole process
+		case SIGTERM:
+			shadow->gracefulShutDown();
+			break;
+		case SIGQUIT:
+			shadow->shutDownFast( JOB_NOT_CKPTED );
+			break;
+		case SIGKILL:
+				// as if a shadow running just this job were killed:
+				// drop the job without telling the starter, which
+				// keeps it running if it has a lease
+			shadow->exitJob( JOB_NOT_CKPTED );
+			break;
+		default: 
+			break;
+	}
+	return iRet;
+}
+
 int handleSignals(int sig)
 {
 	int iRet =0;
-	if( Shadow ) 
+	if( multiJobShadow ) {
+			// a signal to the process is for all of its jobs.  copy
+			// the list, since jobs may exit as we go
+		std::vector<BaseShadow*> jobs = hostedJobs;
+		for( size_t i = 0; i < jobs.size(); i++ ) {
+			if( !jobs[i]->exited() ) {
+				setCurrentShadow( jobs[i] );
+				iRet = handleJobSignal( jobs[i], sig );
+			}
+		}
+	}
+	else if( Shadow ) 
 	{
-		
-		switch (sig)
-		{
-			case SIGUSR1: // remove the job
-				iRet =  Shadow->handleJobRemoval(sig);
-				break;
-			case DC_SIGSUSPEND: // send down a signal to suspend the job
-				dprintf( D_ALWAYS, "***SUSPEND THE JOB\n");
-				iRet =  Shadow->JobSuspend(sig);
-				break;
-			case DC_SIGCONTINUE: // send down a signal to continue the job
-				dprintf( D_ALWAYS, "***CONTINUE THE JOB\n");
-				iRet =  Shadow->JobResume(sig);
-				break;
-			case UPDATE_JOBAD:
-				iRet =  Shadow->handleUpdateJobAd(sig);
-				break;
-			default: 
+		iRet = handleJobSignal( Shadow, sig );
+	}
+	return iRet;
+}
+
+
+void
+setCurrentShadow( BaseShadow *shadow )
+{
+	if( Shadow == shadow ) {
+		return;
+	}
+		// nothing may depend on the working directory here, since
+		// it is shared by all of the jobs.  remote syscalls resolve
+		// relative paths against Shadow->getIwd().
+	Shadow = shadow;
+	BaseShadow::myshadow_ptr = shadow;
+}
+
+
+static void
+scheduleSyncWithSchedd( int delay )
+{
+	if( syncWithScheddTid != -1 ) {
+		daemonCore->Reset_Timer( syncWithScheddTid, delay );
+		return;
+	}
+	syncWithScheddTid = daemonCore->Register_Timer( delay,
+		syncWithSchedd, "syncWithSchedd" );
+}
+
+
+static void
+deleteExitedJobs()
+{
+	deleteExitedJobsTid = -1;
+	for( size_t i = 0; i < exitedJobs.size(); i++ ) {
+		if( Shadow == exitedJobs[i] ) {
+			setCurrentShadow( hostedJobs.empty() ? NULL : hostedJobs.front() );
+		}
+		delete exitedJobs[i];
+	}
+	exitedJobs.clear();
+}
+
+
+void
+multiJobShadowExit( BaseShadow *shadow, int exit_reason )
+{
+	std::vector<BaseShadow*>::iterator it =
+		std::find( hostedJobs.begin(), hostedJobs.end(), shadow );
+	ASSERT( it != hostedJobs.end() );
+	hostedJobs.erase( it );
+
+	PROC_ID job_id;
+	job_id.cluster = shadow->getCluster();
+	job_id.proc = shadow->getProc();
+	unreportedExitJobs.push_back( job_id );
+	unreportedExitReasons.push_back( exit_reason );
+	dprintf( D_ALWAYS, "Job %d.%d exited with reason %d, still running %d jobs\n",
+			 job_id.cluster, job_id.proc, exit_reason, (int)hostedJobs.size() );
+
+		// our caller may still be using the shadow object
+	exitedJobs.push_back( shadow );
+	if( deleteExitedJobsTid == -1 ) {
+		deleteExitedJobsTid = daemonCore->Register_Timer( 0,
+			deleteExitedJobs, "deleteExitedJobs" );
+	}
+	scheduleSyncWithSchedd( 0 );
+}
+
+
+	// Tell the schedd about the jobs that exited, apply the signals it
+	// has for our jobs, and start the new jobs it has for us.
+static void
+syncWithSchedd()
+{
+	syncWithScheddTid = -1;
+	deleteExitedJobs();
+
+	bool accepting = !shuttingDown &&
+		(!shadow_worklife_expires || time(NULL) <= shadow_worklife_expires);
+	std::vector<PROC_ID> signal_jobs;
+	std::vector<int> signals;
+	std::vector<ClassAd*> new_job_ads;
+	MyString error_msg;
+
+	dprintf( D_FULLDEBUG, "Reporting %d job exits and %d running jobs to the schedd\n",
+			 (int)unreportedExitJobs.size(), (int)hostedJobs.size() );
+
+	DCSchedd schedd(schedd_addr);
+	if( !schedd.multiJobShadowSync( unreportedExitJobs, unreportedExitReasons,
+									(int)hostedJobs.size(), accepting,
+									signal_jobs, signals, new_job_ads, error_msg ) )
+	{
+		dprintf( D_ALWAYS, "Failed to sync with the schedd: %s\n", error_msg.Value() );
+		syncWithScheddFailures++;
+		if( hostedJobs.empty() ) {
+				// the schedd learns how the last job exited from our
+				// exit status; if there is more than one, requeue them
+			if( unreportedExitJobs.size() <= 1 ) {
+				DC_Exit( unreportedExitJobs.empty() ? JOB_EXITED : unreportedExitReasons[0] );
+			}
+			if( syncWithScheddFailures > param_integer("SHADOW_MAX_JOB_CLEANUP_RETRIES", 5) ) {
+				dprintf( D_ALWAYS, "Maximum number of attempts to sync with "
+						 "the schedd reached; Forcing job requeue!\n" );
+				DC_Exit( JOB_SHOULD_REQUEUE );
+			}
+		}
+		scheduleSyncWithSchedd( param_integer("SHADOW_JOB_CLEANUP_RETRY_DELAY", 30) );
+		return;
+	}
+	syncWithScheddFailures = 0;
+	unreportedExitJobs.clear();
+	unreportedExitReasons.clear();
+
+		// start the new jobs first, since the signals may be for them
+	for( size_t i = 0; i < new_job_ads.size(); i++ ) {
+		new_job_ads[i]->LookupInteger(ATTR_CLUSTER_ID,cluster);
+		new_job_ads[i]->LookupInteger(ATTR_PROC_ID,proc);
+		dprintf(D_ALWAYS,"Starting new job %d.%d\n",cluster,proc);
+		is_reconnect = false;
+		startShadow( new_job_ads[i] );
+		if( shuttingDown && !Shadow->exited() ) {
+				// the schedd assigned it before we told it we were
+				// shutting down
+			Shadow->gracefulShutDown();
+		}
+	}
+
+	for( size_t i = 0; i < signal_jobs.size(); i++ ) {
+		BaseShadow *shadow = NULL;
+		for( size_t j = 0; j < hostedJobs.size(); j++ ) {
+			if( hostedJobs[j]->getCluster() == signal_jobs[i].cluster &&
+				hostedJobs[j]->getProc() == signal_jobs[i].proc )
+			{
+				shadow = hostedJobs[j];
 				break;
-				
+			}
 		}
-		
+		if( !shadow ) {
+			dprintf( D_FULLDEBUG, "Ignoring signal %d for job %d.%d, which is not running here\n",
+					 signals[i], signal_jobs[i].cluster, signal_jobs[i].proc );
+			continue;
+		}
+		dprintf( D_ALWAYS, "Schedd sent signal %d for job %d.%d\n",
+				 signals[i], signal_jobs[i].cluster, signal_jobs[i].proc );
+		setCurrentShadow( shadow );
+		handleJobSignal( shadow, signals[i] );
+	}
+
+	if( hostedJobs.empty() && unreportedExitJobs.empty() && new_job_ads.empty() ) {
+			// the schedd won't give us any more jobs
+		dprintf( D_ALWAYS, "No jobs left to run in this shadow, exiting\n" );
+		DC_Exit( JOB_EXITED );
+	}
+
+	if( syncWithScheddTid == -1 ) {
+			// in case we miss a wakeup from the schedd
+		scheduleSyncWithSchedd( param_integer("SHADOW_QUEUE_UPDATE_INTERVAL", 15*60) );
 	}
-	return iRet;
+}
+
+
+int handleWakeup(int /* sig */)
+{
+	scheduleSyncWithSchedd( 0 );
+	return 0;
 }
 
 
@@ -394,6 +622,9 @@ main_init(int argc, char *argv[])
 		&handleSignals,"handleSignals");
 	daemonCore->Register_Signal( DC_SIGCONTINUE, "DC_SIGCONTINUE", 
 		&handleSignals,"handleSignals");
+		// the schedd has new jobs or signals for a multi-job shadow
+	daemonCore->Register_Signal( MULTI_JOB_SHADOW_WAKEUP, "MULTI_JOB_SHADOW_WAKEUP",
+		&handleWakeup,"handleWakeup");
 
 	int shadow_worklife = param_integer( "SHADOW_WORKLIFE", 3600 );
 	if( shadow_worklife > 0 ) {
@@ -411,17 +642,40 @@ main_init(int argc, char *argv[])
 
 	CheckSpoolVersion(SPOOL_MIN_VERSION_SHADOW_SUPPORTS,SPOOL_CUR_VERSION_SHADOW_SUPPORTS);
 
+	if( multiJobShadow ) {
+		if( !sendUpdatesToSchedd || !schedd_addr ) {
+			EXCEPT( "A multi-job shadow needs a schedd to get its jobs from" );
+		}
+			// each job's UniShadow registers this when it runs alone
+		daemonCore->
+			Register_Command( CREDD_GET_CRED, "CREDD_GET_CRED",
+							  &cred_get_cred_handler,
+							  "cred_get_cred_handler", DAEMON, D_COMMAND,
+							  true /*force authentication*/ );
+	}
+
 	ClassAd* ad = readJobAd();
 	if( ! ad ) {
 		EXCEPT( "Failed to read job ad!" );
 	}
 
 	startShadow( ad );
+
+	if( multiJobShadow ) {
+			// the schedd may have more jobs for us already
+		scheduleSyncWithSchedd( 0 );
+	}
 }
 
 void
 main_config()
 {
+	if( multiJobShadow ) {
+		for( size_t i = 0; i < hostedJobs.size(); i++ ) {
+			hostedJobs[i]->config();
+		}
+		return;
+	}
 	Shadow->config();
 }
 
@@ -429,12 +683,24 @@ main_config()
 void
 main_shutdown_fast()
 {
+	if( multiJobShadow ) {
+		shuttingDown = true;
+		handleSignals( SIGQUIT );
+		scheduleSyncWithSchedd( 0 );
+		return;
+	}
 	Shadow->shutDownFast( JOB_NOT_CKPTED );
 }
 
 void
 main_shutdown_graceful()
 {
+	if( multiJobShadow ) {
+		shuttingDown = true;
+		handleSignals( SIGTERM );
+		scheduleSyncWithSchedd( 0 );
+		return;
+	}
 	Shadow->gracefulShutDown();
 }
 
@@ -497,6 +763,10 @@ recycleShadow(int previous_job_exit_reason)
 	if( previous_job_exit_reason != JOB_EXITED ) {
 		return false;
 	}
+	if( multiJobShadow ) {
+			// the schedd gives us new jobs as it has them
+		return false;
+	}
 	if( shadow_worklife_expires && time(NULL) > shadow_worklife_expires ) {
 		return false;
 	}
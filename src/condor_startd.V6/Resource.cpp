@@ -310,6 +310,8 @@ Resource::Resource( CpuAttributes* cap, int rid, bool multiple_slots, Resource*
 	r_no_collector_updates = SlotType::type_param_boolean(cap, "HIDDEN", false);
 
 	update_tid = -1;
+	r_delta_updates = 0;
+	r_update_failures = 0;
 
 	r_cpu_busy = 0;
 	r_cpu_busy_start_time = 0;
@@ -1312,6 +1314,8 @@ void
 Resource::reconfig( void )
 {
 	r_attr->reconfig_DevIds(r_id, r_sub_id);
+		// the set of collectors may have changed, so start over with a full update
+	r_last_update_ad.Clear();
 #if HAVE_JOB_HOOKS
 	if (m_hook_keyword) {
 		free(m_hook_keyword);
@@ -1536,9 +1540,34 @@ Resource::do_update( void )
 #endif
 #endif
 
-		// Send class ads to collector(s)
-	rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
-								&private_ad, true );
+		// Send class ads to collector(s), just the changes if we can.
+		// If an update failed since the last one we sent, a collector
+		// may be missing it, so send the whole ad.  If the delta itself
+		// fails (most likely because the TCP connection to a restarted
+		// collector broke), follow it with the whole ad right away.
+	CollectorList * collectors = daemonCore->getCollectorList();
+	int failures = collectors ? collectors->updateFailures() : 0;
+	if ( failures != r_update_failures ) {
+		r_last_update_ad.Clear();
+		r_update_failures = failures;
+	}
+	ClassAd delta_ad;
+	if ( build_delta_ad( public_ad, private_ad, delta_ad ) ) {
+		rval = resmgr->send_update( UPDATE_STARTD_AD_DELTA, &delta_ad,
+									NULL, true );
+		failures = collectors ? collectors->updateFailures() : 0;
+		if ( failures != r_update_failures ) {
+			dprintf( D_FULLDEBUG, "Delta update to collector failed, "
+					 "sending a full update\n" );
+			r_update_failures = failures;
+			r_delta_updates = 0;
+			rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
+										&private_ad, true );
+		}
+	} else {
+		rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
+									&private_ad, true );
+	}
 	if( rval ) {
 		dprintf( D_FULLDEBUG, "Sent update to %d collector(s)\n", rval );
 	} else {
@@ -1550,6 +1579,64 @@ Resource::do_update( void )
 	update_tid = -1;
 }
 
+// Decide whether this update can be sent to the collector as a delta from the
+// previous update, and if so fill delta_ad with the attributes that changed.
+// Removed attributes and changes to the private ad can't be expressed as a
+// delta, so those force a full update.  The collector ignores a delta that does
+// not directly follow the update it has, so we also send a full update every
+// so often to resync collectors that missed an update.
+bool
+Resource::build_delta_ad( ClassAd & public_ad, ClassAd & private_ad, ClassAd & delta_ad )
+{
+	if ( ! send_delta_updates) {
+		r_last_update_ad.Clear();
+		r_last_update_pvt_ad.Clear();
+		return false;
+	}
+
+	bool use_delta = r_last_update_ad.size() > 0 && r_delta_updates < delta_updates_per_full;
+	if (use_delta && private_ad.size() != r_last_update_pvt_ad.size()) {
+		use_delta = false;
+	}
+	for (auto it = private_ad.begin(); use_delta && it != private_ad.end(); ++it) {
+		ExprTree * old_expr = r_last_update_pvt_ad.Lookup(it->first);
+		if ( ! old_expr || ! old_expr->SameAs(it->second)) {
+			use_delta = false;
+		}
+	}
+	for (auto it = r_last_update_ad.begin(); use_delta && it != r_last_update_ad.end(); ++it) {
+		if ( ! public_ad.Lookup(it->first)) {
+			use_delta = false;
+		}
+	}
+	for (auto it = public_ad.begin(); use_delta && it != public_ad.end(); ++it) {
+		ExprTree * old_expr = r_last_update_ad.Lookup(it->first);
+		if ( ! old_expr || ! old_expr->SameAs(it->second)) {
+			delta_ad.Insert(it->first, it->second->Copy());
+		}
+	}
+
+	if (use_delta) {
+			// the collector needs these to find the ad to apply the delta to,
+			// and Machine keeps the delta in the same sequence as the full ads
+		CopyAttribute(ATTR_MY_TYPE, delta_ad, public_ad);
+		CopyAttribute(ATTR_NAME, delta_ad, public_ad);
+		CopyAttribute(ATTR_MACHINE, delta_ad, public_ad);
+		CopyAttribute(ATTR_MY_ADDRESS, delta_ad, public_ad);
+		CopyAttribute(ATTR_STARTD_IP_ADDR, delta_ad, public_ad);
+		++r_delta_updates;
+		dprintf(D_FULLDEBUG, "Sending delta update with %d of %d attributes\n",
+			delta_ad.size(), public_ad.size());
+	} else {
+		delta_ad.Clear();
+		r_delta_updates = 0;
+	}
+
+	r_last_update_ad = public_ad;
+	r_last_update_pvt_ad = private_ad;
+	return use_delta;
+}
+
 // build a slot ad from whole cloth, used for updating the collector, etc
 // it is an ERROR to pass r_classad as input ad here!!
 void Resource::publish_single_slot_ad(ClassAd & ad, time_t cur_time, Purpose purpose)
@@ -1604,6 +1691,8 @@ Resource::final_update( void )
 	MyString line;
 	string escaped_name;
 
+	r_last_update_ad.Clear();
+
 		// Set the correct types
 	SetMyTypeName( invalidate_ad, QUERY_ADTYPE );
 	SetTargetTypeName( invalidate_ad, STARTD_ADTYPE );
@@ -1635,6 +1724,8 @@ Resource::update_with_ack( void )
     const int timeout = 5;
     Daemon    collector ( DT_COLLECTOR );
 
+    r_last_update_ad.Clear();
+
     if ( !collector.locate () ) {
 
         dprintf (
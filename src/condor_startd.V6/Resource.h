@@ -283,6 +283,7 @@ public:
 
 	void	update( void );		// Schedule to update the central manager.
 	void	do_update( void );			// Actually update the CM
+	bool	build_delta_ad( ClassAd & public_ad, ClassAd & private_ad, ClassAd & delta_ad );
 	void    process_update_ad(ClassAd & ad, int snapshot=0); // change the update ad before we send it 
     int     update_with_ack( void );    // Actually update the CM and wait for an ACK
 	void	final_update( void );		// Send a final update to the CM
@@ -421,6 +422,13 @@ private:
 
 	int			update_tid;	// DaemonCore timer id for update delay
 
+		// the ads sent by the last update, for building delta updates.
+		// cleared whenever the collector might not have that update.
+	ClassAd		r_last_update_ad;
+	ClassAd		r_last_update_pvt_ad;
+	int			r_delta_updates;	// delta updates sent since the last full update
+	int			r_update_failures;	// collector update failures as of the last update
+
 	int		r_cpu_busy;
 	time_t	r_cpu_busy_start_time;
 	time_t	r_last_compute_condor_load;
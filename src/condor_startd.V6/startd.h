@@ -89,6 +89,8 @@ extern	int		polling_interval;	// Interval for polling when
 									// running a job
 extern	int		update_interval;	// Interval to update CM
 extern	int		update_offset;		// Interval offset to update CM
+extern	bool	send_delta_updates;	// Send only changed attributes to the CM
+extern	int		delta_updates_per_full;	// Max delta updates between full updates
 
 // String Lists
 extern	StringList* console_devices;
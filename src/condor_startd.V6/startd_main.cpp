@@ -57,6 +57,8 @@ ResMgr*	resmgr;			// Pointer to the resource manager object
 int	polling_interval = 0;	// Interval for polling when there are resources in use
 int	update_interval = 0;	// Interval to update CM
 int	update_offset = 0;		// Interval offset to update CM
+bool	send_delta_updates = false;	// Send only changed attributes to the CM
+int	delta_updates_per_full = 0;	// Max delta updates between full updates
 
 // String Lists
 StringList *startd_job_attrs = NULL;
@@ -511,6 +513,23 @@ init_params( int first_time)
 	update_interval = param_integer( "UPDATE_INTERVAL", 300, 1 );
 	update_offset = param_integer( "UPDATE_OFFSET", 0, 0 );
 
+	send_delta_updates = param_boolean( "STARTD_SEND_DELTA_UPDATES", false );
+	delta_updates_per_full = param_integer( "STARTD_DELTA_UPDATES_PER_FULL_UPDATE", 5, 0 );
+	if( send_delta_updates ) {
+			// A collector that lost the previous update ignores deltas
+			// until the next full update, so that has to arrive before
+			// the collector expires the ad, with an update to spare.
+		int classad_lifetime = param_integer( "CLASSAD_LIFETIME", 900 );
+		int max_deltas = MAX( classad_lifetime / update_interval - 2, 0 );
+		if( delta_updates_per_full > max_deltas ) {
+			dprintf( D_ALWAYS, "STARTD_DELTA_UPDATES_PER_FULL_UPDATE of %d is too "
+					 "large for an UPDATE_INTERVAL of %d and CLASSAD_LIFETIME of "
+					 "%d, using %d\n", delta_updates_per_full, update_interval,
+					 classad_lifetime, max_deltas );
+			delta_updates_per_full = max_deltas;
+		}
+	}
+
 	if( accountant_host ) {
 		free( accountant_host );
 	}
@@ -0,0 +1,169 @@
+#!/usr/bin/env pytest
+
+# Test that a job query that the schedd answers from its Owner, JobStatus
+# or ClusterId index returns the same jobs as the same query written so
+# that the schedd has to examine every job, as jobs are submitted, change
+# status, change Owner and leave the queue.
+
+import logging
+import time
+
+import htcondor
+
+from ornithology import (
+    standup,
+    action,
+    Condor,
+)
+
+logger = logging.getLogger(__name__)
+logger.setLevel(logging.DEBUG)
+
+
+@standup
+def condor(test_dir):
+    with Condor(
+        local_dir=test_dir / "condor",
+        config={
+            # keep the jobs idle, so only our actions change their status
+            "START": "false",
+            # let the test change the Owner of a job
+            "QUEUE_ALL_USERS_TRUSTED": "true",
+            "SYSTEM_IMMUTABLE_JOB_ATTRS": "ClusterId ProcId MyType TargetType User",
+        },
+    ) as condor:
+        yield condor
+
+
+def job_ids(condor, constraint):
+    ads = condor.query(constraint=constraint, projection=["ClusterId", "ProcId"])
+    return sorted((ad["ClusterId"], ad["ProcId"]) for ad in ads)
+
+
+def indexed_queries(condor):
+    ad = condor.direct_status(
+        htcondor.DaemonTypes.Schedd,
+        htcondor.AdTypes.Schedd,
+        projection=["JobQueriesIndexed"],
+    )[0]
+    return ad.get("JobQueriesIndexed", 0)
+
+
+def counted_query(condor, constraint):
+    """
+    Returns the jobs that match the constraint, and whether the schedd
+    answered the query from an index.
+    """
+    before = indexed_queries(condor)
+    ids = job_ids(condor, constraint)
+    return ids, indexed_queries(condor) > before
+
+
+def compare_queries(condor, constraints):
+    """
+    Run each constraint as it is, which the schedd may answer from an
+    index, and wrapped in "|| false", which it can't.
+    """
+    results = {}
+    for constraint in constraints:
+        indexed, used_index = counted_query(condor, constraint)
+        full, full_used_index = counted_query(condor, "({}) || false".format(constraint))
+        results[constraint] = (indexed, full, used_index, full_used_index)
+    return results
+
+
+def wait_for_no_jobs(condor, constraint, timeout=60):
+    start = time.time()
+    while time.time() - start < timeout:
+        if not job_ids(condor, "({}) || false".format(constraint)):
+            return True
+        time.sleep(1)
+    return False
+
+
+@action
+def query_results(condor, path_to_sleep):
+    """
+    Returns the results of comparing the queries at each stage of the test,
+    keyed by stage and then by constraint, along with the two clusters.
+    """
+    description = {"executable": path_to_sleep, "arguments": "0"}
+    idle = condor.submit(description=description, count=4)
+    held = condor.submit(description=dict(description, hold="true"), count=4)
+    a = idle.clusterid
+    b = held.clusterid
+    owner = condor.query(
+        constraint="ClusterId == {}".format(a), projection=["Owner"]
+    )[0]["Owner"]
+
+    constraints = [
+        'Owner == "{}"'.format(owner),
+        'Owner =?= "{}"'.format(owner.upper()),
+        'Owner == "other"',
+        "JobStatus == 1",
+        "JobStatus == 5",
+        "JobStatus == 3",
+        "ClusterId == {}".format(a),
+        "ClusterId == {}".format(b),
+        'Owner == "{}" && JobStatus == 5'.format(owner),
+        'JobStatus == 1 && Owner == "other"',
+        "ClusterId == {} && ProcId > 1".format(b),
+    ]
+
+    stages = {}
+    stages["submit"] = compare_queries(condor, constraints)
+
+    # every job changes status
+    condor.act(htcondor.JobAction.Hold, "ClusterId == {}".format(a))
+    condor.act(htcondor.JobAction.Release, "ClusterId == {}".format(b))
+    stages["status"] = compare_queries(condor, constraints)
+
+    # half of each cluster gets a new Owner
+    condor.edit("Owner", '"other"', "ProcId < 2")
+    stages["owner"] = compare_queries(condor, constraints)
+
+    # and back again for one of them
+    condor.edit("Owner", '"{}"'.format(owner), "ClusterId == {} && ProcId == 0".format(a))
+    stages["owner_back"] = compare_queries(condor, constraints)
+
+    # one cluster leaves the queue
+    condor.act(htcondor.JobAction.Remove, "ClusterId == {}".format(a))
+    assert wait_for_no_jobs(condor, "ClusterId == {}".format(a))
+    stages["delete"] = compare_queries(condor, constraints)
+
+    return {"stages": stages, "a": a, "b": b}
+
+
+class TestJobQueryIndex:
+    def test_indexed_queries_return_the_same_jobs_as_full_walk(self, query_results):
+        for stage, results in query_results["stages"].items():
+            for constraint, (indexed, full, _, _) in results.items():
+                assert indexed == full, "{}: {}".format(stage, constraint)
+
+    def test_full_walk_queries_do_not_use_an_index(self, query_results):
+        for stage, results in query_results["stages"].items():
+            for constraint, (_, _, _, full_used_index) in results.items():
+                assert not full_used_index, "{}: {}".format(stage, constraint)
+
+    def test_selective_queries_use_an_index(self, query_results):
+        stages = query_results["stages"]
+        for stage, results in stages.items():
+            assert results["JobStatus == 3"][2], stage
+            assert results['JobStatus == 1 && Owner == "other"'][2], stage
+        assert stages["submit"]["JobStatus == 5"][2]
+        assert stages["submit"]["ClusterId == {}".format(query_results["b"])][2]
+        assert stages["owner"]['Owner == "other"'][2]
+
+    def test_queries_find_the_jobs(self, query_results):
+        found = {
+            stage: {constraint: len(r[0]) for constraint, r in results.items()}
+            for stage, results in query_results["stages"].items()
+        }
+        assert found["submit"]["JobStatus == 1"] == 4
+        assert found["submit"]["JobStatus == 5"] == 4
+        assert found["status"]["JobStatus == 1"] == 4
+        assert found["status"]["JobStatus == 5"] == 4
+        assert found["owner"]['Owner == "other"'] == 4
+        assert found["owner_back"]['Owner == "other"'] == 3
+        assert found["delete"]['Owner == "other"'] == 2
+        assert found["delete"]["JobStatus == 5"] == 0
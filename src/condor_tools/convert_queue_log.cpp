@@ -0,0 +1,118 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Rewrite a job queue log (or any other ClassAd log) with every record
+// in the text form or in the binary form.  The records are copied one for
+// one, so transactions and the historical sequence number are preserved.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "classad_log.h"
+#include "MyString.h"
+
+static void usage(const char* name);
+static bool convertQueueLog(const char *in_name, const char *out_name, bool binary);
+
+int
+main(int argc, char* argv[])
+{
+	const char * in_name = NULL;
+	const char * out_name = NULL;
+	int binary = -1;
+
+	set_priv_initialize(); // allow uid switching if root
+	config();
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-help") == 0) {
+			usage(argv[0]);
+			exit(0);
+		} else if (strcmp(argv[i], "-binary") == 0) {
+			binary = 1;
+		} else if (strcmp(argv[i], "-text") == 0) {
+			binary = 0;
+		} else if (strcmp(argv[i], "-debug") == 0) {
+			dprintf_set_tool_debug("TOOL", 0);
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			usage(argv[0]);
+			exit(1);
+		} else if ( ! in_name) {
+			in_name = argv[i];
+		} else if ( ! out_name) {
+			out_name = argv[i];
+		} else {
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+	if (binary < 0 || ! in_name) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	if (out_name) {
+		return convertQueueLog(in_name, out_name, binary) ? 0 : 1;
+	}
+
+	// convert in place, keeping the original log
+	MyString new_name, old_name;
+	new_name.formatstr("%s.new", in_name);
+	old_name.formatstr("%s.oldver", in_name);
+	if ( ! convertQueueLog(in_name, new_name.Value(), binary)) {
+		return 1;
+	}
+	if (rename(in_name, old_name.Value()) < 0 || rename(new_name.Value(), in_name) < 0) {
+		fprintf(stderr, "Failed to replace %s with %s, errno = %d (%s)\n",
+			in_name, new_name.Value(), errno, strerror(errno));
+		return 1;
+	}
+	printf("The original log was renamed to %s\n", old_name.Value());
+	return 0;
+}
+
+
+static void
+usage(const char* name)
+{
+	printf("Usage: %s [-help] [-debug] -binary|-text <log> [<new log>]\n", name);
+	printf("    Rewrites a job queue log (job_queue.log) with all of its records in\n"
+	       "    the binary form or in the text form.  If <new log> is not given, the\n"
+	       "    log is converted in place and the original is renamed to end in\n"
+	       "    '.oldver'.  The schedd must not be running while its log is converted.\n");
+}
+
+
+static bool
+convertQueueLog(const char *in_name, const char *out_name, bool binary)
+{
+	unsigned long count = 0;
+	MyString errmsg;
+	if ( ! ConvertClassAdLog(in_name, out_name, binary, count, errmsg)) {
+		fprintf(stderr, "%s", errmsg.Value());
+		return false;
+	}
+	if ( ! errmsg.empty()) {
+		// this is what the schedd does with an unterminated record too
+		fprintf(stderr, "Warning: %s", errmsg.Value());
+	}
+	printf("Wrote %lu records from %s to %s as %s\n", count, in_name, out_name, binary ? "binary" : "text");
+	return true;
+}
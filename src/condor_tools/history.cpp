@@ -37,6 +37,8 @@
 #include "match_prefix.h"
 #include "subsystem_info.h"
 #include "historyFileFinder.h"
+#include "classadHistory.h" // for the history index
+#include "history_archive.h"
 #include "condor_id.h"
 #include "userlog_to_classads.h"
 #include "setenv.h"
@@ -108,6 +110,9 @@ static void readHistoryRemote(classad::ExprTree *constraintExpr, bool want_start
 static void readHistoryFromFiles(bool fileisuserlog, const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr);
 static void readHistoryFromFileOld(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr);
 static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards);
+static bool readHistoryFromIndex(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards);
+static bool readHistoryFromArchive(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards);
+static void initArchiveQuery(const char* constraint, ExprTree *constraintExpr);
 static void printJobAds(ClassAdList & jobs);
 static void printJob(ClassAd & ad);
 
@@ -144,6 +149,20 @@ static bool abort_transfer = false;
 static StringList projection;
 static classad::References whitelist;
 static ExprTree *sinceExpr = NULL;
+static ExprTree *indexConstraintExpr = NULL; // the part of the constraint that can be checked with the history index
+
+// a clause of the constraint that compares an attribute with an integer, which
+// can be checked against the range of values in a block of a history archive.
+struct ArchiveRangeClause {
+	std::string attr;
+	classad::Operation::OpKind op;
+	long long value;
+};
+static std::vector<ArchiveRangeClause> archiveRangeClauses;
+static classad::References archiveFilterAttrs; // the attributes the constraint and -since refer to
+static bool archiveFilterRows = false;         // true if the archive rows can be checked with just those
+static classad::References archiveAttrs;       // the attributes needed for output and the constraint
+static bool archiveProject = false;            // true if just archiveAttrs need to be read from an archive
 static bool want_startd_history = false;
 
 int getInheritedSocks(Stream* socks[], size_t cMaxSocks, pid_t & ppid)
@@ -534,6 +553,13 @@ main(int argc, const char* argv[])
 	  fprintf( stderr, "Error:  could not parse constraint %s\n", my_constraint.c_str() );
 	  exit( 1 );
   }
+  // -since must be checked for every ad, so it must be answerable from the index too
+  if ( ! sinceExpr || CanEvaluateWithHistoryIndex(sinceExpr)) {
+	  indexConstraintExpr = MakeHistoryIndexConstraint(constraintExpr);
+  }
+  if (diagnostic && indexConstraintExpr) {
+	  fprintf(stderr, "Using history index constraint: %s\n", ExprTreeToString(indexConstraintExpr));
+  }
 
   if ( use_xml && use_json ) {
     fprintf( stderr, "Error: Cannot print as both XML and JSON\n" );
@@ -557,6 +583,7 @@ main(int argc, const char* argv[])
 		for (const char * attr = projection.first(); attr != NULL; attr = projection.next()) {
 			whitelist.insert(attr);
 		}
+		initArchiveQuery(my_constraint.c_str(), constraintExpr);
       readHistoryFromFiles(fileisuserlog, JobHistoryFileName, my_constraint.c_str(), constraintExpr);
   }
   else {
@@ -1334,6 +1361,23 @@ static void printJob(ClassAd & ad)
 	printCount++;
 }
 
+// count the ad as scanned, and print it if it matches the constraint
+//
+static void printAdIfConstraint(ClassAd & ad, const char* constraint, ExprTree *constraintExpr)
+{
+	++adCount;
+
+	if (sinceExpr && EvalExprBool(&ad, sinceExpr)) {
+		maxAds = adCount; // this will force us to stop scanning
+		return;
+	}
+
+	if (!constraint || constraint[0]=='\0' || EvalExprBool(&ad, constraintExpr)) {
+		printJob(ad);
+		matchCount++; // if control reached here, match has occured
+	}
+}
+
 // convert list of expressions into a classad
 //
 static void printJobIfConstraint(std::vector<std::string> & exprs, const char* constraint, ExprTree *constraintExpr)
@@ -1357,17 +1401,7 @@ static void printJobIfConstraint(std::vector<std::string> & exprs, const char* c
 		}
 		exprs.pop_back();
 	}
-	++adCount;
-
-	if (sinceExpr && EvalExprBool(&ad, sinceExpr)) {
-		maxAds = adCount; // this will force us to stop scanning
-		return;
-	}
-
-	if (!constraint || constraint[0]=='\0' || EvalExprBool(&ad, constraintExpr)) {
-		printJob(ad);
-		matchCount++; // if control reached here, match has occured
-	}
+	printAdIfConstraint(ad, constraint, constraintExpr);
 }
 
 static void printJobAds(ClassAdList & jobs)
@@ -1389,6 +1423,16 @@ static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* co
 		return;
 	}
 
+	// a rotated history file may have been replaced by an archive
+	if (readHistoryFromArchive(JobHistoryFileName, constraint, constraintExpr, read_backwards)) {
+		return;
+	}
+
+	// if the history file has an index, use it to read just the ads that can match.
+	if (indexConstraintExpr && readHistoryFromIndex(JobHistoryFileName, constraint, constraintExpr, read_backwards)) {
+		return;
+	}
+
 	// the old function doesn't work for backwards, but it does work for forwards so go ahead and call it.
 	//
 	if ( ! read_backwards) {
@@ -1470,6 +1514,273 @@ static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* co
 	reader.Close();
 }
 
+// Read the ads in the history file that can match, using the index to skip the
+// others.  Returns false without reading anything if the file has no usable index.
+static bool readHistoryFromIndex(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards)
+{
+	std::vector<HistoryIndexEntry> entries;
+	if ( ! ReadHistoryIndex(JobHistoryFileName, entries)) {
+		return false;
+	}
+	FILE * fp = safe_fopen_wrapper_follow(JobHistoryFileName, "r");
+	if ( ! fp) {
+		return false;
+	}
+
+	std::string buf;
+	std::vector<std::string> exprs;
+	size_t num_entries = entries.size();
+	for (size_t ix = 0; ix < num_entries; ++ix) {
+		if ((specifiedMatch > 0 && matchCount >= specifiedMatch) || (maxAds > 0 && adCount >= maxAds))
+			break;
+		if (abort_transfer)
+			break;
+
+		const HistoryIndexEntry & entry = entries[read_backwards ? num_entries - 1 - ix : ix];
+		if ( ! entry.MayMatch(indexConstraintExpr)) {
+			// this ad can't match, but it still counts as scanned
+			++adCount;
+			if (sinceExpr) {
+				ClassAd index_ad;
+				entry.ToClassAd(index_ad);
+				if (EvalExprBool(&index_ad, sinceExpr)) {
+					maxAds = adCount; // this will force us to stop scanning
+				}
+			}
+			continue;
+		}
+
+		buf.resize(entry.end - entry.start);
+		if (fseek(fp, entry.start, SEEK_SET) < 0 || fread(&buf[0], 1, buf.size(), fp) != buf.size()) {
+			fprintf(stderr, "Error reading history file %s: %s\n", JobHistoryFileName, strerror(errno));
+			exit(1);
+		}
+
+		// the lines go into exprs last first, as they do when reading backwards,
+		// leaving out the "***" banner line and comments.
+		size_t eol = buf.size();
+		while (eol > 0) {
+			size_t bol = buf.rfind('\n', eol - 1);
+			bol = (bol == std::string::npos) ? 0 : bol + 1;
+			const char * psz = buf.c_str() + bol;
+			while (*psz == ' ' || *psz == '\t') ++psz;
+			if (eol > bol && *psz != '#' && ! starts_with(psz, "*** ")) {
+				exprs.push_back(buf.substr(bol, eol - bol));
+			}
+			eol = bol ? bol - 1 : 0;
+		}
+		printJobIfConstraint(exprs, constraint, constraintExpr);
+		exprs.clear();
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// add the clauses of the constraint that compare an attribute with an integer
+// to archiveRangeClauses
+static void addArchiveRangeClauses(ExprTree * tree)
+{
+	tree = SkipExprParens(tree);
+	if ( ! tree || tree->GetKind() != ExprTree::OP_NODE) {
+		return;
+	}
+	classad::Operation::OpKind op;
+	ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+	((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+	if (op == classad::Operation::LOGICAL_AND_OP) {
+		addArchiveRangeClauses(t1);
+		addArchiveRangeClauses(t2);
+		return;
+	}
+
+	ArchiveRangeClause clause;
+	classad::Value value;
+	bool absolute = false;
+	bool reversed = false; // true for <literal> op <attr>
+	t1 = SkipExprParens(t1);
+	t2 = SkipExprParens(t2);
+	if (ExprTreeIsAttrRef(t1, clause.attr, &absolute) && ExprTreeIsLiteral(t2, value)) {
+		reversed = false;
+	} else if (ExprTreeIsLiteral(t1, value) && ExprTreeIsAttrRef(t2, clause.attr, &absolute)) {
+		reversed = true;
+	} else {
+		return;
+	}
+	if (absolute || ! value.IsIntegerValue(clause.value)) {
+		return;
+	}
+
+	// these are all false or undefined when the attribute is undefined
+	switch (op) {
+	case classad::Operation::EQUAL_OP:
+	case classad::Operation::META_EQUAL_OP:
+		clause.op = classad::Operation::EQUAL_OP;
+		break;
+	case classad::Operation::NOT_EQUAL_OP:
+		clause.op = op;
+		break;
+	case classad::Operation::LESS_THAN_OP:
+		clause.op = reversed ? classad::Operation::GREATER_THAN_OP : op;
+		break;
+	case classad::Operation::LESS_OR_EQUAL_OP:
+		clause.op = reversed ? classad::Operation::GREATER_OR_EQUAL_OP : op;
+		break;
+	case classad::Operation::GREATER_THAN_OP:
+		clause.op = reversed ? classad::Operation::LESS_THAN_OP : op;
+		break;
+	case classad::Operation::GREATER_OR_EQUAL_OP:
+		clause.op = reversed ? classad::Operation::LESS_OR_EQUAL_OP : op;
+		break;
+	default:
+		return;
+	}
+	archiveRangeClauses.push_back(clause);
+}
+
+// decide how much of the work of the query can be done by the archive reader
+static void initArchiveQuery(const char* constraint, ExprTree *constraintExpr)
+{
+	archiveRangeClauses.clear();
+	archiveFilterAttrs.clear();
+	archiveAttrs.clear();
+	bool has_constraint = constraint && constraint[0] && constraintExpr;
+
+	// blocks whose ranges can't satisfy the constraint are skipped.  an ad in a
+	// skipped block could be the one that -since stops at, so not with -since.
+	if (has_constraint && ! sinceExpr) {
+		addArchiveRangeClauses(constraintExpr);
+	}
+
+	// ads are checked against the constraint before the rest of the ad is read
+	archiveFilterRows = (has_constraint || sinceExpr) &&
+		( ! has_constraint || GetUnscopedAttrRefs(constraintExpr, archiveFilterAttrs)) &&
+		( ! sinceExpr || GetUnscopedAttrRefs(sinceExpr, archiveFilterAttrs));
+
+	// and when the output is a projection, just the projected attributes are read.
+	// the custom formats can look up attributes that are not in the projection.
+	archiveProject = longformat && ! projection.isEmpty() &&
+		( ! has_constraint || GetUnscopedAttrRefs(constraintExpr, archiveAttrs)) &&
+		( ! sinceExpr || GetUnscopedAttrRefs(sinceExpr, archiveAttrs));
+	if (archiveProject) {
+		for (const char * attr = projection.first(); attr != NULL; attr = projection.next()) {
+			archiveAttrs.insert(attr);
+		}
+	}
+}
+
+// returns false if the range of values in the block shows that no ad in it can match
+static bool archiveBlockCanMatch(HistoryArchiveReader & reader)
+{
+	for (size_t ix = 0; ix < archiveRangeClauses.size(); ++ix) {
+		const ArchiveRangeClause & clause = archiveRangeClauses[ix];
+		long long min, max;
+		bool absent;
+		if ( ! reader.GetIntegerRange(clause.attr.c_str(), min, max, absent)) {
+			continue;
+		}
+		if (absent) {
+			return false;
+		}
+		switch (clause.op) {
+		case classad::Operation::EQUAL_OP:
+			if (clause.value < min || clause.value > max) return false;
+			break;
+		case classad::Operation::NOT_EQUAL_OP:
+			if (clause.value == min && clause.value == max) return false;
+			break;
+		case classad::Operation::LESS_THAN_OP:
+			if (min >= clause.value) return false;
+			break;
+		case classad::Operation::LESS_OR_EQUAL_OP:
+			if (min > clause.value) return false;
+			break;
+		case classad::Operation::GREATER_THAN_OP:
+			if (max <= clause.value) return false;
+			break;
+		case classad::Operation::GREATER_OR_EQUAL_OP:
+			if (max < clause.value) return false;
+			break;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+// Read the ads in a history archive, skipping the blocks and ads that can't
+// match.  Returns false without reading anything if the file is not an archive.
+static bool readHistoryFromArchive(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards)
+{
+	if ( ! IsHistoryArchive(JobHistoryFileName)) {
+		return false;
+	}
+	HistoryArchiveReader reader;
+	std::string errmsg;
+	if ( ! reader.Open(JobHistoryFileName, errmsg)) {
+		fprintf(stderr, "Error reading history archive: %s\n", errmsg.c_str());
+		exit(1);
+	}
+
+	int num_blocks = reader.NumBlocks();
+	for (int bx = 0; bx < num_blocks; ++bx) {
+		if ((specifiedMatch > 0 && matchCount >= specifiedMatch) || (maxAds > 0 && adCount >= maxAds))
+			break;
+		if (abort_transfer)
+			break;
+
+		int block = read_backwards ? num_blocks - 1 - bx : bx;
+		if ( ! reader.ReadBlockHeader(block)) {
+			fprintf(stderr, "Error reading history archive %s: block %d is corrupt\n", JobHistoryFileName, block);
+			exit(1);
+		}
+		if ( ! archiveBlockCanMatch(reader)) {
+			// these ads can't match, but they still count as scanned
+			adCount += reader.NumRows();
+			if (maxAds > 0 && adCount > maxAds) adCount = maxAds;
+			continue;
+		}
+		if ( ! reader.ReadBlockData()) {
+			fprintf(stderr, "Error reading history archive %s: block %d is corrupt\n", JobHistoryFileName, block);
+			exit(1);
+		}
+
+		int num_rows = reader.NumRows();
+		for (int rx = 0; rx < num_rows; ++rx) {
+			if ((specifiedMatch > 0 && matchCount >= specifiedMatch) || (maxAds > 0 && adCount >= maxAds))
+				break;
+			if (abort_transfer)
+				break;
+			int row = read_backwards ? num_rows - 1 - rx : rx;
+
+			if (archiveFilterRows) {
+				ClassAd filter_ad;
+				if (reader.GetRowLiterals(row, filter_ad, archiveFilterAttrs)) {
+					if (sinceExpr && EvalExprBool(&filter_ad, sinceExpr)) {
+						++adCount;
+						maxAds = adCount; // this will force us to stop scanning
+						continue;
+					}
+					if (constraint && constraint[0] && ! EvalExprBool(&filter_ad, constraintExpr)) {
+						++adCount;
+						continue;
+					}
+				}
+			}
+
+			ClassAd ad;
+			ad.rehash(521); // big enough to prevent regrowing hash table
+			if ( ! reader.GetRow(row, ad, archiveProject ? &archiveAttrs : NULL)) {
+				dprintf(D_ALWAYS, "condor_history: failed to create classad from row %d of block %d of %s\n", row, block, JobHistoryFileName);
+				printf( "\t*** Warning: Bad history file; skipping malformed ad(s)\n" );
+				continue;
+			}
+			printAdIfConstraint(ad, constraint, constraintExpr);
+		}
+	}
+	return true;
+}
+
 // !!! ENTRIES IN THIS TABLE MUST BE SORTED BY THE FIRST FIELD !!
 static const CustomFormatFnTableItem LocalPrintFormats[] = {
 	{ "DATE",            ATTR_Q_DATE, 0, format_int_date, NULL },
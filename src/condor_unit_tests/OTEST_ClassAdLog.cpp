@@ -0,0 +1,774 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the ClassAdLog implementation, as used for the job queue log.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_attributes.h"
+#include "classad_collection.h"
+#include "ClassAdLogReader.h"
+
+#include <map>
+#include <set>
+
+static bool test_background_trunc_merges_tail(void);
+static bool test_background_trunc_replays_tail_after_crash(void);
+static bool test_background_trunc_ignores_merged_tail(void);
+static bool test_trunc_abandons_background_trunc(void);
+static bool test_background_trunc_falls_back(void);
+static bool test_reader_follows_background_trunc(void);
+static bool test_binary_round_trip(void);
+static bool test_convert_round_trip(void);
+static bool test_binary_truncated_tail(void);
+static bool test_binary_corrupt_length(void);
+static bool test_mixed_text_and_binary(void);
+
+static std::string log_name;
+
+static void
+remove_log_files()
+{
+	std::string name;
+	unlink(log_name.c_str());
+	formatstr(name, "%s.tail", log_name.c_str());
+	unlink(name.c_str());
+	formatstr(name, "%s.snapshot", log_name.c_str());
+	unlink(name.c_str());
+}
+
+static bool
+file_exists(const char *suffix)
+{
+	std::string name = log_name + suffix;
+	struct stat st;
+	return stat(name.c_str(), &st) == 0;
+}
+
+	// Other files for tests that don't need a ClassAdLog
+static std::string
+scratch_name(int i)
+{
+	std::string name;
+	formatstr(name, "%s.%d", log_name.c_str(), i);
+	return name;
+}
+
+static bool
+read_file(const std::string &name, std::string &data)
+{
+	data.clear();
+	FILE *fp = safe_fopen_wrapper_follow(name.c_str(), "rb");
+	if ( ! fp) { return false; }
+	char buf[4096];
+	size_t cb;
+	while ((cb = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		data.append(buf, cb);
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool
+write_file(const std::string &name, const std::string &data)
+{
+	FILE *fp = safe_fopen_wrapper_follow(name.c_str(), "wb");
+	if ( ! fp) { return false; }
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	if (fclose(fp) != 0) { ok = false; }
+	return ok;
+}
+
+static bool
+copy_file(const std::string &from, const std::string &to)
+{
+	FILE *in = safe_fopen_wrapper_follow(from.c_str(), "rb");
+	if ( ! in) { return false; }
+	FILE *out = safe_fopen_wrapper_follow(to.c_str(), "wb");
+	if ( ! out) { fclose(in); return false; }
+	char buf[4096];
+	size_t cb;
+	bool ok = true;
+	while ((cb = fread(buf, 1, sizeof(buf), in)) > 0) {
+		if (fwrite(buf, 1, cb, out) != cb) { ok = false; }
+	}
+	fclose(in);
+	if (fclose(out) != 0) { ok = false; }
+	return ok;
+}
+
+	// Describe the ads in a collection as "key:attr=value,...;" in key order,
+	// so the contents of two logs can be compared as strings.  MyType and
+	// TargetType are left out, a rotated log has them as attributes.
+static bool
+is_type_attr(const char *name)
+{
+	return strcasecmp(name, ATTR_MY_TYPE) == 0 || strcasecmp(name, ATTR_TARGET_TYPE) == 0;
+}
+
+static std::string
+describe(ClassAdCollection &coll)
+{
+	std::map<std::string, std::string> ads;
+	ClassAd *ad;
+	std::string key;
+	coll.StartIterateAllClassAds();
+	while (coll.IterateAllClassAds(ad, key)) {
+		std::map<std::string, std::string> attrs;
+		for (auto itr = ad->begin(); itr != ad->end(); ++itr) {
+			if (is_type_attr(itr->first.c_str())) { continue; }
+			attrs[itr->first] = ExprTreeToString(itr->second);
+		}
+		std::string desc;
+		for (auto itr = attrs.begin(); itr != attrs.end(); ++itr) {
+			formatstr_cat(desc, "%s%s=%s", desc.empty() ? "" : ",", itr->first.c_str(), itr->second.c_str());
+		}
+		ads[key] = desc;
+	}
+	std::string result;
+	for (auto itr = ads.begin(); itr != ads.end(); ++itr) {
+		formatstr_cat(result, "%s:%s;", itr->first.c_str(), itr->second.c_str());
+	}
+	return result;
+}
+
+static std::string
+describe_log()
+{
+	ClassAdCollection coll(NULL, log_name.c_str(), 0);
+	return describe(coll);
+}
+
+	// Ads 1.0 and 1.1 before a background truncation begins
+static void
+write_before(ClassAdCollection &coll)
+{
+	coll.BeginTransaction();
+	coll.NewClassAd("1.0", "Job", "Machine");
+	coll.SetAttribute("1.0", "JobStatus", "1");
+	coll.NewClassAd("1.1", "Job", "Machine");
+	coll.SetAttribute("1.1", "JobStatus", "1");
+	coll.CommitTransaction();
+}
+
+	// Changes made while the tail is being written
+static void
+write_during(ClassAdCollection &coll)
+{
+	coll.BeginTransaction();
+	coll.SetAttribute("1.0", "JobStatus", "2");
+	coll.DestroyClassAd("1.1");
+	coll.NewClassAd("2.0", "Job", "Machine");
+	coll.SetAttribute("2.0", "Owner", "\"alice\"");
+	coll.CommitTransaction();
+}
+
+static const char *expected_after = "1.0:JobStatus=2;2.0:Owner=\"alice\";";
+
+bool OTEST_ClassAdLog(void) {
+	emit_object("ClassAdLog");
+	emit_comment("Keeps a table of ClassAds in a log of transactions. These "
+		"tests cover cleaning the log in the background, where new records "
+		"go to a tail file while a snapshot of the table is written, and "
+		"records written in the binary form.");
+
+	formatstr(log_name, "testclassadlog%d", (int)getpid());
+
+	FunctionDriver driver;
+	driver.register_function(test_background_trunc_merges_tail);
+	driver.register_function(test_background_trunc_replays_tail_after_crash);
+	driver.register_function(test_background_trunc_ignores_merged_tail);
+	driver.register_function(test_trunc_abandons_background_trunc);
+	driver.register_function(test_background_trunc_falls_back);
+	driver.register_function(test_reader_follows_background_trunc);
+	driver.register_function(test_binary_round_trip);
+	driver.register_function(test_convert_round_trip);
+	driver.register_function(test_binary_truncated_tail);
+	driver.register_function(test_binary_corrupt_length);
+	driver.register_function(test_mixed_text_and_binary);
+
+	bool result = driver.do_all_functions();
+	remove_log_files();
+	for (int i = 0; i < 4; i++) {
+		unlink(scratch_name(i).c_str());
+	}
+	return result;
+}
+
+static bool test_background_trunc_merges_tail() {
+	emit_test("Test that the tail written during a background truncation "
+		"is merged into the new log.");
+	remove_log_files();
+	bool began, merged, in_background;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		began = coll.BeginBackgroundTruncLog();
+		write_during(coll);
+		bool written = coll.WriteSnapshot();
+		merged = coll.EndBackgroundTruncLog(written);
+		in_background = coll.InBackgroundTruncLog();
+			// records after the merge go to the new log
+		coll.SetAttribute("2.0", "JobStatus", "1");
+	}
+	std::string actual = describe_log();
+	std::string expected = "1.0:JobStatus=2;2.0:JobStatus=1,Owner=\"alice\";";
+	bool tail = file_exists(".tail"), snapshot = file_exists(".snapshot");
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	emit_param("Tail or snapshot left", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Tail or snapshot left", "%s", tfstr(tail || snapshot));
+	if ( ! began || ! merged || in_background || actual != expected || tail || snapshot) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_background_trunc_replays_tail_after_crash() {
+	emit_test("Test that a tail that was never merged is replayed when the "
+		"log is loaded, and is then folded into the log.");
+	remove_log_files();
+	bool began;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		began = coll.BeginBackgroundTruncLog();
+		write_during(coll);
+			// the process stops here, before the snapshot is merged
+	}
+	bool tail_before = file_exists(".tail");
+	std::string actual = describe_log();
+	bool tail_after = file_exists(".tail");
+	std::string again = describe_log();
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected_after);
+	emit_param("Tail before load", "%s", tfstr(true));
+	emit_param("Tail after load", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Tail before load", "%s", tfstr(tail_before));
+	emit_param("Tail after load", "%s", tfstr(tail_after));
+	if ( ! began || actual != expected_after || again != expected_after || ! tail_before || tail_after) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_background_trunc_ignores_merged_tail() {
+	emit_test("Test that a tail left behind after it was merged is not "
+		"replayed again.");
+	remove_log_files();
+	std::string tail_copy = log_name + ".oldtail";
+	bool copied;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		coll.BeginBackgroundTruncLog();
+		write_during(coll);
+		coll.FlushLog();
+		copied = copy_file(log_name + ".tail", tail_copy);
+		coll.EndBackgroundTruncLog(coll.WriteSnapshot());
+			// undone by the stale tail if it were replayed
+		coll.SetAttribute("1.0", "JobStatus", "4");
+	}
+	copied = copied && copy_file(tail_copy, log_name + ".tail");
+	unlink(tail_copy.c_str());
+	std::string actual = describe_log();
+	std::string expected = "1.0:JobStatus=4;2.0:Owner=\"alice\";";
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	if ( ! copied || actual != expected) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_trunc_abandons_background_trunc() {
+	emit_test("Test that TruncLog() during a background truncation folds "
+		"the tail into the log and makes the snapshot stale.");
+	remove_log_files();
+	bool rotated, merged, in_background;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		coll.BeginBackgroundTruncLog();
+		write_during(coll);
+		bool written = coll.WriteSnapshot();
+		rotated = coll.TruncLog();
+		in_background = coll.InBackgroundTruncLog();
+		coll.SetAttribute("2.0", "JobStatus", "1");
+			// the reaper of the snapshot child runs after the rotation
+		merged = coll.EndBackgroundTruncLog(written);
+	}
+	std::string actual = describe_log();
+	std::string expected = "1.0:JobStatus=2;2.0:JobStatus=1,Owner=\"alice\";";
+	bool tail = file_exists(".tail"), snapshot = file_exists(".snapshot");
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	emit_param("Snapshot merged", "%s", tfstr(false));
+	emit_param("Tail or snapshot left", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Snapshot merged", "%s", tfstr(merged));
+	emit_param("Tail or snapshot left", "%s", tfstr(tail || snapshot));
+	if ( ! rotated || in_background || merged || actual != expected || tail || snapshot) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_background_trunc_falls_back() {
+	emit_test("Test that a background truncation whose snapshot was not "
+		"written falls back to TruncLog().");
+	remove_log_files();
+	bool rotated, in_background;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		coll.BeginBackgroundTruncLog();
+		write_during(coll);
+		rotated = coll.EndBackgroundTruncLog(false);
+		in_background = coll.InBackgroundTruncLog();
+	}
+	std::string actual = describe_log();
+	bool tail = file_exists(".tail"), snapshot = file_exists(".snapshot");
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected_after);
+	emit_param("Tail or snapshot left", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Tail or snapshot left", "%s", tfstr(tail || snapshot));
+	if ( ! rotated || in_background || actual != expected_after || tail || snapshot) {
+		FAIL;
+	}
+	PASS;
+}
+
+	// A consumer that keeps the keys and attributes it has been told of
+class TestLogConsumer : public ClassAdLogConsumer
+{
+public:
+	TestLogConsumer() : resets(0) {}
+	void Reset() { ++resets; ads.clear(); }
+	bool NewClassAd(const char *key, const char *, const char *) { ads[key]; return true; }
+	bool DestroyClassAd(const char *key) { ads.erase(key); return true; }
+	bool SetAttribute(const char *key, const char *name, const char *value) {
+		ads[key][name] = value;
+		return true;
+	}
+	bool DeleteAttribute(const char *key, const char *name) {
+		ads[key].erase(name);
+		return true;
+	}
+	std::string describe() {
+		std::string result;
+		for (auto itr = ads.begin(); itr != ads.end(); ++itr) {
+			std::string desc;
+			for (auto a = itr->second.begin(); a != itr->second.end(); ++a) {
+				if (is_type_attr(a->first.c_str())) { continue; }
+				formatstr_cat(desc, "%s%s=%s", desc.empty() ? "" : ",", a->first.c_str(), a->second.c_str());
+			}
+			formatstr_cat(result, "%s:%s;", itr->first.c_str(), desc.c_str());
+		}
+		return result;
+	}
+
+	int resets;
+	std::map<std::string, std::map<std::string, std::string> > ads;
+};
+
+static bool test_reader_follows_background_trunc() {
+	emit_test("Test that a program following the log does not see the tail "
+		"until it is merged, and then reads the whole new log.");
+	remove_log_files();
+	TestLogConsumer *consumer = new TestLogConsumer;
+	ClassAdLogReader reader(consumer);
+	reader.SetClassAdLogFileName(log_name.c_str());
+	std::string before, during, after;
+	int resets_before, resets_after;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		reader.Poll();
+		before = consumer->describe();
+		resets_before = consumer->resets;
+		coll.BeginBackgroundTruncLog();
+		write_during(coll);
+		reader.Poll();
+		during = consumer->describe();
+		coll.EndBackgroundTruncLog(coll.WriteSnapshot());
+		reader.Poll();
+		after = consumer->describe();
+		resets_after = consumer->resets;
+	}
+	std::string expected_before = "1.0:JobStatus=1;1.1:JobStatus=1;";
+	emit_output_expected_header();
+	emit_param("Before", "%s", expected_before.c_str());
+	emit_param("During", "%s", expected_before.c_str());
+	emit_param("After", "%s", expected_after);
+	emit_param("Reloaded", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Before", "%s", before.c_str());
+	emit_param("During", "%s", during.c_str());
+	emit_param("After", "%s", after.c_str());
+	emit_param("Reloaded", "%s", tfstr(resets_after > resets_before));
+	if (before != expected_before || during != expected_before || after != expected_after ||
+		resets_after <= resets_before) {
+		FAIL;
+	}
+	PASS;
+}
+
+	// Write one of each kind of log record, and SetAttribute records with
+	// each kind of value, returning the op types written.
+static std::vector<int>
+write_every_record_type(FILE *fp, bool binary)
+{
+	std::vector<LogRecord *> records;
+	records.push_back(new LogHistoricalSequenceNumber(7, 1600000000));
+	records.push_back(new LogBeginTransaction());
+	records.push_back(new LogNewClassAd("01.-1", "Job", "Machine"));
+	records.push_back(new LogNewClassAd("1.0", "CustomType", "OtherType"));
+	records.push_back(new LogSetAttribute("1.0", "JobStatus", "2"));
+	records.push_back(new LogSetAttribute("1.0", "CustomInt", "-7"));
+	records.push_back(new LogSetAttribute("1.0", "QDate", "1600000000"));
+	records.push_back(new LogSetAttribute("1.0", "CumulativeSlotTime", "3.5"));
+	records.push_back(new LogSetAttribute("1.0", "NiceUser", "false"));
+	records.push_back(new LogSetAttribute("1.0", "Owner", "\"alice smith\""));
+	records.push_back(new LogSetAttribute("1.0", "Env", "undefined"));
+	records.push_back(new LogSetAttribute("1.0", "CustomError", "error"));
+	records.push_back(new LogSetAttribute("1.0", "RequestMemory", "RequestCpus * 1024"));
+	records.push_back(new LogSetAttribute("1.0", "CustomList", "{ 1,\"two\",3.0 }"));
+	records.push_back(new LogSetAttribute("1.0", "CustomReal", "1.0E10"));
+	records.push_back(new LogDeleteAttribute("1.0", "Env"));
+	records.push_back(new LogDeleteAttribute("1.0", "CustomAttrThatIsNotThere"));
+	records.push_back(new LogDestroyClassAd("01.-1"));
+	records.push_back(new LogEndTransaction());
+	records.push_back(new LogBeginTransaction());
+	records.push_back(new LogSetAttribute("1.0", "JobStatus", "4"));
+	LogEndTransaction *end = new LogEndTransaction();
+	end->set_comment("a comment");
+	records.push_back(end);
+
+	std::vector<int> ops;
+	for (size_t i = 0; i < records.size(); i++) {
+		records[i]->Write(fp, binary);
+		ops.push_back(records[i]->get_op_type());
+		delete records[i];
+	}
+	return ops;
+}
+
+	// Copy the records of one file to another in the given form,
+	// returning the op types read.
+static std::vector<int>
+copy_records(const std::string &from, const std::string &to, bool binary)
+{
+	std::vector<int> ops;
+	FILE *in = safe_fopen_wrapper_follow(from.c_str(), "rb");
+	FILE *out = safe_fopen_wrapper_follow(to.c_str(), "wb");
+	if (in && out) {
+		LogRecord *rec;
+		while ((rec = ReadLogEntry(in, ops.size() + 1, InstantiateLogEntry, DefaultMakeClassAdLogTableEntry))) {
+			ops.push_back(rec->get_op_type());
+			rec->Write(out, binary);
+			delete rec;
+		}
+	}
+	if (in) { fclose(in); }
+	if (out) { fclose(out); }
+	return ops;
+}
+
+	// The number of good records read before the first bad one or the end
+static int
+count_records(const std::string &name)
+{
+	int count = 0;
+	FILE *fp = safe_fopen_wrapper_follow(name.c_str(), "rb");
+	if ( ! fp) { return -1; }
+	LogRecord *rec;
+	while ((rec = ReadLogEntry(fp, count + 1, InstantiateLogEntry, DefaultMakeClassAdLogTableEntry))) {
+		bool bad = rec->get_op_type() == CondorLogOp_Error;
+		delete rec;
+		if (bad) { break; }
+		count++;
+	}
+	fclose(fp);
+	return count;
+}
+
+static std::string
+describe_ops(const std::vector<int> &ops)
+{
+	std::string result;
+	for (size_t i = 0; i < ops.size(); i++) {
+		formatstr_cat(result, "%s%d", i ? "," : "", ops[i]);
+	}
+	return result;
+}
+
+static bool test_binary_round_trip() {
+	emit_test("Test that every kind of record written as text, copied to "
+		"binary and back to text, is the same as it was.");
+	std::string text = scratch_name(0), binary = scratch_name(1), text_again = scratch_name(2);
+	FILE *fp = safe_fopen_wrapper_follow(text.c_str(), "wb");
+	std::vector<int> ops;
+	if (fp) {
+		ops = write_every_record_type(fp, false);
+		fclose(fp);
+	}
+	std::vector<int> text_ops = copy_records(text, binary, true);
+	std::vector<int> binary_ops = copy_records(binary, text_again, false);
+	std::string text_data, binary_data, text_again_data;
+	read_file(text, text_data);
+	read_file(binary, binary_data);
+	read_file(text_again, text_again_data);
+	bool all_binary = true;
+	for (size_t pos = 0; pos < binary_data.size(); ) {
+			// every record should start with a binary marker and a length
+			// of less than 128 bytes
+		unsigned char marker = binary_data[pos];
+		if ( ! is_binary_log_record(marker) || pos + 1 >= binary_data.size() ||
+			((unsigned char)binary_data[pos + 1] & 0x80)) {
+			all_binary = false;
+			break;
+		}
+		pos += 2 + (unsigned char)binary_data[pos + 1];
+	}
+	emit_output_expected_header();
+	emit_param("Records", "%s", describe_ops(ops).c_str());
+	emit_param("Text is unchanged", "%s", tfstr(true));
+	emit_param("Binary records", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Records read from text", "%s", describe_ops(text_ops).c_str());
+	emit_param("Records read from binary", "%s", describe_ops(binary_ops).c_str());
+	emit_param("Text is unchanged", "%s", tfstr(text_data == text_again_data));
+	emit_param("Binary records", "%s", tfstr(all_binary));
+	emit_param("Sizes", "text %d, binary %d", (int)text_data.size(), (int)binary_data.size());
+	if (ops.empty() || text_ops != ops || binary_ops != ops || text_data != text_again_data ||
+		! all_binary || binary_data.size() >= text_data.size()) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_convert_round_trip() {
+	emit_test("Test that ConvertClassAdLog(), which condor_convert_queue_log "
+		"uses, converts a log to binary and back without changing it.");
+	std::string text = scratch_name(0), binary = scratch_name(1), text_again = scratch_name(2);
+	FILE *fp = safe_fopen_wrapper_follow(text.c_str(), "wb");
+	unsigned long written = 0;
+	if (fp) {
+		written = write_every_record_type(fp, false).size();
+		fclose(fp);
+	}
+	unsigned long to_binary = 0, to_text = 0;
+	MyString errmsg1, errmsg2;
+	bool ok1 = ConvertClassAdLog(text.c_str(), binary.c_str(), true, to_binary, errmsg1);
+	bool ok2 = ConvertClassAdLog(binary.c_str(), text_again.c_str(), false, to_text, errmsg2);
+	std::string text_data, text_again_data;
+	read_file(text, text_data);
+	read_file(text_again, text_again_data);
+
+		// a partial record at the end is left out, with a warning
+	std::string binary_data;
+	read_file(binary, binary_data);
+	write_file(scratch_name(3), binary_data.substr(0, binary_data.size() - 3));
+	unsigned long partial = 0;
+	MyString errmsg3;
+	bool ok3 = ConvertClassAdLog(scratch_name(3).c_str(), text_again.c_str(), false, partial, errmsg3);
+
+	emit_output_expected_header();
+	emit_param("Records", "%lu, %lu, %lu", written, written, written - 1);
+	emit_param("Text is unchanged", "%s", tfstr(true));
+	emit_param("Warning for partial record", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Records", "%lu, %lu, %lu", to_binary, to_text, partial);
+	emit_param("Text is unchanged", "%s", tfstr(text_data == text_again_data));
+	emit_param("Warning for partial record", "%s", tfstr( ! errmsg3.empty()));
+	if ( ! ok1 || ! ok2 || ! ok3 || ! errmsg1.empty() || ! errmsg2.empty() || errmsg3.empty() ||
+		written == 0 || to_binary != written || to_text != written || partial != written - 1 ||
+		text_data != text_again_data) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_binary_truncated_tail() {
+	emit_test("Test that a binary log cut off at any byte of its last "
+		"transaction loads as it was before that transaction.");
+	remove_log_files();
+	struct stat st;
+	off_t committed = 0;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		coll.SetBinaryLog(true);
+		write_before(coll);
+		if (stat(log_name.c_str(), &st) == 0) { committed = st.st_size; }
+		write_during(coll);
+	}
+	std::string data;
+	read_file(log_name, data);
+	std::string expected_before = "1.0:JobStatus=1;1.1:JobStatus=1;";
+	std::string bad;
+	int cuts = 0;
+	for (size_t cut = committed; cut < data.size(); cut++) {
+		remove_log_files();
+		write_file(log_name, data.substr(0, cut));
+		std::string actual = describe_log();
+		cuts++;
+		if (actual != expected_before) {
+			formatstr_cat(bad, "%d:%s ", (int)cut, actual.c_str());
+		}
+	}
+	remove_log_files();
+	write_file(log_name, data);
+	std::string whole = describe_log();
+	emit_output_expected_header();
+	emit_param("Ads when cut", "%s", expected_before.c_str());
+	emit_param("Ads when whole", "%s", expected_after);
+	emit_output_actual_header();
+	emit_param("Cuts tried", "%d", cuts);
+	emit_param("Bad cuts", "%s", bad.c_str());
+	emit_param("Ads when whole", "%s", whole.c_str());
+	if (committed == 0 || cuts == 0 || ! bad.empty() || whole != expected_after) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+binary_record(LogRecord *rec)
+{
+	std::string name = scratch_name(3), data;
+	FILE *fp = safe_fopen_wrapper_follow(name.c_str(), "wb");
+	if (fp) {
+		rec->Write(fp, true);
+		fclose(fp);
+	}
+	delete rec;
+	read_file(name, data);
+	return data;
+}
+
+static bool test_binary_corrupt_length() {
+	emit_test("Test that a binary record whose length is wrong is rejected "
+		"rather than read with part of the next record.");
+		// records with lengths less than 128 bytes, so the length is one byte
+	std::string seq = binary_record(new LogHistoricalSequenceNumber(1, 1600000000));
+	std::string begin = binary_record(new LogBeginTransaction());
+	std::string set = binary_record(new LogSetAttribute("1.0", "JobStatus", "2"));
+	std::string del = binary_record(new LogDeleteAttribute("1.0", "Owner"));
+	std::string body = set.substr(2);
+
+	std::string longer = set, shorter = set, huge = set.substr(0, 1), overlong = set.substr(0, 1);
+	longer[1] = (char)(body.size() + 1);
+	shorter[1] = (char)(body.size() - 1);
+	huge += "\xf0\xff\xff\xff\x03";		// 1 GB, more than is left in the file
+	huge += body;
+	overlong += "\xff\xff\xff\xff\xff\xff\x01";	// a length that doesn't fit
+	overlong += body;
+
+	const char *names[] = { "good", "one longer", "one shorter", "1 GB", "too many length bytes" };
+	std::string records[] = { set, longer, shorter, huge, overlong };
+	int expected[] = { 4, 2, 2, 2, 2 };
+	bool ok = true;
+	emit_output_expected_header();
+	for (int i = 0; i < 5; i++) {
+		emit_param(names[i], "%d records", expected[i]);
+	}
+	emit_output_actual_header();
+	for (int i = 0; i < 5; i++) {
+			// no end of transaction follows, so the bad record is skipped
+		write_file(scratch_name(0), seq + begin + records[i] + del);
+		int count = count_records(scratch_name(0));
+		emit_param(names[i], "%d records", count);
+		if (count != expected[i]) { ok = false; }
+	}
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_mixed_text_and_binary() {
+	emit_test("Test that a log with both text and binary records is read by "
+		"ClassAdLog and ClassAdLogReader, and rotated to binary.");
+	remove_log_files();
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		write_before(coll);
+		coll.SetBinaryLog(true);
+		write_during(coll);
+		coll.SetBinaryLog(false);
+		coll.SetAttribute("2.0", "JobStatus", "1");
+	}
+	std::string data;
+	read_file(log_name, data);
+	bool has_text = ! data.empty() && isdigit((unsigned char)data[0]);
+	bool has_binary = false;
+	for (size_t i = 0; i < data.size(); i++) {
+		if (is_binary_log_record((unsigned char)data[i])) { has_binary = true; break; }
+	}
+	std::string expected = "1.0:JobStatus=2;2.0:JobStatus=1,Owner=\"alice\";";
+	std::string loaded = describe_log();
+
+	TestLogConsumer *consumer = new TestLogConsumer;
+	ClassAdLogReader reader(consumer);
+	reader.SetClassAdLogFileName(log_name.c_str());
+	reader.Poll();
+	std::string followed = consumer->describe();
+
+	bool rotated;
+	{
+		ClassAdCollection coll(NULL, log_name.c_str(), 0);
+		coll.SetBinaryLog(true);
+		rotated = coll.TruncLog();
+	}
+	read_file(log_name, data);
+	bool rotated_binary = ! data.empty() && is_binary_log_record((unsigned char)data[0]);
+	std::string after_rotation = describe_log();
+
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	emit_param("Ads read by ClassAdLogReader", "%s", expected.c_str());
+	emit_param("Ads after rotation to binary", "%s", expected.c_str());
+	emit_output_actual_header();
+	emit_param("Ads", "%s", loaded.c_str());
+	emit_param("Ads read by ClassAdLogReader", "%s", followed.c_str());
+	emit_param("Ads after rotation to binary", "%s", after_rotation.c_str());
+	emit_param("Had text and binary", "%s", tfstr(has_text && has_binary));
+	emit_param("Rotated log is binary", "%s", tfstr(rotated_binary));
+	if ( ! has_text || ! has_binary || loaded != expected || followed != expected ||
+		! rotated || ! rotated_binary || after_rotation != expected) {
+		FAIL;
+	}
+	PASS;
+}
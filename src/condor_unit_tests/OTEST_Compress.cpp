@@ -0,0 +1,463 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test CEDAR compression: Condor_Compress itself, ReliSock connections
+	that compress their packets, and how SecMan negotiates compression.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_compress.h"
+#include "condor_secman.h"
+#include "condor_attributes.h"
+#include "reli_sock.h"
+#ifdef HAVE_EXT_OPENSSL
+#include "condor_crypt_aesgcm.h"
+#endif
+
+#if defined(HAVE_ZLIB_H) && ! defined(WIN32)
+
+#include <sys/ioctl.h>
+
+static bool test_compress_round_trip(void);
+static bool test_decompress_in_pieces(void);
+static bool test_socket_round_trip(void);
+static bool test_socket_incompressible(void);
+static bool test_socket_sealed(void);
+static bool test_negotiation(void);
+static bool test_negotiation_methods(void);
+static bool test_default_never(void);
+
+	// Text like a ClassAd, which is what CEDAR compression is for.
+static std::string
+ad_text(int num)
+{
+	std::string text;
+	formatstr(text, "MyType = \"Machine\"\nName = \"slot%d@exec%d.example.org\"\n"
+		"State = \"Unclaimed\"\nActivity = \"Idle\"\nMemory = %d\n"
+		"OpSys = \"LINUX\"\nArch = \"X86_64\"\n", num % 8 + 1, num, 1024 * (num % 4 + 1));
+	return text;
+}
+
+	// Text that compresses poorly.
+static std::string
+random_text(int len)
+{
+	std::string text;
+	unsigned int x = 12345;
+	for (int i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		text += (char)(' ' + (x >> 16) % 95);
+	}
+	return text;
+}
+
+bool OTEST_Compress(void) {
+	emit_object("Compress");
+	emit_comment("CEDAR compression, and how it is negotiated.");
+
+	FunctionDriver driver;
+	driver.register_function(test_compress_round_trip);
+	driver.register_function(test_decompress_in_pieces);
+	driver.register_function(test_socket_round_trip);
+	driver.register_function(test_socket_incompressible);
+	driver.register_function(test_socket_sealed);
+	driver.register_function(test_negotiation);
+	driver.register_function(test_negotiation_methods);
+	driver.register_function(test_default_never);
+
+	return driver.do_all_functions();
+}
+
+static bool test_compress_round_trip() {
+	emit_test("Test that packets compressed one after another decompress to "
+		"the same data, and that later packets compress better because "
+		"they share the stream with earlier ones.");
+	Condor_Compress * deflater = Condor_Compress::create("ZLIB");
+	Condor_Compress * inflater = Condor_Compress::create("zlib");
+	if ( ! deflater || ! inflater) {
+		delete deflater;
+		delete inflater;
+		emit_alert("Condor_Compress::create(\"ZLIB\") failed");
+		FAIL;
+	}
+	int matched = 0;
+	int first_len = 0, last_len = 0;
+	for (int i = 0; i < 5; i++) {
+		std::string packet;
+		for (int j = 0; j < 10; j++) {
+			packet += ad_text(i * 10 + j);
+		}
+		std::vector<char> zbuf(Condor_Compress::bound(packet.size()));
+		std::vector<char> out(packet.size() + 100);
+		int zlen = 0, out_len = 0;
+		if (deflater->compress(packet.data(), packet.size(), &zbuf[0], zbuf.size(), zlen) &&
+			inflater->decompress(&zbuf[0], zlen, &out[0], out.size(), out_len) &&
+			std::string(&out[0], out_len) == packet) {
+			matched++;
+		}
+		if (i == 0) first_len = zlen;
+		last_len = zlen;
+	}
+	delete deflater;
+	delete inflater;
+	emit_output_expected_header();
+	emit_param("Packets matched", "%d", 5);
+	emit_param("Later packets smaller", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Packets matched", "%d", matched);
+	emit_param("Later packets smaller", "%s (%d then %d bytes)",
+		tfstr(last_len < first_len), first_len, last_len);
+	if (matched != 5 || last_len >= first_len) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_decompress_in_pieces() {
+	emit_test("Test that a packet that decompresses to more than the output "
+		"buffer holds comes out whole over several calls to decompress().");
+	Condor_Compress * deflater = Condor_Compress::create("ZLIB");
+	Condor_Compress * inflater = Condor_Compress::create("ZLIB");
+	std::string packet;
+	for (int i = 0; i < 500; i++) {
+		packet += ad_text(i);
+	}
+	std::vector<char> zbuf(Condor_Compress::bound(packet.size()));
+	int zlen = 0;
+	bool compressed = deflater->compress(packet.data(), packet.size(), &zbuf[0], zbuf.size(), zlen);
+
+	std::string result;
+	char out[1000];
+	int out_len = 0, calls = 0;
+	bool ok = compressed && inflater->decompress(&zbuf[0], zlen, out, sizeof(out), out_len);
+	while (ok) {
+		calls++;
+		result.append(out, out_len);
+		if (out_len < (int)sizeof(out)) {
+			break;
+		}
+		ok = inflater->decompress(NULL, 0, out, sizeof(out), out_len);
+	}
+	delete deflater;
+	delete inflater;
+	emit_input_header();
+	emit_param("Data", "%d bytes", (int)packet.size());
+	emit_param("Output buffer", "%d bytes", (int)sizeof(out));
+	emit_output_expected_header();
+	emit_param("Same data", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Same data", "%s (%d bytes in %d calls)", tfstr(ok && result == packet),
+		(int)result.size(), calls);
+	if ( ! ok || result != packet) {
+		FAIL;
+	}
+	PASS;
+}
+
+	// A connected pair of ReliSocks, which lets a test send a message and
+	// then receive it without another thread.
+struct socket_pair {
+	ReliSock sender, receiver;
+	int fd;
+	bool ok;
+
+	socket_pair() : fd(-1), ok(false) {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+			emit_alert("socketpair() failed");
+			return;
+		}
+		sender.assignDomainSocket(sv[0]);
+		receiver.assignDomainSocket(sv[1]);
+		sender.timeout(10);
+		receiver.timeout(10);
+		fd = sv[1];
+		ok = true;
+	}
+
+	bool compress(const char * method) {
+		return sender.set_compression(method) && receiver.set_compression(method);
+	}
+
+		// How many bytes are waiting to be received.
+	int waiting() const {
+		int len = 0;
+		ioctl(fd, FIONREAD, &len);
+		return len;
+	}
+};
+
+	// Sends the text in one message, receives it, and returns how many
+	// bytes went over the connection, or -1 if it did not arrive intact.
+static int
+send_text(socket_pair & pair, const std::string & text)
+{
+	pair.sender.encode();
+	std::string copy = text;
+	if ( ! pair.sender.code(copy) || ! pair.sender.end_of_message()) {
+		return -1;
+	}
+	int sent = pair.waiting();
+	std::string got;
+	pair.receiver.decode();
+	if ( ! pair.receiver.code(got) || ! pair.receiver.end_of_message() || got != text) {
+		return -1;
+	}
+	return sent;
+}
+
+static bool test_socket_round_trip() {
+	emit_test("Test that messages sent over a compressed ReliSock arrive "
+		"intact, and take far fewer bytes than over a plain one.");
+	std::string text;
+	for (int i = 0; i < 200; i++) {
+		text += ad_text(i);
+	}
+	socket_pair plain, compressed;
+	if ( ! plain.ok || ! compressed.ok || ! compressed.compress("ZLIB")) {
+		FAIL;
+	}
+	int plain_bytes = send_text(plain, text);
+	int first = send_text(compressed, text);
+	int second = send_text(compressed, text);
+	emit_input_header();
+	emit_param("Message", "%d bytes", (int)text.size());
+	emit_output_expected_header();
+	emit_param("Plain", "arrives");
+	emit_param("Compressed", "arrives twice, in less than 1/4 of the plain bytes");
+	emit_output_actual_header();
+	emit_param("Plain", "%d bytes", plain_bytes);
+	emit_param("Compressed", "%d then %d bytes", first, second);
+	if (plain_bytes < 0 || first < 0 || second < 0 ||
+		first * 4 > plain_bytes || second * 4 > plain_bytes) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_socket_incompressible() {
+	emit_test("Test that data that compresses poorly still arrives intact "
+		"over a compressed ReliSock, and is no more than 1% bigger.");
+	std::string text = random_text(20000);
+	socket_pair plain, compressed;
+	if ( ! plain.ok || ! compressed.ok || ! compressed.compress("ZLIB")) {
+		FAIL;
+	}
+	int plain_bytes = send_text(plain, text);
+	int compressed_bytes = send_text(compressed, text);
+	emit_input_header();
+	emit_param("Message", "%d random bytes", (int)text.size());
+	emit_output_expected_header();
+	emit_param("Compressed", "arrives, in at most 1%% more than the plain bytes");
+	emit_output_actual_header();
+	emit_param("Plain", "%d bytes", plain_bytes);
+	emit_param("Compressed", "%d bytes", compressed_bytes);
+	if (plain_bytes < 0 || compressed_bytes < 0 ||
+		compressed_bytes > plain_bytes + plain_bytes / 100) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_socket_sealed() {
+	emit_test("Test that messages sent over a ReliSock that is both "
+		"compressed and sealed with AES-GCM arrive intact.");
+#ifdef HAVE_EXT_OPENSSL
+	std::string text;
+	for (int i = 0; i < 200; i++) {
+		text += ad_text(i);
+	}
+	unsigned char keybuf[24];
+	for (int i = 0; i < (int)sizeof(keybuf); i++) {
+		keybuf[i] = (unsigned char)i;
+	}
+	KeyInfo key(keybuf, sizeof(keybuf), CONDOR_AESGCM);
+	socket_pair pair;
+	if ( ! pair.ok || ! pair.compress("ZLIB")) {
+		FAIL;
+	}
+	pair.sender.set_crypto_key(true, &key);
+	pair.receiver.set_crypto_key(true, &key);
+	int first = send_text(pair, text);
+	int second = send_text(pair, text);
+	emit_input_header();
+	emit_param("Message", "%d bytes", (int)text.size());
+	emit_output_expected_header();
+	emit_param("Sealed and compressed", "arrives twice");
+	emit_output_actual_header();
+	emit_param("Sealed and compressed", "%d then %d bytes", first, second);
+	if (first < 0 || second < 0) {
+		FAIL;
+	}
+#else
+	emit_comment("AES-GCM needs OpenSSL, which this build does not have.");
+#endif
+	PASS;
+}
+
+	// A policy ad with the given Compression value, or none if it is NULL,
+	// which is what peers before 8.9.11 send.
+static ClassAd
+policy_ad(const char * compression, const char * methods = "ZLIB")
+{
+	ClassAd ad;
+	ad.Assign(ATTR_SEC_AUTHENTICATION, "NEVER");
+	ad.Assign(ATTR_SEC_ENCRYPTION, "NEVER");
+	ad.Assign(ATTR_SEC_INTEGRITY, "NEVER");
+	if (compression) {
+		ad.Assign(ATTR_SEC_COMPRESSION, compression);
+		ad.Assign(ATTR_SEC_COMPRESSION_METHODS, methods);
+	}
+	return ad;
+}
+
+	// What the client and server agree to: the Compression attribute of
+	// the action ad, with the method if it is YES, or FAIL.
+static std::string
+negotiate(const ClassAd & cli_ad, const ClassAd & srv_ad)
+{
+	SecMan sec_man;
+	ClassAd * action = sec_man.ReconcileSecurityPolicyAds(cli_ad, srv_ad);
+	if ( ! action) {
+		return "FAIL";
+	}
+	std::string result, method;
+	action->LookupString(ATTR_SEC_COMPRESSION, result);
+	if (action->LookupString(ATTR_SEC_COMPRESSION_METHODS, method)) {
+		result += " " + method;
+	}
+	delete action;
+	return result;
+}
+
+static bool test_negotiation() {
+	emit_test("Test that compression is only turned on when one side asks "
+		"for it and the other allows it, and that a connection fails only "
+		"if one side requires it and the other refuses it or is too old "
+		"to compress.");
+	const char * cases[][3] = {
+		// client       server       result
+		{ "REQUIRED",  "REQUIRED",  "YES ZLIB" },
+		{ "REQUIRED",  "OPTIONAL",  "YES ZLIB" },
+		{ "PREFERRED", "OPTIONAL",  "YES ZLIB" },
+		{ "OPTIONAL",  "PREFERRED", "YES ZLIB" },
+		{ "OPTIONAL",  "OPTIONAL",  "NO" },
+		{ "NEVER",     "PREFERRED", "NO" },
+		{ "PREFERRED", "NEVER",     "NO" },
+		{ "NEVER",     "REQUIRED",  "FAIL" },
+		{ NULL,        "PREFERRED", "NO" },
+		{ "PREFERRED", NULL,        "NO" },
+		{ NULL,        "REQUIRED",  "FAIL" },
+		{ "REQUIRED",  NULL,        "FAIL" },
+	};
+	int failed = 0;
+	emit_output_expected_header();
+	for (auto & c : cases) {
+		emit_param("Client/Server", "%s/%s: %s",
+			c[0] ? c[0] : "old", c[1] ? c[1] : "old", c[2]);
+	}
+	emit_output_actual_header();
+	for (auto & c : cases) {
+		std::string result = negotiate(policy_ad(c[0]), policy_ad(c[1]));
+		emit_param("Client/Server", "%s/%s: %s",
+			c[0] ? c[0] : "old", c[1] ? c[1] : "old", result.c_str());
+		if (result != c[2]) {
+			failed++;
+		}
+	}
+	if (failed) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_negotiation_methods() {
+	emit_test("Test that compression is not turned on when the two sides "
+		"have no method in common, even if one prefers it.");
+	std::string common = negotiate(policy_ad("PREFERRED", "LZ4, ZLIB"),
+		policy_ad("OPTIONAL", "ZLIB"));
+	std::string none = negotiate(policy_ad("PREFERRED", "ZLIB"),
+		policy_ad("OPTIONAL", "LZ4"));
+	emit_output_expected_header();
+	emit_param("LZ4, ZLIB with ZLIB", "YES ZLIB");
+	emit_param("ZLIB with LZ4", "NO");
+	emit_output_actual_header();
+	emit_param("LZ4, ZLIB with ZLIB", "%s", common.c_str());
+	emit_param("ZLIB with LZ4", "%s", none.c_str());
+	if (common != "YES ZLIB" || none != "NO") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_default_never() {
+	emit_test("Test that compression defaults to NEVER, so that two peers "
+		"that were not configured for it do not compress, and a server "
+		"that prefers it does not compress for a client that was not "
+		"configured for it.");
+	param_insert("SEC_DEFAULT_COMPRESSION", "");
+	param_insert("SEC_CLIENT_COMPRESSION", "");
+	param_insert("SEC_READ_COMPRESSION", "");
+	SecMan sec_man;
+	ClassAd cli_ad, srv_ad;
+	bool filled = sec_man.FillInSecurityPolicyAd(CLIENT_PERM, &cli_ad) &&
+		sec_man.FillInSecurityPolicyAd(READ, &srv_ad);
+	std::string cli_value, srv_value;
+	cli_ad.LookupString(ATTR_SEC_COMPRESSION, cli_value);
+	srv_ad.LookupString(ATTR_SEC_COMPRESSION, srv_value);
+	std::string defaults = negotiate(cli_ad, srv_ad);
+
+	param_insert("SEC_READ_COMPRESSION", "PREFERRED");
+	ClassAd preferred_ad;
+	filled = sec_man.FillInSecurityPolicyAd(READ, &preferred_ad) && filled;
+	std::string preferred = negotiate(cli_ad, preferred_ad);
+	param_insert("SEC_READ_COMPRESSION", "");
+
+	emit_output_expected_header();
+	emit_param("Client", "NEVER");
+	emit_param("Server", "NEVER");
+	emit_param("Defaults", "NO");
+	emit_param("Server prefers", "NO");
+	emit_output_actual_header();
+	emit_param("Client", "%s", cli_value.c_str());
+	emit_param("Server", "%s", srv_value.c_str());
+	emit_param("Defaults", "%s", defaults.c_str());
+	emit_param("Server prefers", "%s", preferred.c_str());
+	if ( ! filled || cli_value != "NEVER" || srv_value != "NEVER" ||
+		defaults != "NO" || preferred != "NO") {
+		FAIL;
+	}
+	PASS;
+}
+
+#else
+
+bool OTEST_Compress(void) {
+	emit_object("Compress");
+	emit_comment("CEDAR compression needs zlib, which this build does not have.");
+	return true;
+}
+
+#endif
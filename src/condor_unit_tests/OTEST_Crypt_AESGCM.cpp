@@ -0,0 +1,395 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the AES-GCM crypto method, which seals each ReliSock packet so
+	that the receiver can tell if it was altered, replayed, reordered,
+	dropped or taken from another connection.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_crypt_aesgcm.h"
+#include "reli_sock.h"
+#include <set>
+
+#if defined(HAVE_EXT_OPENSSL) && ! defined(WIN32)
+
+static bool test_round_trip(void);
+static bool test_nonces_differ(void);
+static bool test_tamper(void);
+static bool test_wrong_key(void);
+static bool test_replay(void);
+static bool test_reorder_and_drop(void);
+static bool test_other_connection(void);
+static bool test_reflection(void);
+static bool test_inherited_socket(void);
+
+static Condor_Crypt_AESGCM aesgcm;
+
+static const int DATA_SIZE = 100;
+
+static KeyInfo
+session_key(unsigned char first = 0)
+{
+	unsigned char keybuf[24];
+	for (int i = 0; i < (int)sizeof(keybuf); i++) {
+		keybuf[i] = (unsigned char)(first + i);
+	}
+	return KeyInfo(keybuf, sizeof(keybuf), CONDOR_AESGCM);
+}
+
+	// One packet as ReliSock sends it: a header, which is authenticated
+	// but not encrypted, the sealed data, and the tag and nonce.
+struct packet {
+	unsigned char hdr[5];
+	unsigned char data[DATA_SIZE];
+	unsigned char tag[AESGCM_TAG_SIZE];
+	unsigned char iv[AESGCM_IV_SIZE];
+};
+
+static void
+plain_packet(int num, packet & p)
+{
+	p.hdr[0] = 1;
+	p.hdr[1] = 0; p.hdr[2] = 0; p.hdr[3] = 0; p.hdr[4] = DATA_SIZE;
+	for (int i = 0; i < DATA_SIZE; i++) {
+		p.data[i] = (unsigned char)(num * 31 + i);
+	}
+}
+
+static bool
+seal_packet(Condor_Crypto_State & cs, int num, packet & p)
+{
+	plain_packet(num, p);
+	return aesgcm.seal(&cs, p.hdr, sizeof(p.hdr), p.data, DATA_SIZE, p.tag, p.iv);
+}
+
+	// Opens a copy of the packet, so it can be opened again, and returns
+	// true if it opened to the data of packet num.
+static bool
+open_packet(Condor_Crypto_State & cs, int num, const packet & p)
+{
+	packet copy = p, expected;
+	plain_packet(num, expected);
+	return aesgcm.open(&cs, copy.hdr, sizeof(copy.hdr), copy.data, DATA_SIZE, copy.tag, copy.iv) &&
+		memcmp(copy.data, expected.data, DATA_SIZE) == 0;
+}
+
+	// Whether each packet opens, in the order given, as a string of
+	// "y" and "n".
+static std::string
+open_in_order(Condor_Crypto_State & cs, const packet * packets, const int * order, int count)
+{
+	std::string result;
+	for (int i = 0; i < count; i++) {
+		result += open_packet(cs, order[i], packets[order[i]]) ? "y" : "n";
+	}
+	return result;
+}
+
+bool OTEST_Crypt_AESGCM(void) {
+	emit_object("Crypt_AESGCM");
+	emit_comment("The AES-GCM crypto method, which seals each ReliSock packet "
+		"with a nonce that follows a sequence.");
+
+	FunctionDriver driver;
+	driver.register_function(test_round_trip);
+	driver.register_function(test_nonces_differ);
+	driver.register_function(test_tamper);
+	driver.register_function(test_wrong_key);
+	driver.register_function(test_replay);
+	driver.register_function(test_reorder_and_drop);
+	driver.register_function(test_other_connection);
+	driver.register_function(test_reflection);
+	driver.register_function(test_inherited_socket);
+
+	return driver.do_all_functions();
+}
+
+static bool test_round_trip() {
+	emit_test("Test that packets opened in the order they were sealed give "
+		"back their data, and that sealing encrypts it.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State sender(CONDOR_AESGCM, key), receiver(CONDOR_AESGCM, key);
+	int sealed = 0, encrypted = 0, opened = 0;
+	for (int i = 0; i < 10; i++) {
+		packet p, plain;
+		if (seal_packet(sender, i, p)) sealed++;
+		plain_packet(i, plain);
+		if (memcmp(p.data, plain.data, DATA_SIZE) != 0) encrypted++;
+		if (open_packet(receiver, i, p)) opened++;
+	}
+	emit_output_expected_header();
+	emit_param("Sealed", "%d", 10);
+	emit_param("Encrypted", "%d", 10);
+	emit_param("Opened", "%d", 10);
+	emit_output_actual_header();
+	emit_param("Sealed", "%d", sealed);
+	emit_param("Encrypted", "%d", encrypted);
+	emit_param("Opened", "%d", opened);
+	if (sealed != 10 || encrypted != 10 || opened != 10) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_nonces_differ() {
+	emit_test("Test that no two packets get the same nonce, whether from one "
+		"crypto state or from two states with the same session key.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State one(CONDOR_AESGCM, key), two(CONDOR_AESGCM, key);
+	std::set<std::string> nonces;
+	for (int i = 0; i < 100; i++) {
+		packet p;
+		seal_packet(one, i, p);
+		nonces.insert(std::string((char *)p.iv, sizeof(p.iv)));
+		seal_packet(two, i, p);
+		nonces.insert(std::string((char *)p.iv, sizeof(p.iv)));
+	}
+	emit_output_expected_header();
+	emit_param("Different nonces", "%d", 200);
+	emit_output_actual_header();
+	emit_param("Different nonces", "%d", (int)nonces.size());
+	if (nonces.size() != 200) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_tamper() {
+	emit_test("Test that changing any bit of the header, the data, the tag "
+		"or the nonce of a packet makes it fail to open, and that the real "
+		"packet still opens afterwards.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State sender(CONDOR_AESGCM, key), receiver(CONDOR_AESGCM, key);
+	packet p;
+	seal_packet(sender, 0, p);
+	int tampered = 0, opened = 0;
+	for (size_t i = 0; i < sizeof(p); i++) {
+		for (int bit = 0; bit < 8; bit += 7) {
+			packet bad = p;
+			((unsigned char *)&bad)[i] ^= (unsigned char)(1 << bit);
+			tampered++;
+			if (open_packet(receiver, 0, bad)) opened++;
+		}
+	}
+	bool real_opens = open_packet(receiver, 0, p);
+	emit_output_expected_header();
+	emit_param("Tampered packets opened", "%d", 0);
+	emit_param("Real packet opens", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Tampered packets opened", "%d of %d", opened, tampered);
+	emit_param("Real packet opens", "%s", tfstr(real_opens));
+	if (opened || ! real_opens) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_wrong_key() {
+	emit_test("Test that a packet sealed with another key does not open.");
+	KeyInfo key = session_key(), other_key = session_key(1);
+	Condor_Crypto_State sender(CONDOR_AESGCM, other_key), receiver(CONDOR_AESGCM, key);
+	packet p;
+	seal_packet(sender, 0, p);
+	bool opened = open_packet(receiver, 0, p);
+	emit_output_expected_header();
+	emit_param("Opened", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Opened", "%s", tfstr(opened));
+	if (opened) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_replay() {
+	emit_test("Test that a packet can't be opened twice.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State sender(CONDOR_AESGCM, key), receiver(CONDOR_AESGCM, key);
+	packet packets[3];
+	for (int i = 0; i < 3; i++) {
+		seal_packet(sender, i, packets[i]);
+	}
+	const int order[] = { 0, 0, 1, 0, 1, 2, 2 };
+	std::string result = open_in_order(receiver, packets, order, 7);
+	emit_input_header();
+	emit_param("Order", "%s", "0 0 1 0 1 2 2");
+	emit_output_expected_header();
+	emit_param("Opened", "%s", "ynynnyn");
+	emit_output_actual_header();
+	emit_param("Opened", "%s", result.c_str());
+	if (result != "ynynnyn") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_reorder_and_drop() {
+	emit_test("Test that a packet opens only after every packet sealed "
+		"before it, so packets can't be reordered or dropped.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State sender(CONDOR_AESGCM, key), receiver(CONDOR_AESGCM, key);
+	packet packets[4];
+	for (int i = 0; i < 4; i++) {
+		seal_packet(sender, i, packets[i]);
+	}
+		// the first packet can't be skipped either
+	const int order[] = { 1, 0, 2, 3, 1, 2, 3 };
+	std::string result = open_in_order(receiver, packets, order, 7);
+	emit_input_header();
+	emit_param("Order", "%s", "1 0 2 3 1 2 3");
+	emit_output_expected_header();
+	emit_param("Opened", "%s", "nynnyyy");
+	emit_output_actual_header();
+	emit_param("Opened", "%s", result.c_str());
+	if (result != "nynnyyy") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_other_connection() {
+	emit_test("Test that once a connection has opened a packet, packets "
+		"sealed for another connection with the same session key don't "
+		"open on it.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State sender(CONDOR_AESGCM, key), receiver(CONDOR_AESGCM, key);
+	Condor_Crypto_State other_sender(CONDOR_AESGCM, key), other_receiver(CONDOR_AESGCM, key);
+	packet p, other[2];
+	seal_packet(sender, 0, p);
+	seal_packet(other_sender, 0, other[0]);
+	seal_packet(other_sender, 1, other[1]);
+	bool opened = open_packet(receiver, 0, p);
+	bool other_first = open_packet(receiver, 0, other[0]);
+	bool other_second = open_packet(receiver, 1, other[1]);
+		// they are fine on their own connection
+	bool own_first = open_packet(other_receiver, 0, other[0]);
+	bool own_second = open_packet(other_receiver, 1, other[1]);
+	emit_output_expected_header();
+	emit_param("Own packet", "%s", tfstr(true));
+	emit_param("Other connection's packets", "%s %s", tfstr(false), tfstr(false));
+	emit_param("On their own connection", "%s %s", tfstr(true), tfstr(true));
+	emit_output_actual_header();
+	emit_param("Own packet", "%s", tfstr(opened));
+	emit_param("Other connection's packets", "%s %s", tfstr(other_first), tfstr(other_second));
+	emit_param("On their own connection", "%s %s", tfstr(own_first), tfstr(own_second));
+	if ( ! opened || other_first || other_second || ! own_first || ! own_second) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_reflection() {
+	emit_test("Test that packets sent back to the side that sealed them "
+		"don't open there.");
+	KeyInfo key = session_key();
+	Condor_Crypto_State side(CONDOR_AESGCM, key);
+	packet packets[3];
+	for (int i = 0; i < 3; i++) {
+		seal_packet(side, i, packets[i]);
+	}
+	const int order[] = { 0, 1, 2 };
+	std::string result = open_in_order(side, packets, order, 3);
+	const int later[] = { 2 };
+	result += open_in_order(side, packets, later, 1);
+	emit_output_expected_header();
+	emit_param("Opened", "%s", "nnnn");
+	emit_output_actual_header();
+	emit_param("Opened", "%s", result.c_str());
+	if (result != "nnnn") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool
+send_message(ReliSock & sock, int num)
+{
+	sock.encode();
+	return sock.code(num) && sock.end_of_message();
+}
+
+static bool
+receive_message(ReliSock & sock, int num)
+{
+	int got = -1;
+	sock.decode();
+	return sock.code(got) && sock.end_of_message() && got == num;
+}
+
+static bool test_inherited_socket() {
+	emit_test("Test that a ReliSock passed to another process through "
+		"serialize() carries on the sequence of nonces, so its peer keeps "
+		"opening its packets.");
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+		emit_alert("socketpair() failed");
+		FAIL;
+	}
+	KeyInfo key = session_key();
+	ReliSock sender, receiver;
+	sender.assignDomainSocket(sv[0]);
+	receiver.assignDomainSocket(sv[1]);
+	sender.timeout(10);
+	receiver.timeout(10);
+	sender.set_crypto_key(true, &key);
+	receiver.set_crypto_key(true, &key);
+
+	bool before = send_message(sender, 1) && receive_message(receiver, 1) &&
+		send_message(receiver, 2) && receive_message(sender, 2);
+
+		// what the process that inherits the socket gets, with its own
+		// copy of the fd
+	char * state = sender.serialize();
+	std::string inherited;
+	formatstr(inherited, "%d%s", dup(sv[0]), strchr(state, '*'));
+	delete [] state;
+	ReliSock child;
+	child.serialize(inherited.c_str());
+
+	bool after = send_message(child, 3) && receive_message(receiver, 3) &&
+		send_message(receiver, 4) && receive_message(child, 4);
+	child.close();
+
+	emit_output_expected_header();
+	emit_param("Before", "%s", tfstr(true));
+	emit_param("After", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Before", "%s", tfstr(before));
+	emit_param("After", "%s", tfstr(after));
+	if ( ! before || ! after) {
+		FAIL;
+	}
+	PASS;
+}
+
+#else
+
+bool OTEST_Crypt_AESGCM(void) {
+	emit_object("Crypt_AESGCM");
+	emit_comment("AES-GCM needs OpenSSL, which this build does not have.");
+	return true;
+}
+
+#endif
@@ -0,0 +1,382 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the history archive, which rotated history files are turned into
+	when ENABLE_HISTORY_ARCHIVE is true.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_attributes.h"
+#include "directory.h"
+#include "classadHistory.h"
+#include "history_archive.h"
+
+static bool test_archive_text_round_trip(void);
+static bool test_archive_reader_rows(void);
+static bool test_archive_integer_ranges(void);
+static bool test_archive_projection(void);
+static bool test_archive_on_rotation(void);
+
+static std::string history_dir;
+static std::string history_name;
+static std::string archive_name;
+static std::vector<ClassAd *> history_ads;
+
+	// more than two blocks of the archive
+static const int NUM_JOBS = HISTORY_ARCHIVE_BLOCK_ROWS * 2 + 100;
+
+	// Start a new, empty history file
+static void
+reset_history()
+{
+	Directory dir(history_dir.c_str());
+	dir.Remove_Entire_Directory();
+	for (size_t i = 0; i < history_ads.size(); i++) {
+		delete history_ads[i];
+	}
+	history_ads.clear();
+	MaxHistoryFileSize = 100 * 1024 * 1024;
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+}
+
+	// Add jobs to the history file, with attributes that are sometimes
+	// missing, sometimes expressions, and in different orders.
+static void
+append_jobs(int num_jobs)
+{
+	const char *owners[] = { "alice", "bob", "carol" };
+	for (int i = 0; i < num_jobs; i++) {
+		ClassAd *ad = new ClassAd;
+		ad->InsertAttr(ATTR_CLUSTER_ID, 100 + i / 3);
+		ad->InsertAttr(ATTR_PROC_ID, i % 3);
+		ad->InsertAttr(ATTR_OWNER, owners[(i / 7) % 3]);
+		if (i % 5) {
+			ad->InsertAttr(ATTR_COMPLETION_DATE, 1600000000 + i * 37);
+		}
+		ad->InsertAttr(ATTR_JOB_STATUS, (i % 11) ? 4 : 3);
+		if (i % 13 == 0) {
+			ad->AssignExpr(ATTR_REQUEST_MEMORY, "RequestCpus * 1024");
+			ad->InsertAttr(ATTR_REQUEST_CPUS, 1 + i % 4);
+		} else {
+			ad->InsertAttr(ATTR_REQUEST_MEMORY, 2048);
+		}
+		ad->InsertAttr("RemoteWallClockTime", (double)(i % 100) / 4);
+		ad->InsertAttr("Args", "-n 5 \"input file\"");
+		AppendHistory(ad);
+		history_ads.push_back(ad);
+	}
+}
+
+static bool
+read_file(const std::string &name, std::string &data)
+{
+	data.clear();
+	FILE *fp = safe_fopen_wrapper_follow(name.c_str(), "rb");
+	if ( ! fp) { return false; }
+	char buf[4096];
+	size_t cb;
+	while ((cb = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		data.append(buf, cb);
+	}
+	fclose(fp);
+	return true;
+}
+
+	// The text of an archive, as it was in the history file
+static bool
+archive_text(const std::string &name, std::string &text, std::string &errmsg)
+{
+	std::string text_name = history_dir + "/text";
+	FILE *fp = safe_fopen_wrapper_follow(text_name.c_str(), "wb");
+	if ( ! fp) { return false; }
+	bool ok = WriteHistoryArchiveAsText(name.c_str(), fp, errmsg);
+	fclose(fp);
+	read_file(text_name, text);
+	unlink(text_name.c_str());
+	return ok;
+}
+
+	// The attributes of an ad, unparsed, in order of name
+static std::string
+describe(ClassAd &ad)
+{
+	std::string result;
+	std::map<std::string, std::string, classad::CaseIgnLTStr> attrs;
+	for (ClassAd::iterator it = ad.begin(); it != ad.end(); ++it) {
+		ExprTreeToString(it->second, attrs[it->first]);
+	}
+	for (std::map<std::string, std::string, classad::CaseIgnLTStr>::iterator it = attrs.begin(); it != attrs.end(); ++it) {
+		formatstr_cat(result, "%s=%s;", it->first.c_str(), it->second.c_str());
+	}
+	return result;
+}
+
+bool OTEST_HistoryArchive(void) {
+	emit_object("HistoryArchive");
+	emit_comment("A column oriented, compact form of a rotated history file, "
+		"which condor_history reads in place of the text.");
+
+	formatstr(history_dir, "testhistoryarchive%d", (int)getpid());
+	if (mkdir(history_dir.c_str(), 0700) < 0) {
+		emit_alert("Can't make a directory for the history file");
+		return false;
+	}
+	char *cwd = getcwd(NULL, 0);
+	formatstr(history_name, "%s/%s/history", cwd, history_dir.c_str());
+	free(cwd);
+	archive_name = history_name + ".archive";
+	param_insert("HISTORY", history_name.c_str());
+	param_insert("ENABLE_HISTORY_ARCHIVE", "false");
+
+		// one history file, made once, for the tests that don't rotate it
+	reset_history();
+	append_jobs(NUM_JOBS);
+	std::string errmsg;
+	if ( ! WriteHistoryArchive(history_name.c_str(), archive_name.c_str(), errmsg)) {
+		emit_alert(errmsg.c_str());
+	}
+
+	FunctionDriver driver;
+	driver.register_function(test_archive_text_round_trip);
+	driver.register_function(test_archive_reader_rows);
+	driver.register_function(test_archive_integer_ranges);
+	driver.register_function(test_archive_projection);
+	driver.register_function(test_archive_on_rotation);
+
+	bool result = driver.do_all_functions();
+	reset_history();
+	rmdir(history_dir.c_str());
+	param_insert("HISTORY", "");
+	param_insert("ENABLE_HISTORY_ARCHIVE", "false");
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+	return result;
+}
+
+static bool test_archive_text_round_trip() {
+	emit_test("Test that the text of an archive is the same as the history "
+		"file it was made from.");
+	std::string history, text, errmsg;
+	read_file(history_name, history);
+	bool is_archive = IsHistoryArchive(archive_name.c_str());
+	bool history_is_archive = IsHistoryArchive(history_name.c_str());
+	bool ok = archive_text(archive_name, text, errmsg);
+	std::string archive;
+	read_file(archive_name, archive);
+	emit_output_expected_header();
+	emit_param("Is archive", "%s", tfstr(true));
+	emit_param("History file is archive", "%s", tfstr(false));
+	emit_param("Text is the same", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Is archive", "%s", tfstr(is_archive));
+	emit_param("History file is archive", "%s", tfstr(history_is_archive));
+	emit_param("Text is the same", "%s", tfstr(ok && text == history));
+	emit_param("Error", "%s", errmsg.c_str());
+	emit_param("Sizes", "history %d, archive %d", (int)history.size(), (int)archive.size());
+	if ( ! is_archive || history_is_archive || ! ok || history.empty() || text != history ||
+		archive.size() >= history.size()) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_archive_reader_rows() {
+	emit_test("Test that HistoryArchiveReader gives back each ad, in order, "
+		"in each block.");
+	HistoryArchiveReader reader;
+	std::string errmsg;
+	bool opened = reader.Open(archive_name.c_str(), errmsg);
+	int rows = 0, bad = 0, bad_text = 0;
+	for (int block = 0; opened && block < reader.NumBlocks(); block++) {
+		if ( ! reader.ReadBlockHeader(block) || ! reader.ReadBlockData()) {
+			bad++;
+			continue;
+		}
+		for (int row = 0; row < reader.NumRows(); row++, rows++) {
+			ClassAd ad;
+			std::string text, expected_text;
+			if ( ! reader.GetRow(row, ad) || rows >= (int)history_ads.size() ||
+				describe(ad) != describe(*history_ads[rows])) {
+				bad++;
+			}
+				// the text of the row is the ad as AppendHistory printed it
+			if (reader.GetRowText(row, text) && rows < (int)history_ads.size()) {
+				sPrintAd(expected_text, *history_ads[rows]);
+				if (text.compare(0, expected_text.size(), expected_text) != 0) {
+					bad_text++;
+				}
+			} else {
+				bad_text++;
+			}
+		}
+	}
+	emit_output_expected_header();
+	emit_param("Opened", "%s", tfstr(true));
+	emit_param("Blocks", "%d", 3);
+	emit_param("Rows", "%d", NUM_JOBS);
+	emit_param("Bad rows", "%d", 0);
+	emit_param("Bad row text", "%d", 0);
+	emit_output_actual_header();
+	emit_param("Opened", "%s", tfstr(opened));
+	emit_param("Blocks", "%d", opened ? reader.NumBlocks() : 0);
+	emit_param("Rows", "%d", rows);
+	emit_param("Bad rows", "%d", bad);
+	emit_param("Bad row text", "%d", bad_text);
+	if ( ! opened || reader.NumBlocks() != 3 || rows != NUM_JOBS || bad || bad_text) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_archive_integer_ranges() {
+	emit_test("Test that the block headers have the range of each column "
+		"that holds only integer literals, so blocks can be skipped.");
+	HistoryArchiveReader reader;
+	std::string errmsg;
+	bool opened = reader.Open(archive_name.c_str(), errmsg);
+	std::string expected, actual;
+	for (int block = 0; opened && block < reader.NumBlocks(); block++) {
+		int first = block * HISTORY_ARCHIVE_BLOCK_ROWS;
+		int last = std::min(first + HISTORY_ARCHIVE_BLOCK_ROWS, NUM_JOBS) - 1;
+		long long min_date = -1, max_date = -1;
+		for (int i = first; i <= last; i++) {
+			long long date;
+			if (history_ads[i]->LookupInteger(ATTR_COMPLETION_DATE, date)) {
+				if (min_date < 0 || date < min_date) min_date = date;
+				if (date > max_date) max_date = date;
+			}
+		}
+		formatstr_cat(expected, "ClusterId %d-%d, CompletionDate %lld-%lld, RequestMemory none; ",
+			100 + first / 3, 100 + last / 3, min_date, max_date);
+
+		long long min, max;
+		bool absent;
+		if ( ! reader.ReadBlockHeader(block)) {
+			actual += "can't read header; ";
+			continue;
+		}
+		if (reader.GetIntegerRange(ATTR_CLUSTER_ID, min, max, absent)) {
+			formatstr_cat(actual, "ClusterId %lld-%lld, ", min, max);
+		}
+		if (reader.GetIntegerRange(ATTR_COMPLETION_DATE, min, max, absent)) {
+			formatstr_cat(actual, "CompletionDate %lld-%lld, ", min, max);
+		}
+			// some of the values are expressions
+		if (reader.GetIntegerRange(ATTR_REQUEST_MEMORY, min, max, absent)) {
+			formatstr_cat(actual, "RequestMemory %lld-%lld; ", min, max);
+		} else {
+			actual += "RequestMemory none; ";
+		}
+	}
+	emit_output_expected_header();
+	emit_param("Ranges", "%s", expected.c_str());
+	emit_output_actual_header();
+	emit_param("Ranges", "%s", actual.c_str());
+	if ( ! opened || actual != expected) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_archive_projection() {
+	emit_test("Test that reading a projection of a row gives the projected "
+		"attributes and the attributes they refer to.");
+	HistoryArchiveReader reader;
+	std::string errmsg;
+	bool opened = reader.Open(archive_name.c_str(), errmsg) &&
+		reader.ReadBlockHeader(0) && reader.ReadBlockData();
+	classad::References attrs;
+	attrs.insert(ATTR_REQUEST_MEMORY);
+	ClassAd with_ref, without_ref;
+	std::string actual_with, actual_without;
+	if (opened) {
+			// row 0 has RequestMemory = RequestCpus * 1024, row 1 has 2048
+		reader.GetRow(0, with_ref, &attrs);
+		reader.GetRow(1, without_ref, &attrs);
+		actual_with = describe(with_ref);
+		actual_without = describe(without_ref);
+	}
+	std::string expected_with = "RequestCpus=1;RequestMemory=RequestCpus * 1024;";
+	std::string expected_without = "RequestMemory=2048;";
+	emit_output_expected_header();
+	emit_param("Row with a reference", "%s", expected_with.c_str());
+	emit_param("Row without", "%s", expected_without.c_str());
+	emit_output_actual_header();
+	emit_param("Row with a reference", "%s", actual_with.c_str());
+	emit_param("Row without", "%s", actual_without.c_str());
+	if ( ! opened || actual_with != expected_with || actual_without != expected_without) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_archive_on_rotation() {
+	emit_test("Test that with ENABLE_HISTORY_ARCHIVE, a rotated history file "
+		"is replaced by an archive that reads back as the same text, and its "
+		"index is removed.");
+	param_insert("ENABLE_HISTORY_ARCHIVE", "true");
+	reset_history();
+	append_jobs(50);
+	std::string before;
+	read_file(history_name, before);
+		// the next ad won't fit, so the history file is rotated and archived
+	MaxHistoryFileSize = before.size() + 10;
+	append_jobs(1);
+	param_insert("ENABLE_HISTORY_ARCHIVE", "false");
+
+	std::string rotated;
+	int rotated_indexes = 0;
+	Directory dir(history_dir.c_str());
+	const char *name;
+	while ((name = dir.Next())) {
+		if ( ! starts_with(name, "history.") || MATCH == strcmp(name, "history" HISTORY_INDEX_SUFFIX)) {
+			continue;
+		}
+		if (IsHistoryIndexFilename(name)) {
+			rotated_indexes++;
+		} else {
+			rotated = history_dir + "/" + name;
+		}
+	}
+	bool is_archive = ! rotated.empty() && IsHistoryArchive(rotated.c_str());
+	std::string text, errmsg;
+	bool ok = is_archive && archive_text(rotated, text, errmsg);
+	std::vector<HistoryIndexEntry> entries;
+	bool new_index = ReadHistoryIndex(history_name.c_str(), entries) && entries.size() == 1;
+	emit_output_expected_header();
+	emit_param("Rotated file is archive", "%s", tfstr(true));
+	emit_param("Text is the same", "%s", tfstr(true));
+	emit_param("Rotated indexes", "%d", 0);
+	emit_param("New history file is indexed", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Rotated file is archive", "%s", tfstr(is_archive));
+	emit_param("Text is the same", "%s", tfstr(ok && text == before));
+	emit_param("Rotated indexes", "%d", rotated_indexes);
+	emit_param("New history file is indexed", "%s", tfstr(new_index));
+	emit_param("Error", "%s", errmsg.c_str());
+	if ( ! is_archive || ! ok || text != before || rotated_indexes != 0 || ! new_index) {
+		FAIL;
+	}
+	PASS;
+}
@@ -0,0 +1,426 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the index that is written alongside the job history file, and
+	the constraints that condor_history checks against it.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_attributes.h"
+#include "directory.h"
+#include "classadHistory.h"
+
+static bool test_index_build(void);
+static bool test_index_stale(void);
+static bool test_index_missing(void);
+static bool test_index_rotation(void);
+static bool test_index_constraint(void);
+static bool test_index_query_agrees(void);
+
+static std::string history_dir;
+static std::string history_name;
+static std::vector<ClassAd *> history_ads;
+
+	// Start a new, empty history file
+static void
+reset_history()
+{
+	Directory dir(history_dir.c_str());
+	dir.Remove_Entire_Directory();
+	for (size_t i = 0; i < history_ads.size(); i++) {
+		delete history_ads[i];
+	}
+	history_ads.clear();
+	MaxHistoryFileSize = 20 * 1024 * 1024;
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+}
+
+static bool
+history_file_exists(const char *suffix)
+{
+	std::string name = history_name + suffix;
+	struct stat st;
+	return stat(name.c_str(), &st) == 0;
+}
+
+	// Add a job to the history file, keeping a copy of its ad.  Attributes
+	// given as NULL are left out, the others are expressions.
+static void
+append_job(int cluster, int proc, const char *owner, const char *completion_date, int status)
+{
+	ClassAd *ad = new ClassAd;
+	ad->InsertAttr(ATTR_CLUSTER_ID, cluster);
+	ad->InsertAttr(ATTR_PROC_ID, proc);
+	if (owner) { ad->AssignExpr(ATTR_OWNER, owner); }
+	if (completion_date) { ad->AssignExpr(ATTR_COMPLETION_DATE, completion_date); }
+	ad->InsertAttr(ATTR_JOB_STATUS, status);
+	AppendHistory(ad);
+	history_ads.push_back(ad);
+}
+
+static void
+append_jobs()
+{
+	append_job(1, 0, "\"alice\"", "1500", 4);
+	append_job(2, 0, "\"bob\"", "2000", 3);
+	append_job(2, 1, "\"alice\"", "2500", 3);
+	append_job(3, 0, "strcat(\"car\", \"ol\")", "3000", 4);
+	append_job(4, 0, "\"alice\"", NULL, 4);
+	append_job(5, 0, "\"bob\"", "1000 + 5000", 4);
+	append_job(6, 0, NULL, "7000", 4);
+}
+
+	// Read the ad in the history file described by an index entry
+static bool
+read_indexed_ad(FILE *fp, const HistoryIndexEntry &entry, ClassAd &ad)
+{
+	std::string buf;
+	buf.resize(entry.end - entry.start);
+	if (fseek(fp, entry.start, SEEK_SET) < 0 || fread(&buf[0], 1, buf.size(), fp) != buf.size()) {
+		return false;
+	}
+	StringTokenIterator lines(buf, 100, "\n");
+	const std::string *line;
+	bool ended = false;
+	while ((line = lines.next_string())) {
+		if (starts_with(*line, "*** ")) {
+			ended = true;
+		} else if (ended || ! InsertLongFormAttrValue(ad, line->c_str(), true)) {
+			return false;
+		}
+	}
+	return ended;
+}
+
+static std::string
+describe_entry(const HistoryIndexEntry &entry)
+{
+	std::string line;
+	entry.Format(line);
+	chomp(line);
+	return line;
+}
+
+	// The cluster.proc of each job, in the order they were written
+static std::string
+job_id(ClassAd &ad)
+{
+	int cluster = -1, proc = -1;
+	ad.LookupInteger(ATTR_CLUSTER_ID, cluster);
+	ad.LookupInteger(ATTR_PROC_ID, proc);
+	std::string id;
+	formatstr(id, "%d.%d;", cluster, proc);
+	return id;
+}
+
+bool OTEST_HistoryIndex(void) {
+	emit_object("HistoryIndex");
+	emit_comment("The index of the job history file, which has the offsets "
+		"and a few attributes of each ad so condor_history can skip the ads "
+		"that can't match a query.");
+
+	formatstr(history_dir, "testhistoryindex%d", (int)getpid());
+	if (mkdir(history_dir.c_str(), 0700) < 0) {
+		emit_alert("Can't make a directory for the history file");
+		return false;
+	}
+	char *cwd = getcwd(NULL, 0);
+	formatstr(history_name, "%s/%s/history", cwd, history_dir.c_str());
+	free(cwd);
+	param_insert("HISTORY", history_name.c_str());
+	param_insert("ENABLE_HISTORY_INDEX", "true");
+
+	FunctionDriver driver;
+	driver.register_function(test_index_build);
+	driver.register_function(test_index_stale);
+	driver.register_function(test_index_missing);
+	driver.register_function(test_index_rotation);
+	driver.register_function(test_index_constraint);
+	driver.register_function(test_index_query_agrees);
+
+	bool result = driver.do_all_functions();
+	reset_history();
+	rmdir(history_dir.c_str());
+	param_insert("HISTORY", "");
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+	return result;
+}
+
+static bool test_index_build() {
+	emit_test("Test that AppendHistory() writes an index entry for each ad "
+		"with the range of the ad in the history file and its attributes.");
+	reset_history();
+	append_jobs();
+	std::vector<HistoryIndexEntry> entries;
+	bool read = ReadHistoryIndex(history_name.c_str(), entries);
+	std::string expected, actual;
+	expected = "1.0;2.0;2.1;3.0;4.0;5.0;6.0;";
+	const char *expected_entries[] = {
+		"1 0 1500 \"alice\"", "2 0 2000 \"bob\"", "2 1 2500 \"alice\"",
+		"3 0 3000 ?", "4 0 - \"alice\"", "5 0 ? \"bob\"", "6 0 7000 -",
+	};
+	std::string bad;
+	FILE *fp = safe_fopen_wrapper_follow(history_name.c_str(), "r");
+	for (size_t i = 0; fp && i < entries.size(); i++) {
+		ClassAd ad;
+		if ( ! read_indexed_ad(fp, entries[i], ad)) {
+			formatstr_cat(bad, "can't read entry %d;", (int)i);
+			continue;
+		}
+		actual += job_id(ad);
+			// the line is the offsets followed by the attributes
+		std::string line = describe_entry(entries[i]);
+		size_t attrs = line.find(' ', line.find(' ') + 1) + 1;
+		if (i >= sizeof(expected_entries)/sizeof(expected_entries[0]) ||
+			line.substr(attrs) != expected_entries[i]) {
+			formatstr_cat(bad, "%s;", line.c_str());
+		}
+	}
+	if (fp) { fclose(fp); }
+	emit_output_expected_header();
+	emit_param("Index read", "%s", tfstr(true));
+	emit_param("Ads", "%s", expected.c_str());
+	emit_param("Bad entries", "%s", "");
+	emit_output_actual_header();
+	emit_param("Index read", "%s", tfstr(read));
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Bad entries", "%s", bad.c_str());
+	if ( ! read || actual != expected || ! bad.empty()) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_index_stale() {
+	emit_test("Test that an index is not used, and is removed, when the "
+		"history file has been written without it.");
+	reset_history();
+	append_jobs();
+	FILE *fp = safe_fopen_wrapper_follow(history_name.c_str(), "a");
+	if (fp) {
+		fprintf(fp, "ClusterId = 7\nProcId = 0\n*** Offset = 0 ClusterId = 7 ProcId = 0 Owner = \"\" CompletionDate = -1\n");
+		fclose(fp);
+	}
+	std::vector<HistoryIndexEntry> entries;
+	bool read_stale = ReadHistoryIndex(history_name.c_str(), entries);
+	size_t stale_entries = entries.size();
+	append_job(8, 0, "\"alice\"", "8000", 4);
+	bool exists_after_append = history_file_exists(HISTORY_INDEX_SUFFIX);
+	bool read_after_append = ReadHistoryIndex(history_name.c_str(), entries);
+	emit_output_expected_header();
+	emit_param("Stale index read", "%s", tfstr(false));
+	emit_param("Entries", "%d", 0);
+	emit_param("Index exists after AppendHistory", "%s", tfstr(false));
+	emit_param("Index read after AppendHistory", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Stale index read", "%s", tfstr(read_stale));
+	emit_param("Entries", "%d", (int)stale_entries);
+	emit_param("Index exists after AppendHistory", "%s", tfstr(exists_after_append));
+	emit_param("Index read after AppendHistory", "%s", tfstr(read_after_append));
+	if (read_stale || stale_entries != 0 || exists_after_append || read_after_append) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_index_missing() {
+	emit_test("Test that a history file whose index is missing is not "
+		"indexed again part way through.");
+	reset_history();
+	append_jobs();
+	std::string index_name = history_name + HISTORY_INDEX_SUFFIX;
+	unlink(index_name.c_str());
+		// as when the schedd restarts
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+	append_job(8, 0, "\"alice\"", "8000", 4);
+	std::vector<HistoryIndexEntry> entries;
+	bool read = ReadHistoryIndex(history_name.c_str(), entries);
+	bool exists = history_file_exists(HISTORY_INDEX_SUFFIX);
+	emit_output_expected_header();
+	emit_param("Index exists", "%s", tfstr(false));
+	emit_param("Index read", "%s", tfstr(false));
+	emit_output_actual_header();
+	emit_param("Index exists", "%s", tfstr(exists));
+	emit_param("Index read", "%s", tfstr(read));
+	if (exists || read) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_index_rotation() {
+	emit_test("Test that rotating an unindexed history file starts a new "
+		"index, and that the index of a rotated file goes with it.");
+	reset_history();
+	append_jobs();
+	std::string index_name = history_name + HISTORY_INDEX_SUFFIX;
+	unlink(index_name.c_str());
+	InitJobHistoryFile("HISTORY", "PER_JOB_HISTORY_DIR");
+		// the next ad won't fit, so the history file is rotated
+	MaxHistoryFileSize = 100;
+	append_job(8, 0, "\"alice\"", "8000", 4);
+	std::vector<HistoryIndexEntry> entries;
+	bool read_new = ReadHistoryIndex(history_name.c_str(), entries);
+	size_t new_entries = entries.size();
+		// and again, now that the history file has an index
+	append_job(9, 0, "\"alice\"", "9000", 4);
+	bool read_newer = ReadHistoryIndex(history_name.c_str(), entries);
+	size_t newer_entries = entries.size();
+
+	int rotated = 0, rotated_indexed = 0;
+	Directory dir(history_dir.c_str());
+	const char *name;
+	while ((name = dir.Next())) {
+		std::string path;
+		formatstr(path, "%s/%s", history_dir.c_str(), name);
+		if (starts_with(name, "history.") && ! IsHistoryIndexFilename(name)) {
+			rotated++;
+			if (ReadHistoryIndex(path.c_str(), entries)) {
+				rotated_indexed++;
+			}
+		}
+	}
+	emit_output_expected_header();
+	emit_param("New index entries", "%d", 1);
+	emit_param("Rotated files with an index", "%d", 1);
+	emit_output_actual_header();
+	emit_param("New index entries", "%d", read_new ? (int)new_entries : -1);
+	emit_param("Rotated files", "%d", rotated);
+	emit_param("Rotated files with an index", "%d", rotated_indexed);
+		// both rotations can happen in the same second, which gives them the
+		// same name, so allow for only the second, indexed, rotated file
+	if ( ! read_new || new_entries != 1 || ! read_newer || newer_entries != 1 ||
+		rotated < 1 || rotated_indexed != 1) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_index_constraint() {
+	emit_test("Test that MakeHistoryIndexConstraint() keeps only the "
+		"clauses of the top-level && that the index can answer.");
+	const char *constraints[] = {
+		"Owner == \"alice\"",
+		"Owner == \"alice\" && JobStatus == 4",
+		"JobStatus == 4 && (ClusterId > 2 && CompletionDate < 6000)",
+		"ClusterId == 3 || JobStatus == 3",
+		"JobStatus == 4",
+		"ProcId == 0 && eval(\"JobStatus\") == 4",
+	};
+	const char *expected[] = {
+		"Owner == \"alice\"",
+		"Owner == \"alice\"",
+		"ClusterId > 2 && CompletionDate < 6000",
+		"",
+		"",
+		"ProcId == 0",
+	};
+	bool ok = true;
+	emit_output_expected_header();
+	for (size_t i = 0; i < sizeof(constraints)/sizeof(constraints[0]); i++) {
+		emit_param(constraints[i], "%s", expected[i]);
+	}
+	emit_output_actual_header();
+	for (size_t i = 0; i < sizeof(constraints)/sizeof(constraints[0]); i++) {
+		ExprTree *tree = NULL;
+		ParseClassAdRvalExpr(constraints[i], tree);
+		ExprTree *index_tree = MakeHistoryIndexConstraint(tree);
+		std::string actual;
+		if (index_tree) { ExprTreeToString(index_tree, actual); }
+		emit_param(constraints[i], "%s", actual.c_str());
+		if ( ! tree || actual != expected[i]) { ok = false; }
+		delete index_tree;
+		delete tree;
+	}
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_index_query_agrees() {
+	emit_test("Test that reading only the ads the index says can match gives "
+		"the same jobs as checking every ad, including constraints the index "
+		"only partly covers and ads with attributes the index can't hold.");
+	reset_history();
+	append_jobs();
+	const char *constraints[] = {
+		"Owner == \"alice\"",
+		"Owner == \"alice\" && JobStatus == 4",
+		"JobStatus == 4 && ClusterId > 2",
+		"ClusterId == 3 || JobStatus == 3",
+		"(ProcId == 0 && CompletionDate > 1000) && substr(Owner, 0, 1) == \"b\"",
+		"CompletionDate =?= undefined",
+		"Owner =?= \"carol\"",
+		"Owner =?= undefined && JobStatus == 4",
+		"CompletionDate >= 6000",
+		"MY.Owner == \"bob\"",
+	};
+	std::vector<HistoryIndexEntry> entries;
+	bool read = ReadHistoryIndex(history_name.c_str(), entries);
+	FILE *fp = safe_fopen_wrapper_follow(history_name.c_str(), "r");
+	bool ok = read && fp && entries.size() == history_ads.size();
+	std::string skipped_all;
+	emit_output_expected_header();
+	emit_param("Index read", "%s", tfstr(true));
+	emit_param("Indexed jobs match all jobs", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_param("Index read", "%s", tfstr(read));
+	for (size_t i = 0; ok && i < sizeof(constraints)/sizeof(constraints[0]); i++) {
+		ExprTree *tree = NULL;
+		ParseClassAdRvalExpr(constraints[i], tree);
+		ExprTree *index_tree = MakeHistoryIndexConstraint(tree);
+		std::string all, indexed;
+		int skipped = 0;
+		for (size_t j = 0; j < history_ads.size(); j++) {
+			if (EvalExprBool(history_ads[j], tree)) {
+				all += job_id(*history_ads[j]);
+			}
+			if ( ! entries[j].MayMatch(index_tree)) {
+				skipped++;
+				continue;
+			}
+			ClassAd ad;
+			if ( ! read_indexed_ad(fp, entries[j], ad)) {
+				ok = false;
+			} else if (EvalExprBool(&ad, tree)) {
+				indexed += job_id(ad);
+			}
+		}
+		emit_param(constraints[i], "all %s, indexed %s, skipped %d", all.c_str(), indexed.c_str(), skipped);
+		if (all != indexed) { ok = false; }
+		formatstr_cat(skipped_all, "%d,", skipped);
+		delete index_tree;
+		delete tree;
+	}
+	if (fp) { fclose(fp); }
+		// the index must have let some ads be skipped, or this tests nothing
+	emit_param("Indexed jobs match all jobs", "%s", tfstr(ok));
+	emit_param("Skipped", "%s", skipped_all.c_str());
+	if ( ! ok || skipped_all.find_first_of("123456789") == std::string::npos) {
+		FAIL;
+	}
+	PASS;
+}
@@ -0,0 +1,279 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test ParallelIsAMatch, which the negotiator uses to match a job
+	against the slots on NEGOTIATOR_NUM_THREADS threads: the matches,
+	and the slot chosen from them by rank, must be the same for any
+	number of threads.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "compat_classad_util.h"
+
+static bool test_matches_sequential(void);
+static bool test_matches_thread_counts(void);
+static bool test_half_match(void);
+static bool test_best_by_rank(void);
+static bool test_few_candidates(void);
+static bool test_no_candidates(void);
+
+static const int thread_counts[] = { 2, 3, 4, 7, 16 };
+
+static std::vector<ClassAd *> pool;
+
+	// A pool of slots that differ in the attributes the job looks at,
+	// with many slots of the same rank, and some that reject the job.
+static void
+make_pool(int num)
+{
+	for (int i = 0; i < num; i++) {
+		std::string text;
+		formatstr(text, "MyType = \"Machine\"\nName = \"slot%d@exec%d.example.org\"\n"
+			"Arch = \"%s\"\nOpSys = \"LINUX\"\nMemory = %d\nCpus = %d\n"
+			"Requirements = TARGET.Owner != \"%s\"\nRank = 0\n",
+			i % 8 + 1, i / 8, (i % 5) ? "X86_64" : "ppc64le",
+			1024 * (i % 4 + 1), i % 3 + 1, (i % 7) ? "nobody" : "alice");
+		ClassAd *ad = new ClassAd();
+		initAdFromString(text.c_str(), *ad);
+		pool.push_back(ad);
+	}
+}
+
+static void
+free_pool()
+{
+	for (size_t i = 0; i < pool.size(); i++) {
+		delete pool[i];
+	}
+	pool.clear();
+}
+
+static void
+make_job(ClassAd &job)
+{
+	initAdFromString("MyType = \"Job\"\nTargetType = \"Machine\"\nOwner = \"alice\"\nRequestMemory = 2048\n"
+		"Requirements = TARGET.Arch == \"X86_64\" && TARGET.Memory >= MY.RequestMemory\n"
+		"Rank = TARGET.Memory + TARGET.Cpus\n", job);
+}
+
+	// Match the job against the candidates one at a time, as the
+	// negotiator does with a single thread.
+static std::vector<ClassAd *>
+sequential_matches(ClassAd &job, std::vector<ClassAd *> &candidates, bool halfMatch)
+{
+	std::vector<ClassAd *> matches;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (halfMatch ? IsAHalfMatch(&job, candidates[i]) : IsAMatch(&job, candidates[i])) {
+			matches.push_back(candidates[i]);
+		}
+	}
+	return matches;
+}
+
+	// Pick the best of the matches by the job's Rank the way the
+	// negotiator's scan does: in order, keeping the first of equals.
+static ClassAd *
+best_by_rank(ClassAd &job, std::vector<ClassAd *> &matches)
+{
+	ClassAd *best = NULL;
+	double best_rank = 0;
+	for (size_t i = 0; i < matches.size(); i++) {
+		double rank = 0;
+		EvalFloat(ATTR_RANK, &job, matches[i], rank);
+		if ( ! best || rank > best_rank) {
+			best = matches[i];
+			best_rank = rank;
+		}
+	}
+	return best;
+}
+
+bool OTEST_ParallelIsAMatch(void) {
+	emit_object("ParallelIsAMatch");
+	emit_comment("Matching a job against slots on several threads gives the same "
+		"result as matching on one.");
+
+	make_pool(500);
+
+	FunctionDriver driver;
+	driver.register_function(test_matches_sequential);
+	driver.register_function(test_matches_thread_counts);
+	driver.register_function(test_half_match);
+	driver.register_function(test_best_by_rank);
+	driver.register_function(test_few_candidates);
+	driver.register_function(test_no_candidates);
+
+	bool result = driver.do_all_functions();
+	free_pool();
+	return result;
+}
+
+static bool test_matches_sequential() {
+	emit_test("Test that ParallelIsAMatch() with one thread finds the same "
+		"matches in the same order as calling IsAMatch() on each slot.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> expected = sequential_matches(job, pool, false);
+	std::vector<ClassAd *> matches;
+	ParallelIsAMatch(&job, pool, matches, 1, false);
+	emit_input_header();
+	emit_param("Slots", "%d", (int)pool.size());
+	emit_output_expected_header();
+	emit_param("Matches", "%d", (int)expected.size());
+	emit_output_actual_header();
+	emit_param("Matches", "%d", (int)matches.size());
+	if (expected.empty() || expected.size() == pool.size() || matches != expected) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_matches_thread_counts() {
+	emit_test("Test that ParallelIsAMatch() finds the same matches in the same "
+		"order with 1, 2, 3, 4, 7 and 16 threads.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> expected;
+	ParallelIsAMatch(&job, pool, expected, 1, false);
+	int differ = 0;
+	for (size_t i = 0; i < sizeof(thread_counts)/sizeof(thread_counts[0]); i++) {
+		std::vector<ClassAd *> matches;
+		ParallelIsAMatch(&job, pool, matches, thread_counts[i], false);
+		if (matches != expected) {
+			emit_alert("matches differ from one thread");
+			emit_param("Threads", "%d", thread_counts[i]);
+			differ++;
+		}
+	}
+	emit_input_header();
+	emit_param("Slots", "%d", (int)pool.size());
+	emit_output_expected_header();
+	emit_param("Thread counts that differ", "0");
+	emit_output_actual_header();
+	emit_param("Thread counts that differ", "%d", differ);
+	if (differ != 0) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_half_match() {
+	emit_test("Test that ParallelIsAMatch() with halfMatch only checks the "
+		"job's Requirements, and gives the same result on 1 and 4 threads.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> expected = sequential_matches(job, pool, true);
+	std::vector<ClassAd *> one, four;
+	ParallelIsAMatch(&job, pool, one, 1, true);
+	ParallelIsAMatch(&job, pool, four, 4, true);
+	emit_input_header();
+	emit_param("Slots", "%d", (int)pool.size());
+	emit_output_expected_header();
+	emit_param("Matches", "%d", (int)expected.size());
+	emit_output_actual_header();
+	emit_param("Matches with 1 thread", "%d", (int)one.size());
+	emit_param("Matches with 4 threads", "%d", (int)four.size());
+	if (one != expected || four != expected) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_best_by_rank() {
+	emit_test("Test that the slot chosen by the job's Rank from the matches, "
+		"keeping the first of equally ranked slots, is the same for any "
+		"number of threads.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> one;
+	ParallelIsAMatch(&job, pool, one, 1, false);
+	ClassAd *expected = best_by_rank(job, one);
+	int differ = 0;
+	for (size_t i = 0; i < sizeof(thread_counts)/sizeof(thread_counts[0]); i++) {
+		std::vector<ClassAd *> matches;
+		ParallelIsAMatch(&job, pool, matches, thread_counts[i], false);
+		if (best_by_rank(job, matches) != expected) {
+			emit_alert("best slot differs from one thread");
+			emit_param("Threads", "%d", thread_counts[i]);
+			differ++;
+		}
+	}
+	std::string name;
+	if (expected) { expected->LookupString(ATTR_NAME, name); }
+	emit_input_header();
+	emit_param("Slots", "%d", (int)pool.size());
+	emit_output_expected_header();
+	emit_param("Thread counts that differ", "0");
+	emit_output_actual_header();
+	emit_param("Best slot", "%s", name.c_str());
+	emit_param("Thread counts that differ", "%d", differ);
+	if ( ! expected || differ != 0) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_few_candidates() {
+	emit_test("Test that ParallelIsAMatch() works when there are fewer slots "
+		"than threads.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> few(pool.begin(), pool.begin() + 5);
+	std::vector<ClassAd *> expected = sequential_matches(job, few, false);
+	std::vector<ClassAd *> matches;
+	ParallelIsAMatch(&job, few, matches, 16, false);
+	emit_input_header();
+	emit_param("Slots", "%d", (int)few.size());
+	emit_param("Threads", "16");
+	emit_output_expected_header();
+	emit_param("Matches", "%d", (int)expected.size());
+	emit_output_actual_header();
+	emit_param("Matches", "%d", (int)matches.size());
+	if (matches != expected) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_no_candidates() {
+	emit_test("Test that ParallelIsAMatch() returns false and no matches when "
+		"there are no slots.");
+	ClassAd job;
+	make_job(job);
+	std::vector<ClassAd *> none;
+	std::vector<ClassAd *> matches;
+	bool result = ParallelIsAMatch(&job, none, matches, 4, false);
+	emit_input_header();
+	emit_param("Slots", "0");
+	emit_output_expected_header();
+	emit_retval("%s", tfstr(false));
+	emit_output_actual_header();
+	emit_retval("%s", tfstr(result));
+	if (result || ! matches.empty()) {
+		FAIL;
+	}
+	PASS;
+}
@@ -0,0 +1,673 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the Selector, both the ordinary one that calls select() or poll()
+	and the persistent one that DaemonCore uses when DAEMON_CORE_USE_EPOLL
+	is true.  Each test runs the same steps on both kinds and expects the
+	same results, the way DaemonCore drives them: reset(), add_fd() for
+	each fd of interest, execute(), then dispatch on fd_ready().
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "selector.h"
+#include <algorithm>
+
+#if ! defined(WIN32)
+
+static bool test_ready_fds(void);
+static bool test_level_triggered(void);
+static bool test_timeout(void);
+static bool test_zero_timeout(void);
+static bool test_delete_fd(void);
+static bool test_remove_during_dispatch(void);
+static bool test_add_during_dispatch(void);
+static bool test_add_without_reset(void);
+static bool test_pipe_hangup(void);
+static bool test_socket_hangup(void);
+static bool test_socket_error(void);
+static bool test_regular_file(void);
+
+	// whether this platform has a persistent selector to test
+static bool have_persistent = false;
+
+struct test_pipe {
+	int rd, wr;
+	test_pipe() : rd(-1), wr(-1) {
+		int fds[2];
+		if (pipe(fds) == 0) { rd = fds[0]; wr = fds[1]; }
+	}
+	~test_pipe() { close_read(); close_write(); }
+	void fill() { if (write(wr, "x", 1) != 1) { emit_alert("Can't write to a pipe"); } }
+	void drain() { char buf[16]; if (read(rd, buf, sizeof(buf)) < 0) { emit_alert("Can't read from a pipe"); } }
+		// the way CEDAR and DaemonCore close an fd a selector may hold
+	void close_read() { if (rd >= 0) { Selector::fd_closing(rd); close(rd); rd = -1; } }
+	void close_write() { if (wr >= 0) { Selector::fd_closing(wr); close(wr); wr = -1; } }
+};
+
+	// A selector of the kind under test, or NULL if this platform has none.
+static Selector *
+make_selector(bool persistent)
+{
+	Selector *selector = new Selector;
+	if (persistent && ! selector->set_persistent(true)) {
+		delete selector;
+		return NULL;
+	}
+	return selector;
+}
+
+static const char *
+kind(bool persistent)
+{
+	return persistent ? "persistent" : "ordinary";
+}
+
+	// One trip around the event loop that does not block, returns the
+	// state the selector ended up in.
+static const char *
+poll_once(Selector &selector)
+{
+	selector.set_timeout(0, 0);
+	selector.execute();
+	if (selector.has_ready()) return "ready";
+	if (selector.timed_out()) return "timed out";
+	if (selector.signalled()) return "signalled";
+	return "failed";
+}
+
+bool OTEST_Selector(void) {
+	emit_object("Selector");
+	emit_comment("Waits for fds to become ready for DaemonCore.  When "
+		"persistent, it keeps its fds registered with epoll between calls.");
+
+	Selector probe;
+	have_persistent = probe.set_persistent(true);
+	if ( ! have_persistent) {
+		emit_comment("There is no persistent selector on this platform, "
+			"only the ordinary selector is tested.");
+	}
+	probe.set_persistent(false);
+
+	FunctionDriver driver;
+	driver.register_function(test_ready_fds);
+	driver.register_function(test_level_triggered);
+	driver.register_function(test_timeout);
+	driver.register_function(test_zero_timeout);
+	driver.register_function(test_delete_fd);
+	driver.register_function(test_remove_during_dispatch);
+	driver.register_function(test_add_during_dispatch);
+	driver.register_function(test_add_without_reset);
+	driver.register_function(test_pipe_hangup);
+	driver.register_function(test_socket_hangup);
+	driver.register_function(test_socket_error);
+	driver.register_function(test_regular_file);
+
+	return driver.do_all_functions();
+}
+
+	// Runs a test on each kind of selector, and compares what it reports
+	// with what was expected.
+typedef std::string (*selector_steps)(bool persistent);
+
+static bool
+run_on_each_selector(selector_steps steps, const char *expected)
+{
+	bool ok = true;
+	emit_output_expected_header();
+	emit_param("Result", "%s", expected);
+	emit_output_actual_header();
+	for (int i = 0; i < 2; i++) {
+		bool persistent = (i == 1);
+		if (persistent && ! have_persistent) continue;
+		std::string actual = steps(persistent);
+		emit_param(kind(persistent), "%s", actual.c_str());
+		if (actual != expected) { ok = false; }
+	}
+	return ok;
+}
+
+static std::string
+ready_fds_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe quiet, busy, busy2;
+	busy.fill();
+	busy2.fill();
+
+	selector->reset();
+	selector->add_fd(quiet.rd, Selector::IO_READ);
+	selector->add_fd(busy.rd, Selector::IO_READ);
+	selector->add_fd(busy2.rd, Selector::IO_READ);
+	selector->add_fd(quiet.wr, Selector::IO_WRITE);
+	std::string result = poll_once(*selector);
+	formatstr_cat(result, ", quiet %s, busy %s, busy2 %s, writable %s",
+		tfstr(selector->fd_ready(quiet.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(busy.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(busy2.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(quiet.wr, Selector::IO_WRITE)));
+	if (persistent) {
+			// a persistent selector also lists them, so dispatch need not
+			// look at every fd
+		std::vector<int> fds = selector->ready_fds();
+		std::sort(fds.begin(), fds.end());
+		std::vector<int> expected;
+		expected.push_back(busy.rd);
+		expected.push_back(busy2.rd);
+		expected.push_back(quiet.wr);
+		std::sort(expected.begin(), expected.end());
+		if (fds != expected) { result += ", wrong ready_fds"; }
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_ready_fds() {
+	emit_test("Test that execute() reports the fds that are ready, and only "
+		"for the interest that was added.");
+	if ( ! run_on_each_selector(ready_fds_steps,
+			"ready, quiet FALSE, busy TRUE, busy2 TRUE, writable TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+level_triggered_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe busy;
+	busy.fill();
+	std::string result;
+	const char *state;
+	for (int cycle = 0; cycle < 3; cycle++) {
+			// the handler doesn't read until the last cycle
+		if (cycle == 2) { busy.drain(); }
+		selector->reset();
+		selector->add_fd(busy.rd, Selector::IO_READ);
+		state = poll_once(*selector);
+		formatstr_cat(result, "%s%s %s", cycle ? ", " : "", state,
+			tfstr(selector->fd_ready(busy.rd, Selector::IO_READ)));
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_level_triggered() {
+	emit_test("Test that an fd stays ready on later calls until its data is "
+		"read, even when its interest does not change.");
+	if ( ! run_on_each_selector(level_triggered_steps,
+			"ready TRUE, ready TRUE, timed out FALSE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+timeout_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe quiet, quiet2;
+	std::string result;
+	for (int cycle = 0; cycle < 2; cycle++) {
+		selector->reset();
+		selector->add_fd(quiet.rd, Selector::IO_READ);
+		selector->add_fd(quiet2.rd, Selector::IO_READ);
+		selector->set_timeout(0, 200000);
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		selector->execute();
+		gettimeofday(&end, NULL);
+		long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+		formatstr_cat(result, "%stimed out %s, ready %s, waited %s", cycle ? ", " : "",
+			tfstr(selector->timed_out()),
+			tfstr(selector->fd_ready(quiet.rd, Selector::IO_READ)),
+				// the wait is rounded up, never down
+			(elapsed_ms >= 199 && elapsed_ms < 2000) ? "200ms" : "wrong time");
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_timeout() {
+	emit_test("Test that execute() waits for the timeout when no fd becomes "
+		"ready, on the first call and when the fds are already registered.");
+	if ( ! run_on_each_selector(timeout_steps,
+			"timed out TRUE, ready FALSE, waited 200ms, timed out TRUE, ready FALSE, waited 200ms")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+zero_timeout_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe quiet, busy;
+	std::string result;
+
+		// no fds at all
+	selector->reset();
+	result += poll_once(*selector);
+
+		// a long timeout is cut short by a ready fd
+	busy.fill();
+	selector->reset();
+	selector->add_fd(quiet.rd, Selector::IO_READ);
+	selector->add_fd(busy.rd, Selector::IO_READ);
+	selector->set_timeout(60, 0);
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	selector->execute();
+	gettimeofday(&end, NULL);
+	long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+	formatstr_cat(result, ", %s %s", selector->has_ready() ? "ready" : "not ready",
+		elapsed_ms < 1000 ? "at once" : "late");
+	delete selector;
+	return result;
+}
+
+static bool test_zero_timeout() {
+	emit_test("Test that a zero timeout does not block, and that a ready fd "
+		"ends a long timeout at once.");
+	if ( ! run_on_each_selector(zero_timeout_steps, "timed out, ready at once")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+delete_fd_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe busy, busy2;
+	busy.fill();
+	busy2.fill();
+	std::string result;
+	const char *state;
+
+		// registered on the first cycle, then deleted before the second
+	for (int cycle = 0; cycle < 2; cycle++) {
+		selector->reset();
+		selector->add_fd(busy.rd, Selector::IO_READ);
+		selector->add_fd(busy2.rd, Selector::IO_READ);
+		if (cycle == 1) {
+			selector->delete_fd(busy2.rd, Selector::IO_READ);
+		}
+		state = poll_once(*selector);
+		formatstr_cat(result, "%s%s %s %s", cycle ? ", " : "", state,
+			tfstr(selector->fd_ready(busy.rd, Selector::IO_READ)),
+			tfstr(selector->fd_ready(busy2.rd, Selector::IO_READ)));
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_delete_fd() {
+	emit_test("Test that an fd whose interest is deleted is not reported, "
+		"even though it is ready and was registered on the last call.");
+	if ( ! run_on_each_selector(delete_fd_steps, "ready TRUE TRUE, ready TRUE FALSE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+remove_during_dispatch_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe first;
+	test_pipe *second = new test_pipe;
+	first.fill();
+	second->fill();
+	std::string result;
+	const char *state;
+
+	selector->reset();
+	selector->add_fd(first.rd, Selector::IO_READ);
+	selector->add_fd(second->rd, Selector::IO_READ);
+	result += poll_once(*selector);
+
+		// the handler for the first fd closes the second before it is
+		// dispatched, and a new pipe takes its fd number
+	int old_fd = second->rd;
+	delete second;
+	test_pipe reused;
+		// an ordinary selector keeps the result of its last select(), so
+		// only a persistent one is expected to drop the closed fd
+	formatstr_cat(result, ", second ready %s",
+		tfstr(persistent ? selector->fd_ready(old_fd, Selector::IO_READ) : false));
+	formatstr_cat(result, ", fd reused %s", tfstr(reused.rd == old_fd));
+	if (persistent) {
+		formatstr_cat(result, ", forgot %s", tfstr(selector->forgot_fds()));
+	}
+
+		// the new pipe under the old number must not look ready until it is
+	for (int cycle = 0; cycle < 2; cycle++) {
+		if (cycle == 1) { reused.fill(); }
+		selector->reset();
+		selector->add_fd(first.rd, Selector::IO_READ);
+		selector->add_fd(reused.rd, Selector::IO_READ);
+		state = poll_once(*selector);
+		formatstr_cat(result, ", %s %s %s", state,
+			tfstr(selector->fd_ready(first.rd, Selector::IO_READ)),
+			tfstr(selector->fd_ready(reused.rd, Selector::IO_READ)));
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_remove_during_dispatch() {
+	emit_test("Test that an fd closed while the ready fds are dispatched is "
+		"no longer reported, and that a new fd with the same number is "
+		"watched for itself.");
+	std::string expected_ordinary = "ready, second ready FALSE, fd reused TRUE, "
+		"ready TRUE FALSE, ready TRUE TRUE";
+	std::string expected_persistent = "ready, second ready FALSE, fd reused TRUE, forgot TRUE, "
+		"ready TRUE FALSE, ready TRUE TRUE";
+	bool ok = true;
+	emit_output_expected_header();
+	emit_param(kind(false), "%s", expected_ordinary.c_str());
+	if (have_persistent) emit_param(kind(true), "%s", expected_persistent.c_str());
+	emit_output_actual_header();
+	std::string actual = remove_during_dispatch_steps(false);
+	emit_param(kind(false), "%s", actual.c_str());
+	if (actual != expected_ordinary) ok = false;
+	if (have_persistent) {
+		actual = remove_during_dispatch_steps(true);
+		emit_param(kind(true), "%s", actual.c_str());
+		if (actual != expected_persistent) ok = false;
+	}
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+add_during_dispatch_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe first;
+	first.fill();
+	std::string result;
+	const char *state;
+
+	selector->reset();
+	selector->add_fd(first.rd, Selector::IO_READ);
+	result += poll_once(*selector);
+
+		// the handler opens a new pipe, which is not ready in this cycle
+	test_pipe added;
+	added.fill();
+		// an ordinary selector watching a single fd answers for that fd,
+		// whatever fd it is asked about, so only ask a persistent one
+	formatstr_cat(result, ", added ready %s",
+		tfstr(persistent ? selector->fd_ready(added.rd, Selector::IO_READ) : false));
+
+		// and is watched from the next cycle on
+	first.drain();
+	selector->reset();
+	selector->add_fd(first.rd, Selector::IO_READ);
+	selector->add_fd(added.rd, Selector::IO_READ);
+	state = poll_once(*selector);
+	formatstr_cat(result, ", %s %s %s", state,
+		tfstr(selector->fd_ready(first.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(added.rd, Selector::IO_READ)));
+	delete selector;
+	return result;
+}
+
+static bool test_add_during_dispatch() {
+	emit_test("Test that an fd added while the ready fds are dispatched is "
+		"reported on the next call.");
+	if ( ! run_on_each_selector(add_during_dispatch_steps,
+			"ready, added ready FALSE, ready FALSE TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+add_without_reset_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe first, second;
+	std::string result;
+	const char *state;
+
+	selector->reset();
+	selector->add_fd(first.rd, Selector::IO_READ);
+	result += poll_once(*selector);
+
+		// the fds already added are kept
+	second.fill();
+	selector->add_fd(second.rd, Selector::IO_READ);
+	state = poll_once(*selector);
+	formatstr_cat(result, ", %s %s %s", state,
+		tfstr(selector->fd_ready(first.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(second.rd, Selector::IO_READ)));
+	first.fill();
+	state = poll_once(*selector);
+	formatstr_cat(result, ", %s %s %s", state,
+		tfstr(selector->fd_ready(first.rd, Selector::IO_READ)),
+		tfstr(selector->fd_ready(second.rd, Selector::IO_READ)));
+	delete selector;
+	return result;
+}
+
+static bool test_add_without_reset() {
+	emit_test("Test that add_fd() between calls to execute(), without a "
+		"reset(), adds to the fds being watched.");
+	if ( ! run_on_each_selector(add_without_reset_steps,
+			"timed out, ready FALSE TRUE, ready TRUE TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+pipe_hangup_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	test_pipe hangup;
+	std::string result;
+	const char *state;
+
+	for (int cycle = 0; cycle < 2; cycle++) {
+			// the writer goes away between calls
+		if (cycle == 1) { hangup.close_write(); }
+		selector->reset();
+		selector->add_fd(hangup.rd, Selector::IO_READ);
+		state = poll_once(*selector);
+		formatstr_cat(result, "%s%s %s", cycle ? ", " : "", state,
+			tfstr(selector->fd_ready(hangup.rd, Selector::IO_READ)));
+	}
+	delete selector;
+	return result;
+}
+
+static bool test_pipe_hangup() {
+	emit_test("Test that a pipe whose writer has closed is ready to read, so "
+		"its handler sees the end of file.");
+	if ( ! run_on_each_selector(pipe_hangup_steps, "timed out FALSE, ready TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+socket_hangup_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		delete selector;
+		return "no socketpair";
+	}
+	std::string result;
+	const char *state;
+	for (int cycle = 0; cycle < 2; cycle++) {
+			// the peer goes away between calls
+		if (cycle == 1) { Selector::fd_closing(fds[1]); close(fds[1]); }
+		selector->reset();
+		selector->add_fd(fds[0], Selector::IO_READ);
+		state = poll_once(*selector);
+		formatstr_cat(result, "%s%s %s", cycle ? ", " : "", state,
+			tfstr(selector->fd_ready(fds[0], Selector::IO_READ)));
+	}
+	Selector::fd_closing(fds[0]);
+	close(fds[0]);
+	delete selector;
+	return result;
+}
+
+static bool test_socket_hangup() {
+	emit_test("Test that a socket whose peer has closed is ready to read.");
+	if ( ! run_on_each_selector(socket_hangup_steps, "timed out FALSE, ready TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+socket_error_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+
+		// find a port that nothing listens on
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof(addr);
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		getsockname(listener, (struct sockaddr *)&addr, &addr_len) < 0) {
+		if (listener >= 0) close(listener);
+		delete selector;
+		return "no socket";
+	}
+	close(listener);
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+	int rc = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+	int connect_errno = errno;
+	std::string result;
+	if (rc == 0 || (connect_errno != EINPROGRESS && connect_errno != ECONNREFUSED)) {
+		result = "connect did not fail";
+	} else {
+			// as DaemonCore waits for a non-blocking connect to finish,
+			// and, separately, for something to read
+		for (int i = 0; i < 2; i++) {
+			Selector::IO_FUNC interest = i ? Selector::IO_READ : Selector::IO_WRITE;
+			selector->reset();
+			selector->add_fd(sock, interest);
+			selector->set_timeout(5, 0);
+			selector->execute();
+			formatstr_cat(result, "%s%s %s", i ? ", " : "",
+				selector->has_ready() ? "ready" : "not ready",
+				tfstr(selector->fd_ready(sock, interest)));
+		}
+		int err = 0;
+		socklen_t err_len = sizeof(err);
+		getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &err_len);
+		formatstr_cat(result, ", refused %s", tfstr(err == ECONNREFUSED || connect_errno == ECONNREFUSED));
+	}
+	Selector::fd_closing(sock);
+	close(sock);
+	delete selector;
+	return result;
+}
+
+static bool test_socket_error() {
+	emit_test("Test that a socket with an error, here a refused connect, is "
+		"ready to write and to read, so its handler finds the error.");
+	if ( ! run_on_each_selector(socket_error_steps, "ready TRUE, ready TRUE, refused TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+static std::string
+regular_file_steps(bool persistent)
+{
+	Selector *selector = make_selector(persistent);
+	if ( ! selector) return "no selector";
+	std::string name;
+	formatstr(name, "testselector%d", (int)getpid());
+	int fd = safe_open_wrapper_follow(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	unlink(name.c_str());
+	if (fd < 0) {
+		delete selector;
+		return "no file";
+	}
+	test_pipe quiet;
+	std::string result;
+	const char *state;
+	for (int cycle = 0; cycle < 2; cycle++) {
+		selector->reset();
+		selector->add_fd(quiet.rd, Selector::IO_READ);
+		selector->add_fd(fd, Selector::IO_READ);
+		state = poll_once(*selector);
+		formatstr_cat(result, "%s%s %s %s", cycle ? ", " : "", state,
+			tfstr(selector->fd_ready(quiet.rd, Selector::IO_READ)),
+			tfstr(selector->fd_ready(fd, Selector::IO_READ)));
+	}
+	Selector::fd_closing(fd);
+	close(fd);
+	delete selector;
+	return result;
+}
+
+static bool test_regular_file() {
+	emit_test("Test that a regular file, which epoll can't watch, is always "
+		"ready, as select() reports it.");
+	if ( ! run_on_each_selector(regular_file_steps, "ready FALSE TRUE, ready FALSE TRUE")) {
+		FAIL;
+	}
+	PASS;
+}
+
+#else
+
+bool OTEST_Selector(void) {
+	emit_object("Selector");
+	emit_comment("The Selector tests use pipes and are not run on Windows.");
+	return true;
+}
+
+#endif
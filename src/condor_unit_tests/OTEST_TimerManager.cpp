@@ -0,0 +1,294 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the TimerManager implementation.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "condor_daemon_core.h"
+
+#include <vector>
+
+static const int STRESS_TIMERS = 100000;
+
+static bool test_equal_deadlines_fire_in_order(void);
+static bool test_reset_to_zero_fires_once_per_timeout(void);
+static bool test_cancel_inside_handler(void);
+static bool test_stress_create_cancel(void);
+static bool test_stress_fire_order(void);
+
+	// The order in which the timer handlers were called
+static std::vector<int> fired;
+
+	// Each timer gets its own Fired object, so the handler knows which
+	// timer it was called for.
+class Fired : public Service
+{
+public:
+	Fired( int n ) : num(n), id(-1), reset_self(false), cancel_self(false) {}
+	void handler() {
+		fired.push_back( num );
+		if ( reset_self ) {
+			TimerManager::GetTimerManager().ResetTimer( id, 0 );
+		}
+		if ( cancel_self ) {
+			TimerManager::GetTimerManager().CancelTimer( id );
+		}
+	}
+
+	int num;
+	int id;
+	bool reset_self;
+	bool cancel_self;
+};
+
+static int
+new_timer( Fired *f, unsigned deltawhen )
+{
+	f->id = TimerManager::GetTimerManager().NewTimer( f, deltawhen,
+		(TimerHandlercpp)&Fired::handler, "Fired::handler" );
+	return f->id;
+}
+
+static void
+cleanup( std::vector<Fired*> &services )
+{
+	TimerManager::GetTimerManager().CancelAllTimers();
+	for ( size_t i = 0; i < services.size(); i++ ) {
+		delete services[i];
+	}
+	services.clear();
+	fired.clear();
+}
+
+bool OTEST_TimerManager(void) {
+	emit_object("TimerManager");
+	emit_comment("Calls registered handlers when their timers are due, in "
+		"order of when they are due, and in the order they were registered "
+		"for timers that are due at the same time.");
+
+	FunctionDriver driver;
+	driver.register_function(test_equal_deadlines_fire_in_order);
+	driver.register_function(test_reset_to_zero_fires_once_per_timeout);
+	driver.register_function(test_cancel_inside_handler);
+	driver.register_function(test_stress_create_cancel);
+	driver.register_function(test_stress_fire_order);
+
+	return driver.do_all_functions();
+}
+
+static bool test_equal_deadlines_fire_in_order() {
+	emit_test("Test that timers with the same deadline fire in the order "
+		"they were registered.");
+	TimerManager &tm = TimerManager::GetTimerManager();
+	std::vector<Fired*> services;
+	for ( int i = 0; i < 5; i++ ) {
+		services.push_back( new Fired(i) );
+	}
+		// register out of order, with a later timer in between
+	new_timer( services[3], 0 );
+	new_timer( services[1], 0 );
+	new_timer( services[4], 1000 );
+	new_timer( services[0], 0 );
+	new_timer( services[2], 0 );
+	emit_input_header();
+	emit_param("Registered", "3, 1, 4 (in 1000s), 0, 2");
+	emit_output_expected_header();
+	emit_param("Fired", "3, 1, 0, 2");
+	int num_fired = 0;
+	tm.Timeout( &num_fired );
+	std::string result;
+	for ( size_t i = 0; i < fired.size(); i++ ) {
+		formatstr_cat( result, "%s%d", i ? ", " : "", fired[i] );
+	}
+	emit_output_actual_header();
+	emit_param("Fired", "%s", result.c_str());
+	bool ok = (num_fired == 4 && result == "3, 1, 0, 2");
+	cleanup( services );
+	if ( !ok ) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_reset_to_zero_fires_once_per_timeout() {
+	emit_test("Test that a timer that resets itself to zero is only fired "
+		"once per call to Timeout(), and after the other due timers.");
+	TimerManager &tm = TimerManager::GetTimerManager();
+	std::vector<Fired*> services;
+	for ( int i = 0; i < 3; i++ ) {
+		services.push_back( new Fired(i) );
+		new_timer( services[i], 0 );
+	}
+	services[0]->reset_self = true;
+	emit_input_header();
+	emit_param("Registered", "0 (resets itself to 0), 1, 2");
+	emit_output_expected_header();
+	emit_param("Fired", "0, 1, 2, 0");
+	tm.Timeout();
+	tm.Timeout();
+	std::string result;
+	for ( size_t i = 0; i < fired.size(); i++ ) {
+		formatstr_cat( result, "%s%d", i ? ", " : "", fired[i] );
+	}
+	emit_output_actual_header();
+	emit_param("Fired", "%s", result.c_str());
+	bool ok = (result == "0, 1, 2, 0");
+	cleanup( services );
+	if ( !ok ) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_cancel_inside_handler() {
+	emit_test("Test that a periodic timer that cancels itself inside its "
+		"handler is not fired again.");
+	TimerManager &tm = TimerManager::GetTimerManager();
+	std::vector<Fired*> services;
+	services.push_back( new Fired(0) );
+	services[0]->cancel_self = true;
+	services[0]->id = tm.NewTimer( services[0], 0,
+		(TimerHandlercpp)&Fired::handler, "Fired::handler", 1 );
+	emit_input_header();
+	emit_param("Period", "1");
+	emit_output_expected_header();
+	emit_param("Fired", "1");
+	emit_param("GetNextRuntime()", "0");
+	tm.Timeout();
+	tm.Timeout();
+	time_t next = tm.GetNextRuntime( services[0]->id );
+	emit_output_actual_header();
+	emit_param("Fired", "%d", (int)fired.size());
+	emit_param("GetNextRuntime()", "%ld", (long)next);
+	bool ok = (fired.size() == 1 && next == 0);
+	cleanup( services );
+	if ( !ok ) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_stress_create_cancel() {
+	emit_test("Test creating, resetting and cancelling 100000 timers.");
+	TimerManager &tm = TimerManager::GetTimerManager();
+	std::vector<Fired*> services;
+	std::vector<int> ids;
+	emit_input_header();
+	emit_param("Timers", "%d", STRESS_TIMERS);
+	emit_output_expected_header();
+	emit_param("Failures", "0");
+
+	double start = _condor_debug_get_time_double();
+	int failures = 0;
+	srand( 42 );
+	for ( int i = 0; i < STRESS_TIMERS; i++ ) {
+		services.push_back( new Fired(i) );
+		ids.push_back( new_timer( services[i], 1000 + rand() % 100000 ) );
+		if ( ids[i] < 0 ) {
+			failures++;
+		}
+	}
+	double created = _condor_debug_get_time_double();
+
+	for ( int i = 0; i < STRESS_TIMERS; i += 2 ) {
+		unsigned deltawhen = 500 + rand() % 100000;
+		time_t now = time(NULL);
+		if ( tm.ResetTimer( ids[i], deltawhen ) != 0 ) {
+			failures++;
+		}
+		time_t when = tm.GetNextRuntime( ids[i] );
+		if ( when < now + deltawhen || when > time(NULL) + deltawhen ) {
+			failures++;
+		}
+	}
+	double reset = _condor_debug_get_time_double();
+
+		// nothing is due yet
+	int num_fired = -1;
+	if ( tm.Timeout( &num_fired ) < 500 || num_fired != 0 ) {
+		failures++;
+	}
+
+	std::vector<int> order( ids );
+	for ( size_t i = order.size() - 1; i > 0; i-- ) {
+		std::swap( order[i], order[rand() % (i + 1)] );
+	}
+	for ( size_t i = 0; i < order.size(); i++ ) {
+		if ( tm.CancelTimer( order[i] ) != 0 ) {
+			failures++;
+		}
+	}
+	double cancelled = _condor_debug_get_time_double();
+
+	if ( tm.GetNextRuntime( ids[0] ) != 0 || tm.Timeout() != -1 ) {
+		failures++;
+	}
+
+	emit_output_actual_header();
+	emit_param("Failures", "%d", failures);
+	emit_param("Create Time", "%.3fs", created - start);
+	emit_param("Reset Time", "%.3fs", reset - created);
+	emit_param("Cancel Time", "%.3fs", cancelled - reset);
+	cleanup( services );
+	if ( failures ) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_stress_fire_order() {
+	emit_test("Test that only the due timers among 100000 fire, in the "
+		"order they were registered, after some are cancelled.");
+	TimerManager &tm = TimerManager::GetTimerManager();
+	std::vector<Fired*> services;
+	std::vector<int> expected;
+	emit_input_header();
+	emit_param("Timers", "%d", STRESS_TIMERS);
+	emit_param("Due", "every other timer, less every fourth timer");
+	for ( int i = 0; i < STRESS_TIMERS; i++ ) {
+		services.push_back( new Fired(i) );
+		new_timer( services[i], (i % 2) ? 1000 : 0 );
+	}
+	for ( int i = 0; i < STRESS_TIMERS; i++ ) {
+		if ( i % 4 == 0 ) {
+			tm.CancelTimer( services[i]->id );
+		} else if ( i % 2 == 0 ) {
+			expected.push_back( i );
+		}
+	}
+	emit_output_expected_header();
+	emit_param("Fired", "%d", (int)expected.size());
+	int num_fired = 0;
+	tm.Timeout( &num_fired );
+	emit_output_actual_header();
+	emit_param("Fired", "%d", num_fired);
+	bool ok = (fired == expected && num_fired == (int)expected.size());
+	cleanup( services );
+	if ( !ok ) {
+		FAIL;
+	}
+	PASS;
+}
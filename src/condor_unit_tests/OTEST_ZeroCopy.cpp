@@ -0,0 +1,244 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test ReliSock::put_file() and get_file() when CEDAR_ZERO_COPY lets
+	them use sendfile() and splice(), including when the file can't be
+	written with splice() and get_file() has to fall back to write().
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "reli_sock.h"
+
+#ifdef LINUX
+
+#include <sys/wait.h>
+
+static bool test_zero_copy(void);
+static bool test_no_zero_copy(void);
+static bool test_splice_to_file_fallback(void);
+static bool test_short_file(void);
+static bool test_empty_file(void);
+
+static const char * src_file = "OTEST_ZeroCopy.src";
+static const char * dst_file = "OTEST_ZeroCopy.dst";
+
+	// Data that is easy to tell apart at any offset.
+static std::string
+file_data(int len)
+{
+	std::string data;
+	unsigned int x = 54321;
+	for (int i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		data += (char)((x >> 16) & 0xff);
+	}
+	return data;
+}
+
+	// Sends data with put_file() from a child process, and receives it
+	// with get_file() into a file opened with the given extra flags.
+	// Returns what get_file() returned, and the contents of the file.
+static int
+transfer_file(const std::string & data, int dst_flags, std::string & received, bool & sent)
+{
+	int rc = -1;
+	sent = false;
+	received.clear();
+
+	int src_fd = safe_open_wrapper_follow(src_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (src_fd < 0 || write(src_fd, data.data(), data.size()) != (ssize_t)data.size()) {
+		emit_alert("could not write the source file");
+		if (src_fd >= 0) { close(src_fd); }
+		return rc;
+	}
+	close(src_fd);
+
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+		emit_alert("socketpair() failed");
+		return rc;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		emit_alert("fork() failed");
+		close(sv[0]);
+		close(sv[1]);
+		return rc;
+	}
+	if (pid == 0) {
+		close(sv[1]);
+		ReliSock sender;
+		sender.assignDomainSocket(sv[0]);
+		sender.timeout(10);
+		filesize_t size = 0;
+		int fd = safe_open_wrapper_follow(src_file, O_RDONLY);
+		bool ok = fd >= 0 && sender.put_file(&size, fd) >= 0 && sender.end_of_message();
+		_exit(ok ? 0 : 1);
+	}
+
+	close(sv[0]);
+	{
+		ReliSock receiver;
+		receiver.assignDomainSocket(sv[1]);
+		receiver.timeout(10);
+		int dst_fd = safe_open_wrapper_follow(dst_file, O_WRONLY | O_CREAT | O_TRUNC | dst_flags, 0600);
+		if (dst_fd < 0) {
+			emit_alert("could not open the destination file");
+		} else {
+			filesize_t size = 0;
+			receiver.decode();
+			rc = receiver.get_file(&size, dst_fd, false, false, -1, NULL);
+			if (rc >= 0 && ! receiver.end_of_message()) {
+				rc = -1;
+			}
+			close(dst_fd);
+		}
+	}
+
+	int status = 0;
+	sent = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+	int fd = safe_open_wrapper_follow(dst_file, O_RDONLY);
+	if (fd >= 0) {
+		char buf[65536];
+		ssize_t len;
+		while ((len = read(fd, buf, sizeof(buf))) > 0) {
+			received.append(buf, len);
+		}
+		close(fd);
+	}
+
+	unlink(src_file);
+	unlink(dst_file);
+	return rc;
+}
+
+	// Transfers a file of len bytes and checks it arrives intact.
+static bool
+check_transfer(int len, int dst_flags)
+{
+	std::string data = file_data(len);
+	std::string received;
+	bool sent = false;
+	int rc = transfer_file(data, dst_flags, received, sent);
+	emit_input_header();
+	emit_param("File size", "%d", len);
+	emit_output_expected_header();
+	emit_retval("%d", 0);
+	emit_param("Same data", "%s", tfstr(true));
+	emit_output_actual_header();
+	emit_retval("%d", rc);
+	emit_param("Sent", "%s", tfstr(sent));
+	emit_param("Same data", "%s (%d bytes)", tfstr(received == data), (int)received.size());
+	return rc == 0 && sent && received == data;
+}
+
+bool OTEST_ZeroCopy(void) {
+	emit_object("ZeroCopy");
+	emit_comment("Files sent with sendfile() and received with splice(), and the "
+		"fallbacks when those can't be used.");
+
+	FunctionDriver driver;
+	driver.register_function(test_zero_copy);
+	driver.register_function(test_no_zero_copy);
+	driver.register_function(test_splice_to_file_fallback);
+	driver.register_function(test_short_file);
+	driver.register_function(test_empty_file);
+
+	return driver.do_all_functions();
+}
+
+static bool test_zero_copy() {
+	emit_test("Test that a file of several megabytes sent with CEDAR_ZERO_COPY "
+		"arrives intact.");
+	param_insert("CEDAR_ZERO_COPY", "true");
+	bool ok = check_transfer(3 * 1024 * 1024 + 12345, 0);
+	param_insert("CEDAR_ZERO_COPY", "");
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_no_zero_copy() {
+	emit_test("Test that the same file arrives intact when CEDAR_ZERO_COPY "
+		"is false.");
+	param_insert("CEDAR_ZERO_COPY", "false");
+	bool ok = check_transfer(3 * 1024 * 1024 + 12345, 0);
+	param_insert("CEDAR_ZERO_COPY", "");
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_splice_to_file_fallback() {
+	emit_test("Test that a file arrives intact when splice() can't write to "
+		"the destination, which it refuses to do in append mode, so that "
+		"get_file() has to write what it already read with write().");
+	param_insert("CEDAR_ZERO_COPY", "true");
+	bool ok = check_transfer(3 * 1024 * 1024 + 12345, O_APPEND);
+	param_insert("CEDAR_ZERO_COPY", "");
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_short_file() {
+	emit_test("Test that a file much shorter than a pipe buffer arrives "
+		"intact with CEDAR_ZERO_COPY, both when splice() can write it and "
+		"when it can't.");
+	param_insert("CEDAR_ZERO_COPY", "true");
+	bool ok = check_transfer(13, 0) && check_transfer(13, O_APPEND);
+	param_insert("CEDAR_ZERO_COPY", "");
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_empty_file() {
+	emit_test("Test that an empty file arrives as an empty file with "
+		"CEDAR_ZERO_COPY.");
+	param_insert("CEDAR_ZERO_COPY", "true");
+	bool ok = check_transfer(0, 0);
+	param_insert("CEDAR_ZERO_COPY", "");
+	if ( ! ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+#else
+
+bool OTEST_ZeroCopy(void) {
+	emit_object("ZeroCopy");
+	emit_comment("sendfile() and splice() are only used on Linux.");
+	return true;
+}
+
+#endif
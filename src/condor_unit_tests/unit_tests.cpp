@@ -63,6 +63,15 @@ bool OTEST_TmpDir(void);
 bool OTEST_StatInfo(void);
 bool OTEST_condor_sockaddr();
 bool OTEST_ranger();
+bool OTEST_TimerManager();
+bool OTEST_ClassAdLog();
+bool OTEST_HistoryIndex();
+bool OTEST_HistoryArchive();
+bool OTEST_Selector();
+bool OTEST_Crypt_AESGCM();
+bool OTEST_Compress();
+bool OTEST_ParallelIsAMatch();
+bool OTEST_ZeroCopy();
 
 	// function map that maps testing function names to testing functions
 const static struct {
@@ -98,6 +107,15 @@ const static struct {
 	map(OTEST_StatInfo),
 	map(OTEST_condor_sockaddr),
 	map(OTEST_ranger),
+	map(OTEST_TimerManager),
+	map(OTEST_ClassAdLog),
+	map(OTEST_HistoryIndex),
+	map(OTEST_HistoryArchive),
+	map(OTEST_Selector),
+	map(OTEST_Crypt_AESGCM),
+	map(OTEST_Compress),
+	map(OTEST_ParallelIsAMatch),
+	map(OTEST_ZeroCopy),
 };
 int function_map_num_elems = sizeof(function_map) / sizeof(function_map[0]);
 
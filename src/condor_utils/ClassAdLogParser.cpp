@@ -164,8 +164,18 @@ ClassAdLogParser::readLogEntry(int &op_type)
         return FILE_READ_EOF;
     }
 
+	// a binary entry is read whole, and then taken apart below
+	LogRecordBody body;
+	bool binary = false;
     if(log_fp) {
-	    rval = readHeader(log_fp, op_type);
+		int ch = fgetc(log_fp);
+		if (ch != EOF) ungetc(ch, log_fp);
+		if (is_binary_log_record(ch)) {
+			binary = true;
+			rval = op_type = ReadBinaryLogRecord(log_fp, body);
+		} else {
+			rval = readHeader(log_fp, op_type);
+		}
 	    if (rval < 0) {
 		    closeFile();
 		    return FILE_READ_EOF;
@@ -180,7 +190,13 @@ ClassAdLogParser::readLogEntry(int &op_type)
 
 
 		// read a ClassAd Log Entry Body
-	if(log_fp) {
+	if(log_fp && binary) {
+		rval = readBinaryBody(body, op_type);
+		if (rval == -2) {
+			closeFile();
+			return FILE_READ_ERROR;
+		}
+	} else if(log_fp) {
 		switch(op_type) {
 		    case CondorLogOp_LogHistoricalSequenceNumber:
 		    rval = readLogHistoricalSNBody(log_fp);
@@ -232,12 +248,26 @@ ClassAdLogParser::readLogEntry(int &op_type)
 			return FILE_FATAL_ERROR;
 		}
 
-		while( -1 != readline( log_fp, line ) ) {
-			int rv = sscanf( line, "%d ", &op );
-			free(line);
-			if( rv != 1 ) {
-					// no op field in line; more bad log records...
-				continue;
+		int		ch;
+		while( (ch = fgetc( log_fp )) != EOF ) {
+			ungetc( ch, log_fp );
+			if( is_binary_log_record( ch ) ) {
+					// binary entries say how long they are, so skip whole entries
+				LogRecordBody skipped;
+				op = ReadBinaryLogRecord( log_fp, skipped );
+				if( op < 0 ) {
+					break;
+				}
+			} else {
+				if( -1 == readline( log_fp, line ) ) {
+					break;
+				}
+				int rv = sscanf( line, "%d ", &op );
+				free(line);
+				if( rv != 1 ) {
+						// no op field in line; more bad log records...
+					continue;
+				}
 			}
 			if( op == CondorLogOp_EndTransaction ) {
 					// aargh!  bad record in transaction.  abort!
@@ -526,6 +556,62 @@ ClassAdLogParser::readLogHistoricalSNBody(FILE *fp)
 }
 
 
+/*! take apart the body of a binary log entry
+ *
+ * \return -2 if op_type is unknown, -1 if the body is malformed
+ */
+int
+ClassAdLogParser::readBinaryBody(LogRecordBody & body, int op_type)
+{
+	curCALogEntry.init(op_type);
+
+	bool ok = true;
+	switch(op_type) {
+		case CondorLogOp_LogHistoricalSequenceNumber: {
+			unsigned long long seq, stamp;
+			ok = body.getVarint(seq) && body.getVarint(stamp);
+			if (ok) {
+					// present the entry as the text form would
+				char buf[100];
+				snprintf(buf, sizeof(buf), "%llu", seq);
+				curCALogEntry.key = strdup(buf);
+				curCALogEntry.name = strdup("CreationTimestamp");
+				snprintf(buf, sizeof(buf), "%llu", stamp);
+				curCALogEntry.value = strdup(buf);
+			}
+			break;
+		}
+		case CondorLogOp_NewClassAd:
+			ok = body.getString(curCALogEntry.key) &&
+				body.getName(curCALogEntry.mytype) &&
+				body.getName(curCALogEntry.targettype);
+			break;
+		case CondorLogOp_DestroyClassAd:
+			ok = body.getString(curCALogEntry.key);
+			break;
+		case CondorLogOp_SetAttribute:
+			ok = body.getString(curCALogEntry.key) &&
+				body.getName(curCALogEntry.name) &&
+				body.getValue(curCALogEntry.value, NULL);
+			break;
+		case CondorLogOp_DeleteAttribute:
+			ok = body.getString(curCALogEntry.key) &&
+				body.getName(curCALogEntry.name);
+			break;
+		case CondorLogOp_BeginTransaction:
+			break;
+		case CondorLogOp_EndTransaction:
+			if ( ! body.atEnd()) {
+				ok = body.getString(curCALogEntry.value);
+			}
+			break;
+		default:
+			return -2;
+	}
+		// a body with more in it than the entry uses has a bad length
+	return ( ok && body.atEnd() ) ? 0 : -1;
+}
+
 int
 ClassAdLogParser::readHeader(FILE *fp, int& op_type)
 {
@@ -28,6 +28,8 @@
 #include "condor_io.h"
 #endif
 
+class LogRecordBody;
+
 enum ParserErrCode {    PARSER_FAILURE,
 						PARSER_SUCCESS};
 
@@ -121,6 +123,7 @@ private:
 	int 	readDeleteAttributeBody(FILE *fp);
 	int 	readBeginTransactionBody(FILE *fp);
 	int 	readEndTransactionBody(FILE *fp);
+	int 	readBinaryBody(LogRecordBody & body, int op_type);
 		
 		//
 		// data
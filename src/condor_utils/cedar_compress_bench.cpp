@@ -0,0 +1,233 @@
+// Measures how much CEDAR compression shrinks a collector query reply
+// and what it costs, by sending machine-like ClassAds over a socketpair
+// with each combination of compression and encryption.
+//
+// usage: condor_cedar_compress_bench [-n <ads>]
+//
+// For each case, a child process sends the ads to its parent in one
+// message, the way the collector answers a query.  The parent checks
+// that each ad arrived intact.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "reli_sock.h"
+#include "condor_compress.h"
+#include "generic_stats.h"
+
+#include <stdio.h>
+#include <string>
+
+extern stats_entry_recent<int64_t> cedar_decompress_bytes_in;
+extern stats_entry_recent<int64_t> cedar_decompress_bytes_out;
+
+struct BenchCase {
+	const char * name;
+	const char * compression;	// NULL for none
+	Protocol protocol;		// encryption, if any
+};
+
+static const BenchCase bench_cases[] = {
+	{ "NONE", NULL, CONDOR_NO_PROTOCOL },
+	{ "ZLIB", "ZLIB", CONDOR_NO_PROTOCOL },
+	{ "AESGCM", NULL, CONDOR_AESGCM },
+	{ "AESGCM+ZLIB", "ZLIB", CONDOR_AESGCM },
+};
+
+static void
+usage( const char * name ) {
+	fprintf( stderr, "usage: %s [-n <ads>]\n", name );
+	exit( 1 );
+}
+
+	// Something like what a partitionable slot advertises.  The values
+	// that change from machine to machine are what keep the ads from
+	// compressing to nothing.
+static void
+make_ad( ClassAd & ad, int i ) {
+	std::string name;
+	formatstr( name, "slot1@exec%05d.cluster.example.edu", i );
+	ad.Assign( ATTR_NAME, name );
+	ad.Assign( ATTR_MACHINE, name.c_str() + 6 );
+	formatstr( name, "<10.%d.%d.%d:9618?addrs=10.%d.%d.%d-9618&alias=exec%05d.cluster.example.edu&noUDP&sock=startd_%d_%04x>",
+		(i >> 16) & 255, (i >> 8) & 255, i & 255,
+		(i >> 16) & 255, (i >> 8) & 255, i & 255, i, 1000 + i % 9000, i * 7919 & 0xffff );
+	ad.Assign( ATTR_MY_ADDRESS, name );
+	ad.Assign( ATTR_STARTD_IP_ADDR, name );
+	ad.Assign( ATTR_ARCH, "X86_64" );
+	ad.Assign( ATTR_OPSYS, "LINUX" );
+	ad.Assign( "OpSysAndVer", "CentOS7" );
+	ad.Assign( "OpSysLongName", "CentOS Linux release 7.9.2009 (Core)" );
+	ad.Assign( ATTR_CONDOR_VERSION, "$CondorVersion: 8.9.11 Dec 28 2020 BuildID: 526068 PackageID: 8.9.11-1 $" );
+	ad.Assign( ATTR_PLATFORM, "$CondorPlatform: x86_64_CentOS7 $" );
+	ad.Assign( ATTR_STATE, (i % 3) ? "Claimed" : "Unclaimed" );
+	ad.Assign( ATTR_ACTIVITY, (i % 3) ? "Busy" : "Idle" );
+	ad.Assign( ATTR_CPUS, 1 + i % 32 );
+	ad.Assign( ATTR_TOTAL_CPUS, 32 );
+	ad.Assign( ATTR_MEMORY, 2048 + (i * 37) % 126000 );
+	ad.Assign( ATTR_TOTAL_MEMORY, 128000 );
+	ad.Assign( ATTR_DISK, 100000000 + (i * 104729) % 900000000 );
+	ad.Assign( ATTR_LOAD_AVG, (i % 100) / 10.0 );
+	ad.Assign( ATTR_KEYBOARD_IDLE, 100000 + i );
+	ad.Assign( ATTR_MIPS, 20000 + i % 1000 );
+	ad.Assign( ATTR_KFLOPS, 1500000 + i % 100000 );
+	ad.Assign( ATTR_DAEMON_START_TIME, 1609000000 + i );
+	ad.Assign( ATTR_LAST_HEARD_FROM, 1609800000 + i % 300 );
+	ad.Assign( ATTR_SLOT_TYPE, "Partitionable" );
+	ad.Assign( "HasFileTransfer", true );
+	ad.Assign( "HasJobDeferral", true );
+	ad.Assign( "HasSingularity", (i % 2) == 0 );
+	ad.Assign( "FileSystemDomain", "cluster.example.edu" );
+	ad.Assign( "UidDomain", "cluster.example.edu" );
+	ad.Assign( "JobStarts", i % 500 );
+	ad.Assign( "RecentJobStarts", i % 20 );
+	ad.Assign( "TotalTimeClaimedBusy", 86400 + i * 13 );
+	ad.Assign( "TotalTimeUnclaimedIdle", 3600 + i * 3 );
+	ad.Assign( "CpuFamily", 6 );
+	ad.Assign( "CpuModelNumber", 85 );
+	ad.Assign( "CpuCacheSize", 25344 );
+	ad.Assign( "DetectedMemory", 128000 );
+	ad.Assign( "DetectedCpus", 32 );
+	ad.Assign( "StarterAbilityList", "HasFileTransfer,HasJobDeferral,HasTDP,HasVM,HasReconnect,HasMPI,HasFileTransferPluginMethods,HasJICLocalConfig,HasJICLocalStdin,HasPerFileEncryption,HasSelfCheckpointTransfers" );
+	ad.Assign( "HasFileTransferPluginMethods", "box,gdrive,https,http,ftp,s3,onedrive,file,data,dav,davs" );
+	ad.AssignExpr( ATTR_START, "(TARGET.RequestMemory <= MY.Memory) && (TARGET.RequestCpus <= MY.Cpus) && (TARGET.RequestDisk <= MY.Disk)" );
+	ad.AssignExpr( ATTR_REQUIREMENTS, "START && (WithinResourceLimits)" );
+	ad.AssignExpr( ATTR_RANK, "0.0" );
+	ad.AssignExpr( "WithinResourceLimits", "(MY.Cpus > 0 && TARGET.RequestCpus <= MY.Cpus && MY.Memory > 0 && TARGET.RequestMemory <= MY.Memory && MY.Disk > 0 && TARGET.RequestDisk <= MY.Disk)" );
+}
+
+static void
+setup_sock( ReliSock & sock, const BenchCase & bc ) {
+	sock.timeout( 60 );
+
+	if( bc.protocol != CONDOR_NO_PROTOCOL ) {
+		unsigned char keybuf[24];
+		for( int i = 0; i < (int)sizeof(keybuf); i++ ) {
+			keybuf[i] = (unsigned char)i;
+		}
+		KeyInfo key( keybuf, sizeof(keybuf), bc.protocol );
+		if( ! sock.set_crypto_key( true, &key ) ) {
+			EXCEPT( "failed to set %s crypto key", bc.name );
+		}
+	}
+	if( bc.compression && ! sock.set_compression( bc.compression ) ) {
+		EXCEPT( "failed to turn on %s compression", bc.compression );
+	}
+}
+
+	// Returns true if the ads were sent.
+static bool
+send_ads( ReliSock & sock, int num_ads ) {
+	sock.encode();
+	for( int i = 0; i < num_ads; i++ ) {
+		ClassAd ad;
+		make_ad( ad, i );
+		if( ! putClassAd( &sock, ad ) ) {
+			return false;
+		}
+	}
+	return sock.end_of_message();
+}
+
+	// Returns true if all of the ads arrived intact.
+static bool
+receive_ads( ReliSock & sock, int num_ads ) {
+	sock.decode();
+	for( int i = 0; i < num_ads; i++ ) {
+		ClassAd ad, expected;
+		if( ! getClassAd( &sock, ad ) ) {
+			fprintf( stderr, "failed to receive ad %d\n", i );
+			return false;
+		}
+		make_ad( expected, i );
+		if( ! ad.SameAs( &expected ) ) {
+			fprintf( stderr, "ad %d was corrupted\n", i );
+			return false;
+		}
+	}
+	return sock.end_of_message();
+}
+
+	// Returns the number of ads received per second, or a negative
+	// number on failure.  Building and checking the ads is counted, so
+	// this is most useful compared to the NONE case.
+static double
+run_case( const BenchCase & bc, int num_ads ) {
+	ReliSock sender, receiver;
+	if( ! sender.connect_socketpair( receiver ) ) {
+		EXCEPT( "failed to connect loopback sockets" );
+	}
+	setup_sock( sender, bc );
+	setup_sock( receiver, bc );
+
+	pid_t pid = fork();
+	if( pid < 0 ) {
+		EXCEPT( "fork() failed: %s", strerror(errno) );
+	}
+	if( pid == 0 ) {
+		receiver.close();
+		_exit( send_ads( sender, num_ads ) ? 0 : 1 );
+	}
+	sender.close();
+
+	double start = _condor_debug_get_time_double();
+	bool ok = receive_ads( receiver, num_ads );
+	double elapsed = _condor_debug_get_time_double() - start;
+	receiver.close();
+
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	if( ! ok || ! WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+		return -1;
+	}
+	return num_ads / elapsed;
+}
+
+int
+main( int argc, char * argv [] ) {
+	int num_ads = 20000;
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+			num_ads = atoi( argv[++i] );
+		} else {
+			usage( argv[0] );
+		}
+	}
+	if( num_ads < 1 ) {
+		usage( argv[0] );
+	}
+
+	set_priv_initialize();
+	config();
+	dprintf_config_tool_on_error( 0 );
+	dprintf_OnExitDumpOnErrorBuffer( stderr );
+
+	if( ! *Condor_Compress::supportedMethods() ) {
+		fprintf( stderr, "this build does not support compression\n" );
+		return 1;
+	}
+
+	int failures = 0;
+	printf( "%-12s %10s %12s %12s %8s\n", "CASE", "ads/s", "sent MB", "wire MB", "ratio" );
+	for( size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++ ) {
+		const BenchCase & bc = bench_cases[i];
+		int64_t wire_before = cedar_decompress_bytes_in.value;
+		int64_t plain_before = cedar_decompress_bytes_out.value;
+		double rate = run_case( bc, num_ads );
+		if( rate < 0 ) {
+			printf( "%-12s %10s\n", bc.name, "FAILED" );
+			failures++;
+		} else if( bc.compression ) {
+			double wire = (double)(cedar_decompress_bytes_in.value - wire_before);
+			double plain = (double)(cedar_decompress_bytes_out.value - plain_before);
+			printf( "%-12s %10.0f %12.1f %12.1f %8.1f\n", bc.name, rate,
+				plain / (1024 * 1024), wire / (1024 * 1024), wire ? plain / wire : 0.0 );
+		} else {
+			printf( "%-12s %10.0f %12s %12s %8s\n", bc.name, rate, "-", "-", "-" );
+		}
+		fflush( stdout );
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+// Measures how fast a ReliSock can move data over a socketpair with each
+// of the CEDAR crypto methods.
+//
+// usage: condor_cedar_crypto_bench [-s <megabytes>]
+//
+// For each method, a child process sends the data to its parent in 64KB
+// pieces, once the way ReliSock::put_file() does (put_bytes_nobuffer())
+// and once in ordinary messages, with and without integrity checks.
+// AESGCM provides integrity itself, so it should not be slower with them.
+// The parent checks that the data arrived intact.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "reli_sock.h"
+#include "condor_md.h"
+
+#include <stdio.h>
+
+static const int CHUNK_SIZE = 65536;
+
+struct BenchCase {
+	const char * name;
+	Protocol protocol;
+	bool mac;
+};
+
+static const BenchCase bench_cases[] = {
+	{ "NONE", CONDOR_NO_PROTOCOL, false },
+	{ "NONE", CONDOR_NO_PROTOCOL, true },
+	{ "BLOWFISH", CONDOR_BLOWFISH, false },
+	{ "BLOWFISH", CONDOR_BLOWFISH, true },
+	{ "3DES", CONDOR_3DES, false },
+	{ "3DES", CONDOR_3DES, true },
+	{ "AESGCM", CONDOR_AESGCM, false },
+	{ "AESGCM", CONDOR_AESGCM, true },
+};
+
+static void
+usage( const char * name ) {
+	fprintf( stderr, "usage: %s [-s <megabytes>]\n", name );
+	exit( 1 );
+}
+
+static void
+fill_chunk( char * buf, int chunk ) {
+	for( int i = 0; i < CHUNK_SIZE; i++ ) {
+		buf[i] = (char)(chunk + i * 7);
+	}
+}
+
+static void
+setup_sock( ReliSock & sock, int fd, const BenchCase & bc ) {
+	sock.assignDomainSocket( fd );
+	sock.timeout( 60 );
+
+	unsigned char keybuf[24];
+	for( int i = 0; i < (int)sizeof(keybuf); i++ ) {
+		keybuf[i] = (unsigned char)i;
+	}
+	KeyInfo key( keybuf, sizeof(keybuf), bc.protocol );
+	if( bc.mac ) {
+		sock.set_MD_mode( MD_ALWAYS_ON, &key );
+	}
+	if( bc.protocol != CONDOR_NO_PROTOCOL && ! sock.set_crypto_key( true, &key ) ) {
+		EXCEPT( "failed to set %s crypto key", bc.name );
+	}
+}
+
+	// Returns true if the data was sent.
+static bool
+send_data( ReliSock & sock, int chunks, bool nobuffer ) {
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf );
+	sock.encode();
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		fill_chunk( buf, c );
+		if( nobuffer ) {
+			ok = sock.put_bytes_nobuffer( buf, CHUNK_SIZE, 0 ) == CHUNK_SIZE;
+		} else {
+			ok = sock.put_bytes( buf, CHUNK_SIZE ) == CHUNK_SIZE && sock.end_of_message();
+		}
+	}
+	free( buf );
+	return ok;
+}
+
+	// Returns true if all of the data arrived intact.
+static bool
+receive_data( ReliSock & sock, int chunks, bool nobuffer ) {
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	char * expected = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf && expected );
+	sock.decode();
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		if( nobuffer ) {
+			ok = sock.get_bytes_nobuffer( buf, CHUNK_SIZE, 0 ) == CHUNK_SIZE;
+		} else {
+			ok = sock.get_bytes( buf, CHUNK_SIZE ) == CHUNK_SIZE && sock.end_of_message();
+		}
+		fill_chunk( expected, c );
+		if( ok && memcmp( buf, expected, CHUNK_SIZE ) != 0 ) {
+			fprintf( stderr, "data in chunk %d was corrupted\n", c );
+			ok = false;
+		}
+	}
+	free( buf );
+	free( expected );
+	return ok;
+}
+
+	// Returns the throughput in MB/s, or a negative number on failure.
+static double
+run_case( const BenchCase & bc, int chunks, bool nobuffer ) {
+	int sv[2];
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 ) {
+		EXCEPT( "socketpair() failed: %s", strerror(errno) );
+	}
+
+	pid_t pid = fork();
+	if( pid < 0 ) {
+		EXCEPT( "fork() failed: %s", strerror(errno) );
+	}
+	if( pid == 0 ) {
+		close( sv[0] );
+		ReliSock sock;
+		setup_sock( sock, sv[1], bc );
+		_exit( send_data( sock, chunks, nobuffer ) ? 0 : 1 );
+	}
+
+	close( sv[1] );
+	ReliSock sock;
+	setup_sock( sock, sv[0], bc );
+	double start = _condor_debug_get_time_double();
+	bool ok = receive_data( sock, chunks, nobuffer );
+	double elapsed = _condor_debug_get_time_double() - start;
+	sock.close();
+
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	if( ! ok || ! WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+		return -1;
+	}
+	return (double)chunks * CHUNK_SIZE / (1024 * 1024) / elapsed;
+}
+
+int
+main( int argc, char * argv [] ) {
+	int megabytes = 256;
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) {
+			megabytes = atoi( argv[++i] );
+		} else {
+			usage( argv[0] );
+		}
+	}
+	if( megabytes < 1 ) {
+		usage( argv[0] );
+	}
+	int chunks = megabytes * (1024 * 1024 / CHUNK_SIZE);
+
+	set_priv_initialize();
+	config();
+	dprintf_config_tool_on_error( 0 );
+	dprintf_OnExitDumpOnErrorBuffer( stderr );
+
+	int failures = 0;
+	printf( "%-10s %-4s %14s %14s\n", "METHOD", "MAC", "put_file MB/s", "message MB/s" );
+	for( size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++ ) {
+		const BenchCase & bc = bench_cases[i];
+		double file_rate = run_case( bc, chunks, true );
+		double msg_rate = run_case( bc, chunks, false );
+		if( file_rate < 0 || msg_rate < 0 ) {
+			failures++;
+		}
+		printf( "%-10s %-4s %14.1f %14.1f\n", bc.name, bc.mac ? "yes" : "no",
+			file_rate, msg_rate );
+		fflush( stdout );
+	}
+	return failures ? 1 : 0;
+}
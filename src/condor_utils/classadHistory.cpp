@@ -27,8 +27,13 @@
 #include "util_lib_proto.h" // for rotate_file
 #include "iso_dates.h"
 #include "condor_email.h"
+#include "stl_string_utils.h"
+#include "condor_daemon_core.h" // for archiving in a child process
 
 #include "classadHistory.h"
+#include "history_archive.h"
+
+#include <deque>
 
 static FILE *HistoryFile_fp = NULL;
 static int HistoryFile_RefCount = 0;
@@ -41,16 +46,34 @@ bool        DoMonthlyHistoryRotation = true;
 filesize_t  MaxHistoryFileSize = 20 * 1024 * 1024; // 20MB;
 int         NumberBackupHistoryFiles = 2;
 char*       PerJobHistoryDir = NULL;
+bool        DoHistoryIndex = true;
+bool        DoHistoryArchive = false;
+
+// the index of the history file, see HistoryIndexEntry.
+static FILE *HistoryIndex_fp = NULL;
+static long long HistoryIndex_end = 0; // offset in the history file of the end of the last indexed ad
+static bool HistoryIndex_unusable = false; // true when the current history file can't be indexed
+
+// rotated history files waiting to be archived, and the child archiving one
+static std::deque<std::string> HistoryArchive_pending;
+static std::string HistoryArchive_current;
+static int HistoryArchive_tid = -1;
+static int HistoryArchive_reaper_id = -1;
 
 static void MaybeRotateHistory(int size_to_append);
 static void RemoveExtraHistoryFiles(void);
 static int MaybeDeleteOneHistoryBackup(void);
 static bool IsHistoryFilename(const char *filename, time_t *backup_time);
 static void RotateHistory(void);
+static void StartHistoryArchive(void);
+static bool ArchiveHistoryFile(const char *history_name);
 static int findHistoryOffset(FILE *LogFile);
 static FILE* OpenHistoryFile();
 static void CloseJobHistoryFile();
 static void RelinquishHistoryFile(FILE *fp);
+static void AppendHistoryIndex(ClassAd *ad, long long start, long long end);
+static void CloseHistoryIndex(bool remove);
+static bool ReadLastHistoryIndexEntry(FILE *fp, HistoryIndexEntry & entry);
 
 // --------------------------------------------------------------------------
 // --------- PUBLIC FUNCTIONS (called by schedd, startd, etc) ---------------
@@ -82,6 +105,8 @@ InitJobHistoryFile(const char *history_param, const char *per_job_history_param)
     NumberBackupHistoryFiles = param_integer("MAX_HISTORY_ROTATIONS", 
                                           2,  // default
                                           1); // minimum
+    DoHistoryIndex = param_boolean("ENABLE_HISTORY_INDEX", true);
+    DoHistoryArchive = param_boolean("ENABLE_HISTORY_ARCHIVE", false);
 
     if (DoHistoryRotation) {
         dprintf(D_ALWAYS, "History file rotation is enabled.\n");
@@ -144,6 +169,7 @@ AppendHistory(ClassAd* ad)
 	  failed = true;
   } else {
 	  int offset = findHistoryOffset(LogFile);
+	  long long start = ftell(LogFile);
 	  if (!fPrintAd(LogFile, *ad)) {
 		  dprintf(D_ALWAYS, 
 				  "ERROR: failed to write job class ad to history file %s\n",
@@ -169,6 +195,7 @@ AppendHistory(ClassAd* ad)
                       "*** Offset = %d ClusterId = %d ProcId = %d Owner = \"%s\" CompletionDate = %d\n",
 				  offset, cluster, proc, owner.c_str(), completion);
 		  fflush( LogFile );
+		  AppendHistoryIndex(ad, start, ftell(LogFile));
       }
   }
 
@@ -283,6 +310,245 @@ WritePerJobHistoryFile(ClassAd* ad, bool useGjid)
     }
 }
 
+// --------------------------------------------------------------------------
+// The history index
+// --------------------------------------------------------------------------
+
+bool
+IsHistoryIndexFilename(const char * filename)
+{
+	size_t len = strlen(filename);
+	size_t cchSuffix = sizeof(HISTORY_INDEX_SUFFIX)-1;
+	return len > cchSuffix && MATCH == strcmp(filename + len - cchSuffix, HISTORY_INDEX_SUFFIX);
+}
+
+bool
+HistoryIndexEntry::IsIndexedAttr(const char * attr)
+{
+	return MATCH == strcasecmp(attr, ATTR_CLUSTER_ID) ||
+		MATCH == strcasecmp(attr, ATTR_PROC_ID) ||
+		MATCH == strcasecmp(attr, ATTR_COMPLETION_DATE) ||
+		MATCH == strcasecmp(attr, ATTR_OWNER);
+}
+
+bool
+HistoryIndexEntry::IsExact() const
+{
+	return cluster_state != Unknown && proc_state != Unknown &&
+		completion_date_state != Unknown && owner_state != Unknown;
+}
+
+void
+HistoryIndexEntry::ToClassAd(ClassAd & ad) const
+{
+	if (cluster_state == Known) ad.InsertAttr(ATTR_CLUSTER_ID, cluster);
+	if (proc_state == Known) ad.InsertAttr(ATTR_PROC_ID, proc);
+	if (completion_date_state == Known) ad.InsertAttr(ATTR_COMPLETION_DATE, completion_date);
+	if (owner_state == Known) ad.InsertAttr(ATTR_OWNER, owner);
+}
+
+// only literal values are Known, since a query could tell an expression
+// from its value.
+static HistoryIndexEntry::State
+IndexIntegerAttr(ClassAd & ad, const char * attr, long long & value)
+{
+	ExprTree * tree = ad.Lookup(attr);
+	if ( ! tree) {
+		return HistoryIndexEntry::Absent;
+	}
+	classad::Value val;
+	if (ExprTreeIsLiteral(tree, val) && val.IsIntegerValue(value)) {
+		return HistoryIndexEntry::Known;
+	}
+	return HistoryIndexEntry::Unknown;
+}
+
+void
+HistoryIndexEntry::FromJobAd(ClassAd & ad, long long start_offset, long long end_offset)
+{
+	start = start_offset;
+	end = end_offset;
+	cluster_state = IndexIntegerAttr(ad, ATTR_CLUSTER_ID, cluster);
+	proc_state = IndexIntegerAttr(ad, ATTR_PROC_ID, proc);
+	completion_date_state = IndexIntegerAttr(ad, ATTR_COMPLETION_DATE, completion_date);
+
+	owner_state = Absent;
+	ExprTree * tree = ad.Lookup(ATTR_OWNER);
+	if (tree) {
+		owner_state = Unknown;
+		if (ExprTreeIsLiteralString(tree, owner) && owner.find_first_of("\"\\\r\n") == std::string::npos) {
+			owner_state = Known;
+		}
+	}
+}
+
+// Each entry is a line of the form
+//    <start> <end> <ClusterId> <ProcId> <CompletionDate> <Owner>
+// where each attribute is a value, or - when the ad does not have it,
+// or ? when it is in the ad but not as a literal value.  Owner values
+// are quoted.
+void
+HistoryIndexEntry::Format(std::string & line) const
+{
+	formatstr(line, "%lld %lld", start, end);
+	const long long * values[] = { &cluster, &proc, &completion_date };
+	const State states[] = { cluster_state, proc_state, completion_date_state };
+	for (int ix = 0; ix < 3; ++ix) {
+		if (states[ix] == Known) {
+			formatstr_cat(line, " %lld", *values[ix]);
+		} else {
+			formatstr_cat(line, " %c", (char)states[ix]);
+		}
+	}
+	if (owner_state == Known) {
+		formatstr_cat(line, " \"%s\"\n", owner.c_str());
+	} else {
+		formatstr_cat(line, " %c\n", (char)owner_state);
+	}
+}
+
+static const char *
+ParseHistoryIndexValue(const char * p, long long & value, HistoryIndexEntry::State & state)
+{
+	while (*p == ' ') ++p;
+	if ((*p == HistoryIndexEntry::Absent || *p == HistoryIndexEntry::Unknown) && (p[1] == ' ' || ! p[1])) {
+		state = (HistoryIndexEntry::State)*p;
+		return p + 1;
+	}
+	char * pend = NULL;
+	value = strtoll(p, &pend, 10);
+	if (pend == p) {
+		return NULL;
+	}
+	state = HistoryIndexEntry::Known;
+	return pend;
+}
+
+bool
+HistoryIndexEntry::Parse(const char * line)
+{
+	char * pend = NULL;
+	start = strtoll(line, &pend, 10);
+	if (pend == line || *pend != ' ') return false;
+	const char * p = pend;
+	end = strtoll(p, &pend, 10);
+	if (pend == p || end <= start) return false;
+	p = pend;
+	if ( ! (p = ParseHistoryIndexValue(p, cluster, cluster_state))) return false;
+	if ( ! (p = ParseHistoryIndexValue(p, proc, proc_state))) return false;
+	if ( ! (p = ParseHistoryIndexValue(p, completion_date, completion_date_state))) return false;
+	while (*p == ' ') ++p;
+	if (*p == '"') {
+		const char * pquote = strchr(p+1, '"');
+		if ( ! pquote) return false;
+		owner.assign(p+1, pquote - p - 1);
+		owner_state = Known;
+	} else if (*p == Absent || *p == Unknown) {
+		owner_state = (State)*p;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool
+ReadHistoryIndex(const char * history_file, std::vector<HistoryIndexEntry> & entries)
+{
+	entries.clear();
+
+	std::string index_name(history_file);
+	index_name += HISTORY_INDEX_SUFFIX;
+	FILE * fp = safe_fopen_wrapper_follow(index_name.c_str(), "r");
+	if ( ! fp) {
+		return false;
+	}
+
+	bool valid = true;
+	std::string line;
+	HistoryIndexEntry entry;
+	long long end = 0;
+	while (readLine(line, fp)) {
+		chomp(line);
+		// the entries must follow each other from the beginning of the history file
+		if ( ! entry.Parse(line.c_str()) || entry.start != end) {
+			valid = false;
+			break;
+		}
+		end = entry.end;
+		entries.push_back(entry);
+	}
+	fclose(fp);
+
+	// the history file may have been written since it was indexed, or not indexed at all.
+	StatInfo history_stat_info(history_file);
+	if ( ! valid || history_stat_info.Error() != SIGood || history_stat_info.GetFileSize() != end) {
+		entries.clear();
+		return false;
+	}
+	return true;
+}
+
+bool
+CanEvaluateWithHistoryIndex(ExprTree * tree)
+{
+	classad::References attrs;
+	if ( ! GetUnscopedAttrRefs(tree, attrs)) {
+		return false;
+	}
+	for (classad::References::const_iterator it = attrs.begin(); it != attrs.end(); ++it) {
+		if ( ! HistoryIndexEntry::IsIndexedAttr(it->c_str())) return false;
+	}
+	return true;
+}
+
+// and together the clauses of the constraint that can be evaluated with the index
+static void
+AddHistoryIndexClauses(ExprTree * tree, ExprTree *& index_expr)
+{
+	tree = SkipExprParens(tree);
+	if (tree->GetKind() == ExprTree::OP_NODE) {
+		classad::Operation::OpKind op;
+		ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+		((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+		if (op == classad::Operation::LOGICAL_AND_OP) {
+			AddHistoryIndexClauses(t1, index_expr);
+			AddHistoryIndexClauses(t2, index_expr);
+			return;
+		}
+	}
+	if (CanEvaluateWithHistoryIndex(tree)) {
+		if (index_expr) {
+			ExprTree * joined = JoinExprTreeCopiesWithOp(classad::Operation::LOGICAL_AND_OP, index_expr, tree);
+			delete index_expr;
+			index_expr = joined;
+		} else {
+			index_expr = tree->Copy();
+		}
+	}
+}
+
+ExprTree *
+MakeHistoryIndexConstraint(ExprTree * constraint)
+{
+	if ( ! constraint) {
+		return NULL;
+	}
+	ExprTree * index_expr = NULL;
+	AddHistoryIndexClauses(constraint, index_expr);
+	return index_expr;
+}
+
+bool
+HistoryIndexEntry::MayMatch(ExprTree * index_constraint) const
+{
+	if ( ! index_constraint || ! IsExact()) {
+		return true;
+	}
+	ClassAd index_ad;
+	ToClassAd(index_ad);
+	return EvalExprBool(&index_ad, index_constraint);
+}
+
 // --------------------------------------------------------------------------
 // ------ PRIVATE / STATIC FUNCTIONS (implementation specific to this module)
 // --------------------------------------------------------------------------
@@ -333,6 +599,138 @@ CloseJobHistoryFile() {
 		fclose( HistoryFile_fp );
 		HistoryFile_fp = NULL;
 	}
+	CloseHistoryIndex(false);
+}
+
+// --------------------------------------------------------------------------
+// Add the ad that was just written to the history file at offsets start
+// to end to the index.  The index is only written when it describes the
+// history file from the beginning, so a history file that was begun without
+// an index (or whose index could not be written) is not indexed until it
+// is rotated.
+// --------------------------------------------------------------------------
+static void
+AppendHistoryIndex(ClassAd *ad, long long start, long long end)
+{
+	if ( ! DoHistoryIndex || HistoryIndex_unusable) {
+		return;
+	}
+
+	std::string index_name(JobHistoryFileName);
+	index_name += HISTORY_INDEX_SUFFIX;
+
+	if ( ! HistoryIndex_fp) {
+		int flags = O_RDWR|O_APPEND|O_LARGEFILE|_O_NOINHERIT;
+		if (start == 0) { flags |= O_CREAT; }
+		int fd = safe_open_wrapper_follow(index_name.c_str(), flags, 0644);
+		if (fd < 0) {
+			if (errno != ENOENT) {
+				dprintf(D_ALWAYS, "ERROR opening history index (%s): %s\n",
+						index_name.c_str(), strerror(errno));
+			}
+			HistoryIndex_unusable = true;
+			return;
+		}
+		HistoryIndex_fp = fdopen(fd, "r+");
+		if ( ! HistoryIndex_fp) {
+			dprintf(D_ALWAYS, "ERROR opening history index fp (%s): %s\n",
+					index_name.c_str(), strerror(errno));
+			close(fd);
+			HistoryIndex_unusable = true;
+			return;
+		}
+		HistoryIndexEntry last;
+		if (start == 0) {
+			// a new history file, so any old index is stale
+			if (ftruncate(fd, 0) < 0) {
+				CloseHistoryIndex(true);
+				return;
+			}
+			HistoryIndex_end = 0;
+		} else if (ReadLastHistoryIndexEntry(HistoryIndex_fp, last)) {
+			HistoryIndex_end = last.end;
+		} else {
+			HistoryIndex_end = -1;
+		}
+	}
+
+	if (HistoryIndex_end != start) {
+		dprintf(D_ALWAYS, "History index %s does not match %s, removing it.\n",
+				index_name.c_str(), JobHistoryFileName);
+		CloseHistoryIndex(true);
+		return;
+	}
+
+	HistoryIndexEntry entry;
+	entry.FromJobAd(*ad, start, end);
+	std::string line;
+	entry.Format(line);
+	if (fputs(line.c_str(), HistoryIndex_fp) < 0 || fflush(HistoryIndex_fp) != 0) {
+		dprintf(D_ALWAYS, "ERROR writing history index (%s): %s\n",
+				index_name.c_str(), strerror(errno));
+		CloseHistoryIndex(true);
+		return;
+	}
+	HistoryIndex_end = end;
+}
+
+// --------------------------------------------------------------------------
+// Close the history index.  If remove is true, the index is deleted and no
+// more is written to it until the history file is rotated or reopened.
+// --------------------------------------------------------------------------
+static void
+CloseHistoryIndex(bool remove)
+{
+	if (HistoryIndex_fp) {
+		fclose(HistoryIndex_fp);
+		HistoryIndex_fp = NULL;
+	}
+	if (remove) {
+		std::string index_name(JobHistoryFileName);
+		index_name += HISTORY_INDEX_SUFFIX;
+		unlink(index_name.c_str());
+		HistoryIndex_unusable = true;
+	} else {
+		HistoryIndex_unusable = false;
+	}
+}
+
+// --------------------------------------------------------------------------
+// Read the last entry in a history index.  Returns false if the index is
+// empty or does not end with a complete entry.
+// --------------------------------------------------------------------------
+static bool
+ReadLastHistoryIndexEntry(FILE *fp, HistoryIndexEntry & entry)
+{
+	const long long MAX_ENTRY = 4096;
+	if (fseek(fp, 0, SEEK_END) < 0) {
+		return false;
+	}
+	long long size = ftell(fp);
+	if (size <= 0) {
+		return false;
+	}
+	long long begin = (size > MAX_ENTRY) ? size - MAX_ENTRY : 0;
+	std::string buf;
+	buf.resize(size - begin);
+	if (fseek(fp, begin, SEEK_SET) < 0 ||
+		fread(&buf[0], 1, buf.size(), fp) != buf.size()) {
+		fseek(fp, 0, SEEK_END);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	if (buf[buf.size()-1] != '\n') {
+		return false;
+	}
+	size_t eol = buf.size() - 1;
+	size_t bol = buf.rfind('\n', eol - 1);
+	if (bol == std::string::npos) {
+		if (begin != 0) return false;
+		bol = 0;
+	} else {
+		bol += 1;
+	}
+	return entry.Parse(buf.substr(bol, eol - bol).c_str());
 }
 
 // --------------------------------------------------------------------------
@@ -491,6 +889,10 @@ MaybeDeleteOneHistoryBackup(void)
                     dprintf(D_ALWAYS, "Failed to delete %s\n", oldest_history_filename);
                     num_backups = 0; // prevent looping forever
                 }
+                MyString index_name;
+                index_name.formatstr("%s%c%s%s", history_dir, DIR_DELIM_CHAR,
+                                     oldest_history_filename, HISTORY_INDEX_SUFFIX);
+                unlink(index_name.Value());
             } else {
                 dprintf(D_ALWAYS, "Failed to find/delete %s\n", oldest_history_filename);
                 num_backups = 0; // prevent looping forever
@@ -519,7 +921,8 @@ IsHistoryFilename(const char *filename, time_t *backup_time)
     history_base_length = strlen(history_base);
 
     if (   !strncmp(filename, history_base, history_base_length)
-        && filename[history_base_length] == '.') {
+        && filename[history_base_length] == '.'
+        && !IsHistoryIndexFilename(filename)) {
         // The filename begins correctly, now see if it ends in an 
         // ISO time
         struct tm file_time;
@@ -571,11 +974,124 @@ RotateHistory(void)
         dprintf(D_ALWAYS, "Failed to rotate history file to %s\n",
                 rotated_history_name.Value());
         dprintf(D_ALWAYS, "Because rotation failed, the history file may get very large.\n");
+    } else {
+        // and its index, which must not be left to describe the new history file
+        MyString index_name(JobHistoryFileName);
+        index_name += HISTORY_INDEX_SUFFIX;
+        MyString rotated_index_name(rotated_history_name);
+        rotated_index_name += HISTORY_INDEX_SUFFIX;
+        StatInfo index_stat_info(index_name.Value());
+        if (index_stat_info.Error() == SIGood &&
+            rotate_file(index_name.Value(), rotated_index_name.Value())) {
+            dprintf(D_ALWAYS, "Failed to rotate history index to %s\n",
+                    rotated_index_name.Value());
+            unlink(index_name.Value());
+        }
+
+        if (DoHistoryArchive) {
+            HistoryArchive_pending.push_back(rotated_history_name.Value());
+            StartHistoryArchive();
+        }
     }
 
     return;
 }
 
+// --------------------------------------------------------------------------
+// Archive the rotated history files waiting to be archived, one at a time, in
+// a child process, so the daemon is not blocked while a large file is read
+// and written.  Without DaemonCore (in tools and tests) they are archived
+// before this returns.
+// --------------------------------------------------------------------------
+static int
+ArchiveHistoryFileThread(void * /*arg*/, Stream * /*sock*/)
+{
+    return ArchiveHistoryFile(HistoryArchive_current.c_str()) ? 0 : 1;
+}
+
+static int
+HistoryArchiveReaper(int tid, int exit_status)
+{
+    if (tid != HistoryArchive_tid) {
+        return 0;
+    }
+    HistoryArchive_tid = -1;
+    if ( ! WIFEXITED(exit_status) || WEXITSTATUS(exit_status) != 0) {
+        dprintf(D_ALWAYS, "Archiving history file %s failed (status %d), leaving it as it is\n",
+                HistoryArchive_current.c_str(), exit_status);
+    }
+    StartHistoryArchive();
+    return 0;
+}
+
+static void
+StartHistoryArchive(void)
+{
+    if ( ! daemonCore) {
+        while ( ! HistoryArchive_pending.empty()) {
+            ArchiveHistoryFile(HistoryArchive_pending.front().c_str());
+            HistoryArchive_pending.pop_front();
+        }
+        return;
+    }
+    if (HistoryArchive_tid != -1 || HistoryArchive_pending.empty()) {
+        return;
+    }
+
+    HistoryArchive_current = HistoryArchive_pending.front();
+    HistoryArchive_pending.pop_front();
+    if (HistoryArchive_reaper_id == -1) {
+        HistoryArchive_reaper_id = daemonCore->Register_Reaper(
+            "HistoryArchiveReaper",
+            HistoryArchiveReaper,
+            "HistoryArchiveReaper");
+    }
+    HistoryArchive_tid = daemonCore->Create_Thread(
+        ArchiveHistoryFileThread, NULL, NULL,
+        HistoryArchive_reaper_id);
+    if ( ! HistoryArchive_tid) {
+        HistoryArchive_tid = -1;
+        dprintf(D_ALWAYS, "Failed to create a process to archive history file %s, leaving it as it is\n",
+                HistoryArchive_current.c_str());
+    }
+}
+
+// --------------------------------------------------------------------------
+// Replace a rotated history file with a history archive of the same name.
+// The archive has its own summary of the ads, so the index is removed.
+// If the file can't be archived, it is left as it is and false is returned.
+// --------------------------------------------------------------------------
+static bool
+ArchiveHistoryFile(const char *history_name)
+{
+    // the temporary name must not look like a rotated history file
+    MyString archive_name(JobHistoryFileName);
+    archive_name += ".tmp";
+
+    double begin = _condor_debug_get_time_double();
+    std::string errmsg;
+    if ( ! WriteHistoryArchive(history_name, archive_name.Value(), errmsg)) {
+        dprintf(D_ALWAYS, "Failed to archive history file %s: %s\n",
+                history_name, errmsg.c_str());
+        return false;
+    }
+    StatInfo history_stat_info(history_name);
+    StatInfo archive_stat_info(archive_name.Value());
+    if (rotate_file(archive_name.Value(), history_name)) {
+        dprintf(D_ALWAYS, "Failed to replace history file %s with its archive\n",
+                history_name);
+        unlink(archive_name.Value());
+        return false;
+    }
+    MyString index_name(history_name);
+    index_name += HISTORY_INDEX_SUFFIX;
+    unlink(index_name.Value());
+    dprintf(D_ALWAYS, "Archived history file %s in %.3f seconds, %lld bytes down to %lld\n",
+            history_name, _condor_debug_get_time_double() - begin,
+            (long long)history_stat_info.GetFileSize(), (long long)archive_stat_info.GetFileSize());
+    return true;
+}
+
 // --------------------------------------------------------------------------
 // Figure out how far from the end the beginning of the last line in the
 // history file is. We assume that the file is open. We reset the file pointer
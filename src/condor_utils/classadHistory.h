@@ -29,9 +29,71 @@ extern filesize_t  MaxHistoryFileSize;
 extern int         NumberBackupHistoryFiles;
 extern char*       PerJobHistoryDir;
 extern char* JobHistoryFileName;
+extern bool        DoHistoryIndex;
+extern bool        DoHistoryArchive;
 
 void WritePerJobHistoryFile(ClassAd*, bool);
 void AppendHistory(ClassAd*);
 void InitJobHistoryFile(const char *, const char *);
 
+// An entry in the index that is kept alongside a history file, in a file with
+// the same name plus HISTORY_INDEX_SUFFIX.  The index has a line for each job
+// ad in the history file, in the same order, with the offsets of the ad and the
+// values of a few attributes.  Readers use it to find the ads that can match
+// a query without reading the whole history file.
+#define HISTORY_INDEX_SUFFIX ".idx"
+
+class HistoryIndexEntry {
+public:
+	HistoryIndexEntry()
+		: start(0), end(0), cluster(0), proc(0), completion_date(0)
+		, cluster_state(Absent), proc_state(Absent), completion_date_state(Absent), owner_state(Absent)
+	{}
+
+	long long start;  // offset of the first line of the ad in the history file
+	long long end;    // offset just past the "***" line that ends the ad
+
+	// the value of each attribute, when its state is Known.
+	long long cluster, proc, completion_date;
+	std::string owner;
+	enum State { Absent = '-', Unknown = '?', Known = 'v' };
+	State cluster_state, proc_state, completion_date_state, owner_state;
+
+	// true if all of the attributes are Known or Absent, so the ad made by
+	// ToClassAd() gives the same result as the job ad for an expression
+	// that refers to no other attributes.
+	bool IsExact() const;
+	// insert the Known attributes into ad
+	void ToClassAd(ClassAd & ad) const;
+
+	// false if the job ad can't satisfy index_constraint, which should be made
+	// by MakeHistoryIndexConstraint().  true if it might, or the entry is not exact.
+	bool MayMatch(ExprTree * index_constraint) const;
+
+	void FromJobAd(ClassAd & ad, long long start, long long end);
+	bool Parse(const char * line);
+	void Format(std::string & line) const;
+
+	// true if the named attribute is one of the attributes in the index
+	static bool IsIndexedAttr(const char * attr);
+};
+
+// true if filename is the name of a history index
+bool IsHistoryIndexFilename(const char * filename);
+
+// read the index of the history file into entries.  returns false if the history
+// file has no index, or the index does not describe all of the history file.
+bool ReadHistoryIndex(const char * history_file, std::vector<HistoryIndexEntry> & entries);
+
+// true if the expression gives the same result when it is evaluated against an
+// ad made from an exact history index entry as against the job ad.  This is true
+// when all of the attributes it refers to are in the index.
+bool CanEvaluateWithHistoryIndex(ExprTree * tree);
+
+// Make the constraint used to skip ads using the history index, or NULL if the
+// index can't help.  It is the clauses of the top-level && of constraint that
+// can be evaluated with the index, so a job ad whose index entry does not
+// satisfy it can't satisfy constraint.  The caller must delete it.
+ExprTree * MakeHistoryIndexConstraint(ExprTree * constraint);
+
 #endif
@@ -72,10 +72,11 @@ public:
   /** Constructor (initialization). It reads the log file and initializes
       the class-ads (that are read from the log file) in memory.
     @param filename the name of the log file.
+    @param replay_threads parse the log on this many threads when more than 1.
     @return nothing
   */
-  GenericClassAdCollection(const ConstructLogEntry * pctor,const char* filename,int max_historical_logs=0)
-	: ClassAdLog<K,AD>(filename,max_historical_logs,pctor)
+  GenericClassAdCollection(const ConstructLogEntry * pctor,const char* filename,int max_historical_logs=0,int replay_threads=0)
+	: ClassAdLog<K,AD>(filename,max_historical_logs,pctor,replay_threads)
   {
   }
 
@@ -109,6 +110,17 @@ public:
   */
   void CommitNondurableTransaction(const char * comment=NULL) { ClassAdLog<K,AD>::CommitNondurableTransaction(comment); }
 
+  /** Commit a transaction without forcing a sync to disk, leaving it for
+      the next SyncGroupCommits()
+    @return true if the transaction logged anything
+  */
+  bool CommitGroupTransaction(const char * comment=NULL) { return ClassAdLog<K,AD>::CommitGroupTransaction(comment); }
+
+  /** Force the log to disk if any group committed transactions are not yet synced
+    @return the number of group committed transactions that were not synced
+  */
+  int SyncGroupCommits() { return ClassAdLog<K,AD>::SyncGroupCommits(); }
+
   /** Abort a transaction
     @return true if a transaction aborted, false if no transaction active
   */
@@ -170,11 +182,22 @@ public:
   */
   bool TruncLog() { return ClassAdLog<K,AD>::TruncLog(); }
 
+  /** Truncate the log file without blocking while the repository is written,
+      see ClassAdLog::BeginBackgroundTruncLog
+  */
+  bool BeginBackgroundTruncLog() { return ClassAdLog<K,AD>::BeginBackgroundTruncLog(); }
+  bool WriteSnapshot() { return ClassAdLog<K,AD>::WriteSnapshot(); }
+  bool EndBackgroundTruncLog(bool snapshot_written) { return ClassAdLog<K,AD>::EndBackgroundTruncLog(snapshot_written); }
+  bool InBackgroundTruncLog() { return ClassAdLog<K,AD>::InBackgroundTruncLog(); }
+
   void SetMaxHistoricalLogs(int max) { ClassAdLog<K,AD>::SetMaxHistoricalLogs(max); }
   int GetMaxHistoricalLogs() { return ClassAdLog<K,AD>::GetMaxHistoricalLogs(); }
 
   time_t GetOrigLogBirthdate() { return ClassAdLog<K,AD>::GetOrigLogBirthdate(); }
 
+  void SetBinaryLog(bool binary) { ClassAdLog<K,AD>::SetBinaryLog(binary); }
+  bool GetBinaryLog() { return ClassAdLog<K,AD>::GetBinaryLog(); }
+
   //@}
   //------------------------------------------------------------------------
   /**@name Method to control the class-ads in the repository
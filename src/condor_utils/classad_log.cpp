@@ -30,6 +30,8 @@
 #include "classad_merge.h"
 #include "condor_fsync.h"
 #include "condor_attributes.h"
+#include "classad/classadCache.h"
+#include <thread>
 
 #if defined(HAVE_DLOPEN)
 #include "ClassAdLogPlugin.h"
@@ -64,57 +66,224 @@ const ConstructClassAdLogTableEntry<ClassAd*> DefaultMakeClassAdLogTableEntry;
 #endif
 
 
-// non-templatized worker function that implements the log loading functionality of ClassAdLog
-//
-FILE* LoadClassAdLog(
+static LogRecord * InstantiateUnparsedLogEntry(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor);
+static void LogCorruptLogRecord(LogRecord *log_rec, unsigned long recnum, long long pos);
+static void SkipCorruptLogRecords(FILE *fp, unsigned long recnum, long long pos);
+
+// The log records read by ReplayClassAdLog.  With more than one thread, the
+// records are read ahead in batches, and the values of the SetAttribute records
+// in a batch are parsed on all of the threads at once, each thread taking the
+// records for a share of the keys.  The records are still returned (and so
+// played) one at a time in log order.  A value that fails to parse is handled
+// as InstantiateLogEntry would have handled it while reading the record.
+class LogRecordSource {
+public:
+	LogRecordSource(FILE *fp, const ConstructLogEntry & maker, int threads);
+	~LogRecordSource();
+
+	// returns the next record, or NULL at the end of the log, or after a bad record.
+	LogRecord * Next(unsigned long recnum);
+	// returns the offset of the end of the last record returned by Next()
+	long long Tell() const { return end_pos; }
+
+	int Threads() const { return threads; }
+	double read_time;   // seconds spent reading (and when not threaded, parsing) records
+	double parse_time;  // seconds spent parsing values on the threads
+
+private:
+	bool ReadBatch(unsigned long recnum);
+	void ParseBatch(int partition);
+
+	FILE * fp;
+	const ConstructLogEntry & maker;
+	int threads;
+	bool strict_parsing;
+	bool at_end;
+	long long end_pos;
+	size_t next;
+	std::vector<LogRecord*> batch;
+	std::vector<long long> batch_ends; // offset of the end of each record in the batch
+	std::vector<char> batch_failed;    // true for each record whose value did not parse
+};
+
+// records per batch when replaying on more than one thread.
+#define PARALLEL_REPLAY_BATCH 0x10000
+
+LogRecordSource::LogRecordSource(FILE *fp_arg, const ConstructLogEntry & maker_arg, int threads_arg)
+	: read_time(0)
+	, parse_time(0)
+	, fp(fp_arg)
+	, maker(maker_arg)
+	, threads(threads_arg > 1 ? threads_arg : 1)
+	, strict_parsing(true)
+	, at_end(false)
+	, end_pos(ftell(fp_arg))
+	, next(0)
+{
+	if (threads > 1) {
+		strict_parsing = param_boolean("CLASSAD_LOG_STRICT_PARSING", true);
+		// the ClassAd function table is built the first time a function call
+		// is parsed, make sure that happens before there is more than one thread.
+		classad::ExprTree * tree = NULL;
+		if (ParseClassAdRvalExpr("isUndefined(x)", tree) == 0) { delete tree; }
+	}
+}
+
+LogRecordSource::~LogRecordSource()
+{
+	for (size_t ix = next; ix < batch.size(); ++ix) {
+		delete batch[ix];
+	}
+}
+
+LogRecord *
+LogRecordSource::Next(unsigned long recnum)
+{
+	if (threads <= 1) {
+		double begin = _condor_debug_get_time_double();
+		LogRecord * log_rec = ReadLogEntry(fp, recnum, InstantiateLogEntry, maker);
+		read_time += _condor_debug_get_time_double() - begin;
+		if (log_rec) { end_pos = ftell(fp); }
+		return log_rec;
+	}
+
+	if (next >= batch.size()) {
+		if (at_end || ! ReadBatch(recnum)) {
+			return NULL;
+		}
+	}
+	end_pos = batch_ends[next];
+	return batch[next++];
+}
+
+bool
+LogRecordSource::ReadBatch(unsigned long recnum)
+{
+	batch.clear();
+	batch_ends.clear();
+	next = 0;
+
+	double begin = _condor_debug_get_time_double();
+	long long batch_pos = end_pos;
+	while (batch.size() < PARALLEL_REPLAY_BATCH) {
+		LogRecord * log_rec = ReadLogEntry(fp, recnum + batch.size(), InstantiateUnparsedLogEntry, maker);
+		if ( ! log_rec) {
+			at_end = true;
+			break;
+		}
+		batch.push_back(log_rec);
+		batch_ends.push_back(ftell(fp));
+		if (log_rec->get_op_type() == CondorLogOp_Error) {
+			// the replay stops here, so don't read any further.
+			at_end = true;
+			break;
+		}
+	}
+	double parse_begin = _condor_debug_get_time_double();
+	read_time += parse_begin - begin;
+
+	batch_failed.assign(batch.size(), 0);
+	std::vector<std::thread> workers;
+	for (int partition = 1; partition < threads; ++partition) {
+		workers.push_back(std::thread(&LogRecordSource::ParseBatch, this, partition));
+	}
+	ParseBatch(0);
+	for (size_t ix = 0; ix < workers.size(); ++ix) {
+		workers[ix].join();
+	}
+	parse_time += _condor_debug_get_time_double() - parse_begin;
+
+	for (size_t ix = 0; ix < batch.size(); ++ix) {
+		if ( ! batch_failed[ix]) {
+			continue;
+		}
+		LogSetAttribute * log_rec = (LogSetAttribute *)batch[ix];
+		if ( ! strict_parsing) {
+			dprintf(D_ALWAYS, "WARNING: strict classad parsing failed for expression: %s\n", log_rec->get_value());
+			continue;
+		}
+		// the log ends at this record, unless there is a committed transaction
+		// after it, in which case SkipCorruptLogRecords will EXCEPT.
+		long long pos = ix ? batch_ends[ix-1] : batch_pos;
+		LogCorruptLogRecord(log_rec, recnum + ix, pos);
+		if (fseek(fp, batch_ends[ix], SEEK_SET) < 0) {
+			EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum + ix, errno);
+		}
+		SkipCorruptLogRecords(fp, recnum + ix, pos);
+		for (size_t jx = ix; jx < batch.size(); ++jx) {
+			delete batch[jx];
+		}
+		batch.resize(ix);
+		batch_ends.resize(ix);
+		at_end = true;
+		break;
+	}
+
+	return ! batch.empty();
+}
+
+// parse the SetAttribute values in the batch for one partition of the keys.
+// this runs on several threads at once, and must not touch anything but
+// the records of its own partition.
+void
+LogRecordSource::ParseBatch(int partition)
+{
+	for (size_t ix = 0; ix < batch.size(); ++ix) {
+		LogRecord * log_rec = batch[ix];
+		if (log_rec->get_op_type() != CondorLogOp_SetAttribute) {
+			continue;
+		}
+		unsigned int hash = 0;
+		for (const char * pch = log_rec->get_key(); pch && *pch; ++pch) {
+			hash = hash*31 + (unsigned char)*pch;
+		}
+		if ((int)(hash % threads) != partition) {
+			continue;
+		}
+		if ( ! ((LogSetAttribute *)log_rec)->ParseValue()) {
+			batch_failed[ix] = 1;
+		}
+	}
+}
+
+// play the log records in fp from its current position into the table,
+// committing complete transactions and discarding an incomplete one at the end.
+// count is the number of records read so far, and is updated.
+// when replay_threads is more than 1, values are parsed on that many threads.
+// returns false if fp contains a bad record.
+static bool ReplayClassAdLog(
+	FILE *fp,
 	const char *filename,
 	LoggableClassAdTable & la,
 	const ConstructLogEntry& maker,
+	int replay_threads,
+	unsigned long & count,
 	unsigned long & historical_sequence_number,
 	time_t & m_original_log_birthdate,
 	bool & is_clean,
 	bool & requires_successful_cleaning,
 	MyString & errmsg)
 {
-	FILE* log_fp = NULL;
 	Transaction * active_transaction = NULL;
-
-	historical_sequence_number = 1;
-	m_original_log_birthdate = time(NULL);
-
-	// TODO: this should open O_BINARY because on windows, text files have \r\n with the c-runtime magically adding/removing \r as needed.
-	int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_CREAT | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
-	if (log_fd < 0) {
-		errmsg.formatstr("failed to open log %s, errno = %d\n", filename, errno);
-		return NULL;
-	}
-
-	log_fp = fdopen(log_fd, "r+");
-	if (log_fp == NULL) {
-		errmsg.formatstr("failed to fdopen log %s, errno = %d\n", filename, errno);
-		return NULL;
-	}
-
-	is_clean = true; // was cleanly closed (until we find out otherwise)
-	requires_successful_cleaning = false;
+	double begin = _condor_debug_get_time_double();
+	unsigned long first_count = count;
 
 	// Read all of the log records
+	LogRecordSource source(fp, maker, replay_threads);
 	LogRecord		*log_rec;
-	unsigned long count = 0;
-	long long next_log_entry_pos = 0;
-    long long curr_log_entry_pos = 0;
-	while ((log_rec = ReadLogEntry(log_fp, 1+count, InstantiateLogEntry, maker)) != 0) {
-        curr_log_entry_pos = next_log_entry_pos;
-		next_log_entry_pos = ftell(log_fp);
+	long long next_log_entry_pos = source.Tell();
+	long long curr_log_entry_pos = next_log_entry_pos;
+	while ((log_rec = source.Next(1+count)) != 0) {
+		curr_log_entry_pos = next_log_entry_pos;
+		next_log_entry_pos = source.Tell();
 		count++;
 		switch (log_rec->get_op_type()) {
 		case CondorLogOp_Error:
 			// this is defensive, ought to be caught in InstantiateLogEntry()
 			errmsg.formatstr("ERROR: in log %s transaction record %lu was bad (byte offset %lld)\n", filename, count, curr_log_entry_pos);
-			fclose(log_fp);
-
+			delete log_rec;
 			delete active_transaction;
-			return NULL;
+			return false;
 			break;
 		case CondorLogOp_BeginTransaction:
 			// this file contains transactions, so it must not
@@ -154,7 +323,18 @@ FILE* LoadClassAdLog(
 			}
 		}
 	}
-	long long final_log_entry_pos = ftell(log_fp);
+	long long final_log_entry_pos = ftell(fp);
+
+	double runtime = _condor_debug_get_time_double() - begin;
+	if (source.Threads() > 1) {
+		dprintf(D_ALWAYS, "Replayed %lu records of %s in %.3f seconds (read %.3f, parse %.3f on %d threads, apply %.3f)\n",
+			count - first_count, filename, runtime, source.read_time, source.parse_time, source.Threads(),
+			runtime - source.read_time - source.parse_time);
+	} else {
+		dprintf(D_FULLDEBUG, "Replayed %lu records of %s in %.3f seconds (read %.3f, apply %.3f)\n",
+			count - first_count, filename, runtime, source.read_time, runtime - source.read_time);
+	}
+
 	if( next_log_entry_pos != final_log_entry_pos ) {
 		// The log file has a broken line at the end so we _must_
 		// _not_ write anything more into this log.
@@ -177,8 +357,53 @@ FILE* LoadClassAdLog(
 			requires_successful_cleaning = true;
 		}
 	}
+	return true;
+}
+
+// non-templatized worker function that implements the log loading functionality of ClassAdLog
+//
+FILE* LoadClassAdLog(
+	const char *filename,
+	LoggableClassAdTable & la,
+	const ConstructLogEntry& maker,
+	unsigned long & historical_sequence_number,
+	time_t & m_original_log_birthdate,
+	bool & is_clean,
+	bool & requires_successful_cleaning,
+	MyString & errmsg,
+	int replay_threads)
+{
+	FILE* log_fp = NULL;
+
+	historical_sequence_number = 1;
+	m_original_log_birthdate = time(NULL);
+
+	// TODO: this should open O_BINARY because on windows, text files have \r\n with the c-runtime magically adding/removing \r as needed.
+	int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_CREAT | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
+	if (log_fd < 0) {
+		errmsg.formatstr("failed to open log %s, errno = %d\n", filename, errno);
+		return NULL;
+	}
+
+	log_fp = fdopen(log_fd, "r+");
+	if (log_fp == NULL) {
+		errmsg.formatstr("failed to fdopen log %s, errno = %d\n", filename, errno);
+		return NULL;
+	}
+
+	is_clean = true; // was cleanly closed (until we find out otherwise)
+	requires_successful_cleaning = false;
+
+	unsigned long count = 0;
+	if ( ! ReplayClassAdLog(log_fp, filename, la, maker, replay_threads, count,
+			historical_sequence_number, m_original_log_birthdate,
+			is_clean, requires_successful_cleaning, errmsg)) {
+		fclose(log_fp);
+		return NULL;
+	}
+
 	if(!count) {
-		log_rec = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
+		LogRecord *log_rec = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
 		if (log_rec->Write(log_fp) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d\n", filename, errno);
 			fclose(log_fp);
@@ -188,6 +413,39 @@ FILE* LoadClassAdLog(
 		delete log_rec;
 	}
 
+	// If we stopped during a background truncation, the changes made since
+	// it began are in the tail file.  The tail belongs to this log if it
+	// begins with the sequence number of the log, otherwise the truncation
+	// finished and the tail is already part of the log.
+	MyString tail_filename;
+	tail_filename.formatstr("%s.tail", filename);
+	FILE *tail_fp = safe_fopen_wrapper_follow(tail_filename.Value(), "r");
+	if (tail_fp) {
+		unsigned long tail_count = 1;
+		LogRecord *log_rec = ReadLogEntry(tail_fp, tail_count, InstantiateLogEntry, maker);
+		if (log_rec && log_rec->get_op_type() == CondorLogOp_LogHistoricalSequenceNumber &&
+			((LogHistoricalSequenceNumber *)log_rec)->get_historical_sequence_number() == historical_sequence_number) {
+			unsigned long tail_sequence_number = 0;
+			time_t tail_birthdate = 0;
+			if ( ! ReplayClassAdLog(tail_fp, tail_filename.Value(), la, maker, replay_threads, tail_count,
+					tail_sequence_number, tail_birthdate,
+					is_clean, requires_successful_cleaning, errmsg)) {
+				delete log_rec;
+				fclose(tail_fp);
+				fclose(log_fp);
+				return NULL;
+			}
+			errmsg.formatstr_cat("Replayed %lu records from %s\n", tail_count - 1, tail_filename.Value());
+				// the log must be rewritten to include the tail before
+				// anything more is written to it.
+			requires_successful_cleaning = true;
+		} else {
+			errmsg.formatstr_cat("Ignoring %s, which does not belong to this log\n", tail_filename.Value());
+		}
+		delete log_rec;
+		fclose(tail_fp);
+	}
+
 	return log_fp;
 }
 
@@ -253,6 +511,57 @@ bool SaveHistoricalClassAdLogs(
 }
 
 
+// open a log for appending, returns NULL and sets errmsg on failure
+static FILE* OpenClassAdLogForAppend(const char * filename, MyString & errmsg)
+{
+	int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
+	if (log_fd < 0) {
+		errmsg.formatstr( "failed to open log in append mode: "
+			"safe_open_wrapper(%s) returns %d", filename, log_fd);
+		return NULL;
+	}
+	FILE *log_fp = fdopen(log_fd, "a+");
+	if (log_fp == NULL) {
+		close(log_fd);
+		errmsg.formatstr("failed to fdopen log in append mode: "
+			"fdopen(%s) returns %d", filename, log_fd);
+	}
+	return log_fp;
+}
+
+// make a rename or create in the directory of filename durable
+static void SyncClassAdLogDirectory(const char * filename, MyString & errmsg)
+{
+#ifndef WIN32
+	// POSIX does not provide any durability guarantees for rename().  Instead, we must
+	// open the parent directory and invoke fsync there.
+	char * parent_dir = condor_dirname(filename);
+	if (parent_dir)
+	{
+		int parent_fd = safe_open_wrapper_follow(parent_dir, O_RDONLY);
+		if (parent_fd >= 0)
+		{
+			if (condor_fsync(parent_fd) == -1)
+			{
+				errmsg.formatstr("Failed to fsync directory %s after rename. (errno=%d, msg=%s)", parent_dir, errno, strerror(errno));
+			}
+			close(parent_fd);
+		}
+		else
+		{
+			errmsg.formatstr("Failed to open parent directory %s for fsync after rename. (errno=%d, msg=%s)", parent_dir, errno, strerror(errno));
+		}
+		free( parent_dir );
+	}
+	else
+	{
+		errmsg.formatstr("Failed to determine log's directory name\n");
+	}
+#else
+	(void)filename; (void)errmsg;
+#endif
+}
+
 bool TruncateClassAdLog(
 	const char * filename,	        // in
 	LoggableClassAdTable & la,      // in
@@ -260,7 +569,8 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
-	MyString & errmsg) // out
+	MyString & errmsg, // out
+	bool binary) // in
 {
 	MyString	tmp_log_filename;
 	int new_log_fd;
@@ -291,7 +601,7 @@ bool TruncateClassAdLog(
 	// with a future value for sequence number
 	bool success = WriteClassAdLogState(new_log_fp, tmp_log_filename.Value(),
 		future_sequence_number, m_original_log_birthdate,
-		la, maker, errmsg);
+		la, maker, errmsg, binary);
 
 	fclose(log_fp);
 	log_fp = NULL;
@@ -312,15 +622,10 @@ bool TruncateClassAdLog(
 
 		unlink(tmp_log_filename.Value());
 
-		int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
-		if (log_fd < 0) {
-			errmsg.formatstr("failed to reopen log %s, errno = %d after failing to rotate log.",filename,errno);
-		} else {
-			log_fp = fdopen(log_fd, "a+");
-			if (log_fp == NULL) {
-				errmsg.formatstr("failed to refdopen log %s, errno = %d after failing to rotate log.",filename,errno);
-				close(log_fd);
-			}
+		MyString reopen_errmsg;
+		log_fp = OpenClassAdLogForAppend(filename, reopen_errmsg);
+		if ( ! log_fp) {
+			errmsg.formatstr("%s after failing to rotate log.", reopen_errmsg.Value());
 		}
 
 		return false;
@@ -329,50 +634,247 @@ bool TruncateClassAdLog(
 	// we successfully wrote and rotated, so we can update our sequence number
 	historical_sequence_number = future_sequence_number;
 
-#ifndef WIN32
-	// POSIX does not provide any durability guarantees for rename().  Instead, we must
-	// open the parent directory and invoke fsync there.
-	char * parent_dir = condor_dirname(filename);
-	if (parent_dir)
-	{
-		int parent_fd = safe_open_wrapper_follow(parent_dir, O_RDONLY);
-		if (parent_fd >= 0)
-		{
-			if (condor_fsync(parent_fd) == -1)
-			{
-				errmsg.formatstr("Failed to fsync directory %s after rename. (errno=%d, msg=%s)", parent_dir, errno, strerror(errno));
-			}
-			close(parent_fd);
-		}
-		else
-		{
-			errmsg.formatstr("Failed to open parent directory %s for fsync after rename. (errno=%d, msg=%s)", parent_dir, errno, strerror(errno));
-		}
-		free( parent_dir );
+	SyncClassAdLogDirectory(filename, errmsg);
+
+	// the tail of a background truncation, if any, is now part of the log,
+	// and a snapshot that was being written for it is of no use.
+	MyString tail_filename, snapshot_filename;
+	tail_filename.formatstr("%s.tail", filename);
+	unlink(tail_filename.Value());
+	snapshot_filename.formatstr("%s.snapshot", filename);
+	unlink(snapshot_filename.Value());
+
+	log_fp = OpenClassAdLogForAppend(filename, errmsg);
+
+	return true;
+}
+
+
+bool BeginClassAdLogTail(
+	const char * filename,          // in
+	FILE* &log_fp,                  // in,out
+	unsigned long historical_sequence_number, // in
+	time_t m_original_log_birthdate, // in
+	long & tail_offset,             // out
+	MyString & errmsg,              // out
+	bool binary)                    // in
+{
+	MyString tail_filename;
+	tail_filename.formatstr("%s.tail", filename);
+
+	// everything written so far must be in the log before the tail takes over
+	int err = FlushClassAdLog(log_fp, true);
+	if (err) {
+		errmsg.formatstr("failed to sync %s before starting %s, errno = %d\n", filename, tail_filename.Value(), err);
+		return false;
 	}
-	else
-	{
-		errmsg.formatstr("Failed to determine log's directory name\n");
+
+	int tail_fd = safe_create_replace_if_exists(tail_filename.Value(), O_RDWR | O_CREAT | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
+	if (tail_fd < 0) {
+		errmsg.formatstr("safe_create_replace_if_exists(%s) failed with errno %d (%s)\n",
+			tail_filename.Value(), errno, strerror(errno));
+		return false;
+	}
+	FILE *tail_fp = fdopen(tail_fd, "a+");
+	if (tail_fp == NULL) {
+		errmsg.formatstr("fdopen(%s) returns NULL\n", tail_filename.Value());
+		close(tail_fd);
+		unlink(tail_filename.Value());
+		return false;
 	}
-#endif
 
-	int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
-	if (log_fd < 0) {
-		errmsg.formatstr( "failed to open log in append mode: "
-			"safe_open_wrapper(%s) returns %d", filename, log_fd);
-	} else {
-		log_fp = fdopen(log_fd, "a+");
-		if (log_fp == NULL) {
-			close(log_fd);
-			errmsg.formatstr("failed to fdopen log in append mode: "
-				"fdopen(%s) returns %d", filename, log_fd);
+	// the tail begins with the sequence number of the log it follows,
+	// this is how LoadClassAdLog tells whether it has been merged yet.
+	LogHistoricalSequenceNumber log(historical_sequence_number, m_original_log_birthdate);
+	if (log.Write(tail_fp, binary) < 0 || FlushClassAdLog(tail_fp, true) != 0) {
+		errmsg.formatstr("write to %s failed, errno = %d\n", tail_filename.Value(), errno);
+		fclose(tail_fp);
+		unlink(tail_filename.Value());
+		return false;
+	}
+	SyncClassAdLogDirectory(tail_filename.Value(), errmsg);
+
+	tail_offset = ftell(tail_fp);
+	fclose(log_fp);
+	log_fp = tail_fp;
+	return true;
+}
+
+
+bool WriteClassAdLogSnapshot(
+	const char * filename,          // in
+	unsigned long historical_sequence_number, // in
+	time_t m_original_log_birthdate, // in
+	LoggableClassAdTable & la,      // in
+	const ConstructLogEntry& maker, // in
+	MyString & errmsg,              // out
+	bool binary)                    // in
+{
+	MyString snapshot_filename;
+	snapshot_filename.formatstr("%s.snapshot", filename);
+
+	int fd = safe_create_replace_if_exists(snapshot_filename.Value(), O_RDWR | O_CREAT | O_LARGEFILE | _O_NOINHERIT, 0600);
+	if (fd < 0) {
+		errmsg.formatstr("safe_create_replace_if_exists(%s) failed with errno %d (%s)\n",
+			snapshot_filename.Value(), errno, strerror(errno));
+		return false;
+	}
+	FILE *fp = fdopen(fd, "r+");
+	if (fp == NULL) {
+		errmsg.formatstr("fdopen(%s) returns NULL\n", snapshot_filename.Value());
+		close(fd);
+		unlink(snapshot_filename.Value());
+		return false;
+	}
+
+	bool success = WriteClassAdLogState(fp, snapshot_filename.Value(),
+		historical_sequence_number + 1, m_original_log_birthdate,
+		la, maker, errmsg, binary);
+	if (fclose(fp) != 0) {
+		success = false;
+	}
+	if ( ! success) {
+		unlink(snapshot_filename.Value());
+	}
+	return success;
+}
+
+
+bool MergeClassAdLogTail(
+	const char * filename,          // in
+	FILE* &log_fp,                  // in,out
+	long tail_offset,               // in
+	unsigned long & historical_sequence_number, // in,out
+	MyString & errmsg)              // out
+{
+	MyString tail_filename, snapshot_filename;
+	tail_filename.formatstr("%s.tail", filename);
+	snapshot_filename.formatstr("%s.snapshot", filename);
+
+	int err = FlushClassAdLog(log_fp, true);
+	if (err) {
+		errmsg.formatstr("failed to sync %s, errno = %d\n", tail_filename.Value(), err);
+		return false;
+	}
+
+	// append the records written since the snapshot was taken, without
+	// the sequence number that begins the tail, to the snapshot
+	FILE *tail_fp = safe_fopen_wrapper_follow(tail_filename.Value(), "rb");
+	FILE *snapshot_fp = safe_fopen_wrapper_follow(snapshot_filename.Value(), "ab");
+	bool success = tail_fp && snapshot_fp && fseek(tail_fp, tail_offset, SEEK_SET) == 0;
+	if ( ! success) {
+		errmsg.formatstr("failed to open %s and %s to merge them, errno = %d\n",
+			tail_filename.Value(), snapshot_filename.Value(), errno);
+	}
+	char buf[64*1024];
+	size_t cb;
+	while (success && (cb = fread(buf, 1, sizeof(buf), tail_fp)) > 0) {
+		if (fwrite(buf, 1, cb, snapshot_fp) < cb) {
+			errmsg.formatstr("write to %s failed, errno = %d\n", snapshot_filename.Value(), errno);
+			success = false;
 		}
 	}
+	if (success && (ferror(tail_fp) || FlushClassAdLog(snapshot_fp, true) != 0)) {
+		errmsg.formatstr("failed to merge %s into %s, errno = %d\n",
+			tail_filename.Value(), snapshot_filename.Value(), errno);
+		success = false;
+	}
+	if (tail_fp) { fclose(tail_fp); }
+	if (snapshot_fp && fclose(snapshot_fp) != 0) { success = false; }
+
+	if (success && rotate_file(snapshot_filename.Value(), filename) < 0) {
+		errmsg.formatstr("failed to rotate %s to %s\n", snapshot_filename.Value(), filename);
+		success = false;
+	}
+	if ( ! success) {
+		unlink(snapshot_filename.Value());
+		return false;
+	}
 
+	// the snapshot is now the log, and has the next sequence number
+	historical_sequence_number++;
+	SyncClassAdLogDirectory(filename, errmsg);
+
+	fclose(log_fp);
+	unlink(tail_filename.Value());
+	log_fp = OpenClassAdLogForAppend(filename, errmsg);
 	return true;
 }
 
 
+FILE* ReopenClassAdLogTail(
+	const char * filename,          // in
+	MyString & errmsg)              // out
+{
+	MyString tail_filename;
+	tail_filename.formatstr("%s.tail", filename);
+	return OpenClassAdLogForAppend(tail_filename.Value(), errmsg);
+}
+
+
+bool ConvertClassAdLog(
+	const char * in_name,           // in
+	const char * out_name,          // in
+	bool binary,                    // in
+	unsigned long & count,          // out
+	MyString & errmsg)              // out
+{
+	count = 0;
+	FILE *in_fp = safe_fopen_wrapper_follow(in_name, "rb");
+	if ( ! in_fp) {
+		errmsg.formatstr("Can't open %s, errno = %d (%s)\n", in_name, errno, strerror(errno));
+		return false;
+	}
+	FILE *out_fp = safe_fopen_wrapper_follow(out_name, "wb", 0600);
+	if ( ! out_fp) {
+		errmsg.formatstr("Can't create %s, errno = %d (%s)\n", out_name, errno, strerror(errno));
+		fclose(in_fp);
+		return false;
+	}
+
+	bool success = true;
+	long long last_pos = 0;
+	LogRecord *log_rec;
+	while ((log_rec = ReadLogEntry(in_fp, count + 1, InstantiateLogEntry, DefaultMakeClassAdLogTableEntry)) != NULL) {
+		if (log_rec->get_op_type() == CondorLogOp_Error) {
+			errmsg.formatstr("Record %lu of %s is bad (byte offset %lld)\n", count + 1, in_name, last_pos);
+			delete log_rec;
+			success = false;
+			break;
+		}
+		if (log_rec->Write(out_fp, binary) < 0) {
+			errmsg.formatstr("Failed to write %s, errno = %d (%s)\n", out_name, errno, strerror(errno));
+			delete log_rec;
+			success = false;
+			break;
+		}
+		delete log_rec;
+		count++;
+		last_pos = ftell(in_fp);
+	}
+
+	if (success) {
+		fseek(in_fp, 0, SEEK_END);
+		if (ftell(in_fp) != last_pos) {
+			errmsg.formatstr("Ignoring the unterminated or corrupt records at the end of %s (byte offset %lld)\n", in_name, last_pos);
+		}
+	}
+	fclose(in_fp);
+
+	if (success && FlushClassAdLog(out_fp, true) != 0) {
+		errmsg.formatstr("Failed to write %s, errno = %d (%s)\n", out_name, errno, strerror(errno));
+		success = false;
+	}
+	if (fclose(out_fp) != 0) {
+		success = false;
+	}
+	if ( ! success) {
+		unlink(out_name);
+	}
+	return success;
+}
+
+
 bool AddAttrNamesFromLogTransaction(
 	Transaction* active_transaction,
 	const char * key,
@@ -543,14 +1045,15 @@ bool WriteClassAdLogState(
 	time_t m_original_log_birthdate, // in
 	LoggableClassAdTable & la,
 	const ConstructLogEntry& maker,
-	MyString & errmsg)
+	MyString & errmsg,
+	bool binary)
 {
 	LogRecord	*log=NULL;
 	ExprTree	*expr=NULL;
 
 	// This must always be the first entry in the log.
 	log = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
-	if (log->Write(fp) < 0) {
+	if (log->Write(fp, binary) < 0) {
 		errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 		delete log;
 		return false;
@@ -563,7 +1066,7 @@ bool WriteClassAdLogState(
 	la.startIterations();
 	while(la.nextIteration(key, ad)) {
 		log = new LogNewClassAd(key, GetMyTypeName(*ad), GetTargetTypeName(*ad), maker);
-		if (log->Write(fp) < 0) {
+		if (log->Write(fp, binary) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 			delete log;
 			return false;
@@ -582,7 +1085,7 @@ bool WriteClassAdLogState(
 			if (expr) {
 				log = new LogSetAttribute(key, itr->first.c_str(),
 										  ExprTreeToString(expr));
-				if (log->Write(fp) < 0) {
+				if (log->Write(fp, binary) < 0) {
 					errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 					delete log;
 					return false;
@@ -653,6 +1156,26 @@ LogHistoricalSequenceNumber::WriteBody(FILE *fp)
 	return (fwrite(buf, 1, len, fp) < (unsigned)len) ? -1: len;
 }
 
+int
+LogHistoricalSequenceNumber::WriteBinaryBody(LogRecordBody & body)
+{
+	body.putVarint(historical_sequence_number);
+	body.putVarint((unsigned long long)timestamp);
+	return 0;
+}
+
+int
+LogHistoricalSequenceNumber::ReadBinaryBody(LogRecordBody & body)
+{
+	unsigned long long seq, stamp;
+	if ( ! body.getVarint(seq) || ! body.getVarint(stamp)) {
+		return -1;
+	}
+	historical_sequence_number = (unsigned long)seq;
+	timestamp = (time_t)stamp;
+	return 0;
+}
+
 LogNewClassAd::LogNewClassAd(const char *k, const char *m, const char *t, const ConstructLogEntry & c) : ctor(c)
 {
 	op_type = CondorLogOp_NewClassAd;
@@ -750,6 +1273,28 @@ LogNewClassAd::WriteBody(FILE* fp)
 	return rval + rval1;
 }
 
+int
+LogNewClassAd::WriteBinaryBody(LogRecordBody & body)
+{
+		// unlike the text form, the binary form can hold an empty type name
+	body.putString(key);
+	body.putName(mytype);
+	body.putName(targettype);
+	return 0;
+}
+
+int
+LogNewClassAd::ReadBinaryBody(LogRecordBody & body)
+{
+	free(key);
+	free(mytype);
+	free(targettype);
+	if ( ! body.getString(key) || ! body.getName(mytype) || ! body.getName(targettype)) {
+		return -1;
+	}
+	return 0;
+}
+
 LogDestroyClassAd::LogDestroyClassAd(const char *k, const ConstructLogEntry & c) : ctor(c)
 {
 	op_type = CondorLogOp_DestroyClassAd;
@@ -788,6 +1333,13 @@ LogDestroyClassAd::ReadBody(FILE* fp)
 	return readword(fp, key);
 }
 
+int
+LogDestroyClassAd::ReadBinaryBody(LogRecordBody & body)
+{
+	free(key);
+	return body.getString(key) ? 0 : -1;
+}
+
 LogSetAttribute::LogSetAttribute(const char *k, const char *n, const char *val, bool dirty)
 {
 	op_type = CondorLogOp_SetAttribute;
@@ -804,6 +1356,7 @@ LogSetAttribute::LogSetAttribute(const char *k, const char *n, const char *val,
 		value = strdup("UNDEFINED");
 	}
 	is_dirty = dirty;
+	defer_parse = false;
 }
 
 
@@ -826,7 +1379,25 @@ LogSetAttribute::Play(void *data_structure)
 		return -1;
 
 	std::string attr(name);
-	if (ad->InsertViaCache(attr, value)) {
+	bool inserted;
+	if (value_expr) {
+			// the value was parsed when this record was created or read,
+			// so insert a copy rather than parsing it again.  this does the
+			// same as InsertViaCache when the value is not yet in the cache.
+		if (classad::ClassAdGetExpressionCaching() && attr[0] != '\'') {
+			std::string rhs(value);
+			ExprTree * tree = classad::CachedExprEnvelope::check_hit(attr, rhs);
+			if ( ! tree) {
+				tree = classad::CachedExprEnvelope::cache(attr, value_expr->Copy(), rhs);
+			}
+			inserted = ad->Insert(attr, tree);
+		} else {
+			inserted = ad->Insert(attr, value_expr->Copy());
+		}
+	} else {
+		inserted = ad->InsertViaCache(attr, value);
+	}
+	if (inserted) {
 		rval = TRUE;
 	} else {
 		rval = FALSE;
@@ -910,16 +1481,71 @@ LogSetAttribute::ReadBody(FILE* fp)
 
 	if (value_expr) delete value_expr;
 	value_expr = NULL;
+	if (defer_parse) {
+		return rval + rval1;
+	}
+	if ( ! ParseValue()) {
+		if (param_boolean("CLASSAD_LOG_STRICT_PARSING", true)) {
+			return -1;
+		} else {
+			dprintf(D_ALWAYS, "WARNING: strict classad parsing failed for expression: %s\n", value);
+		}
+	}
+	return rval + rval1;
+}
+
+bool
+LogSetAttribute::ParseValue()
+{
+	if (value_expr) {
+		return true;
+	}
 	if (ParseClassAdRvalExpr(value, value_expr)) {
 		if (value_expr) delete value_expr;
 		value_expr = NULL;
+		return false;
+	}
+	return true;
+}
+
+int
+LogSetAttribute::WriteBinaryBody(LogRecordBody & body)
+{
+	// Refuse newlines here too, so that the log can always be converted to text
+	if( strchr(key, '\n') || strchr(name, '\n') || strchr(value, '\n') ) {
+		dprintf(D_ALWAYS, "Refusing attempt to add '%s' = '%s' to record '%s' as it contains a newline, which is not allowed.\n", name, value, key);
+		return -1;
+	}
+
+	body.putString(key);
+	body.putName(name);
+	body.putValue(value, value_expr);
+	return 0;
+}
+
+int
+LogSetAttribute::ReadBinaryBody(LogRecordBody & body)
+{
+	free(key);
+	free(name);
+	free(value);
+	if (value_expr) delete value_expr;
+	value_expr = NULL;
+
+	if ( ! body.getString(key) || ! body.getName(name) || ! body.getValue(value, &value_expr)) {
+		return -1;
+	}
+
+		// literal values come back already parsed, anything else is parsed
+		// the same way as in the text form.
+	if ( ! defer_parse && ! ParseValue()) {
 		if (param_boolean("CLASSAD_LOG_STRICT_PARSING", true)) {
 			return -1;
 		} else {
 			dprintf(D_ALWAYS, "WARNING: strict classad parsing failed for expression: %s\n", value);
 		}
 	}
-	return rval + rval1;
+	return 0;
 }
 
 
@@ -1024,6 +1650,18 @@ LogEndTransaction::WriteBody(FILE* fp)
 	return rval;
 }
 
+int
+LogEndTransaction::ReadBinaryBody(LogRecordBody & body)
+{
+	free(comment);
+	if ( ! body.atEnd()) {
+		if ( ! body.getString(comment)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int 
 LogEndTransaction::ReadBody( FILE* fp )
 {
@@ -1059,8 +1697,96 @@ LogDeleteAttribute::ReadBody(FILE* fp)
 	return rval + rval1;
 }
 
-LogRecord	*
-InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor)
+int
+LogDeleteAttribute::ReadBinaryBody(LogRecordBody & body)
+{
+	free(key);
+	free(name);
+	return (body.getString(key) && body.getName(name)) ? 0 : -1;
+}
+
+// Check the records that follow a corrupt record in fp.  If the corrupt record is
+// inside a transaction that was committed (followed by an end-of-transaction op), the
+// log is unrecoverable and this is a fatal exception.  Otherwise the records from the
+// corrupt one to the end of the file are ignored, and fp is left at the end of the file.
+static void
+SkipCorruptLogRecords(FILE *fp, unsigned long recnum, long long pos)
+{
+	char	line[ATTRLIST_MAX_EXPRESSION + 64];
+	int		op;
+
+	// check if this bogus record is in the midst of a transaction
+	// (try to find a CloseTransaction log record)
+	const unsigned long maxfollow = 3;
+	dprintf(D_ALWAYS, "Lines following corrupt log record %lu (up to %lu):\n", recnum, maxfollow);
+	unsigned long nlines = 0;
+	int		ch;
+	while( (ch = fgetc( fp )) != EOF ) {
+		ungetc( ch, fp );
+		if( is_binary_log_record( ch ) ) {
+				// binary records say how long they are, so skip whole records
+			LogRecordBody skipped;
+			op = ReadBinaryLogRecord( fp, skipped );
+			if( op < 0 ) {
+				break;
+			}
+			nlines += 1;
+			if (nlines <= maxfollow) {
+				dprintf(D_ALWAYS, "    (binary record %d, %d bytes)\n", op, (int)skipped.data().size());
+			}
+			if( !valid_record_optype(op) ) {
+				continue;
+			}
+		} else {
+			if( !fgets( line, ATTRLIST_MAX_EXPRESSION+64, fp ) ) {
+				break;
+			}
+			nlines += 1;
+			if (nlines <= maxfollow) {
+				dprintf(D_ALWAYS, "    %s", line);
+				int ll = strlen(line);
+				if (ll <= 0  ||  line[ll-1] != '\n') dprintf(D_ALWAYS, "\n");
+			}
+			if (sscanf( line, "%d ", &op ) != 1  ||  !valid_record_optype(op)) {
+				// no op field in line; more bad log records...
+				continue;
+			}
+		}
+		if( op == CondorLogOp_EndTransaction ) {
+				// aargh!  bad record in transaction.  abort!
+			EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
+		}
+	}
+
+	if( !feof( fp ) ) {
+		EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
+	}
+
+		// there wasn't an error in reading the file, and the bad log 
+		// record wasn't bracketed by a CloseTransaction; ignore all
+		// records starting from the bad record to the end-of-file, and
+		// pretend that we hit the end-of-file.
+	fseek( fp , 0, SEEK_END);
+}
+
+// print the record that was found to be corrupt
+static void
+LogCorruptLogRecord(LogRecord *log_rec, unsigned long recnum, long long pos)
+{
+	dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
+	// TODO: this ugly code attempts to reconstruct the corrupted line, fix it to just show the actual line.
+	const char *key, *name="", *value="";
+	key = log_rec->get_key(); if ( ! key) key = "";
+	if (log_rec->get_op_type() == CondorLogOp_SetAttribute) {
+		LogSetAttribute * log = (LogSetAttribute *)log_rec;
+		name = log->get_name(); if ( ! name) name = "";
+		value = log->get_value(); if ( ! value) value = "";
+	}
+	dprintf(D_ALWAYS | D_ERROR, "    %d %s %s %s\n", log_rec->get_op_type(), key, name, value);
+}
+
+static LogRecord *
+InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor, bool parse_values)
 {
 	LogRecord	*log_rec;
 
@@ -1076,6 +1802,9 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
 			break;
 	    case CondorLogOp_SetAttribute:
 		    log_rec = new LogSetAttribute("", "", "");
+			if ( ! parse_values) {
+				((LogSetAttribute *)log_rec)->DeferParse();
+			}
 			break;
 	    case CondorLogOp_DeleteAttribute:
 		    log_rec = new LogDeleteAttribute("", "");
@@ -1103,54 +1832,15 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
     // mode is a failure that occurs inside a complete transaction (one with an end-of-
     // transaction op).  A complete transaction with corruption is unrecoverable, and 
     // causes a fatal exception.
-	if (log_rec->ReadBody(fp) < 0  ||  log_rec->get_op_type() == CondorLogOp_Error) {
-        dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
-		// TODO: this ugly code attempts to reconstruct the corrupted line, fix it to just show the actual line.
-		const char *key, *name="", *value="";
-		key = log_rec->get_key(); if ( ! key) key = "";
-		if (log_rec->get_op_type() == CondorLogOp_SetAttribute) {
-			LogSetAttribute * log = (LogSetAttribute *)log_rec;
-			name = log->get_name(); if ( ! name) name = "";
-			value = log->get_value(); if ( ! value) value = "";
-		}
-		dprintf(D_ALWAYS | D_ERROR, "    %d %s %s %s\n", log_rec->get_op_type(), key, name, value);
-
-		char	line[ATTRLIST_MAX_EXPRESSION + 64];
-		int		op;
-
+	int rval = body ? log_rec->ReadBinaryBody(*body) : log_rec->ReadBody(fp);
+	if (body && rval >= 0 && ! body->atEnd()) {
+			// the length of the record doesn't match what is in it
+		rval = -1;
+	}
+	if (rval < 0  ||  log_rec->get_op_type() == CondorLogOp_Error) {
+		LogCorruptLogRecord(log_rec, recnum, pos);
 		delete log_rec;
-
-        // check if this bogus record is in the midst of a transaction
-	    // (try to find a CloseTransaction log record)
-        const unsigned long maxfollow = 3;
-        dprintf(D_ALWAYS, "Lines following corrupt log record %lu (up to %lu):\n", recnum, maxfollow);
-        unsigned long nlines = 0;
-		while( fgets( line, ATTRLIST_MAX_EXPRESSION+64, fp ) ) {
-            nlines += 1;
-            if (nlines <= maxfollow) {
-                dprintf(D_ALWAYS, "    %s", line);
-                int ll = strlen(line);
-                if (ll <= 0  ||  line[ll-1] != '\n') dprintf(D_ALWAYS, "\n");
-            }
-			if (sscanf( line, "%d ", &op ) != 1  ||  !valid_record_optype(op)) {
-				// no op field in line; more bad log records...
-				continue;
-			}
-			if( op == CondorLogOp_EndTransaction ) {
-					// aargh!  bad record in transaction.  abort!
-				EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
-			}
-		}
-
-		if( !feof( fp ) ) {
-			EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
-		}
-
-			// there wasn't an error in reading the file, and the bad log 
-			// record wasn't bracketed by a CloseTransaction; ignore all
-			// records starting from the bad record to the end-of-file, and
-			// pretend that we hit the end-of-file.
-		fseek( fp , 0, SEEK_END);
+		SkipCorruptLogRecords(fp, recnum, pos);
 		return( NULL );
 	}
 
@@ -1158,6 +1848,19 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
 	return log_rec;
 }
 
+LogRecord	*
+InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor)
+{
+	return InstantiateLogEntry(fp, recnum, type, body, ctor, true);
+}
+
+// instantiate a log entry, leaving SetAttribute values to be parsed later
+static LogRecord *
+InstantiateUnparsedLogEntry(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor)
+{
+	return InstantiateLogEntry(fp, recnum, type, body, ctor, false);
+}
+
 // Force instantiation of the simple form of ClassAdLog, used the the Accountant
 //
 template class ClassAdLog<std::string,ClassAd*>;
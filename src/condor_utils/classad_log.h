@@ -42,6 +42,9 @@
    internally by ClassAdLog to delimit transactions in the on-disk log.
 */
 
+#include <memory>
+#include <vector>
+
 #include "condor_classad.h"
 #include "log.h"
 #include "log_transaction.h"
@@ -84,7 +87,7 @@ class ClassAdLog {
 public:
 
 	ClassAdLog(const ConstructLogEntry* pc=NULL);
-	ClassAdLog(const char *filename,int max_historical_logs=0,const ConstructLogEntry* pc=NULL);
+	ClassAdLog(const char *filename,int max_historical_logs=0,const ConstructLogEntry* pc=NULL,int replay_threads=0);
 	~ClassAdLog();
 
 	// define an stl type iterator, but one that can filter based on a requirements expression
@@ -97,6 +100,14 @@ public:
 			int m_timeslice_ms;
 			int m_done;
 			int m_options;
+			int m_examined; // number of ads checked against the requirements
+			// when set, only the ads with these keys are visited, in this order,
+			// rather than every ad in the table.
+			std::shared_ptr<const std::vector<K> > m_keys;
+			size_t m_key_pos;
+			AD m_key_ad;
+
+			bool matches(AD ad);
 
 		public:
 			filter_iterator(ClassAdLog<K,AD> &log, const classad::ExprTree *requirements, int timeslice_ms, bool at_end=false)
@@ -106,10 +117,17 @@ public:
 				, m_requirements(requirements)
 				, m_timeslice_ms(timeslice_ms)
 				, m_done(at_end)
-				, m_options(0) {}
+				, m_options(0)
+				, m_examined(0)
+				, m_key_pos(0)
+				, m_key_ad(NULL) {}
 
 			~filter_iterator() {}
 			AD operator *() const {
+				if (m_keys) {
+					if (m_done || !m_found_ad) return NULL;
+					return m_key_ad;
+				}
 				if (m_done || (m_cur == m_table->end()) || !m_found_ad)
 					return NULL;
 				return (*m_cur).second;
@@ -121,18 +139,38 @@ public:
 				if (m_table != rhs.m_table) return false;
 				if (m_done && rhs.m_done) return true;
 				if (m_done != rhs.m_done) return false;
+				if (m_keys || rhs.m_keys) {
+					return m_keys == rhs.m_keys && m_key_pos == rhs.m_key_pos;
+				}
 				if (!(m_cur == rhs.m_cur) ) return false;
 				return true;
 			}
 			bool operator!=(const filter_iterator &rhs) {return !(*this == rhs);}
 			int set_options(int options) { int opts = m_options; m_options = options; return opts; }
 			int get_options() { return m_options; }
+			// visit only the ads with the given keys; they must be a superset of the ads that match.
+			void set_keys(const std::shared_ptr<const std::vector<K> > & keys) { m_keys = keys; m_key_pos = 0; }
+			bool has_keys() const { return (bool)m_keys; }
+			int examined() const { return m_examined; }
 	};
 
 
 	void AppendLog(LogRecord *log);	// perform a log operation
 	bool TruncLog();				// clean log file on disk
 
+	// Clean the log file without blocking while the table is written.
+	// BeginBackgroundTruncLog() sends new log records to a tail file.
+	// WriteSnapshot() writes the table to a snapshot file, and is meant
+	// to be called in a forked child, which sees the table as it was
+	// when the tail began.  EndBackgroundTruncLog() appends the tail to
+	// the snapshot and makes it the log.  If anything fails, it falls
+	// back to TruncLog().  Calling TruncLog() in between abandons the
+	// background truncation.
+	bool BeginBackgroundTruncLog();
+	bool WriteSnapshot();
+	bool EndBackgroundTruncLog(bool snapshot_written);
+	bool InBackgroundTruncLog() { return m_tail_offset > 0; }
+
 	void BeginTransaction();
 	bool AbortTransaction();
 	void CommitTransaction(const char * comment = NULL);
@@ -171,6 +209,17 @@ public:
 		// This means doing both a flush and fsync.
 	void ForceLog();
 
+		// Group commit: commit a transaction without forcing it to disk,
+		// leaving it for a later SyncGroupCommits() to make durable along
+		// with every other transaction committed this way since the last
+		// fsync.  Returns true if the transaction logged anything, so the
+		// caller knows whether it has something to wait for.
+	bool CommitGroupTransaction(const char * comment = NULL);
+		// Force the log if any group committed transactions are not yet
+		// on disk, returning how many there were.
+	int SyncGroupCommits();
+	int PendingGroupCommits() const { return m_group_commits; }
+
 	bool AdExistsInTableOrTransaction(const K& key);
 
 	// returns 1 and sets val if corresponding SetAttribute found
@@ -204,6 +253,12 @@ public:
 
 	time_t GetOrigLogBirthdate() {return m_original_log_birthdate;}
 
+	// Write new log records in the compact binary form (see log.h) rather
+	// than as text.  Records already in the log are not rewritten until the
+	// log is next truncated.  Readers accept either form.
+	void SetBinaryLog(bool binary) { m_binary_log = binary; }
+	bool GetBinaryLog() { return m_binary_log; }
+
 protected:
 	/** Returns handle to active transaction.  Upon return of this
 		method, any active transaction is forgotten.  It is the caller's
@@ -239,6 +294,9 @@ private:
 	unsigned long historical_sequence_number;
 	time_t m_original_log_birthdate;
 	int m_nondurable_level;
+	int m_group_commits;	// group committed transactions not yet forced to disk
+	long m_tail_offset;	// > 0 when log_fp is the tail of a background truncation
+	bool m_binary_log;	// write records in binary rather than text
 
 	bool SaveHistoricalLogs();
 };
@@ -252,9 +310,12 @@ public:
 	unsigned long get_historical_sequence_number() const {return historical_sequence_number;}
 	time_t get_timestamp() const {return timestamp;}
 
+
 private:
 	virtual int WriteBody(FILE *fp);
 	virtual int ReadBody(FILE *fp);
+	virtual int WriteBinaryBody(LogRecordBody & body);
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	virtual char const *get_key() {return NULL;}
 
@@ -331,6 +392,8 @@ public:
 private:
 	virtual int WriteBody(FILE *fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(LogRecordBody & body);
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	const ConstructLogEntry & ctor;
 	char *key;
@@ -349,6 +412,8 @@ public:
 private:
 	virtual int WriteBody(FILE* fp) { size_t r=fwrite(key, sizeof(char), strlen(key), fp); return (r < strlen(key)) ? -1 : (int)r;}
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(LogRecordBody & body) { body.putString(key); return 0; }
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	const ConstructLogEntry & ctor;
 	char *key;
@@ -365,14 +430,24 @@ public:
 	char const *get_value() { return value; }
     ExprTree* get_expr() { return value_expr; }
 
+	// Parse the value into an expression, unless it was read already parsed.
+	// Returns false if it does not parse.  Only this record is touched, so
+	// different records may be parsed on different threads at once.
+	bool ParseValue();
+	// Have ReadBody() leave the value for a later call to ParseValue()
+	void DeferParse() { defer_parse = true; }
+
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(LogRecordBody & body);
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	char *key;
 	char *name;
 	char *value;
 	bool is_dirty;
+	bool defer_parse;
     ExprTree* value_expr;    
 };
 
@@ -387,6 +462,8 @@ public:
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(LogRecordBody & body) { body.putString(key); body.putName(name); return 0; }
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	char *key;
 	char *name;
@@ -421,9 +498,12 @@ public:
 			comment = strdup(cmt);
 		}
 	}
+
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(LogRecordBody & body) { if (comment) { body.putString(comment); } return 0; }
+	virtual int ReadBinaryBody(LogRecordBody & body);
 
 	virtual char const *get_key() {return NULL;}
 	char * comment;
@@ -440,6 +520,48 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
+	MyString & errmsg,              // out
+	bool binary = false);           // in: write records in binary
+
+// Background truncation writes new records to filename.tail while a snapshot
+// of the table is written to filename.snapshot, then merges the two.
+bool BeginClassAdLogTail(
+	const char * filename,          // in
+	FILE* &log_fp,                  // in,out
+	unsigned long historical_sequence_number, // in
+	time_t m_original_log_birthdate, // in
+	long & tail_offset,             // out
+	MyString & errmsg,              // out
+	bool binary = false);           // in: write records in binary
+
+bool WriteClassAdLogSnapshot(
+	const char * filename,          // in
+	unsigned long historical_sequence_number, // in
+	time_t m_original_log_birthdate, // in
+	LoggableClassAdTable & la,      // in
+	const ConstructLogEntry& maker, // in
+	MyString & errmsg,              // out
+	bool binary = false);           // in: write records in binary
+
+bool MergeClassAdLogTail(
+	const char * filename,          // in
+	FILE* &log_fp,                  // in,out
+	long tail_offset,               // in
+	unsigned long & historical_sequence_number, // in,out
+	MyString & errmsg);             // out
+
+FILE* ReopenClassAdLogTail(
+	const char * filename,          // in
+	MyString & errmsg);             // out
+
+// Copy the records of the log in_name to out_name, written in binary or in
+// text.  Unterminated or corrupt records at the end are not copied, which
+// is what loading the log does with them too, and errmsg says so.
+bool ConvertClassAdLog(
+	const char * in_name,           // in
+	const char * out_name,          // in
+	bool binary,                    // in: write records in binary
+	unsigned long & count,          // out: the number of records copied
 	MyString & errmsg);             // out
 
 bool WriteClassAdLogState(
@@ -449,7 +571,8 @@ bool WriteClassAdLogState(
 	time_t original_log_birthdate,  // in
 	LoggableClassAdTable & la,      // in
 	const ConstructLogEntry& maker, // in
-	MyString & errmsg);             // out
+	MyString & errmsg,              // out
+	bool binary = false);           // in: write records in binary
 
 FILE* LoadClassAdLog(
 	const char *filename,           // in
@@ -459,7 +582,8 @@ FILE* LoadClassAdLog(
 	time_t & m_original_log_birthdate, // in,out
 	bool & is_clean,  // out: true if log was shutdown cleanly
 	bool & requires_successful_cleaning, // out: true if log must be cleaned (i.e rotated) before it can be written to again.
-	MyString & errmsg);             // out, contains error or warning messages
+	MyString & errmsg,              // out, contains error or warning messages
+	int replay_threads = 0);        // in: parse the records on this many threads when more than 1
 
 int FlushClassAdLog(FILE* fp, bool force);
 
@@ -491,19 +615,23 @@ LogRecord* InstantiateLogEntry(
 	FILE* fp,
 	unsigned long recnum,
 	int type,
+	LogRecordBody * body,           // in: the body of a binary record, NULL for a text record
 	const ConstructLogEntry & ctor);
 
 // Templated member functions that call the helper functions with the correct arguments.
 //
 
 template <typename K, typename AD>
-ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,const ConstructLogEntry* maker)
+ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,const ConstructLogEntry* maker,int replay_threads)
 	: table(hashFunction)
 	, make_table_entry(maker)
 {
 	log_filename_buf = filename;
 	active_transaction = NULL;
 	m_nondurable_level = 0;
+	m_group_commits = 0;
+	m_tail_offset = 0;
+	m_binary_log = false;
 
 	bool open_read_only = max_historical_logs_arg < 0;
 	if (open_read_only) { max_historical_logs_arg = -max_historical_logs_arg; }
@@ -518,7 +646,7 @@ ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,co
 	log_fp = LoadClassAdLog(filename,
 		la, this->GetTableEntryMaker(),
 		historical_sequence_number, m_original_log_birthdate,
-		is_clean, requires_successful_cleaning, errmsg);
+		is_clean, requires_successful_cleaning, errmsg, replay_threads);
 
 	if ( ! log_fp) {
 		EXCEPT("%s", errmsg.Value());
@@ -543,6 +671,9 @@ ClassAdLog<K,AD>::ClassAdLog(const ConstructLogEntry* maker)
 	active_transaction = NULL;
 	log_fp = NULL;
 	m_nondurable_level = 0;
+	m_group_commits = 0;
+	m_tail_offset = 0;
+	m_binary_log = false;
 	max_historical_logs = 0;
 	historical_sequence_number = 0;
 }
@@ -584,7 +715,7 @@ ClassAdLog<K,AD>::AppendLog(LogRecord *log)
 	} else {
 			//MD: using file pointer
 		if (log_fp!=NULL) {
-			if (log->Write(log_fp) < 0) {
+			if (log->Write(log_fp, m_binary_log) < 0) {
 				EXCEPT("write to %s failed, errno = %d", logFilename(), errno);
 			}
 			if( m_nondurable_level == 0 ) {
@@ -617,6 +748,7 @@ ClassAdLog<K,AD>::ForceLog()
 	if (err) {
 		EXCEPT("fsync of %s failed, errno = %d", logFilename(), err);
 	}
+	m_group_commits = 0;
 }
 
 template <typename K, typename AD>
@@ -632,7 +764,9 @@ ClassAdLog<K,AD>::TruncLog()
 {
 	dprintf(D_ALWAYS,"About to rotate ClassAd log %s\n",logFilename());
 
-	if(!SaveHistoricalLogs()) {
+	// a background truncation already saved the log it began with
+	bool in_background = InBackgroundTruncLog();
+	if(!in_background && !SaveHistoricalLogs()) {
 		dprintf(D_ALWAYS,"Skipping log rotation, because saving of historical log failed for %s.\n",logFilename());
 		return false;
 	}
@@ -642,7 +776,15 @@ ClassAdLog<K,AD>::TruncLog()
 	bool rotated = TruncateClassAdLog(logFilename(),
 		la, this->GetTableEntryMaker(),
 		log_fp, historical_sequence_number, m_original_log_birthdate,
-		errmsg);
+		errmsg, m_binary_log);
+	if (in_background && ! rotated && log_fp) {
+		// the failed rotation reopened the log, but records must go to
+		// the tail until the log includes it.
+		fclose(log_fp);
+		log_fp = ReopenClassAdLogTail(logFilename(), errmsg);
+	} else if (rotated) {
+		m_tail_offset = 0;
+	}
 	if ( ! log_fp) {
 		// if after rotation, the log is no longer open, the the failure is fatal, and we must except
 		EXCEPT("%s", errmsg.Value());
@@ -654,6 +796,88 @@ ClassAdLog<K,AD>::TruncLog()
 	return rotated;
 }
 
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::BeginBackgroundTruncLog()
+{
+	if (InBackgroundTruncLog() || ! log_fp) {
+		return false;
+	}
+
+	dprintf(D_ALWAYS,"About to rotate ClassAd log %s in the background\n",logFilename());
+
+	if(!SaveHistoricalLogs()) {
+		dprintf(D_ALWAYS,"Skipping log rotation, because saving of historical log failed for %s.\n",logFilename());
+		return false;
+	}
+
+	MyString errmsg;
+	if ( ! BeginClassAdLogTail(logFilename(), log_fp,
+			historical_sequence_number, m_original_log_birthdate,
+			m_tail_offset, errmsg, m_binary_log)) {
+		dprintf(D_ALWAYS, "Not rotating ClassAd log %s in the background: %s", logFilename(), errmsg.Value());
+		m_tail_offset = 0;
+		return false;
+	}
+	if ( ! errmsg.empty()) {
+		dprintf(D_ALWAYS, "%s\n", errmsg.Value());
+	}
+	return true;
+}
+
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::WriteSnapshot()
+{
+	MyString errmsg;
+	ClassAdLogTable<K,AD> la(table);
+	bool success = WriteClassAdLogSnapshot(logFilename(),
+		historical_sequence_number, m_original_log_birthdate,
+		la, this->GetTableEntryMaker(),
+		errmsg, m_binary_log);
+	if ( ! success) {
+		dprintf(D_ALWAYS, "Failed to write snapshot of ClassAd log %s: %s\n", logFilename(), errmsg.Value());
+	}
+	return success;
+}
+
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::EndBackgroundTruncLog(bool snapshot_written)
+{
+	MyString snapshot_filename;
+	snapshot_filename.formatstr("%s.snapshot", logFilename());
+
+	if ( ! InBackgroundTruncLog()) {
+		// TruncLog() was called in the meantime, so this snapshot is stale
+		unlink(snapshot_filename.Value());
+		return false;
+	}
+
+	if (snapshot_written) {
+		MyString errmsg;
+		bool merged = MergeClassAdLogTail(logFilename(), log_fp, m_tail_offset,
+			historical_sequence_number, errmsg);
+		if (merged) {
+			m_tail_offset = 0;
+			if ( ! log_fp) {
+				EXCEPT("%s", errmsg.Value());
+			}
+			if ( ! errmsg.empty()) {
+				dprintf(D_ALWAYS, "%s\n", errmsg.Value());
+			}
+			dprintf(D_ALWAYS, "Rotated ClassAd log %s in the background\n", logFilename());
+			return true;
+		}
+		dprintf(D_ALWAYS, "Failed to merge the tail of ClassAd log %s: %s", logFilename(), errmsg.Value());
+	} else {
+		unlink(snapshot_filename.Value());
+	}
+
+	// the log must not stay split in two, so rotate it the slow way
+	return TruncLog();
+}
+
 template <typename K, typename AD>
 void
 ClassAdLog<K,AD>::LogState(FILE *fp)
@@ -663,7 +887,7 @@ ClassAdLog<K,AD>::LogState(FILE *fp)
 	bool success = WriteClassAdLogState(fp, logFilename(),
 		historical_sequence_number, m_original_log_birthdate,
 		la, this->GetTableEntryMaker(),
-		errmsg);
+		errmsg, m_binary_log);
 	if (! success) {
 		EXCEPT("%s", errmsg.Value());
 	}
@@ -722,7 +946,11 @@ ClassAdLog<K,AD>::CommitTransaction(const char * comment /*=NULL*/)
 		active_transaction->AppendLog(log);
 		bool nondurable = m_nondurable_level > 0;
 		ClassAdLogTable<K,AD> la(table);
-		active_transaction->Commit(log_fp, logFilename(), &la, nondurable );
+		active_transaction->Commit(log_fp, logFilename(), &la, nondurable, m_binary_log );
+		if ( ! nondurable) {
+				// the fsync covered everything written before it
+			m_group_commits = 0;
+		}
 	}
 	delete active_transaction;
 	active_transaction = NULL;
@@ -737,6 +965,30 @@ ClassAdLog<K,AD>::CommitNondurableTransaction(const char * comment /*=NULL*/)
 	DecNondurableCommitLevel( old_level );
 }
 
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::CommitGroupTransaction(const char * comment /*=NULL*/)
+{
+	if (!active_transaction || active_transaction->EmptyTransaction()) {
+		CommitTransaction(comment);
+		return false;
+	}
+	CommitNondurableTransaction(comment);
+	m_group_commits++;
+	return true;
+}
+
+template <typename K, typename AD>
+int
+ClassAdLog<K,AD>::SyncGroupCommits()
+{
+	int synced = m_group_commits;
+	if (synced > 0) {
+		ForceLog();
+	}
+	return synced;
+}
+
 template <typename K, typename AD>
 bool
 ClassAdLog<K,AD>::AdExistsInTableOrTransaction(const K& key)
@@ -24,6 +24,7 @@
 #include "condor_attributes.h"
 #include "my_hostname.h"
 #include "string_list.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -37,6 +38,8 @@ int _putClassAd(Stream *sock, const classad::ClassAd& ad, int options,
 int _putClassAd(Stream *sock, const classad::ClassAd& ad, int options,
 	const classad::References &whitelist, const classad::References *encrypted_attrs);
 int _mergeStringListIntoWhitelist(StringList & list_in, classad::References & whitelist_out);
+int _putSerializedClassAd(Stream *sock, const classad::ClassAd& ad, const SerializedClassAd &wire,
+	int options, const classad::References *whitelist);
 
 
 static bool publish_server_timeMangled = false;
@@ -544,6 +547,25 @@ int putClassAd ( Stream *sock, const classad::ClassAd& ad )
 	return _putClassAd(sock, ad, options, nullptr);
 }
 
+// add the attributes in the whitelist that exist in the ad, and the attributes they refer to, to expanded_whitelist
+static void _expandWhitelist(const classad::ClassAd& ad, const classad::References &whitelist, classad::References &expanded_whitelist)
+{
+	// Jaime made changes to the core classad lib that make this unneeded...
+	//ad.InsertAttr("MY","SELF");
+	for (classad::References::const_iterator attr = whitelist.begin(); attr != whitelist.end(); ++attr) {
+		ExprTree * tree = ad.Lookup(*attr);
+		if (tree) {
+			expanded_whitelist.insert(*attr); // the node exists, so add it to the final whitelist
+			if (tree->GetKind() != ExprTree::LITERAL_NODE) {
+				ad.GetInternalReferences(tree, expanded_whitelist, false);
+			}
+		}
+	}
+	//ad.Delete("MY");
+	//classad::References::iterator my = expanded_whitelist.find("MY");
+	//if (my != expanded_whitelist.end()) { expanded_whitelist.erase(my); }
+}
+
 int putClassAd (Stream *sock, const classad::ClassAd& ad, int options, const classad::References * whitelist /*=nullptr*/, const classad::References * encrypted_attrs /*=nullptr*/)
 {
 	int retval = 0;
@@ -551,20 +573,7 @@ int putClassAd (Stream *sock, const classad::ClassAd& ad, int options, const cla
 
 	bool expand_whitelist = ! (options & PUT_CLASSAD_NO_EXPAND_WHITELIST);
 	if (whitelist && expand_whitelist) {
-		// Jaime made changes to the core classad lib that make this unneeded...
-		//ad.InsertAttr("MY","SELF");
-		for (classad::References::const_iterator attr = whitelist->begin(); attr != whitelist->end(); ++attr) {
-			ExprTree * tree = ad.Lookup(*attr);
-			if (tree) {
-				expanded_whitelist.insert(*attr); // the node exists, so add it to the final whitelist
-				if (tree->GetKind() != ExprTree::LITERAL_NODE) {
-					ad.GetInternalReferences(tree, expanded_whitelist, false);
-				}
-			}
-		}
-		//ad.Delete("MY");
-		//classad::References::iterator my = expanded_whitelist.find("MY");
-		//if (my != expanded_whitelist.end()) { expanded_whitelist.erase(my); }
+		_expandWhitelist(ad, *whitelist, expanded_whitelist);
 		whitelist = &expanded_whitelist;
 	}
 
@@ -818,3 +827,172 @@ int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options, const cl
 
 	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes);
 }
+
+
+void SerializedClassAd::clear()
+{
+	m_buf.clear();
+	m_attrs.clear();
+	m_lines.clear();
+	m_num_public = 0;
+	m_public_bytes = 0;
+}
+
+void SerializedClassAd::serialize(const classad::ClassAd &ad)
+{
+	clear();
+	if (ad.GetChainedParentAd()) {
+		return;
+	}
+
+	classad::ClassAdUnParser unp;
+	unp.SetOldClassAd( true, true );
+
+	// two passes, so that the public lines are contiguous at the front of the buffer
+	// and can be sent with a single put_bytes when the stream is not encrypted.
+	for (int pass = 0; pass < 2; ++pass) {
+		bool want_private = (pass == 1);
+		for (classad::ClassAd::const_iterator itr = ad.begin(); itr != ad.end(); ++itr) {
+			if (ClassAdAttributeIsPrivate(itr->first) != want_private) {
+				continue;
+			}
+			Line line;
+			line.offset = (unsigned int)m_buf.size();
+			line.name_len = (unsigned int)itr->first.size();
+			m_buf += itr->first;
+			m_buf += " = ";
+			unp.Unparse(m_buf, itr->second);
+			m_buf += '\0';
+			m_lines.push_back(line);
+		}
+		if ( ! want_private) {
+			m_num_public = m_lines.size();
+			m_public_bytes = m_buf.size();
+		}
+	}
+
+	m_attrs = m_lines;
+	const char * base = m_buf.c_str();
+	std::sort(m_attrs.begin(), m_attrs.end(), [base](const Line &a, const Line &b) {
+		int diff = strncasecmp(base + a.offset, base + b.offset, MIN(a.name_len, b.name_len));
+		return diff < 0 || (diff == 0 && a.name_len < b.name_len);
+	});
+}
+
+const SerializedClassAd::Line * SerializedClassAd::find(const std::string &attr) const
+{
+	const char * base = m_buf.c_str();
+	size_t lo = 0, hi = m_attrs.size();
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		const Line &line = m_attrs[mid];
+		int diff = strncasecmp(base + line.offset, attr.c_str(), MIN((size_t)line.name_len, attr.size()));
+		if (diff == 0) {
+			if (line.name_len == attr.size()) { return &line; }
+			diff = (line.name_len < attr.size()) ? -1 : 1;
+		}
+		if (diff < 0) { lo = mid + 1; } else { hi = mid; }
+	}
+	return NULL;
+}
+
+int putClassAd (Stream *sock, const classad::ClassAd& ad, const SerializedClassAd &wire, int options, const classad::References * whitelist /*=nullptr*/)
+{
+	int retval = 0;
+	classad::References expanded_whitelist; // in case we need to expand the whitelist
+
+	bool expand_whitelist = ! (options & PUT_CLASSAD_NO_EXPAND_WHITELIST);
+	if (whitelist && expand_whitelist) {
+		_expandWhitelist(ad, *whitelist, expanded_whitelist);
+		whitelist = &expanded_whitelist;
+	}
+
+	bool non_blocking = (options & PUT_CLASSAD_NON_BLOCKING) != 0;
+	ReliSock* rsock = static_cast<ReliSock*>(sock);
+	if (non_blocking && rsock)
+	{
+		BlockingModeGuard guard(rsock, true);
+		retval = _putSerializedClassAd(sock, ad, wire, options, whitelist);
+		bool backlog = rsock->clear_backlog_flag();
+		if (retval && backlog) { retval = 2; }
+	}
+	else // normal blocking mode put
+	{
+		retval = _putSerializedClassAd(sock, ad, wire, options, whitelist);
+	}
+	return retval;
+}
+
+int _putSerializedClassAd(Stream *sock, const classad::ClassAd& ad, const SerializedClassAd &wire,
+	int options, const classad::References *whitelist)
+{
+	bool excludeTypes = (options & PUT_CLASSAD_NO_TYPES) == PUT_CLASSAD_NO_TYPES;
+	bool exclude_private = (options & PUT_CLASSAD_NO_PRIVATE) == PUT_CLASSAD_NO_PRIVATE;
+	bool send_server_time = publish_server_timeMangled;
+
+	// build the list of lines to send, if there is a whitelist.
+	std::vector<std::pair<const SerializedClassAd::Line *, bool> > lines; // line and is_private
+	int numExprs = 0;
+	if (whitelist) {
+		lines.reserve(whitelist->size());
+		for (classad::References::const_iterator attr = whitelist->begin(); attr != whitelist->end(); ++attr) {
+			if (send_server_time && strcasecmp(attr->c_str(), ATTR_SERVER_TIME) == 0) {
+				continue;
+			}
+			const SerializedClassAd::Line *line = wire.find(*attr);
+			bool is_private = ClassAdAttributeIsPrivate(*attr);
+			if ( ! line || (exclude_private && is_private)) {
+				continue;
+			}
+			lines.push_back(std::make_pair(line, is_private));
+		}
+		numExprs = (int)lines.size();
+	} else {
+		numExprs = (int)(exclude_private ? wire.m_num_public : wire.m_lines.size());
+	}
+	if (send_server_time) {
+		++numExprs;
+	}
+
+	sock->encode( );
+	if( !sock->code( numExprs ) ) {
+		return false;
+	}
+
+	const char * base = wire.m_buf.c_str();
+	bool crypto_is_noop = sock->prepare_crypto_for_secret_is_noop();
+	if (whitelist) {
+		for (size_t ix = 0; ix < lines.size(); ++ix) {
+			const char * line = base + lines[ix].first->offset;
+			if ( ! crypto_is_noop && lines[ix].second) {
+				if (!sock->put(SECRET_MARKER)) {
+					return false;
+				}
+				if (!sock->put_secret(line)) {
+					return false;
+				}
+			} else if ( ! sock->put(line)) {
+				return false;
+			}
+		}
+	} else {
+		// like _putClassAd, which sends the private attributes in the clear when it sends
+		// them at all.  Without encryption a string goes on the wire as its bytes and a
+		// terminating null, which is exactly how the lines are stored in the buffer.
+		size_t num_lines = exclude_private ? wire.m_num_public : wire.m_lines.size();
+		int num_bytes = (int)(exclude_private ? wire.m_public_bytes : wire.m_buf.size());
+		if ( ! sock->get_encryption()) {
+			if (num_bytes && sock->put_bytes(base, num_bytes) != num_bytes) {
+				return false;
+			}
+		} else {
+			for (size_t ix = 0; ix < num_lines; ++ix) {
+				if ( ! sock->put(base + wire.m_lines[ix].offset)) {
+					return false;
+				}
+			}
+		}
+	}
+
+	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes);
+}
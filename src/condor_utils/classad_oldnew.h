@@ -82,6 +82,46 @@ int putClassAd (Stream *sock, const classad::ClassAd& ad, int options,
 #define PUT_CLASSAD_NON_BLOCKING        0x04 // use non-blocking sematics. returns 2 of this would have blocked.
 #define PUT_CLASSAD_NO_EXPAND_WHITELIST 0x08 // use the whitelist argument as-is, (default is to expand internal references before using it)
 
+/** A ClassAd unparsed into the form that putClassAd sends on the wire, so that an ad
+ * which is sent many times (i.e. by the collector) need only be unparsed once.
+ * The ad must be re-serialized whenever it changes.  Chained ads are not supported,
+ * serialize() leaves the object empty if the ad has a chained parent.
+ */
+class SerializedClassAd {
+public:
+	SerializedClassAd() : m_num_public(0), m_public_bytes(0) {}
+
+	void serialize(const classad::ClassAd &ad);
+	void clear();
+	bool empty() const { return m_attrs.empty(); }
+	size_t bytes() const { return m_buf.size(); }
+
+private:
+	friend int _putSerializedClassAd(Stream *sock, const classad::ClassAd& ad, const SerializedClassAd &wire,
+		int options, const classad::References *whitelist);
+
+	// a single "attr = value" line in m_buf, the public lines come first
+	struct Line {
+		unsigned int offset;
+		unsigned int name_len;
+	};
+	const Line * find(const std::string &attr) const;
+
+	std::string m_buf;           // null terminated lines, public lines then private lines
+	std::vector<Line> m_attrs;   // sorted by case-insensitive attribute name
+	std::vector<Line> m_lines;   // in the order they appear in m_buf
+	size_t m_num_public;
+	size_t m_public_bytes;
+};
+
+/** As putClassAd above, but send the ad from its serialized form.  The wire must have
+ * been serialized from the current contents of the ad; the ad itself is used only to expand
+ * the whitelist.  There is no encrypted_attrs argument, only private attributes are sent
+ * as secrets (and only when there is a whitelist, as with putClassAd).
+ */
+int putClassAd (Stream *sock, const classad::ClassAd& ad, const SerializedClassAd &wire,
+	int options, const classad::References * whitelist = nullptr);
+
 // fetch the given attribute from the queryAd and convert it into a set of attributes
 //   the attribute should be a string value containing a comma and/or space separated list of attributes (like StringList)
 //   if allow_list is true, then attribute is permitted to be a classad list of strings each of which is an attribute of the projection.
@@ -306,6 +306,7 @@ const struct Translation CollectorTranslation[] = {
 	{ "QUERY_GRID_ADS", QUERY_GRID_ADS },
 	{ "INVALIDATE_GRID_ADS", INVALIDATE_GRID_ADS },
 	{ "MERGE_STARTD_AD", MERGE_STARTD_AD },
+	{ "UPDATE_STARTD_AD_DELTA", UPDATE_STARTD_AD_DELTA },
 	{ "UPDATE_ACCOUNTING_AD", UPDATE_ACCOUNTING_AD },
 	{ "QUERY_ACCOUNTING_ADS", QUERY_ACCOUNTING_ADS },
 	{ "INVALIDATE_ACCOUNTING_ADS", INVALIDATE_ACCOUNTING_ADS },
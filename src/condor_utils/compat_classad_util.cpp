@@ -23,6 +23,7 @@
 #include "string_list.h"
 #include "condor_adtypes.h"
 #include "classad/classadCache.h" // for CachedExprEnvelope
+#include "classad/compiledExpr.h"
 
 #include "compat_classad_list.h"
 #ifdef _OPENMP
@@ -552,6 +553,58 @@ int GetAttrRefsOfScope(classad::ExprTree * expr, classad::References &attrs, con
 	 return walk_attr_refs(expr, AccumAttrsOfScopes, &tmp);
 }
 
+// add the attributes that expr refers to without a scope to attrs.  returns false if the value
+// of expr can also depend on attributes that can't be listed.
+bool GetUnscopedAttrRefs(classad::ExprTree * tree, classad::References &attrs)
+{
+	if ( ! tree) return true;
+	switch (tree->GetKind()) {
+	case classad::ExprTree::LITERAL_NODE: {
+		classad::Value val;
+		classad::Value::NumberFactor factor;
+		((classad::Literal*)tree)->GetComponents(val, factor);
+		return ! val.IsClassAdValue();
+	}
+	case classad::ExprTree::ATTRREF_NODE: {
+		classad::ExprTree * scope = NULL;
+		std::string attr;
+		bool absolute = false;
+		((classad::AttributeReference*)tree)->GetComponents(scope, attr, absolute);
+		if (scope || absolute) return false;
+		attrs.insert(attr);
+		return true;
+	}
+	case classad::ExprTree::OP_NODE: {
+		classad::Operation::OpKind op;
+		classad::ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+		((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+		return GetUnscopedAttrRefs(t1, attrs) && GetUnscopedAttrRefs(t2, attrs) && GetUnscopedAttrRefs(t3, attrs);
+	}
+	case classad::ExprTree::FN_CALL_NODE: {
+		std::string fn;
+		std::vector<classad::ExprTree*> args;
+		((classad::FunctionCall*)tree)->GetComponents(fn, args);
+		// eval() can refer to any attribute
+		if (MATCH == strcasecmp(fn.c_str(), "eval")) return false;
+		for (size_t ix = 0; ix < args.size(); ++ix) {
+			if ( ! GetUnscopedAttrRefs(args[ix], attrs)) return false;
+		}
+		return true;
+	}
+	case classad::ExprTree::EXPR_LIST_NODE: {
+		std::vector<classad::ExprTree*> items;
+		((classad::ExprList*)tree)->GetComponents(items);
+		for (size_t ix = 0; ix < items.size(); ++ix) {
+			if ( ! GetUnscopedAttrRefs(items[ix], attrs)) return false;
+		}
+		return true;
+	}
+	case classad::ExprTree::EXPR_ENVELOPE:
+		return GetUnscopedAttrRefs(SkipExprEnvelope(tree), attrs);
+	default:
+		return false;
+	}
+}
 
 // edit the given expr changing attribute references as the mapping indicates
 int RewriteAttrRefs(classad::ExprTree * tree, const NOCASE_STRING_MAP & mapping)
@@ -656,6 +709,72 @@ int RewriteAttrRefs(classad::ExprTree * tree, const NOCASE_STRING_MAP & mapping)
 }
 
 
+bool ExprTreeDependsOnTime(const classad::ExprTree * tree)
+{
+	if ( ! tree) return false;
+	switch (tree->GetKind()) {
+		case classad::ExprTree::LITERAL_NODE:
+			return false;
+
+		case classad::ExprTree::ATTRREF_NODE: {
+			classad::ExprTree *expr;
+			std::string ref;
+			bool absolute;
+			((const classad::AttributeReference*)tree)->GetComponents(expr, ref, absolute);
+			if (strcasecmp(ref.c_str(), "CurrentTime") == MATCH) return true;
+			return ExprTreeDependsOnTime(expr);
+		}
+
+		case classad::ExprTree::OP_NODE: {
+			classad::Operation::OpKind op;
+			classad::ExprTree *t1, *t2, *t3;
+			((const classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+			return ExprTreeDependsOnTime(t1) || ExprTreeDependsOnTime(t2) || ExprTreeDependsOnTime(t3);
+		}
+
+		case classad::ExprTree::FN_CALL_NODE: {
+			static const char * const volatile_fns[] = {
+				"absTime", "currentTime", "dayTime", "eval", "formatTime",
+				"random", "time", "userMap",
+			};
+			std::string fnName;
+			std::vector<classad::ExprTree*> args;
+			((const classad::FunctionCall*)tree)->GetComponents(fnName, args);
+			for (size_t ix = 0; ix < COUNTOF(volatile_fns); ++ix) {
+				if (strcasecmp(fnName.c_str(), volatile_fns[ix]) == MATCH) return true;
+			}
+			for (auto it = args.begin(); it != args.end(); ++it) {
+				if (ExprTreeDependsOnTime(*it)) return true;
+			}
+			return false;
+		}
+
+		case classad::ExprTree::CLASSAD_NODE: {
+			std::vector< std::pair<std::string, classad::ExprTree*> > attrs;
+			((const classad::ClassAd*)tree)->GetComponents(attrs);
+			for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+				if (ExprTreeDependsOnTime(it->second)) return true;
+			}
+			return false;
+		}
+
+		case classad::ExprTree::EXPR_LIST_NODE: {
+			std::vector<classad::ExprTree*> exprs;
+			((const classad::ExprList*)tree)->GetComponents(exprs);
+			for (auto it = exprs.begin(); it != exprs.end(); ++it) {
+				if (ExprTreeDependsOnTime(*it)) return true;
+			}
+			return false;
+		}
+
+		case classad::ExprTree::EXPR_ENVELOPE:
+			return ExprTreeDependsOnTime(SkipExprEnvelope(const_cast<classad::ExprTree*>(tree)));
+
+		default:
+			return true;
+	}
+}
+
 bool EvalExprBool(ClassAd *ad, const char *constraint)
 {
 	static classad::ExprTree *tree = NULL;
@@ -805,6 +924,17 @@ bool IsAMatch( ClassAd *ad1, ClassAd *ad2 )
 	return result;
 }
 
+bool IsAMatch( ClassAd *ad1, const classad::CompiledExpr *ad1_requirements, ClassAd *ad2 )
+{
+	classad::MatchClassAd *mad = getTheMatchAd( ad1, ad2 );
+
+	mad->SetLeftRequirements( ad1_requirements );
+	bool result = mad->symmetricMatch();
+
+	releaseTheMatchAd();
+	return result;
+}
+
 static classad::MatchClassAd *match_pool = NULL;
 static ClassAd *target_pool = NULL;
 static std::vector<ClassAd*> *matched_ads = NULL;
@@ -814,7 +944,7 @@ bool ParallelIsAMatch(ClassAd *ad1, std::vector<ClassAd*> &candidates, std::vect
 	int adCount = candidates.size();
 	static int cpu_count = 0;
 	int current_cpu_count = threads;
-	int iterations = 0;
+	int chunk = 0;
 	size_t matched = 0;
 
 	if(cpu_count != current_cpu_count)
@@ -854,61 +984,62 @@ bool ParallelIsAMatch(ClassAd *ad1, std::vector<ClassAd*> &candidates, std::vect
 		matched_ads[index].clear();
 	}
 
-	iterations = ((candidates.size() - 1) / cpu_count) + 1;
+	// The first candidate is evaluated on this thread before any others are
+	// started, so that whatever the ClassAd library sets up the first time an
+	// expression is evaluated is already in place when the threads share it.
+	int first = 0;
+	{
+		ClassAd *ad2 = candidates[0];
+		bool result = false;
+
+		match_pool[0].ReplaceRightAd(ad2);
+		if(halfMatch)
+			result = match_pool[0].rightMatchesLeft();
+		else
+			result = match_pool[0].symmetricMatch();
+		match_pool[0].RemoveRightAd();
+
+		if(result)
+		{
+			matched_ads[0].push_back(ad2);
+		}
+		first = 1;
+	}
+
+	// Each thread gets a contiguous slice of the remaining candidates, and the
+	// slices are concatenated in order below, so the matches come back in the
+	// same order as the candidates no matter how many threads there are.
+	// Without OpenMP the slices are simply evaluated one after another.
+	int remaining = adCount - first;
+	chunk = remaining > 0 ? ((remaining - 1) / cpu_count) + 1 : 0;
 
 #ifdef _OPENMP
 	omp_set_num_threads(cpu_count);
 #endif
 
-#pragma omp parallel
+#pragma omp parallel for schedule(static,1)
+	for(int part = 0; part < cpu_count; part++)
 	{
-
-#ifdef _OPENMP
-		int omp_id = omp_get_thread_num();
-#else
-		int omp_id = 0;
-#endif
-		for(int index = 0; index < iterations; index++)
+		int end = first + (part + 1) * chunk;
+		if(end > adCount)
+			end = adCount;
+		for(int offset = first + part * chunk; offset < end; offset++)
 		{
 			bool result = false;
-			int offset = omp_id + index * cpu_count;
-			if(offset >= adCount)
-				break;
 			ClassAd *ad2 = candidates[offset];
 
-/*
-			if(halfMatch)
-			{
-				char const *my_target_type = target_pool[omp_id].GetTargetTypeName();
-				char const *target_type = ad2->GetMyTypeName();
-				if( !my_target_type ) {
-					my_target_type = "";
-				}
-				if( !target_type ) {
-					target_type = "";
-				}
-				if( strcasecmp(target_type,my_target_type) &&
-					strcasecmp(my_target_type,ANY_ADTYPE) )
-				{
-					result = false;
-					continue;
-				}
-			}
-*/
-
+			match_pool[part].ReplaceRightAd(ad2);
 
-			match_pool[omp_id].ReplaceRightAd(ad2);
-		
 			if(halfMatch)
-				result = match_pool[omp_id].rightMatchesLeft();
+				result = match_pool[part].rightMatchesLeft();
 			else
-				result = match_pool[omp_id].symmetricMatch();
+				result = match_pool[part].symmetricMatch();
 
-			match_pool[omp_id].RemoveRightAd();
+			match_pool[part].RemoveRightAd();
 
 			if(result)
 			{
-				matched_ads[omp_id].push_back(ad2);
+				matched_ads[part].push_back(ad2);
 			}
 		}
 	}
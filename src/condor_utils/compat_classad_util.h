@@ -76,6 +76,16 @@ int RewriteAttrRefs(classad::ExprTree * expr, const NOCASE_STRING_MAP & mapping)
 // and the expression contains MY.Foo, the Foo is added to attrs.
 int GetAttrRefsOfScope(classad::ExprTree * expr, classad::References &attrs, const std::string &scope);
 
+// add the attributes that expr refers to without a scope to attrs.  returns false if the value
+// of expr can also depend on attributes that can't be listed, because it has a scoped or
+// absolute attribute reference, a nested ClassAd or a call to eval().
+bool GetUnscopedAttrRefs(classad::ExprTree * expr, classad::References &attrs);
+
+// returns true if the value of the expression can change without any
+// attribute changing, because it uses the current time, a random number
+// or a function that looks outside the ad
+bool ExprTreeDependsOnTime(const classad::ExprTree * expr);
+
 classad::ExprTree * SkipExprEnvelope(classad::ExprTree * tree);
 classad::ExprTree * SkipExprParens(classad::ExprTree * tree);
 // create an op node, using copies of the input expr trees. this function will not copy envelope nodes (it skips over them)
@@ -99,8 +109,18 @@ int EvalExprTree( classad::ExprTree *expr, ClassAd *source,
 //ad2 treated as candidate to match against ad1, so we want to find a match for ad1
 bool IsAMatch( ClassAd *ad1, ClassAd *ad2 );
 
+// as above, but evaluate the Requirements of ad1 with ad1_requirements, which
+// must have been compiled from the Requirements currently in ad1.
+namespace classad { class CompiledExpr; }
+bool IsAMatch( ClassAd *ad1, const classad::CompiledExpr *ad1_requirements, ClassAd *ad2 );
+
 bool IsAHalfMatch( ClassAd *my, ClassAd *target );
 
+// evaluate ad1 against each of the candidates using up to threads threads, the matches
+// are appended to matches in the same order that they appear in candidates, so the
+// result does not depend on the number of threads.  Each candidate is only touched by
+// one thread, but the candidates must not be lazily parsed ads, since evaluating those
+// parses them in place.
 bool ParallelIsAMatch(ClassAd *ad1, std::vector<ClassAd*> &candidates, std::vector<ClassAd*> &matches, int threads, bool halfMatch = false);
 
 void AddClassAdXMLFileHeader(std::string &buffer);
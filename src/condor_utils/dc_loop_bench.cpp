@@ -0,0 +1,150 @@
+// A DaemonCore daemon that measures the cost of one trip around the
+// event loop while a large number of idle sockets are registered.
+//
+// usage: condor_dc_loop_bench -f -t [-n <idle sockets>] [-i <cycles>]
+//
+// Run it once with DAEMON_CORE_USE_EPOLL=True and once with False to
+// compare the epoll and select() backends.
+
+#include "condor_common.h"
+#include "condor_daemon_core.h"
+#include "subsystem_info.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "reli_sock.h"
+
+#include <stdio.h>
+#include <vector>
+
+static int num_sockets = 10000;
+static int num_cycles = 10000;
+
+static int hot_pipe[2];
+static int cycles_done = 0;
+static double start_time = 0;
+static std::vector<ReliSock *> idle_socks;
+static std::vector<int> idle_peers;
+
+static void
+usage( const char * name ) {
+	fprintf( stderr, "usage: %s -f -t [-n <idle sockets>] [-i <cycles>]\n", name );
+	DC_Exit( 1 );
+}
+
+static int
+idle_socket_handler( Stream * ) {
+	dprintf( D_ALWAYS, "idle socket became ready; the benchmark is not measuring idle sockets\n" );
+	return KEEP_STREAM;
+}
+
+// Exactly one byte is ever in flight on the hot pipe, so this handler runs
+// once per trip around the event loop.
+static int
+hot_pipe_handler( int ) {
+	char c;
+	if( daemonCore->Read_Pipe( hot_pipe[0], &c, 1 ) != 1 ) {
+		EXCEPT( "failed to read from hot pipe" );
+	}
+
+	cycles_done++;
+	if( cycles_done == 1 ) {
+		// Don't count the first cycle; that is when every idle socket
+		// gets handed to the kernel.
+		start_time = _condor_debug_get_time_double();
+	} else if( cycles_done > num_cycles ) {
+		double elapsed = _condor_debug_get_time_double() - start_time;
+		double usec = elapsed * 1e6 / num_cycles;
+		bool use_epoll = param_boolean( "DAEMON_CORE_USE_EPOLL", true );
+		fprintf( stdout, "%d idle sockets, %d cycles, %.2f usec/cycle, DAEMON_CORE_USE_EPOLL=%s\n",
+				 (int)idle_socks.size(), num_cycles, usec, use_epoll ? "true" : "false" );
+		dprintf( D_ALWAYS, "%d idle sockets, %d cycles, %.2f usec/cycle, DAEMON_CORE_USE_EPOLL=%s\n",
+				 (int)idle_socks.size(), num_cycles, usec, use_epoll ? "true" : "false" );
+		DC_Exit( 0 );
+	}
+
+	if( daemonCore->Write_Pipe( hot_pipe[1], &c, 1 ) != 1 ) {
+		EXCEPT( "failed to write to hot pipe" );
+	}
+	return 0;
+}
+
+void
+main_init( int argc, char * argv [] ) {
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+			num_sockets = atoi( argv[++i] );
+		} else if( strcmp( argv[i], "-i" ) == 0 && i + 1 < argc ) {
+			num_cycles = atoi( argv[++i] );
+		} else {
+			usage( argv[0] );
+		}
+	}
+	if( num_sockets < 0 || num_cycles < 1 ) {
+		usage( argv[0] );
+	}
+
+	for( int i = 0; i < num_sockets; i++ ) {
+		int sv[2];
+		if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 ) {
+			dprintf( D_ALWAYS, "socketpair() failed after %d sockets: %s\n", i, strerror(errno) );
+			break;
+		}
+		ReliSock * rsock = new ReliSock();
+		rsock->assignDomainSocket( sv[0] );
+		if( daemonCore->Register_Socket( rsock, "idle socket",
+				idle_socket_handler, "idle_socket_handler" ) < 0 ) {
+			EXCEPT( "failed to register idle socket %d", i );
+		}
+		idle_socks.push_back( rsock );
+		idle_peers.push_back( sv[1] );
+	}
+	dprintf( D_ALWAYS, "registered %d idle sockets\n", (int)idle_socks.size() );
+
+	if( ! daemonCore->Create_Pipe( hot_pipe, true, false, true, true ) ) {
+		EXCEPT( "failed to create hot pipe" );
+	}
+	daemonCore->Register_Pipe( hot_pipe[0], "hot pipe",
+		hot_pipe_handler, "hot_pipe_handler" );
+
+	char c = 0;
+	daemonCore->Write_Pipe( hot_pipe[1], &c, 1 );
+}
+
+void
+main_config() {
+}
+
+void
+main_shutdown_fast() {
+	DC_Exit( 0 );
+}
+
+void
+main_shutdown_graceful() {
+	DC_Exit( 0 );
+}
+
+int
+main( int argc, char * argv [] ) {
+	set_mySubSystem( "TESTING", SUBSYSTEM_TYPE_DAEMON );
+
+#if !defined(WIN32)
+	// Each idle socket uses two fds.  Raise our limit before DaemonCore
+	// sizes its select() fd sets from it.
+	struct rlimit rlim;
+	if( getrlimit( RLIMIT_NOFILE, &rlim ) == 0 && rlim.rlim_cur < rlim.rlim_max ) {
+		rlim.rlim_cur = rlim.rlim_max;
+		if( rlim.rlim_cur > 1024 * 1024 ) {
+			rlim.rlim_cur = 1024 * 1024;
+		}
+		setrlimit( RLIMIT_NOFILE, &rlim );
+	}
+#endif
+
+	dc_main_init = main_init;
+	dc_main_config = main_config;
+	dc_main_shutdown_fast = main_shutdown_fast;
+	dc_main_shutdown_graceful = main_shutdown_graceful;
+
+	return dc_main( argc, argv );
+}
@@ -0,0 +1,244 @@
+// Measures how fast ReliSock::put_file()/get_file(), which FileTransfer
+// uses for every file, and put_bytes() move data over a loopback TCP
+// connection, with CEDAR's bulk transfer settings on and off.
+//
+// usage: condor_file_transfer_bench [-s <megabytes>] [-d <scratch dir>]
+//
+// Each case sends a file of the given size from a child process to its
+// parent, which checks that the data arrived intact.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "reli_sock.h"
+#include "condor_ver_info.h"
+
+#include <stdio.h>
+#include <string>
+
+static const int CHUNK_SIZE = 65536;
+
+struct BenchCase {
+	const char * name;
+	bool use_put_file;		// else put_bytes() in CHUNK_SIZE messages
+	const char * packet_size;	// CEDAR_BULK_PACKET_SIZE
+	const char * zero_copy;		// CEDAR_ZERO_COPY
+	Protocol protocol;		// encryption, if any
+};
+
+static const BenchCase bench_cases[] = {
+	{ "put_file, 8.9.10 behavior", true, "4096", "false", CONDOR_NO_PROTOCOL },
+	{ "put_file, sendfile/splice", true, "262144", "true", CONDOR_NO_PROTOCOL },
+	{ "put_bytes, 4KB packets", false, "4096", "false", CONDOR_NO_PROTOCOL },
+	{ "put_bytes, 256KB packets", false, "262144", "false", CONDOR_NO_PROTOCOL },
+	{ "put_bytes, 256KB zero-copy", false, "262144", "true", CONDOR_NO_PROTOCOL },
+	{ "put_file AESGCM, 4KB packets", true, "4096", "true", CONDOR_AESGCM },
+	{ "put_file AESGCM, 256KB packets", true, "262144", "true", CONDOR_AESGCM },
+};
+
+static void
+usage( const char * name ) {
+	fprintf( stderr, "usage: %s [-s <megabytes>] [-d <scratch dir>]\n", name );
+	exit( 1 );
+}
+
+static void
+fill_chunk( char * buf, int chunk ) {
+	for( int i = 0; i < CHUNK_SIZE; i++ ) {
+		buf[i] = (char)(chunk + i * 7);
+	}
+}
+
+static bool
+write_source_file( const std::string & path, int chunks ) {
+	int fd = safe_open_wrapper_follow( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+	if( fd < 0 ) {
+		fprintf( stderr, "failed to create %s: %s\n", path.c_str(), strerror(errno) );
+		return false;
+	}
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf );
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		fill_chunk( buf, c );
+		ok = full_write( fd, buf, CHUNK_SIZE ) == CHUNK_SIZE;
+	}
+	free( buf );
+	close( fd );
+	return ok;
+}
+
+	// Returns true if the file holds what write_source_file() wrote.
+static bool
+check_file( const std::string & path, int chunks ) {
+	int fd = safe_open_wrapper_follow( path.c_str(), O_RDONLY, 0 );
+	if( fd < 0 ) {
+		return false;
+	}
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	char * expected = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf && expected );
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		fill_chunk( expected, c );
+		ok = full_read( fd, buf, CHUNK_SIZE ) == CHUNK_SIZE &&
+			memcmp( buf, expected, CHUNK_SIZE ) == 0;
+	}
+	char extra;
+	if( ok && read( fd, &extra, 1 ) != 0 ) {
+		ok = false;
+	}
+	free( buf );
+	free( expected );
+	close( fd );
+	return ok;
+}
+
+static void
+setup_sock( ReliSock & sock, const BenchCase & bc ) {
+	sock.timeout( 60 );
+
+		// as if a security handshake had told us the peer's version
+	CondorVersionInfo version;
+	sock.set_peer_version( &version );
+
+	if( bc.protocol != CONDOR_NO_PROTOCOL ) {
+		unsigned char keybuf[24];
+		for( int i = 0; i < (int)sizeof(keybuf); i++ ) {
+			keybuf[i] = (unsigned char)i;
+		}
+		KeyInfo key( keybuf, sizeof(keybuf), bc.protocol );
+		if( ! sock.set_crypto_key( true, &key ) ) {
+			EXCEPT( "failed to set crypto key" );
+		}
+	}
+}
+
+static bool
+send_data( ReliSock & sock, const BenchCase & bc, const std::string & source, int chunks ) {
+	sock.encode();
+	if( bc.use_put_file ) {
+		filesize_t size = 0;
+		return sock.put_file( &size, source.c_str() ) == 0 && sock.end_of_message();
+	}
+
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf );
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		fill_chunk( buf, c );
+		ok = sock.put_bytes( buf, CHUNK_SIZE ) == CHUNK_SIZE && sock.end_of_message();
+	}
+	free( buf );
+	return ok;
+}
+
+static bool
+receive_data( ReliSock & sock, const BenchCase & bc, const std::string & dest, int chunks ) {
+	sock.decode();
+	if( bc.use_put_file ) {
+		filesize_t size = 0;
+		return sock.get_file( &size, dest.c_str(), false ) == 0 && sock.end_of_message() &&
+			check_file( dest, chunks );
+	}
+
+	char * buf = (char *)malloc( CHUNK_SIZE );
+	char * expected = (char *)malloc( CHUNK_SIZE );
+	ASSERT( buf && expected );
+	bool ok = true;
+	for( int c = 0; ok && c < chunks; c++ ) {
+		ok = sock.get_bytes( buf, CHUNK_SIZE ) == CHUNK_SIZE && sock.end_of_message();
+		fill_chunk( expected, c );
+		ok = ok && memcmp( buf, expected, CHUNK_SIZE ) == 0;
+	}
+	free( buf );
+	free( expected );
+	return ok;
+}
+
+	// Returns the throughput in MB/s, or a negative number on failure.
+	// The time to check the received file is not counted.
+static double
+run_case( const BenchCase & bc, const std::string & source, const std::string & dest, int chunks ) {
+	param_insert( "CEDAR_BULK_PACKET_SIZE", bc.packet_size );
+	param_insert( "CEDAR_ZERO_COPY", bc.zero_copy );
+
+	ReliSock sender, receiver;
+	if( ! sender.connect_socketpair( receiver ) ) {
+		EXCEPT( "failed to connect loopback sockets" );
+	}
+	setup_sock( sender, bc );
+	setup_sock( receiver, bc );
+
+	pid_t pid = fork();
+	if( pid < 0 ) {
+		EXCEPT( "fork() failed: %s", strerror(errno) );
+	}
+	if( pid == 0 ) {
+		receiver.close();
+		_exit( send_data( sender, bc, source, chunks ) ? 0 : 1 );
+	}
+	sender.close();
+
+	double start = _condor_debug_get_time_double();
+	bool ok = receive_data( receiver, bc, dest, chunks );
+	double elapsed = _condor_debug_get_time_double() - start;
+	receiver.close();
+	unlink( dest.c_str() );
+
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	if( ! ok || ! WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+		return -1;
+	}
+	return (double)chunks * CHUNK_SIZE / (1024 * 1024) / elapsed;
+}
+
+int
+main( int argc, char * argv [] ) {
+	int megabytes = 512;
+	const char * dir = "/tmp";
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) {
+			megabytes = atoi( argv[++i] );
+		} else if( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc ) {
+			dir = argv[++i];
+		} else {
+			usage( argv[0] );
+		}
+	}
+	if( megabytes < 1 ) {
+		usage( argv[0] );
+	}
+	int chunks = megabytes * (1024 * 1024 / CHUNK_SIZE);
+
+	set_priv_initialize();
+	config();
+	dprintf_config_tool_on_error( 0 );
+	dprintf_OnExitDumpOnErrorBuffer( stderr );
+
+	std::string source, dest;
+	formatstr( source, "%s/file_transfer_bench.%d.src", dir, (int)getpid() );
+	formatstr( dest, "%s/file_transfer_bench.%d.dst", dir, (int)getpid() );
+	if( ! write_source_file( source, chunks ) ) {
+		unlink( source.c_str() );
+		return 1;
+	}
+
+	int failures = 0;
+	printf( "%-32s %10s\n", "CASE", "MB/s" );
+	for( size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++ ) {
+		const BenchCase & bc = bench_cases[i];
+		double rate = run_case( bc, source, dest, chunks );
+		if( rate < 0 ) {
+			printf( "%-32s %10s\n", bc.name, "FAILED" );
+			failures++;
+		} else {
+			printf( "%-32s %10.1f\n", bc.name, rate );
+		}
+		fflush( stdout );
+	}
+
+	unlink( source.c_str() );
+	return failures ? 1 : 0;
+}
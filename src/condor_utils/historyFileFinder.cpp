@@ -35,6 +35,7 @@
 #include "subsystem_info.h"
 
 #include "historyFileFinder.h"
+#include "classadHistory.h" // for IsHistoryIndexFilename
 
 static bool isHistoryBackup(const char *fullFilename, time_t *backup_time);
 static int compareHistoryFilenames(const void *item1, const void *item2);
@@ -154,7 +155,8 @@ static bool isHistoryBackup(const char *fullFilename, time_t *backup_time)
     filename            = condor_basename(fullFilename);
 
     if (   !strncmp(filename, history_base, history_base_length)
-        && filename[history_base_length] == '.') {
+        && filename[history_base_length] == '.'
+        && !IsHistoryIndexFilename(filename)) {
         // The filename begins correctly, now see if it ends in an 
         // ISO time
         struct tm file_time;
@@ -0,0 +1,861 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "compat_classad_util.h"
+#include "condor_fsync.h"
+#include "stl_string_utils.h"
+#include "history_archive.h"
+
+// the ways a column can be encoded
+enum {
+	ArchiveColumnDictionary = 0,	// distinct values, then (run length, value index) pairs
+	ArchiveColumnIntegerDelta = 1,	// the difference of each integer from the one before
+};
+
+static unsigned long long zigzag(long long val) {
+	return ((unsigned long long)val << 1) ^ (unsigned long long)(val >> 63);
+}
+static long long unzigzag(unsigned long long val) {
+	return (long long)(val >> 1) ^ -(long long)(val & 1);
+}
+
+// true if text is an integer written the way the ClassAd unparser writes it,
+// so that the text can be made again from the number.
+static bool
+IsCanonicalInteger(const std::string & text, long long & val)
+{
+	if (text.empty() || text.size() > 20) {
+		return false;
+	}
+	char * end = NULL;
+	errno = 0;
+	val = strtoll(text.c_str(), &end, 10);
+	if (*end || errno) {
+		return false;
+	}
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%lld", val);
+	return text == buf;
+}
+
+static void
+putFixed64(std::string & buf, unsigned long long val)
+{
+	for (int ix = 0; ix < 8; ++ix) {
+		buf += (char)((val >> (8*ix)) & 0xFF);
+	}
+}
+
+static unsigned long long
+getFixed64(const char * p)
+{
+	unsigned long long val = 0;
+	for (int ix = 0; ix < 8; ++ix) {
+		val |= (unsigned long long)(unsigned char)p[ix] << (8*ix);
+	}
+	return val;
+}
+
+bool
+IsHistoryArchive(const char * filename)
+{
+	FILE * fp = safe_fopen_wrapper_follow(filename, "rb");
+	if ( ! fp) {
+		return false;
+	}
+	char buf[sizeof(HISTORY_ARCHIVE_MAGIC)];
+	size_t len = sizeof(HISTORY_ARCHIVE_MAGIC) - 1;
+	bool is_archive = fread(buf, 1, len, fp) == len && memcmp(buf, HISTORY_ARCHIVE_MAGIC, len) == 0;
+	fclose(fp);
+	return is_archive;
+}
+
+// --------------------------------------------------------------------------
+// Writing an archive
+// --------------------------------------------------------------------------
+
+class HistoryArchiveWriter {
+public:
+	HistoryArchiveWriter(FILE * fp) : fp(fp), offset(0), num_rows(0) {}
+
+	bool Begin();
+	// add an attribute to the ad being read. returns false if the ad already has it.
+	bool AddAttr(const std::string & name, const std::string & value);
+	// the ad being read is complete, or is to be thrown away.
+	void EndRow();
+	void DropRow();
+	int NumRows() const { return num_rows; }
+	bool WriteBlock();
+	bool Finish();
+
+private:
+	void EncodeColumn(const std::vector<std::string> & values, LogRecordBody & body, bool & has_range, long long & min, long long & max);
+	bool Write(const std::string & buf);
+
+	FILE * fp;
+	long long offset;
+	int num_rows;
+
+	std::map<std::string, int> col_index;
+	std::vector<std::string> col_names;
+	std::vector<std::vector<std::string> > col_values;
+
+	std::map<std::vector<int>, int> layout_index;
+	std::vector<std::vector<int> > layouts;
+	std::vector<int> row_layouts;
+
+	// the ad being read
+	std::vector<int> row_cols;
+	std::vector<std::string> row_values;
+	classad::References row_attrs;
+
+	LogRecordBody directory;
+	int num_blocks;
+};
+
+bool
+HistoryArchiveWriter::Write(const std::string & buf)
+{
+	if (fwrite(buf.data(), 1, buf.size(), fp) != buf.size()) {
+		return false;
+	}
+	offset += buf.size();
+	return true;
+}
+
+bool
+HistoryArchiveWriter::Begin()
+{
+	num_blocks = 0;
+	return Write(HISTORY_ARCHIVE_MAGIC);
+}
+
+bool
+HistoryArchiveWriter::AddAttr(const std::string & name, const std::string & value)
+{
+	// attribute names are not case sensitive, so an ad can have each just once
+	if ( ! row_attrs.insert(name).second) {
+		return false;
+	}
+	std::map<std::string, int>::iterator it = col_index.find(name);
+	int col;
+	if (it == col_index.end()) {
+		col = (int)col_names.size();
+		col_index[name] = col;
+		col_names.push_back(name);
+		col_values.resize(col_names.size());
+	} else {
+		col = it->second;
+	}
+	row_cols.push_back(col);
+	row_values.push_back(value);
+	return true;
+}
+
+void
+HistoryArchiveWriter::EndRow()
+{
+	for (size_t ix = 0; ix < row_cols.size(); ++ix) {
+		col_values[row_cols[ix]].push_back(row_values[ix]);
+	}
+	std::map<std::vector<int>, int>::iterator it = layout_index.find(row_cols);
+	if (it == layout_index.end()) {
+		int layout = (int)layouts.size();
+		layout_index[row_cols] = layout;
+		layouts.push_back(row_cols);
+		row_layouts.push_back(layout);
+	} else {
+		row_layouts.push_back(it->second);
+	}
+	++num_rows;
+	DropRow();
+}
+
+void
+HistoryArchiveWriter::DropRow()
+{
+	row_cols.clear();
+	row_values.clear();
+	row_attrs.clear();
+}
+
+// encode the values of a column in whichever way is smaller
+void
+HistoryArchiveWriter::EncodeColumn(const std::vector<std::string> & values, LogRecordBody & body, bool & has_range, long long & min, long long & max)
+{
+	std::map<std::string, int> dict_index;
+	std::vector<const std::string *> dict;
+	LogRecordBody runs;
+	has_range = true;
+	min = max = 0;
+	long long val;
+
+	size_t ix = 0;
+	while (ix < values.size()) {
+		size_t run = 1;
+		while (ix + run < values.size() && values[ix + run] == values[ix]) ++run;
+
+		std::map<std::string, int>::iterator it = dict_index.find(values[ix]);
+		int dix;
+		if (it == dict_index.end()) {
+			dix = (int)dict.size();
+			dict_index[values[ix]] = dix;
+			dict.push_back(&values[ix]);
+			if (has_range && IsCanonicalInteger(values[ix], val)) {
+				if (dix == 0 || val < min) min = val;
+				if (dix == 0 || val > max) max = val;
+			} else {
+				has_range = false;
+			}
+		} else {
+			dix = it->second;
+		}
+		runs.putVarint(run);
+		runs.putVarint(dix);
+		ix += run;
+	}
+
+	body.clear();
+	body.putVarint(ArchiveColumnDictionary);
+	body.putVarint(dict.size());
+	for (size_t dix = 0; dix < dict.size(); ++dix) {
+		body.putString(dict[dix]->c_str());
+	}
+	body.data() += runs.data();
+
+	// integers that are mostly different from each other, like job ids and
+	// times, are smaller as differences.
+	if (has_range && dict.size() > 1) {
+		LogRecordBody deltas;
+		deltas.putVarint(ArchiveColumnIntegerDelta);
+		long long prev = 0;
+		for (ix = 0; ix < values.size(); ++ix) {
+			IsCanonicalInteger(values[ix], val);
+			deltas.putVarint(zigzag((long long)((unsigned long long)val - (unsigned long long)prev)));
+			prev = val;
+		}
+		if (deltas.data().size() < body.data().size()) {
+			body.data().swap(deltas.data());
+		}
+	}
+}
+
+bool
+HistoryArchiveWriter::WriteBlock()
+{
+	if ( ! num_rows) {
+		return true;
+	}
+
+	// the order of the attributes in each ad
+	LogRecordBody layout_body;
+	layout_body.putVarint(layouts.size());
+	for (size_t ix = 0; ix < layouts.size(); ++ix) {
+		layout_body.putVarint(layouts[ix].size());
+		for (size_t jx = 0; jx < layouts[ix].size(); ++jx) {
+			layout_body.putVarint(layouts[ix][jx]);
+		}
+	}
+	size_t row = 0;
+	while (row < row_layouts.size()) {
+		size_t run = 1;
+		while (row + run < row_layouts.size() && row_layouts[row + run] == row_layouts[row]) ++run;
+		layout_body.putVarint(run);
+		layout_body.putVarint(row_layouts[row]);
+		row += run;
+	}
+
+	LogRecordBody header;
+	header.putVarint(num_rows);
+	header.putVarint(layout_body.data().size());
+	header.putVarint(col_names.size());
+	std::string data;
+	data.swap(layout_body.data());
+	LogRecordBody col_body;
+	for (size_t col = 0; col < col_names.size(); ++col) {
+		bool has_range;
+		long long min, max;
+		EncodeColumn(col_values[col], col_body, has_range, min, max);
+		header.putString(col_names[col].c_str());
+		header.putVarint(has_range ? 1 : 0);
+		if (has_range) {
+			header.putVarint(zigzag(min));
+			header.putVarint(zigzag(max));
+		}
+		header.putVarint(col_body.data().size());
+		data += col_body.data();
+	}
+
+	directory.putVarint(offset);
+	directory.putVarint(header.data().size());
+	directory.putVarint(num_rows);
+	++num_blocks;
+
+	if ( ! Write(header.data()) || ! Write(data)) {
+		return false;
+	}
+
+	col_index.clear();
+	col_names.clear();
+	col_values.clear();
+	layout_index.clear();
+	layouts.clear();
+	row_layouts.clear();
+	num_rows = 0;
+	return true;
+}
+
+bool
+HistoryArchiveWriter::Finish()
+{
+	if ( ! WriteBlock()) {
+		return false;
+	}
+	LogRecordBody trailer;
+	trailer.putVarint(num_blocks);
+	trailer.data() += directory.data();
+	putFixed64(trailer.data(), offset);
+	return Write(trailer.data());
+}
+
+bool
+WriteHistoryArchive(const char * history_name, const char * archive_name, std::string & errmsg)
+{
+	FILE * in = safe_fopen_wrapper_follow(history_name, "r");
+	if ( ! in) {
+		formatstr(errmsg, "can't open %s: %s", history_name, strerror(errno));
+		return false;
+	}
+	FILE * out = safe_fopen_wrapper_follow(archive_name, "wb", 0644);
+	if ( ! out) {
+		formatstr(errmsg, "can't create %s: %s", archive_name, strerror(errno));
+		fclose(in);
+		return false;
+	}
+
+	HistoryArchiveWriter writer(out);
+	bool success = writer.Begin();
+	std::string line, name, value;
+	long long lineno = 0;
+	while (success && readLine(line, in)) {
+		++lineno;
+		chomp(line);
+		const char * psz = line.c_str();
+		while (*psz == ' ' || *psz == '\t') ++psz;
+
+		// the "***" banner line ends each ad, it is made again from the ad when needed
+		if (starts_with(line, "*** ")) {
+			writer.EndRow();
+			if (writer.NumRows() >= HISTORY_ARCHIVE_BLOCK_ROWS) {
+				success = writer.WriteBlock();
+			}
+			continue;
+		}
+		if ( ! *psz || *psz == '#') {
+			continue;
+		}
+
+		// split the line the way ClassAd::Insert does
+		const char * peq = strchr(psz, '=');
+		if ( ! peq || *psz == '\'') {
+			formatstr(errmsg, "line %lld of %s is not an attribute", lineno, history_name);
+			success = false;
+			break;
+		}
+		const char * p = peq;
+		while (p > psz && p[-1] == ' ') --p;
+		name.assign(psz, p - psz);
+		p = peq + 1;
+		while (*p == ' ') ++p;
+		value = p;
+		if (name.empty() || ! writer.AddAttr(name, value)) {
+			formatstr(errmsg, "line %lld of %s is a duplicate or empty attribute", lineno, history_name);
+			success = false;
+			break;
+		}
+	}
+	// an ad without its banner line is skipped, as it is by condor_history
+	writer.DropRow();
+	if (success && ferror(in)) {
+		formatstr(errmsg, "can't read %s: %s", history_name, strerror(errno));
+		success = false;
+	}
+	fclose(in);
+
+	if (success && ( ! writer.Finish() || fflush(out) != 0 || condor_fsync(fileno(out)) != 0)) {
+		formatstr(errmsg, "can't write %s: %s", archive_name, strerror(errno));
+		success = false;
+	}
+	if (fclose(out) != 0 && success) {
+		formatstr(errmsg, "can't write %s: %s", archive_name, strerror(errno));
+		success = false;
+	}
+	if ( ! success) {
+		unlink(archive_name);
+	}
+	return success;
+}
+
+bool
+WriteHistoryArchiveAsText(const char * archive_name, FILE * fp, std::string & errmsg)
+{
+	HistoryArchiveReader reader;
+	if ( ! reader.Open(archive_name, errmsg)) {
+		return false;
+	}
+
+	// each ad is followed by a banner line like the one AppendHistory writes,
+	// with the offset of the banner before it.
+	long long offset = 0, last_banner = 0;
+	std::string text;
+	for (int block = 0; block < reader.NumBlocks(); ++block) {
+		if ( ! reader.ReadBlockHeader(block) || ! reader.ReadBlockData()) {
+			formatstr(errmsg, "block %d of %s is corrupt", block, archive_name);
+			return false;
+		}
+		for (int row = 0; row < reader.NumRows(); ++row) {
+			text.clear();
+			reader.GetRowText(row, text);
+
+			ClassAd ad;
+			reader.GetRow(row, ad);
+			int cluster, proc, completion;
+			std::string owner;
+			if ( ! ad.LookupInteger("ClusterId", cluster)) {
+				cluster = -1;
+			}
+			if ( ! ad.LookupInteger("ProcId", proc)) {
+				proc = -1;
+			}
+			if ( ! ad.LookupInteger("CompletionDate", completion)) {
+				completion = -1;
+			}
+			if ( ! ad.LookupString("Owner", owner)) {
+				owner = "?";
+			}
+			long long banner = offset + text.size();
+			formatstr_cat(text, "*** Offset = %d ClusterId = %d ProcId = %d Owner = \"%s\" CompletionDate = %d\n",
+				(int)last_banner, cluster, proc, owner.c_str(), completion);
+			if (fwrite(text.data(), 1, text.size(), fp) != text.size()) {
+				formatstr(errmsg, "write failed: %s", strerror(errno));
+				return false;
+			}
+			offset += text.size();
+			last_banner = banner;
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// Reading an archive
+// --------------------------------------------------------------------------
+
+HistoryArchiveReader::HistoryArchiveReader()
+	: fp(NULL), cur_block(-1), num_rows(0), data_read(false)
+{
+}
+
+HistoryArchiveReader::~HistoryArchiveReader()
+{
+	Close();
+}
+
+void
+HistoryArchiveReader::Close()
+{
+	ClearBlock();
+	blocks.clear();
+	if (fp) {
+		fclose(fp);
+		fp = NULL;
+	}
+}
+
+void
+HistoryArchiveReader::ClearBlock()
+{
+	for (size_t col = 0; col < columns.size(); ++col) {
+		for (size_t ix = 0; ix < columns[col].parsed.size(); ++ix) {
+			delete columns[col].parsed[ix];
+		}
+	}
+	columns.clear();
+	layouts.clear();
+	row_layouts.clear();
+	data.clear();
+	data_read = false;
+	num_rows = 0;
+	cur_block = -1;
+}
+
+bool
+HistoryArchiveReader::Open(const char * filename, std::string & errmsg)
+{
+	Close();
+	fp = safe_fopen_wrapper_follow(filename, "rb");
+	if ( ! fp) {
+		formatstr(errmsg, "can't open %s: %s", filename, strerror(errno));
+		return false;
+	}
+
+	std::string buf;
+	size_t magic_len = sizeof(HISTORY_ARCHIVE_MAGIC) - 1;
+	buf.resize(magic_len);
+	long long size = -1;
+	if (fread(&buf[0], 1, magic_len, fp) == magic_len && buf == HISTORY_ARCHIVE_MAGIC &&
+		fseek(fp, 0, SEEK_END) == 0) {
+		size = ftell(fp);
+	}
+	long long dir_offset = -1;
+	if (size >= (long long)magic_len + 8) {
+		buf.resize(8);
+		if (fseek(fp, size - 8, SEEK_SET) == 0 && fread(&buf[0], 1, 8, fp) == 8) {
+			dir_offset = (long long)getFixed64(buf.data());
+		}
+	}
+	if (dir_offset < (long long)magic_len || dir_offset > size - 8) {
+		formatstr(errmsg, "%s is not a history archive", filename);
+		Close();
+		return false;
+	}
+
+	LogRecordBody dir;
+	dir.data().resize(size - 8 - dir_offset);
+	if (fseek(fp, dir_offset, SEEK_SET) != 0 ||
+		fread(&dir.data()[0], 1, dir.data().size(), fp) != dir.data().size()) {
+		formatstr(errmsg, "can't read %s: %s", filename, strerror(errno));
+		Close();
+		return false;
+	}
+	unsigned long long num_blocks, offset, header_size, rows;
+	bool valid = dir.getVarint(num_blocks) && num_blocks <= dir.data().size();
+	for (unsigned long long ix = 0; valid && ix < num_blocks; ++ix) {
+		valid = dir.getVarint(offset) && dir.getVarint(header_size) && dir.getVarint(rows) &&
+			offset >= magic_len && offset + header_size <= (unsigned long long)dir_offset &&
+			rows <= INT_MAX;
+		Block block;
+		block.offset = offset;
+		block.header_size = header_size;
+		block.rows = (int)rows;
+		blocks.push_back(block);
+	}
+	if ( ! valid || ! dir.atEnd()) {
+		formatstr(errmsg, "the directory of %s is corrupt", filename);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool
+HistoryArchiveReader::ReadBlockHeader(int block)
+{
+	ClearBlock();
+	if (block < 0 || block >= (int)blocks.size()) {
+		return false;
+	}
+
+	LogRecordBody header;
+	header.data().resize(blocks[block].header_size);
+	if (fseek(fp, blocks[block].offset, SEEK_SET) != 0 ||
+		fread(&header.data()[0], 1, header.data().size(), fp) != header.data().size()) {
+		return false;
+	}
+
+	unsigned long long rows, layout_size, num_cols, has_range, zz, size;
+	if ( ! header.getVarint(rows) || rows != (unsigned long long)blocks[block].rows ||
+		! header.getVarint(layout_size) || ! header.getVarint(num_cols) || num_cols > header.data().size()) {
+		return false;
+	}
+	size_t data_offset = layout_size;
+	columns.resize(num_cols);
+	for (size_t col = 0; col < num_cols; ++col) {
+		Column & column = columns[col];
+		column.has_range = false;
+		column.min = column.max = 0;
+		column.decoded = false;
+		if ( ! header.getString(column.name) || ! header.getVarint(has_range)) {
+			return false;
+		}
+		if (has_range) {
+			column.has_range = true;
+			if ( ! header.getVarint(zz)) return false;
+			column.min = unzigzag(zz);
+			if ( ! header.getVarint(zz)) return false;
+			column.max = unzigzag(zz);
+		}
+		if ( ! header.getVarint(size)) {
+			return false;
+		}
+		column.data_offset = data_offset;
+		column.data_size = size;
+		data_offset += size;
+	}
+	if ( ! header.atEnd()) {
+		return false;
+	}
+	data.resize(data_offset);
+	num_rows = (int)rows;
+	cur_block = block;
+	return true;
+}
+
+bool
+HistoryArchiveReader::GetIntegerRange(const char * attr, long long & min, long long & max, bool & absent) const
+{
+	const Column * found = NULL;
+	for (size_t col = 0; col < columns.size(); ++col) {
+		if (strcasecmp(columns[col].name.c_str(), attr) == MATCH) {
+			if (found) return false;
+			found = &columns[col];
+		}
+	}
+	absent = ! found;
+	if (found) {
+		if ( ! found->has_range) return false;
+		min = found->min;
+		max = found->max;
+	}
+	return true;
+}
+
+bool
+HistoryArchiveReader::ReadBlockData()
+{
+	if (cur_block < 0) {
+		return false;
+	}
+	if (data_read) {
+		return true;
+	}
+	const Block & block = blocks[cur_block];
+	if (fseek(fp, block.offset + block.header_size, SEEK_SET) != 0 ||
+		fread(&data[0], 1, data.size(), fp) != data.size()) {
+		return false;
+	}
+
+	LogRecordBody body;
+	body.data().assign(data, 0, columns.empty() ? data.size() : columns[0].data_offset);
+	unsigned long long num_layouts, len, ix, run;
+	if ( ! body.getVarint(num_layouts) || num_layouts > body.data().size()) {
+		return false;
+	}
+	layouts.resize(num_layouts);
+	for (size_t lx = 0; lx < num_layouts; ++lx) {
+		if ( ! body.getVarint(len) || len > columns.size()) {
+			return false;
+		}
+		layouts[lx].resize(len);
+		for (size_t jx = 0; jx < len; ++jx) {
+			if ( ! body.getVarint(ix) || ix >= columns.size()) {
+				return false;
+			}
+			layouts[lx][jx] = (int)ix;
+		}
+	}
+	row_layouts.reserve(num_rows);
+	while ((int)row_layouts.size() < num_rows) {
+		if ( ! body.getVarint(run) || ! body.getVarint(ix) || ! run ||
+			run > (unsigned long long)(num_rows - row_layouts.size()) || ix >= num_layouts) {
+			return false;
+		}
+		row_layouts.insert(row_layouts.end(), run, (int)ix);
+	}
+	data_read = body.atEnd();
+	return data_read;
+}
+
+bool
+HistoryArchiveReader::DecodeColumn(Column & col)
+{
+	if (col.decoded) {
+		return true;
+	}
+	int col_index = (int)(&col - &columns[0]);
+
+	// the rows that have this column
+	std::vector<bool> in_layout(layouts.size(), false);
+	for (size_t lx = 0; lx < layouts.size(); ++lx) {
+		for (size_t jx = 0; jx < layouts[lx].size(); ++jx) {
+			if (layouts[lx][jx] == col_index) in_layout[lx] = true;
+		}
+	}
+	std::vector<int> rows;
+	for (int row = 0; row < num_rows; ++row) {
+		if (in_layout[row_layouts[row]]) rows.push_back(row);
+	}
+
+	col.row_values.assign(num_rows, -1);
+	LogRecordBody body;
+	body.data().assign(data, col.data_offset, col.data_size);
+	unsigned long long kind, count, run, ix, zz;
+	if ( ! body.getVarint(kind)) {
+		return false;
+	}
+	if (kind == ArchiveColumnDictionary) {
+		if ( ! body.getVarint(count) || count > col.data_size) {
+			return false;
+		}
+		col.values.resize(count);
+		for (size_t dix = 0; dix < count; ++dix) {
+			if ( ! body.getString(col.values[dix])) return false;
+		}
+		size_t rx = 0;
+		while (rx < rows.size()) {
+			if ( ! body.getVarint(run) || ! body.getVarint(ix) || ! run || run > rows.size() - rx || ix >= count) {
+				return false;
+			}
+			for (size_t end = rx + run; rx < end; ++rx) {
+				col.row_values[rows[rx]] = (int)ix;
+			}
+		}
+	} else if (kind == ArchiveColumnIntegerDelta) {
+		long long val = 0;
+		col.values.resize(rows.size());
+		for (size_t rx = 0; rx < rows.size(); ++rx) {
+			if ( ! body.getVarint(zz)) return false;
+			val = (long long)((unsigned long long)val + (unsigned long long)unzigzag(zz));
+			formatstr(col.values[rx], "%lld", val);
+			col.row_values[rows[rx]] = (int)rx;
+		}
+	} else {
+		return false;
+	}
+	col.decoded = body.atEnd();
+	return col.decoded;
+}
+
+classad::ExprTree *
+HistoryArchiveReader::ParsedValue(Column & col, int ix)
+{
+	if (col.parsed.size() < col.values.size()) {
+		col.parsed.resize(col.values.size(), NULL);
+	}
+	// each distinct value is parsed just once for the block
+	if ( ! col.parsed[ix]) {
+		classad::ClassAdParser parser;
+		parser.SetOldClassAd(true);
+		col.parsed[ix] = parser.ParseExpression(col.values[ix]);
+	}
+	return col.parsed[ix];
+}
+
+// insert the value of column col for the row into ad.  if literal_only is true,
+// fail if the value is not a literal.
+bool
+HistoryArchiveReader::InsertValue(ClassAd & ad, Column & col, int row, bool literal_only)
+{
+	if ( ! DecodeColumn(col) || col.row_values[row] < 0) {
+		return false;
+	}
+	classad::ExprTree * tree = ParsedValue(col, col.row_values[row]);
+	if ( ! tree) {
+		return false;
+	}
+	if (tree->GetKind() == classad::ExprTree::LITERAL_NODE) {
+		return ad.Insert(col.name, tree->Copy());
+	}
+	if (literal_only) {
+		return false;
+	}
+	// other values are inserted the way ClassAd::Insert inserts the line from
+	// the history file, since a copy of a nested ad doesn't keep its order.
+	std::string name(col.name);
+	return ad.InsertViaCache(name, col.values[col.row_values[row]]);
+}
+
+bool
+HistoryArchiveReader::GetRow(int row, ClassAd & ad, const classad::References * attrs)
+{
+	if ( ! data_read || row < 0 || row >= num_rows) {
+		return false;
+	}
+	const std::vector<int> & layout = layouts[row_layouts[row]];
+
+	// find the attributes that are wanted and the attributes they refer to
+	std::vector<bool> wanted(layout.size(), attrs == NULL);
+	if (attrs) {
+		classad::References refs(*attrs);
+		bool more = true;
+		while (more) {
+			more = false;
+			for (size_t jx = 0; jx < layout.size(); ++jx) {
+				Column & col = columns[layout[jx]];
+				if (wanted[jx] || ! refs.count(col.name)) continue;
+				wanted[jx] = true;
+				if ( ! DecodeColumn(col)) {
+					return false;
+				}
+				size_t num_refs = refs.size();
+				classad::ExprTree * tree = ParsedValue(col, col.row_values[row]);
+				if (tree && ! GetUnscopedAttrRefs(tree, refs)) {
+					return GetRow(row, ad, NULL);
+				}
+				if (refs.size() != num_refs) more = true;
+			}
+		}
+	}
+
+	for (size_t jx = 0; jx < layout.size(); ++jx) {
+		if (wanted[jx] && ! InsertValue(ad, columns[layout[jx]], row, false)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+HistoryArchiveReader::GetRowLiterals(int row, ClassAd & ad, const classad::References & attrs)
+{
+	if ( ! data_read || row < 0 || row >= num_rows) {
+		return false;
+	}
+	const std::vector<int> & layout = layouts[row_layouts[row]];
+	for (size_t jx = 0; jx < layout.size(); ++jx) {
+		Column & col = columns[layout[jx]];
+		if (attrs.count(col.name) && ! InsertValue(ad, col, row, true)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+HistoryArchiveReader::GetRowText(int row, std::string & text)
+{
+	if ( ! data_read || row < 0 || row >= num_rows) {
+		return false;
+	}
+	const std::vector<int> & layout = layouts[row_layouts[row]];
+	for (size_t jx = 0; jx < layout.size(); ++jx) {
+		Column & col = columns[layout[jx]];
+		if ( ! DecodeColumn(col)) {
+			return false;
+		}
+		text += col.name;
+		text += " = ";
+		text += col.values[col.row_values[row]];
+		text += '\n';
+	}
+	return true;
+}
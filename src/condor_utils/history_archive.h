@@ -0,0 +1,134 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _HISTORY_ARCHIVE_H_
+#define _HISTORY_ARCHIVE_H_
+
+#include "condor_classad.h"
+#include "log.h" // for LogRecordBody
+
+/*
+   A history archive holds the job ads of a rotated history file in a
+   compact, column oriented form.  The ads are stored in blocks of up to
+   HISTORY_ARCHIVE_BLOCK_ROWS ads.  Within a block, each attribute is a
+   column holding the unparsed value of the attribute for the ads that
+   have it, encoded either as a dictionary of the distinct values and runs
+   of references to it, or, for integers, as the differences between
+   successive values.  The order of the attributes in each ad is kept as
+   a reference to a dictionary of attribute orders, so the archive can be
+   turned back into the history file it was made from.
+
+   The header of each block has the name of each column, and the smallest
+   and largest value of the columns that hold only integers, so readers can
+   skip blocks that can't match a query without reading their columns, and
+   read just the columns that a query needs.
+
+   On disk the archive is HISTORY_ARCHIVE_MAGIC, the blocks, each made of
+   its header and then its columns, and then a directory of the blocks.
+   The last 8 bytes of the file are the offset of the directory.  Numbers
+   and strings are encoded as they are in the body of a binary job queue
+   log record.
+
+   The columns are not compressed further with zlib.  zlib is optional
+   (HAVE_ZLIB_H), and an archive written by one build must be readable by
+   the condor_history of any other.
+*/
+
+#define HISTORY_ARCHIVE_MAGIC "CONDOR_HISTORY_ARCHIVE 1\n"
+#define HISTORY_ARCHIVE_BLOCK_ROWS 1024
+
+// true if the file is a history archive
+bool IsHistoryArchive(const char * filename);
+
+// write an archive of the history file history_name to archive_name.  returns
+// false and sets errmsg if the history file can't be archived exactly, in which
+// case archive_name is not left behind.
+bool WriteHistoryArchive(const char * history_name, const char * archive_name, std::string & errmsg);
+
+// write the text form of an archive to fp, as it was in the history file.
+bool WriteHistoryArchiveAsText(const char * archive_name, FILE * fp, std::string & errmsg);
+
+class HistoryArchiveReader {
+public:
+	HistoryArchiveReader();
+	~HistoryArchiveReader();
+
+	bool Open(const char * filename, std::string & errmsg);
+	void Close();
+
+	int NumBlocks() const { return (int)blocks.size(); }
+	int NumBlockRows(int block) const { return blocks[block].rows; }
+
+	// read the header of a block, after which the range methods can be used.
+	bool ReadBlockHeader(int block);
+	// returns true if every ad in the block that has the attribute has an integer
+	// literal value for it, in which case min and max are the smallest and largest.
+	// absent is true if no ad in the block has the attribute.
+	bool GetIntegerRange(const char * attr, long long & min, long long & max, bool & absent) const;
+
+	// read the columns of the block whose header was read last,
+	// after which the row methods can be used.
+	bool ReadBlockData();
+	int NumRows() const { return num_rows; }
+
+	// insert the attributes of an ad into ad, in the order they were in the
+	// history file.  If attrs is not NULL, only the attributes in it and the
+	// attributes they refer to are inserted, unless an attribute refers to
+	// attributes in a way that can't be followed, in which case they all are.
+	bool GetRow(int row, ClassAd & ad, const classad::References * attrs = NULL);
+	// insert the attributes in attrs into ad.  Returns false if an inserted
+	// value is not a literal, in which case ad can't stand in for the job ad.
+	bool GetRowLiterals(int row, ClassAd & ad, const classad::References & attrs);
+	// append the attributes of an ad to text as they were in the history file.
+	bool GetRowText(int row, std::string & text);
+
+private:
+	struct Block {
+		long long offset;
+		long long header_size;
+		int rows;
+	};
+	struct Column {
+		std::string name;
+		bool has_range;
+		long long min, max;
+		size_t data_offset, data_size;
+		bool decoded;
+		std::vector<std::string> values;	// the distinct values
+		std::vector<int> row_values;		// for each row, an index into values or -1
+		std::vector<classad::ExprTree*> parsed; // the parsed values, as they are needed
+	};
+
+	bool DecodeColumn(Column & col);
+	bool InsertValue(ClassAd & ad, Column & col, int row, bool literal_only);
+	classad::ExprTree * ParsedValue(Column & col, int ix);
+	void ClearBlock();
+
+	FILE * fp;
+	std::vector<Block> blocks;
+	int cur_block;
+	int num_rows;
+	std::vector<Column> columns;
+	std::vector<std::vector<int> > layouts;	// the order of the columns in the ads
+	std::vector<int> row_layouts;			// for each row, an index into layouts
+	std::string data;
+	bool data_read;
+};
+
+#endif
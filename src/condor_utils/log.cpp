@@ -34,6 +34,8 @@
 
 #include "log.h"
 #include "stl_string_utils.h"
+#include <map>
+#include <algorithm>
 
 bool valid_record_optype(int optype) {
     switch (optype) {
@@ -163,8 +165,11 @@ LogRecord::readline(FILE *fp, char * &str)
 }
 
 int
-LogRecord::Write(FILE *fp)
+LogRecord::Write(FILE *fp, bool binary)
 {
+	if (binary) {
+		return WriteBinary(fp);
+	}
 	int rval1, rval2, rval3;
 	return( ( rval1=WriteHeader(fp) )<0 || 
 			( rval2=WriteBody(fp) )  <0 || 
@@ -196,6 +201,26 @@ LogRecord::WriteTail(FILE *fp)
 	return( fprintf(fp, "\n") < 1 ? -1 : 1 );
 }
 
+int
+LogRecord::WriteBinary(FILE *fp)
+{
+	LogRecordBody body;
+	if (op_type <= 100 || op_type >= 100 + 0x80 || WriteBinaryBody(body) < 0) {
+		return -1;
+	}
+
+	LogRecordBody header;
+	header.data() += (char)(0x80 | (op_type - 100));
+	header.putVarint(body.data().size());
+
+	size_t len = header.data().size() + body.data().size();
+	if (fwrite(header.data().data(), 1, header.data().size(), fp) < header.data().size() ||
+		fwrite(body.data().data(), 1, body.data().size(), fp) < body.data().size()) {
+		return -1;
+	}
+	return (int)len;
+}
+
 
 
 int
@@ -228,8 +253,19 @@ LogRecord::ReadTail(FILE *  /*fp*/)
 }
 
 LogRecord *
-ReadLogEntry(FILE *fp, unsigned long recnum, LogRecord* (*InstantiateLogEntry)(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor), const ConstructLogEntry & ctor)
+ReadLogEntry(FILE *fp, unsigned long recnum, LogRecord* (*InstantiateLogEntry)(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor), const ConstructLogEntry & ctor)
 {
+	int ch = fgetc(fp);
+	if (ch == EOF) return NULL;
+	if (is_binary_log_record(ch)) {
+		ungetc(ch, fp);
+		LogRecordBody body;
+		int op = ReadBinaryLogRecord(fp, body);
+		if (op < 0) return NULL;
+		return InstantiateLogEntry(fp, recnum, op, &body, ctor);
+	}
+	ungetc(ch, fp);
+
     char* opword = NULL;
     int opcode = CondorLogOp_Error;
 	int rval = LogRecord::readword(fp, opword);
@@ -240,5 +276,407 @@ ReadLogEntry(FILE *fp, unsigned long recnum, LogRecord* (*InstantiateLogEntry)(F
     }
     free(opword);
 
-	return InstantiateLogEntry(fp, recnum, opcode, ctor);
+	return InstantiateLogEntry(fp, recnum, opcode, NULL, ctor);
+}
+
+// Names that are written to the log as an index into this table rather than
+// as a string.  Logs refer to names by their position in the table, so names
+// may be added to the end of the table but never removed or reordered.
+static const char * const LogRecordNames[] = {
+	"",
+	"Job",
+	"Machine",
+	"ClusterId",
+	"ProcId",
+	"Owner",
+	"User",
+	"QDate",
+	"JobStatus",
+	"EnteredCurrentStatus",
+	"LastJobStatus",
+	"JobUniverse",
+	"Cmd",
+	"Args",
+	"Arguments",
+	"Env",
+	"Environment",
+	"Iwd",
+	"In",
+	"Out",
+	"Err",
+	"UserLog",
+	"Requirements",
+	"Rank",
+	"RequestCpus",
+	"RequestMemory",
+	"RequestDisk",
+	"DiskUsage",
+	"ImageSize",
+	"ExecutableSize",
+	"MemoryUsage",
+	"ResidentSetSize",
+	"JobPrio",
+	"NiceUser",
+	"CompletionDate",
+	"RemoteWallClockTime",
+	"RemoteUserCpu",
+	"RemoteSysCpu",
+	"LocalUserCpu",
+	"LocalSysCpu",
+	"CumulativeSlotTime",
+	"CumulativeSuspensionTime",
+	"CommittedTime",
+	"CommittedSlotTime",
+	"CommittedSuspensionTime",
+	"TotalSuspensions",
+	"NumJobStarts",
+	"NumRestarts",
+	"NumShadowStarts",
+	"NumCkpts",
+	"NumSystemHolds",
+	"JobRunCount",
+	"JobStartDate",
+	"JobCurrentStartDate",
+	"JobCurrentStartExecutingDate",
+	"JobLastStartDate",
+	"ShadowBday",
+	"LastSuspensionTime",
+	"LastMatchTime",
+	"LastRemoteHost",
+	"RemoteHost",
+	"RemoteSlotID",
+	"StartdPrincipal",
+	"StartdIpAddr",
+	"ClaimId",
+	"PublicClaimId",
+	"GlobalJobId",
+	"JobLeaseDuration",
+	"WantCheckpoint",
+	"WantRemoteSyscalls",
+	"WantRemoteIO",
+	"TransferIn",
+	"TransferInput",
+	"TransferOutput",
+	"TransferExecutable",
+	"ShouldTransferFiles",
+	"WhenToTransferOutput",
+	"StreamOut",
+	"StreamErr",
+	"OnExitRemove",
+	"OnExitHold",
+	"PeriodicHold",
+	"PeriodicRelease",
+	"PeriodicRemove",
+	"LeaveJobInQueue",
+	"ExitStatus",
+	"ExitCode",
+	"ExitBySignal",
+	"ExitSignal",
+	"HoldReason",
+	"HoldReasonCode",
+	"HoldReasonSubCode",
+	"ReleaseReason",
+	"RemoveReason",
+	"MaxHosts",
+	"MinHosts",
+	"CurrentHosts",
+	"CoreSize",
+	"BufferSize",
+	"BufferBlockSize",
+	"AutoClusterId",
+	"AutoClusterAttrs",
+	"JobNotification",
+	"NotifyUser",
+	"AccountingGroup",
+	"NTDomain",
+	"x509userproxy",
+	"x509UserProxySubject",
+	"JobMachineAttrs",
+	"MachineAttrCpus0",
+	"MachineAttrSlotWeight0",
+	"LastRejMatchReason",
+	"LastRejMatchTime",
+	"CondorVersion",
+	"CondorPlatform",
+	"JobSubmitMethod",
+	"SubmitEventNotes",
+	"BytesSent",
+	"BytesRecvd",
+	"TransferInputSizeMB",
+	"CumulativeTransferTime",
+	"DiskUsage_RAW",
+	"ImageSize_RAW",
+	"OrigMaxHosts",
+	"NextClusterNum",
+	"Managed",
+	"StageInStart",
+	"StageInFinish",
+	"StartdSendsAlives",
+	"JobCoreDumped",
+	"LastHoldReason",
+	"LastHoldReasonCode",
+	"LastHoldReasonSubCode",
+	"ProcessesRunning",
+	"NumJobMatches",
+	"WantMatchDiagnostics",
+	"MyType",
+	"TargetType",
+	"Priority",
+	"PriorityFactor",
+	"ResourcesUsed",
+	"WeightedResourcesUsed",
+	"AccumulatedUsage",
+	"WeightedAccumulatedUsage",
+	"BeginUsageTime",
+	"LastUsageTime",
+	"UnchargedTime",
+	"WeightedUnchargedTime",
+	"LastUpdateTime",
+	"Accountant",
+};
+
+// maps a name to its index in LogRecordNames, built on first use.
+static std::map<std::string, int> & LogRecordNameIndex()
+{
+	static std::map<std::string, int> index;
+	if (index.empty()) {
+		for (int ix = 0; ix < (int)(sizeof(LogRecordNames)/sizeof(LogRecordNames[0])); ++ix) {
+			index[LogRecordNames[ix]] = ix;
+		}
+	}
+	return index;
+}
+
+// the tags that begin a SetAttribute value in a binary log entry
+enum {
+	LogValueExpr = 0,
+	LogValueUndefined,
+	LogValueFalse,
+	LogValueTrue,
+	LogValueInteger,
+	LogValueReal,
+	LogValueString,
+};
+
+void
+LogRecordBody::putVarint(unsigned long long val)
+{
+	while (val >= 0x80) {
+		buf += (char)(0x80 | (val & 0x7F));
+		val >>= 7;
+	}
+	buf += (char)val;
+}
+
+void
+LogRecordBody::putString(const char * str)
+{
+	size_t len = str ? strlen(str) : 0;
+	putVarint(len);
+	buf.append(str ? str : "", len);
+}
+
+// a name is written as 1 + its index in LogRecordNames,
+// or as 0 followed by the name as a string
+void
+LogRecordBody::putName(const char * name)
+{
+	std::map<std::string, int> & index = LogRecordNameIndex();
+	std::map<std::string, int>::const_iterator it = index.find(name ? name : "");
+	if (it != index.end()) {
+		putVarint(it->second + 1);
+	} else {
+		putVarint(0);
+		putString(name);
+	}
+}
+
+void
+LogRecordBody::putValue(const char * text, const classad::ExprTree * expr)
+{
+	if (expr && expr->GetKind() == classad::ExprTree::LITERAL_NODE) {
+		classad::Value::NumberFactor factor;
+		const classad::Value & val = ((const classad::Literal*)expr)->getValue(factor);
+
+			// only store the literal if reading it back will reproduce the text
+		std::string unparsed;
+		classad::ClassAdUnParser unparser;
+		unparser.SetOldClassAd(true, true);
+		unparser.Unparse(unparsed, expr);
+		if (factor == classad::Value::NO_FACTOR && unparsed == text) {
+			bool b;
+			long long ll;
+			double d;
+			const char * str;
+			if (val.IsUndefinedValue()) {
+				buf += (char)LogValueUndefined;
+				return;
+			} else if (val.IsBooleanValue(b)) {
+				buf += (char)(b ? LogValueTrue : LogValueFalse);
+				return;
+			} else if (val.IsIntegerValue(ll)) {
+				buf += (char)LogValueInteger;
+				// zigzag encode so that small negative numbers are short
+				putVarint(((unsigned long long)ll << 1) ^ (unsigned long long)(ll >> 63));
+				return;
+			} else if (val.IsRealValue(d)) {
+				unsigned long long bits;
+				memcpy(&bits, &d, sizeof(bits));
+				buf += (char)LogValueReal;
+				for (int ix = 0; ix < 8; ++ix) {
+					buf += (char)((bits >> (8*ix)) & 0xFF);
+				}
+				return;
+			} else if (val.IsStringValue(str)) {
+				buf += (char)LogValueString;
+				putString(str);
+				return;
+			}
+		}
+	}
+	buf += (char)LogValueExpr;
+	putString(text);
+}
+
+bool
+LogRecordBody::getVarint(unsigned long long & val)
+{
+	val = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos >= buf.size()) return false;
+		unsigned char ch = (unsigned char)buf[pos++];
+		val |= (unsigned long long)(ch & 0x7F) << shift;
+		if ( ! (ch & 0x80)) return true;
+	}
+	return false;
+}
+
+bool
+LogRecordBody::getString(char * & str)
+{
+	unsigned long long len;
+	if ( ! getVarint(len) || len > buf.size() - pos) return false;
+	str = (char *)malloc(len + 1);
+	if ( ! str) return false;
+	memcpy(str, buf.data() + pos, len);
+	str[len] = 0;
+	pos += len;
+	return true;
+}
+
+bool
+LogRecordBody::getString(std::string & str)
+{
+	unsigned long long len;
+	if ( ! getVarint(len) || len > buf.size() - pos) return false;
+	str.assign(buf, pos, len);
+	pos += len;
+	return true;
+}
+
+bool
+LogRecordBody::getName(char * & name)
+{
+	unsigned long long ix;
+	if ( ! getVarint(ix)) return false;
+	if (ix == 0) return getString(name);
+	if (ix > sizeof(LogRecordNames)/sizeof(LogRecordNames[0])) return false;
+	name = strdup(LogRecordNames[ix - 1]);
+	return name != NULL;
+}
+
+bool
+LogRecordBody::getValue(char * & value, classad::ExprTree ** expr)
+{
+	if (atEnd()) return false;
+	int tag = (unsigned char)buf[pos++];
+	if (tag == LogValueExpr) {
+		return getString(value);
+	}
+
+	classad::Literal * lit = NULL;
+	switch (tag) {
+	case LogValueUndefined:
+		lit = classad::Literal::MakeUndefined();
+		break;
+	case LogValueFalse:
+	case LogValueTrue:
+		lit = classad::Literal::MakeBool(tag == LogValueTrue);
+		break;
+	case LogValueInteger: {
+		unsigned long long zz;
+		if ( ! getVarint(zz)) return false;
+		lit = classad::Literal::MakeLong((long long)(zz >> 1) ^ -(long long)(zz & 1));
+		break;
+	}
+	case LogValueReal: {
+		if (buf.size() - pos < 8) return false;
+		unsigned long long bits = 0;
+		for (int ix = 0; ix < 8; ++ix) {
+			bits |= (unsigned long long)(unsigned char)buf[pos++] << (8*ix);
+		}
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		lit = classad::Literal::MakeReal(d);
+		break;
+	}
+	case LogValueString: {
+		unsigned long long len;
+		if ( ! getVarint(len) || len > buf.size() - pos) return false;
+		lit = classad::Literal::MakeString(buf.data() + pos, len);
+		pos += len;
+		break;
+	}
+	default:
+		return false;
+	}
+	if ( ! lit) return false;
+
+	std::string unparsed;
+	classad::ClassAdUnParser unparser;
+	unparser.SetOldClassAd(true, true);
+	unparser.Unparse(unparsed, lit);
+	value = strdup(unparsed.c_str());
+	if (expr) {
+		*expr = lit;
+	} else {
+		delete lit;
+	}
+	return value != NULL;
+}
+
+int
+ReadBinaryLogRecord(FILE *fp, LogRecordBody & body)
+{
+	body.clear();
+
+	int ch = fgetc(fp);
+	if (ch == EOF) return -1;
+	if ( ! is_binary_log_record(ch)) return CondorLogOp_Error;
+	int op_type = 100 + (ch & 0x7F);
+
+	unsigned long long len = 0;
+	for (int shift = 0; ; shift += 7) {
+		ch = fgetc(fp);
+		if (ch == EOF) return -1;
+		if (shift > 28) return CondorLogOp_Error;
+		len |= (unsigned long long)(ch & 0x7F) << shift;
+		if ( ! (ch & 0x80)) break;
+	}
+	if (len > 0x40000000) return CondorLogOp_Error;
+
+		// read the body a piece at a time, so that a corrupt length
+		// doesn't make us allocate more than the file holds
+	std::string & data = body.data();
+	const size_t chunk = 64*1024;
+	while (data.size() < len) {
+		size_t have = data.size();
+		size_t want = (size_t)std::min<unsigned long long>(len - have, chunk);
+		data.resize(have + want);
+		if (fread(&data[have], 1, want, fp) < want) {
+			body.clear();
+			return -1;
+		}
+	}
+	return valid_record_optype(op_type) ? op_type : CondorLogOp_Error;
 }
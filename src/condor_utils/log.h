@@ -35,6 +35,11 @@ using std::string;
    log.  The Play() method is defined to perform the operation on
    the data structure passed in as an argument.  The argument is of
    type (void *) for generality.
+
+   Log entries may instead be written in a compact binary form, see
+   LogRecordBody below.  Since a text entry always begins with an ascii
+   digit and a binary entry never does, both kinds of entry may be
+   mixed in the same log, and readers tell them apart entry by entry.
 */
 
 #define CondorLogOp_NewClassAd			101
@@ -46,6 +51,52 @@ using std::string;
 #define CondorLogOp_LogHistoricalSequenceNumber 107
 #define CondorLogOp_Error               999
 
+/*
+   The body of a binary log entry.  On disk a binary entry is a byte
+   holding 0x80 + (op_type - 100), the length of the body as a varint,
+   and then the body.  Within the body, numbers are varints, strings are
+   a varint length and the characters, and attribute and type names are
+   either a reference to a fixed dictionary of well known names or an
+   inline string.  SetAttribute values that are simple literals are
+   stored already parsed, so reading them back doesn't need the ClassAd
+   parser.  The get methods return false if the body is malformed.
+*/
+class LogRecordBody {
+public:
+	LogRecordBody() : pos(0) {}
+
+	void clear() { buf.clear(); pos = 0; }
+	std::string & data() { return buf; }
+	bool atEnd() const { return pos >= buf.size(); }
+
+	void putVarint(unsigned long long val);
+	void putString(const char * str);
+	void putName(const char * name);
+		// the value is stored as a typed literal when expr is a literal that
+		// unparses to exactly the given text, and as expression text otherwise
+	void putValue(const char * text, const classad::ExprTree * expr);
+
+	bool getVarint(unsigned long long & val);
+	bool getString(char * & str);	// str is malloc'ed
+	bool getString(std::string & str);
+	bool getName(char * & name);	// name is malloc'ed
+		// value is malloc'ed.  if expr is not NULL and the value was
+		// stored as a literal, *expr is set to the parsed literal.
+	bool getValue(char * & value, classad::ExprTree ** expr);
+
+private:
+	std::string buf;
+	size_t pos;
+};
+
+// returns true if ch is the first byte of a binary log entry
+inline bool is_binary_log_record(int ch) { return ch >= 0x80 && ch != EOF; }
+
+// read a binary log entry into body, returning its op_type, CondorLogOp_Error
+// if the entry is malformed, or -1 at the end of the file or of a partially
+// written entry.
+int ReadBinaryLogRecord(FILE *fp, LogRecordBody & body);
+
 class LogRecord {
 public:
 	
@@ -53,11 +104,12 @@ public:
 	virtual ~LogRecord();
 	int get_op_type() const { return op_type; }
 
-	int Write(FILE *fp);
+	int Write(FILE *fp, bool binary = false);
 	int Read(FILE *fp);
 	int ReadHeader(FILE *fp);
 	virtual int ReadBody(FILE *) { return 0; }
 	int ReadTail(FILE *fp);
+	virtual int ReadBinaryBody(LogRecordBody &) { return 0; }
 
 	virtual int Play(void *) { return 0; }
 
@@ -73,6 +125,8 @@ private:
 	int WriteHeader(FILE *fp) const;
 	virtual int WriteBody(FILE *) { return 0; }
 	int WriteTail(FILE *fp);
+	int WriteBinary(FILE *fp);
+	virtual int WriteBinaryBody(LogRecordBody &) { return 0; }
 };
 
 class ConstructLogEntry
@@ -83,7 +137,10 @@ public:
 	virtual ~ConstructLogEntry() {}; // declare (superfluous) virtual constructor to get rid of g++ warning.
 };
 
-LogRecord *ReadLogEntry(FILE* fp, unsigned long recnum, LogRecord* (*InstantiateLogEntry)(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor), const ConstructLogEntry & ctor);
+// Reads a text or binary log entry.  For a binary entry, InstantiateLogEntry
+// is passed the body of the entry, for a text entry body is NULL and the
+// body is read from fp.
+LogRecord *ReadLogEntry(FILE* fp, unsigned long recnum, LogRecord* (*InstantiateLogEntry)(FILE *fp, unsigned long recnum, int type, LogRecordBody * body, const ConstructLogEntry & ctor), const ConstructLogEntry & ctor);
 
 bool valid_record_optype(int optype);
 
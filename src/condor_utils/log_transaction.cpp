@@ -52,7 +52,7 @@ Transaction::~Transaction()
 }
 
 void
-Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable)
+Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable, bool binary)
 {
 	LogRecord *log;
 	int fd;
@@ -71,7 +71,7 @@ Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_s
 
 	while( (log = ordered_op_log.Next()) ) {
 		if ( fp != NULL ) {
-			if ( log->Write( fp ) < 0 ) {
+			if ( log->Write( fp, binary ) < 0 ) {
 				EXCEPT( "write to %s failed, errno = %d", filename, errno );
 			}
 		}
@@ -48,7 +48,7 @@ class Transaction {
 public:
 	Transaction();
 	~Transaction();
-	void Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable=false);
+	void Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable=false, bool binary=false);
 	void AppendLog(LogRecord *);
 	LogRecord *FirstEntry(char const *key);
 	LogRecord *NextEntry();
@@ -24,6 +24,7 @@
 #include "condor_debug.h"
 #include "selector.h"
 #include "condor_threads.h"
+#include <algorithm>
 
 #ifndef SELECTOR_USE_POLL
 #define POLLIN 1
@@ -49,6 +50,10 @@ int poll(struct fake_pollfd *, int, int)
 
 int Selector::_fd_select_size = -1;
 
+#ifdef SELECTOR_USE_EPOLL
+static std::vector<Selector *> persistent_selectors;
+#endif
+
 Selector::Selector()
 {
 #if defined(WIN32)
@@ -71,11 +76,24 @@ Selector::Selector()
 	save_write_fds = NULL;
 	save_except_fds = NULL;
 
+	m_persistent = false;
+	m_forgot_fds = false;
+#ifdef SELECTOR_USE_EPOLL
+	m_epfd = -1;
+	m_epoll_pid = 0;
+	m_interest_changed = false;
+#endif
+
 	reset();
 }
 
 Selector::~Selector()
 {
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		set_persistent( false );
+	}
+#endif
 	free( read_fds );
 }
 
@@ -121,6 +139,25 @@ Selector::reset()
 	timeout.tv_sec = timeout.tv_usec = 0;
 
 	max_fd = -1;
+	m_forgot_fds = false;
+
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		m_interest_changed = true;
+			// Only the caller's interest is forgotten here; what is
+			// registered with the kernel is reconciled in execute().
+		for ( size_t i = 0; i < m_wanted_fds.size(); i++ ) {
+			m_wanted[m_wanted_fds[i]] = 0;
+		}
+		m_wanted_fds.clear();
+		for ( size_t i = 0; i < m_ready_fds.size(); i++ ) {
+			m_ready[m_ready_fds[i]] = 0;
+		}
+		m_ready_fds.clear();
+		m_single_shot = SINGLE_SHOT_SKIP;
+	} else
+#endif
+	{
 	if ( save_read_fds != NULL ) {
 #if defined(WIN32)
 		FD_ZERO( save_read_fds );
@@ -139,6 +176,7 @@ Selector::reset()
 	m_single_shot = SINGLE_SHOT_SKIP;
 	init_fd_sets();
 #endif
+	}
 	memset(&m_poll, '\0', sizeof(m_poll));
 
 	if (IsDebugLevel(D_DAEMONCORE)) {
@@ -223,6 +261,29 @@ Selector::add_fd( int fd, IO_FUNC interest )
 		free(fd_description);
 	}
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		grow_fd_state( fd );
+		m_interest_changed = true;
+		if ( ! (m_wanted[fd] & EP_LISTED) ) {
+			m_wanted_fds.push_back( fd );
+			m_wanted[fd] = EP_LISTED;
+		}
+		switch( interest ) {
+		case IO_READ:
+			m_wanted[fd] |= EP_READ;
+			break;
+		case IO_WRITE:
+			m_wanted[fd] |= EP_WRITE;
+			break;
+		case IO_EXCEPT:
+			m_wanted[fd] |= EP_EXCEPT;
+			break;
+		}
+		return;
+	}
+#endif
+
 	if ((m_single_shot == SINGLE_SHOT_OK) && (m_poll.fd != fd)) {
 		init_fd_sets();
 		m_single_shot = SINGLE_SHOT_SKIP;
@@ -287,13 +348,33 @@ Selector::delete_fd( int fd, IO_FUNC interest )
 	}
 #endif
 
-	init_fd_sets();
-	m_single_shot = SINGLE_SHOT_SKIP;
-
 	if (IsDebugLevel(D_DAEMONCORE)) {
 		dprintf(D_DAEMONCORE | D_VERBOSE, "selector %p deleting fd %d\n", this, fd);
 	}
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		m_interest_changed = true;
+		if ( fd < (int)m_wanted.size() ) {
+			switch( interest ) {
+			case IO_READ:
+				m_wanted[fd] &= ~EP_READ;
+				break;
+			case IO_WRITE:
+				m_wanted[fd] &= ~EP_WRITE;
+				break;
+			case IO_EXCEPT:
+				m_wanted[fd] &= ~EP_EXCEPT;
+				break;
+			}
+		}
+		return;
+	}
+#endif
+
+	init_fd_sets();
+	m_single_shot = SINGLE_SHOT_SKIP;
+
 	switch( interest ) {
 
 	  case IO_READ:
@@ -341,6 +422,13 @@ Selector::execute()
 	struct timeval timeout_copy;
 	struct timeval	*tp;
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		execute_persistent();
+		return;
+	}
+#endif
+
 	if ( m_single_shot == SINGLE_SHOT_SKIP ) {
 		memcpy( read_fds, save_read_fds, fd_set_size * sizeof(fd_set) );
 		memcpy( write_fds, save_write_fds, fd_set_size * sizeof(fd_set) );
@@ -421,6 +509,23 @@ Selector::fd_ready( int fd, IO_FUNC interest )
 	}
 #endif
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		if ( fd >= (int)m_ready.size() ) {
+			return false;
+		}
+		switch( interest ) {
+		case IO_READ:
+			return m_ready[fd] & EP_READ;
+		case IO_WRITE:
+			return m_ready[fd] & EP_WRITE;
+		case IO_EXCEPT:
+			return m_ready[fd] & EP_EXCEPT;
+		}
+		return false;
+	}
+#endif
+
 	switch( interest ) {
 
 	  case IO_READ:
@@ -465,6 +570,331 @@ Selector::has_ready()
 	return state == FDS_READY;
 }
 
+bool
+Selector::set_persistent( bool persistent )
+{
+	if ( persistent == m_persistent ) {
+		return true;
+	}
+#ifdef SELECTOR_USE_EPOLL
+	if ( persistent ) {
+		if ( ! create_epoll() ) {
+			return false;
+		}
+		m_persistent = true;
+		persistent_selectors.push_back( this );
+	} else {
+		persistent_selectors.erase( std::remove( persistent_selectors.begin(),
+			persistent_selectors.end(), this ), persistent_selectors.end() );
+		close_epoll();
+		m_wanted.clear();
+		m_registered.clear();
+		m_ready.clear();
+		m_generation.clear();
+		m_wanted_fds.clear();
+		m_ready_fds.clear();
+		m_persistent = false;
+	}
+	reset();
+	return true;
+#else
+	return false;
+#endif
+}
+
+void
+Selector::forget_fd( int fd )
+{
+#ifdef SELECTOR_USE_EPOLL
+	if ( ! m_persistent || fd < 0 || fd >= (int)m_registered.size() ) {
+		return;
+	}
+	if ( m_registered[fd] ) {
+			// A forked child shares our epoll instance, so it must not
+			// touch it.  The fd may already be closed, in which case the
+			// kernel has dropped it and there is nothing to do.
+		if ( m_epoll_pid == getpid() ) {
+			struct epoll_event ev;
+			memset( &ev, 0, sizeof(ev) );
+			epoll_ctl( m_epfd, EPOLL_CTL_DEL, fd, &ev );
+		}
+		m_registered[fd] = 0;
+		m_interest_changed = true;
+		m_forgot_fds = true;
+	}
+	m_ready[fd] = 0;
+#else
+	if ( fd ) {}
+#endif
+}
+
+void
+Selector::fd_closing( int fd )
+{
+#ifdef SELECTOR_USE_EPOLL
+	for ( size_t i = 0; i < persistent_selectors.size(); i++ ) {
+		persistent_selectors[i]->forget_fd( fd );
+	}
+#else
+	if ( fd ) {}
+#endif
+}
+
+#ifdef SELECTOR_USE_EPOLL
+
+bool
+Selector::create_epoll()
+{
+	m_epfd = epoll_create1( EPOLL_CLOEXEC );
+	if ( m_epfd < 0 ) {
+		dprintf( D_ALWAYS, "Selector: epoll_create1() failed: %s (errno=%d)\n",
+				 strerror(errno), errno );
+		return false;
+	}
+	m_epoll_pid = getpid();
+	return true;
+}
+
+void
+Selector::close_epoll()
+{
+	if ( m_epfd >= 0 ) {
+		close( m_epfd );
+		m_epfd = -1;
+	}
+	for ( size_t i = 0; i < m_registered_fds.size(); i++ ) {
+		m_registered[m_registered_fds[i]] = 0;
+	}
+	m_registered_fds.clear();
+}
+
+void
+Selector::grow_fd_state( int fd )
+{
+	if ( fd < (int)m_wanted.size() ) {
+		return;
+	}
+	size_t size = m_wanted.size() ? m_wanted.size() : 64;
+	while ( (int)size <= fd ) {
+		size *= 2;
+	}
+	m_wanted.resize( size, 0 );
+	m_registered.resize( size, 0 );
+	m_ready.resize( size, 0 );
+	m_generation.resize( size, 0 );
+}
+
+unsigned int
+Selector::epoll_events_for( unsigned char interest )
+{
+	unsigned int events = 0;
+	if ( interest & EP_READ ) { events |= EPOLLIN | EPOLLRDHUP; }
+	if ( interest & EP_WRITE ) { events |= EPOLLOUT; }
+	if ( interest & EP_EXCEPT ) { events |= EPOLLPRI; }
+	return events;
+}
+
+// Bring the kernel's registrations in line with what the caller asked
+// for since the last reset().  Fds whose interest did not change cost
+// nothing here.  Fds that epoll cannot watch (regular files) are reported
+// ready immediately, which is what select() would do with them.
+bool
+Selector::sync_registrations()
+{
+	bool ok = true;
+
+	if ( m_epoll_pid != getpid() ) {
+			// We are a forked child still holding our parent's epoll
+			// instance.  Get one of our own and register everything anew.
+		close_epoll();
+		if ( ! create_epoll() ) {
+			EXCEPT( "Selector: failed to create an epoll instance in child process" );
+		}
+		m_interest_changed = true;
+	}
+	if ( ! m_interest_changed ) {
+		return true;
+	}
+	bool always_ready = false;
+
+	for ( size_t i = 0; i < m_registered_fds.size(); i++ ) {
+		int fd = m_registered_fds[i];
+		if ( m_registered[fd] && ! (m_wanted[fd] & EP_INTEREST) ) {
+			struct epoll_event ev;
+			memset( &ev, 0, sizeof(ev) );
+			epoll_ctl( m_epfd, EPOLL_CTL_DEL, fd, &ev );
+			m_registered[fd] = 0;
+		}
+	}
+	m_registered_fds.clear();
+
+	for ( size_t i = 0; i < m_wanted_fds.size(); i++ ) {
+		int fd = m_wanted_fds[i];
+		unsigned char want = m_wanted[fd] & EP_INTEREST;
+		if ( ! want ) {
+			continue;
+		}
+		if ( want != m_registered[fd] ) {
+			struct epoll_event ev;
+			memset( &ev, 0, sizeof(ev) );
+			ev.events = epoll_events_for( want );
+			int op = m_registered[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+			if ( op == EPOLL_CTL_ADD ) {
+				m_generation[fd]++;
+			}
+			ev.data.u64 = ((uint64_t)m_generation[fd] << 32) | (uint32_t)fd;
+			int rc = epoll_ctl( m_epfd, op, fd, &ev );
+			if ( rc < 0 && errno == EEXIST ) {
+				rc = epoll_ctl( m_epfd, EPOLL_CTL_MOD, fd, &ev );
+			} else if ( rc < 0 && errno == ENOENT ) {
+					// Closed and reopened behind our back; the kernel
+					// already dropped the old registration.
+				m_generation[fd]++;
+				ev.data.u64 = ((uint64_t)m_generation[fd] << 32) | (uint32_t)fd;
+				rc = epoll_ctl( m_epfd, EPOLL_CTL_ADD, fd, &ev );
+			}
+			if ( rc < 0 ) {
+				int err = errno;
+				m_registered[fd] = 0;
+				if ( err == EPERM ) {
+					always_ready = true;
+					if ( ! m_ready[fd] ) {
+						m_ready_fds.push_back( fd );
+					}
+					m_ready[fd] = want;
+					continue;
+				}
+				_select_errno = err;
+				ok = false;
+				dprintf( D_ALWAYS, "Selector: failed to register fd %d with epoll: %s (errno=%d)\n",
+						 fd, strerror(err), err );
+				continue;
+			}
+		}
+		m_registered[fd] = want;
+		m_registered_fds.push_back( fd );
+	}
+		// fds that can't be registered must be looked at every time
+	m_interest_changed = always_ready;
+	return ok;
+}
+
+void
+Selector::execute_persistent()
+{
+	for ( size_t i = 0; i < m_ready_fds.size(); i++ ) {
+		m_ready[m_ready_fds[i]] = 0;
+	}
+	m_ready_fds.clear();
+
+	if ( ! sync_registrations() ) {
+		_select_retval = -1;
+		state = FAILED;
+		return;
+	}
+
+	int timeout_ms = -1;
+	if ( timeout_wanted ) {
+			// round up, so we don't spin until the deadline arrives
+		long long ms = (long long)timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+		timeout_ms = ms > INT_MAX ? INT_MAX : (int)ms;
+	}
+	if ( ! m_ready_fds.empty() ) {
+		timeout_ms = 0;
+	}
+
+	size_t max_events = m_registered_fds.size();
+	if ( max_events < 16 ) { max_events = 16; }
+	if ( max_events > 4096 ) { max_events = 4096; }
+	if ( m_events.size() < max_events ) {
+		m_events.resize( max_events );
+	}
+
+	start_thread_safe("select");
+	int nfds = epoll_wait( m_epfd, &m_events[0], (int)max_events, timeout_ms );
+	_select_errno = errno;
+	stop_thread_safe("select");
+	_select_retval = nfds;
+
+	if( nfds < 0 ) {
+		if( _select_errno == EINTR ) {
+			state = SIGNALLED;
+		} else {
+			state = FAILED;
+		}
+		return;
+	}
+	_select_errno = 0;
+
+	bool stale = false;
+	for ( int i = 0; i < nfds; i++ ) {
+		int fd = (int)(uint32_t)(m_events[i].data.u64 & 0xffffffff);
+		unsigned int gen = (unsigned int)(m_events[i].data.u64 >> 32);
+		if ( fd >= (int)m_registered.size() || ! m_registered[fd] ||
+			 m_generation[fd] != gen )
+		{
+			stale = true;
+			continue;
+		}
+		unsigned int events = m_events[i].events;
+		unsigned char ready = 0;
+		if ( events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR) ) {
+			ready |= EP_READ;
+		}
+		if ( events & (EPOLLOUT | EPOLLHUP | EPOLLERR) ) {
+			ready |= EP_WRITE;
+		}
+		if ( events & (EPOLLPRI | EPOLLHUP | EPOLLERR) ) {
+			ready |= EP_EXCEPT;
+		}
+		ready &= m_registered[fd];
+		if ( ! ready ) {
+			continue;
+		}
+		if ( ! m_ready[fd] ) {
+			m_ready_fds.push_back( fd );
+		}
+		m_ready[fd] |= ready;
+	}
+
+	if ( stale ) {
+			// An fd was closed without being forgotten while another
+			// process still holds the file, so the kernel kept its
+			// registration and we can no longer name it to remove it.
+			// Start over with a fresh epoll instance.
+		dprintf( D_ALWAYS, "Selector: epoll reported an event for an fd that is no longer registered; rebuilding the epoll set\n" );
+		close_epoll();
+		if ( ! create_epoll() ) {
+			EXCEPT( "Selector: failed to re-create epoll instance" );
+		}
+		m_interest_changed = true;
+	}
+
+	_select_retval = (int)m_ready_fds.size();
+	if ( m_ready_fds.empty() ) {
+		state = TIMED_OUT;
+	} else {
+		state = FDS_READY;
+	}
+}
+
+static void
+display_fd_list( const char *msg, const std::vector<int> &fds,
+				 const std::vector<unsigned char> &bits, unsigned char mask )
+{
+	int count = 0;
+	dprintf( D_ALWAYS, "%s {", msg );
+	for ( size_t i = 0; i < fds.size(); i++ ) {
+		if ( bits[fds[i]] & mask ) {
+			count++;
+			dprintf( D_ALWAYS | D_NOHEADER, "%d ", fds[i] );
+		}
+	}
+	dprintf( D_ALWAYS | D_NOHEADER, "} = %d\n", count );
+}
+
+#endif /* SELECTOR_USE_EPOLL */
+
 void
 Selector::display()
 {
@@ -472,7 +902,9 @@ Selector::display()
 	//   poll() is used to query a single fd. Currently, it's only
 	//   called in DaemonCore::Driver(), where we should always be
 	//   in select() mode.
-	init_fd_sets();
+	if ( ! m_persistent ) {
+		init_fd_sets();
+	}
 
 	switch( state ) {
 
@@ -499,6 +931,30 @@ Selector::display()
 
 	dprintf( D_ALWAYS, "max_fd = %d\n", max_fd );
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_persistent ) {
+		dprintf( D_ALWAYS, "Registered FD's (epoll fd %d)\n", m_epfd );
+		display_fd_list( "\tRead", m_registered_fds, m_registered, EP_READ );
+		display_fd_list( "\tWrite", m_registered_fds, m_registered, EP_WRITE );
+		display_fd_list( "\tExcept", m_registered_fds, m_registered, EP_EXCEPT );
+		if( state == FDS_READY ) {
+			dprintf( D_ALWAYS, "Ready FD's\n" );
+			display_fd_list( "\tRead", m_ready_fds, m_ready, EP_READ );
+			display_fd_list( "\tWrite", m_ready_fds, m_ready, EP_WRITE );
+			display_fd_list( "\tExcept", m_ready_fds, m_ready, EP_EXCEPT );
+		}
+		if( timeout_wanted ) {
+			dprintf( D_ALWAYS,
+				"Timeout = %ld.%06ld seconds\n", (long) timeout.tv_sec,
+				(long) timeout.tv_usec
+			);
+		} else {
+			dprintf( D_ALWAYS, "Timeout not wanted\n" );
+		}
+		return;
+	}
+#endif
+
 	dprintf( D_ALWAYS, "Selection FD's\n" );
 	bool try_dup = ( (FAILED == state) &&  (EBADF == _select_errno) );
 	display_fd_set( "\tRead", save_read_fds, max_fd, try_dup );
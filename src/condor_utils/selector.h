@@ -27,6 +27,10 @@
 #define SELECTOR_USE_POLL 1
 #endif
 
+#ifdef CONDOR_HAVE_EPOLL
+#define SELECTOR_USE_EPOLL 1
+#endif
+
 #ifdef SELECTOR_USE_POLL
 #include <poll.h>
 #else
@@ -39,6 +43,12 @@ struct fake_pollfd {
 };
 #endif
 
+#ifdef SELECTOR_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include <vector>
+
 class Selector {
 public:
 	Selector();
@@ -69,10 +79,50 @@ public:
 	bool fd_ready( int fd, IO_FUNC interest );
 	void display();
 
+		// A persistent selector keeps its fds registered with the
+		// kernel (via epoll) across calls to reset().  The caller still
+		// declares its interest with add_fd() before every execute(), but
+		// only the fds whose interest changed since the last execute()
+		// cost a system call, and execute() only visits the fds that are
+		// ready.  Returns false if persistent mode is not available, in
+		// which case the selector continues to use select()/poll().
+	bool set_persistent( bool persistent );
+	bool is_persistent() const { return m_persistent; }
+
+		// Tell a persistent selector that whatever fd was registered under
+		// this number is going away (or has already been replaced), so it
+		// must be registered again the next time it is added.
+	void forget_fd( int fd );
+
+		// Call forget_fd() on every persistent selector in this process.
+		// Code that closes an fd which may be registered with a persistent
+		// selector (CEDAR sockets, DaemonCore pipes) must call this before
+		// the close; the kernel only drops an epoll registration once every
+		// copy of the file description is closed, including copies
+		// inherited by child processes.
+	static void fd_closing( int fd );
+
+		// The fds found ready by the last execute() of a persistent
+		// selector.  Always empty for a selector that isn't persistent.
+	const std::vector<int> &ready_fds() const { return m_ready_fds; }
+
+		// True if forget_fd() dropped a registered fd since the last
+		// reset(), so the caller's interest must be declared again.
+	bool forgot_fds() const { return m_forgot_fds; }
+
 private:
 
 	void init_fd_sets();
 
+#ifdef SELECTOR_USE_EPOLL
+	bool create_epoll();
+	void close_epoll();
+	void grow_fd_state( int fd );
+	bool sync_registrations();
+	void execute_persistent();
+	static unsigned int epoll_events_for( unsigned char interest );
+#endif
+
 	enum SINGLE_SHOT {
 		SINGLE_SHOT_VIRGIN, SINGLE_SHOT_OK, SINGLE_SHOT_SKIP
 	};
@@ -95,6 +145,34 @@ private:
 #else
 	struct fake_pollfd m_poll;
 #endif
+
+	bool	m_persistent;
+	bool	m_forgot_fds;
+	std::vector<int> m_ready_fds;
+#ifdef SELECTOR_USE_EPOLL
+	enum {
+		EP_READ = 1, EP_WRITE = 2, EP_EXCEPT = 4,
+		EP_INTEREST = 7,
+		EP_LISTED = 0x80	// fd is already in m_wanted_fds
+	};
+
+	int		m_epfd;
+	pid_t	m_epoll_pid;
+		// Whether m_wanted may differ from m_registered.
+	bool	m_interest_changed;
+		// Per-fd interest bits, indexed by fd: what the caller wants for
+		// the next execute(), what is currently registered with the kernel,
+		// and what the last execute() reported.
+	std::vector<unsigned char> m_wanted;
+	std::vector<unsigned char> m_registered;
+	std::vector<unsigned char> m_ready;
+		// Registration generation of each fd, carried in the epoll event
+		// data so stale events for a replaced fd can be recognized.
+	std::vector<unsigned int> m_generation;
+	std::vector<int> m_wanted_fds;
+	std::vector<int> m_registered_fds;
+	std::vector<struct epoll_event> m_events;
+#endif
 };
 
 void display_fd_set( const char *msg, fd_set *set, int max,
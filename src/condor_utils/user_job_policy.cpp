@@ -636,6 +636,46 @@ UserPolicy::AnalyzePolicy( int mode )
 
 #ifdef USE_NON_MUTATING_USERPOLICY
 
+bool UserPolicy::PeriodicPolicyReferences(ClassAd & ad, classad::References & attrs)
+{
+	// AnalyzePolicy looks at these whether or not the ad has them
+	static const char * const policy_attrs[] = {
+		ATTR_JOB_STATUS, ATTR_TIMER_REMOVE_CHECK,
+		ATTR_PERIODIC_HOLD_CHECK, ATTR_PERIODIC_RELEASE_CHECK, ATTR_PERIODIC_REMOVE_CHECK,
+	};
+	ExprTree * sys_exprs[] = { m_sys_periodic_hold, m_sys_periodic_release, m_sys_periodic_remove };
+
+	bool depends_on_time = false;
+	classad::References refs;
+	for (size_t ix = 0; ix < COUNTOF(policy_attrs); ++ix) {
+		attrs.insert(policy_attrs[ix]);
+		ExprTree * expr = ad.Lookup(policy_attrs[ix]);
+		if (expr && ! GetExprReferences(expr, ad, &refs, &refs)) {
+			depends_on_time = true; // probably a circular reference
+		}
+		depends_on_time = depends_on_time || ExprTreeDependsOnTime(expr);
+	}
+	for (size_t ix = 0; ix < COUNTOF(sys_exprs); ++ix) {
+		if (sys_exprs[ix] && ! GetExprReferences(sys_exprs[ix], ad, &refs, &refs)) {
+			depends_on_time = true;
+		}
+		depends_on_time = depends_on_time || ExprTreeDependsOnTime(sys_exprs[ix]);
+	}
+
+	// the internal references include the attributes referenced through
+	// other attributes, so looking at each of them covers the whole policy
+	for (auto it = refs.begin(); it != refs.end() && ! depends_on_time; ++it) {
+		if (strcasecmp(it->c_str(), "CurrentTime") == MATCH) {
+			depends_on_time = true;
+		} else {
+			depends_on_time = ExprTreeDependsOnTime(ad.Lookup(*it));
+		}
+	}
+
+	attrs.insert(refs.begin(), refs.end());
+	return depends_on_time;
+}
+
 bool UserPolicy::AnalyzeSinglePeriodicPolicy(ClassAd & ad, ExprTree * expr, int on_true_return, int & retval)
 {
 	ASSERT(expr);
@@ -232,6 +232,16 @@ class UserPolicy
 		   occurred, then false is returned. */
 		bool FiringReason(MyString &reason,int &reason_code,int &reason_subcode);
 
+	#ifdef USE_NON_MUTATING_USERPOLICY
+		/* Adds the attributes that the periodic policy of the ad depends on
+			to attrs, including attributes referenced through other attributes
+			and ones that the ad does not have yet.  Returns true if the policy
+			may also depend on the time, or on something not in the ad, so the
+			result of AnalyzePolicy(ad, PERIODIC_ONLY) can change even if none
+			of the attributes do. */
+		bool PeriodicPolicyReferences(ClassAd &ad, classad::References &attrs);
+	#endif
+
 	private: /* functions */
 		/* This function inserts the five of the six (all but TimerRemove) user
 			job policy expressions with default values into the classad if they